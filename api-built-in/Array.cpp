@@ -11,6 +11,7 @@
 #include "objects/JsPrimaryObject.hpp"
 #include "strings/JsString.hpp"
 #include "interpreter/BinaryOperation.hpp"
+#include "interpreter/ArraySort.hpp"
 
 
 void normalizeStart(int &start, int length) {
@@ -1496,19 +1497,7 @@ void arrayPrototypeSort(VMContext *ctx, const JsValue &thiz, const Arguments &ar
         }
     }
 
-    auto vm = ctx->vm;
-
-    if (callback.isFunction()) {
-        stable_sort(values.begin(), values.end(), [vm, ctx, callback](const JsValue &a, const JsValue &b) {
-            ArgumentsX args(a, b);
-            vm->callMember(ctx, jsValueGlobalThis, callback, args);
-            return ctx->error == JE_OK && ctx->runtime->testTrue(ctx->retValue);
-        });
-    } else {
-        stable_sort(values.begin(), values.end(), [vm, ctx, callback](const JsValue &a, const JsValue &b) {
-            return ctx->error == JE_OK && convertToStringLessCmp(ctx, a, b);
-        });
-    }
+    sortJsValues(ctx, values, callback);
 
     // 排好序的属性
     int i = 0;
@@ -34,6 +34,8 @@ void registerJSON(VMRuntimeCommon *rt);
 void registerDate(VMRuntimeCommon *rt);
 void registerReflect(VMRuntimeCommon *rt);
 void registerPromise(VMRuntimeCommon *rt);
+void registerMapSet(VMRuntimeCommon *rt);
+void registerGenerator(VMRuntimeCommon *rt);
 
 
 void registerBuiltIns(VMRuntimeCommon *rt) {
@@ -53,4 +55,6 @@ void registerBuiltIns(VMRuntimeCommon *rt) {
     registerDate(rt);
     registerReflect(rt);
     registerPromise(rt);
+    registerMapSet(rt);
+    registerGenerator(rt);
 }
@@ -13,4 +13,12 @@
 
 void registerBuiltIns(VMRuntimeCommon *rt);
 
+class JsRegExpProgram;
+struct JsRegExpMatch;
+
+// 在 RegExp.cpp 中实现，String.prototype.match/matchAll/replace 等也会使用
+JsValue regExpExec(VMContext *ctx, const JsValue &thiz, const JsValue &strVal);
+JsValue newRegExpExecResult(VMContext *ctx, const JsRegExpProgram &program, const StringView &str, const JsValue &strVal, const JsRegExpMatch &match, uint32_t index);
+JsValue newRegExpGroups(VMContext *ctx, const JsRegExpProgram &program, const StringView &str, const JsRegExpMatch &match);
+
 #endif /* BuiltIn_hpp */
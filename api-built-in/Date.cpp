@@ -21,7 +21,9 @@ public:
     }
 
     virtual IJsObject *clone() override {
-        return new JsDate(time);
+        auto obj = new JsDate(time, isValid);
+        copyPropertiesTo(obj);
+        return obj;
     }
 
     int64_t                         time;
@@ -507,7 +509,8 @@ void datePrototype_toXXString(VMContext *ctx, const JsValue &thiz, cstr_t format
 
     char buf[256];
     time_t time = (time_t)(obj->time / 1000);
-    struct tm *tm = isLocalTime ? localtime(&time) : gmtime(&time);
+    struct tm tmBuf;
+    auto tm = timeToTm(time, isLocalTime, tmBuf);
     auto len = strftime(buf, sizeof(buf), format, tm);
 
     ctx->retValue = ctx->runtime->pushString(StringView(buf, len));
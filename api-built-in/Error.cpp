@@ -6,6 +6,8 @@
 //
 
 #include "BuiltIn.hpp"
+#include "objects/JsArray.hpp"
+#include "strings/JsString.hpp"
 #include <stdio.h>
 
 
@@ -50,6 +52,7 @@ JsValue newJsError(VMContext *ctx, JsError errType, const JsValue &message) {
         case JE_SYNTAX_ERROR: proto = __syntaxErrorPrototype; break;
         case JE_TYPE_ERROR: proto = __typeErrorPrototype; break;
         case JE_RANGE_ERROR: proto = __rangeErrorPrototype; break;
+        case JE_MAX_STACK_EXCEEDED: proto = __rangeErrorPrototype; break;
         case JE_REFERECNE_ERROR: proto = __referenceErrorPrototype; break;
         default: break;
     }
@@ -63,6 +66,22 @@ JsValue newJsError(VMContext *ctx, JsError errType, const JsValue &message) {
     return err;
 }
 
+// errors 为 JsArray
+JsValue newJsAggregateError(VMContext *ctx, const JsValue &errors, const JsValue &message) {
+    auto runtime = ctx->runtime;
+
+    auto errObj = new JsObject(__aggregateErrorPrototype);
+    auto err = runtime->pushObject(errObj);
+
+    if (message.type != JDT_UNDEFINED) {
+        errObj->setByName(ctx, err, SS_MESSAGE, message.isString() ? message : runtime->toString(ctx, message));
+    }
+    errObj->setByName(ctx, err, SS_STACK, runtime->pushString(StringView(getStack(ctx))));
+    errObj->setByName(ctx, err, SS_ERRORS, errors);
+
+    return err;
+}
+
 void errorConstructor(VMContext *ctx, JsError errType, const Arguments &args) {
     JsValue message = jsValueUndefined;
     if (args.count > 0) {
@@ -165,6 +184,45 @@ static JsLibProperty referenceErrorPrototypeFunctions[] = {
     { "toString", errorToString },
 };
 
+// AggregateError
+
+static void aggregateErrorConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto runtime = ctx->runtime;
+    auto iterable = args.getAt(0);
+
+    IJsIterator *it = nullptr;
+    if (iterable.isString()) {
+        it = newJsStringIterator(ctx, iterable, false);
+    } else if (iterable.type >= JDT_OBJECT && runtime->getObject(iterable)->isOfIterable()) {
+        it = runtime->getObject(iterable)->getIteratorObject(ctx, false);
+    } else {
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "%.*s is not iterable (cannot read property Symbol(Symbol.iterator))", iterable);
+        return;
+    }
+
+    auto arr = new JsArray();
+    auto errors = runtime->pushObject(arr);
+    JsValue item;
+    while (it->nextOf(item)) {
+        arr->push(ctx, item);
+    }
+    delete it;
+
+    ctx->retValue = newJsAggregateError(ctx, errors, args.getAt(1));
+}
+
+static JsLibProperty aggregateErrorFunctions[] = {
+    { "name", nullptr, "AggregateError" },
+    { "length", nullptr, nullptr, jsValueLength1Property },
+    { "prototype", nullptr, nullptr, jsValuePropertyPrototype },
+};
+
+static JsLibProperty aggregateErrorPrototypeFunctions[] = {
+    { "name", nullptr, "AggregateError" },
+    { "message", nullptr, nullptr, jsStringValueEmpty.asProperty(JP_WRITABLE | JP_CONFIGURABLE) },
+    { "toString", errorToString },
+};
+
 // RangeError
 
 static void rangeErrorConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
@@ -223,4 +281,12 @@ void registerErrorAPIs(VMRuntimeCommon *rt) {
     __rangeErrorPrototype = rt->pushObject(prototype);
     SET_PROTOTYPE(rangeErrorFunctions, __rangeErrorPrototype);
     setGlobalLibObject("RangeError", rt, rangeErrorFunctions, CountOf(rangeErrorFunctions), rangeErrorConstructor, jsValuePrototypeFunction);
+
+    //
+    // AggregateError
+    //
+    prototype = new JsLibObject(rt, aggregateErrorPrototypeFunctions, CountOf(aggregateErrorPrototypeFunctions), nullptr, nullptr, __errorPrototype);
+    __aggregateErrorPrototype = rt->pushObject(prototype);
+    SET_PROTOTYPE(aggregateErrorFunctions, __aggregateErrorPrototype);
+    setGlobalLibObject("AggregateError", rt, aggregateErrorFunctions, CountOf(aggregateErrorFunctions), aggregateErrorConstructor, jsValuePrototypeFunction);
 }
@@ -0,0 +1,62 @@
+//
+//  Generator.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/25.
+//
+
+#include "BuiltIn.hpp"
+#include "objects/JsGeneratorObject.hpp"
+
+
+JsValue jsValuePrototypeGenerator;
+
+/**
+ * 恢复执行 thiz 对应的 generator，返回 { value, done }
+ */
+static void resumeGenerator(VMContext *ctx, const JsValue &thiz, const Arguments &args, GeneratorResumeMode mode, cstr_t methodName) {
+    auto runtime = ctx->runtime;
+    auto generator = thiz.type == JDT_GENERATOR ? (JsGeneratorObject *)runtime->getObject(thiz) : nullptr;
+    if (generator == nullptr || generator->isAsync()) {
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, (string("Method ") + methodName + " called on incompatible receiver %.*s").c_str(), thiz);
+        return;
+    }
+
+    ctx->vm->resumeGenerator(ctx, generator, mode, args.getAt(0));
+    if (ctx->error != JE_OK) {
+        return;
+    }
+
+    auto value = ctx->retValue;
+    runtime->addTempValue(value);
+
+    auto obj = new JsObject();
+    auto ret = runtime->pushObject(obj);
+    obj->setByName(ctx, ret, SS_VALUE, value);
+    obj->setByName(ctx, ret, SS_DONE, makeJsValueBool(generator->isCompleted()));
+    ctx->retValue = ret;
+}
+
+void generator_prototype_next(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    resumeGenerator(ctx, thiz, args, GRM_NEXT, "Generator.prototype.next");
+}
+
+void generator_prototype_return(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    resumeGenerator(ctx, thiz, args, GRM_RETURN, "Generator.prototype.return");
+}
+
+void generator_prototype_throw(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    resumeGenerator(ctx, thiz, args, GRM_THROW, "Generator.prototype.throw");
+}
+
+static JsLibProperty generatorPrototypeFunctions[] = {
+    { "next", generator_prototype_next },
+    { "return", generator_prototype_return },
+    { "throw", generator_prototype_throw },
+};
+
+void registerGenerator(VMRuntimeCommon *rt) {
+    // 没有全局的 Generator 对象，只有 generator 函数返回的对象的原型
+    auto prototypeObj = new JsLibObject(rt, generatorPrototypeFunctions, CountOf(generatorPrototypeFunctions));
+    jsValuePrototypeGenerator = rt->pushObject(prototypeObj);
+}
@@ -0,0 +1,485 @@
+﻿//
+//  MapSet.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/22.
+//
+
+#include "BuiltIn.hpp"
+#include "objects/JsMap.hpp"
+#include "objects/IJsIterator.hpp"
+#include "strings/JsString.hpp"
+
+
+JsValue jsValuePrototypeMap, jsValuePrototypeSet, jsValuePrototypeWeakMap, jsValuePrototypeWeakSet;
+
+using IJsIteratorPtr = std::shared_ptr<IJsIterator>;
+
+/**
+ * 取得 thiz 对应的 JsMapTable, 类型不匹配时抛出异常并返回 nullptr.
+ */
+static JsMapTable *getMapTable(VMContext *ctx, const JsValue &thiz, JsDataType type, cstr_t method) {
+    if (thiz.type != type) {
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, (string("Method ") + method + " called on incompatible receiver %.*s").c_str(), thiz);
+        return nullptr;
+    }
+
+    auto obj = ctx->runtime->getObject(thiz);
+    if (type == JDT_MAP || type == JDT_SET) {
+        return &((JsMap *)obj)->table;
+    }
+    return &((JsWeakMap *)obj)->table;
+}
+
+/**
+ * 同 getMapTable(), 用于之后会写入新值的情况: 老年代的对象需要加入 remembered set.
+ */
+static JsMapTable *getMapTableToModify(VMContext *ctx, const JsValue &thiz, JsDataType type, cstr_t method) {
+    auto table = getMapTable(ctx, thiz, type, method);
+    if (table) {
+        ctx->runtime->writeBarrier(ctx->runtime->getObject(thiz));
+    }
+    return table;
+}
+
+/**
+ * 遍历构造函数的参数 iterable, 对每一项调用 callback. undefined 和 null 不需要遍历.
+ */
+template<typename Callback>
+bool forEachOfIterable(VMContext *ctx, const JsValue &iterable, Callback callback) {
+    if (iterable.type <= JDT_NULL) {
+        return true;
+    }
+
+    auto runtime = ctx->runtime;
+    IJsIteratorPtr it;
+    if (iterable.type == JDT_CHAR || iterable.type == JDT_STRING) {
+        it.reset(newJsStringIterator(ctx, iterable, false));
+    } else if (iterable.type >= JDT_OBJECT && runtime->getObject(iterable)->isOfIterable()) {
+        it.reset(runtime->getObject(iterable)->getIteratorObject(ctx, false));
+    } else {
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "%.*s is not iterable (cannot read property Symbol(Symbol.iterator))", iterable);
+        return false;
+    }
+
+    JsValue item;
+    while (it->nextOf(item)) {
+        if (!callback(item) || ctx->error != JE_OK) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// 将 iterable 中的 [key, value] 添加到 Map/WeakMap 中
+static bool addEntriesOfIterable(VMContext *ctx, IJsObject *obj, JsMapTable *table, const JsValue &iterable, bool isWeak) {
+    auto runtime = ctx->runtime;
+
+    return forEachOfIterable(ctx, iterable, [ctx, runtime, obj, table, isWeak](const JsValue &item) {
+        if (item.type < JDT_OBJECT) {
+            ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "Iterator value %.*s is not an entry object", item);
+            return false;
+        }
+
+        auto entry = runtime->getObject(item);
+        auto key = entry->getByIndex(ctx, item, 0);
+        if (isWeak && key.type < JDT_OBJECT) {
+            ctx->throwException(JE_TYPE_ERROR, "Invalid value used as weak map key");
+            return false;
+        }
+
+        auto value = entry->getByIndex(ctx, item, 1);
+        // 遍历时可能发生 GC, obj 已经进入了老年代
+        runtime->writeBarrier(obj);
+        table->set(runtime, key, value);
+        return true;
+    });
+}
+
+// 将 iterable 中的值添加到 Set/WeakSet 中
+static bool addValuesOfIterable(VMContext *ctx, IJsObject *obj, JsMapTable *table, const JsValue &iterable, bool isWeak) {
+    auto runtime = ctx->runtime;
+
+    return forEachOfIterable(ctx, iterable, [ctx, runtime, obj, table, isWeak](const JsValue &item) {
+        if (isWeak && item.type < JDT_OBJECT) {
+            ctx->throwException(JE_TYPE_ERROR, "Invalid value used in weak set");
+            return false;
+        }
+
+        runtime->writeBarrier(obj);
+        table->set(runtime, item, jsValueUndefined);
+        return true;
+    });
+}
+
+/**
+ * Map.prototype.forEach 和 Set.prototype.forEach.
+ * 遍历过程中可以添加和删除 entry: 新添加的 entry 也会被遍历到，已经删除的则不会.
+ */
+static void mapForEach(VMContext *ctx, const JsValue &thiz, const Arguments &args, JsDataType type, cstr_t method) {
+    auto table = getMapTable(ctx, thiz, type, method);
+    if (!table) {
+        return;
+    }
+
+    auto callback = args.getAt(0);
+    if (!callback.isFunction()) {
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "%.*s is not a function", callback);
+        return;
+    }
+
+    auto thisArg = args.getAt(1, jsValueGlobalThis);
+    auto isSet = type == JDT_SET;
+
+    JsMapCursor cursor(table);
+    VMRepeatedCall call(ctx, callback);
+    while (cursor.table) {
+        auto entry = table->next(cursor);
+        if (!entry) {
+            break;
+        }
+
+        // 调用过程中 entry 可能会被修改，先复制
+        auto key = entry->key;
+        ArgumentsX callArgs(isSet ? key : entry->value, key, thiz);
+        call.call(thisArg, callArgs);
+        if (ctx->error != JE_OK) {
+            return;
+        }
+    }
+
+    ctx->retValue = jsValueUndefined;
+}
+
+static void newMapIterator(VMContext *ctx, const JsValue &thiz, JsDataType type, JsMapIteratorKind kind, cstr_t method) {
+    if (!getMapTable(ctx, thiz, type, method)) {
+        return;
+    }
+
+    auto runtime = ctx->runtime;
+    auto map = (JsMap *)runtime->getObject(thiz);
+    ctx->retValue = runtime->pushObject(map->newIterator(ctx, kind));
+}
+
+//
+// Map
+//
+
+void mapConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    if (thiz.isValid()) {
+        ctx->throwException(JE_TYPE_ERROR, "Constructor Map requires 'new'");
+        return;
+    }
+
+    auto runtime = ctx->runtime;
+    auto obj = new JsMap(JDT_MAP);
+    auto ret = runtime->pushObject(obj);
+    runtime->addTempValue(ret);
+
+    if (addEntriesOfIterable(ctx, obj, &obj->table, args.getAt(0), false)) {
+        ctx->retValue = ret;
+    }
+}
+
+void map_prototype_clear(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_MAP, "Map.prototype.clear");
+    if (table) {
+        table->clear();
+        ctx->retValue = jsValueUndefined;
+    }
+}
+
+void map_prototype_delete(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_MAP, "Map.prototype.delete");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->remove(ctx->runtime, args.getAt(0)));
+    }
+}
+
+void map_prototype_entries(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    newMapIterator(ctx, thiz, JDT_MAP, MIK_ENTRIES, "Map.prototype.entries");
+}
+
+void map_prototype_forEach(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    mapForEach(ctx, thiz, args, JDT_MAP, "Map.prototype.forEach");
+}
+
+void map_prototype_get(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_MAP, "Map.prototype.get");
+    if (table) {
+        auto entry = table->find(ctx->runtime, args.getAt(0));
+        ctx->retValue = entry ? entry->value : jsValueUndefined;
+    }
+}
+
+void map_prototype_has(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_MAP, "Map.prototype.has");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->find(ctx->runtime, args.getAt(0)) != nullptr);
+    }
+}
+
+void map_prototype_keys(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    newMapIterator(ctx, thiz, JDT_MAP, MIK_KEYS, "Map.prototype.keys");
+}
+
+void map_prototype_set(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTableToModify(ctx, thiz, JDT_MAP, "Map.prototype.set");
+    if (table) {
+        table->set(ctx->runtime, args.getAt(0), args.getAt(1));
+        ctx->retValue = thiz;
+    }
+}
+
+void map_prototype_values(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    newMapIterator(ctx, thiz, JDT_MAP, MIK_VALUES, "Map.prototype.values");
+}
+
+static JsLibProperty mapFunctions[] = {
+    { "name", nullptr, "Map" },
+    { "length", nullptr, nullptr, jsValueLength0Property },
+    { "prototype", nullptr, nullptr, jsValuePropertyPrototype },
+};
+
+static JsLibProperty mapPrototypeFunctions[] = {
+    { "clear", map_prototype_clear },
+    { "delete", map_prototype_delete },
+    { "entries", map_prototype_entries },
+    { "forEach", map_prototype_forEach },
+    { "get", map_prototype_get },
+    { "has", map_prototype_has },
+    { "keys", map_prototype_keys },
+    { "set", map_prototype_set },
+    { "values", map_prototype_values },
+};
+
+//
+// Set
+//
+
+void setConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    if (thiz.isValid()) {
+        ctx->throwException(JE_TYPE_ERROR, "Constructor Set requires 'new'");
+        return;
+    }
+
+    auto runtime = ctx->runtime;
+    auto obj = new JsMap(JDT_SET);
+    auto ret = runtime->pushObject(obj);
+    runtime->addTempValue(ret);
+
+    if (addValuesOfIterable(ctx, obj, &obj->table, args.getAt(0), false)) {
+        ctx->retValue = ret;
+    }
+}
+
+void set_prototype_add(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTableToModify(ctx, thiz, JDT_SET, "Set.prototype.add");
+    if (table) {
+        table->set(ctx->runtime, args.getAt(0), jsValueUndefined);
+        ctx->retValue = thiz;
+    }
+}
+
+void set_prototype_clear(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_SET, "Set.prototype.clear");
+    if (table) {
+        table->clear();
+        ctx->retValue = jsValueUndefined;
+    }
+}
+
+void set_prototype_delete(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_SET, "Set.prototype.delete");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->remove(ctx->runtime, args.getAt(0)));
+    }
+}
+
+void set_prototype_entries(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    newMapIterator(ctx, thiz, JDT_SET, MIK_ENTRIES, "Set.prototype.entries");
+}
+
+void set_prototype_forEach(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    mapForEach(ctx, thiz, args, JDT_SET, "Set.prototype.forEach");
+}
+
+void set_prototype_has(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_SET, "Set.prototype.has");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->find(ctx->runtime, args.getAt(0)) != nullptr);
+    }
+}
+
+void set_prototype_values(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    newMapIterator(ctx, thiz, JDT_SET, MIK_VALUES, "Set.prototype.values");
+}
+
+static JsLibProperty setFunctions[] = {
+    { "name", nullptr, "Set" },
+    { "length", nullptr, nullptr, jsValueLength0Property },
+    { "prototype", nullptr, nullptr, jsValuePropertyPrototype },
+};
+
+static JsLibProperty setPrototypeFunctions[] = {
+    { "add", set_prototype_add },
+    { "clear", set_prototype_clear },
+    { "delete", set_prototype_delete },
+    { "entries", set_prototype_entries },
+    { "forEach", set_prototype_forEach },
+    { "has", set_prototype_has },
+    { "keys", set_prototype_values },
+    { "values", set_prototype_values },
+};
+
+//
+// WeakMap
+//
+
+void weakMapConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    if (thiz.isValid()) {
+        ctx->throwException(JE_TYPE_ERROR, "Constructor WeakMap requires 'new'");
+        return;
+    }
+
+    auto runtime = ctx->runtime;
+    auto obj = new JsWeakMap(JDT_WEAK_MAP);
+    auto ret = runtime->pushObject(obj);
+    runtime->addTempValue(ret);
+
+    if (addEntriesOfIterable(ctx, obj, &obj->table, args.getAt(0), true)) {
+        ctx->retValue = ret;
+    }
+}
+
+void weak_map_prototype_delete(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_WEAK_MAP, "WeakMap.prototype.delete");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->remove(ctx->runtime, args.getAt(0)));
+    }
+}
+
+void weak_map_prototype_get(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_WEAK_MAP, "WeakMap.prototype.get");
+    if (table) {
+        auto entry = table->find(ctx->runtime, args.getAt(0));
+        ctx->retValue = entry ? entry->value : jsValueUndefined;
+    }
+}
+
+void weak_map_prototype_has(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_WEAK_MAP, "WeakMap.prototype.has");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->find(ctx->runtime, args.getAt(0)) != nullptr);
+    }
+}
+
+void weak_map_prototype_set(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTableToModify(ctx, thiz, JDT_WEAK_MAP, "WeakMap.prototype.set");
+    if (table) {
+        auto key = args.getAt(0);
+        if (key.type < JDT_OBJECT) {
+            ctx->throwException(JE_TYPE_ERROR, "Invalid value used as weak map key");
+            return;
+        }
+
+        table->set(ctx->runtime, key, args.getAt(1));
+        ctx->retValue = thiz;
+    }
+}
+
+static JsLibProperty weakMapFunctions[] = {
+    { "name", nullptr, "WeakMap" },
+    { "length", nullptr, nullptr, jsValueLength0Property },
+    { "prototype", nullptr, nullptr, jsValuePropertyPrototype },
+};
+
+static JsLibProperty weakMapPrototypeFunctions[] = {
+    { "delete", weak_map_prototype_delete },
+    { "get", weak_map_prototype_get },
+    { "has", weak_map_prototype_has },
+    { "set", weak_map_prototype_set },
+};
+
+//
+// WeakSet
+//
+
+void weakSetConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    if (thiz.isValid()) {
+        ctx->throwException(JE_TYPE_ERROR, "Constructor WeakSet requires 'new'");
+        return;
+    }
+
+    auto runtime = ctx->runtime;
+    auto obj = new JsWeakMap(JDT_WEAK_SET);
+    auto ret = runtime->pushObject(obj);
+    runtime->addTempValue(ret);
+
+    if (addValuesOfIterable(ctx, obj, &obj->table, args.getAt(0), true)) {
+        ctx->retValue = ret;
+    }
+}
+
+void weak_set_prototype_add(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTableToModify(ctx, thiz, JDT_WEAK_SET, "WeakSet.prototype.add");
+    if (table) {
+        auto value = args.getAt(0);
+        if (value.type < JDT_OBJECT) {
+            ctx->throwException(JE_TYPE_ERROR, "Invalid value used in weak set");
+            return;
+        }
+
+        table->set(ctx->runtime, value, jsValueUndefined);
+        ctx->retValue = thiz;
+    }
+}
+
+void weak_set_prototype_delete(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_WEAK_SET, "WeakSet.prototype.delete");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->remove(ctx->runtime, args.getAt(0)));
+    }
+}
+
+void weak_set_prototype_has(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto table = getMapTable(ctx, thiz, JDT_WEAK_SET, "WeakSet.prototype.has");
+    if (table) {
+        ctx->retValue = makeJsValueBool(table->find(ctx->runtime, args.getAt(0)) != nullptr);
+    }
+}
+
+static JsLibProperty weakSetFunctions[] = {
+    { "name", nullptr, "WeakSet" },
+    { "length", nullptr, nullptr, jsValueLength0Property },
+    { "prototype", nullptr, nullptr, jsValuePropertyPrototype },
+};
+
+static JsLibProperty weakSetPrototypeFunctions[] = {
+    { "add", weak_set_prototype_add },
+    { "delete", weak_set_prototype_delete },
+    { "has", weak_set_prototype_has },
+};
+
+void registerMapSet(VMRuntimeCommon *rt) {
+    auto prototypeObj = new JsLibObject(rt, mapPrototypeFunctions, CountOf(mapPrototypeFunctions));
+    jsValuePrototypeMap = rt->pushObject(prototypeObj);
+    SET_PROTOTYPE(mapFunctions, jsValuePrototypeMap);
+    setGlobalLibObject("Map", rt, mapFunctions, CountOf(mapFunctions), mapConstructor, jsValuePrototypeFunction);
+
+    prototypeObj = new JsLibObject(rt, setPrototypeFunctions, CountOf(setPrototypeFunctions));
+    jsValuePrototypeSet = rt->pushObject(prototypeObj);
+    SET_PROTOTYPE(setFunctions, jsValuePrototypeSet);
+    setGlobalLibObject("Set", rt, setFunctions, CountOf(setFunctions), setConstructor, jsValuePrototypeFunction);
+
+    prototypeObj = new JsLibObject(rt, weakMapPrototypeFunctions, CountOf(weakMapPrototypeFunctions));
+    jsValuePrototypeWeakMap = rt->pushObject(prototypeObj);
+    SET_PROTOTYPE(weakMapFunctions, jsValuePrototypeWeakMap);
+    setGlobalLibObject("WeakMap", rt, weakMapFunctions, CountOf(weakMapFunctions), weakMapConstructor, jsValuePrototypeFunction);
+
+    prototypeObj = new JsLibObject(rt, weakSetPrototypeFunctions, CountOf(weakSetPrototypeFunctions));
+    jsValuePrototypeWeakSet = rt->pushObject(prototypeObj);
+    SET_PROTOTYPE(weakSetFunctions, jsValuePrototypeWeakSet);
+    setGlobalLibObject("WeakSet", rt, weakSetFunctions, CountOf(weakSetFunctions), weakSetConstructor, jsValuePrototypeFunction);
+}
@@ -6,6 +6,7 @@
 //
 
 #include <math.h>
+#include <random>
 #include "BuiltIn.hpp"
 #include "objects/JsObjectFunction.hpp"
 #include "objects/JsArray.hpp"
@@ -268,7 +269,9 @@ void math_pow(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
 }
 
 void math_random(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
-    double r = rand() / (double)RAND_MAX;
+    // 每个线程使用独立的随机数生成器，多个 VMRuntime 在不同的线程中执行时不需要加锁
+    static thread_local std::mt19937_64 generator(std::random_device{}());
+    double r = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
     ctx->retValue = ctx->runtime->pushDouble(r);
 }
 
@@ -83,7 +83,7 @@ void numberParseFloat(VMContext *ctx, const JsValue &thiz, const Arguments &args
                 ctx->retValue = jsValueNaN;
             }
         } else if (v.type == JDT_STRING) {
-            auto str = ctx->runtime->getString(v).utf8Str().trimStart(stringViewBlanks);
+            auto str = ctx->runtime->getString(v).utf8Str().trimStart();
             double d = NAN;
             bool negative = false;
 
@@ -210,7 +210,7 @@ void numberParseInt(VMContext *ctx, const JsValue &thiz, const Arguments &args)
     auto v = args.getAt(0);
     auto base = args.getIntAt(ctx, 1, -1);
 
-    auto str = runtime->toStringViewStrictly(ctx, v).trimStart(stringViewBlanks);
+    auto str = runtime->toStringViewStrictly(ctx, v).trimStart();
 
     double d = parseInt(str.data, str.data + str.len, base);
     int32_t n = (int32_t)d;
@@ -52,6 +52,11 @@ StringView objectPrototypeToStringView(const JsValue &thiz) {
         case JDT_REGEX: return MAKE_STABLE_STR("[object RegExp]");
         case JDT_DATE: return MAKE_STABLE_STR("[object Date]");
         case JDT_PROMISE: return MAKE_STABLE_STR("[object Promise]");
+        case JDT_MAP: return MAKE_STABLE_STR("[object Map]");
+        case JDT_SET: return MAKE_STABLE_STR("[object Set]");
+        case JDT_WEAK_MAP: return MAKE_STABLE_STR("[object WeakMap]");
+        case JDT_WEAK_SET: return MAKE_STABLE_STR("[object WeakSet]");
+        case JDT_GENERATOR: return MAKE_STABLE_STR("[object Generator]");
         case JDT_ARGUMENTS: return MAKE_STABLE_STR("[object Arguments]");
         case JDT_OBJ_X: return MAKE_STABLE_STR("[object Object]");
         case JDT_OBJ_BOOL: return MAKE_STABLE_STR("[object Boolean]");
@@ -185,9 +190,11 @@ void objectDefineProperty(VMContext *ctx, const JsValue &thiz, const Arguments &
             }
         }
 
-        changeFlag(runtime, configurable, JP_CONFIGURABLE, newProp.propFlags);
-        changeFlag(runtime, enumerable, JP_ENUMERABLE, newProp.propFlags);
-        changeFlag(runtime, writable, JP_WRITABLE, newProp.propFlags);
+        JsPropertyFlags flags = newProp.propFlags;
+        changeFlag(runtime, configurable, JP_CONFIGURABLE, flags);
+        changeFlag(runtime, enumerable, JP_ENUMERABLE, flags);
+        changeFlag(runtime, writable, JP_WRITABLE, flags);
+        newProp.setProperty(flags);
 
         if (prop->isConfigurable()) {
             pObj->setProperty(ctx, name, newProp);
@@ -613,7 +620,7 @@ void objectIs(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
     JsValue right = args.getAt(1);
 
     if (left.type == JDT_NUMBER && right.type == JDT_NUMBER) {
-        if (left.value.index == right.value.index) {
+        if (left.equalValue(right)) {
             ctx->retValue = jsValueTrue;
         } else {
             auto a = ctx->runtime->getDouble(left);
@@ -621,7 +628,7 @@ void objectIs(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
             if (isnan(a) && isnan(b)) {
                 ctx->retValue = jsValueTrue;
             } else {
-                ctx->retValue = makeJsValueBool(a == b);
+                ctx->retValue = makeJsValueBool(a == b && signbit(a) == signbit(b));
             }
         }
     } else {
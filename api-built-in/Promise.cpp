@@ -9,6 +9,8 @@
 #include "objects/JsPrimaryObject.hpp"
 #include "objects/JsObjectFunction.hpp"
 #include "objects/JsPromiseObject.hpp"
+#include "objects/JsArray.hpp"
+#include "strings/JsString.hpp"
 
 
 class JsPromiseObject;
@@ -16,6 +18,8 @@ class JsPromiseObject;
 JsValue jsValuePrototypePromise;
 JsValue jsFuncPromiseFulfill, jsFuncPromiseRejector;
 
+using IJsIteratorPtr = std::shared_ptr<IJsIterator>;
+
 
 void promise_fulfilledCallback(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
     assert(thiz.type == JDT_PROMISE);
@@ -70,24 +74,72 @@ void promiseConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &ar
     ctx->retValue = ret;
 }
 
+void promise_resolve(VMContext *ctx, const JsValue &thiz, const Arguments &args);
+
+/**
+ * Promise.all, allSettled, any 和 race 的公共部分: 遍历 iterable，将每一项关联到返回的 promise.
+ * 参数不是 iterable 时返回 rejected 的 promise.
+ */
+static void promiseCombine(VMContext *ctx, const Arguments &args, JsPromiseObject::Combinator combinator) {
+    auto runtime = ctx->runtime;
+
+    auto result = new JsPromiseObject(ctx);
+    auto ret = runtime->pushObject(result);
+    runtime->addTempValue(ret);
+
+    auto iterable = args.getAt(0);
+    IJsIteratorPtr it;
+    if (iterable.isString()) {
+        it.reset(newJsStringIterator(ctx, iterable, false));
+    } else if (iterable.type >= JDT_OBJECT && runtime->getObject(iterable)->isOfIterable()) {
+        it.reset(runtime->getObject(iterable)->getIteratorObject(ctx, false));
+    } else {
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "%.*s is not iterable (cannot read property Symbol(Symbol.iterator))", iterable);
+        ctx->error = JE_OK;
+        result->changeStatus(JsPromiseObject::REJECTED, ctx->errorMessage);
+        ctx->retValue = ret;
+        return;
+    }
+
+    auto values = runtime->pushObject(new JsArray());
+    result->beginCombine(combinator, values);
+
+    JsValue item;
+    while (it->nextOf(item)) {
+        if (item.type == JDT_OBJECT) {
+            // thenable 转换为 promise
+            promise_resolve(ctx, jsValueUndefined, ArgumentsX(item));
+            if (ctx->error != JE_OK) {
+                return;
+            }
+            item = ctx->retValue;
+        }
+
+        if (item.type == JDT_PROMISE) {
+            result->addToCombine((JsPromiseObject *)runtime->getObject(item));
+        } else {
+            result->addValueToCombine(item);
+        }
+    }
+
+    result->endCombine();
+    ctx->retValue = ret;
+}
+
 void promise_all(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
-    assert(0);
-    ctx->retValue = jsValueUndefined;
+    promiseCombine(ctx, args, JsPromiseObject::COMBINE_ALL);
 }
 
 void promise_allSettled(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
-    assert(0);
-    ctx->retValue = jsValueUndefined;
+    promiseCombine(ctx, args, JsPromiseObject::COMBINE_ALL_SETTLED);
 }
 
 void promise_any(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
-    assert(0);
-    ctx->retValue = jsValueUndefined;
+    promiseCombine(ctx, args, JsPromiseObject::COMBINE_ANY);
 }
 
 void promise_race(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
-    assert(0);
-    ctx->retValue = jsValueUndefined;
+    promiseCombine(ctx, args, JsPromiseObject::COMBINE_RACE);
 }
 
 void promise_reject(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
@@ -41,8 +41,15 @@ void regExpConstructor(VMContext *ctx, const JsValue &thiz, const Arguments &arg
         ctx->throwExceptionFormatJsValue(JE_SYNTAX_ERROR, "Invalid flags supplied to RegExp constructor '%.*s'", flagsVal);
         return;
     }
-    std::regex re((cstr_t)strRe.data, strRe.len, (std::regex::flag_type)flags);
-    auto reObj = new JsRegExp(StringView(all), re, flags);
+
+    string error;
+    auto program = JsRegExpProgram::compileCached(strRe, flags, error);
+    if (!program) {
+        ctx->throwException(JE_SYNTAX_ERROR, "Invalid regular expression: %s: %s", all.c_str(), error.c_str());
+        return;
+    }
+
+    auto reObj = new JsRegExp(StringView(all), program);
 
     ctx->retValue = runtime->pushObject(reObj);
 }
@@ -53,95 +60,140 @@ static JsLibProperty regExpFunctions[] = {
     { "prototype", nullptr, nullptr, jsValuePropertyPrototype },
 };
 
+JsValue newRegExpGroups(VMContext *ctx, const JsRegExpProgram &program, const StringView &str, const JsRegExpMatch &match) {
+    if (!program.hasNamedGroups()) {
+        return jsValueUndefined;
+    }
 
-void regexp_exec(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
     auto runtime = ctx->runtime;
-    if (thiz.type != JDT_REGEX) {
-        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "Method RegExp.prototype.exec called on incompatible receiver %.*s", thiz);
-        return;
+    auto obj = new JsObject();
+    auto ret = runtime->pushObject(obj);
+
+    for (uint32_t i = 1; i < match.countGroups(); i++) {
+        auto &name = program.groupName(i);
+        if (!name.empty()) {
+            auto value = match.isMatched(i) ? runtime->pushString(match.group(str, i)) : jsValueUndefined;
+            obj->setByName(ctx, ret, StringView(name), value);
+        }
     }
 
-    auto strVal = runtime->toString(ctx, args.getAt(0));
-    auto strU16 = runtime->getString(strVal);
+    return ret;
+}
+
+JsValue newRegExpExecResult(VMContext *ctx, const JsRegExpProgram &program, const StringView &str, const JsValue &strVal, const JsRegExpMatch &match, uint32_t index) {
+    auto runtime = ctx->runtime;
+    auto arr = new JsArray();
+    auto ret = runtime->pushObject(arr);
+
+    for (uint32_t i = 0; i < match.countGroups(); i++) {
+        arr->push(ctx, match.isMatched(i) ? runtime->pushString(match.group(str, i)) : jsValueUndefined);
+    }
+
+    arr->setByName(ctx, ret, SS_INDEX, makeJsValueInt32(index));
+    arr->setByName(ctx, ret, SS_GROUPS, newRegExpGroups(ctx, program, str, match));
+    arr->setByName(ctx, ret, SS_INPUT, strVal);
+
+    return ret;
+}
+
+/**
+ * RegExp.prototype.exec 的匹配部分: global 或 sticky 时从 lastIndex 开始匹配，并更新 lastIndex.
+ * 返回是否匹配，indexOut 为匹配开始的 utf-16 位置.
+ */
+static bool regExpBuiltinExec(VMContext *ctx, const JsValue &thiz, const StringViewUtf16 &strU16, JsRegExpMatch &match, uint32_t &indexOut) {
+    auto runtime = ctx->runtime;
     auto regexp = (JsRegExp *)runtime->getObject(thiz);
-    auto &re = regexp->getRegexp();
-    auto flags = regexp->flags();
-    int lastIndex = 0;
-    StringView str = strU16.utf8Str();
-
-    if (flags & RF_GLOBAL_SEARCH) {
-        lastIndex = regexp->getByName(ctx, thiz, SS_LASTINDEX).value.n32;
-        if (lastIndex < strU16.size()) {
-            auto p = utf8ToUtf16Seek(str.data, str.len, lastIndex);
-            str.len -= p - str.data;
-            str.data = p;
+    auto &program = regexp->program();
+    auto &str = strU16.utf8Str();
+    bool isGlobalOrSticky = (program.flags() & (RF_GLOBAL_SEARCH | RF_STICKY)) != 0;
+    uint32_t lastIndex = 0, start = 0;
+
+    if (isGlobalOrSticky) {
+        auto value = regexp->getByName(ctx, thiz, SS_LASTINDEX);
+        if (value.type == JDT_INT32) {
+            lastIndex = (uint32_t)max(value.value.n32, (int32_t)0);
         } else {
-            str.len = 0;
+            auto n = runtime->toNumber(ctx, value);
+            lastIndex = n > 0 ? (uint32_t)min(n, (double)MAX_INT32) : 0;
         }
-    }
 
-    std::cmatch matches;
-    if (std::regex_search((cstr_t)str.data, (cstr_t)str.data + str.len, matches, re)) {
-        auto arr = new JsArray();
-        auto ret = runtime->pushObject(arr);
-
-        for (auto &m : matches) {
-            arr->push(ctx, runtime->pushString(str.substr(m.first, m.second)));
+        if (lastIndex > strU16.size()) {
+            regexp->setLastIndex(0);
+            return false;
         }
+        start = strU16.isAnsi() ? lastIndex : (uint32_t)(utf8ToUtf16Seek(str.data, str.len, lastIndex) - str.data);
+    }
 
-        auto index = utf8ToUtf16Length(str.data, (uint32_t)(matches[0].first - (cstr_t)str.data));
-        lastIndex += index;
-        arr->setByName(ctx, ret, SS_INDEX, makeJsValueInt32(lastIndex));
-        arr->setByName(ctx, ret, SS_GROUPS, jsValueUndefined);
-        arr->setByName(ctx, ret, SS_INPUT, strVal);
-        regexp->setLastIndex(lastIndex + utf8ToUtf16Length((uint8_t *)matches[0].first,
-                                                           (uint32_t)(matches[0].second - matches[0].first)));
+    if (!program.exec(str, start, match)) {
+        if (isGlobalOrSticky) {
+            regexp->setLastIndex(0);
+        }
+        return false;
+    }
 
-        ctx->retValue = ret;
+    if (strU16.isAnsi()) {
+        indexOut = match.begin();
     } else {
-        regexp->setLastIndex(0);
+        indexOut = lastIndex + utf8ToUtf16Length(str.data + start, match.begin() - start);
+    }
 
-        ctx->retValue = jsValueNull;
+    if (isGlobalOrSticky) {
+        regexp->setLastIndex(indexOut + utf8ToUtf16Length(str.data + match.begin(), match.end() - match.begin()));
     }
+
+    return true;
 }
 
-void regexp_test(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+// strVal 为 toString 之后的值, JDT_CHAR 等会转换到 buf 中
+static StringViewUtf16 toStringViewUtf16(VMContext *ctx, const JsValue &strVal, LockedStringViewWrapper &buf) {
+    if (strVal.type == JDT_STRING) {
+        return ctx->runtime->getString(strVal);
+    }
+
+    buf = ctx->runtime->toStringView(ctx, strVal);
+    return StringViewUtf16(buf);
+}
+
+JsValue regExpExec(VMContext *ctx, const JsValue &thiz, const JsValue &strVal) {
+    auto runtime = ctx->runtime;
+    LockedStringViewWrapper buf;
+    auto strU16 = toStringViewUtf16(ctx, strVal, buf);
+    JsRegExpMatch match;
+    uint32_t index;
+
+    if (!regExpBuiltinExec(ctx, thiz, strU16, match, index)) {
+        return jsValueNull;
+    }
+
+    auto regexp = (JsRegExp *)runtime->getObject(thiz);
+    return newRegExpExecResult(ctx, regexp->program(), strU16.utf8Str(), strVal, match, index);
+}
+
+void regexp_exec(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
     auto runtime = ctx->runtime;
     if (thiz.type != JDT_REGEX) {
-        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "Method RegExp.prototype.test called on incompatible receiver %.*s", thiz);
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "Method RegExp.prototype.exec called on incompatible receiver %.*s", thiz);
         return;
     }
 
     auto strVal = runtime->toString(ctx, args.getAt(0));
-    auto strU16 = runtime->getString(strVal);
-    auto regexp = (JsRegExp *)runtime->getObject(thiz);
-    auto &re = regexp->getRegexp();
-    auto flags = regexp->flags();
-    int lastIndex = 0;
-    StringView str = strU16.utf8Str();
-
-    if (flags & RF_GLOBAL_SEARCH) {
-        lastIndex = regexp->getByName(ctx, thiz, SS_LASTINDEX).value.n32;
-        if (lastIndex < strU16.size()) {
-            auto p = utf8ToUtf16Seek(str.data, str.len, lastIndex);
-            str.len -= p - str.data;
-            str.data = p;
-        } else {
-            str.len = 0;
-        }
-    }
+    ctx->retValue = regExpExec(ctx, thiz, strVal);
+}
 
-    std::cmatch matches;
-    if (std::regex_search((cstr_t)str.data, (cstr_t)str.data + str.len, matches, re)) {
-        regexp->setLastIndex(lastIndex + utf8ToUtf16Length(str.data,
-                                                           (uint32_t)(matches[0].second - (char *)str.data)));
+void regexp_test(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    auto runtime = ctx->runtime;
+    if (thiz.type != JDT_REGEX) {
+        ctx->throwExceptionFormatJsValue(JE_TYPE_ERROR, "Method RegExp.prototype.test called on incompatible receiver %.*s", thiz);
+        return;
+    }
 
-        ctx->retValue = jsValueTrue;
-    } else {
-        regexp->setLastIndex(0);
+    auto strVal = runtime->toString(ctx, args.getAt(0));
+    LockedStringViewWrapper buf;
+    auto strU16 = toStringViewUtf16(ctx, strVal, buf);
+    JsRegExpMatch match;
+    uint32_t index;
 
-        ctx->retValue = jsValueFalse;
-    }
+    ctx->retValue = makeJsValueBool(regExpBuiltinExec(ctx, thiz, strU16, match, index));
 }
 
 void regExpPrototypeToString(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
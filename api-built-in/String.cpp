@@ -297,7 +297,7 @@ void stringPrototypeIndexOf(VMContext *ctx, const JsValue &thiz, const Arguments
         tmp.append(strVal);
         s.set(tmp);
     } else {
-        s = runtime->getString(strVal);
+        s = index > 0 ? runtime->getStringWithRandAccess(strVal) : runtime->getString(strVal);
     }
 
     auto pos = s.indexOf(p, index);
@@ -343,38 +343,73 @@ void stringPrototypeLocaleCompare(VMContext *ctx, const JsValue &thiz, const Arg
     ctx->retValue = strVal;
 }
 
-inline JsValue regexMatch(VMContext *ctx, VMRuntime *runtime, std::regex &re, uint32_t flags, const StringView &str, const JsValue &strVal) {
-    JsValue ret = jsValueNull;
+/**
+ * 将递增的 utf-8 偏移转换为 utf-16 的位置，每次只计算新增的部分.
+ */
+class Utf16PosCursor {
+public:
+    Utf16PosCursor(const StringView &str) : _str(str), _offset(0), _pos(0) { }
 
-    if (flags & RegexpFlags::RF_GLOBAL_SEARCH) {
-        auto begin = std::cregex_iterator((cstr_t)str.data, (cstr_t)str.data + str.len, re);
-        auto end = std::cregex_iterator();
-        if (begin == end) {
-            return jsValueNull;
-        }
+    uint32_t toUtf16(uint32_t offset) {
+        assert(offset >= _offset);
+        _pos += utf8ToUtf16Length(_str.data + _offset, offset - _offset);
+        _offset = offset;
+        return _pos;
+    }
 
-        auto arr = new JsArray();
-        ret = runtime->pushObject(arr);
+protected:
+    StringView                      _str;
+    uint32_t                        _offset, _pos;
 
-        for (auto it = begin; it != end; ++it) {
-            auto &m = *it;
-            arr->push(ctx, runtime->pushString(str.substr((uint32_t)m.position(), (uint32_t)m.length())));
-        }
-    } else {
-        std::cmatch matches;
-        if (std::regex_search((cstr_t)str.data, (cstr_t)str.data + str.len, matches, re)) {
-            auto arr = new JsArray();
-            ret = runtime->pushObject(arr);
+};
 
-            for (auto &m : matches) {
-                arr->push(ctx, runtime->pushString(str.substr(m.first, m.second)));
-            }
+// 下一次查找的开始位置: 匹配了空字符串时需要前进一个字符
+static uint32_t nextMatchStart(const StringView &str, const JsRegExpMatch &match) {
+    auto pos = match.end();
+    if (pos > match.begin()) {
+        return pos;
+    } else if (pos >= str.len) {
+        return str.len + 1;
+    }
+
+    return pos + utf8FirstByteLength(str.data[pos]);
+}
+
+// 字符串作为正则表达式的 pattern, 编译失败时抛出 SyntaxError
+static JsRegExpProgramPtr compileStringPattern(VMContext *ctx, JsValue pattern, uint32_t flags) {
+    if (pattern.type == JDT_UNDEFINED) {
+        pattern = jsStringValueEmpty;
+    }
+
+    auto strRe = ctx->runtime->toStringViewStrictly(ctx, pattern);
+    if (ctx->error != JE_OK) {
+        return nullptr;
+    }
+
+    string error;
+    auto program = JsRegExpProgram::compileCached(strRe, flags, error);
+    if (!program) {
+        ctx->throwException(JE_SYNTAX_ERROR, "Invalid regular expression: /%.*s/: %s", strRe.len, strRe.data, error.c_str());
+    }
 
-            auto index = utf8ToUtf16Length(str.data, (uint32_t)(matches[0].first - (cstr_t)str.data));
-            arr->setByName(ctx, ret, SS_INDEX, makeJsValueInt32(index));
-            arr->setByName(ctx, ret, SS_GROUPS, jsValueUndefined);
-            arr->setByName(ctx, ret, SS_INPUT, strVal);
+    return program;
+}
+
+static JsValue regexMatchGlobal(VMContext *ctx, const JsRegExpProgram &program, const StringView &str) {
+    auto runtime = ctx->runtime;
+    JsValue ret = jsValueNull;
+    JsArray *arr = nullptr;
+    JsRegExpMatch match;
+    uint32_t pos = 0;
+
+    while (pos <= str.len && program.exec(str, pos, match)) {
+        if (!arr) {
+            arr = new JsArray();
+            ret = runtime->pushObject(arr);
         }
+
+        arr->push(ctx, runtime->pushString(match.group(str, 0)));
+        pos = nextMatchStart(str, match);
     }
 
     return ret;
@@ -392,56 +427,45 @@ void stringPrototypeMatch(VMContext *ctx, const JsValue &thiz, const Arguments &
     auto pattern = args.getAt(0, jsStringValueEmpty);
     if (pattern.type == JDT_REGEX) {
         auto regexp = (JsRegExp *)runtime->getObject(pattern);
-        auto &re = regexp->getRegexp();
-        auto flags = regexp->flags();
-
-        ctx->retValue = regexMatch(ctx, runtime, re, flags, str, strVal);
+        if (isFlagSet(regexp->flags(), RF_GLOBAL_SEARCH)) {
+            regexp->setLastIndex(0);
+            ctx->retValue = regexMatchGlobal(ctx, regexp->program(), str);
+        } else {
+            ctx->retValue = regExpExec(ctx, pattern, strVal);
+        }
     } else {
-        if (pattern.type == JDT_UNDEFINED) {
-            pattern = jsStringValueEmpty;
+        auto program = compileStringPattern(ctx, pattern, 0);
+        if (!program) {
+            return;
         }
 
-        auto strRe = runtime->toStringViewStrictly(ctx, pattern);
-        auto flags = std::regex::flag_type::ECMAScript;
-        std::regex re((cstr_t)strRe.data, strRe.len, flags);
-
-        ctx->retValue = regexMatch(ctx, runtime, re, flags, str, strVal);
+        JsRegExpMatch match;
+        if (program->exec(str, 0, match)) {
+            auto index = utf8ToUtf16Length(str.data, match.begin());
+            ctx->retValue = newRegExpExecResult(ctx, *program, str, strVal, match, index);
+        } else {
+            ctx->retValue = jsValueNull;
+        }
     }
 }
 
 class StringMatchAllIterator : public IJsIterator {
 public:
-    StringMatchAllIterator(VMContext *ctx, std::regex &re, uint32_t flags, const StringView &str, const JsValue &strVal) : IJsIterator(false, false), _ctx(ctx), _re(re), _flags(flags), _strBegin((uint8_t *)str.data), _strEnd((uint8_t *)str.data + str.len), _strVal(strVal), _offset(0)
+    StringMatchAllIterator(VMContext *ctx, const JsRegExpProgramPtr &program, const StringView &str, const JsValue &strVal) : IJsIterator(false, false), _ctx(ctx), _program(program), _str(str), _strVal(strVal), _pos(0), _cursor(str)
     {
         _isOfIterable = true;
     }
 
     virtual bool nextOf(JsValue &valueOut) override {
-        auto runtime = _ctx->runtime;
-        std::cmatch matches;
+        JsRegExpMatch match;
 
-        if (std::regex_search((cstr_t)_strBegin, (cstr_t)_strEnd, matches, _re)) {
-            auto arr = new JsArray();
-            auto ret = runtime->pushObject(arr);
-            StringView str(_strBegin, uint32_t(_strEnd - _strBegin));
-
-            for (auto &m : matches) {
-                arr->push(_ctx, runtime->pushString(str.substr(m.first, m.second)));
-            }
-
-            auto m0 = matches[0];
-            _offset += utf8ToUtf16Length(_strBegin, (uint32_t)(m0.first - (cstr_t)_strBegin));
-            arr->setByName(_ctx, ret, SS_INDEX, makeJsValueInt32(_offset));
-            arr->setByName(_ctx, ret, SS_GROUPS, jsValueUndefined);
-            arr->setByName(_ctx, ret, SS_INPUT, _strVal);
-
-            _strBegin = (uint8_t *)m0.second;
-            _offset += utf8ToUtf16Length((uint8_t *)m0.first, (uint32_t)(m0.second - m0.first));
-
-            valueOut = ret;
+        if (_pos <= _str.len && _program->exec(_str, _pos, match)) {
+            valueOut = newRegExpExecResult(_ctx, *_program, _str, _strVal, match, _cursor.toUtf16(match.begin()));
+            _pos = nextMatchStart(_str, match);
             return true;
         }
 
+        _pos = _str.len + 1;
         return false;
     }
 
@@ -457,12 +481,12 @@ public:
 
 protected:
     VMContext                       *_ctx;
-    std::regex                      _re;
-    uint32_t                        _flags;
+    JsRegExpProgramPtr              _program;
 
-    uint32_t                        _offset;
-    uint8_t                         *_strBegin, *_strEnd;
+    StringView                      _str;
     JsValue                         _strVal;
+    uint32_t                        _pos;
+    Utf16PosCursor                  _cursor;
 
 };
 
@@ -478,24 +502,19 @@ void stringPrototypeMatchAll(VMContext *ctx, const JsValue &thiz, const Argument
     auto pattern = args.getAt(0, jsStringValueEmpty);
     if (pattern.type == JDT_REGEX) {
         auto regexp = (JsRegExp *)runtime->getObject(pattern);
-        auto &re = regexp->getRegexp();
-        auto flags = regexp->flags();
-        if (!isFlagSet(flags, RegexpFlags::RF_GLOBAL_SEARCH)) {
+        if (!isFlagSet(regexp->flags(), RegexpFlags::RF_GLOBAL_SEARCH)) {
             ctx->throwException(JE_TYPE_ERROR, "String.prototype.matchAll called with a non-global RegExp argument");
             return;
         }
 
-        ctx->retValue = runtime->pushObject(new StringMatchAllIterator(ctx, re, flags, str, strVal));
+        ctx->retValue = runtime->pushObject(new StringMatchAllIterator(ctx, regexp->programPtr(), str, strVal));
     } else {
-        if (pattern.type == JDT_UNDEFINED) {
-            pattern = jsStringValueEmpty;
+        auto program = compileStringPattern(ctx, pattern, RF_GLOBAL_SEARCH);
+        if (!program) {
+            return;
         }
 
-        auto strRe = runtime->toStringViewStrictly(ctx, pattern);
-        auto flags = std::regex::flag_type::ECMAScript;
-        std::regex re((cstr_t)strRe.data, strRe.len, flags);
-
-        ctx->retValue = runtime->pushObject(new StringMatchAllIterator(ctx, re, flags, str, strVal));
+        ctx->retValue = runtime->pushObject(new StringMatchAllIterator(ctx, program, str, strVal));
     }
 }
 
@@ -643,7 +662,7 @@ void stringPrototypeRepeat(VMContext *ctx, const JsValue &thiz, const Arguments
     }
 }
 
-void doStringReplaceWithFunction(VMContext *ctx, const StringView &str, const JsValue &strVal, uint32_t matchBegin, uint32_t matchEnd, const std::cmatch &matches, const JsValue &replacementFunc, string &out, uint32_t offset) {
+void doStringReplaceWithFunction(VMContext *ctx, const JsRegExpProgram *program, const StringView &str, const JsValue &strVal, const JsRegExpMatch &match, const JsValue &replacementFunc, string &out, uint32_t offset) {
 
     assert(replacementFunc.type == JDT_FUNCTION);
 
@@ -652,12 +671,12 @@ void doStringReplaceWithFunction(VMContext *ctx, const StringView &str, const Js
     // function replacer(match, p1, p2, /* …, */ pN, offset, string, groups)
     VecJsValues argvs;
 
-    for (auto &m : matches) {
-        argvs.push_back(runtime->pushString(str.substr(m.first, m.second)));
+    for (uint32_t i = 0; i < match.countGroups(); i++) {
+        argvs.push_back(match.isMatched(i) ? runtime->pushString(match.group(str, i)) : jsValueUndefined);
     }
     argvs.push_back(makeJsValueInt32(offset));
     argvs.push_back(strVal);
-    argvs.push_back(jsValueUndefined);
+    argvs.push_back(program ? newRegExpGroups(ctx, *program, str, match) : jsValueUndefined);
 
     Arguments args(argvs.data(), (uint32_t)argvs.size());
     ctx->vm->callMember(ctx, jsValueGlobalThis, replacementFunc, args);
@@ -669,9 +688,11 @@ void doStringReplaceWithFunction(VMContext *ctx, const StringView &str, const Js
     out.append((cstr_t)s.data, s.len);
 }
 
-void doStringReplaceWithString(VMContext *ctx, const StringView &str, uint32_t matchBegin, uint32_t matchEnd, const std::cmatch &matches, const StringView &replacement, string &out) {
+void doStringReplaceWithString(const JsRegExpProgram *program, const StringView &str, const JsRegExpMatch &match, const StringView &replacement, string &out) {
 
     auto p = replacement.data, end = p + replacement.len;
+    auto matchBegin = match.begin(), matchEnd = match.end();
+    auto countGroups = match.countGroups();
 
     while (p < end) {
         auto c = *p++;
@@ -681,24 +702,26 @@ void doStringReplaceWithString(VMContext *ctx, const StringView &str, uint32_t m
                 // $n    Inserts the nth (1-indexed) capturing group where n is a positive integer less than 100.
                 auto start = p;
                 uint32_t n = c - '0';
-                while (p < end && isDigit(*p)) {
-                    auto tmp = n * 10 + *p - '0';
-                    if (tmp >= matches.size()) {
-                        break;
-                    }
-                    n = tmp;
+                if (p < end && isDigit(*p) && n * 10 + *p - '0' < countGroups) {
+                    n = n * 10 + *p - '0';
                     p++;
                 }
 
-                if (n > 0 && n < matches.size()) {
-                    auto &m = matches[n];
-                    out.append(m.first, (uint32_t)(m.second - m.first));
+                if (n > 0 && n < countGroups) {
+                    if (match.isMatched(n)) {
+                        out.append((cstr_t)str.data + match.begin(n), match.end(n) - match.begin(n));
+                    }
                 } else {
                     out.append((cstr_t)start - 2, (uint32_t)(2 + p - start));
                 }
-            } else if (c == '<') {
+            } else if (c == '<' && program && program->hasNamedGroups() && memchr(p, '>', end - p)) {
                 // $<Name>    Inserts the named capturing group where Name is the group name.
-                assert(0 && "TBD");
+                auto nameEnd = (cstr_t)memchr(p, '>', end - p);
+                auto n = program->findGroup(StringView(p, nameEnd - p));
+                if (n > 0 && match.isMatched(n)) {
+                    out.append((cstr_t)str.data + match.begin(n), match.end(n) - match.begin(n));
+                }
+                p = (char *)nameEnd + 1;
             } else if (c == '$') {
                 // $$    Inserts a "$".
                 out.append(1, '$');
@@ -734,85 +757,55 @@ public:
         }
     }
 
-    virtual bool search(const StringView &str, uint32_t &matchBegin, uint32_t &matchEnd, std::cmatch &matches) {
+    // 从 utf-8 的位置 start 开始查找
+    bool search(const StringView &str, uint32_t start, JsRegExpMatch &match) {
         if (regexp) {
-            if (std::regex_search((cstr_t)str.data, (cstr_t)str.data + str.len, matches, regexp->getRegexp())) {
-                auto &m0 = matches[0];
-                matchBegin = str.offsetOf(m0.first);
-                matchEnd = str.offsetOf(m0.second);
-                return true;
-            } else {
-                // 找不到
-                return false;
-            }
-        } else {
-            auto pos = str.strstr(pattern);
-            if (pos == -1) {
-                // 找不到
-                return false;
-            } else {
-                matchBegin = pos;
-                matchEnd = pos + pattern.len;
-                return true;
-            }
+            return regexp->program().exec(str, start, match);
+        }
+
+        int pos = pattern.len == 0 ? (int)start : str.strstr(pattern, start);
+        if (pos == -1) {
+            // 找不到
+            return false;
         }
+
+        match.captures.resize(2);
+        match.captures[0] = pos;
+        match.captures[1] = pos + pattern.len;
+        return true;
     }
 
+    const JsRegExpProgram *program() const { return regexp ? &regexp->program() : nullptr; }
+
 public:
     LockedStringViewWrapper    pattern;
     JsRegExp                    *regexp;
 
 };
 
-void stringPrototypeReplace(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
-    auto strVal = convertStringToJsValue(ctx, thiz, "replace");
+static void doStringReplace(VMContext *ctx, const JsValue &thiz, const Arguments &args, const char *funcName, bool isReplaceAll) {
+    auto strVal = convertStringToJsValue(ctx, thiz, funcName);
     if (!strVal.isValid()) {
         return;
     }
 
     auto runtime = ctx->runtime;
-    auto str = runtime->toStringView(ctx, strVal);
-    auto replacementVal = args.getAt(1, jsValueUndefined);
-
     StringSearch pattern(ctx, args.getAt(0));
-    uint32_t matchBegin, matchEnd;
-    std::cmatch matches;
-
-    if (pattern.search(str, matchBegin, matchEnd, matches)) {
-        string ret((cstr_t)str.data, matchBegin);
-
-        if (replacementVal.type == JDT_FUNCTION) {
-            auto offset = utf8ToUtf16Length(str.data, matchBegin);
-            doStringReplaceWithFunction(ctx, str, strVal, matchBegin, matchEnd, matches, replacementVal, ret, offset);
-        } else {
-            auto replacement = runtime->toStringViewStrictly(ctx, replacementVal);
-            if (ctx->error != JE_OK) {
-                return;
-            }
-            doStringReplaceWithString(ctx, str, matchBegin, matchEnd, matches, replacement, ret);
-        }
-
-        ret.append((cstr_t)str.data + matchEnd, str.len - matchEnd);
-        ctx->retValue = runtime->pushString(StringView(ret));
-    } else {
-        // 找不到
-        ctx->retValue = strVal;
-    }
-}
-
-void stringPrototypeReplaceAll(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
-    auto strVal = convertStringToJsValue(ctx, thiz, "replaceAll");
-    if (!strVal.isValid()) {
+    if (ctx->error != JE_OK) {
         return;
     }
 
-    auto runtime = ctx->runtime;
-    StringSearch pattern(ctx, args.getAt(0));
+    // 字符串的 pattern 只有 replaceAll 才替换全部
+    bool isGlobal = isReplaceAll;
     if (pattern.regexp) {
-        if (!isFlagSet(pattern.regexp->flags(), RegexpFlags::RF_GLOBAL_SEARCH)) {
+        isGlobal = isFlagSet(pattern.regexp->flags(), RegexpFlags::RF_GLOBAL_SEARCH);
+        if (isReplaceAll && !isGlobal) {
             ctx->throwException(JE_TYPE_ERROR, "String.prototype.replaceAll called with a non-global RegExp argument");
             return;
         }
+        if (isGlobal) {
+            pattern.regexp->setLastIndex(0);
+        }
     }
 
     auto str = runtime->toStringView(ctx, strVal);
@@ -826,48 +819,48 @@ void stringPrototypeReplaceAll(VMContext *ctx, const JsValue &thiz, const Argume
         }
     }
 
-    uint32_t offset = 0;
+    auto program = pattern.program();
+    Utf16PosCursor cursor(str);
+    JsRegExpMatch match;
+    uint32_t pos = 0, lastEnd = 0;
     bool replaced = false;
-    auto p = str.data, strEnd = str.data + str.len;
     string ret;
 
-    while (p < strEnd) {
-        uint32_t matchBegin, matchEnd;
-        std::cmatch matches;
-        StringView remain = StringView(p, uint32_t(strEnd - p));
+    while (pos <= str.len && pattern.search(str, pos, match)) {
+        ret.append((cstr_t)str.data + lastEnd, match.begin() - lastEnd);
 
-        if (pattern.search(remain, matchBegin, matchEnd, matches)) {
-            ret.append((cstr_t)remain.data, matchBegin);
-
-            if (replacementVal.type == JDT_FUNCTION) {
-                offset += utf8ToUtf16Length(remain.data, matchBegin);
-                doStringReplaceWithFunction(ctx, remain, strVal, matchBegin, matchEnd, matches, replacementVal, ret, offset);
-                offset += utf8ToUtf16Length(remain.data + matchBegin, matchEnd - matchBegin);
-            } else {
-                doStringReplaceWithString(ctx, remain, matchBegin, matchEnd, matches, replacement, ret);
+        if (replacementVal.type == JDT_FUNCTION) {
+            doStringReplaceWithFunction(ctx, program, str, strVal, match, replacementVal, ret, cursor.toUtf16(match.begin()));
+            if (ctx->error != JE_OK) {
+                return;
             }
-            replaced = true;
-            p += matchEnd;
         } else {
+            doStringReplaceWithString(program, str, match, replacement, ret);
+        }
+
+        replaced = true;
+        lastEnd = match.end();
+        if (!isGlobal) {
             break;
         }
+        pos = nextMatchStart(str, match);
     }
 
     if (replaced) {
-        ret.append((cstr_t)p, uint32_t(strEnd - p));
+        ret.append((cstr_t)str.data + lastEnd, str.len - lastEnd);
         ctx->retValue = runtime->pushString(StringView(ret));
     } else {
+        // 找不到
         ctx->retValue = strVal;
     }
 }
 
-inline void regexSearch(VMContext *ctx, std::regex &re, const StringView &str) {
-    std::cmatch matches;
-    if (std::regex_search((cstr_t)str.data, (cstr_t)str.data + str.len, matches, re)) {
-        ctx->retValue = makeJsValueInt32(utf8ToUtf16Length(str.data, (uint32_t)(matches[0].first - (cstr_t)str.data)));
-    } else {
-        ctx->retValue = makeJsValueInt32(-1);
-    }
+void stringPrototypeReplace(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    doStringReplace(ctx, thiz, args, "replace", false);
+}
+
+void stringPrototypeReplaceAll(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
+    doStringReplace(ctx, thiz, args, "replaceAll", true);
 }
 
 void stringPrototypeSearch(VMContext *ctx, const JsValue &thiz, const Arguments &args) {
@@ -879,21 +872,22 @@ void stringPrototypeSearch(VMContext *ctx, const JsValue &thiz, const Arguments
     auto runtime = ctx->runtime;
     auto str = runtime->toStringView(ctx, strVal);
 
+    JsRegExpProgramPtr program;
     auto pattern = args.getAt(0, jsStringValueEmpty);
     if (pattern.type == JDT_REGEX) {
-        auto regexp = (JsRegExp *)runtime->getObject(pattern);
-        auto &re = regexp->getRegexp();
-
-        regexSearch(ctx, re, str);
+        program = ((JsRegExp *)runtime->getObject(pattern))->programPtr();
     } else {
-        if (pattern.type == JDT_UNDEFINED) {
-            pattern = jsStringValueEmpty;
+        program = compileStringPattern(ctx, pattern, 0);
+        if (!program) {
+            return;
         }
+    }
 
-        auto strRe = runtime->toStringViewStrictly(ctx, pattern);
-        std::regex re((cstr_t)strRe.data, strRe.len, std::regex::flag_type::ECMAScript);
-
-        regexSearch(ctx, re, str);
+    JsRegExpMatch match;
+    if (program->exec(str, 0, match)) {
+        ctx->retValue = makeJsValueInt32(utf8ToUtf16Length(str.data, match.begin()));
+    } else {
+        ctx->retValue = makeJsValueInt32(-1);
     }
 }
 
@@ -916,7 +910,8 @@ void stringPrototypeSlice(VMContext *ctx, const JsValue &thiz, const Arguments &
         return;
     }
 
-    auto &str = runtime->getString(strVal);
+    // 非 ansi 字符串会创建 utf-16 的偏移索引，多次 slice 时不需要每次都从头查找
+    auto &str = runtime->getStringWithRandAccess(strVal);
     uint32_t len = str.size();
     if (start < 0) {
         start = max(len + start, (uint32_t)0);
@@ -961,24 +956,47 @@ void stringPrototypeSplit(VMContext *ctx, const JsValue &thiz, const Arguments &
     auto str = runtime->toStringView(ctx, strVal);
 
     if (sep.type == JDT_REGEX) {
-        auto regexp = (JsRegExp *)runtime->getObject(sep);
-        auto &re = regexp->getRegexp();
-
-        for (; limit > 0; --limit) {
-            std::cmatch matches;
-            if (!std::regex_search((cstr_t)str.data, (cstr_t)str.data + str.len, matches, re)) {
-                arrObj->push(ctx, runtime->pushString(str));
-                break;
+        auto &program = ((JsRegExp *)runtime->getObject(sep))->program();
+        JsRegExpMatch match;
+
+        if (str.len == 0) {
+            // 空字符串能被匹配时返回空数组
+            if (!program.exec(str, 0, match)) {
+                arrObj->push(ctx, strVal);
+            }
+            ctx->retValue = arr;
+            return;
+        }
+
+        // p: 上一次分割的结束位置，q: 开始查找的位置
+        uint32_t p = 0, q = 0;
+        int32_t count = 0;
+        while (q < str.len && program.exec(str, q, match) && match.begin() < str.len) {
+            if (match.end() == p) {
+                // 在上一次分割的位置匹配了空字符串
+                q = match.begin() + utf8FirstByteLength(str.data[match.begin()]);
+                continue;
+            }
+
+            arrObj->push(ctx, runtime->pushString(str.substr(p, match.begin() - p)));
+            if (++count >= limit) {
+                ctx->retValue = arr;
+                return;
             }
 
-            auto &m0 = matches[0];
-            auto pos = (uint32_t)(m0.first - (cstr_t)str.data);
-            arrObj->push(ctx, runtime->pushString(str.substr(0, pos)));
+            // 分组也会加入到结果中
+            for (uint32_t i = 1; i < match.countGroups(); i++) {
+                arrObj->push(ctx, match.isMatched(i) ? runtime->pushString(match.group(str, i)) : jsValueUndefined);
+                if (++count >= limit) {
+                    ctx->retValue = arr;
+                    return;
+                }
+            }
 
-            pos = (uint32_t)(m0.second - (cstr_t)str.data);
-            str.data = (char *)m0.second;
-            str.len -= pos;
+            p = q = match.end();
         }
+
+        arrObj->push(ctx, runtime->pushString(str.substr(p, str.len - p)));
     } else {
         auto sepStr = runtime->toStringViewStrictly(ctx, sep);
         if (sepStr.len == 0) {
@@ -1057,7 +1075,7 @@ void stringPrototypeSubstr(VMContext *ctx, const JsValue &thiz, const Arguments
         return;
     }
 
-    auto &str = runtime->getString(strVal);
+    auto &str = runtime->getStringWithRandAccess(strVal);
     if (start < 0) {
         start = max(str.size() + start, (uint32_t)0);
     }
@@ -1098,7 +1116,7 @@ void stringPrototypeSubstring(VMContext *ctx, const JsValue &thiz, const Argumen
         return;
     }
 
-    auto &str = runtime->getString(strVal);
+    auto &str = runtime->getStringWithRandAccess(strVal);
     ctx->retValue = runtime->pushString(str.substr(start, end - start));
 }
 
@@ -1223,7 +1241,7 @@ void stringPrototypeTrimEnd(VMContext *ctx, const JsValue &thiz, const Arguments
 
     auto runtime = ctx->runtime;
     auto &orgStr = runtime->getString(strVal).utf8Str();
-    auto str = orgStr.trimEnd(stringViewBlanks);
+    auto str = orgStr.trimEnd();
     if (str.len != orgStr.len) {
         ctx->retValue = runtime->pushString(str);
     } else {
@@ -1248,7 +1266,7 @@ void stringPrototypeTrimStart(VMContext *ctx, const JsValue &thiz, const Argumen
 
     auto runtime = ctx->runtime;
     auto &orgStr = runtime->getString(strVal).utf8Str();
-    auto str = orgStr.trimStart(stringViewBlanks);
+    auto str = orgStr.trimStart();
     if (str.len != orgStr.len) {
         ctx->retValue = runtime->pushString(str);
     } else {
@@ -1340,7 +1358,7 @@ public:
     }
 
     JsValue *getRawByIndex(VMContext *ctx, uint32_t index, bool includeProtoProp) {
-        static JsValue propIndex;
+        static thread_local JsValue propIndex;
         return &propIndex;
     }
 
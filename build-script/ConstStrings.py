@@ -99,6 +99,15 @@ CONST_STRINGS = [
     [ 'resolve', 'resolve' ],
     [ 'reject', 'reject' ],
     [ 'then', 'then' ],
+    [ 'ToJSON', 'toJSON' ],
+    [ 'Size', 'size' ],
+    [ 'status', 'status' ],
+    [ 'reason', 'reason' ],
+    [ 'errors', 'errors' ],
+    [ 'fulfilled', 'fulfilled' ],
+    [ 'rejected', 'rejected' ],
+    [ 'AllPromisesRejected', 'All promises were rejected' ],
+    [ 'done', 'done' ],
     # [ '', '' ],
 ]
 
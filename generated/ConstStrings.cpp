@@ -0,0 +1,133 @@
+/**
+ * 此文件由 ConstStrings.py 自动创建，请不要手动修改
+ */
+
+#include "interpreter/VMRuntime.hpp"
+
+
+StringView SS_EMPTY = makeCommonString("");
+StringView SS_UNDEFINED = makeCommonString("undefined");
+StringView SS_NULL = makeCommonString("null");
+StringView SS_TRUE = makeCommonString("true");
+StringView SS_FALSE = makeCommonString("false");
+StringView SS_THIS = makeCommonString("this");
+StringView SS_ARGUMENTS = makeCommonString("arguments");
+StringView SS_LENGTH = makeCommonString("length");
+StringView SS_TOSTRING = makeCommonString("toString");
+StringView SS___PROTO__ = makeCommonString("__proto__");
+StringView SS_PROTOTYPE = makeCommonString("prototype");
+StringView SS_FUNCTIONNATIVECODE = makeCommonString("function String() { [native code] }");
+StringView SS_ERROR = makeCommonString("Error");
+StringView SS_MESSAGE = makeCommonString("message");
+StringView SS_STACK = makeCommonString("stack");
+StringView SS_CONFIGURABLE = makeCommonString("configurable");
+StringView SS_ENUMERABLE = makeCommonString("enumerable");
+StringView SS_WRITABLE = makeCommonString("writable");
+StringView SS_VALUE = makeCommonString("value");
+StringView SS_VALUEOF = makeCommonString("valueOf");
+StringView SS_GET = makeCommonString("get");
+StringView SS_SET = makeCommonString("set");
+StringView SS_NAME = makeCommonString("name");
+StringView SS_CALLER = makeCommonString("caller");
+StringView SS_CONSTRUCTOR = makeCommonString("constructor");
+StringView SS_OBJECT = makeCommonString("object");
+StringView SS_FUNCTION = makeCommonString("function");
+StringView SS_NUMBER = makeCommonString("number");
+StringView SS_STRING = makeCommonString("string");
+StringView SS_BOOLEAN = makeCommonString("boolean");
+StringView SS_BIGINT = makeCommonString("bigint");
+StringView SS_SYMBOL = makeCommonString("symbol");
+StringView SS_INDEX = makeCommonString("index");
+StringView SS_LASTINDEX = makeCommonString("lastIndex");
+StringView SS_GROUPS = makeCommonString("groups");
+StringView SS_INPUT = makeCommonString("input");
+StringView SS_INFINITY = makeCommonString("Infinity");
+StringView SS_NAN = makeCommonString("NaN");
+StringView SS_INVALIDDATE = makeCommonString("Invalid Date");
+StringView SS_DOTALL = makeCommonString("dotAll");
+StringView SS_FLAGS = makeCommonString("flags");
+StringView SS_GLOBAL = makeCommonString("global");
+StringView SS_HASINDICES = makeCommonString("hasIndices");
+StringView SS_IGNORECASE = makeCommonString("ignoreCase");
+StringView SS_MULTILINE = makeCommonString("multiline");
+StringView SS_SOURCE = makeCommonString("source");
+StringView SS_STICKY = makeCommonString("sticky");
+StringView SS_UNICODE = makeCommonString("unicode");
+StringView SS_RESOLVE = makeCommonString("resolve");
+StringView SS_REJECT = makeCommonString("reject");
+StringView SS_THEN = makeCommonString("then");
+StringView SS_TOJSON = makeCommonString("toJSON");
+StringView SS_SIZE = makeCommonString("size");
+StringView SS_STATUS = makeCommonString("status");
+StringView SS_REASON = makeCommonString("reason");
+StringView SS_ERRORS = makeCommonString("errors");
+StringView SS_FULFILLED = makeCommonString("fulfilled");
+StringView SS_REJECTED = makeCommonString("rejected");
+StringView SS_ALLPROMISESREJECTED = makeCommonString("All promises were rejected");
+StringView SS_DONE = makeCommonString("done");
+
+void addConstStrings(VMRuntimeCommon *rtc) {
+    JsValue tmp;
+
+    tmp = rtc->pushStringValue(SS_EMPTY); assert(tmp.value.index == JS_STRING_IDX_EMPTY);
+    tmp = rtc->pushStringValue(SS_UNDEFINED); assert(tmp.value.index == JS_STRING_IDX_UNDEFINED);
+    tmp = rtc->pushStringValue(SS_NULL); assert(tmp.value.index == JS_STRING_IDX_NULL);
+    tmp = rtc->pushStringValue(SS_TRUE); assert(tmp.value.index == JS_STRING_IDX_TRUE);
+    tmp = rtc->pushStringValue(SS_FALSE); assert(tmp.value.index == JS_STRING_IDX_FALSE);
+    tmp = rtc->pushStringValue(SS_THIS); assert(tmp.value.index == JS_STRING_IDX_THIS);
+    tmp = rtc->pushStringValue(SS_ARGUMENTS); assert(tmp.value.index == JS_STRING_IDX_ARGUMENTS);
+    tmp = rtc->pushStringValue(SS_LENGTH); assert(tmp.value.index == JS_STRING_IDX_LENGTH);
+    tmp = rtc->pushStringValue(SS_TOSTRING); assert(tmp.value.index == JS_STRING_IDX_TOSTRING);
+    tmp = rtc->pushStringValue(SS___PROTO__); assert(tmp.value.index == JS_STRING_IDX___PROTO__);
+    tmp = rtc->pushStringValue(SS_PROTOTYPE); assert(tmp.value.index == JS_STRING_IDX_PROTOTYPE);
+    tmp = rtc->pushStringValue(SS_FUNCTIONNATIVECODE); assert(tmp.value.index == JS_STRING_IDX_FUNCTIONNATIVECODE);
+    tmp = rtc->pushStringValue(SS_ERROR); assert(tmp.value.index == JS_STRING_IDX_ERROR);
+    tmp = rtc->pushStringValue(SS_MESSAGE); assert(tmp.value.index == JS_STRING_IDX_MESSAGE);
+    tmp = rtc->pushStringValue(SS_STACK); assert(tmp.value.index == JS_STRING_IDX_STACK);
+    tmp = rtc->pushStringValue(SS_CONFIGURABLE); assert(tmp.value.index == JS_STRING_IDX_CONFIGURABLE);
+    tmp = rtc->pushStringValue(SS_ENUMERABLE); assert(tmp.value.index == JS_STRING_IDX_ENUMERABLE);
+    tmp = rtc->pushStringValue(SS_WRITABLE); assert(tmp.value.index == JS_STRING_IDX_WRITABLE);
+    tmp = rtc->pushStringValue(SS_VALUE); assert(tmp.value.index == JS_STRING_IDX_VALUE);
+    tmp = rtc->pushStringValue(SS_VALUEOF); assert(tmp.value.index == JS_STRING_IDX_VALUEOF);
+    tmp = rtc->pushStringValue(SS_GET); assert(tmp.value.index == JS_STRING_IDX_GET);
+    tmp = rtc->pushStringValue(SS_SET); assert(tmp.value.index == JS_STRING_IDX_SET);
+    tmp = rtc->pushStringValue(SS_NAME); assert(tmp.value.index == JS_STRING_IDX_NAME);
+    tmp = rtc->pushStringValue(SS_CALLER); assert(tmp.value.index == JS_STRING_IDX_CALLER);
+    tmp = rtc->pushStringValue(SS_CONSTRUCTOR); assert(tmp.value.index == JS_STRING_IDX_CONSTRUCTOR);
+    tmp = rtc->pushStringValue(SS_OBJECT); assert(tmp.value.index == JS_STRING_IDX_OBJECT);
+    tmp = rtc->pushStringValue(SS_FUNCTION); assert(tmp.value.index == JS_STRING_IDX_FUNCTION);
+    tmp = rtc->pushStringValue(SS_NUMBER); assert(tmp.value.index == JS_STRING_IDX_NUMBER);
+    tmp = rtc->pushStringValue(SS_STRING); assert(tmp.value.index == JS_STRING_IDX_STRING);
+    tmp = rtc->pushStringValue(SS_BOOLEAN); assert(tmp.value.index == JS_STRING_IDX_BOOLEAN);
+    tmp = rtc->pushStringValue(SS_BIGINT); assert(tmp.value.index == JS_STRING_IDX_BIGINT);
+    tmp = rtc->pushStringValue(SS_SYMBOL); assert(tmp.value.index == JS_STRING_IDX_SYMBOL);
+    tmp = rtc->pushStringValue(SS_INDEX); assert(tmp.value.index == JS_STRING_IDX_INDEX);
+    tmp = rtc->pushStringValue(SS_LASTINDEX); assert(tmp.value.index == JS_STRING_IDX_LASTINDEX);
+    tmp = rtc->pushStringValue(SS_GROUPS); assert(tmp.value.index == JS_STRING_IDX_GROUPS);
+    tmp = rtc->pushStringValue(SS_INPUT); assert(tmp.value.index == JS_STRING_IDX_INPUT);
+    tmp = rtc->pushStringValue(SS_INFINITY); assert(tmp.value.index == JS_STRING_IDX_INFINITY);
+    tmp = rtc->pushStringValue(SS_NAN); assert(tmp.value.index == JS_STRING_IDX_NAN);
+    tmp = rtc->pushStringValue(SS_INVALIDDATE); assert(tmp.value.index == JS_STRING_IDX_INVALIDDATE);
+    tmp = rtc->pushStringValue(SS_DOTALL); assert(tmp.value.index == JS_STRING_IDX_DOTALL);
+    tmp = rtc->pushStringValue(SS_FLAGS); assert(tmp.value.index == JS_STRING_IDX_FLAGS);
+    tmp = rtc->pushStringValue(SS_GLOBAL); assert(tmp.value.index == JS_STRING_IDX_GLOBAL);
+    tmp = rtc->pushStringValue(SS_HASINDICES); assert(tmp.value.index == JS_STRING_IDX_HASINDICES);
+    tmp = rtc->pushStringValue(SS_IGNORECASE); assert(tmp.value.index == JS_STRING_IDX_IGNORECASE);
+    tmp = rtc->pushStringValue(SS_MULTILINE); assert(tmp.value.index == JS_STRING_IDX_MULTILINE);
+    tmp = rtc->pushStringValue(SS_SOURCE); assert(tmp.value.index == JS_STRING_IDX_SOURCE);
+    tmp = rtc->pushStringValue(SS_STICKY); assert(tmp.value.index == JS_STRING_IDX_STICKY);
+    tmp = rtc->pushStringValue(SS_UNICODE); assert(tmp.value.index == JS_STRING_IDX_UNICODE);
+    tmp = rtc->pushStringValue(SS_RESOLVE); assert(tmp.value.index == JS_STRING_IDX_RESOLVE);
+    tmp = rtc->pushStringValue(SS_REJECT); assert(tmp.value.index == JS_STRING_IDX_REJECT);
+    tmp = rtc->pushStringValue(SS_THEN); assert(tmp.value.index == JS_STRING_IDX_THEN);
+    tmp = rtc->pushStringValue(SS_TOJSON); assert(tmp.value.index == JS_STRING_IDX_TOJSON);
+    tmp = rtc->pushStringValue(SS_SIZE); assert(tmp.value.index == JS_STRING_IDX_SIZE);
+    tmp = rtc->pushStringValue(SS_STATUS); assert(tmp.value.index == JS_STRING_IDX_STATUS);
+    tmp = rtc->pushStringValue(SS_REASON); assert(tmp.value.index == JS_STRING_IDX_REASON);
+    tmp = rtc->pushStringValue(SS_ERRORS); assert(tmp.value.index == JS_STRING_IDX_ERRORS);
+    tmp = rtc->pushStringValue(SS_FULFILLED); assert(tmp.value.index == JS_STRING_IDX_FULFILLED);
+    tmp = rtc->pushStringValue(SS_REJECTED); assert(tmp.value.index == JS_STRING_IDX_REJECTED);
+    tmp = rtc->pushStringValue(SS_ALLPROMISESREJECTED); assert(tmp.value.index == JS_STRING_IDX_ALLPROMISESREJECTED);
+    tmp = rtc->pushStringValue(SS_DONE); assert(tmp.value.index == JS_STRING_IDX_DONE);
+}
+
@@ -0,0 +1,196 @@
+/**
+ * 此文件由 ConstStrings.py 自动创建，请不要手动修改
+ */
+
+#ifndef ConstStrings_hpp
+#define ConstStrings_hpp
+
+extern StringView SS_EMPTY;
+extern StringView SS_UNDEFINED;
+extern StringView SS_NULL;
+extern StringView SS_TRUE;
+extern StringView SS_FALSE;
+extern StringView SS_THIS;
+extern StringView SS_ARGUMENTS;
+extern StringView SS_LENGTH;
+extern StringView SS_TOSTRING;
+extern StringView SS___PROTO__;
+extern StringView SS_PROTOTYPE;
+extern StringView SS_FUNCTIONNATIVECODE;
+extern StringView SS_ERROR;
+extern StringView SS_MESSAGE;
+extern StringView SS_STACK;
+extern StringView SS_CONFIGURABLE;
+extern StringView SS_ENUMERABLE;
+extern StringView SS_WRITABLE;
+extern StringView SS_VALUE;
+extern StringView SS_VALUEOF;
+extern StringView SS_GET;
+extern StringView SS_SET;
+extern StringView SS_NAME;
+extern StringView SS_CALLER;
+extern StringView SS_CONSTRUCTOR;
+extern StringView SS_OBJECT;
+extern StringView SS_FUNCTION;
+extern StringView SS_NUMBER;
+extern StringView SS_STRING;
+extern StringView SS_BOOLEAN;
+extern StringView SS_BIGINT;
+extern StringView SS_SYMBOL;
+extern StringView SS_INDEX;
+extern StringView SS_LASTINDEX;
+extern StringView SS_GROUPS;
+extern StringView SS_INPUT;
+extern StringView SS_INFINITY;
+extern StringView SS_NAN;
+extern StringView SS_INVALIDDATE;
+extern StringView SS_DOTALL;
+extern StringView SS_FLAGS;
+extern StringView SS_GLOBAL;
+extern StringView SS_HASINDICES;
+extern StringView SS_IGNORECASE;
+extern StringView SS_MULTILINE;
+extern StringView SS_SOURCE;
+extern StringView SS_STICKY;
+extern StringView SS_UNICODE;
+extern StringView SS_RESOLVE;
+extern StringView SS_REJECT;
+extern StringView SS_THEN;
+extern StringView SS_TOJSON;
+extern StringView SS_SIZE;
+extern StringView SS_STATUS;
+extern StringView SS_REASON;
+extern StringView SS_ERRORS;
+extern StringView SS_FULFILLED;
+extern StringView SS_REJECTED;
+extern StringView SS_ALLPROMISESREJECTED;
+extern StringView SS_DONE;
+
+enum jsStringValueIndex {
+    __JS_STRING_IDX_INVALID__,
+    JS_STRING_IDX_EMPTY,
+    JS_STRING_IDX_UNDEFINED,
+    JS_STRING_IDX_NULL,
+    JS_STRING_IDX_TRUE,
+    JS_STRING_IDX_FALSE,
+    JS_STRING_IDX_THIS,
+    JS_STRING_IDX_ARGUMENTS,
+    JS_STRING_IDX_LENGTH,
+    JS_STRING_IDX_TOSTRING,
+    JS_STRING_IDX___PROTO__,
+    JS_STRING_IDX_PROTOTYPE,
+    JS_STRING_IDX_FUNCTIONNATIVECODE,
+    JS_STRING_IDX_ERROR,
+    JS_STRING_IDX_MESSAGE,
+    JS_STRING_IDX_STACK,
+    JS_STRING_IDX_CONFIGURABLE,
+    JS_STRING_IDX_ENUMERABLE,
+    JS_STRING_IDX_WRITABLE,
+    JS_STRING_IDX_VALUE,
+    JS_STRING_IDX_VALUEOF,
+    JS_STRING_IDX_GET,
+    JS_STRING_IDX_SET,
+    JS_STRING_IDX_NAME,
+    JS_STRING_IDX_CALLER,
+    JS_STRING_IDX_CONSTRUCTOR,
+    JS_STRING_IDX_OBJECT,
+    JS_STRING_IDX_FUNCTION,
+    JS_STRING_IDX_NUMBER,
+    JS_STRING_IDX_STRING,
+    JS_STRING_IDX_BOOLEAN,
+    JS_STRING_IDX_BIGINT,
+    JS_STRING_IDX_SYMBOL,
+    JS_STRING_IDX_INDEX,
+    JS_STRING_IDX_LASTINDEX,
+    JS_STRING_IDX_GROUPS,
+    JS_STRING_IDX_INPUT,
+    JS_STRING_IDX_INFINITY,
+    JS_STRING_IDX_NAN,
+    JS_STRING_IDX_INVALIDDATE,
+    JS_STRING_IDX_DOTALL,
+    JS_STRING_IDX_FLAGS,
+    JS_STRING_IDX_GLOBAL,
+    JS_STRING_IDX_HASINDICES,
+    JS_STRING_IDX_IGNORECASE,
+    JS_STRING_IDX_MULTILINE,
+    JS_STRING_IDX_SOURCE,
+    JS_STRING_IDX_STICKY,
+    JS_STRING_IDX_UNICODE,
+    JS_STRING_IDX_RESOLVE,
+    JS_STRING_IDX_REJECT,
+    JS_STRING_IDX_THEN,
+    JS_STRING_IDX_TOJSON,
+    JS_STRING_IDX_SIZE,
+    JS_STRING_IDX_STATUS,
+    JS_STRING_IDX_REASON,
+    JS_STRING_IDX_ERRORS,
+    JS_STRING_IDX_FULFILLED,
+    JS_STRING_IDX_REJECTED,
+    JS_STRING_IDX_ALLPROMISESREJECTED,
+    JS_STRING_IDX_DONE,
+};
+
+const JsValue jsStringValueEmpty = JsValue(JDT_STRING, JS_STRING_IDX_EMPTY);
+const JsValue jsStringValueUndefined = JsValue(JDT_STRING, JS_STRING_IDX_UNDEFINED);
+const JsValue jsStringValueNull = JsValue(JDT_STRING, JS_STRING_IDX_NULL);
+const JsValue jsStringValueTrue = JsValue(JDT_STRING, JS_STRING_IDX_TRUE);
+const JsValue jsStringValueFalse = JsValue(JDT_STRING, JS_STRING_IDX_FALSE);
+const JsValue jsStringValueThis = JsValue(JDT_STRING, JS_STRING_IDX_THIS);
+const JsValue jsStringValueArguments = JsValue(JDT_STRING, JS_STRING_IDX_ARGUMENTS);
+const JsValue jsStringValueLength = JsValue(JDT_STRING, JS_STRING_IDX_LENGTH);
+const JsValue jsStringValueToString = JsValue(JDT_STRING, JS_STRING_IDX_TOSTRING);
+const JsValue jsStringValue__proto__ = JsValue(JDT_STRING, JS_STRING_IDX___PROTO__);
+const JsValue jsStringValuePrototype = JsValue(JDT_STRING, JS_STRING_IDX_PROTOTYPE);
+const JsValue jsStringValueFunctionNativeCode = JsValue(JDT_STRING, JS_STRING_IDX_FUNCTIONNATIVECODE);
+const JsValue jsStringValueError = JsValue(JDT_STRING, JS_STRING_IDX_ERROR);
+const JsValue jsStringValuemessage = JsValue(JDT_STRING, JS_STRING_IDX_MESSAGE);
+const JsValue jsStringValuestack = JsValue(JDT_STRING, JS_STRING_IDX_STACK);
+const JsValue jsStringValueConfigurable = JsValue(JDT_STRING, JS_STRING_IDX_CONFIGURABLE);
+const JsValue jsStringValueEnumerable = JsValue(JDT_STRING, JS_STRING_IDX_ENUMERABLE);
+const JsValue jsStringValueWritable = JsValue(JDT_STRING, JS_STRING_IDX_WRITABLE);
+const JsValue jsStringValueValue = JsValue(JDT_STRING, JS_STRING_IDX_VALUE);
+const JsValue jsStringValueValueOf = JsValue(JDT_STRING, JS_STRING_IDX_VALUEOF);
+const JsValue jsStringValueGet = JsValue(JDT_STRING, JS_STRING_IDX_GET);
+const JsValue jsStringValueSet = JsValue(JDT_STRING, JS_STRING_IDX_SET);
+const JsValue jsStringValueName = JsValue(JDT_STRING, JS_STRING_IDX_NAME);
+const JsValue jsStringValueCaller = JsValue(JDT_STRING, JS_STRING_IDX_CALLER);
+const JsValue jsStringValueConstructor = JsValue(JDT_STRING, JS_STRING_IDX_CONSTRUCTOR);
+const JsValue jsStringValueObject = JsValue(JDT_STRING, JS_STRING_IDX_OBJECT);
+const JsValue jsStringValueFunction = JsValue(JDT_STRING, JS_STRING_IDX_FUNCTION);
+const JsValue jsStringValueNumber = JsValue(JDT_STRING, JS_STRING_IDX_NUMBER);
+const JsValue jsStringValueString = JsValue(JDT_STRING, JS_STRING_IDX_STRING);
+const JsValue jsStringValueBoolean = JsValue(JDT_STRING, JS_STRING_IDX_BOOLEAN);
+const JsValue jsStringValueBigint = JsValue(JDT_STRING, JS_STRING_IDX_BIGINT);
+const JsValue jsStringValueSymbol = JsValue(JDT_STRING, JS_STRING_IDX_SYMBOL);
+const JsValue jsStringValueIndex = JsValue(JDT_STRING, JS_STRING_IDX_INDEX);
+const JsValue jsStringValueLastIndex = JsValue(JDT_STRING, JS_STRING_IDX_LASTINDEX);
+const JsValue jsStringValueGroups = JsValue(JDT_STRING, JS_STRING_IDX_GROUPS);
+const JsValue jsStringValueInput = JsValue(JDT_STRING, JS_STRING_IDX_INPUT);
+const JsValue jsStringValueInfinity = JsValue(JDT_STRING, JS_STRING_IDX_INFINITY);
+const JsValue jsStringValueNaN = JsValue(JDT_STRING, JS_STRING_IDX_NAN);
+const JsValue jsStringValueInvalidDate = JsValue(JDT_STRING, JS_STRING_IDX_INVALIDDATE);
+const JsValue jsStringValuedotAll = JsValue(JDT_STRING, JS_STRING_IDX_DOTALL);
+const JsValue jsStringValueflags = JsValue(JDT_STRING, JS_STRING_IDX_FLAGS);
+const JsValue jsStringValueglobal = JsValue(JDT_STRING, JS_STRING_IDX_GLOBAL);
+const JsValue jsStringValuehasIndices = JsValue(JDT_STRING, JS_STRING_IDX_HASINDICES);
+const JsValue jsStringValueignoreCase = JsValue(JDT_STRING, JS_STRING_IDX_IGNORECASE);
+const JsValue jsStringValuemultiline = JsValue(JDT_STRING, JS_STRING_IDX_MULTILINE);
+const JsValue jsStringValuesource = JsValue(JDT_STRING, JS_STRING_IDX_SOURCE);
+const JsValue jsStringValuesticky = JsValue(JDT_STRING, JS_STRING_IDX_STICKY);
+const JsValue jsStringValueunicode = JsValue(JDT_STRING, JS_STRING_IDX_UNICODE);
+const JsValue jsStringValueresolve = JsValue(JDT_STRING, JS_STRING_IDX_RESOLVE);
+const JsValue jsStringValuereject = JsValue(JDT_STRING, JS_STRING_IDX_REJECT);
+const JsValue jsStringValuethen = JsValue(JDT_STRING, JS_STRING_IDX_THEN);
+const JsValue jsStringValueToJSON = JsValue(JDT_STRING, JS_STRING_IDX_TOJSON);
+const JsValue jsStringValueSize = JsValue(JDT_STRING, JS_STRING_IDX_SIZE);
+const JsValue jsStringValuestatus = JsValue(JDT_STRING, JS_STRING_IDX_STATUS);
+const JsValue jsStringValuereason = JsValue(JDT_STRING, JS_STRING_IDX_REASON);
+const JsValue jsStringValueerrors = JsValue(JDT_STRING, JS_STRING_IDX_ERRORS);
+const JsValue jsStringValuefulfilled = JsValue(JDT_STRING, JS_STRING_IDX_FULFILLED);
+const JsValue jsStringValuerejected = JsValue(JDT_STRING, JS_STRING_IDX_REJECTED);
+const JsValue jsStringValueAllPromisesRejected = JsValue(JDT_STRING, JS_STRING_IDX_ALLPROMISESREJECTED);
+const JsValue jsStringValuedone = JsValue(JDT_STRING, JS_STRING_IDX_DONE);
+
+void addConstStrings(class VMRuntimeCommon *rtc);
+
+#endif // ConstStrings_hpp
@@ -44,7 +44,7 @@ protected:
         this->count = count;
         data = args;
         needFree = false;
-        capacity = sizeof(args);
+        capacity = CountOf(args);
     }
 
 public:
@@ -63,7 +63,7 @@ public:
         args[2] = three;
     }
 
-    ArgumentsX(const JsValue &one, const JsValue &two, const JsValue &three, const JsValue &four) : ArgumentsX(3) {
+    ArgumentsX(const JsValue &one, const JsValue &two, const JsValue &three, const JsValue &four) : ArgumentsX(4) {
         args[0] = one;
         args[1] = two;
         args[2] = three;
@@ -0,0 +1,254 @@
+﻿//
+//  ArraySort.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/21.
+//
+
+#include "ArraySort.hpp"
+#include "VirtualMachine.hpp"
+#include "objects/JsObjectFunction.hpp"
+#include "utils/TimSort.h"
+
+
+enum NumericComparator {
+    NC_NONE,
+    NC_ASCENDING, // (a, b) => a - b
+    NC_DESCENDING, // (a, b) => b - a
+};
+
+/**
+ * 判断比较函数是否只是两个参数相减，其 bytecode 为:
+ *     OP_PUSH_ID_LOCAL_ARGUMENT 0/1, OP_PUSH_ID_LOCAL_ARGUMENT 1/0, OP_SUB, OP_RETURN_VALUE
+ */
+static NumericComparator getNumericComparator(VMRuntime *runtime, const JsValue &comparator) {
+    if (comparator.type != JDT_FUNCTION) {
+        return NC_NONE;
+    }
+
+    auto function = ((JsObjectFunction *)runtime->getObject(comparator))->function;
+    if (function->bytecode == nullptr) {
+        function->generateByteCode();
+    }
+
+    auto bytecode = function->bytecode;
+    if (function->lenByteCode != 8 || bytecode[0] != OP_PUSH_ID_LOCAL_ARGUMENT || bytecode[3] != OP_PUSH_ID_LOCAL_ARGUMENT
+        || bytecode[6] != OP_SUB || bytecode[7] != OP_RETURN_VALUE) {
+        return NC_NONE;
+    }
+
+    auto p = bytecode + 1;
+    auto first = readUInt16(p);
+    p = bytecode + 4;
+    auto second = readUInt16(p);
+
+    if (first == 0 && second == 1) {
+        return NC_ASCENDING;
+    } else if (first == 1 && second == 0) {
+        return NC_DESCENDING;
+    }
+    return NC_NONE;
+}
+
+struct NumberSortItem {
+    double                      key;
+    JsValue                     value;
+};
+
+/**
+ * 所有的值都是数字 (且不为 NaN) 时，a - b 的符号和 a, b 的大小关系一致，直接比较数值.
+ * 有其他类型的值时返回 false，需要调用比较函数.
+ */
+static bool sortNumbers(VMRuntime *runtime, VecJsValues &values, bool isDescending) {
+    std::vector<NumberSortItem> items;
+    items.reserve(values.size());
+
+    for (auto &v : values) {
+        double d;
+        if (v.type == JDT_INT32) {
+            d = v.value.n32;
+        } else if (v.type == JDT_NUMBER) {
+            d = runtime->getDouble(v);
+            if (std::isnan(d)) {
+                // NaN 和任何值相减都是 NaN，被当作相等
+                return false;
+            }
+        } else {
+            return false;
+        }
+        items.push_back({d, v});
+    }
+
+    if (isDescending) {
+        timSort(items.data(), items.size(), [](const NumberSortItem &a, const NumberSortItem &b) {
+            return b.key < a.key;
+        });
+    } else {
+        timSort(items.data(), items.size(), [](const NumberSortItem &a, const NumberSortItem &b) {
+            return a.key < b.key;
+        });
+    }
+
+    for (size_t i = 0; i < items.size(); i++) {
+        values[i] = items[i].value;
+    }
+    return true;
+}
+
+struct StringSortItem {
+    StringView                  key;
+    JsValue                     value;
+};
+
+/**
+ * 按照 utf-16 编码单元的顺序比较两个 utf-8 字符串.
+ *
+ * utf-8 的字节顺序和 unicode 码点的顺序一致，只有 U+10000 以上的字符 (utf-16 中为 0xD800 开头的代理对)
+ * 和 U+E000 ~ U+FFFF 的字符比较时相反.
+ */
+static int cmpUtf8AsUtf16(const StringView &a, const StringView &b) {
+    auto pa = (const uint8_t *)a.data, pb = (const uint8_t *)b.data;
+    auto len = std::min(a.len, b.len);
+    uint32_t i = 0;
+    while (i < len && pa[i] == pb[i]) {
+        i++;
+    }
+
+    if (i == len) {
+        return a.len == b.len ? 0 : (a.len < b.len ? -1 : 1);
+    }
+
+    // 不同的字符的第一个字节
+    auto start = i;
+    while (start > 0 && (pa[start] & 0xC0) == 0x80) {
+        start--;
+    }
+
+    uint8_t ca = pa[start], cb = pb[start];
+    if (ca >= 0xF0 && cb >= 0xEE && cb < 0xF0) {
+        return -1;
+    } else if (cb >= 0xF0 && ca >= 0xEE && ca < 0xF0) {
+        return 1;
+    }
+
+    return pa[i] - pb[i];
+}
+
+/**
+ * 没有比较函数时，按照转换后的字符串排序.
+ *
+ * 原来每次比较时都会转换两个值 (数字每次都要格式化)，这里每个值只转换一次.
+ * 对象的 toString 会执行 JavaScript (可能会 GC)，所以先转换所有的对象，之后不再执行 JavaScript，
+ * 字符串的地址就不会再改变了. 其他非字符串类型的值转换后保存在 buf 中.
+ */
+static void sortByStringKeys(VMContext *ctx, VecJsValues &values) {
+    auto runtime = ctx->runtime;
+    auto count = values.size();
+
+    VecJsValues primitives;
+    primitives.reserve(count);
+    bool isRooted = false;
+    for (auto &v : values) {
+        if (v.type >= JDT_OBJECT) {
+            if (!isRooted) {
+                // toString 可能会修改数组，values 中的值需要作为 GC 的 root
+                isRooted = true;
+                for (auto &item : values) {
+                    runtime->addTempValue(item);
+                }
+            }
+
+            ctx->vm->callMember(ctx, v, SS_TOSTRING, Arguments());
+            if (ctx->error != JE_OK) {
+                return;
+            }
+            if (ctx->retValue.type >= JDT_OBJECT) {
+                ctx->throwException(JE_TYPE_ERROR, " Cannot convert object to primitive value");
+                return;
+            }
+            primitives.push_back(ctx->retValue);
+            runtime->addTempValue(ctx->retValue);
+        } else {
+            primitives.push_back(v);
+        }
+    }
+
+    const uint32_t IN_STRING_VALUE = (uint32_t)-1;
+    std::vector<StringSortItem> items(count);
+    std::vector<uint32_t> offsets(count, IN_STRING_VALUE);
+    string buf;
+
+    for (size_t i = 0; i < count; i++) {
+        auto &v = primitives[i];
+        items[i].value = values[i];
+        if (v.type == JDT_STRING) {
+            items[i].key = runtime->getUtf8String(v);
+        } else {
+            auto s = runtime->toStringView(ctx, v);
+            offsets[i] = (uint32_t)buf.size();
+            items[i].key.len = s.len;
+            buf.append((const char *)s.data, s.len);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (offsets[i] != IN_STRING_VALUE) {
+            items[i].key.data = buf.data() + offsets[i];
+        }
+    }
+
+    timSort(items.data(), items.size(), [](const StringSortItem &a, const StringSortItem &b) {
+        return cmpUtf8AsUtf16(a.key, b.key) < 0;
+    });
+
+    for (size_t i = 0; i < count; i++) {
+        values[i] = items[i].value;
+    }
+}
+
+static void sortByComparator(VMContext *ctx, VecJsValues &values, const JsValue &comparator) {
+    auto runtime = ctx->runtime;
+
+    // 比较函数可能会修改数组，values 中的值需要作为 GC 的 root
+    for (auto &v : values) {
+        runtime->addTempValue(v);
+    }
+
+    VMRepeatedCall call(ctx, comparator);
+    timSort(values.data(), values.size(), [ctx, runtime, &call](const JsValue &a, const JsValue &b) {
+        if (ctx->error != JE_OK) {
+            return false;
+        }
+
+        ArgumentsX args(a, b);
+        call.call(jsValueGlobalThis, args);
+        if (ctx->error != JE_OK) {
+            return false;
+        }
+
+        // 比较函数的返回值小于 0 时 a 排在 b 前面，NaN 被当作 0
+        auto &ret = ctx->retValue;
+        if (ret.type == JDT_INT32) {
+            return ret.value.n32 < 0;
+        }
+        return runtime->toNumber(ctx, ret) < 0;
+    });
+}
+
+void sortJsValues(VMContext *ctx, VecJsValues &values, const JsValue &comparator) {
+    if (values.size() < 2) {
+        return;
+    }
+
+    if (!comparator.isFunction()) {
+        sortByStringKeys(ctx, values);
+        return;
+    }
+
+    auto kind = getNumericComparator(ctx->runtime, comparator);
+    if (kind != NC_NONE && sortNumbers(ctx->runtime, values, kind == NC_DESCENDING)) {
+        return;
+    }
+
+    sortByComparator(ctx, values, comparator);
+}
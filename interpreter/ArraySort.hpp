@@ -0,0 +1,27 @@
+﻿//
+//  ArraySort.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/21.
+//
+
+#ifndef ArraySort_hpp
+#define ArraySort_hpp
+
+#include "VirtualMachineTypes.hpp"
+
+
+class VMContext;
+
+/**
+ * Array.prototype.sort 的排序部分: values 中已经去掉了 undefined 和空洞，排序是稳定的.
+ *
+ * - 没有比较函数时，每个值只转换一次字符串，再按照字符串排序;
+ * - 比较函数为 (a, b) => a - b 或者 b - a，并且所有的值都是数字时，不调用比较函数，直接比较数值;
+ * - 其他的比较函数通过 VMRepeatedCall 调用.
+ *
+ * 都使用 TimSort，已经有序或者部分有序的数组只需要很少的比较次数.
+ */
+void sortJsValues(VMContext *ctx, VecJsValues &values, const JsValue &comparator);
+
+#endif /* ArraySort_hpp */
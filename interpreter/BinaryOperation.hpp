@@ -785,8 +785,7 @@ inline bool relationalOperate(VMContext *ctx, VMRuntime *rt, const JsValue &left
 
 inline bool relationalEqual(VMContext *ctx, VMRuntime *rt, const JsValue &left, const JsValue &right) {
     if (left.equalValue(right)) {
-        // TODO: 需要检查 JsValue 在 runtime->_doubleValues 的值是否为 NaN
-        return !left.equalValue(jsValueNaN);
+        return !isJsValueNaN(left);
     } else {
         // 需要特别判断 Object 的情况
         if (left.type >= JDT_OBJECT && right.type >= JDT_OBJECT) {
@@ -799,7 +798,7 @@ inline bool relationalEqual(VMContext *ctx, VMRuntime *rt, const JsValue &left,
 }
 
 inline bool relationalStrictEqual(VMRuntime *rt, const JsValue &left, const JsValue &right) {
-    if (left.equalValue(right) && !left.equalValue(jsValueNaN)) {
+    if (left.equalValue(right) && !isJsValueNaN(left)) {
         return true;
     }
 
@@ -893,12 +892,4 @@ inline bool instanceOf(VMContext *ctx, VMRuntime *rt, const JsValue &left, const
     return false;
 }
 
-inline bool convertToStringLessCmp(VMContext *ctx, JsValue left, JsValue right) {
-    auto rt = ctx->runtime;
-    auto s1 = rt->toStringView(ctx, left);
-    auto s2 = rt->toStringView(ctx, right);
-
-    return s1.cmp(s2) < 0;
-}
-
 #endif /* BinaryOperation_hpp */
@@ -0,0 +1,791 @@
+﻿//
+//  ByteCodeCache.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/13.
+//
+
+#include "ByteCodeCache.hpp"
+#include "VirtualMachine.hpp"
+#include "parser/ParserTypes.hpp"
+
+
+/**
+ * 缓存的格式: ByteCodeCacheHeader + payload. payload 依次为:
+ *   ResourcePool: strings, doubles, regexps, switch jumps
+ *   全局变量: 原索引, 名字, 是否为代码中声明的变量
+ *   Functions: 先是创建 Function 需要的信息 (包括 scope 的数量)，然后是 IdentifierDeclare, Scope 和 Function 的其他字段.
+ * 对象之间的引用都保存为其在缓存中的索引，Function 的 scopes 在缓存中是连续存储的.
+ * 数值都按照本机的字节序存储，和 bytecode 一致.
+ */
+enum ByteCodeCacheMisc : uint32_t {
+    BYTE_CODE_CACHE_MAGIC       = 0x4342534A, // "JSBC"
+
+    IDX_NONE                    = 0xFFFFFFFF,
+    IDX_GLOBAL_SCOPE            = 0xFFFFFFFE, // VMRuntime 的全局 scope，不在缓存中
+};
+
+struct ByteCodeCacheHeader {
+    uint32_t                    magic;
+    uint32_t                    version;
+    uint64_t                    fingerprint;
+    uint64_t                    sourceHash;
+    uint64_t                    lenSource;
+    uint64_t                    payloadHash;
+    uint64_t                    lenPayload;
+};
+
+// 缓存中有不能表示或者无效的数据
+class ByteCodeCacheException { };
+
+static uint64_t byteCodeCacheFingerprint() {
+    uint64_t values[] = { opCodesFingerprint(), VMRuntimeCommon::getInstance()->commonValuesFingerprint(), sizeof(void *) };
+    return hashBytes(values, sizeof(values));
+}
+
+static uint8_t packDeclareFlags(const IdentifierDeclare *id) {
+    return id->isConst | (id->isScopeVar << 1) | (id->isImplicitDeclaration << 2) | (id->isReferredByChild << 3)
+        | (id->isReferred << 4) | (id->isModified << 5) | (id->isFuncName << 6) | (id->isUsedNotAsFunctionCall << 7);
+}
+
+static void unpackDeclareFlags(IdentifierDeclare *id, uint8_t flags) {
+    id->isConst = flags & 1;
+    id->isScopeVar = (flags >> 1) & 1;
+    id->isImplicitDeclaration = (flags >> 2) & 1;
+    id->isReferredByChild = (flags >> 3) & 1;
+    id->isReferred = (flags >> 4) & 1;
+    id->isModified = (flags >> 5) & 1;
+    id->isFuncName = (flags >> 6) & 1;
+    id->isUsedNotAsFunctionCall = (flags >> 7) & 1;
+}
+
+static uint8_t packScopeFlags(const Scope *scope) {
+    return scope->hasWith | (scope->hasEval << 1) | (scope->isFunctionScope << 2)
+        | (scope->isThisUsed << 3) | (scope->isArgumentsUsed << 4);
+}
+
+static void unpackScopeFlags(Scope *scope, uint8_t flags) {
+    scope->hasWith = flags & 1;
+    scope->hasEval = (flags >> 1) & 1;
+    scope->isFunctionScope = (flags >> 2) & 1;
+    scope->isThisUsed = (flags >> 3) & 1;
+    scope->isArgumentsUsed = (flags >> 4) & 1;
+}
+
+static uint16_t packFunctionFlags(const Function *f) {
+    return f->isCodeBlock | (f->isStrictMode << 1) | (f->isVarsReferredByChild << 2) | (f->isArgumentsReferredByChild << 3)
+        | (f->isReferredParentVars << 4) | (f->isGenerator << 5) | (f->isAsync << 6) | (f->isMemberFunction << 7)
+        | (f->isArrowFunction << 8);
+}
+
+static void unpackFunctionFlags(Function *f, uint16_t flags) {
+    f->isCodeBlock = flags & 1;
+    f->isStrictMode = (flags >> 1) & 1;
+    f->isVarsReferredByChild = (flags >> 2) & 1;
+    f->isArgumentsReferredByChild = (flags >> 3) & 1;
+    f->isReferredParentVars = (flags >> 4) & 1;
+    f->isGenerator = (flags >> 5) & 1;
+    f->isAsync = (flags >> 6) & 1;
+    f->isMemberFunction = (flags >> 7) & 1;
+    f->isArrowFunction = (flags >> 8) & 1;
+}
+
+// 资源池中的 string/number 的索引包括了 ResourcePool 的索引，加载后的 ResourcePool 索引会不同
+inline bool isJsValueInResourcePool(const JsValue &value) {
+    return value.isInResourcePool;
+}
+
+class ByteCodeCacheWriter {
+public:
+    ByteCodeCacheWriter(VMRuntime *runtime, Function *root, const StringView &code) : _runtime(runtime), _root(root), _code(code) { }
+
+    void write(BinaryOutputStream &stream);
+
+    const VecFunctions &functions() const { return _functions; }
+    const VecScopes &scopes() const { return _scopes; }
+
+protected:
+    void addFunction(Function *f);
+    void addGlobal(uint32_t storageIndex);
+
+    uint32_t indexOfFunction(Function *f);
+    uint32_t indexOfScope(Scope *scope, bool isNoneAllowed);
+    uint32_t indexOfDeclare(IdentifierDeclare *id);
+
+    void writeString(BinaryOutputStream &stream, const StringView &str);
+    void writeFunctions(BinaryOutputStream &stream, const VecFunctions &functions);
+
+    void writeResourcePool(BinaryOutputStream &stream);
+    void writeGlobals(BinaryOutputStream &stream);
+    void writeFunctionsAndScopes(BinaryOutputStream &stream);
+
+protected:
+    VMRuntime                   *_runtime;
+    Function                    *_root;
+    StringView                  _code;
+
+    VecFunctions                _functions;
+    std::unordered_map<Function *, uint32_t> _functionsIdx;
+    VecScopes                   _scopes;
+    std::unordered_map<Scope *, uint32_t> _scopesIdx;
+    std::vector<IdentifierDeclare *> _declares;
+    std::unordered_map<IdentifierDeclare *, uint32_t> _declaresIdx;
+
+    // 全局 scope 中的声明，下标为其 storageIndex
+    std::vector<IdentifierDeclare *> _globalDeclares;
+    std::vector<uint32_t>       _globals; // 引用到的全局变量的索引
+    std::unordered_map<uint32_t, bool> _globalsDeclared; // 全局变量是否在代码中声明了
+
+};
+
+void ByteCodeCacheWriter::write(BinaryOutputStream &out) {
+    addFunction(_root);
+
+    auto resPool = _root->resourcePool;
+    for (auto f : _functions) {
+        if (f->resourcePool != resPool || f->scopes.empty() || f->scope != f->scopes[0]) {
+            throw ByteCodeCacheException();
+        }
+
+        if (f->bytecode == nullptr) {
+            f->generateByteCode();
+        }
+
+        for (size_t i = 0; i < f->scopes.size(); i++) {
+            auto scope = f->scopes[i];
+            if (scope->function != f || scope->index != i) {
+                throw ByteCodeCacheException();
+            }
+            _scopesIdx[scope] = (uint32_t)_scopes.size();
+            _scopes.push_back(scope);
+        }
+    }
+
+    for (auto scope : _scopes) {
+        for (auto &item : scope->varDeclares) {
+            auto id = item.second;
+            if (_declaresIdx.find(id) == _declaresIdx.end()) {
+                _declaresIdx[id] = (uint32_t)_declares.size();
+                _declares.push_back(id);
+            }
+        }
+    }
+
+    // 引用到的全局变量: bytecode 中的和被重新定位到全局 scope 中的变量
+    auto globalScopeDsc = _runtime->globalScope()->scopeDsc;
+    _globalDeclares.resize(globalScopeDsc->countLocalVars);
+    for (auto &item : globalScopeDsc->varDeclares) {
+        auto id = item.second;
+        if (id->varStorageType == VST_GLOBAL_VAR && id->storageIndex < _globalDeclares.size()) {
+            _globalDeclares[id->storageIndex] = id;
+        }
+    }
+
+    std::vector<uint8_t *> operands;
+    for (auto f : _functions) {
+        findGlobalVarOperands(f->bytecode, f->lenByteCode, operands);
+    }
+    for (auto p : operands) {
+        addGlobal(*(uint16_t *)p);
+    }
+
+    for (auto id : _declares) {
+        if (id->varStorageType == VST_GLOBAL_VAR) {
+            addGlobal(id->storageIndex);
+            _globalsDeclared[id->storageIndex] = true;
+        }
+    }
+
+    // switch 的 case 条件在第一次执行时才会生成，这里提前生成
+    for (auto &switchJump : resPool->switchCaseJumps) {
+        if (switchJump.stmtSwitch) {
+            switchJump.findAddress(_runtime, resPool->index, jsValueUndefined);
+        }
+    }
+
+    BinaryOutputStream stream;
+    writeResourcePool(stream);
+    writeGlobals(stream);
+    writeFunctionsAndScopes(stream);
+
+    auto payload = stream.toStringView();
+
+    ByteCodeCacheHeader header;
+    header.magic = BYTE_CODE_CACHE_MAGIC;
+    header.version = BYTE_CODE_CACHE_VERSION;
+    header.fingerprint = byteCodeCacheFingerprint();
+    header.sourceHash = hashBytes(_code.data, _code.len);
+    header.lenSource = _code.len;
+    header.payloadHash = hashBytes(payload.data, payload.len);
+    header.lenPayload = payload.len;
+
+    out.write((const uint8_t *)&header, sizeof(header));
+    out.write(payload.data, payload.len);
+}
+
+void ByteCodeCacheWriter::addFunction(Function *f) {
+    if (_functionsIdx.find(f) != _functionsIdx.end()) {
+        return;
+    }
+
+    _functionsIdx[f] = (uint32_t)_functions.size();
+    _functions.push_back(f);
+
+    if (f->isLazy) {
+        // 缓存中保存的是完整解析后的函数
+        f->generateByteCode();
+    }
+
+    for (auto child : f->functions) {
+        addFunction(child);
+    }
+}
+
+void ByteCodeCacheWriter::addGlobal(uint32_t storageIndex) {
+    if (storageIndex >= _globalDeclares.size() || _globalDeclares[storageIndex] == nullptr) {
+        throw ByteCodeCacheException();
+    }
+
+    if (_globalsDeclared.find(storageIndex) == _globalsDeclared.end()) {
+        _globalsDeclared[storageIndex] = false;
+        _globals.push_back(storageIndex);
+    }
+}
+
+uint32_t ByteCodeCacheWriter::indexOfFunction(Function *f) {
+    auto it = _functionsIdx.find(f);
+    if (it == _functionsIdx.end()) {
+        throw ByteCodeCacheException();
+    }
+    return (*it).second;
+}
+
+uint32_t ByteCodeCacheWriter::indexOfScope(Scope *scope, bool isNoneAllowed) {
+    if (scope == _runtime->globalScope()->scopeDsc) {
+        return IDX_GLOBAL_SCOPE;
+    }
+
+    auto it = _scopesIdx.find(scope);
+    if (it == _scopesIdx.end()) {
+        // 比如: 代码片段的 scope 和之前执行的代码片段的 scope 互为 sibling
+        if (isNoneAllowed) {
+            return IDX_NONE;
+        }
+        throw ByteCodeCacheException();
+    }
+    return (*it).second;
+}
+
+uint32_t ByteCodeCacheWriter::indexOfDeclare(IdentifierDeclare *id) {
+    auto it = _declaresIdx.find(id);
+    if (it == _declaresIdx.end()) {
+        throw ByteCodeCacheException();
+    }
+    return (*it).second;
+}
+
+void ByteCodeCacheWriter::writeString(BinaryOutputStream &stream, const StringView &str) {
+    stream.writeUInt32(str.len);
+    stream.write(str.data, str.len);
+}
+
+void ByteCodeCacheWriter::writeFunctions(BinaryOutputStream &stream, const VecFunctions &functions) {
+    stream.writeUInt32((uint32_t)functions.size());
+    for (auto f : functions) {
+        stream.writeUInt32(indexOfFunction(f));
+    }
+}
+
+void ByteCodeCacheWriter::writeResourcePool(BinaryOutputStream &stream) {
+    auto resPool = _root->resourcePool;
+
+    stream.writeUInt32((uint32_t)resPool->strings.size());
+    for (auto &s : resPool->strings) {
+        writeString(stream, s.utf8Str());
+    }
+
+    stream.writeUInt32((uint32_t)resPool->doubles.size());
+    for (auto d : resPool->doubles) {
+        stream.writeDouble(d);
+    }
+
+    stream.writeUInt32((uint32_t)resPool->regexps.size());
+    for (auto &item : resPool->regexps) {
+        // str 为 /pattern/flags 的原始字符串，加载时重新编译
+        writeString(stream, item.str);
+        stream.writeUInt32(item.program->flags());
+    }
+
+    stream.writeUInt32((uint32_t)resPool->switchCaseJumps.size());
+    for (auto &item : resPool->switchCaseJumps) {
+        stream.writeUInt32(item.defaultAddr);
+        stream.writeUInt32((uint32_t)(item.caseJumpsEnd - item.caseJumps));
+        for (auto p = item.caseJumps; p < item.caseJumpsEnd; p++) {
+            auto cond = p->caseConds;
+            if (isJsValueInResourcePool(cond)) {
+                cond.value.index = makeResourceIndex(0, (uint16_t)cond.value.index);
+            }
+            stream.writeUInt64(cond.bits);
+            stream.writeUInt64(cond.numberBits);
+            stream.writeUInt32(p->addr);
+        }
+    }
+}
+
+void ByteCodeCacheWriter::writeGlobals(BinaryOutputStream &stream) {
+    // 代码片段中的 eval 会使全局 scope 也 hasEval
+    stream.writeUInt8(_root->scope->hasEval);
+
+    stream.writeUInt32((uint32_t)_globals.size());
+    for (auto index : _globals) {
+        stream.writeUInt32(index);
+        writeString(stream, _globalDeclares[index]->name);
+        stream.writeUInt8(_globalsDeclared[index]);
+    }
+}
+
+void ByteCodeCacheWriter::writeFunctionsAndScopes(BinaryOutputStream &stream) {
+    // 创建 Function 和 Scope 所需要的信息
+    stream.writeUInt32((uint32_t)_functions.size());
+    for (auto f : _functions) {
+        stream.writeUInt32((uint32_t)f->scopes.size());
+        stream.writeUInt16(f->index);
+        stream.writeUInt8(f->isCodeBlock);
+        stream.writeUInt8(f->isArrowFunction);
+    }
+
+    stream.writeUInt32((uint32_t)_declares.size());
+    for (auto id : _declares) {
+        writeString(stream, id->name);
+        stream.writeUInt32(indexOfScope(id->scope, false));
+        stream.writeUInt8(packDeclareFlags(id));
+        stream.writeUInt8(id->varStorageType);
+        stream.writeUInt16(id->storageIndex);
+        stream.writeUInt32(id->isFuncName ? indexOfFunction(id->value.function) : IDX_NONE);
+    }
+
+    for (auto scope : _scopes) {
+        stream.writeUInt32(scope->parent ? indexOfScope(scope->parent, false) : IDX_NONE);
+        stream.writeUInt32(scope->child ? indexOfScope(scope->child, true) : IDX_NONE);
+        stream.writeUInt32(scope->sibling ? indexOfScope(scope->sibling, true) : IDX_NONE);
+        stream.writeUInt16(scope->countLocalVars);
+        stream.writeUInt16(scope->countArguments);
+        stream.writeUInt8((uint8_t)scope->depth);
+        stream.writeUInt8(packScopeFlags(scope));
+
+        writeFunctions(stream, scope->functions);
+        writeFunctions(stream, scope->functionDecls);
+        if (scope->functionArgs) {
+            stream.writeUInt8(1);
+            writeFunctions(stream, *scope->functionArgs);
+        } else {
+            stream.writeUInt8(0);
+        }
+
+        stream.writeUInt32((uint32_t)scope->varDeclares.size());
+        for (auto &item : scope->varDeclares) {
+            stream.writeUInt32(indexOfDeclare(item.second));
+        }
+    }
+
+    for (auto f : _functions) {
+        writeString(stream, f->name);
+
+        // 源代码保存为在 code 中的位置
+        auto &src = f->srcCode;
+        if (src.len > 0 && src.data >= _code.data && src.data + src.len <= _code.data + _code.len) {
+            stream.writeUInt32((uint32_t)(src.data - _code.data));
+            stream.writeUInt32(src.len);
+        } else {
+            stream.writeUInt32(IDX_NONE);
+            writeString(stream, src);
+        }
+
+        stream.writeUInt32((uint32_t)f->line);
+        stream.writeUInt32((uint32_t)f->col);
+        stream.writeUInt16(packFunctionFlags(f));
+        stream.writeUInt32(f->declare ? indexOfDeclare(f->declare) : IDX_NONE);
+
+        stream.writeUInt32((uint32_t)f->lenByteCode);
+        stream.write(f->bytecode, f->lenByteCode);
+        stream.writeUInt16(f->countInlineCaches);
+
+        writeFunctions(stream, f->functions);
+    }
+}
+
+class ByteCodeCacheReader {
+public:
+    ByteCodeCacheReader(VMRuntime *runtime, ResourcePool *resPool, const StringView &payload)
+        : _runtime(runtime), _resPool(resPool), _pool(resPool->pool), _is(payload) { }
+
+    Function *read(const StringView &code);
+
+    const VecFunctions &functions() const { return _functions; }
+    const VecScopes &scopes() const { return _scopes; }
+
+protected:
+    StringView readString();
+    Function *readFunction();
+    void readFunctions(VecFunctions &functions);
+    Scope *scopeAt(uint32_t index);
+
+    void readResourcePool();
+    void readGlobals();
+    Function *readFunctionsAndScopes(const StringView &code);
+    void relocateGlobals();
+
+protected:
+    struct GlobalVar {
+        uint32_t                index;
+        StringView              name;
+        bool                    isDeclared;
+    };
+
+    VMRuntime                   *_runtime;
+    ResourcePool                *_resPool;
+    AllocatorPool               &_pool;
+    BinaryInputStream           _is;
+
+    VecFunctions                _functions;
+    VecScopes                   _scopes;
+    std::vector<IdentifierDeclare *> _declares;
+
+    bool                        _hasEval;
+    std::vector<GlobalVar>      _globals;
+
+};
+
+Function *ByteCodeCacheReader::read(const StringView &code) {
+    readResourcePool();
+    readGlobals();
+    auto root = readFunctionsAndScopes(code);
+
+    if (_is.isRemaining()) {
+        throw ByteCodeCacheException();
+    }
+
+    relocateGlobals();
+
+    return root;
+}
+
+StringView ByteCodeCacheReader::readString() {
+    auto len = _is.readUInt32();
+    return _pool.duplicate(_is.readString(len));
+}
+
+Function *ByteCodeCacheReader::readFunction() {
+    auto index = _is.readUInt32();
+    if (index >= _functions.size()) {
+        throw ByteCodeCacheException();
+    }
+    return _functions[index];
+}
+
+void ByteCodeCacheReader::readFunctions(VecFunctions &functions) {
+    auto count = _is.readUInt32();
+    functions.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        functions.push_back(readFunction());
+    }
+}
+
+Scope *ByteCodeCacheReader::scopeAt(uint32_t index) {
+    if (index == IDX_NONE) {
+        return nullptr;
+    } else if (index == IDX_GLOBAL_SCOPE) {
+        return _runtime->globalScope()->scopeDsc;
+    } else if (index >= _scopes.size()) {
+        throw ByteCodeCacheException();
+    }
+    return _scopes[index];
+}
+
+void ByteCodeCacheReader::readResourcePool() {
+    auto count = _is.readUInt32();
+    for (uint32_t i = 0; i < count; i++) {
+        _resPool->strings.push_back(StringViewUtf16(readString()));
+    }
+
+    count = _is.readUInt32();
+    _resPool->doubles.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        auto bits = _is.readUInt64();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        _resPool->doubles.push_back(d);
+    }
+
+    count = _is.readUInt32();
+    _resPool->regexps.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        auto str = readString();
+        auto flags = _is.readUInt32();
+
+        // str 为: /pattern/flags
+        auto end = str.data + str.len;
+        while (end > str.data && end[-1] != '/') {
+            end--;
+        }
+        if (end - str.data < 2) {
+            throw ByteCodeCacheException();
+        }
+
+        string error;
+        auto program = JsRegExpProgram::compile(StringView(str.data + 1, end - 1 - (str.data + 1)), flags, error);
+        if (!program) {
+            throw ByteCodeCacheException();
+        }
+        _resPool->regexps.push_back({ str, program });
+    }
+
+    count = _is.readUInt32();
+    _resPool->switchCaseJumps.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        SwitchJump switchJump;
+        switchJump.stmtSwitch = nullptr;
+        switchJump.defaultAddr = _is.readUInt32();
+
+        auto countCases = _is.readUInt32();
+        switchJump.caseJumps = (CaseJump *)_pool.allocate(sizeof(CaseJump) * countCases);
+        switchJump.caseJumpsEnd = switchJump.caseJumps + countCases;
+        for (auto p = switchJump.caseJumps; p < switchJump.caseJumpsEnd; p++) {
+            p->caseConds.bits = _is.readUInt64();
+            p->caseConds.numberBits = _is.readUInt64();
+            if (isJsValueInResourcePool(p->caseConds)) {
+                p->caseConds.value.index = makeResourceIndex(_resPool->index, (uint16_t)p->caseConds.value.index);
+            }
+            p->addr = _is.readUInt32();
+        }
+
+        _resPool->switchCaseJumps.push_back(switchJump);
+    }
+}
+
+void ByteCodeCacheReader::readGlobals() {
+    _hasEval = _is.readUInt8() != 0;
+
+    auto count = _is.readUInt32();
+    _globals.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        GlobalVar var;
+        var.index = _is.readUInt32();
+        var.name = _is.readString(_is.readUInt32());
+        var.isDeclared = _is.readUInt8() != 0;
+        _globals.push_back(var);
+    }
+}
+
+Function *ByteCodeCacheReader::readFunctionsAndScopes(const StringView &code) {
+    auto count = _is.readUInt32();
+    if (count == 0) {
+        throw ByteCodeCacheException();
+    }
+
+    _functions.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        auto countScopes = _is.readUInt32();
+        auto index = _is.readUInt16();
+        bool isCodeBlock = _is.readUInt8() != 0;
+        bool isArrowFunction = _is.readUInt8() != 0;
+        if (countScopes == 0) {
+            throw ByteCodeCacheException();
+        }
+
+        auto f = PoolNew(_pool, Function)(_resPool, nullptr, index, isCodeBlock, isArrowFunction);
+        _functions.push_back(f);
+        _scopes.push_back(f->scope);
+
+        for (uint32_t k = 1; k < countScopes; k++) {
+            _scopes.push_back(PoolNew(_pool, Scope)(_resPool, f, nullptr));
+        }
+    }
+
+    count = _is.readUInt32();
+    _declares.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        auto name = readString();
+        auto scope = scopeAt(_is.readUInt32());
+        if (scope == nullptr) {
+            throw ByteCodeCacheException();
+        }
+
+        auto id = PoolNew(_pool, IdentifierDeclare)(name, scope);
+        unpackDeclareFlags(id, _is.readUInt8());
+        id->varStorageType = (VarStorageType)_is.readUInt8();
+        id->storageIndex = _is.readUInt16();
+        if (id->isFuncName) {
+            id->value.function = readFunction();
+        } else if (_is.readUInt32() != IDX_NONE) {
+            throw ByteCodeCacheException();
+        }
+        _declares.push_back(id);
+    }
+
+    for (auto scope : _scopes) {
+        scope->parent = scopeAt(_is.readUInt32());
+        scope->child = scopeAt(_is.readUInt32());
+        scope->sibling = scopeAt(_is.readUInt32());
+        scope->countLocalVars = _is.readUInt16();
+        scope->countArguments = _is.readUInt16();
+        scope->depth = (int8_t)_is.readUInt8();
+        unpackScopeFlags(scope, _is.readUInt8());
+
+        readFunctions(scope->functions);
+        readFunctions(scope->functionDecls);
+        if (_is.readUInt8()) {
+            scope->functionArgs = PoolNew(_pool, VecFunctions);
+            readFunctions(*scope->functionArgs);
+        }
+
+        auto countDeclares = _is.readUInt32();
+        for (uint32_t i = 0; i < countDeclares; i++) {
+            auto index = _is.readUInt32();
+            if (index >= _declares.size()) {
+                throw ByteCodeCacheException();
+            }
+            auto id = _declares[index];
+            scope->varDeclares[id->name] = id;
+        }
+    }
+
+    for (auto f : _functions) {
+        f->name = readString();
+
+        auto offset = _is.readUInt32();
+        if (offset == IDX_NONE) {
+            f->srcCode = readString();
+        } else {
+            auto len = _is.readUInt32();
+            if ((uint64_t)offset + len > code.len) {
+                throw ByteCodeCacheException();
+            }
+            f->srcCode = StringView(code.data + offset, len);
+        }
+
+        f->line = (int)_is.readUInt32();
+        f->col = (int)_is.readUInt32();
+        unpackFunctionFlags(f, _is.readUInt16());
+
+        auto declareIdx = _is.readUInt32();
+        if (declareIdx != IDX_NONE) {
+            if (declareIdx >= _declares.size()) {
+                throw ByteCodeCacheException();
+            }
+            f->declare = _declares[declareIdx];
+        }
+
+        auto lenByteCode = _is.readUInt32();
+        if (lenByteCode > 0) {
+            f->bytecode = (uint8_t *)_pool.duplicate(_is.readString(lenByteCode)).data;
+            f->lenByteCode = (int)lenByteCode;
+        }
+        f->allocateInlineCaches(_is.readUInt16());
+
+        readFunctions(f->functions);
+    }
+
+    // 代码片段的 parent 是全局 scope
+    auto root = _functions[0];
+    if (!root->isCodeBlock || root->scope->parent != _runtime->globalScope()->scopeDsc) {
+        throw ByteCodeCacheException();
+    }
+
+    return root;
+}
+
+/**
+ * 按照名字在全局 scope 中查找缓存中引用的全局变量，找不到则和 JSParser 一样添加声明，再替换 bytecode 和声明中的索引.
+ */
+void ByteCodeCacheReader::relocateGlobals() {
+    std::vector<uint8_t *> operands;
+    for (auto f : _functions) {
+        findGlobalVarOperands(f->bytecode, f->lenByteCode, operands);
+    }
+
+    // 先检查所有的索引都有效，之后才能修改全局 scope
+    std::unordered_map<uint32_t, uint16_t> indices;
+    for (auto &var : _globals) {
+        indices[var.index] = 0;
+    }
+    for (auto p : operands) {
+        if (indices.find(*(uint16_t *)p) == indices.end()) {
+            throw ByteCodeCacheException();
+        }
+    }
+    for (auto id : _declares) {
+        if (id->varStorageType == VST_GLOBAL_VAR && indices.find(id->storageIndex) == indices.end()) {
+            throw ByteCodeCacheException();
+        }
+    }
+
+    auto globalScopeDsc = _runtime->globalScope()->scopeDsc;
+    if (_hasEval) {
+        globalScopeDsc->setHasEval();
+    }
+
+    for (auto &var : _globals) {
+        auto id = globalScopeDsc->getVarDeclarationByName(var.name);
+        if (id == nullptr) {
+            id = globalScopeDsc->addVarDeclaration(var.name);
+            id->isImplicitDeclaration = !var.isDeclared;
+            id->varStorageType = VST_GLOBAL_VAR;
+            id->storageIndex = globalScopeDsc->countLocalVars++;
+        }
+        indices[var.index] = id->storageIndex;
+    }
+
+    for (auto p : operands) {
+        *(uint16_t *)p = indices[*(uint16_t *)p];
+    }
+
+    for (auto id : _declares) {
+        if (id->varStorageType == VST_GLOBAL_VAR) {
+            id->storageIndex = indices[id->storageIndex];
+        }
+    }
+}
+
+bool serializeByteCodeCache(VMRuntime *runtime, Function *root, const StringView &code, BinaryOutputStream &stream, VecFunctions *functionsOut, VecScopes *scopesOut) {
+    try {
+        ByteCodeCacheWriter writer(runtime, root, code);
+        writer.write(stream);
+        if (functionsOut) { *functionsOut = writer.functions(); }
+        if (scopesOut) { *scopesOut = writer.scopes(); }
+        return true;
+    } catch (ByteCodeCacheException &) {
+        return false;
+    }
+}
+
+Function *deserializeByteCodeCache(VMRuntime *runtime, ResourcePool *resPool, const StringView &code, const StringView &cache, VecFunctions *functionsOut, VecScopes *scopesOut) {
+    ByteCodeCacheHeader header;
+    if (cache.len < sizeof(header)) {
+        return nullptr;
+    }
+
+    memcpy(&header, cache.data, sizeof(header));
+    if (header.magic != BYTE_CODE_CACHE_MAGIC || header.version != BYTE_CODE_CACHE_VERSION
+        || header.lenSource != code.len || header.lenPayload != cache.len - sizeof(header)
+        || header.fingerprint != byteCodeCacheFingerprint()) {
+        return nullptr;
+    }
+
+    StringView payload(cache.data + sizeof(header), (uint32_t)header.lenPayload);
+    if (header.sourceHash != hashBytes(code.data, code.len) || header.payloadHash != hashBytes(payload.data, payload.len)) {
+        return nullptr;
+    }
+
+    try {
+        ByteCodeCacheReader reader(runtime, resPool, payload);
+        auto root = reader.read(code);
+        if (functionsOut) { *functionsOut = reader.functions(); }
+        if (scopesOut) { *scopesOut = reader.scopes(); }
+        return root;
+    } catch (ByteCodeCacheException &) {
+        return nullptr;
+    } catch (std::out_of_range &) {
+        return nullptr;
+    }
+}
@@ -0,0 +1,45 @@
+﻿//
+//  ByteCodeCache.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/13.
+//
+
+#ifndef ByteCodeCache_hpp
+#define ByteCodeCache_hpp
+
+#include <vector>
+#include "utils/BinaryStream.h"
+
+
+class Function;
+class Scope;
+class ResourcePool;
+class VMRuntime;
+
+using VecFunctions = std::vector<Function *>;
+using VecScopes = std::vector<Scope *>;
+
+// 修改了缓存的格式后，需要增加版本号
+#define BYTE_CODE_CACHE_VERSION     4
+
+/**
+ * 将解析后的 Function 树序列化为二进制格式，再次执行相同的源代码时，直接加载，跳过词法和语法分析.
+ *
+ * 缓存中包括所有函数的 bytecode, Scope 和 IdentifierDeclare, 以及 ResourcePool 中的 strings/doubles/regexps/switch jumps.
+ * 全局变量按照名字保存，加载时在 VMRuntime 的全局 scope 中重新查找或分配索引.
+ * 缓存的版本、opcode 的定义、common 字符串/double 或者源代码的 hash 有任何不同，缓存都会失效.
+ */
+
+// root 为 JSParser::parse 返回的代码片段，code 为其源代码. 会生成所有函数的 bytecode.
+// 缓存中不能表示的情况，返回 false
+// functionsOut/scopesOut 不为空时，返回 Function 和 Scope 在缓存中的顺序，和加载后 deserializeByteCodeCache 返回的顺序相同.
+bool serializeByteCodeCache(VMRuntime *runtime, Function *root, const StringView &code, BinaryOutputStream &stream,
+    VecFunctions *functionsOut = nullptr, VecScopes *scopesOut = nullptr);
+
+// 从 cache 中加载 Function 树到 resPool 中，code 需要已经复制到 resPool 中 (Function::srcCode 会引用 code).
+// cache 无效或者和 code 不匹配时，返回 nullptr. 失败时 resPool 中可能有部分加载的内容，不能再用于解析.
+Function *deserializeByteCodeCache(VMRuntime *runtime, ResourcePool *resPool, const StringView &code, const StringView &cache,
+    VecFunctions *functionsOut = nullptr, VecScopes *scopesOut = nullptr);
+
+#endif /* ByteCodeCache_hpp */
@@ -0,0 +1,595 @@
+﻿//
+//  JsonParser.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/19.
+//
+
+#include "JsonParser.hpp"
+#include "VirtualMachine.hpp"
+#include "objects/JsObject.hpp"
+#include "objects/JsArray.hpp"
+#include "utils/CharEncoding.h"
+#include "utils/StringEx.h"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2_SCAN       1
+#endif
+
+
+// 保存字符串的 buffer 的大小. 只要还有一个字符串被引用，整个 buffer 就不会被释放，所以不能太大
+const uint32_t JSON_STRING_BUFFER_SIZE = 1024 * 256;
+
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+inline bool isJsonWhitespace(uint8_t c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static const uint8_t *skipBlanks(const uint8_t *p, const uint8_t *end) {
+#if USE_SSE2_SCAN
+    // 缩进较长时每次检查 16 个字节
+    while (p + 16 <= end && isJsonWhitespace(*p)) {
+        auto v = _mm_loadu_si128((const __m128i *)p);
+        auto blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+        uint32_t mask = ~_mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    while (p < end && isJsonWhitespace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * 返回 p 之后第一个 '"', '\\' 或者控制字符的位置，有非 ascii 字符时设置 hasNonAscii
+ */
+static const uint8_t *scanStringChars(const uint8_t *p, const uint8_t *end, bool &hasNonAscii) {
+#if USE_SSE2_SCAN
+    auto quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), space = _mm_set1_epi8(0x20);
+    uint32_t high = 0;
+    while (p + 16 <= end) {
+        auto v = _mm_loadu_si128((const __m128i *)p);
+        uint32_t highMask = _mm_movemask_epi8(v);
+        // 有符号比较时 >= 0x80 的字节也小于 0x20, 需要去掉
+        uint32_t mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)))
+            | (_mm_movemask_epi8(_mm_cmplt_epi8(v, space)) & ~highMask);
+        if (mask) {
+            auto i = __builtin_ctz(mask);
+            high |= highMask & ((1u << i) - 1);
+            hasNonAscii |= high != 0;
+            return p + i;
+        }
+        high |= highMask;
+        p += 16;
+    }
+    hasNonAscii |= high != 0;
+#endif
+
+    for (; p < end; p++) {
+        auto c = *p;
+        if (c == '"' || c == '\\' || c < 0x20) {
+            return p;
+        }
+        if (c >= 0x80) {
+            hasNonAscii = true;
+        }
+    }
+    return end;
+}
+
+static bool readHex4(const uint8_t *p, const uint8_t *end, uint32_t &codeOut) {
+    if (end - p < 4) {
+        return false;
+    }
+
+    uint32_t code = 0;
+    for (int i = 0; i < 4; i++) {
+        auto c = p[i];
+        if (!isHexChar(c)) {
+            return false;
+        }
+        code = code * 16 + (isDigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    codeOut = code;
+    return true;
+}
+
+JsonParser::JsonParser(VMContext *ctx) : _ctx(ctx), _runtime(ctx->runtime) {
+    _start = _p = _end = nullptr;
+    _depth = 0;
+    _buffer = nullptr;
+    _errorMessage = nullptr;
+    _errorOffset = 0;
+}
+
+JsonParser::~JsonParser() {
+    if (_buffer) {
+        _runtime->releaseStringBuffer(_buffer);
+    }
+}
+
+inline void JsonParser::skipWhitespace() {
+    if (_p < _end && isJsonWhitespace(*_p)) {
+        _p = skipBlanks(_p, _end);
+    }
+}
+
+bool JsonParser::parse(const StringView &str, JsValue &valueOut) {
+    _start = _p = (const uint8_t *)str.data;
+    _end = _start + str.len;
+    _values.clear();
+    _depth = 0;
+
+    JsValue value;
+    while (true) {
+        // 解析一个值
+        skipWhitespace();
+        if (_p >= _end) {
+            return error("Unexpected end of JSON input");
+        }
+
+        auto c = *_p;
+        if (c == '{' || c == '[') {
+            _p++;
+            if (_depth == _frames.size()) {
+                _frames.emplace_back();
+            }
+            auto &frame = _frames[_depth++];
+            frame.isArray = c == '[';
+            frame.first = (uint32_t)_values.size();
+            frame.shape = _runtime->shapeTree()->root();
+            frame.obj = nullptr;
+            frame.duplicatedSlot = -1;
+
+            skipWhitespace();
+            if (_p < _end && *_p == (frame.isArray ? ']' : '}')) {
+                _p++;
+                value = frame.isArray ? finishArray() : finishObject();
+            } else if (frame.isArray) {
+                continue;
+            } else {
+                if (!parseKey(frame)) {
+                    return false;
+                }
+                continue;
+            }
+        } else if (c == '"') {
+            if (!parseString(value)) {
+                return false;
+            }
+        } else if (c == '-' || isDigit(c)) {
+            if (!parseNumber(value)) {
+                return false;
+            }
+        } else if (c == 't' && _end - _p >= 4 && memcmp(_p, "true", 4) == 0) {
+            _p += 4;
+            value = jsValueTrue;
+        } else if (c == 'f' && _end - _p >= 5 && memcmp(_p, "false", 5) == 0) {
+            _p += 5;
+            value = jsValueFalse;
+        } else if (c == 'n' && _end - _p >= 4 && memcmp(_p, "null", 4) == 0) {
+            _p += 4;
+            value = jsValueNull;
+        } else {
+            return error("Unexpected token");
+        }
+
+        // 值已经结束，添加到所在的对象或者数组中
+        while (true) {
+            if (_depth == 0) {
+                skipWhitespace();
+                if (_p < _end) {
+                    return error("Unexpected non-whitespace character after JSON");
+                }
+                valueOut = value;
+                return true;
+            }
+
+            auto &frame = _frames[_depth - 1];
+            addValue(frame, value);
+
+            skipWhitespace();
+            if (_p >= _end) {
+                return error("Unexpected end of JSON input");
+            }
+
+            c = *_p;
+            if (c == ',') {
+                _p++;
+                if (!frame.isArray && !parseKey(frame)) {
+                    return false;
+                }
+                break;
+            } else if (c == (frame.isArray ? ']' : '}')) {
+                _p++;
+                value = frame.isArray ? finishArray() : finishObject();
+            } else {
+                return error(frame.isArray ? "Expected ',' or ']' after array element" : "Expected ',' or '}' after property value");
+            }
+        }
+    }
+}
+
+/**
+ * 解析属性名和之后的 ':', 并找到属性对应的 shape
+ */
+bool JsonParser::parseKey(Frame &frame) {
+    skipWhitespace();
+    if (_p >= _end || *_p != '"') {
+        return error(_p >= _end ? "Unexpected end of JSON input" : "Expected property name");
+    }
+
+    const uint8_t *end;
+    bool hasEscape, isAnsi;
+    if (!scanString(end, hasEscape, isAnsi)) {
+        return false;
+    }
+
+    StringView key;
+    if (hasEscape) {
+        _keyBuf.resize(end - _p - 1);
+        auto out = (uint8_t *)&_keyBuf[0];
+        uint8_t *outEnd;
+        if (!unescapeString(_p + 1, end, out, outEnd, isAnsi)) {
+            return false;
+        }
+        key = StringView(out, outEnd - out);
+    } else {
+        key = StringView(_p + 1, end - _p - 1);
+    }
+
+    _p = end + 1;
+    skipWhitespace();
+    if (_p >= _end || *_p != ':') {
+        return error("Expected ':' after property name");
+    }
+    _p++;
+
+    if (frame.shape) {
+        // 和上一个相同结构的对象的属性相同
+        auto next = frame.shape->lastTransition();
+        if (next && next->lastName().equal(key)) {
+            frame.shape = next;
+            return true;
+        }
+
+        if (key.equal(SS___PROTO__)) {
+            // __proto__ 和 setByName 相同，修改对象的原型
+            toGenericObject(frame);
+        } else {
+            // 先不添加 atom, 对象转为字典模式时 key 不需要占用 atom 表
+            auto atom = frame.shape->atoms()->find(key);
+            if (atom != JS_ATOM_NONE) {
+                auto index = frame.shape->find(atom);
+                if (index >= 0) {
+                    frame.duplicatedSlot = index;
+                    return true;
+                }
+                next = frame.shape->addProperty(atom);
+            } else {
+                next = frame.shape->addProperty(key);
+            }
+            if (next) {
+                frame.shape = next;
+                return true;
+            }
+
+            // 属性过多，需要转为字典模式
+            toGenericObject(frame);
+        }
+    }
+
+    frame.key.assign(key.data, key.len);
+    return true;
+}
+
+bool JsonParser::parseString(JsValue &valueOut) {
+    const uint8_t *end;
+    bool hasEscape, isAnsi;
+    if (!scanString(end, hasEscape, isAnsi)) {
+        return false;
+    }
+
+    auto src = _p + 1;
+    uint32_t len = (uint32_t)(end - src);
+    auto data = beginString(len);
+    uint8_t *dataEnd;
+    if (hasEscape) {
+        if (!unescapeString(src, end, data, dataEnd, isAnsi)) {
+            return false;
+        }
+    } else {
+        memcpy(data, src, len);
+        dataEnd = data + len;
+    }
+
+    _p = end + 1;
+    valueOut = endString(data, (uint32_t)(dataEnd - data), isAnsi);
+    return true;
+}
+
+bool JsonParser::parseNumber(JsValue &valueOut) {
+    auto start = _p;
+    bool isNegative = false;
+    if (*_p == '-') {
+        isNegative = true;
+        _p++;
+    }
+
+    // 最多 19 位有效数字，超过时使用 strtod
+    uint64_t mantissa = 0;
+    int countDigits = 0, exponent = 0;
+    bool isTooLong = false;
+
+    if (_p < _end && *_p == '0') {
+        _p++;
+    } else if (_p < _end && isDigit(*_p)) {
+        for (; _p < _end && isDigit(*_p); _p++) {
+            if (countDigits < 19) {
+                mantissa = mantissa * 10 + (*_p - '0');
+                countDigits++;
+            } else {
+                isTooLong = true;
+            }
+        }
+    } else {
+        return error("No number after minus sign");
+    }
+
+    if (_p < _end && *_p == '.') {
+        _p++;
+        if (_p >= _end || !isDigit(*_p)) {
+            return error("Unterminated fractional number");
+        }
+        for (; _p < _end && isDigit(*_p); _p++) {
+            if (countDigits < 19) {
+                mantissa = mantissa * 10 + (*_p - '0');
+                countDigits++;
+                exponent--;
+            } else {
+                isTooLong = true;
+            }
+        }
+    }
+
+    if (_p < _end && (*_p == 'e' || *_p == 'E')) {
+        _p++;
+        bool isExpNegative = false;
+        if (_p < _end && (*_p == '+' || *_p == '-')) {
+            isExpNegative = *_p == '-';
+            _p++;
+        }
+        if (_p >= _end || !isDigit(*_p)) {
+            return error("Exponent part is missing a number");
+        }
+
+        int n = 0;
+        for (; _p < _end && isDigit(*_p); _p++) {
+            if (n < 100000) {
+                n = n * 10 + (*_p - '0');
+            }
+        }
+        exponent += isExpNegative ? -n : n;
+    }
+
+    double d;
+    if (!isTooLong && exponent == 0) {
+        if (mantissa <= (uint64_t)MAX_INT32 + (isNegative ? 1 : 0) && !(isNegative && mantissa == 0)) {
+            valueOut = makeJsValueInt32(isNegative ? (int32_t)(0 - mantissa) : (int32_t)mantissa);
+            return true;
+        }
+        d = (double)mantissa;
+    } else if (!isTooLong && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22) {
+        // mantissa 和 10 的幂都可以精确表示为 double, 一次乘除的结果是正确舍入的
+        d = exponent > 0 ? mantissa * POW10[exponent] : mantissa / POW10[-exponent];
+    } else {
+        string buf((const char *)start, _p - start);
+        valueOut = _runtime->pushDouble(strtod(buf.c_str(), nullptr));
+        return true;
+    }
+
+    if (isNegative) {
+        d = -d;
+    }
+
+    if (d >= -MAX_INT32 - 1 && d <= MAX_INT32 && d == (int32_t)d && !(d == 0 && std::signbit(d))) {
+        valueOut = makeJsValueInt32((int32_t)d);
+    } else {
+        valueOut = _runtime->pushDouble(d);
+    }
+    return true;
+}
+
+/**
+ * _p 为字符串开始的 '"', endOut 为结束的 '"' 的位置
+ */
+bool JsonParser::scanString(const uint8_t *&endOut, bool &hasEscapeOut, bool &isAnsiOut) {
+    auto p = _p + 1;
+    bool hasNonAscii = false, hasEscape = false;
+
+    while (true) {
+        p = scanStringChars(p, _end, hasNonAscii);
+        if (p >= _end) {
+            _p = _end;
+            return error("Unterminated string in JSON");
+        }
+
+        auto c = *p;
+        if (c == '"') {
+            break;
+        } else if (c == '\\') {
+            // 转义的字符在 unescapeString 中检查
+            hasEscape = true;
+            p += 2;
+        } else {
+            _p = p;
+            return error("Bad control character in string literal");
+        }
+    }
+
+    endOut = p;
+    hasEscapeOut = hasEscape;
+    isAnsiOut = !hasNonAscii;
+    return true;
+}
+
+/**
+ * 将 [p, end) 中的转义字符解码到 out 中，解码后的长度不会超过 end - p
+ */
+bool JsonParser::unescapeString(const uint8_t *p, const uint8_t *end, uint8_t *out, uint8_t *&outEnd, bool &isAnsi) {
+    while (p < end) {
+        auto escape = (const uint8_t *)memchr(p, '\\', end - p);
+        if (!escape) {
+            escape = end;
+        }
+        memcpy(out, p, escape - p);
+        out += escape - p;
+        p = escape;
+        if (p >= end) {
+            break;
+        }
+
+        // scanString 保证了转义字符之后还有字符
+        auto c = p[1];
+        p += 2;
+        switch (c) {
+            case '"': case '\\': case '/': *out++ = c; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                uint32_t code, low;
+                if (!readHex4(p, end, code)) {
+                    _p = p;
+                    return error("Bad Unicode escape in JSON");
+                }
+                p += 4;
+
+                if (code >= 0xD800 && code <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u'
+                    && readHex4(p + 2, end, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    // surrogate pair
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+
+                if (code >= 0x80) {
+                    isAnsi = false;
+                }
+                out += utf32CodeToUtf8(code, out);
+                break;
+            }
+            default:
+                _p = p - 1;
+                return error("Bad escaped character in JSON");
+        }
+    }
+
+    outEnd = out;
+    return true;
+}
+
+void JsonParser::addValue(Frame &frame, const JsValue &value) {
+    if (frame.isArray) {
+        _values.push_back(value);
+    } else if (frame.shape) {
+        if (frame.duplicatedSlot >= 0) {
+            // 重复的属性，后面的值覆盖前面的
+            _values[frame.first + frame.duplicatedSlot] = value;
+            frame.duplicatedSlot = -1;
+        } else {
+            _values.push_back(value);
+        }
+    } else {
+        frame.obj->setByName(_ctx, frame.obj->self, frame.key, value);
+    }
+}
+
+/**
+ * 不能再使用 shape 时，先创建对象，剩下的属性按照通用的方式设置
+ */
+void JsonParser::toGenericObject(Frame &frame) {
+    assert(frame.shape && frame.duplicatedSlot == -1);
+
+    auto obj = new JsObject();
+    obj->initWithShape(frame.shape, _values.data() + frame.first, (uint32_t)(_values.size() - frame.first));
+    _values.resize(frame.first);
+    _runtime->pushObject(obj);
+
+    frame.shape = nullptr;
+    frame.obj = obj;
+}
+
+JsValue JsonParser::finishObject() {
+    auto &frame = _frames[--_depth];
+    assert(!frame.isArray);
+
+    if (!frame.shape) {
+        return frame.obj->self;
+    }
+
+    auto obj = new JsObject();
+    obj->initWithShape(frame.shape, _values.data() + frame.first, (uint32_t)(_values.size() - frame.first));
+    _values.resize(frame.first);
+    return _runtime->pushObject(obj);
+}
+
+JsValue JsonParser::finishArray() {
+    auto &frame = _frames[--_depth];
+    assert(frame.isArray);
+
+    auto arr = new JsArray();
+    auto count = (uint32_t)(_values.size() - frame.first);
+    if (count > 0) {
+        arr->push(_ctx, _values.data() + frame.first, count);
+        _values.resize(frame.first);
+    }
+    return _runtime->pushObject(arr);
+}
+
+/**
+ * 返回可以写入 maxLen 个字节的位置，写入后调用 endString()
+ */
+uint8_t *JsonParser::beginString(uint32_t maxLen) {
+    const uint32_t sizeHeader = sizeof(uint32_t);
+    if (!_buffer || _buffer->len + sizeHeader + maxLen > _buffer->capacity) {
+        if (_buffer) {
+            _runtime->releaseStringBuffer(_buffer);
+        }
+
+        // 剩下的字符串不会超过剩下的 JSON 的长度
+        auto capacity = std::min(JSON_STRING_BUFFER_SIZE, (uint32_t)(_end - _p) + sizeHeader);
+        _buffer = _runtime->allocStringBuffer(std::max(capacity, maxLen + sizeHeader));
+        _buffer->refCount++;
+    }
+
+    return _buffer->beginSlice();
+}
+
+JsValue JsonParser::endString(uint8_t *data, uint32_t len, bool isAnsi) {
+    if (len <= 1) {
+        // 和 pushString 相同，短字符串不需要保存
+        return len == 0 ? jsStringValueEmpty : makeJsValueChar(data[0]);
+    }
+
+    _buffer->endSlice(data + len);
+    _buffer->refCount++;
+
+    JsString js;
+    js.isInStringBuffer = true;
+    js.value.str = StringViewUtf16(data, len, isAnsi);
+    return _runtime->pushString(js);
+}
@@ -0,0 +1,94 @@
+﻿//
+//  JsonParser.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/19.
+//
+
+#ifndef JsonParser_hpp
+#define JsonParser_hpp
+
+#include "VirtualMachineTypes.hpp"
+
+
+class VMContext;
+class VMRuntime;
+class JsShape;
+class JsObject;
+
+/**
+ * JSON.parse 的解析器，直接创建 JsObject/JsArray 和字符串的值:
+ * - 对象的属性先放在 _values 中，对象结束时按照最终的 shape 一次性创建. 属性名和 shape 的 lastTransition()
+ *   相同时不需要查找 atom，所以数组中相同结构的记录只需比较属性名.
+ * - 字符串的数据依次复制到共享的 JsStringBuffer 中，不需要为每个字符串分配内存.
+ * - 整数保存为 JDT_INT32.
+ * - 不使用递归，嵌套的层数不受栈大小的限制.
+ */
+class JsonParser {
+public:
+    JsonParser(VMContext *ctx);
+    ~JsonParser();
+
+    /**
+     * 解析 str, 失败时返回 false, errorMessage() 和 errorOffset() 为错误信息
+     */
+    bool parse(const StringView &str, JsValue &valueOut);
+
+    const char *errorMessage() const { return _errorMessage; }
+    uint32_t errorOffset() const { return _errorOffset; }
+
+protected:
+    struct Frame {
+        bool                    isArray;
+        // 对象或数组的值在 _values 中开始的位置
+        uint32_t                first;
+        // 对象当前的 shape, 为 nullptr 时对象已经转为通用的方式 (obj) 创建
+        JsShape                 *shape;
+        JsObject                *obj;
+        // 重复的属性名在 _values 中的位置 (相对于 first)
+        int32_t                 duplicatedSlot;
+        // 通用方式创建时，当前的属性名
+        string                  key;
+    };
+
+    bool parseKey(Frame &frame);
+    bool parseString(JsValue &valueOut);
+    bool parseNumber(JsValue &valueOut);
+    bool scanString(const uint8_t *&endOut, bool &hasEscapeOut, bool &isAnsiOut);
+    bool unescapeString(const uint8_t *p, const uint8_t *end, uint8_t *out, uint8_t *&outEnd, bool &isAnsi);
+
+    void addValue(Frame &frame, const JsValue &value);
+    void toGenericObject(Frame &frame);
+    JsValue finishObject();
+    JsValue finishArray();
+
+    uint8_t *beginString(uint32_t maxLen);
+    JsValue endString(uint8_t *data, uint32_t len, bool isAnsi);
+
+    inline void skipWhitespace();
+    bool error(const char *message) {
+        _errorMessage = message;
+        _errorOffset = (uint32_t)(_p - _start);
+        return false;
+    }
+
+protected:
+    VMContext                   *_ctx;
+    VMRuntime                   *_runtime;
+
+    const uint8_t               *_start, *_p, *_end;
+
+    VecJsValues                 _values;
+    std::vector<Frame>          _frames;
+    uint32_t                    _depth;
+
+    // 正在写入字符串的 buffer, _buffer 持有一个引用
+    JsStringBuffer              *_buffer;
+    string                      _keyBuf;
+
+    const char                  *_errorMessage;
+    uint32_t                    _errorOffset;
+
+};
+
+#endif /* JsonParser_hpp */
@@ -0,0 +1,634 @@
+﻿//
+//  JsonWriter.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/20.
+//
+
+#include "JsonWriter.hpp"
+#include "VirtualMachine.hpp"
+#include "objects/JsObject.hpp"
+#include "objects/JsArray.hpp"
+#include "objects/JsLibObject.hpp"
+#include "objects/JsPrimaryObject.hpp"
+#include "utils/StringEx.h"
+#include "utils/CharEncoding.h"
+#include <cmath>
+#include <unordered_set>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2_SCAN       1
+#endif
+
+
+// 每次转义的字符串的最大长度，之后检查是否需要输出到 stream
+const uint32_t STRING_SEGMENT_SIZE = 1024 * 16;
+
+// 超过此大小的 buffer 不再放回 VMRuntime 中复用，避免一直占用内存
+const uint32_t MAX_POOLED_BUFFER_SIZE = 1024 * 1024;
+
+static const char HEX_CHARS[] = "0123456789abcdef";
+
+/**
+ * 返回 p 之后第一个需要特殊处理的字符的位置: 控制字符、'"'、'\\' 和 0xED (utf-8 编码的代理项的第一个字节)
+ */
+static const uint8_t *scanPlainChars(const uint8_t *p, const uint8_t *end) {
+#if USE_SSE2_SCAN
+    auto quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), lead = _mm_set1_epi8((char)0xED), maxControl = _mm_set1_epi8(0x1F);
+    while (p + 16 <= end) {
+        auto v = _mm_loadu_si128((const __m128i *)p);
+        // 无符号比较 v <= 0x1F
+        auto control = _mm_cmpeq_epi8(_mm_min_epu8(v, maxControl), v);
+        uint32_t mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(control, _mm_cmpeq_epi8(v, quote)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, backslash), _mm_cmpeq_epi8(v, lead))));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    for (; p < end; p++) {
+        auto c = *p;
+        if (c < 0x20 || c == '"' || c == '\\' || c == 0xED) {
+            break;
+        }
+    }
+    return p;
+}
+
+inline bool isSurrogateUtf8(const uint8_t *p, const uint8_t *end, uint32_t &codeOut) {
+    if (p + 3 <= end && p[0] == 0xED && p[1] >= 0xA0 && p[1] <= 0xBF && (p[2] & 0xC0) == 0x80) {
+        codeOut = 0xD000 | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+        return true;
+    }
+    return false;
+}
+
+inline uint8_t *writeUnicodeEscape(uint8_t *out, uint32_t code) {
+    out[0] = '\\'; out[1] = 'u';
+    out[2] = HEX_CHARS[(code >> 12) & 0xF];
+    out[3] = HEX_CHARS[(code >> 8) & 0xF];
+    out[4] = HEX_CHARS[(code >> 4) & 0xF];
+    out[5] = HEX_CHARS[code & 0xF];
+    return out + 6;
+}
+
+/**
+ * 转义 [p, end) 之间的内容到 out, 最多读取到 bufEnd (代理项对可能超出 end). 返回 out 的结束位置.
+ * out 需要有 (end - p + 6) * 6 的空间.
+ */
+static uint8_t *escapeString(const uint8_t *&p, const uint8_t *end, const uint8_t *bufEnd, uint8_t *out) {
+    while (p < end) {
+        auto q = scanPlainChars(p, end);
+        memcpy(out, p, q - p);
+        out += q - p;
+        p = q;
+        if (p >= end) {
+            break;
+        }
+
+        auto c = *p;
+        uint32_t code, low;
+        if (c == 0xED) {
+            if (isSurrogateUtf8(p, bufEnd, code)) {
+                if (code < 0xDC00 && isSurrogateUtf8(p + 3, bufEnd, low) && low >= 0xDC00) {
+                    // 分开保存的代理项对，合并为 4 个字节的 utf-8
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    out[0] = 0xF0 | (code >> 18);
+                    out[1] = 0x80 | ((code >> 12) & 0x3F);
+                    out[2] = 0x80 | ((code >> 6) & 0x3F);
+                    out[3] = 0x80 | (code & 0x3F);
+                    out += 4;
+                    p += 6;
+                } else {
+                    // 单独的代理项
+                    out = writeUnicodeEscape(out, code);
+                    p += 3;
+                }
+            } else {
+                *out++ = c;
+                p++;
+            }
+            continue;
+        }
+
+        *out++ = '\\';
+        switch (c) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '\b': *out++ = 'b'; break;
+            case '\f': *out++ = 'f'; break;
+            case '\n': *out++ = 'n'; break;
+            case '\r': *out++ = 'r'; break;
+            case '\t': *out++ = 't'; break;
+            default:
+                out = writeUnicodeEscape(out - 1, c);
+                break;
+        }
+        p++;
+    }
+
+    return out;
+}
+
+static void appendEscapedKey(string &out, const StringView &key) {
+    auto p = (const uint8_t *)key.data, end = p + key.len;
+    auto start = out.size();
+    out.resize(start + (key.len + 6) * 6 + 2);
+    auto q = (uint8_t *)out.data() + start;
+    *q++ = '"';
+    q = escapeString(p, end, end, q);
+    *q++ = '"';
+    out.resize(q - (uint8_t *)out.data());
+}
+
+inline bool isCallable(VMRuntime *runtime, const JsValue &value) {
+    if (value.type == JDT_LIB_OBJECT) {
+        return ((JsLibObject *)runtime->getObject(value))->getFunction() != nullptr;
+    }
+    return value.isFunction();
+}
+
+JsonWriter::JsonWriter(VMContext *ctx) : _ctx(ctx), _runtime(ctx->runtime) {
+    _runtime->swapJsonBuffer(_buf);
+    _len = 0;
+    _stream = nullptr;
+    _chunkSize = DEFAULT_CHUNK_SIZE;
+    _hasPropertyList = false;
+}
+
+JsonWriter::~JsonWriter() {
+    for (auto &item : _shapeKeys) {
+        delete item.second;
+    }
+
+    if (_buf.size() <= MAX_POOLED_BUFFER_SIZE) {
+        _runtime->swapJsonBuffer(_buf);
+    }
+}
+
+void JsonWriter::setReplacer(const JsValue &replacer) {
+    if (isCallable(_runtime, replacer)) {
+        _replacerFunc = replacer;
+        return;
+    }
+
+    if (replacer.type != JDT_ARRAY) {
+        return;
+    }
+
+    // 属性名的列表，去掉重复的
+    _hasPropertyList = true;
+    auto arr = (JsArray *)_runtime->getObject(replacer);
+    std::unordered_set<string> names;
+    for (uint32_t i = 0; i < arr->length(); i++) {
+        auto item = arr->getByIndex(_ctx, replacer, i);
+        if (item.type == JDT_OBJ_NUMBER || item.type == JDT_OBJ_STRING) {
+            item = _runtime->toString(_ctx, item);
+        } else if (!item.isString() && !item.isNumber()) {
+            continue;
+        }
+
+        auto str = _runtime->toStringView(_ctx, item);
+        string name((const char *)str.data, str.len);
+        if (names.insert(name).second) {
+            _propertyListOffsets.push_back((int)_propertyListKeys.size());
+            appendEscapedKey(_propertyListKeys, str);
+            _propertyList.push_back(name);
+        }
+    }
+    _propertyListOffsets.push_back((int)_propertyListKeys.size());
+}
+
+void JsonWriter::setSpace(const JsValue &spaceOrg) {
+    auto space = spaceOrg;
+    if (space.type == JDT_OBJ_NUMBER || space.type == JDT_OBJ_STRING) {
+        space = space.type == JDT_OBJ_NUMBER ? ((JsNumberObject *)_runtime->getObject(space))->value()
+            : ((JsStringObject *)_runtime->getObject(space))->value();
+    }
+
+    if (space.isNumber()) {
+        auto n = _runtime->toNumber(_ctx, space);
+        n = std::min(10.0, n);
+        if (n >= 1) {
+            _gap.assign((size_t)n, ' ');
+        }
+    } else if (space.isString()) {
+        auto str = _runtime->toStringView(_ctx, space);
+        // 最多 10 个字符 (utf-16)
+        auto end = std::min(utf8ToUtf16Seek((const char *)str.data, str.len, 10), (char *)str.data + str.len);
+        _gap.assign((const char *)str.data, end - (const char *)str.data);
+    }
+}
+
+bool JsonWriter::write(const JsValue &value) {
+    JsValue v = value, holder;
+    if (_replacerFunc.type != JDT_UNDEFINED) {
+        // replacer 中的 this 为 { "": value }
+        auto obj = new JsObject();
+        holder = _runtime->pushObject(obj);
+        _runtime->addTempValue(holder);
+        obj->setByName(_ctx, holder, SS_EMPTY, value);
+    }
+
+    if (!toJsonValue(v, holder, SS_EMPTY)) {
+        return false;
+    }
+
+    if (!writeValue(v)) {
+        return false;
+    }
+
+    if (_stream && _len > 0) {
+        flush();
+    }
+    return true;
+}
+
+bool JsonWriter::toJsonValue(JsValue &value, const JsValue &holder, const StringView &key) {
+    JsValue keyValue;
+
+    // JDT_NATIVE_FUNCTION 不是对象，没有属性
+    if (value.type >= JDT_OBJECT && value.type != JDT_NATIVE_FUNCTION) {
+        auto obj = _runtime->getObject(value);
+        auto prop = obj->getRawByName(_ctx, SS_TOJSON, true);
+        if (prop) {
+            auto toJSON = getPropertyValue(_ctx, value, prop);
+            if (_ctx->error != JE_OK) {
+                return false;
+            }
+
+            if (isCallable(_runtime, toJSON)) {
+                keyValue = _runtime->pushString(key);
+                _runtime->addTempValue(keyValue);
+                _ctx->vm->callMember(_ctx, value, toJSON, ArgumentsX(keyValue));
+                if (_ctx->error != JE_OK) {
+                    return false;
+                }
+                value = _ctx->retValue;
+            }
+        }
+    }
+
+    if (_replacerFunc.type != JDT_UNDEFINED) {
+        if (keyValue.type == JDT_UNDEFINED) {
+            keyValue = _runtime->pushString(key);
+            _runtime->addTempValue(keyValue);
+        }
+
+        _ctx->vm->callMember(_ctx, holder, _replacerFunc, ArgumentsX(keyValue, value));
+        if (_ctx->error != JE_OK) {
+            return false;
+        }
+        value = _ctx->retValue;
+    }
+
+    switch (value.type) {
+        case JDT_UNDEFINED:
+        case JDT_SYMBOL:
+        case JDT_FUNCTION:
+        case JDT_BOUND_FUNCTION:
+        case JDT_NATIVE_FUNCTION:
+            return false;
+        case JDT_LIB_OBJECT:
+            return !isCallable(_runtime, value);
+        case JDT_OBJ_BOOL:
+            value = ((JsBooleanObject *)_runtime->getObject(value))->value();
+            break;
+        case JDT_OBJ_NUMBER:
+            value = ((JsNumberObject *)_runtime->getObject(value))->value();
+            break;
+        case JDT_OBJ_STRING:
+            value = ((JsStringObject *)_runtime->getObject(value))->value();
+            break;
+        default:
+            break;
+    }
+
+    return true;
+}
+
+bool JsonWriter::writeValue(const JsValue &value) {
+    switch (value.type) {
+        case JDT_NULL:
+            writeRaw("null", 4);
+            break;
+        case JDT_BOOL:
+            if (value.value.n32) {
+                writeRaw("true", 4);
+            } else {
+                writeRaw("false", 5);
+            }
+            break;
+        case JDT_INT32: {
+            char buf[32];
+            auto len = itoa(value.value.n32, buf);
+            writeRaw(buf, (uint32_t)len);
+            break;
+        }
+        case JDT_NUMBER:
+            writeNumber(_runtime->getDouble(value));
+            break;
+        case JDT_CHAR: {
+            StringViewWrapper s(value);
+            writeString(s);
+            break;
+        }
+        case JDT_STRING:
+            writeString(_runtime->getUtf8String(value));
+            break;
+        case JDT_ARRAY: {
+            auto arr = (JsArray *)_runtime->getObject(value);
+            if (!enterObject(arr)) {
+                return false;
+            }
+            auto ret = writeArray(value, arr);
+            _stack.pop_back();
+            return ret;
+        }
+        default: {
+            assert(value.type >= JDT_OBJECT);
+            auto obj = _runtime->getObject(value);
+            if (!enterObject(obj)) {
+                return false;
+            }
+
+            bool ret;
+            if (obj->type == JDT_OBJECT && !_hasPropertyList && ((JsObject *)obj)->shape()
+                    && !((JsObject *)obj)->shape()->hasNumericNames()) {
+                ret = writeShapedObject(value, (JsObject *)obj);
+            } else {
+                ret = writeObject(value, obj);
+            }
+            _stack.pop_back();
+            return ret;
+        }
+    }
+
+    return true;
+}
+
+bool JsonWriter::enterObject(IJsObject *obj) {
+    if (_stack.size() >= MAX_DEPTH) {
+        _ctx->throwException(JE_RANGE_ERROR, "Maximum call stack size exceeded");
+        return false;
+    }
+
+    // 嵌套的层数通常不多，直接比较
+    for (auto item : _stack) {
+        if (item == obj) {
+            _ctx->throwException(JE_TYPE_ERROR, "Converting circular structure to JSON");
+            return false;
+        }
+    }
+
+    _stack.push_back(obj);
+    return true;
+}
+
+/**
+ * 按照 slot 的顺序输出 (即属性添加的顺序)，属性名使用 shape 中缓存的转义后的内容.
+ * getter, toJSON 和 replacer 可能会修改对象，shape 改变之后按照属性名查找.
+ */
+bool JsonWriter::writeShapedObject(const JsValue &value, JsObject *obj) {
+    auto shape = obj->shape();
+    auto keys = getShapeKeys(shape);
+    auto count = shape->countProperties();
+    bool isFirst = true;
+
+    writeChar('{');
+    for (uint32_t i = 0; i < count; i++) {
+        JsValue prop;
+        if (obj->shape() == shape) {
+            prop = obj->slotAt(i);
+        } else {
+            auto p = obj->getRawByName(_ctx, keys->names[i], false);
+            if (!p) {
+                continue;
+            }
+            prop = *p;
+        }
+
+        if (!prop.isEnumerable()) {
+            continue;
+        }
+
+        auto v = getPropertyValue(_ctx, value, prop);
+        if (_ctx->error != JE_OK) {
+            return false;
+        }
+
+        auto start = keys->offsets[i];
+        if (!writeProperty(value, keys->names[i], keys->text.data() + start, keys->offsets[i + 1] - start, v, isFirst)) {
+            return false;
+        }
+    }
+
+    if (!isFirst && !_gap.empty()) {
+        _indent.resize(_indent.size() - _gap.size());
+        writeNewLine();
+    }
+    writeChar('}');
+    return true;
+}
+
+bool JsonWriter::writeObject(const JsValue &value, IJsObject *obj) {
+    bool isFirst = true;
+
+    writeChar('{');
+    if (_hasPropertyList) {
+        for (size_t i = 0; i < _propertyList.size(); i++) {
+            auto &name = _propertyList[i];
+            auto v = obj->getByName(_ctx, value, name);
+            if (_ctx->error != JE_OK) {
+                return false;
+            }
+
+            auto start = _propertyListOffsets[i];
+            if (!writeProperty(value, name, _propertyListKeys.data() + start, _propertyListOffsets[i + 1] - start, v, isFirst)) {
+                return false;
+            }
+        }
+    } else {
+        std::unique_ptr<IJsIterator> it;
+        it.reset(obj->getIteratorObject(_ctx, false));
+
+        // 先取得所有的属性名: 和规范相同，之后添加的属性不输出
+        VecStrings names;
+        StringView key;
+        while (it->next(&key, nullptr, nullptr)) {
+            names.push_back(string((const char *)key.data, key.len));
+        }
+
+        string escaped;
+        for (auto &name : names) {
+            auto prop = obj->getRawByName(_ctx, name, false);
+            if (!prop || !prop->isEnumerable()) {
+                continue;
+            }
+
+            auto v = getPropertyValue(_ctx, value, prop);
+            if (_ctx->error != JE_OK) {
+                return false;
+            }
+
+            escaped.clear();
+            appendEscapedKey(escaped, name);
+            if (!writeProperty(value, name, escaped.data(), (uint32_t)escaped.size(), v, isFirst)) {
+                return false;
+            }
+        }
+    }
+
+    if (!isFirst && !_gap.empty()) {
+        _indent.resize(_indent.size() - _gap.size());
+        writeNewLine();
+    }
+    writeChar('}');
+    return true;
+}
+
+bool JsonWriter::writeProperty(const JsValue &holder, const StringView &key, const char *escapedKey, uint32_t lenEscapedKey, JsValue value, bool &isFirst) {
+    if (!toJsonValue(value, holder, key)) {
+        return _ctx->error == JE_OK;
+    }
+
+    if (isFirst) {
+        isFirst = false;
+        if (!_gap.empty()) {
+            _indent.append(_gap);
+        }
+    } else {
+        writeChar(',');
+    }
+
+    if (!_gap.empty()) {
+        writeNewLine();
+    }
+
+    writeRaw(escapedKey, lenEscapedKey);
+    if (_gap.empty()) {
+        writeChar(':');
+    } else {
+        writeRaw(": ", 2);
+    }
+
+    if (!writeValue(value)) {
+        return false;
+    }
+
+    flushIfFull();
+    return true;
+}
+
+bool JsonWriter::writeArray(const JsValue &value, JsArray *arr) {
+    auto length = arr->length();
+    if (length == 0) {
+        writeRaw("[]", 2);
+        return true;
+    }
+
+    writeChar('[');
+    if (!_gap.empty()) {
+        _indent.append(_gap);
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (i > 0) {
+            writeChar(',');
+        }
+        if (!_gap.empty()) {
+            writeNewLine();
+        }
+
+        JsValue v;
+        if (!arr->getPackedByIndex(i, v)) {
+            v = arr->getByIndex(_ctx, value, i);
+            if (_ctx->error != JE_OK) {
+                return false;
+            }
+        }
+
+        if (v.type < JDT_OBJECT && v.type != JDT_UNDEFINED && v.type != JDT_SYMBOL && _replacerFunc.type == JDT_UNDEFINED) {
+            // 基本类型，不需要转换
+            writeValue(v);
+        } else {
+            NumberToStringView key(i);
+            if (!toJsonValue(v, value, key)) {
+                if (_ctx->error != JE_OK) {
+                    return false;
+                }
+                writeRaw("null", 4);
+            } else if (!writeValue(v)) {
+                return false;
+            }
+        }
+
+        flushIfFull();
+    }
+
+    if (!_gap.empty()) {
+        _indent.resize(_indent.size() - _gap.size());
+        writeNewLine();
+    }
+    writeChar(']');
+    return true;
+}
+
+JsonWriter::ShapeKeys *JsonWriter::getShapeKeys(JsShape *shape) {
+    auto it = _shapeKeys.find(shape);
+    if (it != _shapeKeys.end()) {
+        return (*it).second;
+    }
+
+    auto keys = new ShapeKeys();
+    shape->getNames(keys->names);
+    for (auto &name : keys->names) {
+        keys->offsets.push_back((int)keys->text.size());
+        appendEscapedKey(keys->text, name);
+    }
+    keys->offsets.push_back((int)keys->text.size());
+
+    _shapeKeys[shape] = keys;
+    return keys;
+}
+
+void JsonWriter::writeString(const StringView &str) {
+    auto p = (const uint8_t *)str.data, end = p + str.len;
+
+    writeChar('"');
+    while (p < end) {
+        // 分段转义，避免在 stream 模式下一次性占用太多的内存
+        auto segmentEnd = std::min(end, p + STRING_SEGMENT_SIZE);
+        auto out = reserve(((uint32_t)(segmentEnd - p) + 6) * 6);
+        auto outEnd = escapeString(p, segmentEnd, end, out);
+        _len += outEnd - out;
+        flushIfFull();
+    }
+    writeChar('"');
+}
+
+void JsonWriter::writeNumber(double value) {
+    if (std::isnan(value) || std::isinf(value)) {
+        writeRaw("null", 4);
+    } else if (value == 0) {
+        // -0 输出为 0
+        writeChar('0');
+    } else {
+        char buf[64];
+        auto len = floatToString(value, buf);
+        writeRaw(buf, len);
+    }
+}
+
+void JsonWriter::writeNewLine() {
+    writeChar('\n');
+    writeRaw(_indent.data(), (uint32_t)_indent.size());
+}
+
+void JsonWriter::flush() {
+    _stream->write(StringView(_buf.data(), _len));
+    _len = 0;
+}
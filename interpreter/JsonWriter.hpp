@@ -0,0 +1,148 @@
+﻿//
+//  JsonWriter.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/20.
+//
+
+#ifndef JsonWriter_hpp
+#define JsonWriter_hpp
+
+#include <unordered_map>
+#include "VirtualMachineTypes.hpp"
+
+
+class VMContext;
+class VMRuntime;
+class JsShape;
+class IJsObject;
+class JsObject;
+class JsArray;
+
+/**
+ * JsonWriter 分段输出结果的接口. chunk 按照字节分段，可能会在 utf-8 字符的中间分开.
+ */
+class IJsonWriterStream {
+public:
+    virtual ~IJsonWriterStream() { }
+
+    virtual void write(const StringView &chunk) = 0;
+
+};
+
+/**
+ * JSON.stringify 的实现:
+ * - 直接遍历 JsObject 的 slots 和 packed 数组的元素，不需要为每个对象创建 IJsIterator;
+ * - 每个 shape 的属性名只转义一次，之后相同结构的对象直接复制;
+ * - 输出到 VMRuntime 中复用的 buffer, 字符串使用 SSE2 查找需要转义的字符;
+ * - 设置了 stream 时，buffer 超过 chunkSize 后就输出到 stream, 不需要在内存中保存完整的结果.
+ */
+class JsonWriter {
+private:
+    JsonWriter(const JsonWriter &);
+    JsonWriter &operator=(const JsonWriter &);
+
+public:
+    enum {
+        DEFAULT_CHUNK_SIZE      = 1024 * 64,
+        // 嵌套的层数超过此值时抛出 RangeError
+        MAX_DEPTH               = 5000,
+    };
+
+    JsonWriter(VMContext *ctx);
+    ~JsonWriter();
+
+    /**
+     * JSON.stringify 的 replacer (函数或者属性名的数组) 和 space 参数
+     */
+    void setReplacer(const JsValue &replacer);
+    void setSpace(const JsValue &space);
+
+    void setStream(IJsonWriterStream *stream, uint32_t chunkSize = DEFAULT_CHUNK_SIZE) {
+        _stream = stream;
+        _chunkSize = chunkSize;
+    }
+
+    /**
+     * 输出 value, 返回 false 表示 value 不能转换为 JSON (比如 undefined, 函数) 或者出现了异常 (ctx->error)
+     */
+    bool write(const JsValue &value);
+
+    // 没有设置 stream 时，输出的结果
+    StringView result() const { return StringView(_buf.data(), _len); }
+
+protected:
+    // 同一个 shape 中转义后的属性名: "name1""name2"..., offsets 为每个属性名的开始位置
+    struct ShapeKeys {
+        string                  text;
+        VecInts                 offsets;
+        VecStringViews          names;
+    };
+
+    bool toJsonValue(JsValue &value, const JsValue &holder, const StringView &key);
+    bool writeValue(const JsValue &value);
+    bool writeObject(const JsValue &value, IJsObject *obj);
+    bool writeShapedObject(const JsValue &value, JsObject *obj);
+    bool writeArray(const JsValue &value, JsArray *arr);
+    bool writeProperty(const JsValue &holder, const StringView &key, const char *escapedKey, uint32_t lenEscapedKey, JsValue value, bool &isFirst);
+    bool enterObject(IJsObject *obj);
+    ShapeKeys *getShapeKeys(JsShape *shape);
+
+    void writeString(const StringView &str);
+    void writeNumber(double value);
+    void writeNewLine();
+
+    inline uint8_t *reserve(uint32_t size) {
+        if (_len + size > _buf.size()) {
+            _buf.resize(std::max(_len + size, (uint32_t)_buf.size() * 2));
+        }
+        return (uint8_t *)_buf.data() + _len;
+    }
+
+    inline void writeRaw(const char *data, uint32_t len) {
+        memcpy(reserve(len), data, len);
+        _len += len;
+    }
+
+    inline void writeChar(char c) {
+        *reserve(1) = c;
+        _len++;
+    }
+
+    inline void flushIfFull() {
+        if (_stream && _len >= _chunkSize) {
+            flush();
+        }
+    }
+
+    void flush();
+
+protected:
+    VMContext                   *_ctx;
+    VMRuntime                   *_runtime;
+
+    // 复用的 VMRuntime::_jsonBuffer, 有效的长度为 _len
+    string                      _buf;
+    uint32_t                    _len;
+
+    IJsonWriterStream           *_stream;
+    uint32_t                    _chunkSize;
+
+    JsValue                     _replacerFunc;
+    bool                        _hasPropertyList;
+    VecStrings                  _propertyList;
+    // _propertyList 中的属性名转义后的内容
+    string                      _propertyListKeys;
+    VecInts                     _propertyListOffsets;
+
+    string                      _gap;
+    string                      _indent;
+
+    // 正在输出的对象，用于检查循环引用
+    std::vector<IJsObject *>    _stack;
+
+    std::unordered_map<JsShape *, ShapeKeys *> _shapeKeys;
+
+};
+
+#endif /* JsonWriter_hpp */
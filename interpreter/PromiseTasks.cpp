@@ -10,21 +10,41 @@
 #include "objects/JsPromiseObject.hpp"
 
 
+const uint32_t PROMISE_TASKS_MIN_CAPACITY = 64;
+
 bool PromiseTasks::run() {
-    while (!_toRunPromises.empty()) {
-        auto toRuns = _toRunPromises;
-        _toRunPromises.clear();
+    while (_count > 0) {
+        _running = _tasks[_head];
+        _head = (_head + 1) & (_tasks.size() - 1);
+        _count--;
 
-        for (auto &task : toRuns) {
-            task.promise->onRun();
-        }
+        _running->onRun();
     }
 
+    _running = nullptr;
     return false;
 }
 
+void PromiseTasks::grow() {
+    auto capacity = std::max((uint32_t)_tasks.size() * 2, PROMISE_TASKS_MIN_CAPACITY);
+    std::vector<JsPromiseObject *> tasks(capacity);
+
+    // 按照队列的顺序复制到新的缓冲区开头
+    for (uint32_t i = 0; i < _count; i++) {
+        tasks[i] = _tasks[(_head + i) & (_tasks.size() - 1)];
+    }
+
+    _tasks.swap(tasks);
+    _head = 0;
+}
+
 void PromiseTasks::markReferIdx(VMRuntime *rt) {
-    for (auto &task : _toRunPromises) {
-        ::markReferIdx(rt, task.promise);
+    auto mask = (uint32_t)_tasks.size() - 1;
+    for (uint32_t i = 0; i < _count; i++) {
+        ::markReferIdx(rt, _tasks[(_head + i) & mask]);
+    }
+
+    if (_running) {
+        ::markReferIdx(rt, _running);
     }
 }
@@ -13,28 +13,39 @@
 
 class JsPromiseObject;
 
+/**
+ * microtask 队列: 已经 settled，需要执行其回调的 promise.
+ *
+ * 使用环形缓冲区，执行时按顺序从头部逐个取出，执行过程中新加入的 promise 追加到尾部，在同一次 run() 中执行.
+ * 缓冲区只在容量不足时按倍数扩展，入队和出队都不需要分配内存.
+ */
 class PromiseTasks {
 public:
-    struct PromiseTask {
-        JsPromiseObject         *promise;
-
-        PromiseTask(JsPromiseObject *promise) : promise(promise) { }
-    };
-
-    using ListPromiseTasks = std::list<PromiseTask>;
-
-public:
-    PromiseTasks() { }
+    PromiseTasks() : _head(0), _count(0), _running(nullptr) { }
 
     void registerToRunPromise(JsPromiseObject *promise) {
-        _toRunPromises.push_back(PromiseTask(promise));
+        if (_count == _tasks.size()) {
+            grow();
+        }
+
+        _tasks[(_head + _count) & (_tasks.size() - 1)] = promise;
+        _count++;
     }
 
+    bool empty() const { return _count == 0; }
+
     bool run();
     void markReferIdx(VMRuntime *rt);
 
 protected:
-    ListPromiseTasks            _toRunPromises;
+    void grow();
+
+    // 大小为 2 的幂
+    std::vector<JsPromiseObject *> _tasks;
+    uint32_t                    _head, _count;
+
+    // 正在执行的 promise，已经从队列中取出，执行期间可能会触发 GC
+    JsPromiseObject             *_running;
 
 };
 
@@ -6,83 +6,76 @@
 //
 
 #include "TimerTasks.hpp"
+#include "PromiseTasks.hpp"
 #include "utils/os.h"
 #include "VirtualMachine.hpp"
 
 
-TimerTasks::Timer::Timer(VMContext *ctx, JsValue callback, int32_t duration, bool repeat, int timerId) : ctx(ctx), callback(callback), duration(duration), repeat(repeat), timerId(timerId)
+TimerTasks::Timer::Timer(VMContext *ctx, JsValue callback, int32_t duration, bool repeat, int timerId) : callback(callback), ctx(ctx), duration(duration), timerId(timerId), seq(0), repeat(repeat)
 {
     startTime = getTickCount() + duration;
 }
 
 TimerTasks::TimerTasks() {
     _timerIdNext = 1;
+    _seqNext = 0;
+    _isWokenUp = false;
 }
 
 int TimerTasks::registerTimer(VMContext *ctx, JsValue callback, int32_t duration, bool repeat) {
     auto id = _timerIdNext++;
-    insertTimer(_timers, _timers.begin(), Timer(ctx, callback, duration, repeat, id));
+    pushTimer(Timer(ctx, callback, duration, repeat, id));
     return id;
 }
 
 void TimerTasks::unregisterTimer(int timerId) {
-    for (auto it = _timers.begin(); it != _timers.end(); ++it) {
-        if ((*it).timerId == timerId) {
-            _timers.erase(it);
-            break;
-        }
+    auto it = _idToIndex.find(timerId);
+    if (it != _idToIndex.end()) {
+        removeAt(it->second);
     }
 }
 
-TimerTasks::ListTimersIterator TimerTasks::insertTimer(ListTimers &timers, ListTimersIterator begin, const Timer &item) {
-    ListTimersIterator end = timers.end();
-    for (; begin != end; ++begin) {
-        if (item.startTime < (*begin).startTime) {
-            break;
-        }
+int32_t TimerTasks::nextTimeout() const {
+    if (_timers.empty()) {
+        return -1;
     }
 
-    return timers.insert(begin, item);
+    auto timeout = _timers.front().startTime - getTickCount();
+    return timeout <= 0 ? 0 : (int32_t)timeout;
 }
 
-bool TimerTasks::run() {
-    //
-    // 为了避免在执行过程中，注册/删除 timer，导致 iterator 失效，
-    // 将要执行的 timer 都预先剥离出来.
-    //
-
+bool TimerTasks::run(PromiseTasks &promiseTasks) {
     int64_t now = getTickCount();
-    ListTimers toRuns, toInserts;
-
-    for (auto it = _timers.begin(); it != _timers.end();) {
-        auto &timer = *it;
-        if (timer.startTime <= now) {
-            toRuns.push_back(timer);
-            if (timer.repeat) {
-                timer.startTime = now + timer.duration;
-                insertTimer(toInserts, toInserts.begin(), timer);
-            }
-            it = _timers.erase(it);
-        } else {
+    uint32_t seqEnd = _seqNext;
+
+    while (!_timers.empty()) {
+        auto &top = _timers.front();
+        if (top.startTime > now || int32_t(top.seq - seqEnd) >= 0) {
             break;
         }
-    }
 
-    auto insertBegin = _timers.begin();
-    for (auto &timer : toInserts) {
-        // toInserts 已经拍好了序，所以只能在上次插入的之后.
-        insertBegin = insertTimer(_timers, insertBegin, timer);
-    }
+        // 执行前先从堆中取出 (或者重新注册), 回调中可以注册/删除 timer
+        Timer timer = top;
+        if (timer.repeat) {
+            top.startTime = now + timer.duration;
+            top.seq = _seqNext++;
+            siftDown(0);
+        } else {
+            removeAt(0);
+        }
 
-    for (auto &timer : toRuns) {
         if (timer.callback.isFunction()) {
+            _runningCallback = timer.callback;
             Arguments args;
             timer.ctx->vm->callMember(timer.ctx, jsValueGlobalThis, timer.callback, args);
+            _runningCallback = jsValueUndefined;
         } else {
             // eval as string.
             assert(0);
             // timer.ctx->vm->eval();
         }
+
+        promiseTasks.run();
     }
 
     return !_timers.empty();
@@ -92,4 +85,77 @@ void TimerTasks::markReferIdx(VMRuntime *rt) {
     for (auto &timer : _timers) {
         rt->markReferIdx(timer.callback);
     }
+
+    rt->markReferIdx(_runningCallback);
+}
+
+void TimerTasks::wait(int32_t timeout) {
+    std::unique_lock<std::mutex> lock(_mutexWait);
+    if (!_isWokenUp) {
+        _condWait.wait_for(lock, std::chrono::milliseconds(timeout), [this]() { return _isWokenUp; });
+    }
+    _isWokenUp = false;
+}
+
+void TimerTasks::wakeUp() {
+    {
+        MutexAutolock lock(_mutexWait);
+        _isWokenUp = true;
+    }
+    _condWait.notify_one();
+}
+
+void TimerTasks::pushTimer(const Timer &timer) {
+    _timers.push_back(timer);
+    auto index = (uint32_t)_timers.size() - 1;
+    _timers[index].seq = _seqNext++;
+    _idToIndex[timer.timerId] = index;
+    siftUp(index);
+}
+
+void TimerTasks::removeAt(uint32_t index) {
+    _idToIndex.erase(_timers[index].timerId);
+
+    auto last = (uint32_t)_timers.size() - 1;
+    if (index != last) {
+        setAt(index, _timers[last]);
+        _timers.pop_back();
+        siftDown(index);
+        siftUp(index);
+    } else {
+        _timers.pop_back();
+    }
+}
+
+void TimerTasks::siftUp(uint32_t index) {
+    Timer timer = _timers[index];
+    while (index > 0) {
+        auto parent = (index - 1) / 2;
+        if (!(timer < _timers[parent])) {
+            break;
+        }
+        setAt(index, _timers[parent]);
+        index = parent;
+    }
+    setAt(index, timer);
+}
+
+void TimerTasks::siftDown(uint32_t index) {
+    Timer timer = _timers[index];
+    auto count = (uint32_t)_timers.size();
+    while (true) {
+        auto child = index * 2 + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && _timers[child + 1] < _timers[child]) {
+            child++;
+        }
+        if (!(_timers[child] < timer)) {
+            break;
+        }
+        setAt(index, _timers[child]);
+        index = child;
+    }
+    setAt(index, timer);
 }
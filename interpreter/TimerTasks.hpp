@@ -9,8 +9,20 @@
 #define TimerTasks_hpp
 
 
+#include <unordered_map>
+#include <condition_variable>
 #include "VirtualMachineTypes.hpp"
 
+
+class PromiseTasks;
+
+/**
+ * timer 保存在以 (startTime, seq) 排序的二叉堆中, _idToIndex 记录 timer 在堆中的位置,
+ * 注册和删除都是 O(log n).
+ *
+ * 相同时间的 timer 按照注册的顺序 (seq) 执行. 执行过程中新注册的 timer，以及重新注册的 setInterval timer
+ * 的 seq 都大于本次 run() 开始时的 seq，不会在同一次 run() 中执行.
+ */
 class TimerTasks {
 public:
     struct Timer {
@@ -19,13 +31,16 @@ public:
         VMContext               *ctx;
         int32_t                 duration;
         int32_t                 timerId;
+        uint32_t                seq;
         bool                    repeat;
 
         Timer(VMContext *ctx, JsValue callback, int32_t duration, bool repeat, int timerId);
+
+        bool operator<(const Timer &other) const
+            { return startTime < other.startTime || (startTime == other.startTime && seq < other.seq); }
     };
 
-    using ListTimers = std::list<Timer>;
-    using ListTimersIterator = ListTimers::iterator;
+    using VecTimers = std::vector<Timer>;
 
 public:
     TimerTasks();
@@ -33,14 +48,37 @@ public:
     int registerTimer(VMContext *ctx, JsValue callback, int32_t duration, bool repeat);
     void unregisterTimer(int timerId);
 
-    static ListTimersIterator insertTimer(ListTimers &timers, ListTimersIterator begin, const Timer &item);
+    bool empty() const { return _timers.empty(); }
+
+    // 距离下一个 timer 到期的毫秒数，没有 timer 返回 -1
+    int32_t nextTimeout() const;
 
-    bool run();
+    // 执行所有已经到期的 timer, 每个 timer 执行之后都执行 microtask 队列
+    bool run(PromiseTasks &promiseTasks);
     void markReferIdx(VMRuntime *rt);
 
+    // 等待 timeout 毫秒，或者直到其他线程调用 wakeUp()
+    void wait(int32_t timeout);
+    void wakeUp();
+
 protected:
-    ListTimers              _timers;
+    void pushTimer(const Timer &timer);
+    void removeAt(uint32_t index);
+    void siftUp(uint32_t index);
+    void siftDown(uint32_t index);
+    void setAt(uint32_t index, const Timer &timer) { _timers[index] = timer; _idToIndex[timer.timerId] = index; }
+
+    VecTimers               _timers;
+    std::unordered_map<int32_t, uint32_t> _idToIndex;
+
+    // 正在执行的 timer 的回调，执行期间可能会触发 GC
+    JsValue                 _runningCallback;
     int                     _timerIdNext;
+    uint32_t                _seqNext;
+
+    std::mutex              _mutexWait;
+    std::condition_variable _condWait;
+    bool                    _isWokenUp;
 
 };
 
@@ -0,0 +1,246 @@
+﻿//
+//  VMProfiler.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/12.
+//
+
+#include "VirtualMachine.hpp"
+#include "parser/ParserTypes.hpp"
+
+
+#if VM_PROFILER
+
+VMProfileFunction::VMProfileFunction(Function *function) : function(function), name(function->name.toString()), line(function->line), col(function->col) {
+    isProgram = function->isCodeBlock;
+    assert(function->bytecode);
+    addresses.resize(function->lenByteCode);
+    opcodes.resize(function->lenByteCode, OP_INVALID);
+}
+
+bool VMProfileFunction::isSameFunction(Function *function) const {
+    return function == this->function && function->line == line && function->col == col
+        && (size_t)function->lenByteCode == addresses.size() && function->name.equal(StringView(name));
+}
+
+void VMProfileFunction::clear() {
+    self.clear();
+    for (auto &counter : addresses) {
+        counter.clear();
+    }
+}
+
+string VMProfileFunction::displayName() const {
+    char buf[64];
+    snprintf(buf, sizeof(buf), ":%d:%d", line, col);
+
+    if (!name.empty()) {
+        return name + buf;
+    }
+    return (isProgram ? "(program)" : "(anonymous)") + string(buf);
+}
+
+VMProfiler::VMProfiler() : _root(nullptr, nullptr) {
+    _lastNode = nullptr;
+    _lastAddress = 0;
+    _lastCode = OP_INVALID;
+    _lastCycles = 0;
+}
+
+VMProfiler::~VMProfiler() {
+    for (auto node : _nodes) {
+        delete node;
+    }
+
+    for (auto &item : _functions) {
+        delete item.second;
+    }
+
+    for (auto f : _expiredFunctions) {
+        delete f;
+    }
+}
+
+void VMProfiler::reset() {
+    // 调用树的结构需要保留，正在执行的 frame 引用了其中的结点
+    _root.self.clear();
+    for (auto node : _nodes) {
+        node->self.clear();
+    }
+
+    for (auto &item : _functions) {
+        item.second->clear();
+    }
+
+    for (auto f : _expiredFunctions) {
+        f->clear();
+    }
+
+    for (auto &counter : _opcodes) {
+        counter.clear();
+    }
+
+    _lastNode = nullptr;
+}
+
+void VMProfiler::flush() {
+    if (_lastNode) {
+        auto cycles = readCycleCounter() - _lastCycles;
+        _lastNode->self.cycles += cycles;
+        _lastNode->function->self.cycles += cycles;
+        _lastNode->function->addresses[_lastAddress].cycles += cycles;
+        _opcodes[_lastCode].cycles += cycles;
+        _lastNode = nullptr;
+    }
+}
+
+VMProfileNode *VMProfiler::nodeOfFrame(VMContext *ctx, VMFunctionFrame *frame) {
+    if (frame->profileNode) {
+        return frame->profileNode;
+    }
+
+    // 父结点为调用者 frame 的结点
+    auto &stackFrames = ctx->stackFrames;
+    auto it = std::find(stackFrames.rbegin(), stackFrames.rend(), frame);
+    assert(it != stackFrames.rend());
+    auto parent = &_root;
+    if (++it != stackFrames.rend()) {
+        parent = nodeOfFrame(ctx, *it);
+    }
+
+    auto function = getFunction(frame->function);
+    auto &child = parent->children[function];
+    if (child == nullptr) {
+        child = new VMProfileNode(parent, function);
+        _nodes.push_back(child);
+    }
+
+    frame->profileNode = child;
+    return child;
+}
+
+VMProfileFunction *VMProfiler::getFunction(Function *function) {
+    auto &f = _functions[function];
+    if (f && !f->isSameFunction(function)) {
+        _expiredFunctions.push_back(f);
+        f = nullptr;
+    }
+
+    if (f == nullptr) {
+        f = new VMProfileFunction(function);
+    }
+
+    return f;
+}
+
+static void writeCounterRow(BinaryOutputStream &stream, const VMProfileCounter &counter, uint64_t totalCycles) {
+    stream.writeFormat("%14llu %16llu %6.2f%%  ", (unsigned long long)counter.count,
+        (unsigned long long)counter.cycles, totalCycles ? counter.cycles * 100.0 / totalCycles : 0.0);
+}
+
+void VMProfiler::dumpFlat(BinaryOutputStream &stream, int countTopAddresses) {
+    uint64_t totalCycles = 0;
+    for (auto &counter : _opcodes) {
+        totalCycles += counter.cycles;
+    }
+
+    auto byCycles = [](const VMProfileCounter *a, const VMProfileCounter *b) { return a->cycles > b->cycles; };
+
+    // Opcodes
+    std::vector<VMProfileCounter *> opcodes;
+    for (auto &counter : _opcodes) {
+        if (counter.count) {
+            opcodes.push_back(&counter);
+        }
+    }
+    std::sort(opcodes.begin(), opcodes.end(), byCycles);
+
+    stream.writeFormat("Opcodes:\n%14s %16s %7s  %s\n", "count", "cycles", "%", "opcode");
+    for (auto counter : opcodes) {
+        writeCounterRow(stream, *counter, totalCycles);
+        stream.write(opCodeToString((OpCode)(counter - _opcodes)));
+        stream.write("\n");
+    }
+
+    // Functions
+    std::vector<VMProfileFunction *> functions;
+    for (auto &item : _functions) {
+        if (item.second->self.count) {
+            functions.push_back(item.second);
+        }
+    }
+    for (auto f : _expiredFunctions) {
+        if (f->self.count) {
+            functions.push_back(f);
+        }
+    }
+    std::sort(functions.begin(), functions.end(), [](VMProfileFunction *a, VMProfileFunction *b) {
+        return a->self.cycles > b->self.cycles;
+    });
+
+    stream.writeFormat("\nFunctions (self):\n%14s %16s %7s  %s\n", "count", "cycles", "%", "function");
+    for (auto f : functions) {
+        writeCounterRow(stream, f->self, totalCycles);
+        stream.write(f->displayName().c_str());
+        stream.write("\n");
+    }
+
+    // 最耗时的 bytecode 地址
+    struct AddressItem {
+        VMProfileFunction           *function;
+        uint32_t                    address;
+    };
+    std::vector<AddressItem> addresses;
+    for (auto f : functions) {
+        for (size_t i = 0; i < f->addresses.size(); i++) {
+            if (f->addresses[i].count) {
+                addresses.push_back({f, (uint32_t)i});
+            }
+        }
+    }
+    std::sort(addresses.begin(), addresses.end(), [](const AddressItem &a, const AddressItem &b) {
+        return a.function->addresses[a.address].cycles > b.function->addresses[b.address].cycles;
+    });
+    if (addresses.size() > (size_t)countTopAddresses) {
+        addresses.resize(countTopAddresses);
+    }
+
+    stream.writeFormat("\nAddresses (top %d):\n%14s %16s %7s  %s\n", countTopAddresses, "count", "cycles", "%", "function @address opcode");
+    for (auto &item : addresses) {
+        auto f = item.function;
+        writeCounterRow(stream, f->addresses[item.address], totalCycles);
+        stream.write(f->displayName().c_str());
+        stream.writeFormat(" @%u ", item.address);
+        stream.write(opCodeToString((OpCode)f->opcodes[item.address]));
+        stream.write("\n");
+    }
+}
+
+void VMProfiler::dumpFoldedStacks(BinaryOutputStream &stream) {
+    string path;
+    for (auto &item : _root.children) {
+        dumpFoldedStacks(stream, item.second, path);
+    }
+}
+
+void VMProfiler::dumpFoldedStacks(BinaryOutputStream &stream, VMProfileNode *node, string &path) {
+    auto lenPath = path.size();
+    if (!path.empty()) {
+        path.append(";");
+    }
+    path.append(node->function->displayName());
+
+    if (node->self.cycles) {
+        // path 可能很长，不能使用 writeFormat
+        stream.write(path.c_str(), path.size());
+        stream.writeFormat(" %llu\n", (unsigned long long)node->self.cycles);
+    }
+
+    for (auto &item : node->children) {
+        dumpFoldedStacks(stream, item.second, path);
+    }
+
+    path.resize(lenPath);
+}
+
+#endif // VM_PROFILER
@@ -0,0 +1,161 @@
+﻿//
+//  VMProfiler.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/12.
+//
+
+#ifndef VMProfiler_hpp
+#define VMProfiler_hpp
+
+#include <unordered_map>
+#include <chrono>
+#include <cassert>
+#include "utils/BinaryStream.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+
+class Function;
+class VMContext;
+class VMFunctionFrame;
+
+/**
+ * 读取 CPU 的时钟计数器，用于统计指令的耗时. 不支持的平台使用 steady_clock 的纳秒数.
+ */
+inline uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct VMProfileCounter {
+    uint64_t                    count = 0;
+    uint64_t                    cycles = 0;
+
+    void clear() { count = 0; cycles = 0; }
+};
+
+/**
+ * 一个 Function 的统计信息.
+ *
+ * Function 所在的 ResourcePool 可能在 GC 时被释放，所以这里复制了函数名和位置，dump 时不再访问 Function.
+ */
+struct VMProfileFunction {
+    Function                    *function;
+    string                      name;
+    int                         line, col;
+    bool                        isProgram; // 是否为最外层的代码或者 eval 的代码
+
+    VMProfileCounter            self;
+    std::vector<VMProfileCounter> addresses; // 每个 bytecode 地址的统计，下标为指令的起始位置
+    std::vector<uint8_t>        opcodes; // 每个地址上执行过的 opcode
+
+    VMProfileFunction(Function *function);
+
+    bool isSameFunction(Function *function) const;
+    void clear();
+    string displayName() const;
+};
+
+/**
+ * 调用树的结点，用于输出 folded stacks. 同一个函数从不同调用路径进入时，对应不同的结点.
+ */
+struct VMProfileNode {
+    VMProfileNode               *parent;
+    VMProfileFunction           *function;
+    VMProfileCounter            self;
+
+    std::unordered_map<VMProfileFunction *, VMProfileNode *> children;
+
+    VMProfileNode(VMProfileNode *parent, VMProfileFunction *function) : parent(parent), function(function) { }
+};
+
+/**
+ * 统计每个 opcode、每个函数和每个 bytecode 地址的执行次数和耗时 (cycles).
+ *
+ * 每条指令在取指时计数，其耗时为到下一条指令取指时 (或者解释执行结束时) 经过的 cycles，
+ * 包括了指令中调用 native function 的时间. 所以函数的耗时都是 self 的耗时.
+ * 只有在编译时定义了 VM_PROFILER=1 才可用，见 JsVirtualMachine::startProfiler.
+ */
+class VMProfiler {
+private:
+    VMProfiler(const VMProfiler &);
+    VMProfiler &operator=(const VMProfiler &);
+
+public:
+    VMProfiler();
+    ~VMProfiler();
+
+    // 清除已有的统计数据
+    void reset();
+
+    // 执行 node 对应函数中 address 处的指令 code
+    void onInstruction(VMProfileNode *node, uint32_t address, uint8_t code) {
+        auto now = readCycleCounter();
+        if (_lastNode) {
+            auto cycles = now - _lastCycles;
+            _lastNode->self.cycles += cycles;
+            _lastNode->function->self.cycles += cycles;
+            _lastNode->function->addresses[_lastAddress].cycles += cycles;
+            _opcodes[_lastCode].cycles += cycles;
+        }
+
+        auto function = node->function;
+        assert(address < function->addresses.size());
+        node->self.count++;
+        function->self.count++;
+        function->addresses[address].count++;
+        function->opcodes[address] = code;
+        _opcodes[code].count++;
+
+        _lastNode = node;
+        _lastAddress = address;
+        _lastCode = code;
+        _lastCycles = now;
+    }
+
+    // 将上一条指令到此时的耗时计入，解释执行结束时调用
+    void flush();
+
+    // 输出 opcode、函数和最耗时的 bytecode 地址
+    void dumpFlat(BinaryOutputStream &stream, int countTopAddresses = 30);
+
+    // 输出 flamegraph.pl 可以使用的 folded stacks 格式，每行为: "f1;f2;f3 cycles"
+    void dumpFoldedStacks(BinaryOutputStream &stream);
+
+    // 返回 frame 在调用树中的结点，frame 需要在 ctx->stackFrames 中
+    VMProfileNode *nodeOfFrame(VMContext *ctx, VMFunctionFrame *frame);
+
+protected:
+    VMProfileFunction *getFunction(Function *function);
+
+    void dumpFoldedStacks(BinaryOutputStream &stream, VMProfileNode *node, string &path);
+
+protected:
+    std::unordered_map<Function *, VMProfileFunction *> _functions;
+    std::vector<VMProfileFunction *> _expiredFunctions; // Function 被释放后，地址被其他 Function 复用
+    std::vector<VMProfileNode *> _nodes;
+
+    VMProfileNode               _root;
+    VMProfileCounter            _opcodes[256];
+
+    // 上一条执行的指令
+    VMProfileNode               *_lastNode;
+    uint32_t                    _lastAddress;
+    uint8_t                     _lastCode;
+    uint64_t                    _lastCycles;
+
+};
+
+#endif /* VMProfiler_hpp */
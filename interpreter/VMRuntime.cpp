@@ -6,16 +6,22 @@
 //
 
 #include <algorithm>
+#include <chrono>
 
 #include "VMRuntime.hpp"
 #include "VirtualMachine.hpp"
 #include "objects/JsGlobalThis.hpp"
 #include "objects/JsDummyObject.hpp"
 #include "objects/JsLibObject.hpp"
+#include "objects/JsMap.hpp"
+#include "objects/JsGeneratorObject.hpp"
+#include "VMSnapshot.hpp"
 
 
 #define MAX_STACK_SIZE          (1024 * 1024 / 8)
 #define JOINED_STRING_MIN_SIZE  256
+#define JOINED_STRING_MAX_DEPTH 4096 // 超过后将较深的一边拼接为普通字符串
+#define STRING_BUFFER_MIN_CAPACITY  1024
 #define POOL_STRING_SMALL       64
 #define POOL_STRING_MID         1024 * 32
 
@@ -27,6 +33,9 @@
 
 const uint32_t GC_ALLOCATED_COUNT_THRESHOLD = (uint32_t)1e5;
 
+// 空闲的 _objValues 位置上的 JsDummyObject 的 referIdx，GC 时不会再重复释放
+const int8_t REFER_IDX_FREE_OBJ_SLOT = -1;
+
 class StdIOConsole : public IConsole {
 public:
     virtual void log(const StringView &message) override {
@@ -67,7 +76,6 @@ VMRuntime::VMRuntime() {
     _countCommonStrings = 0;
     _countCommonObjs = 0;
 
-    _firstFreeDoubleIdx = 0;
     _firstFreeSymbolIdx = 0;
     _firstFreeGetterSetterIdx = 0;
     _firstFreeStringIdx = 0;
@@ -78,6 +86,16 @@ VMRuntime::VMRuntime() {
     _nextRefIdx = 1;
     _newAllocatedCount = 0;
     _gcAllocatedCountThreshold = GC_ALLOCATED_COUNT_THRESHOLD;
+    _gcAllocatedCountThresholdMin = GC_ALLOCATED_COUNT_THRESHOLD;
+
+    _isMinorGc = false;
+    _vmCallDepth = 0;
+    _isVerifyWriteBarrier = false;
+    _isVerifyingOldObj = false;
+    _countMissedWriteBarriers = 0;
+    _countLiveAfterMajorGc = 0;
+    _countPromotedSinceMajorGc = 0;
+    _countGarbageCollect = 0;
 }
 
 VMRuntime::~VMRuntime() {
@@ -89,6 +107,10 @@ VMRuntime::~VMRuntime() {
         delete item;
     }
 
+    for (auto item : _freeDummyObjs) {
+        delete item;
+    }
+
     for (auto item : _vmScopes) {
         delete item;
     }
@@ -106,7 +128,7 @@ VMRuntime::~VMRuntime() {
     }
 }
 
-void VMRuntime::init(JsVirtualMachine *vm) {
+void VMRuntime::init(JsVirtualMachine *vm, const VMSnapshot *snapshot) {
     VMRuntimeCommon *rtCommon = VMRuntimeCommon::getInstance();
     this->_vm = vm;
     this->_rtCommon = rtCommon;
@@ -116,24 +138,38 @@ void VMRuntime::init(JsVirtualMachine *vm) {
     _countCommonStrings = (int)rtCommon->_stringValues.size();
     _countCommonObjs = (int)rtCommon->_objValues.size();
 
-    // 把 0 占用了，0 为非法的位置
-    _symbolValues.push_back(JsSymbol());
+    _nativeFunctions = rtCommon->_nativeFunctions;
 
+    // double 都内联在 JsValue 中，_doubleValues 只有公共的 double 常量
     _doubleValues = rtCommon->_doubleValues;
-    _stringValues = rtCommon->_stringValues;
-    _nativeFunctions = rtCommon->_nativeFunctions;
 
-    _globalScope = new VMGlobalScope(rtCommon->_globalScope);
+    if (snapshot) {
+        snapshot->copyTo(this);
+    } else {
+        // 把 0 占用了，0 为非法的位置
+        _symbolValues.push_back(JsSymbol());
 
-    // 需要将 rtCommon 中的对象都复制一份.
-    for (auto item : rtCommon->_objValues) {
-        _objValues.push_back(item->clone());
-    }
-    delete _objValues[JS_OBJ_GLOBAL_THIS_IDX];
-    _objValues[JS_OBJ_GLOBAL_THIS_IDX] = new JsGlobalThis(_globalScope);
+        _shapeTree = std::make_shared<JsShapeTree>(&rtCommon->_atoms);
 
-    _firstFreeDoubleIdx = 0;
-    _firstFreeObjIdx = 0;
+        _stringValues = rtCommon->_stringValues;
+
+        _globalScope = new VMGlobalScope(rtCommon->_globalScope);
+
+        // 需要将 rtCommon 中的对象都复制一份.
+        for (auto item : rtCommon->_objValues) {
+            _objValues.push_back(item->clone());
+        }
+        delete _objValues[JS_OBJ_GLOBAL_THIS_IDX];
+        _objValues[JS_OBJ_GLOBAL_THIS_IDX] = new JsGlobalThis(_globalScope);
+
+        // common 的对象和全局 scope 每次 GC 时都会作为 root 扫描，不需要再加入 remembered set
+        for (auto item : _objValues) {
+            item->gcGeneration = GEN_OLD_REMEMBERED;
+        }
+        _globalScope->gcGeneration = GEN_OLD_REMEMBERED;
+
+        _firstFreeObjIdx = 0;
+    }
 
     _mainCtx = new VMContext(this, vm);
     _mainCtx->stack.reserve(MAX_STACK_SIZE);
@@ -217,18 +253,14 @@ void VMRuntime::dump(BinaryOutputStream &stream) {
 /**
  * 为了提高性能，以及避免堆栈溢出，采用 stack 以及循环的方式来拼接字符串
  */
-void VMRuntime::joinString(JsString &js) {
+void VMRuntime::copyJoinedString(const JsJoinedString &joinedString, uint8_t *p) {
     struct Item {
-        uint8_t         *p;
-        JsJoinedString  *joinedStr;
+        uint8_t                 *p;
+        const JsJoinedString    *joinedStr;
     };
 
-    assert(js.isJoinedString);
-
-    auto targStr = allocString(js.value.joinedString.len);
-
     std::stack<Item> tasks;
-    tasks.push({ (uint8_t *)targStr.data, &js.value.joinedString });
+    tasks.push({ p, &joinedString });
 
     while (!tasks.empty()) {
         auto &task = tasks.top();
@@ -296,8 +328,17 @@ void VMRuntime::joinString(JsString &js) {
             break;
         }
     }
+}
 
-    js.value.str = targStr;
+void VMRuntime::joinString(JsString &js) {
+    assert(js.isJoinedString);
+
+    auto lenUtf16 = js.value.joinedString.lenUtf16;
+    auto targStr = allocString(js.value.joinedString.len);
+    copyJoinedString(js.value.joinedString, (uint8_t *)targStr.data);
+
+    js.isJoinedString = false;
+    js.value.str = StringViewUtf16(targStr, lenUtf16);
 }
 
 JsValue VMRuntime::joinSmallString(const StringView &sz1, const StringView &sz2) {
@@ -314,103 +355,212 @@ JsValue VMRuntime::joinSmallString(const StringView &sz1, const StringView &sz2)
     return pushString(JsString(str));
 }
 
-JsValue VMRuntime::plusString(const StringView &str1, const JsValue &s2) {
-    assert(s2.type == JDT_STRING || s2.type == JDT_CHAR);
-    if (s2.type == JDT_CHAR) {
-        StringViewWrapper str2(s2);
-        return joinSmallString(str1, str2);
-    }
+JsStringBuffer *VMRuntime::allocStringBuffer(uint32_t capacity) {
+    auto buffer = (JsStringBuffer *)new uint8_t[sizeof(JsStringBuffer) + sizeof(uint32_t) + capacity];
+    buffer->refCount = 0;
+    buffer->capacity = capacity;
+    buffer->len = 0;
+    // data() 开始的字符串的偏移为 0
+    memset(buffer + 1, 0, sizeof(uint32_t));
+    return buffer;
+}
 
-    auto s2Length = getStringLength(s2);
-    if (s2Length >= JOINED_STRING_MIN_SIZE) {
-        auto s1 = pushString(str1);
+void VMRuntime::releaseStringBuffer(JsStringBuffer *buffer) {
+    assert(buffer->refCount > 0);
+    if (--buffer->refCount == 0) {
+        delete [] (uint8_t *)buffer;
+    }
+}
 
-        JsJoinedString js(s1, s2, getStringLength(s1) + s2Length);
-        return pushString(JsString(js));
+void VMRuntime::initStringOperand(const JsValue &s, StringOperand &op) {
+    assert(s.type == JDT_STRING || s.type == JDT_CHAR);
+
+    op.val = s;
+    op.depth = 0;
+    if (s.type == JDT_CHAR) {
+        op.str = StringView(op.buf, utf32CodeToUtf8(s.value.index, op.buf));
+        op.lenUtf16 = utf32CodeToUtf16Length(s.value.index);
+    } else if (s.isInResourcePool) {
+        auto &ss = getStringInResourcePool(s.value.index);
+        op.str = ss.utf8Str();
+        op.lenUtf16 = ss.size();
     } else {
-        auto &str2 = getUtf8String(s2);
-        return joinSmallString(str1, str2);
+        auto &js = _stringValues[s.value.index];
+        if (js.isJoinedString) {
+            op.str = StringView();
+            op.len = js.value.joinedString.len;
+            op.lenUtf16 = js.value.joinedString.lenUtf16;
+            op.depth = js.value.joinedString.depth;
+            return;
+        }
+
+        op.str = js.value.str.utf8Str();
+        op.lenUtf16 = js.value.str.size();
     }
+    op.len = op.str.len;
 }
 
-JsValue VMRuntime::plusString(const JsValue &s1, const StringView &str2) {
-    assert(s1.type == JDT_STRING || s1.type == JDT_CHAR);
-    if (s1.type == JDT_CHAR) {
-        StringViewWrapper str1(s1);
-        return joinSmallString(str1, str2);
-    }
+void VMRuntime::initStringOperand(const StringView &str, StringOperand &op) {
+    op.val = jsValueUndefined;
+    op.str = str;
+    op.len = str.len;
+    op.lenUtf16 = utf8ToUtf16Length((const uint8_t *)str.data, str.len);
+    op.depth = 0;
+}
 
-    auto s1Length = getStringLength(s1);
-    if (s1Length >= JOINED_STRING_MIN_SIZE) {
-        auto s2 = pushString(str2);
+/**
+ * 确保 op 是 _stringValues 中的字符串，才能被 JoinedString 引用
+ */
+void VMRuntime::pushStringOperand(StringOperand &op) {
+    if (op.val.type == JDT_STRING) {
+        return;
+    }
 
-        JsJoinedString js(s1, s2, s1Length + utf8ToUtf16Length(str2));
-        return pushString(JsString(js));
-    } else {
-        auto &str1 = getUtf8String(s1);
-        return joinSmallString(str1, str2);
+    auto str = op.str;
+    if (!str.isStable()) {
+        str = allocString(op.len);
+        memcpy((void *)str.data, op.str.data, op.len);
     }
-}
 
-JsValue VMRuntime::plusString(const JsValue &s1, const JsValue &s2) {
-    assert(s1.type == JDT_STRING || s1.type == JDT_CHAR);
-    assert(s2.type == JDT_STRING || s2.type == JDT_CHAR);
+    JsString js;
+    js.value.str = StringViewUtf16(str, op.lenUtf16);
+    op.val = pushString(js);
+    op.str = js.value.str.utf8Str();
+}
 
-    bool isJoinedString = false;
-    StringViewUtf16 ss1, ss2;
-    uint32_t lenUtf16 = 0;
-    uint8_t buf1[8], buf2[8];
+// str 是否为从 JsStringBuffer::data() 开始，且到 buffer 尾部的字符串 (JSON.parse 的切片不是)
+static inline bool isStringBufferTail(const StringView &str) {
+    auto buffer = JsStringBuffer::fromData(str.data);
+    return (uint8_t *)str.data == buffer->data() && buffer->len == str.len;
+}
 
-    if (s1.type == JDT_CHAR) {
-        lenUtf16 = utf32CodeToUtf16Length(s1.value.index);
-        ss1.set(StringView(buf1, utf32CodeToUtf8(s1.value.index, buf1)));
-    } else {
-        if (s1.isInResourcePool) {
-            ss1 = getStringInResourcePool(s1.value.index);
-            lenUtf16 += ss1.size();
-        } else {
-            auto &js1 = _stringValues[s1.value.index];
-            lenUtf16 += js1.lenUtf16();
-            if (js1.isJoinedString) {
-                isJoinedString = true;
-            } else {
-                ss1 = js1.value.str;
-            }
+/**
+ * s1 为 JoinedString 或者在 JsStringBuffer 的尾部，将 s2 追加到 JsStringBuffer 中.
+ * JsStringBuffer 的容量不够时按照 1.5 倍分配新的 buffer，之前的字符串仍然引用旧的 buffer.
+ */
+JsValue VMRuntime::appendToStringBuffer(StringOperand &op1, StringOperand &op2) {
+    auto len = op1.len + op2.len;
+
+    if (op2.depth > 0) {
+        // 需要先拼接 s2 (s2 可能和 s1 是同一个字符串)
+        auto &js2 = _stringValues[op2.val.value.index];
+        if (js2.isJoinedString) {
+            joinString(js2);
         }
+        op2.str = js2.value.str.utf8Str();
+        op2.depth = 0;
+    }
+
+    auto &js1 = _stringValues[op1.val.value.index];
+    JsStringBuffer *buffer = nullptr;
+    if (js1.isInStringBuffer) {
+        buffer = JsStringBuffer::fromData(js1.value.str.utf8Str().data);
     }
 
-    if (s2.type == JDT_CHAR) {
-        lenUtf16 += utf32CodeToUtf16Length(s2.value.index);
-        ss2.set(StringView(buf2, utf32CodeToUtf8(s2.value.index, buf2)));
+    if (buffer && isStringBufferTail(js1.value.str.utf8Str()) && buffer->capacity >= len) {
+        // 直接在尾部追加
+        memcpy(buffer->data() + op1.len, op2.str.data, op2.len);
     } else {
-        if (s2.isInResourcePool) {
-            ss2 = getStringInResourcePool(s2.value.index);
-            lenUtf16 += ss2.size();
+        auto capacity = (uint32_t)std::min((uint64_t)len + len / 2, (uint64_t)LEN_MAX_STRING);
+        buffer = allocStringBuffer(std::max(std::max(capacity, len), (uint32_t)STRING_BUFFER_MIN_CAPACITY));
+        auto p = buffer->data();
+        if (js1.isJoinedString) {
+            // s1 也拼接到新的 buffer 中
+            copyJoinedString(js1.value.joinedString, p);
+            js1.isJoinedString = false;
+            js1.isInStringBuffer = true;
+            js1.value.str = StringViewUtf16(StringView(p, op1.len), op1.lenUtf16);
+            buffer->refCount++;
         } else {
-            auto &js2 = _stringValues[s2.value.index];
-            lenUtf16 += js2.lenUtf16();
-            if (js2.isJoinedString) {
-                isJoinedString = true;
-            } else {
-                ss2 = js2.value.str;
-            }
+            memcpy(p, js1.value.str.utf8Str().data, op1.len);
         }
+        memcpy(p + op1.len, op2.str.data, op2.len);
     }
 
-    if (isJoinedString) {
-        // 任何一个是 JoinedString
-        JsJoinedString js(s1, s2, lenUtf16);
-        return pushString(JsString(js));
+    buffer->len = len;
+    buffer->refCount++;
+
+    JsString js;
+    js.isInStringBuffer = true;
+    js.value.str = StringViewUtf16(StringView(buffer->data(), len), op1.lenUtf16 + op2.lenUtf16);
+    return pushString(js);
+}
+
+/**
+ * 拼接字符串:
+ * 1. 较短的字符串直接复制拼接
+ * 2. s1 为 JoinedString，或者在 JsStringBuffer 的尾部时 (s += x 的循环)，追加到 JsStringBuffer 中
+ * 3. 其他情况创建 JoinedString，在使用时才拼接
+ */
+JsValue VMRuntime::plusString(StringOperand &op1, StringOperand &op2) {
+    if (op1.len == 0 || op2.len == 0) {
+        auto &op = op1.len == 0 ? op2 : op1;
+        return op.val.type == JDT_UNDEFINED ? pushString(op.str) : op.val;
     }
 
-    if (lenUtf16 >= JOINED_STRING_MIN_SIZE) {
-        // 超过 JOINED_STRING_MIN_SIZE，连接两个字符串
-        JsJoinedString js(s1, s2, lenUtf16);
-        return pushString(JsString(js));
-    } else {
+    auto len = op1.len + op2.len;
+    if (len < JOINED_STRING_MIN_SIZE) {
         // 直接拼接
-        return joinSmallString(ss1.utf8Str(), ss2.utf8Str());
+        assert(op1.depth == 0 && op2.depth == 0);
+        return joinSmallString(op1.str, op2.str);
+    }
+
+    if (op1.val.type == JDT_STRING && !op1.val.isInResourcePool) {
+        auto &js1 = _stringValues[op1.val.value.index];
+        if (js1.isJoinedString || (js1.isInStringBuffer && isStringBufferTail(js1.value.str.utf8Str()))) {
+            return appendToStringBuffer(op1, op2);
+        }
+    }
+
+    if (op2.depth > 0 && op1.len < JOINED_STRING_MIN_SIZE) {
+        // 在 JoinedString 的头部添加较短的字符串时，和头部合并，避免产生大量较短的节点
+        auto joined = _stringValues[op2.val.value.index].value.joinedString;
+        if (!joined.isStringIdxInResourcePool) {
+            auto &head = _stringValues[joined.stringIdx];
+            if (!head.isJoinedString && op1.len + head.value.str.utf8Str().len < JOINED_STRING_MIN_SIZE) {
+                auto merged = joinSmallString(op1.str, head.value.str.utf8Str());
+                assert(merged.type == JDT_STRING);
+                joined.stringIdx = merged.value.index;
+                joined.len += op1.len;
+                joined.lenUtf16 += op1.lenUtf16;
+                return pushString(JsString(joined));
+            }
+        }
     }
+
+    pushStringOperand(op1);
+    pushStringOperand(op2);
+
+    if (std::max(op1.depth, op2.depth) >= JOINED_STRING_MAX_DEPTH) {
+        // 拼接较深的一边，限制 JoinedString 的深度
+        auto &op = op1.depth >= op2.depth ? op1 : op2;
+        joinString(_stringValues[op.val.value.index]);
+        op.depth = 0;
+    }
+
+    JsJoinedString joined(op1.val, op2.val, len, op1.lenUtf16 + op2.lenUtf16, std::max(op1.depth, op2.depth) + 1);
+    return pushString(JsString(joined));
+}
+
+JsValue VMRuntime::plusString(const StringView &str1, const JsValue &s2) {
+    StringOperand op1, op2;
+    initStringOperand(str1, op1);
+    initStringOperand(s2, op2);
+    return plusString(op1, op2);
+}
+
+JsValue VMRuntime::plusString(const JsValue &s1, const StringView &str2) {
+    StringOperand op1, op2;
+    initStringOperand(s1, op1);
+    initStringOperand(str2, op2);
+    return plusString(op1, op2);
+}
+
+JsValue VMRuntime::plusString(const JsValue &s1, const JsValue &s2) {
+    StringOperand op1, op2;
+    initStringOperand(s1, op1);
+    initStringOperand(s2, op2);
+    return plusString(op1, op2);
 }
 
 JsValue VMRuntime::pushObject(IJsObject *value) {
@@ -419,50 +569,38 @@ JsValue VMRuntime::pushObject(IJsObject *value) {
     uint32_t n;
     if (_firstFreeObjIdx) {
         n = _firstFreeObjIdx;
-        _firstFreeObjIdx = _objValues[_firstFreeObjIdx]->nextFreeIdx;
-        delete _objValues[_firstFreeObjIdx];
-        _objValues[_firstFreeObjIdx] = value;
+        _firstFreeObjIdx = _objValues[n]->nextFreeIdx;
+        _freeDummyObjs.push_back(_objValues[n]);
+        _objValues[n] = value;
     } else {
         n = (uint32_t)_objValues.size();
         _objValues.push_back(value);
     }
+    _youngObjs.push_back(n);
 
     assert(value->type >= JDT_OBJECT);
     auto jsv = JsValue(value->type, n);
     value->self = jsv;
+    addTempValue(jsv);
     return jsv;
 }
 
-JsValue VMRuntime::pushDouble(double value) {
-    _newAllocatedCount++;
-    uint32_t n;
-
-    if (_firstFreeDoubleIdx) {
-        n = _firstFreeDoubleIdx;
-        _firstFreeDoubleIdx = _doubleValues[_firstFreeDoubleIdx].nextFreeIdx;
-        _doubleValues[_firstFreeDoubleIdx] = JsDouble(value);
-    } else {
-        n = (uint32_t)_doubleValues.size();
-        _doubleValues.push_back(JsDouble(value));
-    }
-
-    return JsValue(JDT_NUMBER, n);
-}
-
 JsValue VMRuntime::pushSymbol(const JsSymbol &value) {
     _newAllocatedCount++;
     uint32_t n;
 
     if (_firstFreeSymbolIdx) {
         n = _firstFreeSymbolIdx;
-        _firstFreeSymbolIdx = _symbolValues[_firstFreeSymbolIdx].nextFreeIdx;
-        _symbolValues[_firstFreeSymbolIdx] = value;
+        _firstFreeSymbolIdx = _symbolValues[n].nextFreeIdx;
+        _symbolValues[n] = value;
     } else {
         n = (uint32_t)_symbolValues.size();
         _symbolValues.push_back(value);
     }
 
-    return JsValue(JDT_SYMBOL, n);
+    auto jsv = JsValue(JDT_SYMBOL, n);
+    addTempValue(jsv);
+    return jsv;
 }
 
 JsValue VMRuntime::pushGetterSetter(const JsGetterSetter &value) {
@@ -471,14 +609,16 @@ JsValue VMRuntime::pushGetterSetter(const JsGetterSetter &value) {
 
     if (_firstFreeGetterSetterIdx) {
         n = _firstFreeGetterSetterIdx;
-        _firstFreeGetterSetterIdx = _getterSetters[_firstFreeGetterSetterIdx].nextFreeIdx;
-        _getterSetters[_firstFreeGetterSetterIdx] = value;
+        _firstFreeGetterSetterIdx = _getterSetters[n].nextFreeIdx;
+        _getterSetters[n] = value;
     } else {
         n = (uint32_t)_getterSetters.size();
         _getterSetters.push_back(value);
     }
 
-    return JsValue(JDT_GETTER_SETTER, n);
+    auto jsv = JsValue(JDT_GETTER_SETTER, n);
+    addTempValue(jsv);
+    return jsv;
 }
 
 JsValue VMRuntime::pushString(const JsString &str) {
@@ -487,14 +627,17 @@ JsValue VMRuntime::pushString(const JsString &str) {
 
     if (_firstFreeStringIdx) {
         n = _firstFreeStringIdx;
-        _firstFreeStringIdx = _stringValues[_firstFreeStringIdx].nextFreeIdx;
-        _stringValues[_firstFreeStringIdx] = str;
+        _firstFreeStringIdx = _stringValues[n].nextFreeIdx;
+        _stringValues[n] = str;
     } else {
         n = (uint32_t)_stringValues.size();
         _stringValues.push_back(str);
     }
+    _youngStrings.push_back(n);
 
-    return JsValue(JDT_STRING, n);
+    auto jsv = JsValue(JDT_STRING, n);
+    addTempValue(jsv);
+    return jsv;
 }
 
 JsValue VMRuntime::pushString(const StringView &str) {
@@ -545,11 +688,18 @@ VMScope *VMRuntime::newScope(Scope *scope) {
     if (_firstFreeVMScopeIdx) {
         auto vs = _vmScopes[_firstFreeVMScopeIdx];
         vs->scopeDsc = scope;
+        if (scope) {
+            vs->vars.resize(scope->countLocalVars, jsValueUndefined.asProperty());
+        }
+        _youngScopes.push_back(_firstFreeVMScopeIdx);
         _firstFreeVMScopeIdx = vs->nextFreeIdx;
         vs->nextFreeIdx = 0;
+        vs->referIdx = 0;
+        vs->gcGeneration = GEN_YOUNG;
         return vs;
     } else {
         auto vs = new VMScope(scope);
+        _youngScopes.push_back((int)_vmScopes.size());
         _vmScopes.push_back(vs);
         return vs;
     }
@@ -562,6 +712,7 @@ ResourcePool *VMRuntime::newResourcePool() {
         auto rp = _resourcePools[_firstFreeResourcePoolIdx];
         _firstFreeResourcePoolIdx = rp->nextFreeIdx;
         rp->nextFreeIdx = 0;
+        rp->referIdx = 0;
         return rp;
     } else {
         auto rp = new ResourcePool((uint32_t)_resourcePools.size());
@@ -832,7 +983,7 @@ void VMRuntime::extendObject(VMContext *ctx, const JsValue &dst, const JsValue &
 template<typename ARRAY>
 uint32_t freeValues(ARRAY &arr, uint32_t startIdx, uint32_t _firstFreeIdx, uint8_t nextRefIdx, uint32_t &countFreedOut) {
 
-    // 将未标记的对象释放了
+    // 将未标记的对象释放了，存活的对象的 referIdx 恢复为 0
     uint32_t size = (uint32_t)arr.size();
     for (uint32_t i = startIdx; i < size; i++) {
         auto &item = arr[i];
@@ -840,73 +991,324 @@ uint32_t freeValues(ARRAY &arr, uint32_t startIdx, uint32_t _firstFreeIdx, uint8
             item.nextFreeIdx = _firstFreeIdx;
             _firstFreeIdx = i;
             countFreedOut++;
+        } else {
+            item.referIdx = 0;
         }
     }
 
     return _firstFreeIdx;
 }
 
+static uint64_t getTimeInMicroseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 /**
  * 统计分配的各类存储对象的数量
  */
 uint32_t VMRuntime::countAllocated() const {
-    return uint32_t(_doubleValues.size() - _countCommonDobules
-        + _symbolValues.size() + _stringValues.size() - _countCommonStrings
+    return uint32_t(_symbolValues.size() + _stringValues.size() - _countCommonStrings
         + _objValues.size() - _countCommonObjs
         + _vmScopes.size() + _resourcePools.size());
 }
 
+void VMRuntime::rememberObject(IJsObject *obj) {
+    assert(obj->gcGeneration == GEN_OLD);
+    obj->gcGeneration = GEN_OLD_REMEMBERED;
+    _rememberedObjs.push_back(obj);
+}
+
 /**
- * 返回释放的对象数量
+ * 标记 GC 的根: common 对象、全局 scope、调用栈、临时值和任务队列
  */
-uint32_t VMRuntime::garbageCollect() {
-    // 先标记所有的对象
+void VMRuntime::markRoots() {
     for (uint32_t i = 1; i < _countCommonObjs; i++) {
         auto item = _objValues[i];
         item->referIdx = _nextRefIdx;
         item->markReferIdx(this);
     }
 
+    markScopeReferIdx(_globalScope);
+    markReferIdx(_mainCtx);
+
+    for (auto &item : _tempValues) {
+        markReferIdx(item);
+    }
+
     _timerTasks.markReferIdx(this);
     _promiseTasks.markReferIdx(this);
+}
+
+void VMRuntime::markAllObjects() {
+    while (!_toMarkObjs.empty()) {
+        auto obj = _toMarkObjs.back();
+        _toMarkObjs.pop_back();
+        obj->markReferIdx(this);
+    }
+}
+
+/**
+ * WeakMap 的 value 只在其 key 存活时才存活 (ephemeron): 标记 value 又可能使其他 WeakMap 的 key 存活，
+ * 所以重复标记直到没有新的对象被标记. 最后删除 key 没有被标记的 entry.
+ */
+void VMRuntime::markWeakMaps() {
+    bool isMarkedNew = true;
+    while (isMarkedNew) {
+        // 标记过程中可能会登记新的 WeakMap, 不能使用 iterator
+        for (size_t i = 0; i < _markedWeakMaps.size(); i++) {
+            _markedWeakMaps[i]->markLiveValues(this);
+        }
+
+        isMarkedNew = !_toMarkObjs.empty();
+        markAllObjects();
+    }
+
+    for (auto weakMap : _markedWeakMaps) {
+        weakMap->removeDeadKeys(this);
+    }
+    _markedWeakMaps.clear();
+}
+
+bool VMRuntime::isObjectMarked(const JsValue &val) {
+    assert(val.type >= JDT_OBJECT);
+    if (val.value.index < _countCommonObjs) {
+        return true;
+    }
+
+    auto obj = _objValues[val.value.index];
+    if (_isMinorGc && obj->gcGeneration != GEN_YOUNG) {
+        return true;
+    }
+    return obj->referIdx == _nextRefIdx;
+}
+
+/**
+ * 新生代中存活的值晋升到老年代.
+ * minor GC 时同时释放新生代中未标记的值; major GC 时由之后的完整清除来释放.
+ */
+void VMRuntime::promoteYoungValues(bool isMinorGc, bool isKeepRemembered, uint32_t &countFreedOut) {
+    uint32_t countPromoted = 0;
+
+    for (auto i : _youngStrings) {
+        auto &item = _stringValues[i];
+        if (item.referIdx == _nextRefIdx) {
+            item.isOld = true;
+            countPromoted++;
+            if (isMinorGc) {
+                item.referIdx = 0;
+            }
+        } else if (isMinorGc) {
+            freeStringValue(i);
+            countFreedOut++;
+        }
+    }
+
+    for (auto i : _youngObjs) {
+        auto item = _objValues[i];
+        if (item->referIdx == _nextRefIdx) {
+            countPromoted++;
+            if (isKeepRemembered) {
+                // 外层的 C++ 代码可能持有其指针，并在之后写入新生代的值
+                item->gcGeneration = GEN_OLD_REMEMBERED;
+                _rememberedObjs.push_back(item);
+            } else {
+                item->gcGeneration = GEN_OLD;
+            }
+            if (isMinorGc) {
+                item->referIdx = 0;
+            }
+        } else if (isMinorGc) {
+            delete item;
+            _objValues[i] = item = newFreeObjectSlot();
+            item->nextFreeIdx = _firstFreeObjIdx;
+            _firstFreeObjIdx = i;
+            countFreedOut++;
+        }
+    }
+
+    for (auto i : _youngScopes) {
+        auto item = _vmScopes[i];
+        if (item->referIdx == _nextRefIdx) {
+            item->gcGeneration = GEN_OLD;
+            countPromoted++;
+            if (isMinorGc) {
+                item->referIdx = 0;
+            }
+        } else if (isMinorGc) {
+            item->free();
+            item->nextFreeIdx = _firstFreeVMScopeIdx;
+            _firstFreeVMScopeIdx = i;
+            countFreedOut++;
+        }
+    }
+
+    _youngStrings.clear();
+    _youngObjs.clear();
+    _youngScopes.clear();
+
+    if (isMinorGc) {
+        _countPromotedSinceMajorGc += countPromoted;
+    }
+    _gcStats.countPromoted += countPromoted;
+}
+
+/**
+ * isKeepRemembered 为 true 时保留 remembered set (只移除 major GC 中将被释放的).
+ */
+void VMRuntime::clearRememberedSet(bool isMinorGc, bool isKeepRemembered) {
+    if (isMinorGc) {
+        // remembered 的对象作为 root 被标记过，需要恢复其 referIdx
+        for (auto obj : _rememberedObjs) {
+            obj->referIdx = 0;
+        }
+    }
+
+    if (isKeepRemembered) {
+        if (!isMinorGc) {
+            auto isFreed = [this](auto item) { return item->referIdx != _nextRefIdx; };
+            _rememberedObjs.erase(std::remove_if(_rememberedObjs.begin(), _rememberedObjs.end(), isFreed), _rememberedObjs.end());
+            _rememberedScopes.erase(std::remove_if(_rememberedScopes.begin(), _rememberedScopes.end(), isFreed), _rememberedScopes.end());
+        }
+        return;
+    }
+
+    for (auto obj : _rememberedObjs) {
+        obj->gcGeneration = GEN_OLD;
+    }
+    _rememberedObjs.clear();
+
+    for (auto scope : _rememberedScopes) {
+        scope->gcGeneration = GEN_OLD;
+    }
+    _rememberedScopes.clear();
+}
+
+/**
+ * 调用栈中的 scope 在 GC 之后仍可能被写入新生代的值
+ */
+void VMRuntime::rememberActiveScopes() {
+#if VM_GENERATIONAL_GC
+    for (auto frame : _mainCtx->stackFrames) {
+        rememberScope(frame->scope);
+        rememberScope(frame->functionScope);
+        for (auto scope : frame->stackScopes) {
+            rememberScope(scope);
+        }
+    }
+
+    if (_mainCtx->curFunctionScope) {
+        rememberScope(_mainCtx->curFunctionScope);
+    }
+#endif
+}
+
+void VMRuntime::freeStringValue(uint32_t index) {
+    auto &item = _stringValues[index];
+    if (!item.isJoinedString) {
+        auto &str = item.value.str;
+        if (item.isInStringBuffer) {
+            releaseStringBuffer(JsStringBuffer::fromData(str.utf8Str().data));
+        } else if (str.utf8Str().data && !str.utf8Str().isStable()) {
+            freeString(str.utf8Str());
+        }
+        if (str.offsetIndex()) {
+            freeOffsetIndex(str);
+        }
+    }
+    item.isJoinedString = false;
+    item.isInStringBuffer = false;
+    item.value.str = StringViewUtf16();
+    item.nextFreeIdx = _firstFreeStringIdx;
+    _firstFreeStringIdx = index;
+}
+
+/**
+ * 返回放置在空闲位置上的 JsDummyObject
+ */
+IJsObject *VMRuntime::newFreeObjectSlot() {
+    IJsObject *obj;
+    if (_freeDummyObjs.empty()) {
+        obj = new JsDummyObject();
+    } else {
+        obj = _freeDummyObjs.back();
+        _freeDummyObjs.pop_back();
+    }
+
+    obj->referIdx = REFER_IDX_FREE_OBJ_SLOT;
+    return obj;
+}
+
+void VMRuntime::updateGcStats(bool isMinorGc, uint64_t startTime) {
+    auto pause = getTimeInMicroseconds() - startTime;
+    _countGarbageCollect++;
+    if (isMinorGc) {
+        _gcStats.countMinor++;
+        _gcStats.minorPauseTotal += pause;
+        _gcStats.minorPauseMax = std::max(_gcStats.minorPauseMax, (uint32_t)pause);
+    } else {
+        _gcStats.countMajor++;
+        _gcStats.majorPauseTotal += pause;
+        _gcStats.majorPauseMax = std::max(_gcStats.majorPauseMax, (uint32_t)pause);
+    }
+}
+
+/**
+ * 返回释放的对象数量
+ */
+uint32_t VMRuntime::garbageCollect() {
+    auto startTime = getTimeInMicroseconds();
+    bool isKeepRemembered = _vmCallDepth > 1;
+
+    // 先标记所有的对象
+    markRoots();
+    markAllObjects();
+    markWeakMaps();
+
+    uint32_t countFreed = 0;
+
+    clearRememberedSet(false, isKeepRemembered);
+    promoteYoungValues(false, isKeepRemembered, countFreed);
 
     //
     // 释放未标记的对象
+    // 已经释放的对象也不会被标记，所以每次都重新生成空闲链表
     //
-    uint32_t countFreed = 0;
-
-    _firstFreeDoubleIdx = freeValues(_doubleValues, _countCommonDobules, _firstFreeDoubleIdx, _nextRefIdx, countFreed);
-    _firstFreeSymbolIdx = freeValues(_symbolValues, 0, _firstFreeSymbolIdx, _nextRefIdx, countFreed);
-    _firstFreeGetterSetterIdx = freeValues(_getterSetters, 0, _firstFreeGetterSetterIdx, _nextRefIdx, countFreed);
+    _firstFreeSymbolIdx = freeValues(_symbolValues, 0, 0, _nextRefIdx, countFreed);
+    _firstFreeGetterSetterIdx = freeValues(_getterSetters, 0, 0, _nextRefIdx, countFreed);
 
+    _firstFreeStringIdx = 0;
     auto size = (uint32_t)_stringValues.size();
     for (uint32_t i = _countCommonStrings; i < size; i++) {
         auto &item = _stringValues[i];
         if (item.referIdx != _nextRefIdx) {
-            item.nextFreeIdx = _firstFreeStringIdx;
-            _firstFreeStringIdx = i;
-            if (!item.value.str.utf8Str().isStable()) {
-                freeString(item.value.str.utf8Str());
-            }
-            if (item.value.str.utf16Data()) {
-                freeUtf16String(item.value.str);
-            }
+            freeStringValue(i);
             countFreed++;
+        } else {
+            item.referIdx = 0;
         }
     }
 
+    _firstFreeObjIdx = 0;
     size = (uint32_t)_objValues.size();
     for (uint32_t i = _countCommonObjs; i < size; i++) {
         auto item = _objValues[i];
-        if (item->referIdx != _nextRefIdx) {
+        if (item->referIdx == REFER_IDX_FREE_OBJ_SLOT) {
+            item->nextFreeIdx = _firstFreeObjIdx;
+            _firstFreeObjIdx = i;
+            countFreed++;
+        } else if (item->referIdx != _nextRefIdx) {
             delete item;
-            _objValues[i] = item = new JsDummyObject();
+            _objValues[i] = item = newFreeObjectSlot();
             item->nextFreeIdx = _firstFreeObjIdx;
             _firstFreeObjIdx = i;
             countFreed++;
+        } else {
+            item->referIdx = 0;
         }
     }
 
+    _firstFreeVMScopeIdx = 0;
     size = (uint32_t)_vmScopes.size();
     for (uint32_t i = 0; i < size; i++) {
         auto item = _vmScopes[i];
@@ -915,9 +1317,13 @@ uint32_t VMRuntime::garbageCollect() {
             item->nextFreeIdx = _firstFreeVMScopeIdx;
             _firstFreeVMScopeIdx = i;
             countFreed++;
+        } else {
+            item->referIdx = 0;
         }
     }
+    _globalScope->referIdx = 0;
 
+    _firstFreeResourcePoolIdx = 0;
     size = (uint32_t)_resourcePools.size();
     for (uint32_t i = 0; i < size; i++) {
         auto item = _resourcePools[i];
@@ -926,52 +1332,191 @@ uint32_t VMRuntime::garbageCollect() {
             item->nextFreeIdx = _firstFreeResourcePoolIdx;
             _firstFreeResourcePoolIdx = i;
             countFreed++;
+        } else {
+            item->referIdx = 0;
         }
     }
 
+    rememberActiveScopes();
+
+    // referIdx 为 int8_t，所以 _nextRefIdx 只能在 [1, 127] 之间循环
     _nextRefIdx++;
-    if (_nextRefIdx == 0) {
+    if (_nextRefIdx > 127) {
         _nextRefIdx = 1;
     }
+
+    _countLiveAfterMajorGc = countAllocated() - countFreed;
+    _countPromotedSinceMajorGc = 0;
+
+    _newAllocatedCount = 0;
+#if VM_GENERATIONAL_GC
+    // 新生代的大小是固定的，老年代的增长由 garbageCollectAuto() 控制
+    _gcAllocatedCountThreshold = _gcAllocatedCountThresholdMin;
+#else
+    // 存活的对象越多，下次 GC 前允许分配的对象也越多
+    _gcAllocatedCountThreshold = std::max(_gcAllocatedCountThresholdMin, _countLiveAfterMajorGc);
+#endif
+
+    updateGcStats(false, startTime);
+
     return countFreed;
 }
 
+/**
+ * 只回收新生代中的值: 从根和 remembered set 开始标记，不会进入老年代的值.
+ * 返回释放的对象数量
+ */
+uint32_t VMRuntime::garbageCollectMinor() {
+#if VM_GENERATIONAL_GC
+    auto startTime = getTimeInMicroseconds();
+    bool isKeepRemembered = _vmCallDepth > 1;
+
+    _isMinorGc = true;
+
+    if (_isVerifyWriteBarrier) {
+        verifyWriteBarrier();
+    }
+
+    markRoots();
+
+    for (auto obj : _rememberedObjs) {
+        obj->referIdx = _nextRefIdx;
+        obj->markReferIdx(this);
+    }
+
+    for (auto scope : _rememberedScopes) {
+        markScopeReferIdx(scope);
+    }
+
+    markAllObjects();
+    markWeakMaps();
+
+    uint32_t countFreed = 0;
+    promoteYoungValues(true, isKeepRemembered, countFreed);
+
+    // 老年代的值在 minor GC 中也可能被标记了，恢复其 referIdx
+    for (auto scope : _markedOldScopes) {
+        scope->referIdx = 0;
+    }
+    _markedOldScopes.clear();
+    _globalScope->referIdx = 0;
+
+    clearRememberedSet(true, isKeepRemembered);
+    rememberActiveScopes();
+
+    _isMinorGc = false;
+
+    _nextRefIdx++;
+    if (_nextRefIdx > 127) {
+        _nextRefIdx = 1;
+    }
+
+    _newAllocatedCount = 0;
+    _gcAllocatedCountThreshold = _gcAllocatedCountThresholdMin;
+
+    updateGcStats(true, startTime);
+
+    return countFreed;
+#else
+    return garbageCollect();
+#endif
+}
+
+uint32_t VMRuntime::garbageCollectAuto() {
+#if VM_GENERATIONAL_GC
+    if (_countPromotedSinceMajorGc >= std::max(_gcAllocatedCountThresholdMin, _countLiveAfterMajorGc)) {
+        // 老年代的大小已经增长了一倍以上
+        return garbageCollect();
+    }
+
+    return garbageCollectMinor();
+#else
+    return garbageCollect();
+#endif
+}
+
+/**
+ * 老年代的对象引用了新生代的值时，必须在 remembered set 中
+ */
+void VMRuntime::verifyWriteBarrier() {
+    _isVerifyingOldObj = true;
+
+    for (uint32_t i = _countCommonObjs; i < _objValues.size(); i++) {
+        auto obj = _objValues[i];
+        if (obj->gcGeneration == GEN_OLD) {
+            auto countMissed = _countMissedWriteBarriers;
+            obj->referIdx = _nextRefIdx;
+            obj->markReferIdx(this);
+            obj->referIdx = 0;
+            if (countMissed != _countMissedWriteBarriers) {
+                printf("Missed writeBarrier: object %d, type: %d\n", i, obj->type);
+            }
+        }
+    }
+
+    _isVerifyingOldObj = false;
+}
+
+bool VMRuntime::isYoungValue(const JsValue &val) {
+    switch (val.type) {
+        case JDT_STRING:
+            return !val.isInResourcePool && val.value.index >= _countCommonStrings
+                && !_stringValues[val.value.index].isOld;
+        case JDT_GETTER_SETTER: {
+            auto &item = _getterSetters[val.value.index];
+            return isYoungValue(item.getter) || isYoungValue(item.setter);
+        }
+        case JDT_NATIVE_FUNCTION:
+            return false;
+        default:
+            return val.type >= JDT_OBJECT && val.value.index >= _countCommonObjs
+                && _objValues[val.value.index]->gcGeneration == GEN_YOUNG;
+    }
+}
+
 void VMRuntime::markReferIdx(const JsValue &val) {
     if (val.type < JDT_NUMBER) {
         return;
     }
 
+    if (_isVerifyingOldObj) {
+        if (isYoungValue(val)) {
+            _countMissedWriteBarriers++;
+        }
+        return;
+    }
+
     switch (val.type) {
         case JDT_NUMBER: {
-            if (val.value.index < _countCommonDobules) {
-                if (val.isInResourcePool) {
-                    markResourcePoolReferIdx(val.value.index);
-                } else {
-                    _doubleValues[val.value.index].referIdx = _nextRefIdx;
-                }
+            if (!val.isInlineDouble && val.isInResourcePool) {
+                markResourcePoolReferIdx(val.value.index);
             }
             break;
         }
         case JDT_SYMBOL: {
-            assert(val.value.index < _symbolValues.size());
-            _symbolValues[val.value.index].referIdx = _nextRefIdx;
+            markSymbolUsed(val.value.index);
             break;
         }
         case JDT_GETTER_SETTER: {
             assert(val.value.index < _getterSetters.size());
-            _getterSetters[val.value.index].referIdx = _nextRefIdx;
+            auto &item = _getterSetters[val.value.index];
+            if (_isMinorGc) {
+                // getter/setter 不分代，minor GC 时只标记其引用的值
+                markReferIdx(item.getter);
+                markReferIdx(item.setter);
+            } else if (item.referIdx != _nextRefIdx) {
+                item.referIdx = _nextRefIdx;
+                markReferIdx(item.getter);
+                markReferIdx(item.setter);
+            }
             break;
         }
         case JDT_STRING: {
-            if (val.value.index < _countCommonStrings) {
-                break;
-            }
-
             if (val.isInResourcePool) {
                 markResourcePoolReferIdx(val.value.index);
-            } else {
+            } else if (val.value.index >= _countCommonStrings) {
                 auto &item = _stringValues[val.value.index];
-                if (item.referIdx != _nextRefIdx) {
+                if (item.referIdx != _nextRefIdx && !(_isMinorGc && item.isOld)) {
                     item.referIdx = _nextRefIdx;
                     if (item.isJoinedString) {
                         markJoinedStringReferIdx(item.value.joinedString);
@@ -980,26 +1525,112 @@ void VMRuntime::markReferIdx(const JsValue &val) {
             }
             break;
         }
+        case JDT_NATIVE_FUNCTION: {
+            // index 为 native function 的索引，不需要回收
+            break;
+        }
         default: {
-            if (val.value.index < _countCommonObjs) {
-                auto obj = getObject(val);
-                if (obj->referIdx != _nextRefIdx) {
-                    obj->referIdx = _nextRefIdx;
-                    obj->markReferIdx(this);
-                }
+            if (val.value.index >= _countCommonObjs) {
+                assert(!val.isInResourcePool);
+                markReferIdx(_objValues[val.value.index]);
             }
             break;
         }
     }
 }
 
+void VMRuntime::markReferIdx(IJsObject *obj) {
+    if (_isVerifyingOldObj) {
+        if (obj->self.type == JDT_UNDEFINED) {
+            // 不在 _objValues 中的对象 (比如 iterator 内部使用的)，检查其引用的值
+            obj->referIdx = _nextRefIdx;
+            obj->markReferIdx(this);
+            obj->referIdx = 0;
+        } else if (obj->gcGeneration == GEN_YOUNG) {
+            _countMissedWriteBarriers++;
+        }
+        return;
+    }
+
+    if (_isMinorGc && obj->gcGeneration != GEN_YOUNG) {
+        // 老年代的对象如果引用了新生代的值，会在 remembered set 中
+        return;
+    }
+
+    if (obj->referIdx != _nextRefIdx) {
+        obj->referIdx = _nextRefIdx;
+        _toMarkObjs.push_back(obj);
+    }
+}
+
 void VMRuntime::markReferIdx(VMScope *scope) {
+    if (_isVerifyingOldObj) {
+        if (scope->gcGeneration == GEN_YOUNG) {
+            _countMissedWriteBarriers++;
+        }
+        return;
+    }
+
+    if (_isMinorGc && scope->gcGeneration != GEN_YOUNG) {
+        return;
+    }
+
+    markScopeReferIdx(scope);
+}
+
+/**
+ * 不论 scope 是否在新生代都会标记其引用的值 (用于根和 remembered set 中的 scope)
+ */
+void VMRuntime::markScopeReferIdx(VMScope *scope) {
     if (scope->referIdx == _nextRefIdx) {
         return;
     }
 
     scope->referIdx = _nextRefIdx;
+    if (_isMinorGc && scope->gcGeneration != GEN_YOUNG) {
+        _markedOldScopes.push_back(scope);
+    }
+
+    for (auto &item : scope->vars) {
+        markReferIdx(item);
+    }
 
+    auto &args = scope->args;
+    for (uint32_t i = 0; i < args.capacity; i++) {
+        markReferIdx(args.data[i]);
+    }
+
+    markReferIdx(scope->withValue);
+
+    if (scope->scopeDsc && scope->scopeDsc->function) {
+        markReferIdx(scope->scopeDsc->function->resourcePool);
+    }
+}
+
+/**
+ * 标记函数调用栈中正在使用的值
+ */
+void VMRuntime::markReferIdx(VMContext *ctx) {
+    for (auto &item : ctx->stack) {
+        markReferIdx(item);
+    }
+
+    for (auto &frame : ctx->stackFrames) {
+        markScopeReferIdx(frame->scope);
+        markReferIdx(frame->function->resourcePool);
+        for (auto scope : frame->stackScopes) {
+            markScopeReferIdx(scope);
+        }
+        markReferIdx(frame->thiz);
+        markReferIdx(frame->retValue);
+        if (frame->generator) {
+            markReferIdx(frame->generator);
+        }
+    }
+
+    markReferIdx(ctx->retValue);
+    markReferIdx(ctx->errorMessage);
+    markReferIdx(ctx->errorMessageInTry);
 }
 
 void VMRuntime::markJoinedStringReferIdx(const JsJoinedString &joinedString) {
@@ -1023,7 +1654,7 @@ void VMRuntime::markJoinedStringReferIdx(const JsJoinedString &joinedString) {
         stackStrings.pop_back();
 
         auto &js = _stringValues[idx];
-        if (js.referIdx != _nextRefIdx) {
+        if (js.referIdx != _nextRefIdx && !(_isMinorGc && js.isOld)) {
             js.referIdx = _nextRefIdx;
             if (js.isJoinedString) {
                 auto &joinedString = js.value.joinedString;
@@ -1043,21 +1674,35 @@ void VMRuntime::markJoinedStringReferIdx(const JsJoinedString &joinedString) {
     }
 }
 
-void VMRuntime::convertUtf8ToUtf16(StringViewUtf16 &str) {
-    assert(str.utf16Data() == nullptr);
+void VMRuntime::buildOffsetIndex(StringViewUtf16 &str) {
+    assert(str.offsetIndex() == nullptr);
 
-    auto &utf8Str = str.utf8Str();
-    auto dataUtf16 = new utf16_t[str.size()];
-    utf8ToUtf16((uint8_t *)utf8Str.data, utf8Str.len, dataUtf16, str.size());
-    str.setUtf16(dataUtf16, str.size());
+    auto buf = new uint8_t[Utf8OffsetIndex::memorySize(str.size())];
+    str.setOffsetIndex(Utf8OffsetIndex::create(buf, str.utf8Str(), str.size()));
 }
 
 bool VMRuntime::onRunTasks() {
-    bool hasTasks = _promiseTasks.run();
+    _promiseTasks.run();
+
+    bool hasTasks = _timerTasks.run(_promiseTasks);
+
+    // timer 的回调中可能 settle 了 promise, 需要再次执行
+    return hasTasks || !_promiseTasks.empty();
+}
+
+bool VMRuntime::runOnce(int32_t timeout) {
+    _promiseTasks.run();
 
-    if (_timerTasks.run()) {
-        hasTasks = true;
+    if (_promiseTasks.empty()) {
+        auto wait = _timerTasks.nextTimeout();
+        if (timeout >= 0 && (wait < 0 || timeout < wait)) {
+            wait = timeout;
+        }
+
+        if (wait > 0) {
+            _timerTasks.wait(wait);
+        }
     }
 
-    return hasTasks;
+    return onRunTasks();
 }
@@ -11,11 +11,37 @@
 #include "VMRuntimeCommon.hpp"
 #include "TimerTasks.hpp"
 #include "PromiseTasks.hpp"
+#include "objects/JsShape.hpp"
 
 
+// 为 1 时使用分代 GC: 新分配的值都在新生代中，minor GC 只需要扫描根、remembered set 和新生代.
+#ifndef VM_GENERATIONAL_GC
+#define VM_GENERATIONAL_GC      1
+#endif
+
+
+class JsWeakMap;
+class VMSnapshot;
+
 using VecVMScopes = std::vector<VMScope *>;
+using VecJsWeakMaps = std::vector<JsWeakMap *>;
 using MapIndexToJsObjs = std::unordered_map<int, IJsObject *>;
 
+/**
+ * GC 的统计信息，时间的单位为微秒
+ */
+struct GcStats {
+    uint32_t                    countMinor = 0;
+    uint32_t                    countMajor = 0;
+    uint64_t                    minorPauseTotal = 0;
+    uint64_t                    majorPauseTotal = 0;
+    uint32_t                    minorPauseMax = 0;
+    uint32_t                    majorPauseMax = 0;
+    uint64_t                    countPromoted = 0; // 从新生代晋升到老年代的值的数量
+
+    void clear() { *this = GcStats(); }
+};
+
 class IConsole {
 public:
     virtual ~IConsole() { }
@@ -39,7 +65,8 @@ public:
     VMRuntime();
     virtual ~VMRuntime();
 
-    void init(JsVirtualMachine *vm);
+    // snapshot 不为空时，从 snapshot 中复制所有的值、代码和全局变量，见 VMSnapshot
+    void init(JsVirtualMachine *vm, const VMSnapshot *snapshot = nullptr);
 
     //
     // 任务相关的函数
@@ -48,14 +75,26 @@ public:
     inline int registerTimer(VMContext *ctx, JsValue callback, int32_t duration, bool repeat)
         { return _timerTasks.registerTimer(ctx, callback, duration, repeat); }
     inline void unregisterTimer(int timerId) { _timerTasks.unregisterTimer(timerId); }
+
+    // 执行 microtask 和已经到期的 timer，返回是否还有未执行的任务
     bool onRunTasks();
 
+    // 最多等待 timeout 毫秒 (小于 0 表示等到下一个 timer 到期), 然后执行到期的任务.
+    // 等待期间其他线程可以调用 wakeUp() 唤醒. 返回是否还有未执行的任务
+    bool runOnce(int32_t timeout = -1);
+
+    // 一直执行，直到没有 microtask 和 timer
+    void runUntilIdle() { while (runOnce()) { } }
+
+    // 线程安全
+    void wakeUp() { _timerTasks.wakeUp(); }
+
     void setConsole(IConsole *console) { if (this->_console) { delete this->_console; } this->_console = console; }
 
     void dump(BinaryOutputStream &stream);
 
     JsValue pushObject(IJsObject *value);
-    JsValue pushDouble(double value);
+    JsValue pushDouble(double value) { return makeJsValueInlineDouble(value); }
     JsValue pushSymbol(const JsSymbol &value);
     JsValue pushGetterSetter(const JsValue &getter, const JsValue &setter)
         { return pushGetterSetter(JsGetterSetter(getter, setter)); }
@@ -79,7 +118,9 @@ public:
 
     double getDouble(const JsValue &val) {
         assert(val.type == JDT_NUMBER);
-        if (val.isInResourcePool) {
+        if (val.isInlineDouble) {
+            return val.number;
+        } else if (val.isInResourcePool) {
             uint16_t poolIndex = getPoolIndexOfResource(val.value.index);
             uint16_t strIndex = getIndexOfResource(val.value.index);
 
@@ -107,7 +148,7 @@ public:
         auto &str = rp->strings[strIndex];
 
         if (needRandAccess && !str.canRandomAccess()) {
-            rp->convertUtf8ToUtf16(str);
+            rp->buildOffsetIndex(str);
         }
 
         return str;
@@ -124,7 +165,7 @@ public:
             }
 
             if (needRandAccess && !js.value.str.canRandomAccess()) {
-                convertUtf8ToUtf16(js.value.str);
+                buildOffsetIndex(js.value.str);
             }
             return js.value.str;
         }
@@ -133,11 +174,8 @@ public:
     inline const StringView &getUtf8String(const JsValue &val) { return getString(val).utf8Str(); }
     inline const StringViewUtf16 &getStringWithRandAccess(const JsValue &val) { return getString(val, true); }
 
-    IJsObject *getObject(const JsValue &val) {
-        assert(val.type >= JDT_OBJECT);
-        assert(!val.isInResourcePool);
-        return _objValues[val.value.index];
-    }
+    // 在 IJsObject.hpp 中实现
+    inline IJsObject *getObject(const JsValue &val);
 
     JsGetterSetter &getGetterSetter(const JsValue &val) {
         assert(val.type == JDT_GETTER_SETTER);
@@ -158,6 +196,28 @@ public:
         return pool->strings[index].utf8Str();
     }
 
+    // 属性名的 atom 表和 JsShape 的 transition 树
+    JsShapeTree *shapeTree() { return _shapeTree.get(); }
+
+    // 返回 bytecode 中属性名对应的 atom, 在第一次使用时才解析
+    JsAtom getAtomByIdx(uint32_t index, ResourcePool *pool) {
+        if (index < _countCommonStrings) {
+            // common 字符串的 atom 就是其索引
+            return index;
+        }
+
+        index -= _countCommonStrings;
+        if (index >= pool->atoms.size()) {
+            pool->atoms.resize(pool->strings.size(), JS_ATOM_NONE);
+        }
+
+        auto &atom = pool->atoms[index];
+        if (atom == JS_ATOM_NONE) {
+            atom = _shapeTree->atoms()->intern(pool->strings[index].utf8Str());
+        }
+        return atom;
+    }
+
     const SwitchJump &getSwitchJumpInResourcePool(uint32_t index, const ResourcePool *pool) {
         return pool->switchCaseJumps[index];
     }
@@ -188,7 +248,9 @@ public:
 
     inline StringView allocString(uint32_t size) { return StringView(new uint8_t[size], size); }
     inline void freeString(const StringView &s) { assert(s.data); delete [] s.data; }
-    inline void freeUtf16String(const StringViewUtf16 &s) { assert(s.isUtf16Valid()); delete [] s.utf16Data(); }
+    JsStringBuffer *allocStringBuffer(uint32_t capacity);
+    void releaseStringBuffer(JsStringBuffer *buffer);
+    inline void freeOffsetIndex(const StringViewUtf16 &s) { assert(s.offsetIndex()); delete [] (uint8_t *)s.offsetIndex(); }
 
     double toNumber(VMContext *ctx, const JsValue &v);
     bool toNumber(VMContext *ctx, const JsValue &v, double &out);
@@ -230,20 +292,107 @@ public:
 
     uint32_t countAllocated() const ;
 
+    // 完整的 (major) GC: 标记和清除所有的值
     uint32_t garbageCollect();
+
+    // minor GC: 只回收新生代中的值，存活的值晋升到老年代
+    uint32_t garbageCollectMinor();
+
+    // 新分配的值达到阈值时调用: 老年代增长得较多时执行 major GC，否则执行 minor GC
+    uint32_t garbageCollectAuto();
+
     bool shouldGarbageCollect() { return _newAllocatedCount >= _gcAllocatedCountThreshold; }
-    void setGarbageCollectThreshold(uint32_t count) { _gcAllocatedCountThreshold = count; }
+
+    // count 为新生代的大小，同时也是 major GC 之间老年代至少允许增长的数量
+    void setGarbageCollectThreshold(uint32_t count) { _gcAllocatedCountThreshold = _gcAllocatedCountThresholdMin = count; }
+
+    const GcStats &gcStats() const { return _gcStats; }
+    void clearGcStats() { _gcStats.clear(); }
+
+    // 累计的 GC 次数 (包括 minor 和 major)，不会被 clearGcStats 清除. 用于判断两次调用之间是否发生过 GC
+    uint32_t countGarbageCollect() const { return _countGarbageCollect; }
+
+    // JsonWriter 输出使用的 buffer, 在多次 JSON.stringify 之间复用. JsonWriter 创建时取走，结束时再放回
+    void swapJsonBuffer(string &buf) { _jsonBuffer.swap(buf); }
+
+    /**
+     * remembered set 中为可能引用了新生代值的老年代对象和 scope，minor GC 时作为 root 扫描.
+     *
+     * - 对象在写入值的地方调用 writeBarrier() 加入 (比如 setByName 等接口的实现，修改内部存储的 native function);
+     * - scope 在进入函数时加入，以及 GC 后仍在调用栈中的 scope.
+     */
+    void rememberObject(IJsObject *obj);
+    inline void writeBarrier(IJsObject *obj); // 在 IJsObject.hpp 中实现
+    inline void rememberScope(VMScope *scope); // 在 VMScope.hpp 中实现
+
+    /**
+     * 调试用: 每次 minor GC 前检查不在 remembered set 中的老年代对象，
+     * 引用了新生代的值说明写入时遗漏了 writeBarrier()
+     */
+    void setVerifyWriteBarrier(bool isVerify) { _isVerifyWriteBarrier = isVerify; }
+    uint32_t countMissedWriteBarriers() const { return _countMissedWriteBarriers; }
+
+    /**
+     * JsVirtualMachine::call() 的嵌套层数. 大于 1 时外层的 C++ 代码 (比如 native function) 可能在
+     * 调用 JavaScript 函数的前后持有对象的指针，这时 GC 不能清空 remembered set.
+     */
+    inline void enterVMCall() { _vmCallDepth++; }
+    inline void leaveVMCall() { assert(_vmCallDepth > 0); _vmCallDepth--; }
+
+    /**
+     * 在 GC 的安全点之间新分配的值可能只保存在 C++ 的局部变量中 (比如 native function 或者
+     * 运算过程中调用了 JavaScript 函数)，需要将其临时作为 GC 的 root.
+     * 函数返回时，只保留返回值.
+     */
+    inline uint32_t enterFunctionCall() { return (uint32_t)_tempValues.size(); }
+
+    inline void leaveFunctionCall(uint32_t countTempValues, const JsValue &retValue) {
+        _tempValues.resize(countTempValues);
+        addTempValue(retValue);
+    }
+
+    // 返回值已经保存在了 stack 中，不需要再作为临时值
+    inline void leaveFunctionCall(uint32_t countTempValues) {
+        _tempValues.resize(countTempValues);
+    }
+
+    inline void addTempValue(const JsValue &value) {
+        if (value.type >= JDT_NUMBER && !value.isInlineDouble) {
+            _tempValues.push_back(value);
+        }
+    }
+
+    /**
+     * 函数中的安全点: 执行到此处时，当前函数中分配的值都已经保存在了 stack 或者变量中.
+     */
+    inline void garbageCollectAtSafePoint(uint32_t countTempValues) {
+        if (shouldGarbageCollect()) {
+            _tempValues.resize(countTempValues);
+            garbageCollectAuto();
+        }
+    }
 
     inline uint8_t nextReferIdx() const { return _nextRefIdx; }
 
     void markReferIdx(const JsValue &val);
     void markReferIdx(VMScope *scope);
+    void markReferIdx(VMContext *ctx);
 
+    // 为避免对象嵌套层次太深导致堆栈溢出，先放到 _toMarkObjs 中，再统一标记
+    void markReferIdx(IJsObject *obj);
+
+    // ResourcePool 和 Symbol 只在 major GC 中回收，minor GC 时不需要标记
     inline void markReferIdx(ResourcePool *pool) {
-        pool->referIdx = _nextRefIdx;
+        if (!_isMinorGc) {
+            pool->referIdx = _nextRefIdx;
+        }
     }
 
     inline void markResourcePoolReferIdx(uint32_t index) {
+        if (_isMinorGc) {
+            return;
+        }
+
         uint16_t poolIndex = getPoolIndexOfResource(index);
         assert(poolIndex < _resourcePools.size());
         auto rp = _resourcePools[poolIndex];
@@ -252,14 +401,61 @@ public:
 
     inline void markSymbolUsed(uint32_t index) {
         assert(index < _symbolValues.size());
-        _symbolValues[index].referIdx = _nextRefIdx;
+        if (!_isMinorGc) {
+            _symbolValues[index].referIdx = _nextRefIdx;
+        }
     }
 
     void markJoinedStringReferIdx(const JsJoinedString &joinedString);
 
-    void convertUtf8ToUtf16(StringViewUtf16 &str);
+    // WeakMap/WeakSet 不直接标记其 entry, 在其他可达的值都标记完成后再处理 (见 markWeakMaps)
+    inline void markWeakMapLater(JsWeakMap *weakMap) {
+        if (!_isVerifyingOldObj) {
+            _markedWeakMaps.push_back(weakMap);
+        }
+    }
+
+    // 对象在当前的 GC 中是否存活. minor GC 中老年代的对象都视为存活
+    bool isObjectMarked(const JsValue &val);
+
+    void buildOffsetIndex(StringViewUtf16 &str);
+
+protected:
+    /**
+     * 参与拼接的字符串
+     */
+    struct StringOperand {
+        JsValue                 val; // 为 JDT_UNDEFINED 时表示还未添加到 _stringValues 中
+        StringView              str; // utf-8 字符串，JoinedString 时无效
+        uint32_t                len; // utf-8 的长度
+        uint32_t                lenUtf16;
+        uint16_t                depth; // JoinedString 的深度
+        uint8_t                 buf[8]; // JDT_CHAR 的 utf-8 编码
+    };
+
+    void initStringOperand(const JsValue &s, StringOperand &op);
+    void initStringOperand(const StringView &str, StringOperand &op);
+    void pushStringOperand(StringOperand &op);
+    JsValue plusString(StringOperand &op1, StringOperand &op2);
+    JsValue appendToStringBuffer(StringOperand &op1, StringOperand &op2);
+    void copyJoinedString(const JsJoinedString &joinedString, uint8_t *p);
+
+    void markRoots();
+    void markScopeReferIdx(VMScope *scope);
+    void markAllObjects();
+    void markWeakMaps();
+    void promoteYoungValues(bool isMinorGc, bool isKeepRemembered, uint32_t &countFreedOut);
+    void clearRememberedSet(bool isMinorGc, bool isKeepRemembered);
+    void rememberActiveScopes();
+    void verifyWriteBarrier();
+    bool isYoungValue(const JsValue &val);
+    void freeStringValue(uint32_t index);
+    IJsObject *newFreeObjectSlot();
+    void updateGcStats(bool isMinorGc, uint64_t startTime);
 
 protected:
+    friend class VMSnapshot;
+
     VMRuntimeCommon             *_rtCommon;
 
 protected:
@@ -281,11 +477,13 @@ protected:
     VecJsGetterSetters          _getterSetters;
     VecJsStrings                _stringValues;
     VecJsObjects                _objValues;
+
+    JsShapeTreePtr              _shapeTree;
+
     VecVMScopes                 _vmScopes;
     VecJsNativeFunction         _nativeFunctions;
     VecResourcePools            _resourcePools;
 
-    uint32_t                    _firstFreeDoubleIdx;
     uint32_t                    _firstFreeSymbolIdx;
     uint32_t                    _firstFreeGetterSetterIdx;
     uint32_t                    _firstFreeStringIdx;
@@ -309,6 +507,49 @@ protected:
     uint8_t                     _nextRefIdx;
     uint32_t                    _newAllocatedCount;
     uint32_t                    _gcAllocatedCountThreshold;
+    uint32_t                    _gcAllocatedCountThresholdMin;
+
+    // 待标记其引用的对象
+    VecJsObjects                _toMarkObjs;
+
+    VecJsValues                 _tempValues;
+
+    //
+    // 分代 GC
+    //
+    bool                        _isMinorGc;
+    uint32_t                    _vmCallDepth;
+
+    // 新生代: 上次 GC 之后分配的值的索引，按分配的顺序追加
+    VecInts                     _youngStrings;
+    VecInts                     _youngObjs;
+    VecInts                     _youngScopes;
+
+    VecJsObjects                _rememberedObjs;
+    VecVMScopes                 _rememberedScopes;
+
+    // minor GC 中标记过的老年代 scope，结束后需要恢复其 referIdx
+    VecVMScopes                 _markedOldScopes;
+
+    // verifyWriteBarrier() 检查老年代对象时为 true，此时 markReferIdx 只检查值是否在新生代
+    bool                        _isVerifyWriteBarrier;
+    bool                        _isVerifyingOldObj;
+    uint32_t                    _countMissedWriteBarriers;
+
+    // 当前 GC 中标记到的 WeakMap/WeakSet
+    VecJsWeakMaps               _markedWeakMaps;
+
+    // 空闲的 _objValues 位置上放置的是 JsDummyObject，回收后在这里复用
+    VecJsObjects                _freeDummyObjs;
+
+    // 上次 major GC 之后存活的值的数量，以及之后晋升到老年代的值的数量
+    uint32_t                    _countLiveAfterMajorGc;
+    uint32_t                    _countPromotedSinceMajorGc;
+
+    GcStats                     _gcStats;
+    uint32_t                    _countGarbageCollect;
+
+    string                      _jsonBuffer;
 
 };
 
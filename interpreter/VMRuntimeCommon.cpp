@@ -12,6 +12,7 @@
 
 
 VMRuntimeCommon::VMRuntimeCommon() {
+    _isFrozen = false;
     objPrototypeString = nullptr;
     objPrototypeNumber = nullptr;
     objPrototypeBoolean = nullptr;
@@ -73,6 +74,15 @@ VMRuntimeCommon::VMRuntimeCommon() {
 
     registerBuiltIns(this);
     registerWebAPIs(this);
+
+    // 按照索引的顺序添加，common 字符串的 atom 就是其索引
+    for (uint32_t i = 1; i < _stringValues.size(); i++) {
+        _atoms.intern(_stringValues[i].value.str.utf8Str());
+    }
+    assert(_atoms.count() == _stringValues.size() - 1);
+    _atoms.freeze();
+
+    _isFrozen = true;
 }
 
 VMRuntimeCommon::~VMRuntimeCommon() {
@@ -83,13 +93,9 @@ VMRuntimeCommon::~VMRuntimeCommon() {
     delete _globalScope;
 }
 
-static VMRuntimeCommon *_instance = nullptr;
-
 VMRuntimeCommon *VMRuntimeCommon::getInstance() {
-    // static VMRuntimeCommon *_instance = new VMRuntimeCommon();
-    if (_instance == nullptr) {
-        _instance = new VMRuntimeCommon();
-    }
+    // 局部静态变量的初始化是线程安全的，多个线程同时创建 JsVirtualMachine 时也只会初始化一次
+    static VMRuntimeCommon *_instance = new VMRuntimeCommon();
     return _instance;
 }
 
@@ -121,6 +127,7 @@ void VMRuntimeCommon::dump(BinaryOutputStream &stream) {
 }
 
 void VMRuntimeCommon::setGlobalValue(const char *strName, const JsValue &value) {
+    assert(!_isFrozen);
     _globalScope->set(makeStableStr(strName), value);
 }
 
@@ -129,6 +136,7 @@ void VMRuntimeCommon::setGlobalObject(const char *strName, IJsObject *obj) {
 }
 
 JsValue VMRuntimeCommon::pushObject(IJsObject *value) {
+    assert(!_isFrozen);
     auto jsv = JsValue(value->type, (uint32_t)_objValues.size());
     value->self = jsv;
     _objValues.push_back(value);
@@ -136,6 +144,7 @@ JsValue VMRuntimeCommon::pushObject(IJsObject *value) {
 }
 
 JsValue VMRuntimeCommon::pushDouble(double value) {
+    assert(!_isFrozen);
     auto it = _mapDoubles.find(value);
     if (it == _mapDoubles.end()) {
         uint32_t index = (uint32_t)_doubleValues.size();
@@ -148,6 +157,7 @@ JsValue VMRuntimeCommon::pushDouble(double value) {
 }
 
 JsValue VMRuntimeCommon::pushStringValue(const StringView &value) {
+    assert(!_isFrozen);
     assert(value.isStable());
 
     auto it = _mapStrings.find(value);
@@ -163,7 +173,7 @@ JsValue VMRuntimeCommon::pushStringValue(const StringView &value) {
     }
 }
 
-uint32_t VMRuntimeCommon::findDoubleValue(double value) {
+uint32_t VMRuntimeCommon::findDoubleValue(double value) const {
     auto it = _mapDoubles.find(value);
     if (it == _mapDoubles.end()) {
         return -1;
@@ -172,7 +182,7 @@ uint32_t VMRuntimeCommon::findDoubleValue(double value) {
     }
 }
 
-uint32_t VMRuntimeCommon::findStringValue(const StringView &value) {
+uint32_t VMRuntimeCommon::findStringValue(const StringView &value) const {
     auto it = _mapStrings.find(value);
     if (it == _mapStrings.end()) {
         return -1;
@@ -180,3 +190,23 @@ uint32_t VMRuntimeCommon::findStringValue(const StringView &value) {
         return (*it).second;
     }
 }
+
+uint64_t VMRuntimeCommon::commonValuesFingerprint() const {
+    uint64_t hash = _stringValues.size() * 31 + _doubleValues.size();
+    for (size_t i = 1; i < _stringValues.size(); i++) {
+        // 0 为占位的非法位置
+        auto &item = _stringValues[i];
+        if (item.isJoinedString) {
+            continue;
+        }
+
+        auto &str = item.value.str.utf8Str();
+        hash = hashBytes(str.data, str.len, hash);
+    }
+
+    for (auto &item : _doubleValues) {
+        hash = hashBytes(&item.value, sizeof(item.value), hash);
+    }
+
+    return hash;
+}
@@ -13,6 +13,7 @@
 #include "parser/ParserTypes.hpp"
 #include "strings/CommonString.hpp"
 #include "generated/ConstStrings.hpp"
+#include "objects/JsAtomTable.hpp"
 
 
 class VMScope;
@@ -34,6 +35,8 @@ using VecJsNativeFunction = std::vector<JsNativeFunctionInfo>;
 
 /**
  * 在系统初始化阶段用来存储缺省使用的字符串、double、functions 等资源，这些资源不参与后期的资源释放统计
+ *
+ * 初始化完成后不再被修改，每个 VMRuntime 会复制一份需要修改的部分，所以不同线程中的 VMRuntime 可以同时使用它.
  */
 class VMRuntimeCommon {
 private:
@@ -53,6 +56,7 @@ public:
 
     void setPrototypeObject(const JsValue &jsVal, IJsObject *obj) {
         assert(jsVal.type == JDT_LIB_OBJECT);
+        assert(!_isFrozen);
         auto index = jsVal.value.index;
         assert(_objValues[index] == nullptr);
         _objValues[index] = obj;
@@ -60,6 +64,7 @@ public:
 
     JsValue pushObject(IJsObject *value);
     JsValue pushNativeFunction(JsNativeFunction f, const StringView &name) {
+        assert(!_isFrozen);
         uint32_t n = (uint32_t)_nativeFunctions.size();
         _nativeFunctions.push_back(JsNativeFunctionInfo(f, name));
         return JsValue(JDT_NATIVE_FUNCTION, n);
@@ -68,12 +73,15 @@ public:
     JsValue pushDouble(double value);
     JsValue pushStringValue(const StringView &value);
 
-    uint32_t findDoubleValue(double value);
-    uint32_t findStringValue(const StringView &value);
+    uint32_t findDoubleValue(double value) const;
+    uint32_t findStringValue(const StringView &value) const;
 
     uint32_t countStringValues() const { return (uint32_t)_stringValues.size(); }
     uint32_t countDoubleValues() const { return (uint32_t)_doubleValues.size(); }
 
+    // 所有 common 字符串和 double 的 hash，bytecode 中直接引用了它们的索引
+    uint64_t commonValuesFingerprint() const;
+
 public:
     IJsObject                   *objPrototypeString;
     IJsObject                   *objPrototypeNumber;
@@ -103,6 +111,12 @@ protected:
 
     VMGlobalScope               *_globalScope;
 
+    // common 字符串的 atom 表，atom 就是字符串在 _stringValues 中的索引. 是所有 VMRuntime 的 atom 表的 parent
+    JsAtomTable                 _atoms;
+
+    // 初始化完成后为 true, 不能再添加资源
+    bool                        _isFrozen;
+
 };
 
 #endif /* VMRuntimeCommon_hpp */
@@ -14,6 +14,7 @@
 
 VMScope::VMScope(Scope *scopeDsc) : scopeDsc(scopeDsc) {
     referIdx = 0;
+    gcGeneration = GEN_YOUNG;
     nextFreeIdx = 0;
 
     if (scopeDsc) {
@@ -40,13 +41,20 @@ VMGlobalScope::VMGlobalScope(VMGlobalScope *other) : VMScope(nullptr) {
     _rootFunc = PoolNew(_resourcePool.pool, Function)(&_resourcePool, nullptr, 0);
     scopeDsc = _rootFunc->scope;
 
-    // 将全局变量都复制过来.
+    // 将全局变量都复制过来，保持其 storageIndex 不变 (VMSnapshot 中的 bytecode 按照索引引用全局变量).
     for (auto &item : other->scopeDsc->varDeclares) {
-        set(item.first, other->vars[item.second->storageIndex]);
+        auto id = PoolNew(_resourcePool.pool, IdentifierDeclare)(*item.second);
+        id->name = _resourcePool.pool.duplicate(id->name);
+        id->scope = scopeDsc;
+        id->isFuncName = false;
+        scopeDsc->varDeclares[id->name] = id;
     }
 
-    assert(other->scopeDsc->varDeclares.size() == scopeDsc->varDeclares.size());
-    assert(other->vars.size() == vars.size());
+    scopeDsc->countLocalVars = other->scopeDsc->countLocalVars;
+    if (other->scopeDsc->hasEval) {
+        scopeDsc->setHasEval();
+    }
+    vars = other->vars;
 }
 
 JsValue VMGlobalScope::get(VMContext *ctx, uint32_t index) const {
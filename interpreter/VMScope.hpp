@@ -25,6 +25,7 @@ public:
     void free();
 
     int8_t                      referIdx;
+    GcGeneration                gcGeneration;
     uint32_t                    nextFreeIdx;
 
     Scope                       *scopeDsc;
@@ -39,6 +40,15 @@ public:
 
 };
 
+inline void VMRuntime::rememberScope(VMScope *scope) {
+#if VM_GENERATIONAL_GC
+    if (scope->gcGeneration == GEN_OLD) {
+        scope->gcGeneration = GEN_OLD_REMEMBERED;
+        _rememberedScopes.push_back(scope);
+    }
+#endif
+}
+
 class VMGlobalScope : public VMScope {
 public:
     VMGlobalScope();
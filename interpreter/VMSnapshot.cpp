@@ -0,0 +1,382 @@
+//
+//  VMSnapshot.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/25.
+//
+
+#include <unordered_map>
+
+#include "VMSnapshot.hpp"
+#include "VirtualMachine.hpp"
+#include "ByteCodeCache.hpp"
+#include "objects/JsGlobalThis.hpp"
+#include "objects/JsObjectFunction.hpp"
+
+
+static StringViewUtf16 duplicateString(const StringView &str, uint32_t lenUtf16) {
+    auto p = new uint8_t[str.len];
+    memcpy(p, str.data, str.len);
+    return StringViewUtf16(StringView(p, str.len), lenUtf16);
+}
+
+/**
+ * 复制 scope 中的参数. 不需要释放的参数引用的是调用时栈中的值，函数返回后就不会再被访问，不需要复制
+ */
+static void copyArguments(const Arguments &src, Arguments &dst) {
+    if (src.needFree && src.capacity > 0) {
+        dst.data = new JsValue[src.capacity];
+        std::copy(src.data, src.data + src.capacity, dst.data);
+        dst.count = src.count;
+        dst.capacity = src.capacity;
+        dst.needFree = true;
+    }
+}
+
+VMSnapshot::VMSnapshot() {
+    _countCommonStrings = 0;
+    _countCommonObjs = 0;
+    _globalScope = nullptr;
+    _globalThis = nullptr;
+
+    _firstFreeSymbolIdx = 0;
+    _firstFreeGetterSetterIdx = 0;
+    _firstFreeStringIdx = 0;
+    _firstFreeObjIdx = 0;
+    _firstFreeVMScopeIdx = 0;
+    _firstFreeResourcePoolIdx = 0;
+
+    _nextRefIdx = 1;
+    _countLiveAfterMajorGc = 0;
+}
+
+VMSnapshot::~VMSnapshot() {
+    for (uint32_t i = _countCommonStrings; i < _stringValues.size(); i++) {
+        auto &str = _stringValues[i].value.str.utf8Str();
+        if (str.data) {
+            delete [] str.data;
+        }
+    }
+
+    for (auto item : _objValues) {
+        delete item;
+    }
+
+    for (auto item : _vmScopes) {
+        delete item;
+    }
+
+    delete _globalScope;
+    delete _globalThis;
+}
+
+VMSnapshot *VMSnapshot::create(VMRuntime *runtime, string &errorOut) {
+    if (!runtime->_mainCtx->stackFrames.empty() || runtime->_vmCallDepth > 0) {
+        errorOut = "Can not create snapshot while the code is running.";
+        return nullptr;
+    }
+
+    if (!runtime->_promiseTasks.empty() || !runtime->_timerTasks.empty()) {
+        errorOut = "Can not create snapshot with pending promises or timers.";
+        return nullptr;
+    }
+
+    // 只保存存活的值
+    runtime->garbageCollect();
+
+    auto snapshot = new VMSnapshot();
+    if (!snapshot->capture(runtime, errorOut)) {
+        delete snapshot;
+        return nullptr;
+    }
+
+    return snapshot;
+}
+
+bool VMSnapshot::capture(VMRuntime *rt, string &errorOut) {
+    using MapFunctionToRef = std::unordered_map<Function *, CodeRef>;
+    using MapScopeToRef = std::unordered_map<Scope *, CodeRef>;
+
+    _countCommonStrings = rt->_countCommonStrings;
+    _countCommonObjs = rt->_countCommonObjs;
+
+    //
+    // 代码: 需要在复制值之前序列化 (switch 的 case 条件在序列化时才会生成)
+    //
+    MapFunctionToRef functionRefs;
+    MapScopeToRef scopeRefs;
+    auto &pools = rt->_resourcePools;
+    _pools.resize(pools.size());
+    for (uint32_t i = 0; i < pools.size(); i++) {
+        auto rp = pools[i];
+        auto &image = _pools[i];
+        // 释放的 ResourcePool 没有 rootFunction
+        image.isFree = rp->rootFunction == nullptr;
+        image.nextFreeIdx = rp->nextFreeIdx;
+        if (image.isFree) {
+            continue;
+        }
+
+        BinaryOutputStream stream;
+        VecFunctions functions;
+        VecScopes scopes;
+        if (!serializeByteCodeCache(rt, rp->rootFunction, rp->source, stream, &functions, &scopes)) {
+            errorOut = stringPrintf("Can not save the code of ResourcePool %d.", i);
+            return false;
+        }
+
+        image.source.assign((cstr_t)rp->source.data, rp->source.len);
+        auto cache = stream.toStringView();
+        image.cache.assign((cstr_t)cache.data, cache.len);
+
+        for (uint32_t k = 0; k < functions.size(); k++) {
+            functionRefs[functions[k]] = { i, k };
+        }
+        for (uint32_t k = 0; k < scopes.size(); k++) {
+            scopeRefs[scopes[k]] = { i, k };
+        }
+    }
+
+    //
+    // 值: 保持相同的索引
+    //
+    _symbolValues = rt->_symbolValues;
+    _getterSetters = rt->_getterSetters;
+
+    auto countStrings = (uint32_t)rt->_stringValues.size();
+    _stringValues.resize(countStrings);
+    for (uint32_t i = 0; i < countStrings; i++) {
+        auto &js = rt->_stringValues[i];
+        auto &copy = _stringValues[i];
+        copy = js;
+        copy.referIdx = 0;
+        copy.isInStringBuffer = false;
+        if (i < rt->_countCommonStrings) {
+            // common 字符串的内容是 stable 的，只去掉 runtime 自己分配的 offsetIndex
+            copy.value.str = StringViewUtf16(js.value.str.utf8Str(), js.value.str.size());
+        } else if (js.isJoinedString) {
+            // 拼接后保存，快照中的字符串不再引用其他字符串
+            auto &joined = js.value.joinedString;
+            auto p = new uint8_t[joined.len];
+            rt->copyJoinedString(joined, p);
+            copy.isJoinedString = false;
+            copy.value.str = StringViewUtf16(StringView(p, joined.len), joined.lenUtf16);
+        } else if (js.value.str.utf8Str().data) {
+            copy.value.str = duplicateString(js.value.str.utf8Str(), js.value.str.size());
+        } else {
+            copy.value.str = StringViewUtf16();
+        }
+    }
+
+    std::unordered_map<VMScope *, uint32_t> scopeIndices;
+    auto countScopes = (uint32_t)rt->_vmScopes.size();
+    _vmScopes.reserve(countScopes);
+    _scopeDscs.reserve(countScopes);
+    for (uint32_t i = 0; i < countScopes; i++) {
+        auto scope = rt->_vmScopes[i];
+        CodeRef ref = { IDX_NONE, IDX_NONE };
+        if (scope->scopeDsc) {
+            auto it = scopeRefs.find(scope->scopeDsc);
+            if (it == scopeRefs.end()) {
+                errorOut = stringPrintf("Can not find the scope of VMScope %d.", i);
+                return false;
+            }
+            ref = (*it).second;
+        }
+
+        auto copy = new VMScope(nullptr);
+        copy->nextFreeIdx = scope->nextFreeIdx;
+        copy->vars = scope->vars;
+        copyArguments(scope->args, copy->args);
+        copy->withValue = scope->withValue;
+
+        _vmScopes.push_back(copy);
+        _scopeDscs.push_back(ref);
+        scopeIndices[scope] = i;
+    }
+
+    _globalScope = new VMGlobalScope(rt->_globalScope);
+
+    auto countObjs = (uint32_t)rt->_objValues.size();
+    std::vector<bool> isFreeObjs(countObjs, false);
+    for (auto i = rt->_firstFreeObjIdx; i != 0; i = rt->_objValues[i]->nextFreeIdx) {
+        isFreeObjs[i] = true;
+    }
+
+    _objValues.resize(countObjs, nullptr);
+    _objNextFreeIdx.resize(countObjs, 0);
+    for (uint32_t i = 0; i < countObjs; i++) {
+        auto obj = rt->_objValues[i];
+        if (isFreeObjs[i]) {
+            _objNextFreeIdx[i] = obj->nextFreeIdx;
+            continue;
+        }
+
+        if (i == JS_OBJ_GLOBAL_THIS_IDX) {
+            _globalThis = ((JsGlobalThis *)obj)->clone(_globalScope);
+            _globalThis->self = obj->self;
+            continue;
+        }
+
+        switch (obj->type) {
+            case JDT_PROMISE:
+            case JDT_GENERATOR:
+            case JDT_ARGUMENTS:
+            case JDT_OBJ_X:
+            case JDT_ITERATOR:
+                errorOut = stringPrintf("Can not save object of type: %s.", jsDataTypeToString(obj->type));
+                return false;
+            default:
+                break;
+        }
+
+        auto copy = obj->clone();
+        copy->self = obj->self;
+        _objValues[i] = copy;
+
+        if (obj->type == JDT_FUNCTION) {
+            // Function 和 VMScope 在创建 runtime 时再重新定位
+            auto func = (JsObjectFunction *)obj;
+            auto it = functionRefs.find(func->function);
+            if (it == functionRefs.end()) {
+                errorOut = stringPrintf("Can not find the code of function object %d.", i);
+                return false;
+            }
+
+            FunctionFixup fixup;
+            fixup.objIndex = i;
+            fixup.function = (*it).second;
+            for (auto scope : func->stackScopes) {
+                if (scope == rt->_globalScope) {
+                    fixup.stackScopes.push_back(IDX_GLOBAL_SCOPE);
+                } else {
+                    assert(scopeIndices.find(scope) != scopeIndices.end());
+                    fixup.stackScopes.push_back(scopeIndices[scope]);
+                }
+            }
+            _functionFixups.push_back(fixup);
+
+            auto funcCopy = (JsObjectFunction *)copy;
+            funcCopy->function = nullptr;
+            funcCopy->stackScopes.clear();
+        }
+    }
+
+    _firstFreeSymbolIdx = rt->_firstFreeSymbolIdx;
+    _firstFreeGetterSetterIdx = rt->_firstFreeGetterSetterIdx;
+    _firstFreeStringIdx = rt->_firstFreeStringIdx;
+    _firstFreeObjIdx = rt->_firstFreeObjIdx;
+    _firstFreeVMScopeIdx = rt->_firstFreeVMScopeIdx;
+    _firstFreeResourcePoolIdx = rt->_firstFreeResourcePoolIdx;
+
+    _nextRefIdx = rt->_nextRefIdx;
+    _countLiveAfterMajorGc = rt->_countLiveAfterMajorGc;
+
+    // 复制的对象引用了 runtime 当前的 shape 树: 冻结后由快照共享，runtime 在新的树中继续添加属性
+    _shapeTree = rt->_shapeTree;
+    _shapeTree->freeze();
+    rt->_shapeTree = std::make_shared<JsShapeTree>(_shapeTree);
+
+    return true;
+}
+
+void VMSnapshot::copyTo(VMRuntime *rt) const {
+    assert(rt->_countCommonStrings == _countCommonStrings && rt->_countCommonObjs == _countCommonObjs);
+
+    rt->_shapeTree = std::make_shared<JsShapeTree>(_shapeTree);
+
+    rt->_symbolValues = _symbolValues;
+    rt->_getterSetters = _getterSetters;
+    rt->_stringValues = _stringValues;
+    for (uint32_t i = rt->_countCommonStrings; i < _stringValues.size(); i++) {
+        auto &str = rt->_stringValues[i].value.str;
+        if (str.utf8Str().data) {
+            str = duplicateString(str.utf8Str(), str.size());
+        }
+    }
+
+    rt->_globalScope = new VMGlobalScope(_globalScope);
+    rt->_globalScope->gcGeneration = GEN_OLD_REMEMBERED;
+
+    // 代码加载到相同索引的 ResourcePool 中，bytecode 和 JsValue 中引用的 ResourcePool 的索引保持不变
+    std::vector<VecFunctions> functions(_pools.size());
+    std::vector<VecScopes> scopes(_pools.size());
+    rt->_resourcePools.reserve(_pools.size());
+    for (uint32_t i = 0; i < _pools.size(); i++) {
+        auto &image = _pools[i];
+        auto rp = new ResourcePool(i);
+        rp->nextFreeIdx = image.nextFreeIdx;
+        rt->_resourcePools.push_back(rp);
+        if (image.isFree) {
+            continue;
+        }
+
+        auto len = image.source.size();
+        auto p = (uint8_t *)rp->pool.allocate(len + 4);
+        memcpy(p, image.source.c_str(), len);
+        memset(p + len, 0, 4);
+        StringView source(p, len);
+
+        auto func = deserializeByteCodeCache(rt, rp, source, StringView(image.cache.c_str(), image.cache.size()), &functions[i], &scopes[i]);
+        assert(func);
+        rp->source = source;
+        rp->rootFunction = func;
+    }
+
+    rt->_vmScopes.reserve(_vmScopes.size());
+    for (uint32_t i = 0; i < _vmScopes.size(); i++) {
+        auto src = _vmScopes[i];
+        auto &ref = _scopeDscs[i];
+        auto scope = new VMScope(nullptr);
+        if (ref.poolIndex != IDX_NONE) {
+            scope->scopeDsc = scopes[ref.poolIndex][ref.index];
+        }
+        scope->nextFreeIdx = src->nextFreeIdx;
+        scope->gcGeneration = GEN_OLD;
+        scope->vars = src->vars;
+        copyArguments(src->args, scope->args);
+        scope->withValue = src->withValue;
+        rt->_vmScopes.push_back(scope);
+    }
+
+    auto countObjs = (uint32_t)_objValues.size();
+    rt->_objValues.resize(countObjs, nullptr);
+    for (uint32_t i = 0; i < countObjs; i++) {
+        IJsObject *obj;
+        if (i == JS_OBJ_GLOBAL_THIS_IDX) {
+            obj = _globalThis->clone(rt->_globalScope);
+            obj->self = _globalThis->self;
+        } else if (_objValues[i] == nullptr) {
+            obj = rt->newFreeObjectSlot();
+            obj->nextFreeIdx = _objNextFreeIdx[i];
+            rt->_objValues[i] = obj;
+            continue;
+        } else {
+            obj = _objValues[i]->clone();
+            obj->self = _objValues[i]->self;
+        }
+
+        // common 的对象每次 GC 时都会作为 root 扫描，不需要再加入 remembered set
+        obj->gcGeneration = i < _countCommonObjs ? GEN_OLD_REMEMBERED : GEN_OLD;
+        rt->_objValues[i] = obj;
+    }
+
+    for (auto &fixup : _functionFixups) {
+        auto func = (JsObjectFunction *)rt->_objValues[fixup.objIndex];
+        func->function = functions[fixup.function.poolIndex][fixup.function.index];
+        func->stackScopes.reserve(fixup.stackScopes.size());
+        for (auto index : fixup.stackScopes) {
+            func->stackScopes.push_back(index == IDX_GLOBAL_SCOPE ? rt->_globalScope : rt->_vmScopes[index]);
+        }
+    }
+
+    rt->_firstFreeSymbolIdx = _firstFreeSymbolIdx;
+    rt->_firstFreeGetterSetterIdx = _firstFreeGetterSetterIdx;
+    rt->_firstFreeStringIdx = _firstFreeStringIdx;
+    rt->_firstFreeObjIdx = _firstFreeObjIdx;
+    rt->_firstFreeVMScopeIdx = _firstFreeVMScopeIdx;
+    rt->_firstFreeResourcePoolIdx = _firstFreeResourcePoolIdx;
+
+    rt->_nextRefIdx = _nextRefIdx;
+    rt->_countLiveAfterMajorGc = _countLiveAfterMajorGc;
+}
@@ -0,0 +1,107 @@
+//
+//  VMSnapshot.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/25.
+//
+
+#ifndef VMSnapshot_hpp
+#define VMSnapshot_hpp
+
+#include "VMRuntime.hpp"
+
+
+class JsGlobalThis;
+
+/**
+ * VMRuntime 在执行完初始化代码 (bootstrap) 之后的快照，用于快速创建相同状态的 VMRuntime，不需要再重新解析和执行初始化代码.
+ *
+ * - 所有的值保持在相同的索引位置 (包括空闲的位置和空闲链表)，所以 JsValue 不需要重新定位;
+ * - 对象使用 clone() 复制; 字符串复制其内容;
+ * - 每个 ResourcePool 中的代码保存为 ByteCodeCache 的格式，创建时加载到相同索引的 ResourcePool 中,
+ *   JsObjectFunction 引用的 Function 和 VMScope 引用的 Scope 按照其在缓存中的顺序重新定位.
+ *
+ * 创建快照前会先执行一次完整的 GC. 调用栈不为空、还有未执行的 microtask/timer，或者存在不能复制的对象
+ * (Promise, generator, arguments 等) 时，不能创建快照.
+ *
+ * 快照创建后不会再被修改，可以在多个线程中同时用于创建 VMRuntime. 对象的 JsShape 所在的树在创建快照时被冻结,
+ * 由快照和从快照创建的 VMRuntime 共同持有，和创建快照的 VMRuntime 及线程无关.
+ */
+class VMSnapshot {
+private:
+    VMSnapshot(const VMSnapshot &);
+    VMSnapshot &operator=(const VMSnapshot &);
+
+public:
+    ~VMSnapshot();
+
+    // 失败返回 nullptr, errorOut 为错误信息
+    static VMSnapshot *create(VMRuntime *runtime, string &errorOut);
+
+    uint32_t countObjects() const { return (uint32_t)_objValues.size(); }
+
+protected:
+    friend class VMRuntime;
+
+    VMSnapshot();
+
+    bool capture(VMRuntime *runtime, string &errorOut);
+
+    // 复制到刚创建的 runtime 中，由 VMRuntime::init 调用
+    void copyTo(VMRuntime *runtime) const;
+
+    // Function 和 Scope 的位置: 所在的 ResourcePool 的索引，以及在其缓存中的顺序
+    struct CodeRef {
+        uint32_t                poolIndex;
+        uint32_t                index;
+    };
+
+    struct PoolImage {
+        bool                    isFree;
+        uint32_t                nextFreeIdx;
+        string                  source;
+        string                  cache;
+    };
+
+    struct FunctionFixup {
+        uint32_t                objIndex;
+        CodeRef                 function;
+        std::vector<uint32_t>   stackScopes; // 在 _vmScopes 中的索引，IDX_GLOBAL_SCOPE 为全局 scope
+    };
+
+    enum {
+        IDX_NONE                = 0xFFFFFFFF,
+        IDX_GLOBAL_SCOPE        = 0xFFFFFFFE,
+    };
+
+    uint32_t                    _countCommonStrings;
+    uint32_t                    _countCommonObjs;
+
+    VecJsSymbols                _symbolValues;
+    VecJsGetterSetters          _getterSetters;
+    VecJsStrings                _stringValues; // 不是 common 的字符串的内容由快照自己分配
+    VecJsObjects                _objValues; // 空闲的位置为 nullptr
+    JsShapeTreePtr              _shapeTree;
+    std::vector<uint32_t>       _objNextFreeIdx;
+
+    VecVMScopes                 _vmScopes;
+    std::vector<CodeRef>        _scopeDscs;
+    VMGlobalScope               *_globalScope;
+    JsGlobalThis                *_globalThis;
+
+    std::vector<PoolImage>      _pools;
+    std::vector<FunctionFixup>  _functionFixups;
+
+    uint32_t                    _firstFreeSymbolIdx;
+    uint32_t                    _firstFreeGetterSetterIdx;
+    uint32_t                    _firstFreeStringIdx;
+    uint32_t                    _firstFreeObjIdx;
+    uint32_t                    _firstFreeVMScopeIdx;
+    uint32_t                    _firstFreeResourcePoolIdx;
+
+    uint8_t                     _nextRefIdx;
+    uint32_t                    _countLiveAfterMajorGc;
+
+};
+
+#endif /* VMSnapshot_hpp */
@@ -14,16 +14,15 @@
 #include "objects/JsObjectFunction.hpp"
 #include "objects/JsArray.hpp"
 #include "objects/JsRegExp.hpp"
+#include "objects/JsGeneratorObject.hpp"
+#include "objects/JsPromiseObject.hpp"
 #include "BinaryOperation.hpp"
 #include "UnaryOperation.hpp"
 #include "strings/JsString.hpp"
+#include "ByteCodeCache.hpp"
+#include "utils/FileApi.h"
 
 
-uint32_t makeTryCatchPointFlags(Function *function, VMScope *scope) {
-    uint64_t n = (uint64_t)function ^ (uint64_t)scope;
-    return (n & 0xFFFFFFFF) ^ (n >> 32);
-}
-
 bool jsValueStrictLessThan(VMRuntime *runtime, const JsValue &left, const JsValue &right) {
     switch (left.type) {
         case JDT_UNDEFINED:
@@ -89,9 +88,44 @@ VMContext::VMContext(VMRuntime *runtime, JsVirtualMachine *vm) : runtime(runtime
     error = JE_OK;
 
     extraData = nullptr;
+    maxCallDepth = MAX_CALL_DEPTH;
 }
 
 VMContext::~VMContext() {
+    for (auto frame : stackFrames) {
+        delete frame;
+    }
+    for (auto frame : freeFrames) {
+        delete frame;
+    }
+}
+
+VMFunctionFrame *VMContext::pushFrame() {
+    VMFunctionFrame *frame;
+    if (freeFrames.empty()) {
+        frame = new VMFunctionFrame();
+    } else {
+        frame = freeFrames.back();
+        freeFrames.pop_back();
+    }
+
+    stackFrames.push_back(frame);
+    return frame;
+}
+
+void VMContext::popFrame() {
+    assert(!stackFrames.empty());
+    auto frame = stackFrames.back();
+
+    // 未复制的参数引用的是调用者的 stack 或者 C++ 中的临时数组，函数返回后就失效了.
+    // scope 可能还在 remembered set 中，不能再被 GC 扫描到
+    auto &args = frame->scope->args;
+    if (!args.needFree) {
+        args.free();
+    }
+
+    freeFrames.push_back(frame);
+    stackFrames.pop_back();
 }
 
 void VMContext::throwException(JsError err, cstr_t format, ...) {
@@ -132,11 +166,48 @@ void VMContext::throwExceptionFormatJsValue(JsError err, cstr_t format, const Js
 }
 
 JsVirtualMachine::JsVirtualMachine() {
+#if VM_PROFILER
+    _profiler = nullptr;
+    _isProfiling = false;
+#endif
+    _isLazyParse = true;
+
     _runtime.init(this);
 }
 
+JsVirtualMachine::JsVirtualMachine(const VMSnapshot *snapshot) {
+#if VM_PROFILER
+    _profiler = nullptr;
+    _isProfiling = false;
+#endif
+    _isLazyParse = true;
+
+    _runtime.init(this, snapshot);
+}
+
 JsVirtualMachine::~JsVirtualMachine() {
+#if VM_PROFILER
+    delete _profiler;
+#endif
+}
+
+#if VM_PROFILER
+void JsVirtualMachine::startProfiler() {
+    if (_profiler) {
+        _profiler->reset();
+    } else {
+        _profiler = new VMProfiler();
+    }
+    _isProfiling = true;
+}
+
+void JsVirtualMachine::stopProfiler() {
+    if (_isProfiling) {
+        _profiler->flush();
+        _isProfiling = false;
+    }
 }
+#endif
 
 void JsVirtualMachine::run(cstr_t code, size_t len, VMRuntime *runtime) {
     if (runtime == nullptr) {
@@ -151,6 +222,83 @@ void JsVirtualMachine::run(cstr_t code, size_t len, VMRuntime *runtime) {
     ctx->curFunctionScope = runtime->globalScope();
 
     eval(code, len, ctx, stackScopes, args);
+    finishRun(runtime, ctx);
+}
+
+bool JsVirtualMachine::runWithCache(cstr_t code, size_t len, cstr_t cacheFile, VMRuntime *runtime) {
+    if (runtime == nullptr) {
+        runtime = &_runtime;
+    }
+
+    VecVMStackScopes stackScopes;
+    Arguments args;
+    auto ctx = runtime->mainCtx();
+
+    stackScopes.push_back(runtime->globalScope());
+    ctx->curFunctionScope = runtime->globalScope();
+
+    // 和 eval 一样，源代码复制到 ResourcePool 中，Function::srcCode 会引用它
+    StringView source;
+    auto newResourcePool = [runtime, code, len, &source]() {
+        auto resPool = runtime->newResourcePool();
+        auto p = (uint8_t *)resPool->pool.allocate(len + 4);
+        memcpy(p, code, len);
+        memset(p + len, 0, 4);
+        source = StringView(p, (uint32_t)len);
+        return resPool;
+    };
+
+    auto resPool = newResourcePool();
+    Function *func = nullptr;
+
+    // 缓存的内容在加载时会被复制到 resPool 中，加载后就不再需要了
+    string cache;
+    if (readFile(cacheFile, cache) && !cache.empty()) {
+        func = deserializeByteCodeCache(runtime, resPool, source, cache);
+        cache.clear();
+
+        if (func == nullptr) {
+            // 加载失败的 ResourcePool 中可能有部分内容，不能再使用，由 GC 回收
+            resPool = newResourcePool();
+        }
+    }
+
+    bool isCached = func != nullptr;
+    if (!isCached) {
+        JSParser parser(VMRuntimeCommon::getInstance(), resPool, (cstr_t)source.data, len);
+        parser.setLazyParse(_isLazyParse);
+
+        try {
+            func = parser.parse(runtime->globalScope()->scopeDsc, false);
+        } catch (ParseException &e) {
+            ctx->throwException(e.error, e.message.c_str());
+        }
+
+        BinaryOutputStream stream;
+        if (func && serializeByteCodeCache(runtime, func, source, stream)) {
+            // 先写入临时文件再改名，其他进程不会读取到不完整的缓存
+            auto tmpFile = string(cacheFile) + ".tmp";
+            if (writeFile(tmpFile.c_str(), stream.toStringView())) {
+                moveFile(tmpFile.c_str(), cacheFile);
+            }
+        }
+    }
+
+    if (func) {
+        resPool->source = source;
+        resPool->rootFunction = func;
+
+        // 检查全局变量的空间
+        runtime->globalScope()->checkSpace();
+
+        call(func, ctx, stackScopes, jsValueGlobalThis, args);
+    }
+
+    finishRun(runtime, ctx);
+    return isCached;
+}
+
+void JsVirtualMachine::finishRun(VMRuntime *runtime, VMContext *ctx) {
     if (ctx->error) {
         auto message = runtime->toStringView(ctx, ctx->errorMessage);
         runtime->console()->error(stringPrintf("Uncaught %.*s\n", message.len, message.data).c_str());
@@ -180,6 +328,7 @@ void JsVirtualMachine::eval(cstr_t code, size_t len, VMContext *vmctx, VecVMStac
     code = p;
 
     JSParser parser(VMRuntimeCommon::getInstance(), resPool, code, len);
+    parser.setLazyParse(_isLazyParse);
 
     Function *func = nullptr;
     try {
@@ -189,6 +338,9 @@ void JsVirtualMachine::eval(cstr_t code, size_t len, VMContext *vmctx, VecVMStac
         return;
     }
 
+    resPool->source = StringView(code, len);
+    resPool->rootFunction = func;
+
     if (0) {
         BinaryOutputStream stream;
         func->dump(stream);
@@ -200,7 +352,6 @@ void JsVirtualMachine::eval(cstr_t code, size_t len, VMContext *vmctx, VecVMStac
     // 检查全局变量的空间
     runtime->globalScope()->checkSpace();
 
-    VecVMStackFrames stackFrames;
     call(func, vmctx, stackScopes, jsValueGlobalThis, args);
 }
 
@@ -209,6 +360,7 @@ void JsVirtualMachine::dump(cstr_t code, size_t len, BinaryOutputStream &stream)
     resPool.index = 0;
 
     JSParser paser(VMRuntimeCommon::getInstance(), &resPool, code, strlen(code));
+    paser.setLazyParse(_isLazyParse);
 
     Function *rootFunc = PoolNew(resPool.pool, Function)(&resPool, nullptr, 0);
     auto func = paser.parse(rootFunc->scope, false);
@@ -223,6 +375,16 @@ void JsVirtualMachine::dump(BinaryOutputStream &stream) {
     writeIndent(stream, os.stringViewStartNew(), StringView("  "));
 }
 
+/**
+ * 调用 native function, 在其返回前新分配的值都会作为 GC 的 root
+ */
+inline void callNativeFunction(VMContext *ctx, JsNativeFunction f, const JsValue &thiz, const Arguments &args) {
+    auto runtime = ctx->runtime;
+    auto countTempValues = runtime->enterFunctionCall();
+    f(ctx, thiz, args);
+    runtime->leaveFunctionCall(countTempValues, ctx->retValue);
+}
+
 void JsVirtualMachine::callMember(VMContext *ctx, const JsValue &thiz, const StringView &memberName, const Arguments &args) {
     auto member = getMemberDot(ctx, thiz, memberName);
 
@@ -235,14 +397,14 @@ void JsVirtualMachine::callMember(VMContext *ctx, const JsValue &thiz, const JsV
         case JDT_NATIVE_FUNCTION: {
             auto f = runtime->getNativeFunction(memberFunc.value.index);
             ctx->stackScopesForNativeFunctionCall = nullptr;
-            f(ctx, thiz, args);
+            callNativeFunction(ctx, f, thiz, args);
             break;
         }
         case JDT_LIB_OBJECT: {
             auto obj = (JsLibObject *)runtime->getObject(memberFunc);
             auto f = obj->getFunction();
             if (f) {
-                f(ctx, thiz, args);
+                callNativeFunction(ctx, f, thiz, args);
             } else {
                 ctx->throwException(JE_TYPE_ERROR, "value is not a function");
                 assert(0);
@@ -266,6 +428,48 @@ void JsVirtualMachine::callMember(VMContext *ctx, const JsValue &thiz, const JsV
     }
 }
 
+VMRepeatedCall::VMRepeatedCall(VMContext *ctx, const JsValue &func) : _ctx(ctx), _func(func) {
+    _function = nullptr;
+    _stackScopes = nullptr;
+    _isScopeReusable = false;
+    _scope = nullptr;
+    _countGarbageCollect = 0;
+
+    if (func.type == JDT_FUNCTION) {
+        auto f = (JsObjectFunction *)ctx->runtime->getObject(func);
+        _function = f->function;
+        _stackScopes = &f->stackScopes;
+
+        if (_function->bytecode == nullptr) {
+            // 预解析的函数需要完整地解析后才能判断
+            _function->generateByteCode();
+        }
+
+        auto scopeDsc = _function->scope;
+        _isScopeReusable = !_function->isCodeBlock && !_function->isGenerator && !_function->isAsync
+            && _function->functions.empty() && !scopeDsc->hasEval && !scopeDsc->hasWith && !scopeDsc->isArgumentsUsed;
+    }
+}
+
+void VMRepeatedCall::call(const JsValue &thiz, const Arguments &args) {
+    if (_function == nullptr) {
+        _ctx->vm->callMember(_ctx, thiz, _func, args);
+        return;
+    }
+
+    VMScope *scope = nullptr;
+    if (_isScopeReusable) {
+        auto runtime = _ctx->runtime;
+        if (_scope == nullptr || _countGarbageCollect != runtime->countGarbageCollect()) {
+            _scope = runtime->newScope(_function->scope);
+            _countGarbageCollect = runtime->countGarbageCollect();
+        }
+        scope = _scope;
+    }
+
+    _ctx->vm->call(_function, _ctx, *_stackScopes, thiz, args, scope);
+}
+
 JsValue JsVirtualMachine::getMemberDot(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &defVal) {
     auto runtime = ctx->runtime;
     switch (thiz.type) {
@@ -424,6 +628,42 @@ inline void opIncreaseIdentifier(VMContext *ctx, VMRuntime *runtime, uint8_t *&b
     ctx->stack.push_back(value);
 }
 
+// 读取融合指令中的操作数. code 为操作数对应的原指令: OP_PUSH_INT32, OP_PUSH_ID_LOCAL_SCOPE,
+// OP_PUSH_ID_PARENT_SCOPE 或 OP_PUSH_ID_LOCAL_ARGUMENT, bytecode 指向其参数
+inline JsValue readFusedOperand(uint8_t code, uint8_t *&bytecode, VecVMStackScopes &stackScopes, VMScope *functionScope) {
+    switch (code) {
+        case OP_PUSH_INT32:
+            return makeJsValueInt32(readInt32(bytecode));
+        case OP_PUSH_ID_LOCAL_SCOPE:
+            return stackScopes.back()->vars[readUInt16(bytecode)];
+        case OP_PUSH_ID_PARENT_SCOPE: {
+            auto scopeDepth = *bytecode++;
+            auto idx = readUInt16(bytecode);
+            assert(scopeDepth < stackScopes.size());
+            auto scope = stackScopes[scopeDepth];
+            assert(idx < scope->vars.size());
+            return scope->vars[idx];
+        }
+        default: {
+            assert(code == OP_PUSH_ID_LOCAL_ARGUMENT);
+            auto idx = readUInt16(bytecode);
+            assert(idx < functionScope->args.capacity);
+            return functionScope->args[idx];
+        }
+    }
+}
+
+inline bool compareInt32(uint8_t code, int32_t left, int32_t right) {
+    switch (code) {
+        case OP_LESS_THAN: return left < right;
+        case OP_LESS_EQUAL_THAN: return left <= right;
+        case OP_GREATER_THAN: return left > right;
+        default:
+            assert(code == OP_GREATER_EQUAL_THAN);
+            return left >= right;
+    }
+}
+
 JsValue searchIdentifierByName(VMContext *ctx, VecVMStackScopes &stackScopes, const StringView &name) {
     auto globalScope = ctx->runtime->globalScope();
     for (auto it = stackScopes.rbegin(); it != stackScopes.rend(); ++it) {
@@ -454,7 +694,261 @@ JsValue searchIdentifierByName(VMContext *ctx, VecVMStackScopes &stackScopes, co
     return jsValueUndefined;
 }
 
-void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes &stackScopes, const JsValue &thiz, const Arguments &args) {
+inline InlineCache *getInlineCache(InlineCache *inlineCaches, uint16_t idx) {
+    return idx == INLINE_CACHE_IDX_NONE ? nullptr : inlineCaches + idx;
+}
+
+/**
+ * 使用 inline cache 读取 JsObject 的属性，未命中返回 false
+ */
+inline bool getMemberDotByInlineCache(VMRuntime *runtime, InlineCache *ic, const JsValue &obj, JsValue &valueOut) {
+    if (obj.type != JDT_OBJECT) {
+        return false;
+    }
+
+    auto pobj = (JsObject *)runtime->getObject(obj);
+    auto shape = pobj->shape();
+
+    for (int i = 0; i < ic->count; i++) {
+        auto &entry = ic->entries[i];
+        if (entry.shape != shape) {
+            continue;
+        }
+
+        JsValue *prop;
+        if (entry.protoShape) {
+            // 属性在 prototype 上: 对象的 shape 相同说明对象自身没有此属性，还需要确认 prototype 没有变化
+            if (!pobj->__proto__.equalValue(entry.proto)) {
+                continue;
+            }
+
+            auto proto = (JsObject *)runtime->getObject(entry.proto);
+            if (proto->shape() != entry.protoShape) {
+                continue;
+            }
+            prop = &proto->slotAt(entry.slotIndex);
+        } else {
+            prop = &pobj->slotAt(entry.slotIndex);
+        }
+
+        if (prop->isGetterSetter() || prop->isEmpty()) {
+            return false;
+        }
+
+        valueOut = *prop;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * 使用 inline cache 修改 JsObject 已经存在的属性，未命中返回 false
+ */
+inline bool setMemberDotByInlineCache(VMRuntime *runtime, InlineCache *ic, const JsValue &obj, const JsValue &value) {
+    if (obj.type != JDT_OBJECT) {
+        return false;
+    }
+
+    auto pobj = (JsObject *)runtime->getObject(obj);
+    auto shape = pobj->shape();
+
+    for (int i = 0; i < ic->count; i++) {
+        auto &entry = ic->entries[i];
+        if (entry.shape == shape && entry.protoShape == nullptr) {
+            auto &prop = pobj->slotAt(entry.slotIndex);
+            if (prop.isGetterSetter() || prop.isEmpty() || !prop.isWritable()) {
+                return false;
+            }
+
+            runtime->writeBarrier(pobj);
+            prop.setValue(value);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * 在 inline cache 未命中后，记录 obj 的 shape 和属性 atom 所在的 slot, 没有记录返回 false
+ */
+bool updateInlineCache(VMRuntime *runtime, InlineCache *ic, const JsValue &obj, JsAtom atom, bool includeProtoProp) {
+    if (obj.type != JDT_OBJECT) {
+        return false;
+    }
+
+    auto pobj = (JsObject *)runtime->getObject(obj);
+
+    InlineCacheEntry entry;
+    entry.shape = pobj->shape();
+    entry.protoShape = nullptr;
+    if (entry.shape == nullptr) {
+        // 字典模式的对象不使用 inline cache
+        return false;
+    }
+
+    auto index = entry.shape->find(atom);
+    if (index == -1) {
+        // 只缓存一层 prototype 上的属性
+        if (!includeProtoProp || pobj->__proto__.type != JDT_OBJECT) {
+            return false;
+        }
+
+        auto proto = (JsObject *)runtime->getObject(pobj->__proto__);
+        entry.protoShape = proto->shape();
+        if (entry.protoShape == nullptr) {
+            return false;
+        }
+
+        index = entry.protoShape->find(atom);
+        if (index == -1) {
+            return false;
+        }
+        entry.proto = pobj->__proto__;
+    }
+    entry.slotIndex = index;
+
+    if (ic->count < InlineCache::MAX_ENTRIES) {
+        ic->entries[ic->count++] = entry;
+    } else {
+        // polymorphic 的 entries 已满，轮流替换
+        ic->entries[ic->nextReplace] = entry;
+        ic->nextReplace = (ic->nextReplace + 1) % InlineCache::MAX_ENTRIES;
+    }
+    return true;
+}
+
+/**
+ * inline cache 未命中时，先按照属性名的 atom 更新 inline cache，能通过 inline cache 读取时不需要再按照名字查找
+ */
+inline JsValue getMemberDotMissed(VMContext *ctx, InlineCache *ic, const JsValue &obj, uint32_t idx, ResourcePool *resourcePool) {
+    auto runtime = ctx->runtime;
+    JsValue value;
+    if (ic && updateInlineCache(runtime, ic, obj, runtime->getAtomByIdx(idx, resourcePool), true)
+            && getMemberDotByInlineCache(runtime, ic, obj, value)) {
+        return value;
+    }
+
+    return ctx->vm->getMemberDot(ctx, obj, runtime->getStringByIdx(idx, resourcePool));
+}
+
+/**
+ * 按照 index 读取 packed 数组的元素，不需要虚函数调用，未命中返回 false
+ */
+inline bool getArrayMemberIndexPacked(VMRuntime *runtime, const JsValue &obj, const JsValue &index, JsValue &valueOut) {
+    if (obj.type != JDT_ARRAY || index.type != JDT_INT32) {
+        return false;
+    }
+
+    auto arr = (JsArray *)runtime->getObject(obj);
+    return arr->getPackedByIndex((uint32_t)index.value.n32, valueOut);
+}
+
+/**
+ * 按照 index 修改或者添加 packed 数组的元素，未命中返回 false
+ */
+inline bool setArrayMemberIndexPacked(VMRuntime *runtime, const JsValue &obj, const JsValue &index, const JsValue &value) {
+    if (obj.type != JDT_ARRAY || index.type != JDT_INT32) {
+        return false;
+    }
+
+    auto arr = (JsArray *)runtime->getObject(obj);
+    if (arr->elementsKind() == AEK_PACKED_GENERIC) {
+        // 只有 generic 类型的元素会引用 GC 管理的值
+        runtime->writeBarrier(arr);
+    }
+    return arr->setPackedByIndex((uint32_t)index.value.n32, value);
+}
+
+/**
+ * 函数返回时，去掉当前函数中剩余的 try 处理点 (比如使用 break 跳出了 try)，避免被之后相同层次的函数误用
+ */
+inline void popTryCatchPoints(VMContext *ctx) {
+    auto &stackTryCatch = ctx->stackTryCatch;
+    auto frameDepth = ctx->stackFrames.size();
+    while (!stackTryCatch.empty() && stackTryCatch.top().frameDepth >= frameDepth) {
+        stackTryCatch.pop();
+    }
+}
+
+/**
+ * 在异常发生后，查找当前函数中的 catch/finally 的位置，当前函数没有接收异常处理返回 nullptr
+ */
+uint8_t *catchException(VMContext *ctx, VMFunctionFrame *frame) {
+    auto function = frame->function;
+    auto &stackTryCatch = ctx->stackTryCatch;
+    assert(ctx->stackFrames.back() == frame);
+    if (stackTryCatch.empty() || stackTryCatch.top().frameDepth != ctx->stackFrames.size()) {
+        return nullptr;
+    }
+
+    auto &action = stackTryCatch.top();
+    auto &stack = ctx->stack;
+    auto &stackScopes = frame->stackScopes;
+
+    // 发生异常，恢复 stackScopes 和 stack
+    stackScopes.erase(stackScopes.begin() + action.scopeDepth, stackScopes.end());
+    stack.erase(stack.begin() + action.stackSize, stack.end());
+
+    if (action.addrCatch != 0) {
+        // 清除异常标志
+        ctx->error = JE_OK;
+
+        auto addrCatch = action.addrCatch;
+        if (action.addrFinally == 0) {
+            // 没有 finally
+            stackTryCatch.pop();
+        } else {
+            // 表示 Catch 已经处理
+            action.addrCatch = 0;
+        }
+
+        // 跳转到 catch 的位置
+        return function->bytecode + addrCatch;
+    } else {
+        // 跳转到 finally 的位置
+        ctx->errorInTry = ctx->error;
+        ctx->errorMessageInTry = ctx->errorMessage;
+        ctx->error = JE_OK;
+
+        assert(action.addrFinally != 0);
+        auto addrFinally = action.addrFinally;
+        stackTryCatch.pop();
+        return function->bytecode + addrFinally;
+    }
+}
+
+/**
+ * return 时，如果在当前函数的 try 中并且有 finally，返回 finally 的位置 (设置 isReturnedForTry)，否则返回 nullptr
+ */
+inline uint8_t *finallyOfReturn(VMContext *ctx, Function *function) {
+    auto &stackTryCatch = ctx->stackTryCatch;
+    auto frameDepth = ctx->stackFrames.size();
+    while (!stackTryCatch.empty() && stackTryCatch.top().frameDepth == frameDepth) {
+        auto action = stackTryCatch.top();
+        stackTryCatch.pop();
+        if (action.addrFinally) {
+            ctx->isReturnedForTry = true;
+            return function->bytecode + action.addrFinally;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * 创建函数调用的 frame，并准备好参数和 scope. 超过最大调用层次会抛出异常，并返回 nullptr.
+ * scopes 为函数定义处的 scope 链，会被复制到 frame 中.
+ */
+VMFunctionFrame *JsVirtualMachine::enterFunction(VMContext *ctx, Function *function, VMScope * const *scopes, size_t countScopes, const JsValue &thiz, const Arguments &args, VMScope *reusedScope) {
+    auto runtime = ctx->runtime;
+    if (ctx->stackFrames.size() >= ctx->maxCallDepth || ctx->stack.size() * 2 > ctx->stack.capacity()) {
+        // stack 的空间是预留好的，不能重新分配 (Arguments 直接引用了 stack 中的值)
+        ctx->throwException(JE_MAX_STACK_EXCEEDED, "Maximum call stack size exceeded");
+        return nullptr;
+    }
+
     if (function->bytecode == nullptr) {
         function->generateByteCode();
     }
@@ -463,36 +957,48 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
     printf("    > Call function: %d, %.*s\n", function->index, (int)function->name.len, function->name.data);
 #endif
 
-    auto prevFunctionScope = ctx->curFunctionScope;
-    auto runtime = ctx->runtime;
-    auto resourcePool = function->resourcePool;
-    auto &stack = ctx->stack;
-    auto bytecode = function->bytecode, endBytecode = bytecode + function->lenByteCode;
-    auto retValue = jsValueUndefined;
+    auto frame = ctx->pushFrame();
+    frame->function = function;
+    frame->thiz = thiz;
+    frame->retValue = jsValueUndefined;
+    frame->prevFunctionScope = ctx->curFunctionScope;
+    frame->bytecode = function->bytecode;
+    frame->countTempValues = runtime->enterFunctionCall();
+    frame->posStackReturn = 0;
+    frame->isConstructorCall = false;
+    frame->generator = nullptr;
+#if VM_PROFILER
+    frame->profileNode = nullptr;
+#endif
 
-    VMScope *functionScope, *scopeLocal;
-    scopeLocal = runtime->newScope(function->scope);
-    ctx->stackFrames.push_back(std::make_shared<VMFunctionFrame>(scopeLocal, function));
+    VMScope *scopeLocal;
+    if (reusedScope) {
+        scopeLocal = reusedScope;
+        std::fill(scopeLocal->vars.begin(), scopeLocal->vars.end(), jsValueUndefined.asProperty());
+    } else {
+        scopeLocal = runtime->newScope(function->scope);
+    }
+    frame->scope = scopeLocal;
 
     if (function->isCodeBlock) {
-        assert(!stackScopes.empty());
-        functionScope = prevFunctionScope;
+        assert(countScopes > 0);
+        auto functionScope = frame->prevFunctionScope;
+        frame->functionScope = functionScope;
         if (function->scope->countLocalVars > functionScope->vars.size()) {
             functionScope->vars.resize(function->scope->countLocalVars);
         }
     } else {
-        functionScope = scopeLocal;
+        auto functionScope = scopeLocal;
+        frame->functionScope = functionScope;
         ctx->curFunctionScope = functionScope;
         auto functionScopeDsc = function->scope;
 
-        scopeLocal = functionScope;
-
         if (functionScopeDsc->countArguments > args.count) {
             // 传入的参数小于声明的参数数量，需要分配额外的空间给变量
             functionScope->args.copy(args, functionScopeDsc->countArguments);
         } else {
-            if (function->isArgumentsReferredByChild || functionScopeDsc->isArgumentsUsed) {
-                // 参数数组需要被复制
+            if (function->isArgumentsReferredByChild || functionScopeDsc->isArgumentsUsed || function->isGenerator || function->isAsync) {
+                // 参数数组需要被复制 (generator 和 async 函数在调用者返回后才执行)
                 functionScope->args.copy(args);
             } else {
                 functionScope->args = args;
@@ -500,93 +1006,338 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
         }
     }
 
+    auto &stackScopes = frame->stackScopes;
+    stackScopes.assign(scopes, scopes + countScopes);
     stackScopes.push_back(scopeLocal);
 
-    while (bytecode < endBytecode) {
+    // 函数中可能会写入定义处的 scope
+    for (size_t i = 0; i < countScopes; i++) {
+        runtime->rememberScope(scopes[i]);
+    }
+
+    // GC 的安全点: 函数入口和循环的向后跳转处
+    if (runtime->shouldGarbageCollect()) {
+        runtime->garbageCollectAuto();
+    }
+
+    return frame;
+}
+
+void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes &stackScopesCaller, const JsValue &thizCaller, const Arguments &args, VMScope *reusedScope) {
+    if (function->isGenerator || function->isAsync) {
+        callResumable(ctx, function, stackScopesCaller.data(), stackScopesCaller.size(), thizCaller, args);
+        return;
+    }
+
+    auto runtime = ctx->runtime;
+    runtime->enterVMCall();
+    auto frame = enterFunction(ctx, function, stackScopesCaller.data(), stackScopesCaller.size(), thizCaller, args, reusedScope);
+    if (frame == nullptr) {
+        ctx->retValue = jsValueUndefined;
+        runtime->leaveVMCall();
+        return;
+    }
+
+    run(ctx, frame);
+    runtime->leaveVMCall();
+}
+
+void JsVirtualMachine::callResumable(VMContext *ctx, Function *function, VMScope * const *scopes, size_t countScopes, const JsValue &thiz, const Arguments &args) {
+    auto runtime = ctx->runtime;
+    auto generator = new JsGeneratorObject(ctx, function, function->isAsync);
+    auto generatorValue = runtime->pushObject(generator);
+    runtime->addTempValue(generatorValue);
+
+    if (function->isAsync) {
+        generator->promise = new JsPromiseObject(ctx);
+        runtime->pushObject(generator->promise);
+    }
+
+    // 只创建 frame 并保存其初始状态，不执行
+    runtime->enterVMCall();
+    auto frame = enterFunction(ctx, function, scopes, countScopes, thiz, args);
+    if (frame == nullptr) {
+        ctx->retValue = jsValueUndefined;
+        runtime->leaveVMCall();
+        return;
+    }
+
+    generator->suspend(frame, (uint32_t)ctx->stack.size(), true);
+    ctx->curFunctionScope = frame->prevFunctionScope;
+    runtime->leaveFunctionCall(frame->countTempValues);
+    ctx->popFrame();
+    runtime->leaveVMCall();
+
+    if (function->isAsync) {
+        // 同步执行到第一个 await
+        resumeGenerator(ctx, generator, GRM_NEXT, jsValueUndefined);
+    } else {
+        ctx->retValue = generatorValue;
+    }
+}
+
+void JsVirtualMachine::resumeGenerator(VMContext *ctx, JsGeneratorObject *generator, GeneratorResumeMode mode, const JsValue &value) {
+    auto runtime = ctx->runtime;
+    auto &stack = ctx->stack;
+    auto state = generator->state();
+
+    if (state == JsGeneratorObject::RUNNING) {
+        ctx->throwException(JE_TYPE_ERROR, "Generator is already running");
+        return;
+    }
+
+    if (state == JsGeneratorObject::SUSPENDED_START && mode != GRM_NEXT) {
+        // 还未开始执行，直接结束
+        generator->complete();
+        state = JsGeneratorObject::COMPLETED;
+    }
+
+    if (state == JsGeneratorObject::COMPLETED) {
+        assert(!generator->isAsync());
+        ctx->retValue = mode == GRM_RETURN ? value : jsValueUndefined;
+        if (mode == GRM_THROW) {
+            ctx->throwException(JE_ERROR, value);
+        }
+        return;
+    }
+
+    if (ctx->stackFrames.size() >= ctx->maxCallDepth || stack.size() * 2 > stack.capacity()) {
+        ctx->throwException(JE_MAX_STACK_EXCEEDED, "Maximum call stack size exceeded");
+        ctx->retValue = jsValueUndefined;
+        if (generator->isAsync()) {
+            generator->complete();
+            generator->onAsyncStep();
+        }
+        return;
+    }
+
+    runtime->enterVMCall();
+    auto posStackBase = (uint32_t)stack.size();
+    auto frame = generator->resume();
+    auto function = frame->function;
+
+    if (state == JsGeneratorObject::SUSPENDED_YIELD) {
+        if (mode == GRM_NEXT) {
+            // yield/await 表达式的值
+            stack.push_back(value);
+        } else if (mode == GRM_THROW) {
+            // 在 yield/await 处抛出异常
+            ctx->throwException(JE_ERROR, value);
+            frame->bytecode = catchException(ctx, frame);
+            if (frame->bytecode == nullptr) {
+                frame->bytecode = function->bytecode + function->lenByteCode;
+            }
+        } else {
+            // 在 yield 处 return，仍然需要执行 finally
+            frame->retValue = value;
+            frame->bytecode = finallyOfReturn(ctx, function);
+            if (frame->bytecode == nullptr) {
+                frame->bytecode = function->bytecode + function->lenByteCode;
+            }
+        }
+    }
+
+    run(ctx, frame);
+    stack.resize(posStackBase);
+
+    if (generator->state() == JsGeneratorObject::RUNNING) {
+        // 执行到了函数结束或者有未处理的异常
+        generator->complete();
+    }
+
+    if (generator->isAsync()) {
+        generator->onAsyncStep();
+    }
+    runtime->leaveVMCall();
+}
+
+/**
+ * 解释执行 frame 直到其返回，返回值保存在 ctx->retValue 中.
+ * generator/async 函数的 frame 执行到 yield/await 时暂停，暂停的值也保存在 ctx->retValue 中.
+ */
+void JsVirtualMachine::run(VMContext *ctx, VMFunctionFrame *frame) {
+    auto runtime = ctx->runtime;
+    auto &stack = ctx->stack;
+    auto &stackFrames = ctx->stackFrames;
+    auto countFramesEntry = stackFrames.size() - 1;
+    assert(stackFrames.back() == frame);
+
+    // 以下为当前 frame 的状态，在调用 JavaScript 函数和返回时切换
+    Function *function;
+    ResourcePool *resourcePool;
+    uint8_t *bytecode, *endBytecode;
+    InlineCache *inlineCaches;
+    VecVMStackScopes *stackScopes;
+    VMScope *functionScope, *scopeLocal;
+    uint32_t countTempValues;
+
+#define LOAD_FUNCTION_FRAME()                                               \
+    function = frame->function;                                             \
+    resourcePool = function->resourcePool;                                  \
+    bytecode = frame->bytecode;                                             \
+    endBytecode = function->bytecode + function->lenByteCode;               \
+    inlineCaches = function->inlineCaches;                                  \
+    stackScopes = &frame->stackScopes;                                      \
+    functionScope = frame->functionScope;                                   \
+    scopeLocal = stackScopes->back();                                       \
+    countTempValues = frame->countTempValues
+
+    LOAD_FUNCTION_FRAME();
+
+#if VM_OPCODE_PAIR_STATS
+    uint8_t prevCode = OP_INVALID;
+#define VM_STAT_OPCODE(code)    opCodePairCounts[prevCode][code]++; prevCode = code
+#else
+#define VM_STAT_OPCODE(code)
+#endif
+
+#if VM_PROFILER
+    // 统计刚取出的指令 code
+#define VM_PROFILE_OPCODE(code)                                             \
+    if (_isProfiling) {                                                     \
+        _profiler->onInstruction(_profiler->nodeOfFrame(ctx, frame),        \
+            (uint32_t)(bytecode - 1 - function->bytecode), code);           \
+    }
+#else
+#define VM_PROFILE_OPCODE(code)
+#endif
+
+#if VM_DIRECT_THREADED
+    // 每个 opcode 处理代码的地址，和 OpCode 的顺序相同
+#undef OP_ITEM
+#define OP_ITEM(a, b) &&LABEL_##a
+    static const void *dispatchTable[] = { OP_CODE_DEFINES };
+#undef OP_ITEM
+#define OP_ITEM(a, b) a
+
+#define VM_CASE(op)             case op: LABEL_##op
+    // 当前 opcode 执行完成后，如果没有异常且函数未结束，直接跳转到下一个 opcode 的处理代码
+#define VM_NEXT()                                                           \
+    if (bytecode < endBytecode && ctx->error == JE_OK) {                    \
+        code = (OpCode)*bytecode++;                                         \
+        VM_STAT_OPCODE(code);                                               \
+        VM_PROFILE_OPCODE(code);                                            \
+        goto *dispatchTable[code];                                          \
+    }                                                                       \
+    break
+#else
+#define VM_CASE(op)             case op
+#define VM_NEXT()               break
+#endif
+
+    while (true) {
+        if (bytecode >= endBytecode) {
+            // 函数执行完毕，或者有当前函数未处理的异常
+            if (stackFrames.size() == countFramesEntry + 1) {
+                break;
+            }
+
+            // 返回到调用者的 frame
+            auto callee = frame;
+            ctx->curFunctionScope = callee->prevFunctionScope;
+            runtime->leaveFunctionCall(callee->countTempValues);
+            stack.resize(callee->posStackReturn);
+            stack.push_back(callee->isConstructorCall ? callee->thiz : callee->retValue);
+            popTryCatchPoints(ctx);
+            ctx->popFrame();
+
+            frame = stackFrames.back();
+            LOAD_FUNCTION_FRAME();
+
+            if (ctx->error != JE_OK) {
+                // 异常继续在调用者中处理
+                frame->retValue = jsValueUndefined;
+                bytecode = catchException(ctx, frame);
+                if (bytecode == nullptr) {
+                    bytecode = endBytecode;
+                } else {
+                    scopeLocal = stackScopes->back();
+                }
+            }
+            continue;
+        }
+
         auto code = (OpCode)*bytecode++;
+        VM_STAT_OPCODE(code);
+        VM_PROFILE_OPCODE(code);
 //#ifdef DEBUG
 //        printf("    %s\n", opCodeToString(code));
 //#endif
         switch (code) {
-            case OP_INVALID: {
+            VM_CASE(OP_INVALID): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_PREPARE_VAR_THIS:
-                functionScope->vars[VAR_IDX_THIS] = thiz.type <= JDT_UNDEFINED ? jsValueGlobalThis : thiz;
-                break;
-            case OP_PREPARE_VAR_ARGUMENTS: {
+            VM_CASE(OP_PREPARE_VAR_THIS):
+                functionScope->vars[VAR_IDX_THIS] = frame->thiz.type <= JDT_UNDEFINED ? jsValueGlobalThis : frame->thiz;
+                VM_NEXT();
+            VM_CASE(OP_PREPARE_VAR_ARGUMENTS): {
                 functionScope->vars[VAR_IDX_ARGUMENTS] = runtime->pushObject(new JsArguments(functionScope, &functionScope->args));
-                break;
+                VM_NEXT();
             }
-            case OP_INIT_FUNCTION_TO_VARS: {
+            VM_CASE(OP_INIT_FUNCTION_TO_VARS): {
                 // 将根 scope 被引用到的函数添加到变量中
                 for (auto f : function->scope->functionDecls) {
-                    functionScope->vars[f->declare->storageIndex] = runtime->pushObject(new JsObjectFunction(stackScopes, f));
+                    functionScope->vars[f->declare->storageIndex] = runtime->pushObject(new JsObjectFunction(*stackScopes, f));
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_INIT_FUNCTION_TO_ARGS: {
+            VM_CASE(OP_INIT_FUNCTION_TO_ARGS): {
                 // 将根 scope 被引用到的函数添加到参数中
                 for (auto f : *function->scope->functionArgs) {
-                    functionScope->args[f->declare->storageIndex] = runtime->pushObject(new JsObjectFunction(stackScopes, f));
+                    functionScope->args[f->declare->storageIndex] = runtime->pushObject(new JsObjectFunction(*stackScopes, f));
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_RETURN:
-            case OP_RETURN_VALUE: {
+            VM_CASE(OP_RETURN):
+            VM_CASE(OP_RETURN_VALUE): {
                 if (code == OP_RETURN_VALUE) {
                     assert(stack.size() >= 1);
-                    retValue = stack.back();
+                    frame->retValue = stack.back();
                     stack.pop_back();
                 } else {
-                    retValue = jsValueUndefined;
+                    frame->retValue = jsValueUndefined;
                 }
-                bytecode = endBytecode;
 
                 // 检查是否在 try finally 中
-                auto &stackTryCatch = ctx->stackTryCatch;
-                if (!stackTryCatch.empty() && stackTryCatch.top().flags == makeTryCatchPointFlags(function, functionScope)) {
-                    do {
-                        // 当前函数有 try
-                        auto action = stackTryCatch.top();
-                        stackTryCatch.pop();
-                        if (action.addrFinally) {
-                            // 跳转到 finally
-                            bytecode = function->bytecode + action.addrFinally;
-                            ctx->isReturnedForTry = true;
-                            break;
-                        }
-                    } while (!stackTryCatch.empty() && stackTryCatch.top().flags == makeTryCatchPointFlags(function, functionScope));
+                bytecode = finallyOfReturn(ctx, function);
+                if (bytecode == nullptr) {
+                    bytecode = endBytecode;
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_DEBUGGER: {
+            VM_CASE(OP_DEBUGGER): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_THROW: {
+            VM_CASE(OP_THROW): {
                 assert(stack.size() >= 1);
                 ctx->throwException(JE_ERROR, stack.back());
                 stack.pop_back();
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP: {
+            VM_CASE(OP_JUMP): {
                 auto pos = readUInt32(bytecode);
+                if (function->bytecode + pos < bytecode) {
+                    runtime->garbageCollectAtSafePoint(countTempValues);
+                }
                 bytecode = function->bytecode + pos;
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP_IF_TRUE: {
+            VM_CASE(OP_JUMP_IF_TRUE): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto condition = stack.back();
+                stack.pop_back();
                 if (runtime->testTrue(condition)) {
+                    if (function->bytecode + pos < bytecode) {
+                        runtime->garbageCollectAtSafePoint(countTempValues);
+                    }
                     bytecode = function->bytecode + pos;
                 }
-                stack.pop_back();
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP_IF_TRUE_KEEP_VALID: {
+            VM_CASE(OP_JUMP_IF_TRUE_KEEP_VALID): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto condition = stack.back();
@@ -595,19 +1346,22 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 } else {
                     stack.pop_back();
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP_IF_FALSE: {
+            VM_CASE(OP_JUMP_IF_FALSE): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto condition = stack.back();
+                stack.pop_back();
                 if (!runtime->testTrue(condition)) {
+                    if (function->bytecode + pos < bytecode) {
+                        runtime->garbageCollectAtSafePoint(countTempValues);
+                    }
                     bytecode = function->bytecode + pos;
                 }
-                stack.pop_back();
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP_IF_FALSE_KEEP_COND: {
+            VM_CASE(OP_JUMP_IF_FALSE_KEEP_COND): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto condition = stack.back();
@@ -617,9 +1371,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     // false, jump
                     bytecode = function->bytecode + pos;
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP_IF_NULL_UNDEFINED: {
+            VM_CASE(OP_JUMP_IF_NULL_UNDEFINED): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto condition = stack.back();
@@ -627,9 +1381,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     bytecode = function->bytecode + pos;
                 }
                 stack.pop_back();
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP_IF_NOT_NULL_UNDEFINED: {
+            VM_CASE(OP_JUMP_IF_NOT_NULL_UNDEFINED): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto condition = stack.back();
@@ -637,9 +1391,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     bytecode = function->bytecode + pos;
                 }
                 stack.pop_back();
-                break;
+                VM_NEXT();
             }
-            case OP_JUMP_IF_NOT_NULL_UNDEFINED_KEEP_VALID: {
+            VM_CASE(OP_JUMP_IF_NOT_NULL_UNDEFINED_KEEP_VALID): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto condition = stack.back();
@@ -649,9 +1403,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     // condition 为 null/undefined，删除栈顶值
                     stack.pop_back();
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_SWITCH_CASE_CMP_JUMP: {
+            VM_CASE(OP_SWITCH_CASE_CMP_JUMP): {
                 assert(stack.size() >= 1);
                 auto pos = readUInt32(bytecode);
                 auto caseCond = stack.back(); stack.pop_back();
@@ -661,9 +1415,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     stack.pop_back(); // 不再比较 switchCond 了
                     bytecode = function->bytecode + pos;
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_SWITCH_CASE_FAST_CMP_JUMP: {
+            VM_CASE(OP_SWITCH_CASE_FAST_CMP_JUMP): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt16(bytecode);
                 auto switchJump = runtime->getSwitchJumpInResourcePool(idx, resourcePool);
@@ -671,9 +1425,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
 
                 VMAddress addr = switchJump.findAddress(runtime, resourcePool->index, switchCond);
                 bytecode = function->bytecode + addr;
-                break;
+                VM_NEXT();
             }
-            case OP_SET_WITH_OBJ: {
+            VM_CASE(OP_SET_WITH_OBJ): {
                 assert(stack.size() >= 1);
                 auto obj = stack.back(); stack.pop_back();
                 if (obj.type <= JDT_NULL) {
@@ -681,13 +1435,13 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     break;
                 }
                 scopeLocal->withValue = obj;
-                break;
+                VM_NEXT();
             }
-            case OP_PREPARE_RAW_STRING_TEMPLATE_CALL: {
+            VM_CASE(OP_PREPARE_RAW_STRING_TEMPLATE_CALL): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_FUNCTION_CALL: {
+            VM_CASE(OP_FUNCTION_CALL): {
                 uint16_t countArgs = readUInt16(bytecode);
                 assert(stack.size() >= 1 + countArgs);
                 size_t posFunc = stack.size() - countArgs - 1;
@@ -695,8 +1449,21 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 JsValue func = stack.at(posFunc);
                 switch (func.type) {
                     case JDT_FUNCTION: {
+                        // 在当前的解释循环中执行被调用的函数
                         auto f = (JsObjectFunction *)runtime->getObject(func);
-                        call(f->function, ctx, f->stackScopes, jsValueGlobalThis, args);
+                        frame->bytecode = bytecode;
+                        if (f->function->isGenerator || f->function->isAsync) {
+                            callResumable(ctx, f->function, f->stackScopes.data(), f->stackScopes.size(), jsValueGlobalThis, args);
+                            break;
+                        }
+                        auto callee = enterFunction(ctx, f->function, f->stackScopes.data(), f->stackScopes.size(), jsValueGlobalThis, args);
+                        if (callee) {
+                            callee->posStackReturn = (uint32_t)posFunc;
+                            frame = callee;
+                            LOAD_FUNCTION_FRAME();
+                            continue;
+                        }
+                        ctx->retValue = jsValueUndefined;
                         break;
                     }
                     case JDT_BOUND_FUNCTION: {
@@ -706,15 +1473,15 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     }
                     case JDT_NATIVE_FUNCTION: {
                         auto f = runtime->getNativeFunction(func.value.index);
-                        ctx->stackScopesForNativeFunctionCall = &stackScopes;
-                        f(ctx, jsValueGlobalThis, args);
+                        ctx->stackScopesForNativeFunctionCall = stackScopes;
+                        callNativeFunction(ctx, f, jsValueGlobalThis, args);
                         break;
                     }
                     case JDT_LIB_OBJECT: {
                         auto f = (JsLibObject *)runtime->getObject(func);
                         if (f->getFunction()) {
-                            ctx->stackScopesForNativeFunctionCall = &stackScopes;
-                            f->getFunction()(ctx, jsValueGlobalThis, args);
+                            ctx->stackScopesForNativeFunctionCall = stackScopes;
+                            callNativeFunction(ctx, f->getFunction(), jsValueGlobalThis, args);
                         } else {
                             ctx->throwException(JE_TYPE_ERROR, "? is not a function.");
                         }
@@ -726,9 +1493,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 }
                 stack.resize(posFunc);
                 stack.push_back(ctx->retValue);
-                break;
+                VM_NEXT();
             }
-            case OP_MEMBER_FUNCTION_CALL: {
+            VM_CASE(OP_MEMBER_FUNCTION_CALL): MEMBER_FUNCTION_CALL: {
                 uint16_t countArgs = readUInt16(bytecode);
                 assert(stack.size() >= 2 + countArgs);
                 size_t posThiz = stack.size() - countArgs - 2;
@@ -738,7 +1505,19 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 switch (func.type) {
                     case JDT_FUNCTION: {
                         auto f = (JsObjectFunction *)runtime->getObject(func);
-                        call(f->function, ctx, f->stackScopes, thiz, args);
+                        frame->bytecode = bytecode;
+                        if (f->function->isGenerator || f->function->isAsync) {
+                            callResumable(ctx, f->function, f->stackScopes.data(), f->stackScopes.size(), thiz, args);
+                            break;
+                        }
+                        auto callee = enterFunction(ctx, f->function, f->stackScopes.data(), f->stackScopes.size(), thiz, args);
+                        if (callee) {
+                            callee->posStackReturn = (uint32_t)posThiz;
+                            frame = callee;
+                            LOAD_FUNCTION_FRAME();
+                            continue;
+                        }
+                        ctx->retValue = jsValueUndefined;
                         break;
                     }
                     case JDT_BOUND_FUNCTION: {
@@ -748,15 +1527,15 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     }
                     case JDT_NATIVE_FUNCTION: {
                         auto f = runtime->getNativeFunction(func.value.index);
-                        ctx->stackScopesForNativeFunctionCall = &stackScopes;
-                        f(ctx, thiz, args);
+                        ctx->stackScopesForNativeFunctionCall = stackScopes;
+                        callNativeFunction(ctx, f, thiz, args);
                         break;
                     }
                     case JDT_LIB_OBJECT: {
                         auto libobj = (JsLibObject *)runtime->getObject(func);
                         auto f = libobj->getFunction();
                         if (f) {
-                            f(ctx, thiz, args);
+                            callNativeFunction(ctx, f, thiz, args);
                         } else {
                             ctx->throwException(JE_TYPE_ERROR, "value is not a function");
                             assert(0);
@@ -771,9 +1550,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 }
                 stack.resize(posThiz);
                 stack.push_back(ctx->retValue);
-                break;
+                VM_NEXT();
             }
-            case OP_DIRECT_FUNCTION_CALL: {
+            VM_CASE(OP_DIRECT_FUNCTION_CALL): {
                 auto depth = *bytecode++;
                 auto index = readUInt16(bytecode);
                 auto countArgs = readUInt16(bytecode);
@@ -781,83 +1560,89 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 size_t posArgs = stack.size() - countArgs;
                 Arguments args(stack.data() + posArgs, countArgs);
 
-                if (depth + 1 == stackScopes.size()) {
-                    // 当前函数的子函数
-                    auto targFunction = function->functions[index];
-                    call(targFunction, ctx, stackScopes, jsValueGlobalThis, args);
-                } else {
-                    // 父函数的子函数
-                    auto scope = stackScopes.at(depth);
-                    auto targFunction = scope->scopeDsc->function->functions[index];
-                    VecVMStackScopes targetStackScopes;
-                    targetStackScopes.insert(targetStackScopes.begin(), stackScopes.begin(), stackScopes.begin() + depth + 1);
-                    call(targFunction, ctx, targetStackScopes, jsValueGlobalThis, args);
+                // 当前函数或者父函数的子函数，其 scope 链为当前 scope 链的前 depth + 1 层
+                assert(depth < stackScopes->size());
+                auto scope = (*stackScopes)[depth];
+                auto targFunction = scope->scopeDsc->function->functions[index];
+                frame->bytecode = bytecode;
+                if (targFunction->isGenerator || targFunction->isAsync) {
+                    callResumable(ctx, targFunction, stackScopes->data(), depth + 1, jsValueGlobalThis, args);
+                    stack.resize(posArgs);
+                    stack.push_back(ctx->retValue);
+                    VM_NEXT();
+                }
+                auto callee = enterFunction(ctx, targFunction, stackScopes->data(), depth + 1, jsValueGlobalThis, args);
+                if (callee) {
+                    callee->posStackReturn = (uint32_t)posArgs;
+                    frame = callee;
+                    LOAD_FUNCTION_FRAME();
+                    continue;
                 }
                 stack.resize(posArgs);
-                stack.push_back(ctx->retValue);
-                break;
+                stack.push_back(jsValueUndefined);
+                VM_NEXT();
             }
-            case OP_ENTER_SCOPE: {
+            VM_CASE(OP_ENTER_SCOPE): {
                 auto scopeIdx = readUInt16(bytecode);
                 auto childScope = function->scopes[scopeIdx];
                 scopeLocal = runtime->newScope(childScope);
-                stackScopes.push_back(scopeLocal);
+                stackScopes->push_back(scopeLocal);
 
                 // 将当前 scope 的 functionDecls 添加到 functionScope 中
                 auto &childFuncs = childScope->functionDecls;
                 for (auto f : childFuncs) {
-                    functionScope->vars[f->declare->storageIndex] = runtime->pushObject(new JsObjectFunction(stackScopes, f));
+                    functionScope->vars[f->declare->storageIndex] = runtime->pushObject(new JsObjectFunction(*stackScopes, f));
                 }
 
                 if (childScope->hasWith || childScope->hasEval) {
 
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_LEAVE_SCOPE: {
-                stackScopes.pop_back();
-                scopeLocal = stackScopes.back();
-                break;
+            VM_CASE(OP_LEAVE_SCOPE): {
+                stackScopes->pop_back();
+                scopeLocal = stackScopes->back();
+                VM_NEXT();
             }
             // default:
             //    ERR_LOG1("Unkown opcode: %d", code);
             //    break;
-            case OP_POP_STACK_TOP: {
+            VM_CASE(OP_POP_STACK_TOP): {
                 assert(stack.size() >= 1);
                 stack.pop_back();
-                break;
+                VM_NEXT();
             }
-            case OP_POP_STACK_TOP_N: {
+            VM_CASE(OP_POP_STACK_TOP_N): {
                 auto count = readUInt16(bytecode);
                 assert(stack.size() >= count);
                 auto start = stack.end() - count;
                 stack.erase(start, stack.end());
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_UNDFINED: {
+            VM_CASE(OP_PUSH_UNDFINED): {
                 stack.push_back(jsValueUndefined);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_TRUE: {
+            VM_CASE(OP_PUSH_TRUE): {
                 stack.push_back(jsValueTrue);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_FALSE: {
+            VM_CASE(OP_PUSH_FALSE): {
                 stack.push_back(jsValueFalse);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_NULL: {
+            VM_CASE(OP_PUSH_NULL): {
                 stack.push_back(jsValueNull);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_BY_NAME: {
+            VM_CASE(OP_PUSH_ID_BY_NAME): {
                 auto idx = readUInt32(bytecode);
                 auto name = runtime->getStringByIdx(idx, resourcePool);
-                auto value = searchIdentifierByName(ctx, stackScopes, name);
+                auto value = searchIdentifierByName(ctx, *stackScopes, name);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_GLOBAL: {
+            VM_CASE(OP_PUSH_ID_GLOBAL): {
                 auto idx = readUInt16(bytecode);
                 auto globalScope = runtime->globalScope();
                 auto v = globalScope->get(ctx, idx);
@@ -868,180 +1653,199 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     break;
                 }
                 stack.push_back(v);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_LOCAL_ARGUMENT: {
+            VM_CASE(OP_PUSH_ID_LOCAL_ARGUMENT): {
                 auto idx = readUInt16(bytecode);
                 assert(idx < functionScope->args.capacity);
                 stack.push_back(functionScope->args[idx]);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_LOCAL_SCOPE: {
+            VM_CASE(OP_PUSH_ID_LOCAL_SCOPE): {
                 auto idx = readUInt16(bytecode);
                 stack.push_back(scopeLocal->vars[idx]);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_PARENT_ARGUMENT: {
+            VM_CASE(OP_PUSH_ID_PARENT_ARGUMENT): {
                 auto scopeDepth = *bytecode++;
                 auto idx = readUInt16(bytecode);
-                assert(scopeDepth < stackScopes.size());
-                auto scope = stackScopes[scopeDepth];
+                assert(scopeDepth < stackScopes->size());
+                auto scope = (*stackScopes)[scopeDepth];
                 assert(idx < scope->args.capacity);
                 stack.push_back(scope->args[idx]);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_PARENT_SCOPE: {
+            VM_CASE(OP_PUSH_ID_PARENT_SCOPE): {
                 auto scopeDepth = *bytecode++;
                 auto idx = readUInt16(bytecode);
-                assert(scopeDepth < stackScopes.size());
-                auto scope = stackScopes[scopeDepth];
+                assert(scopeDepth < stackScopes->size());
+                auto scope = (*stackScopes)[scopeDepth];
                 assert(idx < scope->vars.size());
                 stack.push_back(scope->vars[idx]);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_GLOBAL_BY_NAME: {
+            VM_CASE(OP_PUSH_ID_GLOBAL_BY_NAME): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_LOCAL_FUNCTION: {
+            VM_CASE(OP_PUSH_ID_LOCAL_FUNCTION): {
                 auto funcIdx = readUInt16(bytecode);
                 assert(funcIdx < scopeLocal->scopeDsc->function->functions.size());
-                auto v = runtime->pushObject(new JsObjectFunction(stackScopes, scopeLocal->scopeDsc->function->functions[funcIdx]));
+                auto v = runtime->pushObject(new JsObjectFunction(*stackScopes, scopeLocal->scopeDsc->function->functions[funcIdx]));
                 stack.push_back(v);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_ID_PARENT_FUNCTION: {
+            VM_CASE(OP_PUSH_ID_PARENT_FUNCTION): {
                 auto scopeIdx = readUInt8(bytecode);
                 auto funcIdx = readUInt16(bytecode);
-                assert(scopeIdx < stackScopes.size());
-                auto scope = stackScopes[scopeIdx];
+                assert(scopeIdx < stackScopes->size());
+                auto scope = (*stackScopes)[scopeIdx];
                 assert(funcIdx < scope->scopeDsc->function->functions.size());
-                auto v = runtime->pushObject(new JsObjectFunction(stackScopes, scope->scopeDsc->function->functions[funcIdx]));
+                auto v = runtime->pushObject(new JsObjectFunction(*stackScopes, scope->scopeDsc->function->functions[funcIdx]));
                 stack.push_back(v);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_STRING: {
+            VM_CASE(OP_PUSH_STRING): {
                 auto idx = readUInt32(bytecode);
                 stack.push_back(runtime->stringIdxToJsValue(function->resourcePool->index, idx));
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_CHAR: {
+            VM_CASE(OP_PUSH_CHAR): {
                 auto ch = readUInt16(bytecode);
                 stack.push_back(makeJsValueChar(ch));
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_REGEXP: {
+            VM_CASE(OP_PUSH_REGEXP): {
                 auto idx = readUInt32(bytecode);
                 auto &info = resourcePool->regexps[idx];
-                auto re = new JsRegExp(info.str, info.re, info.flags);
+                auto re = new JsRegExp(info.str, info.program);
                 stack.push_back(runtime->pushObject(re));
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_INT32: {
+            VM_CASE(OP_PUSH_INT32): {
                 auto value = readInt32(bytecode);
                 stack.push_back(makeJsValueInt32(value));
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_DOUBLE: {
+            VM_CASE(OP_PUSH_DOUBLE): {
                 auto idx = readUInt32(bytecode);
                 stack.push_back(runtime->numberIdxToJsValue(function->resourcePool->index, idx));
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_FUNCTION_EXPR: {
+            VM_CASE(OP_PUSH_FUNCTION_EXPR): {
                 auto scopeIdx = readUInt8(bytecode);
                 auto funcIdx = readUInt16(bytecode);
-                assert(scopeIdx < stackScopes.size());
-                auto scope = stackScopes[scopeIdx];
+                assert(scopeIdx < stackScopes->size());
+                auto scope = (*stackScopes)[scopeIdx];
                 assert(funcIdx < scope->scopeDsc->function->functions.size());
-                auto v = runtime->pushObject(new JsObjectFunction(stackScopes, scope->scopeDsc->function->functions[funcIdx]));
+                auto v = runtime->pushObject(new JsObjectFunction(*stackScopes, scope->scopeDsc->function->functions[funcIdx]));
                 stack.push_back(v);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_MEMBER_INDEX: {
+            VM_CASE(OP_PUSH_MEMBER_INDEX): {
                 assert(stack.size() >= 2);
                 auto index = stack.back(); stack.pop_back();
                 auto obj = stack.back();
-                auto value = getMemberIndex(ctx, obj, index);
+                JsValue value;
+                if (!getArrayMemberIndexPacked(runtime, obj, index, value)) {
+                    value = getMemberIndex(ctx, obj, index);
+                }
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_MEMBER_INDEX_INT: {
+            VM_CASE(OP_PUSH_MEMBER_INDEX_INT): {
                 assert(stack.size() >= 1);
                 auto index = makeJsValueInt32(readUInt32(bytecode));
                 auto obj = stack.back();
-                auto value = getMemberIndex(ctx, obj, index);
+                JsValue value;
+                if (!getArrayMemberIndexPacked(runtime, obj, index, value)) {
+                    value = getMemberIndex(ctx, obj, index);
+                }
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_MEMBER_DOT: {
+            VM_CASE(OP_PUSH_MEMBER_DOT): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
+                auto ic = getInlineCache(inlineCaches, readUInt16(bytecode));
                 auto obj = stack.back();
-                auto name = runtime->getStringByIdx(idx, resourcePool);
-                auto value = getMemberDot(ctx, obj, name);
+                JsValue value;
+                if (!ic || !getMemberDotByInlineCache(runtime, ic, obj, value)) {
+                    value = getMemberDotMissed(ctx, ic, obj, idx, resourcePool);
+                }
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_MEMBER_DOT_OPTIONAL: {
+            VM_CASE(OP_PUSH_MEMBER_DOT_OPTIONAL): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
+                auto ic = getInlineCache(inlineCaches, readUInt16(bytecode));
                 auto obj = stack.back();
                 if (obj.type <= JDT_NULL) {
                     stack.back() = jsValueUndefined;
                 } else {
-                    auto name = runtime->getStringByIdx(idx, resourcePool);
-                    auto value = getMemberDot(ctx, obj, name);
+                    JsValue value;
+                    if (!ic || !getMemberDotByInlineCache(runtime, ic, obj, value)) {
+                        value = getMemberDotMissed(ctx, ic, obj, idx, resourcePool);
+                    }
                     stack.back() = value;
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_THIS_MEMBER_DOT: {
+            VM_CASE(OP_PUSH_THIS_MEMBER_DOT): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
+                auto ic = getInlineCache(inlineCaches, readUInt16(bytecode));
                 auto obj = stack.back();
-                auto name = runtime->getStringByIdx(idx, resourcePool);
-                auto value = getMemberDot(ctx, obj, name);
+                JsValue value;
+                if (!ic || !getMemberDotByInlineCache(runtime, ic, obj, value)) {
+                    value = getMemberDotMissed(ctx, ic, obj, idx, resourcePool);
+                }
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_MEMBER_INDEX_NO_POP: {
+            VM_CASE(OP_PUSH_MEMBER_INDEX_NO_POP): {
                 assert(stack.size() >= 2);
                 auto index = stack.back();
                 auto obj = stack[stack.size() - 2];
                 auto value = getMemberIndex(ctx, obj, index);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_THIS_MEMBER_INDEX: {
+            VM_CASE(OP_PUSH_THIS_MEMBER_INDEX): {
                 assert(stack.size() >= 2);
                 auto index = stack.back(); stack.pop_back();
                 auto obj = stack.back();
                 auto value = getMemberIndex(ctx, obj, index);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_THIS_MEMBER_INDEX_INT: {
+            VM_CASE(OP_PUSH_THIS_MEMBER_INDEX_INT): {
                 assert(stack.size() >= 1);
                 auto index = makeJsValueInt32(readUInt32(bytecode));
                 auto obj = stack.back();
                 auto value = getMemberIndex(ctx, obj, index);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_THIS_MEMBER_DOT_OPTIONAL: {
+            VM_CASE(OP_PUSH_THIS_MEMBER_DOT_OPTIONAL): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
+                auto ic = getInlineCache(inlineCaches, readUInt16(bytecode));
                 auto obj = stack.back();
                 if (obj.type > JDT_NULL) {
-                    auto name = runtime->getStringByIdx(idx, resourcePool);
-                    auto value = getMemberDot(ctx, obj, name);
+                    JsValue value;
+                    if (!ic || !getMemberDotByInlineCache(runtime, ic, obj, value)) {
+                        value = getMemberDotMissed(ctx, ic, obj, idx, resourcePool);
+                    }
                     stack.push_back(value);
                 } else {
                     stack.push_back(jsValueUndefined);
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_ASSIGN_IDENTIFIER: {
+            VM_CASE(OP_ASSIGN_IDENTIFIER):
+            VM_CASE(OP_ASSIGN_IDENTIFIER_POP): {
                 assert(stack.size() >= 1);
                 auto varStorageType = *bytecode++;
                 auto scopeDepth = *bytecode++;
@@ -1049,15 +1853,15 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 VMScope *scope;
                 switch (varStorageType) {
                     case VST_ARGUMENT:
-                        assert(scopeDepth < stackScopes.size());
-                        scope = stackScopes[scopeDepth];
+                        assert(scopeDepth < stackScopes->size());
+                        scope = (*stackScopes)[scopeDepth];
                         assert(storageIndex < scope->args.capacity);
                         scope->args[storageIndex] = stack.back();
                         break;
                     case VST_SCOPE_VAR:
                     case VST_FUNCTION_VAR:
-                        assert(scopeDepth < stackScopes.size());
-                        scope = stackScopes[scopeDepth];
+                        assert(scopeDepth < stackScopes->size());
+                        scope = (*stackScopes)[scopeDepth];
                         assert(storageIndex < scope->vars.size());
                         scope->vars[storageIndex] = stack.back();
                         break;
@@ -1068,226 +1872,242 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                         assert(0);
                         break;
                 }
-                break;
+                if (code == OP_ASSIGN_IDENTIFIER_POP) {
+                    // 跳过紧随其后的 OP_POP_STACK_TOP
+                    assert(*bytecode == OP_POP_STACK_TOP);
+                    stack.pop_back();
+                    bytecode++;
+                }
+                VM_NEXT();
             }
-            case OP_ASSIGN_LOCAL_ARGUMENT: {
+            VM_CASE(OP_ASSIGN_LOCAL_ARGUMENT): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt16(bytecode);
                 assert(idx < functionScope->args.capacity);
                 functionScope->args[idx] = stack.back();
-                break;
+                VM_NEXT();
             }
-            case OP_ASSIGN_MEMBER_INDEX: {
+            VM_CASE(OP_ASSIGN_MEMBER_INDEX): {
                 assert(stack.size() >= 3);
                 auto value = stack.back(); stack.pop_back();
                 auto index = stack.back(); stack.pop_back();
                 auto obj = stack.back();
 
-                assignMemberIndexOperation(ctx, runtime, obj, index, value);
+                if (!setArrayMemberIndexPacked(runtime, obj, index, value)) {
+                    assignMemberIndexOperation(ctx, runtime, obj, index, value);
+                }
 
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_ASSIGN_MEMBER_DOT: {
+            VM_CASE(OP_ASSIGN_MEMBER_DOT): {
                 assert(stack.size() >= 2);
                 auto idx = readUInt32(bytecode);
+                auto ic = getInlineCache(inlineCaches, readUInt16(bytecode));
                 auto value = stack.back(); stack.pop_back();
-                auto obj = stack.back(); stack.pop_back();
-                auto name = runtime->getStringByIdx(idx, resourcePool);
-                setMemberDot(ctx, obj, name, value);
-                stack.push_back(value);
-                break;
+                auto obj = stack.back();
+                if (!ic || !setMemberDotByInlineCache(runtime, ic, obj, value)) {
+                    setMemberDot(ctx, obj, runtime->getStringByIdx(idx, resourcePool), value);
+                    if (ic) updateInlineCache(runtime, ic, obj, runtime->getAtomByIdx(idx, resourcePool), false);
+                }
+                stack.back() = value;
+                VM_NEXT();
             }
-            case OP_ASSIGN_VALUE_AHEAD_MEMBER_INDEX: {
+            VM_CASE(OP_ASSIGN_VALUE_AHEAD_MEMBER_INDEX): {
                 // 和 OP_ASSIGN_MEMBER_INDEX 不同的是，先 push value，再 push member index
                 assert(stack.size() >= 3);
                 auto index = stack.back(); stack.pop_back();
                 auto obj = stack.back(); stack.pop_back();
                 auto value = stack.back();
 
-                assignMemberIndexOperation(ctx, runtime, obj, index, value);
-                break;
+                if (!setArrayMemberIndexPacked(runtime, obj, index, value)) {
+                    assignMemberIndexOperation(ctx, runtime, obj, index, value);
+                }
+                VM_NEXT();
             }
-            case OP_ASSIGN_VALUE_AHEAD_MEMBER_DOT: {
+            VM_CASE(OP_ASSIGN_VALUE_AHEAD_MEMBER_DOT): {
                 // 和 OP_ASSIGN_MEMBER_DOT 不同的是，先 push value，再 push member dot
                 assert(stack.size() >= 2);
                 auto idx = readUInt32(bytecode);
-                auto obj = stack.back(); stack.pop_back();
-                auto value = stack.back();
-                auto name = runtime->getStringByIdx(idx, resourcePool);
-
-                setMemberDot(ctx, obj, name, value);
-                break;
+                auto ic = getInlineCache(inlineCaches, readUInt16(bytecode));
+                auto obj = stack.back();
+                auto value = stack[stack.size() - 2];
+                if (!ic || !setMemberDotByInlineCache(runtime, ic, obj, value)) {
+                    setMemberDot(ctx, obj, runtime->getStringByIdx(idx, resourcePool), value);
+                    if (ic) updateInlineCache(runtime, ic, obj, runtime->getAtomByIdx(idx, resourcePool), false);
+                }
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_INCREMENT_ID_PRE: {
-                opIncreaseIdentifier(ctx, runtime, bytecode, stackScopes, 1, false);
-                break;
+            VM_CASE(OP_INCREMENT_ID_PRE): {
+                opIncreaseIdentifier(ctx, runtime, bytecode, *stackScopes, 1, false);
+                VM_NEXT();
             }
-            case OP_INCREMENT_ID_POST: {
-                opIncreaseIdentifier(ctx, runtime, bytecode, stackScopes, 1, true);
-                break;
+            VM_CASE(OP_INCREMENT_ID_POST): {
+                opIncreaseIdentifier(ctx, runtime, bytecode, *stackScopes, 1, true);
+                VM_NEXT();
             }
-            case OP_DECREMENT_ID_PRE: {
-                opIncreaseIdentifier(ctx, runtime, bytecode, stackScopes, -1, false);
-                break;
+            VM_CASE(OP_DECREMENT_ID_PRE): {
+                opIncreaseIdentifier(ctx, runtime, bytecode, *stackScopes, -1, false);
+                VM_NEXT();
             }
-            case OP_DECREMENT_ID_POST: {
-                opIncreaseIdentifier(ctx, runtime, bytecode, stackScopes, -1, true);
-                break;
+            VM_CASE(OP_DECREMENT_ID_POST): {
+                opIncreaseIdentifier(ctx, runtime, bytecode, *stackScopes, -1, true);
+                VM_NEXT();
             }
-            case OP_INCREMENT_MEMBER_DOT_PRE: {
+            VM_CASE(OP_INCREMENT_MEMBER_DOT_PRE): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
                 auto name = runtime->getStringByIdx(idx, resourcePool);
                 JsValue obj = stack.back(); stack.pop_back();
                 auto value = increaseMemberDot(ctx, obj, name, 1, false);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_INCREMENT_MEMBER_DOT_POST: {
+            VM_CASE(OP_INCREMENT_MEMBER_DOT_POST): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
                 auto name = runtime->getStringByIdx(idx, resourcePool);
                 JsValue obj = stack.back(); stack.pop_back();
                 auto value = increaseMemberDot(ctx, obj, name, 1, true);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_DECREMENT_MEMBER_DOT_PRE: {
+            VM_CASE(OP_DECREMENT_MEMBER_DOT_PRE): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
                 auto name = runtime->getStringByIdx(idx, resourcePool);
                 JsValue obj = stack.back(); stack.pop_back();
                 auto value = increaseMemberDot(ctx, obj, name, -1, false);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_DECREMENT_MEMBER_DOT_POST: {
+            VM_CASE(OP_DECREMENT_MEMBER_DOT_POST): {
                 assert(stack.size() >= 1);
                 auto idx = readUInt32(bytecode);
                 auto name = runtime->getStringByIdx(idx, resourcePool);
                 JsValue obj = stack.back(); stack.pop_back();
                 auto value = increaseMemberDot(ctx, obj, name, -1, true);
                 stack.push_back(value);
-                break;
+                VM_NEXT();
             }
-            case OP_INCREMENT_MEMBER_INDEX_PRE: {
+            VM_CASE(OP_INCREMENT_MEMBER_INDEX_PRE): {
                 assert(stack.size() >= 2);
                 JsValue index = stack.back(); stack.pop_back();
                 JsValue obj = stack.back();
                 auto value = increaseMemberIndex(ctx, obj, index, 1, false);
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_INCREMENT_MEMBER_INDEX_POST: {
+            VM_CASE(OP_INCREMENT_MEMBER_INDEX_POST): {
                 assert(stack.size() >= 2);
                 JsValue index = stack.back(); stack.pop_back();
                 JsValue obj = stack.back();
                 auto value = increaseMemberIndex(ctx, obj, index, 1, true);
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_DECREMENT_MEMBER_INDEX_PRE: {
+            VM_CASE(OP_DECREMENT_MEMBER_INDEX_PRE): {
                 assert(stack.size() >= 2);
                 JsValue index = stack.back(); stack.pop_back();
                 JsValue obj = stack.back();
                 auto value = increaseMemberIndex(ctx, obj, index, -1, false);
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_DECREMENT_MEMBER_INDEX_POST: {
+            VM_CASE(OP_DECREMENT_MEMBER_INDEX_POST): {
                 assert(stack.size() >= 2);
                 JsValue index = stack.back(); stack.pop_back();
                 JsValue obj = stack.back();
                 auto value = increaseMemberIndex(ctx, obj, index, -1, true);
                 stack.back() = value;
-                break;
+                VM_NEXT();
             }
-            case OP_ADD: {
+            VM_CASE(OP_ADD): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = plusOperate(ctx, runtime, left, right);
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = plusOperate(ctx, runtime, left, right);
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_SUB: {
+            VM_CASE(OP_SUB): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpSub());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpSub());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_MUL: {
+            VM_CASE(OP_MUL): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpMul());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpMul());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_DIV: {
+            VM_CASE(OP_DIV): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpDiv());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpDiv());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_MOD: {
+            VM_CASE(OP_MOD): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpMod());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpMod());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_EXP: {
+            VM_CASE(OP_EXP): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpExp());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpExp());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_BIT_OR: {
+            VM_CASE(OP_BIT_OR): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpBitOr());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpBitOr());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_BIT_XOR: {
+            VM_CASE(OP_BIT_XOR): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpBitXor());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpBitXor());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_BIT_AND: {
+            VM_CASE(OP_BIT_AND): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpBitAnd());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpBitAnd());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_LEFT_SHIFT: {
+            VM_CASE(OP_LEFT_SHIFT): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpLeftShift());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpLeftShift());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_RIGHT_SHIFT: {
+            VM_CASE(OP_RIGHT_SHIFT): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpRightShift());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpRightShift());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_UNSIGNED_RIGHT_SHIFT: {
+            VM_CASE(OP_UNSIGNED_RIGHT_SHIFT): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpUnsignedRightShift());
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = arithmeticBinaryOperation(ctx, runtime, left, right, BinaryOpUnsignedRightShift());
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_PREFIX_NEGATE: {
+            VM_CASE(OP_PREFIX_NEGATE): {
                 assert(stack.size() >= 1);
                 JsValue &v = stack.back();
                 if (v.type == JDT_INT32) {
@@ -1303,9 +2123,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                         v = runtime->pushDouble(-d);
                     }
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_PREFIX_PLUS: {
+            VM_CASE(OP_PREFIX_PLUS): {
                 assert(stack.size() >= 1);
                 JsValue &v = stack.back();
                 if (v.type == JDT_INT32 || v.type == JDT_NUMBER) {
@@ -1321,82 +2141,82 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                         v = runtime->pushDouble(d);
                     }
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_LOGICAL_NOT: {
+            VM_CASE(OP_LOGICAL_NOT): {
                 assert(stack.size() >= 1);
                 JsValue right = stack.back();
                 stack.back() = makeJsValueBool(!runtime->testTrue(right));
-                break;
+                VM_NEXT();
             }
-            case OP_BIT_NOT: {
+            VM_CASE(OP_BIT_NOT): {
                 assert(stack.size() >= 1);
                 stack.back() = bitNotOperation(ctx, stack.back());
-                break;
+                VM_NEXT();
             }
-            case OP_INEQUAL_STRICT: {
+            VM_CASE(OP_INEQUAL_STRICT): {
                 assert(stack.size() >= 2);
                 JsValue right = stack.back(); stack.pop_back();
                 JsValue left = stack.back(); stack.pop_back();
                 stack.push_back(makeJsValueBool(!relationalStrictEqual(runtime, left, right)));
-                break;
+                VM_NEXT();
             }
-            case OP_INEQUAL: {
+            VM_CASE(OP_INEQUAL): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
+                auto &right = stack.back(), &left = stack.end()[-2];
                 bool ret = relationalEqual(ctx, runtime, left, right);
+                stack.pop_back();
                 stack.back() = makeJsValueBool(!ret);
-                break;
+                VM_NEXT();
             }
-            case OP_EQUAL_STRICT: {
+            VM_CASE(OP_EQUAL_STRICT): {
                 assert(stack.size() >= 2);
                 JsValue right = stack.back(); stack.pop_back();
                 JsValue left = stack.back(); stack.pop_back();
                 stack.push_back(makeJsValueBool(relationalStrictEqual(runtime, left, right)));
-                break;
+                VM_NEXT();
             }
-            case OP_EQUAL: {
+            VM_CASE(OP_EQUAL): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
+                auto &right = stack.back(), &left = stack.end()[-2];
                 bool ret = relationalEqual(ctx, runtime, left, right);
+                stack.pop_back();
                 stack.back() = makeJsValueBool(ret);
-                break;
+                VM_NEXT();
             }
-            case OP_LESS_THAN: {
+            VM_CASE(OP_LESS_THAN): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
+                auto &right = stack.back(), &left = stack.end()[-2];
                 bool ret = relationalOperate(ctx, runtime, left, right, RelationalOpLessThan());
+                stack.pop_back();
                 stack.back() = makeJsValueBool(ret);
-                break;
+                VM_NEXT();
             }
-            case OP_LESS_EQUAL_THAN: {
+            VM_CASE(OP_LESS_EQUAL_THAN): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
+                auto &right = stack.back(), &left = stack.end()[-2];
                 bool ret = relationalOperate(ctx, runtime, left, right, RelationalOpLessEqThan());
+                stack.pop_back();
                 stack.back() = makeJsValueBool(ret);
-                break;
+                VM_NEXT();
             }
-            case OP_GREATER_THAN: {
+            VM_CASE(OP_GREATER_THAN): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
+                auto &right = stack.back(), &left = stack.end()[-2];
                 bool ret = relationalOperate(ctx, runtime, left, right, RelationalOpGreaterThan());
+                stack.pop_back();
                 stack.back() = makeJsValueBool(ret);
-                break;
+                VM_NEXT();
             }
-            case OP_GREATER_EQUAL_THAN: {
+            VM_CASE(OP_GREATER_EQUAL_THAN): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
+                auto &right = stack.back(), &left = stack.end()[-2];
                 bool ret = relationalOperate(ctx, runtime, left, right, RelationalOpGreaterEqThan());
+                stack.pop_back();
                 stack.back() = makeJsValueBool(ret);
-                break;
+                VM_NEXT();
             }
-            case OP_IN: {
+            VM_CASE(OP_IN): {
                 assert(stack.size() >= 2);
                 JsValue right = stack.back(); stack.pop_back();
                 JsValue left = stack.back(); stack.pop_back();
@@ -1411,16 +2231,16 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 auto pobj = runtime->getObject(right);
                 auto prop = pobj->getRaw(ctx, left, true);
                 stack.push_back(makeJsValueBool(prop != nullptr));
-                break;
+                VM_NEXT();
             }
-            case OP_INSTANCE_OF: {
+            VM_CASE(OP_INSTANCE_OF): {
                 assert(stack.size() >= 2);
-                JsValue right = stack.back(); stack.pop_back();
-                JsValue left = stack.back();
-                stack.back() = makeJsValueBool(instanceOf(ctx, runtime, left, right));
-                break;
+                auto &right = stack.back(), &left = stack.end()[-2];
+                stack.end()[-2] = makeJsValueBool(instanceOf(ctx, runtime, left, right));
+                stack.pop_back();
+                VM_NEXT();
             }
-            case OP_DELETE_MEMBER_DOT: {
+            VM_CASE(OP_DELETE_MEMBER_DOT): {
                 assert(stack.size() >= 1);
                 auto obj = stack.back(); stack.pop_back();
                 auto stringIdx = readUInt32(bytecode);
@@ -1433,9 +2253,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     }
                 }
                 stack.push_back(jsValueTrue);
-                break;
+                VM_NEXT();
             }
-            case OP_DELETE_MEMBER_INDEX: {
+            VM_CASE(OP_DELETE_MEMBER_INDEX): {
                 assert(stack.size() >= 2);
                 auto index = stack.back(); stack.pop_back();
                 auto obj = stack.back(); stack.pop_back();
@@ -1444,23 +2264,23 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     pobj->remove(ctx, index);
                 }
                 stack.push_back(jsValueTrue);
-                break;
+                VM_NEXT();
             }
-            case OP_DELETE_ID_BY_NAME: {
+            VM_CASE(OP_DELETE_ID_BY_NAME): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_DELETE_ID_GLOBAL: {
+            VM_CASE(OP_DELETE_ID_GLOBAL): {
                 auto index = readUInt16(bytecode);
                 stack.push_back(makeJsValueBool(runtime->globalScope()->remove(ctx, index)));
-                break;
+                VM_NEXT();
             }
-            case OP_DELETE: {
+            VM_CASE(OP_DELETE): {
                 assert(stack.size() >= 1);
                 stack.back() = jsValueTrue;
-                break;
+                VM_NEXT();
             }
-            case OP_TYPEOF: {
+            VM_CASE(OP_TYPEOF): {
                 assert(stack.size() >= 1);
                 auto value = stack.back(); stack.pop_back();
                 switch (value.type) {
@@ -1488,14 +2308,14 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     }
                     default: stack.push_back(jsStringValueObject); break;
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_VOID: {
+            VM_CASE(OP_VOID): {
                 assert(stack.size() >= 1);
                 stack.back() = jsValueUndefined;
-                break;
+                VM_NEXT();
             }
-            case OP_NEW: {
+            VM_CASE(OP_NEW): {
                 uint16_t countArgs = readUInt16(bytecode);
                 assert(stack.size() >= 1 + countArgs);
                 auto posStack = stack.size() - countArgs - 1;
@@ -1507,7 +2327,7 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     case JDT_FUNCTION: {
                         auto obj = (JsObjectFunction *)runtime->getObject(func);
                         assert(obj->type == JDT_FUNCTION);
-                        if (obj->function->isMemberFunction) {
+                        if (obj->function->isMemberFunction || obj->function->isGenerator || obj->function->isAsync) {
                             ctx->throwException(JE_TYPE_ERROR, "? is not a constructor");
                             break;
                         }
@@ -1517,7 +2337,15 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                             prototype = jsValuePrototypeObject;
                         }
                         thizVal = runtime->pushObject(new JsObject(prototype));
-                        call(obj->function, ctx, obj->stackScopes, thizVal, args);
+                        frame->bytecode = bytecode;
+                        auto callee = enterFunction(ctx, obj->function, obj->stackScopes.data(), obj->stackScopes.size(), thizVal, args);
+                        if (callee) {
+                            callee->posStackReturn = (uint32_t)posStack;
+                            callee->isConstructorCall = true;
+                            frame = callee;
+                            LOAD_FUNCTION_FRAME();
+                            continue;
+                        }
                         break;
                     }
                     case JDT_BOUND_FUNCTION: {
@@ -1534,13 +2362,13 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                             break;
                         }
 
-                        obj->getFunction()(ctx, jsValueEmpty, args);
+                        callNativeFunction(ctx, obj->getFunction(), jsValueEmpty, args);
                         thizVal = ctx->retValue;
                         break;
                     }
                     case JDT_NATIVE_FUNCTION: {
                         auto f = runtime->getNativeFunction(func.value.index);
-                        f(ctx, jsValueEmpty, args);
+                        callNativeFunction(ctx, f, jsValueEmpty, args);
                         thizVal = ctx->retValue;
                     }
                     default:
@@ -1550,17 +2378,17 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
 
                 stack.resize(posStack);
                 stack.push_back(thizVal);
-                break;
+                VM_NEXT();
             }
-            case OP_NEW_TARGET: {
+            VM_CASE(OP_NEW_TARGET): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_OBJ_CREATE: {
+            VM_CASE(OP_OBJ_CREATE): {
                 stack.push_back(runtime->pushObject(new JsObject()));
-                break;
+                VM_NEXT();
             }
-            case OP_OBJ_SET_PROPERTY: {
+            VM_CASE(OP_OBJ_SET_PROPERTY): {
                 assert(stack.size() >= 2);
                 auto nameIdx = readUInt32(bytecode);
                 auto value = stack.back(); stack.pop_back();
@@ -1569,9 +2397,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 auto pobj = runtime->getObject(obj);
                 auto name = runtime->getStringByIdx(nameIdx, resourcePool);
                 pobj->setByName(ctx, obj, name, value);
-                break;
+                VM_NEXT();
             }
-            case OP_OBJ_SET_COMPUTED_PROPERTY: {
+            VM_CASE(OP_OBJ_SET_COMPUTED_PROPERTY): {
                 assert(stack.size() >= 3);
                 auto value = stack.back(); stack.pop_back();
                 auto name = stack.back(); stack.pop_back();
@@ -1579,17 +2407,17 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 assert(obj.type == JDT_OBJECT);
                 auto pobj = (JsObject *)runtime->getObject(obj);
                 pobj->set(ctx, obj, name, value);
-                break;
+                VM_NEXT();
             }
-            case OP_OBJ_SPREAD_PROPERTY: {
+            VM_CASE(OP_OBJ_SPREAD_PROPERTY): {
                 assert(stack.size() >= 2);
                 auto src = stack.back(); stack.pop_back();
                 auto obj = stack.back();
                 assert(obj.type == JDT_OBJECT);
                 runtime->extendObject(ctx, obj, src);
-                break;
+                VM_NEXT();
             }
-            case OP_OBJ_SET_GETTER: {
+            VM_CASE(OP_OBJ_SET_GETTER): {
                 assert(stack.size() >= 2);
                 auto idx = readUInt32(bytecode);
                 auto value = stack.back(); stack.pop_back();
@@ -1598,9 +2426,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 auto pobj = (JsObject *)runtime->getObject(obj);
                 auto name = runtime->getStringByIdx(idx, resourcePool);
                 pobj->addGetterSetterByName(ctx, name, value, jsValueUndefined);
-                break;
+                VM_NEXT();
             }
-            case OP_OBJ_SET_SETTER: {
+            VM_CASE(OP_OBJ_SET_SETTER): {
                 assert(stack.size() >= 2);
                 auto idx = readUInt32(bytecode);
                 auto value = stack.back(); stack.pop_back();
@@ -1609,54 +2437,54 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 auto pobj = (JsObject *)runtime->getObject(obj);
                 auto name = runtime->getStringByIdx(idx, resourcePool);
                 pobj->addGetterSetterByName(ctx, name, jsValueUndefined, value);
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_CREATE: {
+            VM_CASE(OP_ARRAY_CREATE): {
                 stack.push_back(runtime->pushObject(new JsArray()));
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_SPREAD_VALUE: {
+            VM_CASE(OP_ARRAY_SPREAD_VALUE): {
                 assert(stack.size() >= 2);
                 auto item = stack.back(); stack.pop_back();
                 auto arr = stack.back();
                 runtime->extendObject(ctx, arr, item);
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_PUSH_VALUE: {
+            VM_CASE(OP_ARRAY_PUSH_VALUE): {
                 assert(stack.size() >= 2);
                 auto item = stack.back(); stack.pop_back();
                 auto arr = stack.back();
                 assert(arr.type == JDT_ARRAY);
                 auto a = (JsArray *)runtime->getObject(arr);
                 a->push(ctx, item);
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_PUSH_EMPTY_VALUE: {
+            VM_CASE(OP_ARRAY_PUSH_EMPTY_VALUE): {
                 assert(stack.size() >= 1);
                 auto arr = stack.back();
                 assert(arr.type == JDT_ARRAY);
                 auto a = (JsArray *)runtime->getObject(arr);
                 a->pushEmpty();
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_ASSING_CREATE: {
+            VM_CASE(OP_ARRAY_ASSING_CREATE): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_ASSIGN_REST_VALUE: {
+            VM_CASE(OP_ARRAY_ASSIGN_REST_VALUE): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_ASSIGN_PUSH_VALUE: {
+            VM_CASE(OP_ARRAY_ASSIGN_PUSH_VALUE): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_ARRAY_ASSIGN_PUSH_UNDEFINED_VALUE: {
+            VM_CASE(OP_ARRAY_ASSIGN_PUSH_UNDEFINED_VALUE): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_ITERATOR_IN_CREATE:
-            case OP_ITERATOR_OF_CREATE: {
+            VM_CASE(OP_ITERATOR_IN_CREATE):
+            VM_CASE(OP_ITERATOR_OF_CREATE): {
                 assert(stack.size() >= 1);
                 auto obj = stack.back(); stack.pop_back();
                 IJsIterator *it = nullptr;
@@ -1683,9 +2511,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                 }
                 assert(it);
                 stack.push_back(runtime->pushObject(it));
-                break;
+                VM_NEXT();
             }
-            case OP_ITERATOR_NEXT_KEY: {
+            VM_CASE(OP_ITERATOR_NEXT_KEY): {
                 assert(stack.size() >= 1);
                 auto addrEnd = readUInt32(bytecode);
                 auto it = stack.back();
@@ -1701,9 +2529,9 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     // 弹出 it
                     stack.pop_back();
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_ITERATOR_NEXT_VALUE: {
+            VM_CASE(OP_ITERATOR_NEXT_VALUE): {
                 assert(stack.size() >= 1);
                 auto addrEnd = readUInt32(bytecode);
                 auto it = stack.back();
@@ -1719,42 +2547,64 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     // 弹出 it
                     stack.pop_back();
                 }
-                break;
+                VM_NEXT();
             }
-            case OP_SPREAD_ARGS: {
+            VM_CASE(OP_SPREAD_ARGS): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_REST_PARAMETER: {
+            VM_CASE(OP_REST_PARAMETER): {
                 assert(0);
-                break;
+                VM_NEXT();
             }
-            case OP_PUSH_EXCEPTION: {
+            VM_CASE(OP_YIELD):
+            VM_CASE(OP_AWAIT): {
+                // 暂停 generator/async 函数，返回到 resumeGenerator. 其 frame 一定是当前解释循环的入口 frame
+                assert(frame->generator && stackFrames.size() == countFramesEntry + 1);
+                assert(stack.size() >= 1);
+                auto value = stack.back();
+                stack.pop_back();
+                frame->bytecode = bytecode;
+                frame->generator->suspend(frame, frame->posStackReturn);
+                frame->retValue = value;
+                bytecode = endBytecode;
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_EXCEPTION): {
                 stack.push_back(ctx->errorMessage);
-                break;
+                VM_NEXT();
             }
-            case OP_TRY_START: {
+            VM_CASE(OP_TRY_START): {
                 auto addrCatch = readUInt32(bytecode);
                 auto addrFinally = readUInt32(bytecode);
-                ctx->stackTryCatch.push(TryCatchPoint(makeTryCatchPointFlags(function, functionScope),
-                        (uint32_t)stackScopes.size(), (uint32_t)stack.size(), addrCatch, addrFinally));
-                break;
+                ctx->stackTryCatch.push(TryCatchPoint((uint32_t)stackFrames.size(),
+                        (uint32_t)stackScopes->size(), (uint32_t)stack.size(), addrCatch, addrFinally));
+                VM_NEXT();
+            }
+            VM_CASE(OP_TRY_END): {
+                // try 顺序执行完成，需要去掉 stackTryCatch 中添加的处理点
+                auto &stackTryCatch = ctx->stackTryCatch;
+                assert(!stackTryCatch.empty());
+                assert(stackTryCatch.top().frameDepth == stackFrames.size());
+                assert(stackTryCatch.top().addrFinally == 0);
+                stackTryCatch.pop();
+                VM_NEXT();
             }
-            case OP_BEGIN_FINALLY_NORMAL: {
+            VM_CASE(OP_BEGIN_FINALLY_NORMAL): {
                 // 顺序执行到此，需要去掉 stackTryCatch 中添加的处理点
                 auto &stackTryCatch = ctx->stackTryCatch;
                 assert(!stackTryCatch.empty());
-                assert(stackTryCatch.top().flags == makeTryCatchPointFlags(function, functionScope));
+                assert(stackTryCatch.top().frameDepth == stackFrames.size());
                 assert(stackTryCatch.top().addrCatch == 0);
                 assert(stackTryCatch.top().addrFinally != 0);
                 stackTryCatch.pop();
-                break;
+                VM_NEXT();
             }
-            case OP_FINISH_FINALLY: {
+            VM_CASE(OP_FINISH_FINALLY): {
                 if (ctx->isReturnedForTry) {
                     // 检查是否执行了 return 指令
                     auto &stackTryCatch = ctx->stackTryCatch;
-                    if (!stackTryCatch.empty() && stackTryCatch.top().flags == makeTryCatchPointFlags(function, functionScope)) {
+                    if (!stackTryCatch.empty() && stackTryCatch.top().frameDepth == stackFrames.size()) {
                         // 当前函数还有 try
                         auto action = stackTryCatch.top();
                         stackTryCatch.pop();
@@ -1776,7 +2626,101 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
                     ctx->errorMessageInTry = jsValueUndefined;
                     stack.push_back(ctx->errorMessage);
                 }
-                break;
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_ID_LOCAL_SCOPE_CMP_JUMP):
+            VM_CASE(OP_PUSH_ID_PARENT_SCOPE_CMP_JUMP): {
+                auto left = readFusedOperand(code == OP_PUSH_ID_LOCAL_SCOPE_CMP_JUMP ? OP_PUSH_ID_LOCAL_SCOPE : OP_PUSH_ID_PARENT_SCOPE,
+                                             bytecode, *stackScopes, functionScope);
+                auto p = bytecode;
+                auto right = readFusedOperand(*p++, p, *stackScopes, functionScope);
+                if (left.type == JDT_INT32 && right.type == JDT_INT32) {
+                    bool ret = compareInt32(*p++, left.value.n32, right.value.n32);
+                    assert(*p == OP_JUMP_IF_FALSE);
+                    p++;
+                    auto pos = readUInt32(p);
+                    if (ret) {
+                        bytecode = p;
+                    } else {
+                        if (function->bytecode + pos < p) {
+                            runtime->garbageCollectAtSafePoint(countTempValues);
+                        }
+                        bytecode = function->bytecode + pos;
+                    }
+                } else {
+                    // 按照第一条指令执行，再依次执行后续的原指令
+                    stack.push_back(left);
+                }
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_ID_LOCAL_SCOPE_ADD_SUB):
+            VM_CASE(OP_PUSH_ID_PARENT_SCOPE_ADD_SUB): {
+                auto left = readFusedOperand(code == OP_PUSH_ID_LOCAL_SCOPE_ADD_SUB ? OP_PUSH_ID_LOCAL_SCOPE : OP_PUSH_ID_PARENT_SCOPE,
+                                             bytecode, *stackScopes, functionScope);
+                auto p = bytecode;
+                auto right = readFusedOperand(*p++, p, *stackScopes, functionScope);
+                if (left.type == JDT_INT32 && right.type == JDT_INT32) {
+                    int64_t n = left.value.n32;
+                    if (*p++ == OP_ADD) {
+                        n += right.value.n32;
+                    } else {
+                        assert(p[-1] == OP_SUB);
+                        n -= right.value.n32;
+                    }
+                    if (n == (int32_t)n) {
+                        stack.push_back(makeJsValueInt32((int32_t)n));
+                        bytecode = p;
+                        VM_NEXT();
+                    }
+                }
+                stack.push_back(left);
+                VM_NEXT();
+            }
+            VM_CASE(OP_PUSH_THIS_MEMBER_DOT_CALL): {
+                assert(stack.size() >= 1);
+                auto idx = readUInt32(bytecode);
+                auto ic = getInlineCache(inlineCaches, readUInt16(bytecode));
+                auto obj = stack.back();
+                JsValue value;
+                if (!ic || !getMemberDotByInlineCache(runtime, ic, obj, value)) {
+                    value = getMemberDotMissed(ctx, ic, obj, idx, resourcePool);
+                }
+                stack.push_back(value);
+                if (ctx->error == JE_OK) {
+                    // 直接执行紧随其后的 OP_MEMBER_FUNCTION_CALL
+                    assert(*bytecode == OP_MEMBER_FUNCTION_CALL);
+                    bytecode++;
+                    goto MEMBER_FUNCTION_CALL;
+                }
+                VM_NEXT();
+            }
+            VM_CASE(OP_INCREMENT_ID_JUMP):
+            VM_CASE(OP_DECREMENT_ID_JUMP): {
+                int inc = code == OP_INCREMENT_ID_JUMP ? 1 : -1;
+                auto p = bytecode;
+                auto varStorageType = *p++;
+                auto scopeDepth = *p++;
+                auto storageIndex = readUInt16(p);
+                assert(varStorageType == VST_SCOPE_VAR || varStorageType == VST_FUNCTION_VAR);
+                assert(scopeDepth < stackScopes->size());
+                auto scope = (*stackScopes)[scopeDepth];
+                assert(storageIndex < scope->vars.size());
+                auto &v = scope->vars[storageIndex];
+                if (v.type == JDT_INT32 && v.value.n32 != (inc > 0 ? INT32_MAX : INT32_MIN)) {
+                    v = makeJsValueInt32(v.value.n32 + inc);
+
+                    // 跳过 OP_POP_STACK_TOP，执行 OP_JUMP
+                    assert(p[0] == OP_POP_STACK_TOP && p[1] == OP_JUMP);
+                    p += 2;
+                    auto pos = readUInt32(p);
+                    if (function->bytecode + pos < p) {
+                        runtime->garbageCollectAtSafePoint(countTempValues);
+                    }
+                    bytecode = function->bytecode + pos;
+                    VM_NEXT();
+                }
+                opIncreaseIdentifier(ctx, runtime, bytecode, *stackScopes, inc, true);
+                VM_NEXT();
             }
         }
 
@@ -1784,52 +2728,39 @@ void JsVirtualMachine::call(Function *function, VMContext *ctx, VecVMStackScopes
             // 有异常发生
 
             // 异常会清除 return 相关内容
-            retValue = jsValueUndefined;
+            frame->retValue = jsValueUndefined;
 
-            auto &stackTryCatch = ctx->stackTryCatch;
-            if (stackTryCatch.empty() || stackTryCatch.top().flags != makeTryCatchPointFlags(function, functionScope)) {
-                // 当前函数没有接收异常处理
-                break;
+            bytecode = catchException(ctx, frame);
+            if (bytecode == nullptr) {
+                // 当前函数没有接收异常处理，返回到调用者
+                bytecode = endBytecode;
             } else {
-                auto &action = stackTryCatch.top();
-
-                // 发生异常，恢复 stackScopes 和 stack
-                stackScopes.erase(stackScopes.begin() + action.scopeDepth, stackScopes.end());
-                stack.erase(stack.begin() + action.stackSize, stack.end());
-
-                if (action.addrCatch != 0) {
-                    // 跳转到 catch 的位置
-                    bytecode = function->bytecode + action.addrCatch;
-
-                    // 清除异常标志
-                    ctx->error = JE_OK;
-
-                    if (action.addrFinally == 0) {
-                        // 没有 finally
-                        stackTryCatch.pop();
-                    } else {
-                        // 表示 Catch 已经处理
-                        action.addrCatch = 0;
-                    }
-                } else {
-                    // 跳转到 finally 的位置
-                    ctx->errorInTry = ctx->error;
-                    ctx->errorMessageInTry = ctx->errorMessage;
-                    ctx->error = JE_OK;
-
-                    assert(action.addrFinally != 0);
-                    bytecode = function->bytecode + action.addrFinally;
-                    stackTryCatch.pop();
-                }
+                scopeLocal = stackScopes->back();
             }
         }
     }
 
-    ctx->curFunctionScope = prevFunctionScope;
+#undef LOAD_FUNCTION_FRAME
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_STAT_OPCODE
+#undef VM_PROFILE_OPCODE
+
+    assert(stackFrames.size() == countFramesEntry + 1 && stackFrames.back() == frame);
+    auto retValue = frame->retValue;
+    ctx->curFunctionScope = frame->prevFunctionScope;
     ctx->retValue = retValue;
+    popTryCatchPoints(ctx);
+    ctx->popFrame();
+
+#if VM_PROFILER
+    if (_isProfiling && stackFrames.empty()) {
+        // 最外层的解释执行结束，之后的时间不再计入最后一条指令
+        _profiler->flush();
+    }
+#endif
 
-    stackScopes.pop_back();
-    ctx->stackFrames.pop_back();
+    runtime->leaveFunctionCall(countTempValues, retValue);
 }
 
 /*
@@ -8,25 +8,45 @@
 #ifndef VirtualMachine_hpp
 #define VirtualMachine_hpp
 
+#include <algorithm>
 #include "VMScope.hpp"
 
 
+// 解释循环的分派方式: 1 为 direct-threaded (computed goto, 需要编译器支持 labels as values)，0 为 switch.
+// 可以在编译时定义 VM_DIRECT_THREADED=0 来强制使用 switch.
+#ifndef VM_DIRECT_THREADED
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_DIRECT_THREADED      1
+#else
+#define VM_DIRECT_THREADED      0
+#endif
+#endif
+
+// 为 1 时编译 VMProfiler，可以通过 JsVirtualMachine::startProfiler 开始统计. 默认关闭，解释循环中没有额外的开销.
+#ifndef VM_PROFILER
+#define VM_PROFILER             0
+#endif
+
+#if VM_PROFILER
+#include "VMProfiler.hpp"
+#endif
+
 class VMScopeDescriptor;
 class VMFunctionFrame;
 class VMRuntimeCommon;
 class VMRuntime;
 class VMContext;
 class JsVirtualMachine;
+class JsGeneratorObject;
 class Arguments;
 
 
-using VMFunctionFramePtr = std::shared_ptr<VMFunctionFrame>;
 using VecVMScopes = std::vector<VMScope *>;
 using VecVMStackScopes = std::vector<VMScope *>;
-using StackJsValues = std::vector<JsValue>;
-using VecVMStackFrames = std::vector<VMFunctionFramePtr>;
+using VecVMStackFrames = std::vector<VMFunctionFrame *>;
 
 JsValue newJsError(VMContext *ctx, JsError errType, const JsValue &message = jsValueUndefined);
+JsValue newJsAggregateError(VMContext *ctx, const JsValue &errors, const JsValue &message = jsValueUndefined);
 
 enum VMMiscFlags {
     COMMON_STRINGS              = 1,
@@ -35,33 +55,133 @@ enum VMMiscFlags {
     VAR_IDX_ARGUMENTS           = 1,
 
     POOL_STRING_IDX_INVALID     = 0,
+
+    // 缺省的最大函数调用层次
+    MAX_CALL_DEPTH              = 10000,
+};
+
+/**
+ * 解释执行时的操作数栈.
+ *
+ * 空间在 reserve 时一次性分配，之后不会再重新分配 (Arguments 会直接引用栈中的值)，
+ * 所以 push_back 等操作不需要检查和扩展空间. 调用函数前会检查剩余的空间，见 JsVirtualMachine::enterFunction.
+ */
+class StackJsValues {
+private:
+    StackJsValues(const StackJsValues &);
+    StackJsValues &operator=(const StackJsValues &);
+
+public:
+    StackJsValues() : _data(nullptr), _top(nullptr), _end(nullptr) { }
+    ~StackJsValues() { delete [] _data; }
+
+    void reserve(size_t capacity) {
+        if (capacity > this->capacity()) {
+            auto data = new JsValue[capacity];
+            auto count = size();
+            std::copy(_data, _top, data);
+            delete [] _data;
+            _data = data;
+            _top = data + count;
+            _end = data + capacity;
+        }
+    }
+
+    void push_back(const JsValue &value) { assert(_top < _end); *_top++ = value; }
+    void pop_back() { assert(_top > _data); _top--; }
+    JsValue &back() { assert(_top > _data); return _top[-1]; }
+
+    JsValue &at(size_t n) { assert(n < size()); return _data[n]; }
+    JsValue &operator[](size_t n) { assert(n < size()); return _data[n]; }
+
+    void resize(size_t n) {
+        assert(n <= capacity());
+        auto top = _data + n;
+        if (top > _top) {
+            std::fill(_top, top, jsValueUndefined);
+        }
+        _top = top;
+    }
+
+    // 只支持删除栈顶部的值
+    void erase(JsValue *first, JsValue *last) { assert(last == _top && first >= _data); _top = first; }
+
+    JsValue *data() { return _data; }
+    JsValue *begin() { return _data; }
+    JsValue *end() { return _top; }
+
+    size_t size() const { return _top - _data; }
+    size_t capacity() const { return _end - _data; }
+    bool empty() const { return _top == _data; }
+
+protected:
+    JsValue                     *_data;
+    JsValue                     *_top;
+    JsValue                     *_end;
+
 };
 
 /**
  * VMFunctionFrame 即是函数调用的 frame，也是当前函数的 root scope.
+ *
+ * JavaScript 函数之间的调用不再递归调用 JsVirtualMachine::call，而是在同一个解释循环中切换 frame.
+ * frame 由 VMContext 缓存复用，其地址在使用期间不会改变 (native function 可能持有 thiz 等的引用).
  */
 class VMFunctionFrame {
 public:
-    VMFunctionFrame(VMScope *scope, Function *function) : scope(scope), function(function) { }
-
     VMScope                     *scope;
     Function                    *function;
 
+    // 函数执行时的 scope 链: 函数定义处的 scope 链 + 当前函数的 scope.
+    // 每个 frame 都有自己的 stackScopes，递归调用时不会相互影响.
+    VecVMStackScopes            stackScopes;
+    JsValue                     thiz;
+    JsValue                     retValue;
+
+    // 函数 scope，对于 code block (eval) 是调用者的函数 scope
+    VMScope                     *functionScope;
+    VMScope                     *prevFunctionScope;
+
+    // 调用其他函数时，保存当前执行的位置
+    uint8_t                     *bytecode;
+
+    uint32_t                    countTempValues;
+
+    // 返回到调用者时，stack 恢复到此位置，再压入返回值
+    uint32_t                    posStackReturn;
+
+    // 是否为 new 调用，返回时压入的是 thiz
+    bool                        isConstructorCall;
+
+    // generator 和 async 函数的 frame 对应的 JsGeneratorObject，暂停时保存 frame 的状态
+    JsGeneratorObject           *generator;
+
+#if VM_PROFILER
+    // 在调用树中的结点，开始 profile 后第一次执行指令时设置
+    VMProfileNode               *profileNode;
+#endif
+
 };
 
 struct TryCatchPoint {
-    uint32_t                    flags; // 用于判断是否为当前函数的异常
+    uint32_t                    frameDepth; // try 所在函数的 frame 层次，用于判断是否为当前函数的异常
     uint32_t                    scopeDepth; // 进入 try 时的 scopeDepth，当出现异常后，需要释放 scope.
     uint32_t                    stackSize; // 进入 try 时的 scopeDepth，当出现异常后，需要释放 stack.
     uint32_t                    addrCatch;
     uint32_t                    addrFinally;
 
-    TryCatchPoint(uint32_t flags, uint32_t scopeDepth, uint32_t stackSize, uint32_t addrCatch, uint32_t addrFinally) : flags(flags), scopeDepth(scopeDepth), stackSize(stackSize), addrCatch(addrCatch), addrFinally(addrFinally) {
+    TryCatchPoint(uint32_t frameDepth, uint32_t scopeDepth, uint32_t stackSize, uint32_t addrCatch, uint32_t addrFinally) : frameDepth(frameDepth), scopeDepth(scopeDepth), stackSize(stackSize), addrCatch(addrCatch), addrFinally(addrFinally) {
     }
 };
 
 using StackTryCatchPoint = std::stack<TryCatchPoint>;
 
+enum GeneratorResumeMode {
+    GRM_NEXT,
+    GRM_THROW,
+    GRM_RETURN,
+};
+
 /**
  * 运行时的函数调用上下文，包括了当前的调用堆栈等信息
  */
@@ -78,6 +198,9 @@ public:
     void throwException(JsError err, JsValue errorMessage);
     void throwExceptionFormatJsValue(JsError err, cstr_t format, const JsValue &value);
 
+    VMFunctionFrame *pushFrame();
+    void popFrame();
+
     JsVirtualMachine            *vm;
     VMScope                     *curFunctionScope;
     VMRuntime                   *runtime;
@@ -89,6 +212,8 @@ public:
 
     StackJsValues               stack;
     VecVMStackFrames            stackFrames; // 当前的函数调用栈，用于记录函数的调用层次
+    VecVMStackFrames            freeFrames; // 已经返回的 frame，缓存以便复用
+    uint32_t                    maxCallDepth;
 
     StackTryCatchPoint          stackTryCatch;
 
@@ -111,10 +236,16 @@ private:
 
 public:
     JsVirtualMachine();
+    // 从 snapshot 创建 defaultRuntime，状态和创建 snapshot 时相同. 见 VMSnapshot
+    JsVirtualMachine(const VMSnapshot *snapshot);
     virtual ~JsVirtualMachine();
 
     void run(cstr_t code, size_t len, VMRuntime *runtime = nullptr);
 
+    // 和 run 相同，但是使用 cacheFile 缓存解析的结果: cacheFile 和 code 匹配时直接加载 bytecode 执行，跳过解析;
+    // 否则解析 code，并将所有函数的 bytecode 写入 cacheFile. 返回是否使用了缓存. 见 ByteCodeCache.
+    bool runWithCache(cstr_t code, size_t len, cstr_t cacheFile, VMRuntime *runtime = nullptr);
+
     void eval(cstr_t code, size_t len, VMContext *ctx, VecVMStackScopes &stackScopes, const Arguments &args);
     void callMember(VMContext *ctx, const JsValue &thiz, const StringView &memberName, const Arguments &args);
     void callMember(VMContext *ctx, const JsValue &thiz, const JsValue &memberFunc, const Arguments &args);
@@ -125,16 +256,84 @@ public:
     JsValue getMemberIndex(VMContext *ctx, const JsValue &thiz, const JsValue &prop);
     void setMemberIndex(VMContext *ctx, const JsValue &thiz, const JsValue &prop, const JsValue &value);
 
+    /**
+     * 恢复执行 generator (next/throw/return) 或者 async 函数 (await 的 promise settled 后)，直到下一个 yield/await 或者结束.
+     * generator: ctx->retValue 为 yield 或者返回的值，未处理的异常保存在 ctx->error 中;
+     * async 函数: 结束或者异常时 settle 其返回的 promise，ctx->retValue 为此 promise.
+     */
+    void resumeGenerator(VMContext *ctx, JsGeneratorObject *generator, GeneratorResumeMode mode, const JsValue &value);
+
     void dump(cstr_t code, size_t len, BinaryOutputStream &stream);
     void dump(BinaryOutputStream &stream);
 
     VMRuntime *defaultRuntime() { return &_runtime; }
 
+    // 是否延迟解析函数，缺省为 true. 见 JSParser::setLazyParse
+    void setLazyParse(bool isLazyParse) { _isLazyParse = isLazyParse; }
+
+#if VM_PROFILER
+    // 开始统计，会清除之前的统计数据
+    void startProfiler();
+    void stopProfiler();
+    bool isProfiling() const { return _isProfiling; }
+
+    // 输出统计的结果，停止统计后仍然可以输出
+    void dumpProfile(BinaryOutputStream &stream) { if (_profiler) _profiler->dumpFlat(stream); }
+    void dumpProfileFoldedStacks(BinaryOutputStream &stream) { if (_profiler) _profiler->dumpFoldedStacks(stream); }
+#endif
+
 protected:
-    void call(Function *function, VMContext *ctx, VecVMStackScopes &stackScopes, const JsValue &thiz, const Arguments &args);
+    friend class VMRepeatedCall;
+
+    void finishRun(VMRuntime *runtime, VMContext *ctx);
+
+    // reusedScope 不为空时，作为函数的 scope，不再分配新的 scope. 见 VMRepeatedCall
+    void call(Function *function, VMContext *ctx, VecVMStackScopes &stackScopes, const JsValue &thiz, const Arguments &args, VMScope *reusedScope = nullptr);
+    VMFunctionFrame *enterFunction(VMContext *ctx, Function *function, VMScope * const *scopes, size_t countScopes, const JsValue &thiz, const Arguments &args, VMScope *reusedScope = nullptr);
+
+    // 调用 generator 或者 async 函数: 返回 generator 对象，或者执行到第一个 await 后返回 promise
+    void callResumable(VMContext *ctx, Function *function, VMScope * const *scopes, size_t countScopes, const JsValue &thiz, const Arguments &args);
+
+    // 解释执行已经在调用栈顶部的 frame，直到其返回或者暂停
+    void run(VMContext *ctx, VMFunctionFrame *frame);
 
 protected:
     VMRuntime                   _runtime;
+    bool                        _isLazyParse;
+
+#if VM_PROFILER
+    VMProfiler                  *_profiler;
+    bool                        _isProfiling;
+#endif
+
+};
+
+/**
+ * 重复调用同一个函数，比如 Array.prototype.sort 的比较函数.
+ *
+ * 预先取出 JavaScript 函数的 Function 和 scope 链，每次调用时不再经过 callMember 的类型判断.
+ * 函数不会创建闭包，也不使用 arguments, eval 和 with 时，其 scope 在函数返回后不会再被引用，
+ * 所以多次调用之间复用同一个 VMScope，不用每次都分配 (也减少了触发 GC 的次数).
+ * 复用的 scope 在调用之间没有被任何 root 引用，发生过 GC 后就可能被回收了，需要重新分配.
+ */
+class VMRepeatedCall {
+public:
+    VMRepeatedCall(VMContext *ctx, const JsValue &func);
+
+    // 返回值保存在 ctx->retValue 中
+    void call(const JsValue &thiz, const Arguments &args);
+
+protected:
+    VMContext                   *_ctx;
+    JsValue                     _func;
+
+    // _func 为 JDT_FUNCTION 时有效
+    Function                    *_function;
+    VecVMStackScopes            *_stackScopes;
+
+    bool                        _isScopeReusable;
+    VMScope                     *_scope;
+    uint32_t                    _countGarbageCollect;
 
 };
 
@@ -44,13 +44,16 @@ const char *jsDataTypeToString(JsDataType type) {
         "JDT_GETTER_SETTER",
         "JDT_STRING",
 
-        "JDT_ITERATOR",
-
         "JDT_OBJECT",
         "JDT_ARRAY",
         "JDT_REGEX",
         "JDT_DATE",
         "JDT_PROMISE",
+        "JDT_MAP",
+        "JDT_SET",
+        "JDT_WEAK_MAP",
+        "JDT_WEAK_SET",
+        "JDT_GENERATOR",
         "JDT_ARGUMENTS",
         "JDT_OBJ_X",
 
@@ -60,6 +63,8 @@ const char *jsDataTypeToString(JsDataType type) {
         "JDT_OBJ_SYMBOL",
         "JDT_OBJ_GLOBAL_THIS",
 
+        "JDT_ITERATOR",
+
         "JDT_FUNCTION",
         "JDT_BOUND_FUNCTION",
         "JDT_NATIVE_FUNCTION",
@@ -127,6 +132,181 @@ bool decodeBytecode(uint8_t *bytecode, int lenBytecode, BinaryOutputStream &stre
     return true;
 }
 
+// 根据参数描述计算指令的长度（包括 opcode 本身）
+static int calcOpCodeSize(const OpCodeDesc &desc) {
+    int size = 1;
+    auto p = desc.params;
+    while ((p = strchr(p, ':')) != nullptr) {
+        p++;
+        if (strncmp(p, "u8", 2) == 0 || strncmp(p, "varStorageType", 14) == 0) size += 1;
+        else if (strncmp(p, "u16", 3) == 0) size += 2;
+        else if (strncmp(p, "u32", 3) == 0 || strncmp(p, "i32", 3) == 0) size += 4;
+        else if (strncmp(p, "u64", 3) == 0 || strncmp(p, "i64", 3) == 0) size += 8;
+        else { assert(0); }
+    }
+    return size;
+}
+
+struct OpCodeSizes {
+    uint8_t sizes[CountOf(OP_CODE_DESCRIPTIONS)];
+
+    OpCodeSizes() {
+        for (size_t i = 0; i < CountOf(OP_CODE_DESCRIPTIONS); i++) {
+            sizes[i] = (uint8_t)calcOpCodeSize(OP_CODE_DESCRIPTIONS[i]);
+        }
+    }
+};
+
+static OpCodeSizes opCodeSizes;
+
+inline uint8_t *nextInstruction(uint8_t *p) {
+    assert(*p < CountOf(OP_CODE_DESCRIPTIONS));
+    return p + opCodeSizes.sizes[*p];
+}
+
+// 融合指令中第二个操作数可以是的指令
+inline bool isFusibleOperand(uint8_t code) {
+    return code == OP_PUSH_INT32 || code == OP_PUSH_ID_LOCAL_SCOPE || code == OP_PUSH_ID_PARENT_SCOPE || code == OP_PUSH_ID_LOCAL_ARGUMENT;
+}
+
+inline bool isRelationalCompare(uint8_t code) {
+    return code == OP_LESS_THAN || code == OP_LESS_EQUAL_THAN || code == OP_GREATER_THAN || code == OP_GREATER_EQUAL_THAN;
+}
+
+/**
+ * 融合指令只替换序列中第一条指令的 opcode，序列中的其他指令保持原样：
+ *   1. bytecode 长度不变，不需要重新计算跳转地址;
+ *   2. 跳转到序列中间的指令时，仍然按照原来的指令执行;
+ *   3. 融合指令的快速路径不满足条件时，可以只执行第一条指令，然后继续执行后续的原指令.
+ * 为了保证融合指令读取到的后续指令都是原指令，匹配成功后跳过整个序列.
+ */
+void optimizeByteCode(uint8_t *bytecode, int lenBytecode) {
+    auto p = bytecode, end = bytecode + lenBytecode;
+    while (p < end) {
+        auto next = nextInstruction(p);
+        auto next2 = next < end ? nextInstruction(next) : end;
+        auto next3 = next2 < end ? nextInstruction(next2) : end;
+        auto next4 = next3 < end ? nextInstruction(next3) : end;
+
+        switch (*p) {
+            case OP_PUSH_ID_LOCAL_SCOPE:
+            case OP_PUSH_ID_PARENT_SCOPE: {
+                if (next2 >= end || !isFusibleOperand(*next)) {
+                    break;
+                }
+
+                bool isLocal = *p == OP_PUSH_ID_LOCAL_SCOPE;
+                if (next3 < end && isRelationalCompare(*next2) && *next3 == OP_JUMP_IF_FALSE) {
+                    // i < n, 然后条件跳转
+                    *p = isLocal ? OP_PUSH_ID_LOCAL_SCOPE_CMP_JUMP : OP_PUSH_ID_PARENT_SCOPE_CMP_JUMP;
+                    next = next4;
+                } else if (*next2 == OP_ADD || *next2 == OP_SUB) {
+                    // s + 1, s - i
+                    *p = isLocal ? OP_PUSH_ID_LOCAL_SCOPE_ADD_SUB : OP_PUSH_ID_PARENT_SCOPE_ADD_SUB;
+                    next = next3;
+                }
+                break;
+            }
+            case OP_PUSH_THIS_MEMBER_DOT: {
+                if (next < end && *next == OP_MEMBER_FUNCTION_CALL) {
+                    // obj.func(...)
+                    *p = OP_PUSH_THIS_MEMBER_DOT_CALL;
+                    next = next2;
+                }
+                break;
+            }
+            case OP_INCREMENT_ID_PRE:
+            case OP_INCREMENT_ID_POST:
+            case OP_DECREMENT_ID_PRE:
+            case OP_DECREMENT_ID_POST: {
+                // 循环末尾的 i++，然后跳转回循环开始处. 只处理 scope 中的变量
+                auto varStorageType = p[1];
+                if (next2 < end && *next == OP_POP_STACK_TOP && *next2 == OP_JUMP &&
+                    (varStorageType == VST_SCOPE_VAR || varStorageType == VST_FUNCTION_VAR)) {
+                    bool isIncrement = *p == OP_INCREMENT_ID_PRE || *p == OP_INCREMENT_ID_POST;
+                    *p = isIncrement ? OP_INCREMENT_ID_JUMP : OP_DECREMENT_ID_JUMP;
+                    next = next3;
+                }
+                break;
+            }
+            case OP_ASSIGN_IDENTIFIER: {
+                if (next < end && *next == OP_POP_STACK_TOP) {
+                    // 赋值语句
+                    *p = OP_ASSIGN_IDENTIFIER_POP;
+                    next = next2;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        p = next;
+    }
+
+    assert(p == end);
+}
+
+// 参数中的标识符类型为 VST_GLOBAL_VAR 时，var_index 为全局变量的索引
+inline bool isOpCodeWithVarStorageType(uint8_t code) {
+    return strncmp(OP_CODE_DESCRIPTIONS[code].params, "identifier_storage_type:varStorageType", 38) == 0;
+}
+
+void findGlobalVarOperands(uint8_t *bytecode, int lenBytecode, std::vector<uint8_t *> &operands) {
+    auto p = bytecode, end = bytecode + lenBytecode;
+    while (p < end) {
+        auto code = *p;
+        if (code == OP_PUSH_ID_GLOBAL || code == OP_DELETE_ID_GLOBAL) {
+            operands.push_back(p + 1);
+        } else if (isOpCodeWithVarStorageType(code) && p[1] == VST_GLOBAL_VAR) {
+            // varStorageType, scope_depth, var_index
+            operands.push_back(p + 3);
+        }
+
+        p = nextInstruction(p);
+    }
+
+    assert(p == end);
+}
+
+uint64_t opCodesFingerprint() {
+    uint64_t hash = CountOf(OP_CODE_DESCRIPTIONS);
+    for (auto &item : OP_CODE_DESCRIPTIONS) {
+        hash = hashBytes(item.name, strlen(item.name), hash);
+        hash = hashBytes(item.params, strlen(item.params), hash);
+    }
+    return hash;
+}
+
+#if VM_OPCODE_PAIR_STATS
+uint32_t opCodePairCounts[256][256];
+
+void dumpOpCodePairStats(BinaryOutputStream &stream, int countTop) {
+    struct Item {
+        uint32_t count;
+        uint8_t first, second;
+    };
+
+    std::vector<Item> items;
+    for (int i = 0; i < 256; i++) {
+        for (int k = 0; k < 256; k++) {
+            if (opCodePairCounts[i][k]) {
+                items.push_back({opCodePairCounts[i][k], (uint8_t)i, (uint8_t)k});
+            }
+        }
+    }
+
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) { return a.count > b.count; });
+    if (items.size() > (size_t)countTop) {
+        items.resize(countTop);
+    }
+
+    for (auto &item : items) {
+        stream.writeFormat("%12u  %s, %s\n", item.count, opCodeToString((OpCode)item.first), opCodeToString((OpCode)item.second));
+    }
+}
+#endif
+
 string JsSymbol::toString() const {
     return "Symbol(" + name + ")";
 }
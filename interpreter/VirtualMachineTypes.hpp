@@ -9,10 +9,16 @@
 #define VirtualMachineTypes_hpp
 
 #include <deque>
+#include <cmath>
 #include "utils/StringView.h"
 #include "utils/BinaryStream.h"
 
 
+// 为 1 时统计相邻 opcode 对的执行次数（用于分析融合指令），会降低执行性能，默认关闭.
+#ifndef VM_OPCODE_PAIR_STATS
+#define VM_OPCODE_PAIR_STATS    0
+#endif
+
 class IJsObject;
 class JsObject;
 class IJsIterator;
@@ -81,21 +87,21 @@ extern StringView SS_FALSE;
     \
     OP_ITEM(OP_PUSH_MEMBER_INDEX, ""), \
     OP_ITEM(OP_PUSH_MEMBER_INDEX_INT, "index:u32"), \
-    OP_ITEM(OP_PUSH_MEMBER_DOT, "property_string_idx:u32"), \
-    OP_ITEM(OP_PUSH_MEMBER_DOT_OPTIONAL, "property_string_idx:u32"), \
+    OP_ITEM(OP_PUSH_MEMBER_DOT, "property_string_idx:u32, inline_cache_idx:u16"), \
+    OP_ITEM(OP_PUSH_MEMBER_DOT_OPTIONAL, "property_string_idx:u32, inline_cache_idx:u16"), \
     \
     OP_ITEM(OP_PUSH_MEMBER_INDEX_NO_POP, ""), \
     OP_ITEM(OP_PUSH_THIS_MEMBER_INDEX, ""), \
     OP_ITEM(OP_PUSH_THIS_MEMBER_INDEX_INT, "index:u32"), \
-    OP_ITEM(OP_PUSH_THIS_MEMBER_DOT, "property_string_idx:u32"), \
-    OP_ITEM(OP_PUSH_THIS_MEMBER_DOT_OPTIONAL, "property_string_idx:u32"), \
+    OP_ITEM(OP_PUSH_THIS_MEMBER_DOT, "property_string_idx:u32, inline_cache_idx:u16"), \
+    OP_ITEM(OP_PUSH_THIS_MEMBER_DOT_OPTIONAL, "property_string_idx:u32, inline_cache_idx:u16"), \
     \
     OP_ITEM(OP_ASSIGN_IDENTIFIER, "identifier_storage_type:varStorageType, scope_depth:u8, var_index:u16"), \
     OP_ITEM(OP_ASSIGN_LOCAL_ARGUMENT, "argument_idx:u16"), \
     OP_ITEM(OP_ASSIGN_MEMBER_INDEX, ""), \
-    OP_ITEM(OP_ASSIGN_MEMBER_DOT, "property_string_idx:u32"), \
+    OP_ITEM(OP_ASSIGN_MEMBER_DOT, "property_string_idx:u32, inline_cache_idx:u16"), \
     OP_ITEM(OP_ASSIGN_VALUE_AHEAD_MEMBER_INDEX, ""), \
-    OP_ITEM(OP_ASSIGN_VALUE_AHEAD_MEMBER_DOT, "property_string_idx:u32"), \
+    OP_ITEM(OP_ASSIGN_VALUE_AHEAD_MEMBER_DOT, "property_string_idx:u32, inline_cache_idx:u16"), \
     OP_ITEM(OP_INCREMENT_ID_PRE, "identifier_storage_type:varStorageType, scope_depth:u8, var_index:u16"), \
     OP_ITEM(OP_INCREMENT_ID_POST, "identifier_storage_type:varStorageType, scope_depth:u8, var_index:u16"), \
     OP_ITEM(OP_DECREMENT_ID_PRE, "identifier_storage_type:varStorageType, scope_depth:u8, var_index:u16"), \
@@ -174,10 +180,33 @@ extern StringView SS_FALSE;
     OP_ITEM(OP_SPREAD_ARGS, ""), \
     OP_ITEM(OP_REST_PARAMETER, "index:u16"), \
     \
+    /* 暂停 generator/async 函数，栈顶为 yield/await 的值. 恢复执行时栈顶为 next() 传入的值或者 await 的结果 */\
+    OP_ITEM(OP_YIELD, ""), \
+    OP_ITEM(OP_AWAIT, ""), \
+    \
     OP_ITEM(OP_TRY_START, "address_catch:u32, address_finally:u32"), \
+    OP_ITEM(OP_TRY_END, ""), \
     OP_ITEM(OP_PUSH_EXCEPTION, ""), \
     OP_ITEM(OP_BEGIN_FINALLY_NORMAL, ""), \
     OP_ITEM(OP_FINISH_FINALLY, ""), \
+    \
+    /* 以下为 optimizeByteCode 生成的融合指令（superinstruction），只替换序列中第一条指令的 opcode， */\
+    /* 参数和后续指令保持不变，所以参数描述和被替换的指令相同. 快速路径不满足时，按第一条指令执行 */\
+    /* 第二个操作数可以为: OP_PUSH_INT32, OP_PUSH_ID_LOCAL_SCOPE, OP_PUSH_ID_PARENT_SCOPE, OP_PUSH_ID_LOCAL_ARGUMENT */\
+    /* OP_PUSH_ID_LOCAL_SCOPE/OP_PUSH_ID_PARENT_SCOPE, 第二个操作数, 比较, OP_JUMP_IF_FALSE */\
+    OP_ITEM(OP_PUSH_ID_LOCAL_SCOPE_CMP_JUMP, "var_idx:u16"), \
+    OP_ITEM(OP_PUSH_ID_PARENT_SCOPE_CMP_JUMP, "scope_depth:u8, var_idx:u16"), \
+    /* OP_PUSH_ID_LOCAL_SCOPE/OP_PUSH_ID_PARENT_SCOPE, 第二个操作数, OP_ADD/OP_SUB */\
+    OP_ITEM(OP_PUSH_ID_LOCAL_SCOPE_ADD_SUB, "var_idx:u16"), \
+    OP_ITEM(OP_PUSH_ID_PARENT_SCOPE_ADD_SUB, "scope_depth:u8, var_idx:u16"), \
+    /* OP_PUSH_THIS_MEMBER_DOT, OP_MEMBER_FUNCTION_CALL */\
+    OP_ITEM(OP_PUSH_THIS_MEMBER_DOT_CALL, "property_string_idx:u32, inline_cache_idx:u16"), \
+    /* OP_INCREMENT_ID_PRE/POST, OP_POP_STACK_TOP, OP_JUMP */\
+    OP_ITEM(OP_INCREMENT_ID_JUMP, "identifier_storage_type:varStorageType, scope_depth:u8, var_index:u16"), \
+    /* OP_DECREMENT_ID_PRE/POST, OP_POP_STACK_TOP, OP_JUMP */\
+    OP_ITEM(OP_DECREMENT_ID_JUMP, "identifier_storage_type:varStorageType, scope_depth:u8, var_index:u16"), \
+    /* OP_ASSIGN_IDENTIFIER, OP_POP_STACK_TOP */\
+    OP_ITEM(OP_ASSIGN_IDENTIFIER_POP, "identifier_storage_type:varStorageType, scope_depth:u8, var_index:u16"), \
 
 
 #ifdef OP_ITEM
@@ -235,6 +264,11 @@ enum JsDataType : uint8_t {
     JDT_REGEX,
     JDT_DATE,
     JDT_PROMISE,
+    JDT_MAP,
+    JDT_SET,
+    JDT_WEAK_MAP,
+    JDT_WEAK_SET,
+    JDT_GENERATOR,
     JDT_ARGUMENTS,
     JDT_OBJ_X,
 
@@ -275,19 +309,39 @@ enum JsPropertyFlag {
 
 using JsPropertyFlags = uint8_t;
 
+/**
+ * double 内联存储在 JsValue 中，不需要在 VMRuntime::_doubleValues 中分配.
+ *
+ * JsValue 一共 128 位: 前 64 位为 propFlags, type 等，后 64 位为完整的 IEEE 754 double,
+ * 所以任意的 double (包括 NaN, Infinity) 都可以内联.
+ * _doubleValues 中只有公共的 double 常量，资源池中的 double 常量存储在 ResourcePool 中.
+ */
 struct JsValue {
-    // 在 Object property 中的属性定义，仅仅在 Object 中有效
-    JsPropertyFlags             propFlags;
+    union {
+        struct {
+            // 在 Object property 中的属性定义，仅仅在 Object 中有效
+            JsPropertyFlags     propFlags;
+
+            JsDataType          type;
+            bool                isInResourcePool;
+            // 为 true 表示 double 内联存储在 number 中
+            bool                isInlineDouble;
+            union {
+                int32_t         n32;
+                uint32_t        index;
+            } value;
+        };
+
+        uint64_t                bits;
+    };
 
-    JsDataType                  type;
-    bool                        isInResourcePool;
     union {
-        int32_t                 n32;
-        uint32_t                index;
-    } value;
+        double                  number;
+        uint64_t                numberBits;
+    };
 
-    JsValue() { *(uint64_t *)this = 0; }
-    JsValue(JsDataType type, uint32_t objIdx) { *(uint64_t *)this = 0; this->type = type; value.index = objIdx; }
+    JsValue() { bits = 0; numberBits = 0; }
+    JsValue(JsDataType type, uint32_t objIdx) { bits = ((uint64_t)objIdx << 32) | ((uint64_t)type << 8); numberBits = 0; }
 
     inline bool isEmpty() const { return propFlags & JP_EMPTY; }
     inline bool isConfigurable() const { return propFlags & JP_CONFIGURABLE; }
@@ -299,10 +353,11 @@ struct JsValue {
     inline bool isNumber() const { return type == JDT_INT32 || type == JDT_NUMBER; }
     inline bool isGetterSetter() const { return type == JDT_GETTER_SETTER; }
     inline bool isFunction() const { return type >= JDT_FUNCTION; }
-    inline bool equal(const JsValue &other) const { return *(uint64_t *)this == *(uint64_t *)&other; }
+    inline bool equal(const JsValue &other) const { return bits == other.bits && numberBits == other.numberBits; }
 
+    // 不比较 propFlags
     inline bool equalValue(const JsValue &other) const {
-        return type == other.type && value.n32 == other.value.n32 && isInResourcePool == other.isInResourcePool;
+        return ((bits ^ other.bits) & ~(uint64_t)0xFF) == 0 && numberBits == other.numberBits;
     }
 
     inline void changeProperty(JsPropertyFlags toAdd, JsPropertyFlags toRemove) {
@@ -317,7 +372,7 @@ struct JsValue {
 
     inline void setValue(const JsValue &other) {
         auto flags = propFlags;
-        *(uint64_t *)this = *(uint64_t *)&other;
+        *this = other;
         propFlags = flags & ~JP_EMPTY;
     }
 
@@ -334,8 +389,17 @@ struct JsValue {
     }
 };
 
+static_assert(sizeof(JsValue) == 16, "JsValue should be 16 bytes");
+
 inline bool operator==(const JsValue &a, const JsValue &b) {
-    return a.type == b.type && a.isInResourcePool == b.isInResourcePool && a.value.index == b.value.index;
+    return a.equalValue(b);
+}
+
+inline JsValue makeJsValueInlineDouble(double value) {
+    JsValue r(JDT_NUMBER, 0);
+    r.isInlineDouble = true;
+    r.number = value;
+    return r;
 }
 
 inline JsValue makeJsValueOfStringInResourcePool(uint16_t poolIndex, uint16_t index) {
@@ -350,14 +414,24 @@ inline JsValue makeJsValueOfNumberInResourcePool(uint16_t poolIndex, uint16_t in
     return r;
 }
 
+/**
+ * 分代 GC 中对象和 scope 所在的代
+ */
+enum GcGeneration : uint8_t {
+    GEN_YOUNG, // 上次 GC 之后新分配的
+    GEN_OLD, // 经过 GC 后仍然存活的
+    GEN_OLD_REMEMBERED, // 老年代，并且已经在 remembered set 中，minor GC 时会被扫描
+};
+
 /**
  * 存储 double 类型的值
  */
 struct JsDouble {
-    JsDouble() { referIdx = 0; nextFreeIdx = 0; value = 0; }
-    JsDouble(double v) { referIdx = 0; nextFreeIdx = 0; value = v; }
+    JsDouble() { referIdx = 0; isOld = false; nextFreeIdx = 0; value = 0; }
+    JsDouble(double v) { referIdx = 0; isOld = false; nextFreeIdx = 0; value = v; }
 
     int8_t                      referIdx; // 用于资源回收时所用
+    bool                        isOld; // 是否在老年代
     uint32_t                    nextFreeIdx; // 下一个空闲的索引位置
     double                      value;
 };
@@ -392,6 +466,7 @@ public:
 struct JsJoinedString {
     bool                        isStringIdxInResourcePool; // stringIdx 指向的是 ResourcePool?
     bool                        isNextStringIdxInResourcePool; // nextStringIdx 指向的是 ResourcePool?
+    uint16_t                    depth; // 连接的深度, 普通字符串的深度为 0
     uint32_t                    stringIdx;
     uint32_t                    nextStringIdx; // 下一个连接的字符串索引位置
     uint32_t                    len; // utf-8 的长度大小
@@ -402,10 +477,12 @@ struct JsJoinedString {
         isNextStringIdxInResourcePool = false;
         stringIdx = 0;
         nextStringIdx = 0;
+        depth = 0;
         len = 0;
+        lenUtf16 = 0;
     }
 
-    JsJoinedString(const JsValue &s1, const JsValue &s2, uint32_t lenUtf16) : lenUtf16(lenUtf16) {
+    JsJoinedString(const JsValue &s1, const JsValue &s2, uint32_t len, uint32_t lenUtf16, uint16_t depth) : depth(depth), len(len), lenUtf16(lenUtf16) {
         stringIdx = s1.value.index;
         isStringIdxInResourcePool = s1.isInResourcePool;
 
@@ -414,13 +491,42 @@ struct JsJoinedString {
     }
 };
 
+/**
+ * 多个字符串共享的 buffer, 数据紧跟在 JsStringBuffer 之后.
+ * 1. s += x: 共享此 buffer 的字符串都是从 data() 开始的前缀，只有长度等于 len 的字符串才能直接在尾部追加.
+ * 2. JSON.parse: 字符串作为切片依次保存在 buffer 中.
+ * 每个字符串的数据之前都有 4 个字节保存其相对于 data() - 4 的偏移，用于从字符串找到所在的 buffer.
+ */
+struct JsStringBuffer {
+    uint32_t                    refCount; // 引用此 buffer 的 JsString 数量
+    uint32_t                    capacity;
+    uint32_t                    len; // 已经使用的长度
+
+    uint8_t *data() { return (uint8_t *)(this + 1) + sizeof(uint32_t); }
+
+    // 在尾部开始一个新的切片，最多可以写入 capacity - len - 4 个字节，写入后调用 endSlice()
+    uint8_t *beginSlice() {
+        auto p = data() + len;
+        uint32_t offset = len + sizeof(uint32_t);
+        memcpy(p, &offset, sizeof(offset));
+        return p + sizeof(uint32_t);
+    }
+    void endSlice(const uint8_t *end) { len = (uint32_t)(end - data()); }
+
+    static JsStringBuffer *fromData(const char *data) {
+        uint32_t offset;
+        memcpy(&offset, data - sizeof(uint32_t), sizeof(offset));
+        return (JsStringBuffer *)(data - sizeof(uint32_t) - offset) - 1;
+    }
+};
+
 /**
  * 存储 string 类型的值
  */
 struct JsString {
-    JsString() { referIdx = 0; nextFreeIdx = 0; isJoinedString = false; }
-    JsString(const StringView &str) { referIdx = 0; nextFreeIdx = 0; isJoinedString = false; value.str.set(str); }
-    JsString(const JsJoinedString &joinedString) { referIdx = 0; nextFreeIdx = 0; isJoinedString = true; value.joinedString = joinedString; }
+    JsString() { referIdx = 0; nextFreeIdx = 0; isJoinedString = false; isOld = false; isInStringBuffer = false; }
+    JsString(const StringView &str) { referIdx = 0; nextFreeIdx = 0; isJoinedString = false; isOld = false; isInStringBuffer = false; value.str.set(str); }
+    JsString(const JsJoinedString &joinedString) { referIdx = 0; nextFreeIdx = 0; isJoinedString = true; isOld = false; isInStringBuffer = false; value.joinedString = joinedString; }
     JsString(const JsString &other) { *this = other; }
 
     uint32_t lenUtf16() const { return isJoinedString ? value.joinedString.lenUtf16 : value.str.size(); }
@@ -428,7 +534,8 @@ struct JsString {
     uint32_t                    nextFreeIdx; // 下一个空闲的索引位置
     int8_t                      referIdx; // 用于资源回收时所用
     bool                        isJoinedString;
-    uint8_t                     reserved[2];
+    bool                        isOld; // 是否在老年代
+    bool                        isInStringBuffer; // value.str 的数据在 JsStringBuffer 中
 
     union Value {
         Value() { }
@@ -525,6 +632,11 @@ const JsValue jsValueMinSafeInt = JsValue(JDT_NUMBER, JS_NUMBER_IDX_MIN_SAFE_INT
 const JsValue jsValueMinNumber = JsValue(JDT_NUMBER, JS_NUMBER_IDX_MIN_VALUE);
 const JsValue jsValueNegInf = JsValue(JDT_NUMBER, JS_NUMBER_IDX_NEGATIVE_INFINITY);
 
+// 内联的 NaN 可能有不同的 bits，不能直接和 jsValueNaN 比较
+inline bool isJsValueNaN(const JsValue &value) {
+    return value.isInlineDouble ? std::isnan(value.number) : value.equalValue(jsValueNaN);
+}
+
 const JsValue jsValueLength0Property = makeJsValueInt32(0).asProperty(JP_CONFIGURABLE);
 const JsValue jsValueLength1Property = makeJsValueInt32(1).asProperty(JP_CONFIGURABLE);
 const JsValue jsValuePropertyDefault = jsValueUndefined.asProperty(JP_DEFAULT);
@@ -533,6 +645,34 @@ const JsValue jsValuePropertyConfWritable = jsValueUndefined.asProperty(JP_CONFI
 const JsValue jsValuePropertyWritable = jsValueUndefined.asProperty(JP_WRITABLE);
 const JsValue jsValuePropertyPrototype = jsValueUndefined.asProperty(JP_WRITABLE | JP_EMPTY);
 
+class JsShape;
+
+/**
+ * 属性访问指令 (OP_PUSH_MEMBER_DOT, OP_ASSIGN_MEMBER_DOT 等) 的 inline cache.
+ * 记录了最近访问过的 JsObject 的 shape 和属性所在的 slot，命中时不需要再按照属性名查找.
+ */
+struct InlineCacheEntry {
+    JsShape                     *shape;
+
+    // 属性在 prototype 对象上时有效: 对象的 __proto__ 和 prototype 对象的 shape
+    JsShape                     *protoShape;
+    JsValue                     proto;
+
+    uint32_t                    slotIndex;
+};
+
+// 不使用 inline cache 的序号
+#define INLINE_CACHE_IDX_NONE   0xFFFF
+
+struct InlineCache {
+    enum { MAX_ENTRIES = 4 };
+
+    InlineCacheEntry            entries[MAX_ENTRIES];
+    // 已使用的 entries 数量，满了之后轮流替换
+    uint8_t                     count;
+    uint8_t                     nextReplace;
+};
+
 using VecJsValues = std::vector<JsValue>;
 using VecJsDoubles = std::vector<JsDouble>;
 using VecJsStrings = std::vector<JsString>;
@@ -545,4 +685,20 @@ using DequeJsValue = std::deque<JsValue>;
 
 bool decodeBytecode(uint8_t *bytecode, int lenBytecode, BinaryOutputStream &stream);
 
+// 窥孔优化：将常见的指令序列替换为融合指令，bytecode 的长度和跳转地址不变
+void optimizeByteCode(uint8_t *bytecode, int lenBytecode);
+
+// 查找 bytecode 中引用全局变量索引 (uint16) 的参数位置，全局变量的索引在不同的 VMRuntime 中可能不同
+void findGlobalVarOperands(uint8_t *bytecode, int lenBytecode, std::vector<uint8_t *> &operands);
+
+// 所有 opcode 及其参数定义的 hash，opcode 有变化时，之前序列化的 bytecode 不能再使用
+uint64_t opCodesFingerprint();
+
+#if VM_OPCODE_PAIR_STATS
+// 统计解释执行时相邻两条 opcode 出现的次数，用于选择需要融合的指令序列
+extern uint32_t opCodePairCounts[256][256];
+
+void dumpOpCodePairStats(BinaryOutputStream &stream, int countTop = 30);
+#endif
+
 #endif /* VirtualMachineTypes_hpp */
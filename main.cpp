@@ -70,13 +70,7 @@ int main(int argc, const char * argv[]) {
         printf("Got exception: %.*s\n", int(err.len), err.data);
     }
 
-    for (int i = 0; i < 3; i++) {
-        if (runtime->onRunTasks()) {
-            i = 0;
-        } else {
-            Sleep(1);
-        }
-    }
+    runtime->runUntilIdle();
 
 //    code = "g('y');";
 //    vm.eval(code, strlen(code), runtime->mainCtx(), stackScopes, args);
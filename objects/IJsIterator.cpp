@@ -27,6 +27,8 @@ public:
     }
 
     virtual bool nextOf(JsValue &valueOut) override {
+        // _it 的 _curValue 会被修改
+        _ctx->runtime->writeBarrier(_it);
         return _it->nextOf(valueOut);
     }
 
@@ -42,6 +44,13 @@ public:
         return _itObj->next(strKeyOut, keyOut, valueOut);
     }
 
+    virtual void markReferIdx(VMRuntime *rt) override {
+        IJsIterator::markReferIdx(rt);
+
+        // _it 可能只被当前的 iterator 引用 (比如 for (i of o.entries()))
+        ::markReferIdx(rt, _it);
+    }
+
 protected:
     VMContext                       *_ctx;
     IJsIterator                     *_it;
@@ -52,6 +61,7 @@ protected:
 
 
 void IJsIterator::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -65,6 +75,7 @@ void IJsIterator::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsVal
 }
 
 void IJsIterator::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -73,6 +84,7 @@ void IJsIterator::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsVa
 }
 
 JsError IJsIterator::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -86,6 +98,7 @@ JsError IJsIterator::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t in
 }
 
 JsError IJsIterator::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -93,6 +106,7 @@ JsError IJsIterator::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t i
 }
 
 JsValue IJsIterator::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -106,6 +120,7 @@ JsValue IJsIterator::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32
 }
 
 JsValue IJsIterator::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -15,6 +15,7 @@ IJsObject::IJsObject(JsValue proto, JsDataType type) : __proto__(proto), type(ty
     isPreventedExtensions = false;
     _isOfIterable = false;
     referIdx = 0;
+    gcGeneration = GEN_YOUNG;
     nextFreeIdx = 0;
 }
 
@@ -173,7 +174,8 @@ void IJsObject::set(VMContext *ctx, const JsValue &thiz, const JsValue &nameOrg,
             break;
         }
         case JDT_STRING: {
-            auto &strName = ctx->runtime->getUtf8String(name);
+            // 复制 StringView: setter/valueOf 中可能向 ResourcePool 添加字符串，导致其内存被重新分配
+            auto strName = ctx->runtime->getUtf8String(name);
             setByName(ctx, thiz, strName, value);
             break;
         }
@@ -214,7 +216,8 @@ JsValue IJsObject::increase(VMContext *ctx, const JsValue &thiz, const JsValue &
             return increaseByName(ctx, thiz, str.str(), n, isPost);
         }
         case JDT_STRING: {
-            auto &strName = ctx->runtime->getUtf8String(name);
+            // 复制 StringView，原因同 set()
+            auto strName = ctx->runtime->getUtf8String(name);
             return increaseByName(ctx, thiz, strName, n, isPost);
         }
         case JDT_SYMBOL:
@@ -282,76 +285,9 @@ void IJsObject::addGetterSetterByName(VMContext *ctx, const StringView &name, co
         auto gs = ctx->runtime->pushGetterSetter(getter, setter);
         setPropertyByName(ctx, name, gs.asProperty(JP_DEFAULT));
     } else {
+        ctx->runtime->writeBarrier(this);
         auto &gs = ctx->runtime->getGetterSetter(*prop);
         if (getter.isFunction()) gs.getter = getter;
         if (setter.isFunction()) gs.setter = setter;
     }
 }
-
-/**
- * 为了遍历 Object 的所有属性
- */
-class JsObjectIterator : public IJsIterator {
-public:
-    JsObjectIterator(VMContext *ctx, JsObject *obj, bool includeProtoProp, bool includeNoneEnumerable) : IJsIterator(includeProtoProp, includeNoneEnumerable)
-    {
-        _ctx = ctx;
-        _obj = obj;
-        _it = obj->_props.begin();
-        _itProto = nullptr;
-        _includeProtoProp = includeProtoProp;
-    }
-
-    virtual bool next(StringView *strKeyOut = nullptr, JsValue *keyOut = nullptr, JsValue *valueOut = nullptr) override {
-        if (_itProto) {
-            return _itProto->next(strKeyOut, keyOut, valueOut);
-        }
-
-        while (true) {
-            if (_it == _obj->_props.end()) {
-                if (_includeProtoProp) {
-                    if (_itProto == nullptr) {
-                        auto objProto = _obj->getPrototypeObject(_ctx);
-                        if (objProto) {
-                            _itProto = objProto->getIteratorObject(_ctx, true);
-                        } else {
-                            return false;
-                        }
-                    }
-                    return _itProto->next(strKeyOut, keyOut, valueOut);
-                }
-                return false;
-            }
-
-            auto &prop = (*_it).second;
-            if (prop.isEnumerable() || _includeNoneEnumerable) {
-                break;
-            }
-            _it++;
-        }
-
-        if (strKeyOut) {
-            *strKeyOut = (*_it).first;
-        }
-
-        if (keyOut) {
-            *keyOut = _ctx->runtime->pushString((*_it).first);
-        }
-
-        if (valueOut) {
-            *valueOut = getPropertyValue(_ctx, _obj->self, (*_it).second);
-        }
-
-        _it++;
-
-        return true;
-    }
-
-protected:
-    VMContext                       *_ctx;
-    JsObject                        *_obj;
-    MapNameToJsProperty::iterator   _it;
-    IJsIterator                     *_itProto;
-    bool                            _includeProtoProp;
-
-};
@@ -80,6 +80,7 @@ public:
     JsValue increase(VMContext *ctx, const JsValue &thiz, const JsValue &name, int n, bool isPost);
     bool remove(VMContext *ctx, const JsValue &name);
 
+    // 修改属性的接口，实现中需要调用 ctx->runtime->writeBarrier(this)
     virtual void setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) = 0;
     virtual void setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue &descriptor) = 0;
     virtual void setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) = 0;
@@ -200,7 +201,7 @@ public:
         if ((int32_t)d == d) {
             v = makeJsValueInt32((int32_t)d);
         } else {
-            v = JsValue(JDT_NUMBER, d);
+            v = ctx->runtime->pushDouble(d);
         }
 
         d += x;
@@ -208,7 +209,7 @@ public:
         if (n == d) {
             return makeJsValueInt32(n);
         }
-        return JsValue(JDT_NUMBER, d);
+        return ctx->runtime->pushDouble(d);
     }
 
     static JsValue increasePropertyValue(VMContext *ctx, JsValue *prop, const JsValue &thiz, int n, bool isPost) {
@@ -246,6 +247,7 @@ public:
     bool                        _isOfIterable;
 
     int8_t                      referIdx;
+    GcGeneration                gcGeneration;
     uint32_t                    nextFreeIdx;
 
     JsValue                     __proto__;
@@ -256,10 +258,21 @@ public:
 };
 
 inline void markReferIdx(VMRuntime *rt, IJsObject *obj) {
-    if (obj->referIdx != rt->nextReferIdx()) {
-        obj->referIdx = rt->nextReferIdx();
-        obj->markReferIdx(rt);
+    rt->markReferIdx(obj);
+}
+
+inline IJsObject *VMRuntime::getObject(const JsValue &val) {
+    assert(val.type >= JDT_OBJECT);
+    assert(!val.isInResourcePool);
+    return _objValues[val.value.index];
+}
+
+inline void VMRuntime::writeBarrier(IJsObject *obj) {
+#if VM_GENERATIONAL_GC
+    if (obj->gcGeneration == GEN_OLD) {
+        rememberObject(obj);
     }
+#endif
 }
 
 #endif /* IJsObject_hpp */
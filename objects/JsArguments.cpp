@@ -96,6 +96,7 @@ JsArguments::~JsArguments() {
 }
 
 void JsArguments::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (name.len > 0 && isDigit(name.data[0])) {
         bool successful = false;
         auto n = name.atoi(successful);
@@ -118,6 +119,7 @@ void JsArguments::setPropertyByName(VMContext *ctx, const StringView &name, cons
 }
 
 void JsArguments::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (index >= _args->count) {
         NumberToStringView ss(index);
         setPropertyByName(ctx, ss, descriptor);
@@ -138,6 +140,7 @@ void JsArguments::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsVal
 }
 
 void JsArguments::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -146,6 +149,7 @@ void JsArguments::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsVa
 }
 
 JsError JsArguments::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (name.len > 0 && isDigit(name.data[0])) {
         bool successful = false;
         auto n = name.atoi(successful);
@@ -165,6 +169,7 @@ JsError JsArguments::setByName(VMContext *ctx, const JsValue &thiz, const String
 }
 
 JsError JsArguments::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (index >= _args->count) {
         NumberToStringView name(index);
         return setByName(ctx, thiz, name, value);
@@ -185,6 +190,7 @@ JsError JsArguments::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t in
 }
 
 JsError JsArguments::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -192,6 +198,7 @@ JsError JsArguments::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t i
 }
 
 JsValue JsArguments::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (name.len > 0 && isDigit(name.data[0])) {
         bool successful = false;
         auto index = name.atoi(successful);
@@ -211,6 +218,7 @@ JsValue JsArguments::increaseByName(VMContext *ctx, const JsValue &thiz, const S
 }
 
 JsValue JsArguments::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (index >= _args->count) {
         NumberToStringView name(index);
         return increaseByName(ctx, thiz, name, n, isPost);
@@ -231,6 +239,7 @@ JsValue JsArguments::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32
 }
 
 JsValue JsArguments::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -273,7 +282,7 @@ JsValue *JsArguments::getRawByIndex(VMContext *ctx, uint32_t index, bool include
     }
 
     // 获取值
-    static JsValue prop;
+    static thread_local JsValue prop;
     prop = _args->data[index].asProperty();
     return &prop;
 }
@@ -7,11 +7,13 @@
 
 #include "JsArray.hpp"
 #include "interpreter/BinaryOperation.hpp"
+#include "interpreter/ArraySort.hpp"
 
 
 const uint32_t ARRAY_BLOCK_SIZE = 1024 * 32; // 32768
 const uint32_t ARRAY_RESERVE_MAX_SIZE = ARRAY_BLOCK_SIZE * 10; // 327680 个
 const uint32_t ARRAY_MAX_INDEX = 4294967294; // 2 ** 32 - 2
+const uint32_t ARRAY_PACKED_SHIFT_MAX_SIZE = 1024; // 超过此长度的 packed 数组 shift 时转换为 block 存储
 
 const JsValue jsPropertyNotInitialized = jsValueEmpty.asProperty(JP_CONFIGURABLE | JP_WRITABLE | JP_EMPTY);
 
@@ -22,7 +24,7 @@ public:
     }
 
     bool operator()(const JsArray::Block *other, uint32_t index) const {
-        return index > other->index + (uint32_t)other->items.size();
+        return index >= other->index + (uint32_t)other->items.size();
     }
 
 };
@@ -35,6 +37,37 @@ inline uint32_t roundIndexToBlock(uint32_t index) {
     return index;
 }
 
+/**
+ * 按照存储的顺序遍历已经分配的元素 (packed 的元素或者各个 block 中的元素)，不包括 block 之间的空洞
+ */
+class JsArrayItemsCursor {
+public:
+    JsArrayItemsCursor(JsArray *arr) : _arr(arr), _block(0), _pos(0) { }
+
+    JsValue *next() {
+        if (_arr->_elementsKind != AEK_HOLEY) {
+            return _pos < _arr->_packedItems.size() ? &_arr->_packedItems[_pos++] : nullptr;
+        }
+
+        while (_block < _arr->_blocks.size()) {
+            auto &items = _arr->_blocks[_block]->items;
+            if (_pos < items.size()) {
+                return &items[_pos++];
+            }
+            _block++;
+            _pos = 0;
+        }
+
+        return nullptr;
+    }
+
+protected:
+    JsArray                         *_arr;
+    uint32_t                        _block;
+    uint32_t                        _pos;
+
+};
+
 /**
  * 遍历 Array
  */
@@ -140,18 +173,20 @@ protected:
 
 JsArray::JsArray(uint32_t length) : IJsObject(jsValuePrototypeArray, JDT_ARRAY) {
     _isOfIterable = true;
+    _obj = nullptr;
 
     if (length > 0) {
+        // 指定了长度的数组，元素都是空洞
+        _elementsKind = AEK_HOLEY;
         reserveSize(length);
+        _firstBlock = _blocks.front();
+        _firstBlockItems = &_firstBlock->items;
     } else {
-        auto block = new Block();
-        _blocks.push_back(block);
+        _elementsKind = AEK_PACKED_INT32;
         _length = 0;
+        _firstBlock = nullptr;
+        _firstBlockItems = nullptr;
     }
-
-    _firstBlock = _blocks.front();
-    _firstBlockItems = &_firstBlock->items;
-    _obj = nullptr;
 }
 
 JsArray::~JsArray() {
@@ -166,6 +201,7 @@ JsArray::~JsArray() {
 }
 
 void JsArray::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (name.len > 0 && isDigit(name.data[0])) {
         bool successful = false;
         auto n = name.atoi(successful);
@@ -187,10 +223,13 @@ void JsArray::setPropertyByName(VMContext *ctx, const StringView &name, const Js
 }
 
 void JsArray::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (isPreventedExtensions && index >= _length) {
         return;
     }
 
+    convertToHoley();
+
     auto block = findToModifyBlock(index);
     index -= block->index;
     assert(index < block->items.size());
@@ -199,6 +238,7 @@ void JsArray::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue &
 }
 
 void JsArray::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -207,6 +247,7 @@ void JsArray::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue
 }
 
 JsError JsArray::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (name.len > 0 && isDigit(name.data[0])) {
         bool successful = false;
         auto n = name.atoi(successful);
@@ -235,10 +276,27 @@ JsError JsArray::setByName(VMContext *ctx, const JsValue &thiz, const StringView
 }
 
 JsError JsArray::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (isPreventedExtensions && index >= _length) {
         return JE_TYPE_PREVENTED_EXTENSION;
     }
 
+    if (_elementsKind != AEK_HOLEY) {
+        if (index < _length) {
+            _packedItems[index] = value.asProperty();
+            updateElementsKind(value);
+            return JE_OK;
+        } else if (index == _length) {
+            _packedItems.push_back(value.asProperty());
+            _length++;
+            updateElementsKind(value);
+            return JE_OK;
+        }
+
+        // 出现了空洞
+        convertToHoley();
+    }
+
     Block *block = nullptr;
     if (index < ARRAY_BLOCK_SIZE) {
         // 大多数情况都是在第一块内
@@ -266,6 +324,7 @@ JsError JsArray::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index,
 }
 
 JsError JsArray::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -273,6 +332,7 @@ JsError JsArray::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index
 }
 
 JsValue JsArray::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (name.len > 0 && isDigit(name.data[0])) {
         bool successful = false;
         auto index = name.atoi(successful);
@@ -294,10 +354,22 @@ JsValue JsArray::increaseByName(VMContext *ctx, const JsValue &thiz, const Strin
 }
 
 JsValue JsArray::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (isPreventedExtensions && index >= _length) {
         return jsValueNaN;
     }
 
+    if (_elementsKind != AEK_HOLEY) {
+        if (index < _length) {
+            auto &prop = _packedItems[index];
+            auto ret = increasePropertyValue(ctx, &prop, thiz, n, isPost);
+            updateElementsKind(prop);
+            return ret;
+        }
+
+        convertToHoley();
+    }
+
     Block *block = nullptr;
     if (index < ARRAY_BLOCK_SIZE) {
         // 大多数情况都是在第一块内
@@ -325,6 +397,7 @@ JsValue JsArray::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t i
 }
 
 JsValue JsArray::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -341,7 +414,7 @@ JsValue *JsArray::getRawByName(VMContext *ctx, const StringView &name, bool incl
     }
 
     if (name.equal(SS_LENGTH)) {
-        static JsValue prop;
+        static thread_local JsValue prop;
         prop = makeJsValueInt32(_length).asProperty(JP_WRITABLE);
         return &prop;
     }
@@ -361,6 +434,10 @@ JsValue *JsArray::getRawByName(VMContext *ctx, const StringView &name, bool incl
 }
 
 JsValue *JsArray::getRawByIndex(VMContext *ctx, uint32_t index, bool includeProtoProp) {
+    if (_elementsKind != AEK_HOLEY) {
+        return index < _length ? &_packedItems[index] : nullptr;
+    }
+
     Block *block;
     if (index < ARRAY_BLOCK_SIZE) {
         // 大多数情况都是在第一块内
@@ -399,6 +476,11 @@ bool JsArray::removeByName(VMContext *ctx, const StringView &name) {
 }
 
 bool JsArray::removeByIndex(VMContext *ctx, uint32_t index) {
+    if (_elementsKind != AEK_HOLEY && index < _length) {
+        // 删除后会出现空洞
+        convertToHoley();
+    }
+
     auto block = findBlock(index);
     if (!block) {
         if (_obj) {
@@ -429,6 +511,9 @@ bool JsArray::removeBySymbol(VMContext *ctx, uint32_t index) {
 }
 
 void JsArray::changeAllProperties(VMContext *ctx, JsPropertyFlags toAdd, JsPropertyFlags toRemove) {
+    // packed 的元素属性只能是 JP_DEFAULT
+    convertToHoley();
+
     for (auto block : _blocks) {
         for (auto &item : block->items) {
             item.changeProperty(toAdd, toRemove);
@@ -441,6 +526,11 @@ void JsArray::changeAllProperties(VMContext *ctx, JsPropertyFlags toAdd, JsPrope
 }
 
 bool JsArray::hasAnyProperty(VMContext *ctx, JsPropertyFlags flags) {
+    if (!_packedItems.empty() && _packedItems.front().isPropertyAny(flags)) {
+        // packed 的元素属性都相同
+        return true;
+    }
+
     for (auto block : _blocks) {
         for (auto &item : block->items) {
             if (item.isPropertyAny(flags)) {
@@ -461,9 +551,15 @@ void JsArray::preventExtensions(VMContext *ctx) {
 }
 
 IJsObject *JsArray::clone() {
-    assert(0 && "NOT supported.");
+    auto obj = cloneArrayOnly();
 
-    return nullptr;
+    obj->__proto__ = __proto__;
+    obj->isPreventedExtensions = isPreventedExtensions;
+    if (_obj) {
+        obj->_obj = (JsObject *)_obj->clone();
+    }
+
+    return obj;
 }
 
 IJsIterator *JsArray::getIteratorObject(VMContext *ctx, bool includeProtoProp, bool includeNoneEnumerable) {
@@ -473,12 +569,21 @@ IJsIterator *JsArray::getIteratorObject(VMContext *ctx, bool includeProtoProp, b
 void JsArray::markReferIdx(VMRuntime *rt) {
     assert(referIdx == rt->nextReferIdx());
 
+    if (_elementsKind == AEK_PACKED_GENERIC) {
+        for (auto &prop : _packedItems) {
+            rt->markReferIdx(prop);
+        }
+    }
+    // AEK_PACKED_INT32 和 AEK_PACKED_DOUBLE 的元素都没有引用其他的值
+
     for (auto block : _blocks) {
         for (auto &prop : block->items) {
             rt->markReferIdx(prop);
         }
     }
 
+    rt->markReferIdx(__proto__);
+
     if (_obj) {
         _obj->referIdx = rt->nextReferIdx();
         _obj->markReferIdx(rt);
@@ -538,6 +643,18 @@ std::tuple<JsValue, JsError, int> JsArray::popFront(VMContext *ctx) {
         return { jsValueUndefined, JE_OK, 0 };
     }
 
+    if (_elementsKind != AEK_HOLEY) {
+        if (_length <= ARRAY_PACKED_SHIFT_MAX_SIZE) {
+            auto retValue = _packedItems.front().asValue();
+            _packedItems.erase(_packedItems.begin());
+            _length--;
+            return { retValue, JE_OK, 0 };
+        }
+
+        // 较长的数组使用 block 存储，deque 可以直接删除第一个元素
+        convertToHoley();
+    }
+
     auto retValue = front(ctx, _firstBlock);
     if (retValue.isEmpty()) {
         retValue = jsValueUndefined;
@@ -573,33 +690,34 @@ void JsArray::sort(VMContext *ctx, const JsValue &callback) {
     VecJsValues values;
     int countEmpty = 0, countUndefined = 0;
 
-    for (auto b : _blocks) {
-        for (auto &item : b->items) {
-            auto v = getPropertyValue(ctx, self, item, jsValueEmpty);
-            if (v.isEmpty()) {
-                countEmpty++;
-            } else if (v.type == JDT_UNDEFINED) {
-                countUndefined++;
-            } else {
-                values.push_back(v);
-            }
+    JsArrayItemsCursor cursor(this);
+    JsValue *item;
+    while ((item = cursor.next())) {
+        auto v = getPropertyValue(ctx, self, item, jsValueEmpty);
+        if (v.isEmpty()) {
+            countEmpty++;
+        } else if (v.type == JDT_UNDEFINED) {
+            countUndefined++;
+        } else {
+            values.push_back(v);
         }
     }
 
-    auto vm = ctx->vm;
+    sortJsValues(ctx, values, callback);
 
-    if (callback.isFunction()) {
-        stable_sort(values.begin(), values.end(), [vm, ctx, callback](const JsValue &a, const JsValue &b) {
-            ArgumentsX args(a, b);
-            vm->callMember(ctx, jsValueGlobalThis, callback, args);
-            return ctx->error == JE_OK && ctx->runtime->testTrue(ctx->retValue);
-        });
-    } else {
-        stable_sort(values.begin(), values.end(), [vm, ctx, callback](const JsValue &a, const JsValue &b) {
-            return ctx->error == JE_OK && convertToStringLessCmp(ctx, a, b);
-        });
+    if (_elementsKind != AEK_HOLEY && values.size() + countUndefined == _length) {
+        // packed 的数组没有空洞和属性描述，直接写回
+        assert(countEmpty == 0);
+        for (uint32_t i = 0; i < values.size(); i++) {
+            _packedItems[i] = values[i].asProperty();
+        }
+        std::fill(_packedItems.begin() + values.size(), _packedItems.end(), jsValueUndefined.asProperty());
+        return;
     }
 
+    // 比较函数修改了数组
+    convertToHoley();
+
     // 排好序的属性
     int i = 0;
     while (i < (int)values.size() && ctx->error == JE_OK) {
@@ -686,6 +804,7 @@ void JsArray::sort(VMContext *ctx, const JsValue &callback) {
 }
 
 void JsArray::pushEmpty() {
+    convertToHoley();
     findToModifyBlock(_length);
 }
 
@@ -694,35 +813,69 @@ JsError JsArray::push(VMContext *ctx, const JsValue &value) {
 }
 
 JsError JsArray::push(VMContext *ctx, const JsValue *first, uint32_t count) {
+    ctx->runtime->writeBarrier(this);
     if (isPreventedExtensions) {
         return JE_TYPE_PREVENTED_EXTENSION;
     }
 
+    if (_elementsKind != AEK_HOLEY) {
+        if (_packedItems.capacity() < _packedItems.size() + count) {
+            // 按倍数扩展: 每次精确 reserve 会破坏 vector 的倍增，导致逐个 push 为 O(n^2)
+            _packedItems.reserve(std::max(_packedItems.size() + count, _packedItems.capacity() * 2));
+        }
+        for (; count > 0; first++, count--) {
+            if (first->isEmpty()) {
+                // 空洞
+                convertToHoley();
+                break;
+            }
+            _packedItems.push_back(first->asProperty());
+            updateElementsKind(*first);
+            _length++;
+        }
+    }
+
     while (count > 0) {
-        auto b = findToModifyBlock(_length); // 这里会将 _length + 1
-        uint32_t bound = roundIndexToBlock(b->index + ARRAY_BLOCK_SIZE);
+        uint32_t index = _length;
+        auto b = findToModifyBlock(index); // 这里会将 _length 修改为 index + 1
+        auto &items = b->items;
 
-        uint32_t n = _length + count;
-        n = n < bound ? count : bound - b->index;
+        // 在此 block 中能添加的个数
+        uint32_t n = roundIndexToBlock(b->index + ARRAY_BLOCK_SIZE) - index;
+        if (n > count) {
+            n = count;
+        }
 
-        _firstBlock->items[_length - 1 - b->index] = first[0].asProperty(); // 第一个元素直接修改
-        for (int i = 1; i < n; i++) {
-            _firstBlock->items.push_back(first[i].asProperty());
+        for (uint32_t i = 0; i < n; i++) {
+            auto pos = index - b->index + i;
+            auto prop = first[i].isEmpty() ? jsPropertyNotInitialized : first[i].asProperty();
+            if (pos < items.size()) {
+                items[pos] = prop;
+            } else {
+                items.push_back(prop);
+            }
         }
 
         first += n;
         count -= n;
-        _length += n - 1;
+        _length = index + n;
     }
 
     return JE_OK;
 }
 
 JsError JsArray::extend(VMContext *ctx, const JsArray *other) {
+    ctx->runtime->writeBarrier(this);
     if (isPreventedExtensions) {
         return JE_TYPE_PREVENTED_EXTENSION;
     }
 
+    if (other->_elementsKind != AEK_HOLEY) {
+        // packed 的元素都是值，可以直接添加
+        auto &items = other->_packedItems;
+        return push(ctx, items.data(), (uint32_t)items.size());
+    }
+
     for (auto b : other->_blocks) {
         VecJsValues values;
         values.reserve(b->items.size());
@@ -738,6 +891,7 @@ JsError JsArray::extend(VMContext *ctx, const JsArray *other) {
 }
 
 JsError JsArray::extend(VMContext *ctx, const JsValue &other, uint32_t depth) {
+    ctx->runtime->writeBarrier(this);
     if (isPreventedExtensions) {
         return JE_TYPE_PREVENTED_EXTENSION;
     }
@@ -748,72 +902,40 @@ JsError JsArray::extend(VMContext *ctx, const JsValue &other, uint32_t depth) {
 
     // 采用栈来保存递归调用，避免堆栈溢出
     struct Status {
-        VecBlocks::iterator         itBlock, itBlockEnd;
-        DequeJsProperties::iterator itItems, itItemsEnd;
+        JsArrayItemsCursor          cursor;
+        uint32_t                    depth; // 此数组中的元素还可以展开的深度
     };
     std::vector<Status> stack;
+    stack.push_back({JsArrayItemsCursor((JsArray *)ctx->runtime->getObject(other)), depth});
 
-    auto otherArr = (JsArray *)ctx->runtime->getObject(other);
-
-    VecBlocks::iterator itBlock = otherArr->_blocks.begin(), itBlockEnd = otherArr->_blocks.end();
-    DequeJsProperties::iterator itItems, itItemsEnd;
-    if (itBlock != itBlockEnd) {
-        itItems = (*itBlock)->items.begin();
-        itItemsEnd = (*itBlock)->items.end();
-    }
-
-    while (1) {
-        while (1) {
-            while (itItems != itItemsEnd) {
-                auto &prop = *itItems;
-                itItems++;
-
-                JsValue value = getPropertyValue(ctx, self, prop, jsValueUndefined);
+    while (!stack.empty()) {
+        auto prop = stack.back().cursor.next();
+        if (prop == nullptr) {
+            stack.pop_back();
+            continue;
+        }
 
-                if (depth > 0 && value.type == JDT_ARRAY) {
-                    depth--;
-                    stack.push_back({itBlock, itBlockEnd, itItems, itItemsEnd});
+        JsValue value = getPropertyValue(ctx, self, prop, jsValueUndefined);
 
-                    auto otherArr = (JsArray *)ctx->runtime->getObject(value);
-                    if (!otherArr->_blocks.empty()) {
-                        itBlock = otherArr->_blocks.begin(); itBlockEnd = otherArr->_blocks.end();
-                        itItems = (*itBlock)->items.begin(); itItemsEnd = (*itBlock)->items.end();
-                    }
-                } else {
-                    values.push_back(value);
-                    if (values.size() > 0x1000000) {
-                        ctx->throwException(JE_RANGE_ERROR, "Maximum call stack size exceeded");
-                        return JE_MAX_STACK_EXCEEDED;
-                    }
-                }
-            }
-
-            itBlock++;
-            if (itBlock == itBlockEnd) {
-                break;
+        depth = stack.back().depth;
+        if (depth > 0 && value.type == JDT_ARRAY) {
+            stack.push_back({JsArrayItemsCursor((JsArray *)ctx->runtime->getObject(value)), depth - 1});
+        } else {
+            values.push_back(value);
+            if (values.size() > 0x1000000) {
+                ctx->throwException(JE_RANGE_ERROR, "Maximum call stack size exceeded");
+                return JE_MAX_STACK_EXCEEDED;
             }
-
-            itItems = (*itBlock)->items.begin();
-            itItemsEnd = (*itBlock)->items.end();
         }
-
-        if (stack.empty()) {
-            break;
-        }
-
-        auto &status = stack.back();
-        itBlock = status.itBlock;
-        itBlockEnd = status.itBlockEnd;
-        itItems = status.itItems;
-        itItemsEnd = status.itItemsEnd;
-        stack.pop_back();
     }
 
     return push(ctx, values.data(), (uint32_t)values.size());
 }
 
 void JsArray::reverse(VMContext *ctx) {
-    if (_length < ARRAY_BLOCK_SIZE)  {
+    if (_elementsKind != AEK_HOLEY) {
+        std::reverse(_packedItems.begin(), _packedItems.end());
+    } else if (_length < ARRAY_BLOCK_SIZE)  {
         // 都在第一个 block 内
         auto &items = *_firstBlockItems;
         int32_t high = (int32_t)items.size();
@@ -852,7 +974,8 @@ void JsArray::reverse(VMContext *ctx) {
     }
 }
 
-static std::set<uint32_t> toStringCallStack;
+// 避免循环引用的数组无限递归. 每个线程有独立的 VMRuntime
+static thread_local std::set<uint32_t> toStringCallStack;
 
 void JsArray::toString(VMContext *ctx, const JsValue &thiz, BinaryOutputStream &stream) {
     uint32_t lastIdx = 0;
@@ -864,6 +987,25 @@ void JsArray::toString(VMContext *ctx, const JsValue &thiz, BinaryOutputStream &
     }
     toStringCallStack.insert(thiz.value.index);
 
+    if (_elementsKind != AEK_HOLEY) {
+        for (uint32_t i = 0; i < _packedItems.size(); i++) {
+            auto v = _packedItems[i].asValue();
+
+            LockedStringViewWrapper s;
+            if (v.type == JDT_ARRAY) {
+                auto arr = (JsArray *)ctx->runtime->getObject(v);
+                arr->toString(ctx, v, stream);
+            } else {
+                s = ctx->runtime->toStringView(ctx, v);
+            }
+
+            if (i > 0) {
+                stream.writeUInt8(',');
+            }
+            stream.write(s.data, s.len);
+        }
+    }
+
     for (auto b : _blocks) {
         for (auto i = lastIdx; i < b->index; i++) {
             if (empty) {
@@ -897,9 +1039,23 @@ void JsArray::toString(VMContext *ctx, const JsValue &thiz, BinaryOutputStream &
 }
 
 void JsArray::setLength(uint32_t length) {
+    if (_elementsKind != AEK_HOLEY) {
+        if (length <= _length) {
+            _packedItems.resize(length);
+            _length = length;
+            return;
+        }
+
+        // 扩大后会有空洞
+        convertToHoley();
+    }
+
     if (length > _length) {
         // 扩大 length
         _length = length;
+    } else if (length == 0) {
+        // 清空之后可以重新使用 packed 存储
+        resetToPacked();
     } else if (length < _length) {
         // 缩小 length
         _length = length;
@@ -908,11 +1064,12 @@ void JsArray::setLength(uint32_t length) {
         if (it != _blocks.end()) {
             // 分配了空间，先删除 length 所在 block 的
             auto block = *it;
-            length -= block->index;
-            block->items.resize(length);
+            if (length > block->index) {
+                block->items.resize(length - block->index);
+                ++it;
+            }
 
             // 删除剩下的 block
-            ++it;
             auto itStart = it;
             for (; it != _blocks.end(); ++it) {
                 auto block = *it;
@@ -927,6 +1084,13 @@ JsArray *JsArray::cloneArrayOnly() {
     auto other = new JsArray();
     other->_length = _length;
 
+    if (_elementsKind != AEK_HOLEY) {
+        other->_elementsKind = _elementsKind;
+        other->_packedItems = _packedItems;
+        return other;
+    }
+
+    other->convertToHoley();
     for (auto b : _blocks) {
         Block *t;
         if (b == _firstBlock) {
@@ -937,6 +1101,7 @@ JsArray *JsArray::cloneArrayOnly() {
         }
 
         t->index = b->index;
+        t->hasPropDescriptor = b->hasPropDescriptor;
         t->items = b->items;
     }
 
@@ -944,6 +1109,14 @@ JsArray *JsArray::cloneArrayOnly() {
 }
 
 void JsArray::dump(VMContext *ctx, const JsValue &thiz, VecJsValues &values) {
+    if (_elementsKind != AEK_HOLEY) {
+        values.resize(_length);
+        for (uint32_t i = 0; i < _length; i++) {
+            values[i] = _packedItems[i].asValue();
+        }
+        return;
+    }
+
     for (auto b : _blocks) {
         values.resize(b->index + b->items.size(), jsValueUndefined);
 
@@ -965,6 +1138,10 @@ void JsArray::_newObject(VMContext *ctx) {
 }
 
 JsArray::Block *JsArray::findBlock(uint32_t index) {
+    if (_elementsKind != AEK_HOLEY) {
+        return nullptr;
+    }
+
     auto it = lower_bound(_blocks.begin(), _blocks.end(), index, BlockLessCompare());
     if (it != _blocks.end()) {
         auto block = *it;
@@ -977,6 +1154,8 @@ JsArray::Block *JsArray::findBlock(uint32_t index) {
 }
 
 JsArray::Block *JsArray::findToModifyBlock(uint32_t index) {
+    assert(_elementsKind == AEK_HOLEY);
+
     if (index < ARRAY_BLOCK_SIZE) {
         // 在第一个 block 内
         if (index >= _firstBlockItems->size()) {
@@ -1076,7 +1255,7 @@ void JsArray::reserveSize(uint32_t length) {
 
     assert(_blocks.empty());
 
-    auto index = 0;
+    uint32_t index = 0;
     while (index < length) {
         auto size = min(ARRAY_BLOCK_SIZE, length - index);
 
@@ -1086,8 +1265,49 @@ void JsArray::reserveSize(uint32_t length) {
         b->items.resize(size, jsPropertyNotInitialized);
 
         index += size;
-        length -= size;
     }
 
     _length = length;
 }
+
+/**
+ * 转换为 block 存储，之后不会再自动转换回 packed.
+ */
+void JsArray::convertToHoley() {
+    if (_elementsKind == AEK_HOLEY) {
+        return;
+    }
+
+    assert(_blocks.empty());
+    assert(_packedItems.size() == _length);
+
+    uint32_t index = 0;
+    do {
+        auto size = min(ARRAY_BLOCK_SIZE, _length - index);
+
+        auto b = new Block();
+        _blocks.push_back(b);
+        b->index = index;
+        b->items.assign(_packedItems.begin() + index, _packedItems.begin() + index + size);
+
+        index += size;
+    } while (index < _length);
+
+    _firstBlock = _blocks.front();
+    _firstBlockItems = &_firstBlock->items;
+
+    _elementsKind = AEK_HOLEY;
+    VecJsValues().swap(_packedItems);
+}
+
+void JsArray::resetToPacked() {
+    for (auto b : _blocks) {
+        delete b;
+    }
+    _blocks.clear();
+
+    _firstBlock = nullptr;
+    _firstBlockItems = nullptr;
+    _elementsKind = AEK_PACKED_INT32;
+    _length = 0;
+}
@@ -11,8 +11,30 @@
 #include "JsObject.hpp"
 
 
+/**
+ * 数组元素的存储类型，只能按照从上到下的顺序转换 (清空数组后重新从 AEK_PACKED_INT32 开始).
+ * packed 类型的元素连续存储在 _packedItems 中，没有空洞，属性都是 JP_DEFAULT.
+ */
+enum ArrayElementsKind : uint8_t {
+    AEK_PACKED_INT32,           // 元素都是 JDT_INT32
+    AEK_PACKED_DOUBLE,          // 元素都是 JDT_INT32 或者内联的 double
+    AEK_PACKED_GENERIC,         // 任意的值
+    AEK_HOLEY,                  // 有空洞、属性描述或者是稀疏的数组，使用 _blocks 存储
+};
+
+inline ArrayElementsKind arrayElementsKindOf(const JsValue &value) {
+    if (value.type == JDT_INT32) {
+        return AEK_PACKED_INT32;
+    } else if (value.isInlineDouble) {
+        return AEK_PACKED_DOUBLE;
+    }
+    return AEK_PACKED_GENERIC;
+}
+
 /**
  * JsArray 对应于 JavaScript 中的 Array。
+ * 没有空洞的数组使用 packed 类型，元素连续存储在 _packedItems 中，可以直接按照 index 访问.
+ * 其他的数组:
  * 小于 ARRAY_RESERVE_MAX_SIZE 个元素内的对象，按照每个 block ARRAY_BLOCK_SIZE 个对象来管理
  * 超过的，则使用就近原则，一个元素靠近哪个 block 就归其管理
  * block 采用 deque 来存储，方便添加、修改，同时支持二分查找.
@@ -73,6 +95,37 @@ public:
 
     void dump(VMContext *ctx, const JsValue &thiz, VecJsValues &values);
 
+    ArrayElementsKind elementsKind() const { return _elementsKind; }
+
+    /**
+     * 虚拟机中按照 index 读写的快速路径，不需要虚函数调用.
+     * 返回 false 表示不是 packed 数组、越界或者需要转换元素类型，需要走通用的流程.
+     */
+    inline bool getPackedByIndex(uint32_t index, JsValue &valueOut) const {
+        // 非 packed 类型的 _packedItems 为空
+        if (index < _packedItems.size()) {
+            valueOut = _packedItems[index].asValue();
+            return true;
+        }
+        return false;
+    }
+
+    inline bool setPackedByIndex(uint32_t index, const JsValue &value) {
+        if (arrayElementsKindOf(value) > _elementsKind) {
+            return false;
+        }
+
+        if (index < _packedItems.size()) {
+            _packedItems[index] = value.asProperty();
+            return true;
+        } else if (index == _packedItems.size() && _elementsKind != AEK_HOLEY && !isPreventedExtensions) {
+            _packedItems.push_back(value.asProperty());
+            _length++;
+            return true;
+        }
+        return false;
+    }
+
     /**
      * 采用按 Block 存储所有的元素，平均每一个 Block 约 2 ** 14 = 16384 个元素
      * 整个数组采用 block 数组存储。查找位置时，先根据 index 使用二分查找到 block，再直接定位具体的元素
@@ -99,10 +152,23 @@ protected:
 
     void reserveSize(uint32_t length);
 
+    void convertToHoley();
+    void resetToPacked();
+    inline void updateElementsKind(const JsValue &value) {
+        auto kind = arrayElementsKindOf(value);
+        if (kind > _elementsKind) {
+            _elementsKind = kind;
+        }
+    }
+
     friend class JsArrayIterator;
+    friend class JsArrayItemsCursor;
 
 protected:
 
+    ArrayElementsKind           _elementsKind;
+    VecJsValues                 _packedItems;
+
     VecBlocks                   _blocks;
     uint32_t                    _length;
     Block                       *_firstBlock;
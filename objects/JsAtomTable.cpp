@@ -0,0 +1,37 @@
+﻿//
+//  JsAtomTable.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/17.
+//
+
+#include "JsAtomTable.hpp"
+
+
+JsAtomTable::JsAtomTable(const JsAtomTable *parent) : _parent(parent), _isFrozen(false) {
+    if (parent) {
+        assert(parent->isFrozen());
+        _firstAtom = parent->count() + 1;
+    } else {
+        // 0 为非法的 atom
+        _firstAtom = 0;
+        _names.push_back(StringView());
+    }
+}
+
+JsAtom JsAtomTable::intern(const StringView &name) {
+    auto atom = find(name);
+    if (atom != JS_ATOM_NONE) {
+        return atom;
+    }
+
+    assert(!_isFrozen);
+    auto str = _pool.duplicate(name);
+    str.setStable();
+
+    atom = _firstAtom + (JsAtom)_names.size();
+    _names.push_back(str);
+    _map[str] = atom;
+
+    return atom;
+}
@@ -0,0 +1,94 @@
+﻿//
+//  JsAtomTable.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/17.
+//
+
+#ifndef JsAtomTable_hpp
+#define JsAtomTable_hpp
+
+#include <unordered_map>
+#include "utils/StringView.h"
+#include "utils/AllocatorPool.h"
+
+
+// 属性名的整数 id, 0 为非法的 atom
+using JsAtom = uint32_t;
+using VecJsAtoms = std::vector<JsAtom>;
+
+const JsAtom JS_ATOM_NONE = 0;
+
+using MapNameToAtom = std::unordered_map<StringView, JsAtom, StringViewHash, SizedStrCmpEqual>;
+
+/**
+ * 属性名的 atom 表: 相同的属性名只保存一份，并对应唯一的 JsAtom.
+ *
+ * JsShape 按照 atom 保存和查找属性名，bytecode 中的属性名也会在运行时解析为 atom，所以查找属性时只需比较整数.
+ * atom 表可以在 parent 的基础上继续添加: parent 中已有的名字使用 parent 的 atom, 新的 atom 从 parent 的末尾开始编号.
+ * 最底层为 VMRuntimeCommon 的 atom 表，每个 VMRuntime 有自己的 atom 表 (见 JsShapeTree)，随其一起释放.
+ * parent 需要先冻结，之后只读，可以在多个线程中共享.
+ */
+class JsAtomTable {
+private:
+    JsAtomTable(const JsAtomTable &);
+    JsAtomTable &operator=(const JsAtomTable &);
+
+public:
+    JsAtomTable(const JsAtomTable *parent = nullptr);
+
+    /**
+     * 查找 name 对应的 atom，不存在返回 JS_ATOM_NONE
+     */
+    JsAtom find(const StringView &name) const {
+        if (_parent) {
+            auto atom = _parent->find(name);
+            if (atom != JS_ATOM_NONE) {
+                return atom;
+            }
+        }
+
+        auto it = _map.find(name);
+        return it == _map.end() ? JS_ATOM_NONE : (*it).second;
+    }
+
+    /**
+     * 返回 name 对应的 atom, 不存在则添加
+     */
+    JsAtom intern(const StringView &name);
+
+    /**
+     * 返回 atom 的名字，其内存由 atom 表管理，是 stable 的
+     */
+    const StringView &name(JsAtom atom) const {
+        if (atom < _firstAtom) {
+            return _parent->name(atom);
+        }
+
+        assert(atom > 0 && atom - _firstAtom < _names.size());
+        return _names[atom - _firstAtom];
+    }
+
+    // 包括 parent 中的 atom 数量
+    uint32_t count() const { return _firstAtom + (uint32_t)_names.size() - 1; }
+
+    void freeze() { _isFrozen = true; }
+    bool isFrozen() const { return _isFrozen; }
+
+protected:
+    const JsAtomTable           *_parent;
+
+    // _names 中第一个名字的 atom
+    JsAtom                      _firstAtom;
+
+    MapNameToAtom               _map;
+    VecStringViews              _names;
+
+    // 保存名字的内存
+    AllocatorPool               _pool;
+
+    bool                        _isFrozen;
+
+};
+
+#endif /* JsAtomTable_hpp */
@@ -0,0 +1,246 @@
+//
+//  JsGeneratorObject.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/25.
+//
+
+#include "JsGeneratorObject.hpp"
+#include "JsPromiseObject.hpp"
+#include "IJsIterator.hpp"
+
+
+extern JsValue jsValuePrototypeGenerator;
+
+/**
+ * for...of 遍历 generator: 每次调用 next()，直到 generator 结束
+ */
+class JsGeneratorIterator : public IJsIterator {
+public:
+    JsGeneratorIterator(VMContext *ctx, JsGeneratorObject *generator, bool includeProtoProp, bool includeNoneEnumerable) : IJsIterator(includeProtoProp, includeNoneEnumerable)
+    {
+        _isOfIterable = true;
+        _ctx = ctx;
+        _generator = generator;
+        _itObj = nullptr;
+    }
+
+    ~JsGeneratorIterator() {
+        if (_itObj) {
+            delete _itObj;
+        }
+    }
+
+    virtual bool nextOf(JsValue &valueOut) override {
+        _ctx->vm->resumeGenerator(_ctx, _generator, GRM_NEXT, jsValueUndefined);
+        if (_ctx->error != JE_OK || _generator->isCompleted()) {
+            // 异常由 OP_ITERATOR_NEXT_VALUE 之后的 catchException 处理
+            return false;
+        }
+
+        valueOut = _ctx->retValue;
+
+        // _curValue 可能引用了新生代的值
+        _ctx->runtime->writeBarrier(this);
+        _curValue = valueOut;
+        return true;
+    }
+
+    virtual bool next(StringView *strKeyOut = nullptr, JsValue *keyOut = nullptr, JsValue *valueOut = nullptr) override {
+        if (_itObj == nullptr) {
+            _itObj = _generator->JsObjectLazy::getIteratorObject(_ctx, _includeProtoProp, _includeNoneEnumerable);
+        }
+
+        return _itObj->next(strKeyOut, keyOut, valueOut);
+    }
+
+    virtual void markReferIdx(VMRuntime *rt) override {
+        IJsIterator::markReferIdx(rt);
+
+        ::markReferIdx(rt, _generator);
+    }
+
+protected:
+    VMContext                       *_ctx;
+    JsGeneratorObject               *_generator;
+
+    IJsIterator                     *_itObj;
+
+};
+
+JsGeneratorObject::JsGeneratorObject(VMContext *ctx, Function *function, bool isAsync) : JsObjectLazy(nullptr, 0, jsValuePrototypeGenerator, JDT_GENERATOR), _ctx(ctx), _function(function), _isAsync(isAsync)
+{
+    _isOfIterable = !isAsync;
+    _state = SUSPENDED_START;
+    promise = nullptr;
+
+    _scope = _functionScope = nullptr;
+    _pc = 0;
+
+    _isReturnedForTry = false;
+    _errorInTry = JE_OK;
+}
+
+/**
+ * 调用者 (finally 中) 的 return/异常状态和 generator 自己的交换
+ */
+inline void swapTryState(VMContext *ctx, bool &isReturnedForTry, JsError &errorInTry, JsValue &errorMessageInTry) {
+    std::swap(ctx->isReturnedForTry, isReturnedForTry);
+    std::swap(ctx->errorInTry, errorInTry);
+    std::swap(ctx->errorMessageInTry, errorMessageInTry);
+}
+
+void JsGeneratorObject::suspend(VMFunctionFrame *frame, uint32_t posStackBase, bool isStart) {
+    auto &stack = _ctx->stack;
+    assert(_ctx->stackFrames.back() == frame);
+    assert(posStackBase <= stack.size());
+
+    // 保存的值可能在新生代
+    _ctx->runtime->writeBarrier(this);
+
+    _pc = (uint32_t)(frame->bytecode - _function->bytecode);
+    _thiz = frame->thiz;
+    _retValue = frame->retValue;
+    _scope = frame->scope;
+    _functionScope = frame->functionScope;
+    _stackScopes.swap(frame->stackScopes);
+
+    _stack.assign(stack.begin() + posStackBase, stack.end());
+    stack.resize(posStackBase);
+
+    // 从内层到外层取出，保存的顺序为从外层到内层
+    auto &stackTryCatch = _ctx->stackTryCatch;
+    auto frameDepth = _ctx->stackFrames.size();
+    while (!stackTryCatch.empty() && stackTryCatch.top().frameDepth == frameDepth) {
+        auto point = stackTryCatch.top();
+        point.stackSize -= posStackBase;
+        _tryCatchPoints.push_back(point);
+        stackTryCatch.pop();
+    }
+    std::reverse(_tryCatchPoints.begin(), _tryCatchPoints.end());
+
+    if (isStart) {
+        _state = SUSPENDED_START;
+    } else {
+        swapTryState(_ctx, _isReturnedForTry, _errorInTry, _errorMessageInTry);
+        _state = SUSPENDED_YIELD;
+    }
+}
+
+VMFunctionFrame *JsGeneratorObject::resume() {
+    assert(_state == SUSPENDED_START || _state == SUSPENDED_YIELD);
+    auto runtime = _ctx->runtime;
+    auto &stack = _ctx->stack;
+    auto posStackBase = (uint32_t)stack.size();
+
+    auto frame = _ctx->pushFrame();
+    frame->function = _function;
+    frame->thiz = _thiz;
+    frame->retValue = _retValue;
+    frame->prevFunctionScope = _ctx->curFunctionScope;
+    frame->bytecode = _function->bytecode + _pc;
+    frame->countTempValues = runtime->enterFunctionCall();
+    frame->posStackReturn = posStackBase; // 作为入口 frame 不会用于返回，保存函数的操作数栈的起始位置
+    frame->isConstructorCall = false;
+    frame->generator = this;
+#if VM_PROFILER
+    frame->profileNode = nullptr;
+#endif
+
+    frame->scope = _scope;
+    frame->functionScope = _functionScope;
+    _ctx->curFunctionScope = _functionScope;
+    frame->stackScopes.swap(_stackScopes);
+    _stackScopes.clear();
+
+    // 暂停期间 scope 可能已经被移到了老年代，恢复执行后会写入新的值
+    for (auto scope : frame->stackScopes) {
+        runtime->rememberScope(scope);
+    }
+
+    for (auto &value : _stack) {
+        stack.push_back(value);
+    }
+    _stack.clear();
+
+    auto frameDepth = (uint32_t)_ctx->stackFrames.size();
+    for (auto &point : _tryCatchPoints) {
+        _ctx->stackTryCatch.push(TryCatchPoint(frameDepth, point.scopeDepth, point.stackSize + posStackBase, point.addrCatch, point.addrFinally));
+    }
+    _tryCatchPoints.clear();
+
+    swapTryState(_ctx, _isReturnedForTry, _errorInTry, _errorMessageInTry);
+    _state = RUNNING;
+
+    return frame;
+}
+
+void JsGeneratorObject::complete() {
+    if (_state == RUNNING) {
+        // 恢复调用者的状态
+        swapTryState(_ctx, _isReturnedForTry, _errorInTry, _errorMessageInTry);
+    }
+
+    _state = COMPLETED;
+    _stackScopes.clear();
+    _scope = _functionScope = nullptr;
+    _thiz = _retValue = jsValueUndefined;
+    _stack.clear();
+    _tryCatchPoints.clear();
+    _errorMessageInTry = jsValueUndefined;
+}
+
+void JsGeneratorObject::onAsyncStep() {
+    assert(_isAsync && promise);
+    auto runtime = _ctx->runtime;
+
+    if (_ctx->error != JE_OK) {
+        // 未处理的异常
+        _ctx->error = JE_OK;
+        promise->changeStatus(JsPromiseObject::REJECTED, _ctx->errorMessage);
+    } else if (_state == COMPLETED) {
+        promise->changeStatus(JsPromiseObject::FULFILLED, _ctx->retValue);
+    } else {
+        // await: 不是 promise 的值也需要等到下一个 microtask 才继续执行
+        auto value = _ctx->retValue;
+        JsPromiseObject *awaited;
+        if (value.type == JDT_PROMISE) {
+            awaited = (JsPromiseObject *)runtime->getObject(value);
+        } else {
+            awaited = new JsPromiseObject(_ctx);
+            runtime->pushObject(awaited);
+            awaited->changeStatus(JsPromiseObject::FULFILLED, value);
+        }
+        awaited->addAwaiter(this);
+    }
+
+    _ctx->retValue = promise->self;
+}
+
+IJsObject *JsGeneratorObject::clone() {
+    assert(0);
+    return nullptr;
+}
+
+IJsIterator *JsGeneratorObject::getIteratorObject(VMContext *ctx, bool includeProtoProp, bool includeNoneEnumerable) {
+    return new JsGeneratorIterator(ctx, this, includeProtoProp, includeNoneEnumerable);
+}
+
+void JsGeneratorObject::markReferIdx(VMRuntime *rt) {
+    JsObjectLazy::markReferIdx(rt);
+
+    for (auto scope : _stackScopes) {
+        rt->markReferIdx(scope);
+    }
+    rt->markReferIdx(_function->resourcePool);
+    rt->markReferIdx(_thiz);
+    rt->markReferIdx(_retValue);
+    for (auto &value : _stack) {
+        rt->markReferIdx(value);
+    }
+    rt->markReferIdx(_errorMessageInTry);
+
+    if (promise) {
+        ::markReferIdx(rt, promise);
+    }
+}
@@ -0,0 +1,86 @@
+//
+//  JsGeneratorObject.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/25.
+//
+
+#ifndef JsGeneratorObject_hpp
+#define JsGeneratorObject_hpp
+
+#include "JsObjectLazy.hpp"
+
+
+class JsPromiseObject;
+
+/**
+ * generator 和 async 函数暂停时保存的执行状态.
+ *
+ * 调用时先保存 frame 的初始状态，每次恢复执行时重新压入 frame，执行到 yield/await 时再保存回来:
+ * scope 链、函数自己的那一段操作数栈、当前函数中的 try 处理点和 bytecode 的位置.
+ * 恢复执行只是切换这些状态，不需要重新解析代码或者为每一步创建闭包.
+ *
+ * async 函数也使用 JsGeneratorObject (不暴露给 JavaScript)，await 的 promise settled 后由 microtask 队列直接恢复执行.
+ */
+class JsGeneratorObject : public JsObjectLazy {
+public:
+    enum State {
+        SUSPENDED_START,        // 还未开始执行
+        SUSPENDED_YIELD,        // 暂停在 yield/await 处
+        RUNNING,
+        COMPLETED,
+    };
+
+    JsGeneratorObject(VMContext *ctx, Function *function, bool isAsync);
+
+    State state() const { return _state; }
+    bool isAsync() const { return _isAsync; }
+    bool isCompleted() const { return _state == COMPLETED; }
+
+    // 保存调用栈顶部的 frame 的状态，frame 随后由调用者释放. frame 的操作数栈从 posStackBase 开始
+    void suspend(VMFunctionFrame *frame, uint32_t posStackBase, bool isStart = false);
+
+    // 重新创建 frame 并恢复保存的状态，frame 在调用栈的顶部
+    VMFunctionFrame *resume();
+
+    // 执行结束，释放保存的状态
+    void complete();
+
+    // async 函数暂停或者结束后: 等待 await 的值，或者 settle 返回的 promise. ctx->retValue 设置为返回的 promise
+    void onAsyncStep();
+
+    virtual IJsObject *clone() override;
+    virtual IJsIterator *getIteratorObject(VMContext *ctx, bool includeProtoProp = true, bool includeNoneEnumerable = false) override;
+
+    virtual void markReferIdx(VMRuntime *rt) override;
+
+    // async 函数返回的 promise
+    JsPromiseObject             *promise;
+
+protected:
+    VMContext                   *_ctx;
+    Function                    *_function;
+    bool                        _isAsync;
+    State                       _state;
+
+    // 暂停时 frame 的状态
+    VecVMStackScopes            _stackScopes;
+    VMScope                     *_scope, *_functionScope;
+    JsValue                     _thiz;
+    uint32_t                    _pc;
+
+    // 在 finally 中暂停时，还未完成的 return 的值
+    JsValue                     _retValue;
+
+    // 函数自己的操作数栈，以及当前函数的 try 处理点 (从外层到内层，stackSize 为相对于函数栈底的位置)
+    VecJsValues                 _stack;
+    std::vector<TryCatchPoint>  _tryCatchPoints;
+
+    // 在 finally 中暂停时，finally 结束后需要继续的 return 或者异常
+    bool                        _isReturnedForTry;
+    JsError                     _errorInTry;
+    JsValue                     _errorMessageInTry;
+
+};
+
+#endif /* JsGeneratorObject_hpp */
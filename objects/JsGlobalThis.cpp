@@ -71,6 +71,7 @@ JsGlobalThis::~JsGlobalThis() {
 }
 
 void JsGlobalThis::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     auto declare = _scopeDesc->getVarDeclarationByName(name);
     if (!declare) {
         declare = PoolNew(_scopeDesc->function->resourcePool->pool, IdentifierDeclare)(name, _scopeDesc);
@@ -89,6 +90,7 @@ void JsGlobalThis::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsVa
 }
 
 void JsGlobalThis::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -97,6 +99,7 @@ void JsGlobalThis::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsV
 }
 
 JsError JsGlobalThis::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     auto declare = _scopeDesc->getVarDeclarationByName(name);
     if (declare) {
         return _scope->set(ctx, declare->storageIndex, value);
@@ -129,6 +132,7 @@ JsError JsGlobalThis::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t i
 }
 
 JsError JsGlobalThis::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -136,6 +140,7 @@ JsError JsGlobalThis::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t
 }
 
 JsValue JsGlobalThis::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     auto declare = _scopeDesc->getVarDeclarationByName(name);
     if (declare) {
         return _scope->increase(ctx, declare->storageIndex, n, isPost);
@@ -189,6 +194,7 @@ JsValue JsGlobalThis::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint3
 }
 
 JsValue JsGlobalThis::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -267,6 +273,17 @@ IJsObject *JsGlobalThis::clone() {
     return nullptr;
 }
 
+JsGlobalThis *JsGlobalThis::clone(VMGlobalScope *globalScope) {
+    auto obj = new JsGlobalThis(globalScope);
+
+    obj->isPreventedExtensions = isPreventedExtensions;
+    if (_obj) {
+        obj->_obj = (JsObject *)_obj->clone();
+    }
+
+    return obj;
+}
+
 IJsIterator *JsGlobalThis::getIteratorObject(VMContext *ctx, bool includeProtoProp, bool includeNoneEnumerable) {
     if (_obj) {
         return _obj->getIteratorObject(ctx, includeProtoProp, includeNoneEnumerable);
@@ -51,6 +51,9 @@ public:
     virtual bool hasAnyProperty(VMContext *ctx, JsPropertyFlags flags) override { return true; }
 
     virtual IJsObject *clone() override;
+
+    // 复制为另一个 VMRuntime 的 globalThis, 全局变量在 globalScope 中
+    JsGlobalThis *clone(VMGlobalScope *globalScope);
     virtual IJsIterator *getIteratorObject(VMContext *ctx, bool includeProtoProp = true, bool includeNoneEnumerable = false) override;
 
     virtual void markReferIdx(VMRuntime *rt) override;
@@ -44,15 +44,20 @@ JsLibObject::JsLibObject(VMRuntimeCommon *rt, JsLibProperty *libProps, int count
 }
 
 JsLibObject::JsLibObject(JsLibObject *from) : IJsObject(from->__proto__, from->type) {
-    assert(!from->_modified);
     _name = from->_name;
     _constructor = from->_constructor;
-    _obj = from->_obj;
+    _obj = from->_obj ? (JsObject *)from->_obj->clone() : nullptr;
     _libProps = from->_libProps;
     _libPropsEnd = from->_libPropsEnd;
     _modified = false;
     _isOfIterable = from->_isOfIterable;
+    isPreventedExtensions = from->isPreventedExtensions;
     __proto__ = from->__proto__;
+
+    if (from->_modified) {
+        // 修改过的属性不能共享
+        _copyForModify(_libProps);
+    }
 }
 
 JsLibObject::~JsLibObject() {
@@ -66,6 +71,7 @@ JsLibObject::~JsLibObject() {
 }
 
 void JsLibObject::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     auto first = std::lower_bound(_libProps, _libPropsEnd, name, JsLibFunctionLessCmp());
     if (first != _libPropsEnd && first->name.equal(name)) {
         // 修改现有的属性
@@ -89,6 +95,7 @@ void JsLibObject::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsVal
 }
 
 void JsLibObject::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -97,6 +104,7 @@ void JsLibObject::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsVa
 }
 
 JsError JsLibObject::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (thiz.type < JDT_OBJECT) {
         // Primitive types 不能被修改，但是其 setter 函数会被调用
         if (_obj) {
@@ -131,6 +139,7 @@ JsError JsLibObject::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t in
 }
 
 JsError JsLibObject::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -138,6 +147,7 @@ JsError JsLibObject::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t i
 }
 
 JsValue JsLibObject::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (thiz.type < JDT_OBJECT) {
         // Primitive types 不能被修改，但是其 setter 函数会被调用
         if (_obj) {
@@ -171,6 +181,7 @@ JsValue JsLibObject::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32
 }
 
 JsValue JsLibObject::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
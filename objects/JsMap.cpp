@@ -0,0 +1,405 @@
+﻿//
+//  JsMap.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/22.
+//
+
+#include "JsMap.hpp"
+#include "JsArray.hpp"
+#include "IJsIterator.hpp"
+#include "utils/Hash.h"
+
+
+extern JsValue jsValuePrototypeMap, jsValuePrototypeSet, jsValuePrototypeWeakMap, jsValuePrototypeWeakSet;
+
+// 只有删除的 entry 较多时才压缩，避免交替地添加和删除时反复压缩
+const uint32_t MAP_COMPACT_MIN_DELETED = 16;
+
+static inline uint32_t hashBits(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+JsMapCursor::JsMapCursor(JsMapTable *table) : table(table), pos(0) {
+    table->_cursors.push_back(this);
+}
+
+JsMapCursor::~JsMapCursor() {
+    if (table) {
+        auto &cursors = table->_cursors;
+        cursors.erase(std::find(cursors.begin(), cursors.end(), this));
+    }
+}
+
+JsMapTable::~JsMapTable() {
+    for (auto cursor : _cursors) {
+        cursor->table = nullptr;
+    }
+}
+
+JsMapTable::Entry *JsMapTable::find(VMRuntime *rt, const JsValue &key) {
+    auto k = normalizeKey(rt, key);
+    auto index = findIndex(rt, k, hashKey(rt, k));
+    return index >= 0 ? &_entries[index] : nullptr;
+}
+
+void JsMapTable::set(VMRuntime *rt, const JsValue &key, const JsValue &value) {
+    auto k = normalizeKey(rt, key);
+    auto hash = hashKey(rt, k);
+    auto index = findIndex(rt, k, hash);
+    if (index >= 0) {
+        _entries[index].value = value;
+        return;
+    }
+
+    // 包括已经删除的 entry 在内，_buckets 最多使用 3/4
+    if ((_entries.size() + 1) * 4 > _buckets.size() * 3) {
+        rehash(size() + 1);
+    }
+
+    _entries.push_back({k, value, hash});
+    insertBucket(hash, (uint32_t)_entries.size());
+}
+
+bool JsMapTable::remove(VMRuntime *rt, const JsValue &key) {
+    auto k = normalizeKey(rt, key);
+    auto index = findIndex(rt, k, hashKey(rt, k));
+    if (index < 0) {
+        return false;
+    }
+
+    removeEntry(_entries[index]);
+    compactIfSparse();
+    return true;
+}
+
+void JsMapTable::clear() {
+    _entries.clear();
+    _buckets.clear();
+    _countDeleted = 0;
+
+    // 之后添加的 entry 仍然需要被遍历到
+    for (auto cursor : _cursors) {
+        cursor->pos = 0;
+    }
+}
+
+void JsMapTable::copyFrom(const JsMapTable &other) {
+    _entries = other._entries;
+    _buckets = other._buckets;
+    _countDeleted = other._countDeleted;
+}
+
+JsMapTable::Entry *JsMapTable::next(JsMapCursor &cursor) {
+    assert(cursor.table == this);
+
+    while (cursor.pos < _entries.size()) {
+        auto &entry = _entries[cursor.pos++];
+        if (!entry.key.isEmpty()) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+void JsMapTable::markReferIdx(VMRuntime *rt) {
+    for (auto &entry : _entries) {
+        if (!entry.key.isEmpty()) {
+            rt->markReferIdx(entry.key);
+            rt->markReferIdx(entry.value);
+        }
+    }
+}
+
+JsValue JsMapTable::normalizeKey(VMRuntime *rt, const JsValue &key) {
+    if (key.type == JDT_NUMBER) {
+        auto d = rt->getDouble(key);
+        if (isnan(d)) {
+            return jsValueNaN;
+        }
+
+        // -0 也会被转换为 0
+        if (d >= INT32_MIN && d <= INT32_MAX && (int32_t)d == d) {
+            return makeJsValueInt32((int32_t)d);
+        }
+    }
+
+    return key.asValue();
+}
+
+uint32_t JsMapTable::hashKey(VMRuntime *rt, const JsValue &key) {
+    switch (key.type) {
+        case JDT_CHAR: {
+            StringViewWrapper s(key);
+            return (uint32_t)hashBytes(s.data, s.len);
+        }
+        case JDT_STRING: {
+            auto &s = rt->getUtf8String(key);
+            return (uint32_t)hashBytes(s.data, s.len);
+        }
+        case JDT_NUMBER: {
+            // 相同的 double 可能内联存储，也可能是常量
+            auto d = rt->getDouble(key);
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            return hashBits(bits);
+        }
+        default:
+            return hashBits(key.bits);
+    }
+}
+
+bool JsMapTable::isSameKey(VMRuntime *rt, const JsValue &a, const JsValue &b) {
+    if (a.equalValue(b)) {
+        return true;
+    }
+
+    if (a.isString() && b.isString()) {
+        if (a.type == JDT_CHAR && b.type == JDT_CHAR) {
+            return false;
+        }
+
+        StringViewWrapper bufA, bufB;
+        const StringView &s1 = a.type == JDT_CHAR ? (bufA = StringViewWrapper(a)) : rt->getUtf8String(a);
+        const StringView &s2 = b.type == JDT_CHAR ? (bufB = StringViewWrapper(b)) : rt->getUtf8String(b);
+        return s1.equal(s2);
+    } else if (a.type == JDT_NUMBER && b.type == JDT_NUMBER) {
+        return rt->getDouble(a) == rt->getDouble(b);
+    }
+
+    return false;
+}
+
+int32_t JsMapTable::findIndex(VMRuntime *rt, const JsValue &key, uint32_t hash) {
+    if (_buckets.empty()) {
+        return -1;
+    }
+
+    auto mask = (uint32_t)_buckets.size() - 1;
+    for (auto i = hash & mask; ; i = (i + 1) & mask) {
+        auto slot = _buckets[i];
+        if (slot == 0) {
+            return -1;
+        }
+
+        auto &entry = _entries[slot - 1];
+        if (entry.hash == hash && !entry.key.isEmpty() && isSameKey(rt, entry.key, key)) {
+            return (int32_t)slot - 1;
+        }
+    }
+}
+
+void JsMapTable::insertBucket(uint32_t hash, uint32_t slot) {
+    auto mask = (uint32_t)_buckets.size() - 1;
+    auto i = hash & mask;
+    while (_buckets[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    _buckets[i] = slot;
+}
+
+void JsMapTable::removeEntry(Entry &entry) {
+    entry.key = jsValueEmpty;
+    entry.value = jsValueUndefined;
+    _countDeleted++;
+}
+
+void JsMapTable::compactIfSparse() {
+    if (_countDeleted >= MAP_COMPACT_MIN_DELETED && _countDeleted * 2 >= _entries.size()) {
+        rehash(size());
+    }
+}
+
+/**
+ * 移除已经删除的 entry，并按照 count 重新分配 _buckets.
+ */
+void JsMapTable::rehash(uint32_t count) {
+    if (_countDeleted > 0) {
+        // 正在遍历的位置调整为其之前有效的 entry 的数量
+        for (auto cursor : _cursors) {
+            uint32_t pos = 0;
+            auto end = std::min(cursor->pos, (uint32_t)_entries.size());
+            for (uint32_t i = 0; i < end; i++) {
+                if (!_entries[i].key.isEmpty()) {
+                    pos++;
+                }
+            }
+            cursor->pos = pos;
+        }
+
+        auto isDeleted = [](const Entry &entry) { return entry.key.isEmpty(); };
+        _entries.erase(std::remove_if(_entries.begin(), _entries.end(), isDeleted), _entries.end());
+        _countDeleted = 0;
+    }
+
+    uint32_t capacity = 8;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+
+    _buckets.assign(capacity, 0);
+    for (uint32_t i = 0; i < _entries.size(); i++) {
+        insertBucket(_entries[i].hash, i + 1);
+    }
+}
+
+/**
+ * 遍历 Map/Set 的 entry.
+ * for ... of 以及 entries(), keys(), values() 使用 nextOf(); for ... in 使用 next()，遍历的是 Map/Set 自身的属性.
+ */
+class JsMapIterator : public IJsIterator {
+public:
+    JsMapIterator(VMContext *ctx, JsMap *map, JsMapIteratorKind kind, bool includeProtoProp, bool includeNoneEnumerable) : IJsIterator(includeProtoProp, includeNoneEnumerable), _cursor(&map->table)
+    {
+        _isOfIterable = true;
+        _ctx = ctx;
+        _map = map;
+        _kind = kind;
+        _itObj = nullptr;
+    }
+
+    ~JsMapIterator() {
+        if (_itObj) {
+            delete _itObj;
+        }
+    }
+
+    virtual bool nextOf(JsValue &valueOut) override {
+        if (!_cursor.table) {
+            return false;
+        }
+
+        auto entry = _cursor.table->next(_cursor);
+        if (!entry) {
+            return false;
+        }
+
+        auto key = entry->key;
+        auto value = _map->isSet() ? key : entry->value;
+
+        if (_kind == MIK_KEYS) {
+            valueOut = key;
+        } else if (_kind == MIK_VALUES) {
+            valueOut = value;
+        } else {
+            auto arrObj = new JsArray();
+            valueOut = _ctx->runtime->pushObject(arrObj);
+            JsValue items[] = { key, value };
+            arrObj->push(_ctx, items, CountOf(items));
+        }
+
+        // _curValue 可能引用了新生代的值
+        _ctx->runtime->writeBarrier(this);
+        _curValue = valueOut;
+        return true;
+    }
+
+    virtual bool next(StringView *strKeyOut = nullptr, JsValue *keyOut = nullptr, JsValue *valueOut = nullptr) override {
+        if (_itObj == nullptr) {
+            _itObj = _map->JsObjectLazy::getIteratorObject(_ctx, _includeProtoProp, _includeNoneEnumerable);
+        }
+
+        return _itObj->next(strKeyOut, keyOut, valueOut);
+    }
+
+    virtual void markReferIdx(VMRuntime *rt) override {
+        IJsIterator::markReferIdx(rt);
+
+        // 遍历过程中 _map 可能只被当前的 iterator 引用 (比如 for (x of new Map(...).keys()))
+        ::markReferIdx(rt, _map);
+    }
+
+protected:
+    VMContext                       *_ctx;
+    JsMap                           *_map;
+    JsMapIteratorKind               _kind;
+    JsMapCursor                     _cursor;
+
+    IJsIterator                     *_itObj;
+
+};
+
+JsMap::JsMap(JsDataType type) : JsObjectLazy(nullptr, 0, type == JDT_SET ? jsValuePrototypeSet : jsValuePrototypeMap, type) {
+    assert(type == JDT_MAP || type == JDT_SET);
+    _isOfIterable = true;
+}
+
+IJsIterator *JsMap::newIterator(VMContext *ctx, JsMapIteratorKind kind, bool includeProtoProp, bool includeNoneEnumerable) {
+    return new JsMapIterator(ctx, this, kind, includeProtoProp, includeNoneEnumerable);
+}
+
+JsError JsMap::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    if (name.equal(SS_SIZE)) {
+        // size 只有 getter
+        return JE_TYPE_NO_PROP_SETTER;
+    }
+
+    return JsObjectLazy::setByName(ctx, thiz, name, value);
+}
+
+JsValue *JsMap::getRawByName(VMContext *ctx, const StringView &name, bool includeProtoProp) {
+    if (name.equal(SS_SIZE)) {
+        static thread_local JsValue prop;
+        prop = makeJsValueInt32(table.size()).asProperty(JP_CONFIGURABLE);
+        return &prop;
+    }
+
+    return JsObjectLazy::getRawByName(ctx, name, includeProtoProp);
+}
+
+IJsObject *JsMap::clone() {
+    auto obj = new JsMap(type);
+    copyPropertiesTo(obj);
+    obj->table.copyFrom(table);
+
+    return obj;
+}
+
+IJsIterator *JsMap::getIteratorObject(VMContext *ctx, bool includeProtoProp, bool includeNoneEnumerable) {
+    // Map 遍历的是 [key, value], Set 遍历的是值
+    return newIterator(ctx, isSet() ? MIK_KEYS : MIK_ENTRIES, includeProtoProp, includeNoneEnumerable);
+}
+
+void JsMap::markReferIdx(VMRuntime *rt) {
+    JsObjectLazy::markReferIdx(rt);
+
+    table.markReferIdx(rt);
+}
+
+JsWeakMap::JsWeakMap(JsDataType type) : JsObjectLazy(nullptr, 0, type == JDT_WEAK_SET ? jsValuePrototypeWeakSet : jsValuePrototypeWeakMap, type) {
+    assert(type == JDT_WEAK_MAP || type == JDT_WEAK_SET);
+}
+
+IJsObject *JsWeakMap::clone() {
+    auto obj = new JsWeakMap(type);
+    copyPropertiesTo(obj);
+    obj->table.copyFrom(table);
+
+    return obj;
+}
+
+void JsWeakMap::markReferIdx(VMRuntime *rt) {
+    JsObjectLazy::markReferIdx(rt);
+
+    rt->markWeakMapLater(this);
+}
+
+void JsWeakMap::markLiveValues(VMRuntime *rt) {
+    table.forEach([rt](JsMapTable::Entry &entry) {
+        if (rt->isObjectMarked(entry.key)) {
+            rt->markReferIdx(entry.value);
+        }
+    });
+}
+
+void JsWeakMap::removeDeadKeys(VMRuntime *rt) {
+    table.removeIf([rt](JsMapTable::Entry &entry) {
+        return !rt->isObjectMarked(entry.key);
+    });
+}
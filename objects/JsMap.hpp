@@ -0,0 +1,171 @@
+﻿//
+//  JsMap.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/22.
+//
+
+#ifndef JsMap_hpp
+#define JsMap_hpp
+
+#include "JsObjectLazy.hpp"
+
+
+class JsMapTable;
+
+/**
+ * 遍历 JsMapTable 时的位置.
+ * JsMapTable 压缩时会移除已经删除的 entry，需要调整所有正在遍历的位置，所以 cursor 在创建时需要注册到 JsMapTable 中.
+ */
+class JsMapCursor {
+private:
+    JsMapCursor(const JsMapCursor &);
+    JsMapCursor &operator=(const JsMapCursor &);
+
+public:
+    JsMapCursor(JsMapTable *table);
+    ~JsMapCursor();
+
+    // JsMapTable 先被释放时会被设置为 nullptr
+    JsMapTable                  *table;
+
+    // 下一个要访问的 entry 的序号
+    uint32_t                    pos;
+
+};
+
+/**
+ * Map/Set 的存储.
+ *
+ * entry 按照插入的顺序保存在 _entries 中，删除时只将 key 标记为 empty.
+ * _buckets 为开放寻址 (线性探测) 的哈希表，保存 entry 的序号 + 1, 0 表示空位置.
+ * 已经删除的 entry 仍然占用 _buckets 中的位置，在扩展或者删除得较多时连同 _entries 一起压缩.
+ *
+ * key 按照 SameValueZero 比较: 可以表示为 int32 的数字 (包括 -0) 都转换为 JDT_INT32，NaN 统一为 jsValueNaN,
+ * 这样 undefined, null, bool, int32, Symbol 和对象都可以直接比较 JsValue 的值.
+ * 字符串没有 intern，需要按照内容计算 hash 和比较，所以 hash 保存在 entry 中.
+ */
+class JsMapTable {
+private:
+    JsMapTable(const JsMapTable &);
+    JsMapTable &operator=(const JsMapTable &);
+
+public:
+    struct Entry {
+        JsValue                 key;
+        JsValue                 value;
+        uint32_t                hash;
+    };
+    using VecEntries = std::vector<Entry>;
+
+    JsMapTable() : _countDeleted(0) { }
+    ~JsMapTable();
+
+    uint32_t size() const { return (uint32_t)_entries.size() - _countDeleted; }
+
+    // 返回 key 对应的 entry, 不存在返回 nullptr. 修改 JsMapTable 之后返回的指针就无效了
+    Entry *find(VMRuntime *rt, const JsValue &key);
+
+    void set(VMRuntime *rt, const JsValue &key, const JsValue &value);
+    bool remove(VMRuntime *rt, const JsValue &key);
+    void clear();
+
+    // 返回 cursor 位置之后的第一个 entry，遍历完成返回 nullptr
+    Entry *next(JsMapCursor &cursor);
+
+    // 复制 other 的所有 entry, 不包括正在遍历的 cursor
+    void copyFrom(const JsMapTable &other);
+
+    template<typename Callback>
+    void forEach(Callback callback) {
+        for (auto &entry : _entries) {
+            if (!entry.key.isEmpty()) {
+                callback(entry);
+            }
+        }
+    }
+
+    template<typename Pred>
+    void removeIf(Pred shouldRemove) {
+        for (auto &entry : _entries) {
+            if (!entry.key.isEmpty() && shouldRemove(entry)) {
+                removeEntry(entry);
+            }
+        }
+        compactIfSparse();
+    }
+
+    void markReferIdx(VMRuntime *rt);
+
+protected:
+    friend class JsMapCursor;
+
+    static JsValue normalizeKey(VMRuntime *rt, const JsValue &key);
+    static uint32_t hashKey(VMRuntime *rt, const JsValue &key);
+    static bool isSameKey(VMRuntime *rt, const JsValue &a, const JsValue &b);
+
+    int32_t findIndex(VMRuntime *rt, const JsValue &key, uint32_t hash);
+    void insertBucket(uint32_t hash, uint32_t slot);
+    void removeEntry(Entry &entry);
+    void compactIfSparse();
+    void rehash(uint32_t count);
+
+    VecEntries                  _entries;
+    std::vector<uint32_t>       _buckets;
+    uint32_t                    _countDeleted;
+
+    std::vector<JsMapCursor *>  _cursors;
+
+};
+
+enum JsMapIteratorKind {
+    MIK_KEYS,
+    MIK_VALUES,
+    MIK_ENTRIES,
+};
+
+/**
+ * Map 和 Set, type 为 JDT_MAP 或者 JDT_SET. Set 只使用 entry 的 key.
+ */
+class JsMap : public JsObjectLazy {
+public:
+    JsMap(JsDataType type);
+
+    bool isSet() const { return type == JDT_SET; }
+
+    IJsIterator *newIterator(VMContext *ctx, JsMapIteratorKind kind, bool includeProtoProp = false, bool includeNoneEnumerable = false);
+
+    virtual JsError setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) override;
+    virtual JsValue *getRawByName(VMContext *ctx, const StringView &name, bool includeProtoProp = true) override;
+
+    virtual IJsObject *clone() override;
+    virtual IJsIterator *getIteratorObject(VMContext *ctx, bool includeProtoProp = true, bool includeNoneEnumerable = false) override;
+
+    virtual void markReferIdx(VMRuntime *rt) override;
+
+    JsMapTable                  table;
+
+};
+
+/**
+ * WeakMap 和 WeakSet, type 为 JDT_WEAK_MAP 或者 JDT_WEAK_SET, key 只能为对象.
+ *
+ * GC 标记时不标记 key 和 value，只是登记到 VMRuntime 中. 所有可达的值都标记完成后，
+ * VMRuntime 调用 markLiveValues() 标记 key 已经存活的 entry 的 value，
+ * 最后调用 removeDeadKeys() 删除 key 没有被标记的 entry.
+ */
+class JsWeakMap : public JsObjectLazy {
+public:
+    JsWeakMap(JsDataType type);
+
+    virtual IJsObject *clone() override;
+    virtual void markReferIdx(VMRuntime *rt) override;
+
+    void markLiveValues(VMRuntime *rt);
+    void removeDeadKeys(VMRuntime *rt);
+
+    JsMapTable                  table;
+
+};
+
+#endif /* JsMap_hpp */
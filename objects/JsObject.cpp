@@ -9,8 +9,14 @@
 #include "JsObject.hpp"
 
 
-StringView copyPropertyIfNeed(StringView name) {
+StringView copyPropertyIfNeed(StringView name, const JsAtomTable *atoms = nullptr) {
     if (!name.isStable()) {
+        auto atom = atoms ? atoms->find(name) : JS_ATOM_NONE;
+        if (atom != JS_ATOM_NONE) {
+            // 共享 atom 表中的属性名
+            return atoms->name(atom);
+        }
+
         auto p = new char[name.len];
         memcpy(p, name.data, name.len);
         name.data = p;
@@ -19,6 +25,49 @@ StringView copyPropertyIfNeed(StringView name) {
     return name;
 }
 
+static bool toArrayIndex(const StringView &name, uint32_t &indexOut) {
+    if (name.len == 0 || name.len > 10 || (name.len > 1 && name.data[0] == '0')) {
+        return false;
+    }
+
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < name.len; i++) {
+        auto c = name.data[i];
+        if (!isDigit(c)) {
+            return false;
+        }
+        n = n * 10 + (c - '0');
+    }
+
+    if (n >= 0xFFFFFFFF) {
+        return false;
+    }
+    indexOut = (uint32_t)n;
+    return true;
+}
+
+/**
+ * 和 V8 相同的属性顺序: 整数的属性按照数值大小排在前面，其他的属性按照添加的顺序.
+ */
+static void sortPropertyNames(VecStringViews &names) {
+    uint32_t index;
+    bool hasIndex = std::any_of(names.begin(), names.end(), [&index](const StringView &name) {
+        return toArrayIndex(name, index);
+    });
+    if (!hasIndex) {
+        return;
+    }
+
+    std::stable_sort(names.begin(), names.end(), [](const StringView &a, const StringView &b) {
+        uint32_t indexA, indexB;
+        bool isIndexA = toArrayIndex(a, indexA), isIndexB = toArrayIndex(b, indexB);
+        if (isIndexA && isIndexB) {
+            return indexA < indexB;
+        }
+        return isIndexA && !isIndexB;
+    });
+}
+
 /**
  * 为了遍历 Object 的所有属性
  */
@@ -28,8 +77,16 @@ public:
     {
         _ctx = ctx;
         _obj = obj;
-        _it = obj->_props.begin();
         _itProto = nullptr;
+        _index = 0;
+        _isDictionary = obj->_shape == nullptr;
+        if (_isDictionary) {
+            _it = obj->_dictProps->begin();
+        } else {
+            // shape 的属性名不会被释放，遍历过程中即使对象转为了字典模式，也可以继续使用
+            obj->_shape->getNames(_names);
+            sortPropertyNames(_names);
+        }
     }
 
     virtual bool next(StringView *strKeyOut = nullptr, JsValue *keyOut = nullptr, JsValue *valueOut = nullptr) override {
@@ -37,8 +94,10 @@ public:
             return _itProto->next(strKeyOut, keyOut, valueOut);
         }
 
+        StringView name;
+        JsValue prop;
         while (true) {
-            if (_it == _obj->_props.end()) {
+            if (!nextOwnProperty(name, prop)) {
                 if (_includeProtoProp) {
                     if (_itProto == nullptr) {
                         auto objProto = _obj->getPrototypeObject(_ctx);
@@ -53,51 +112,82 @@ public:
                 return false;
             }
 
-            auto &prop = (*_it).second;
             if (prop.isEnumerable() || _includeNoneEnumerable) {
                 break;
             }
-            _it++;
         }
 
         if (strKeyOut) {
-            *strKeyOut = (*_it).first;
+            *strKeyOut = name;
         }
 
         if (keyOut) {
-            *keyOut = _ctx->runtime->pushString((*_it).first);
+            *keyOut = _ctx->runtime->pushString(name);
         }
 
         if (valueOut) {
-            *valueOut = getPropertyValue(_ctx, _obj->self, (*_it).second);
+            *valueOut = getPropertyValue(_ctx, _obj->self, prop);
         }
 
-        _it++;
-
         return true;
     }
 
+protected:
+    bool nextOwnProperty(StringView &nameOut, JsValue &propOut) {
+        if (_isDictionary) {
+            if (_it == _obj->_dictProps->end()) {
+                return false;
+            }
+
+            nameOut = (*_it).first;
+            propOut = (*_it).second;
+            _it++;
+            return true;
+        }
+
+        while (_index < _names.size()) {
+            auto &name = _names[_index++];
+            // 属性可能在遍历过程中被删除了
+            auto prop = _obj->findOwnByName(name);
+            if (prop) {
+                nameOut = name;
+                propOut = *prop;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
 protected:
     VMContext                       *_ctx;
     JsObject                        *_obj;
-    MapNameToJsProperty::iterator   _it;
     IJsIterator                     *_itProto;
 
+    bool                            _isDictionary;
+    MapNameToJsProperty::iterator   _it;
+    VecStringViews                  _names;
+    uint32_t                        _index;
+
 };
 
 
 JsObject::JsObject(const JsValue &proto) : IJsObject(proto, JDT_OBJECT) {
+    _shape = JsShape::emptyShape();
+    _dictProps = nullptr;
     _symbolProps = nullptr;
 }
 
 JsObject::~JsObject() {
-    for (auto &item : _props) {
-        auto &key = item.first;
-        if (!key.isStable()) {
-            delete [] key.data;
+    if (_dictProps) {
+        for (auto &item : *_dictProps) {
+            auto &key = item.first;
+            if (!key.isStable()) {
+                delete [] key.data;
+            }
         }
+        delete _dictProps;
     }
-    _props.clear();
 
     if (_symbolProps) {
         delete _symbolProps;
@@ -105,8 +195,9 @@ JsObject::~JsObject() {
 }
 
 void JsObject::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
-    auto it = _props.find(name);
-    if (it == _props.end()) {
+    ctx->runtime->writeBarrier(this);
+    auto prop = findOwnByName(name);
+    if (prop == nullptr) {
         if (isPreventedExtensions) {
             ctx->throwException(JE_TYPE_ERROR, "Cannot define property %.*s, object is not extensible", name.len, name.data);
             return;
@@ -116,10 +207,10 @@ void JsObject::setPropertyByName(VMContext *ctx, const StringView &name, const J
             __proto__ = descriptor;
         } else {
             // 定义新的属性
-            _props[copyPropertyIfNeed(name)] = descriptor;
+            addOwnByName(ctx, name, descriptor);
         }
     } else {
-        (*it).second = descriptor;
+        *prop = descriptor;
     }
 }
 
@@ -129,6 +220,7 @@ void JsObject::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue
 }
 
 void JsObject::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     auto prop = getRawBySymbol(ctx, index, false);
     if (prop) {
         *prop = descriptor;
@@ -148,8 +240,9 @@ void JsObject::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue
 }
 
 JsError JsObject::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
-    auto it = _props.find(name);
-    if (it == _props.end()) {
+    ctx->runtime->writeBarrier(this);
+    auto own = findOwnByName(name);
+    if (own == nullptr) {
         if (name.equal(SS___PROTO__)) {
             if (!isPreventedExtensions) {
                 return setPropertyValue(ctx, &__proto__, thiz, value);
@@ -175,12 +268,12 @@ JsError JsObject::setByName(VMContext *ctx, const JsValue &thiz, const StringVie
 
         if (!isPreventedExtensions) {
             // 添加新属性
-            _props[copyPropertyIfNeed(name)] = value.asProperty();
+            addOwnByName(ctx, name, value.asProperty());
             return JE_OK;
         }
         return JE_TYPE_PREVENTED_EXTENSION;
     } else {
-        return setPropertyValue(ctx, &(*it).second, thiz, value);
+        return setPropertyValue(ctx, own, thiz, value);
     }
 }
 
@@ -190,6 +283,7 @@ JsError JsObject::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index
 }
 
 JsError JsObject::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     auto prop = getRawBySymbol(ctx, index, false);
     if (prop) {
         // 修改已经存在的
@@ -209,8 +303,9 @@ JsError JsObject::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t inde
 }
 
 JsValue JsObject::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
-    auto it = _props.find(name);
-    if (it == _props.end()) {
+    ctx->runtime->writeBarrier(this);
+    auto own = findOwnByName(name);
+    if (own == nullptr) {
         if (name.equal(SS___PROTO__)) {
             return jsValueNaN;
         }
@@ -234,7 +329,7 @@ JsValue JsObject::increaseByName(VMContext *ctx, const JsValue &thiz, const Stri
 
             if (prop->isWritable()) {
                 // 添加新属性
-                _props[copyPropertyIfNeed(name)] = tmp.asProperty();
+                addOwnByName(ctx, name, tmp.asProperty());
             }
             return ret;
         } else {
@@ -242,11 +337,21 @@ JsValue JsObject::increaseByName(VMContext *ctx, const JsValue &thiz, const Stri
                 return jsValueNaN;
             }
             // 添加新属性
-            _props[copyPropertyIfNeed(name)] = jsValueNaN.asProperty();
+            addOwnByName(ctx, name, jsValueNaN.asProperty());
             return jsValueNaN;
         }
+    } else if (own->isGetterSetter()) {
+        return increasePropertyValue(ctx, own, thiz, n, isPost);
     } else {
-        return increasePropertyValue(ctx, &(*it).second, thiz, n, isPost);
+        // valueOf 中可能会添加属性，导致 _slots 的内存被重新分配，所以先在临时变量上修改
+        JsValue tmp = *own;
+        auto ret = increasePropertyValue(ctx, &tmp, thiz, n, isPost);
+
+        own = findOwnByName(name);
+        if (own && tmp.isWritable()) {
+            *own = tmp;
+        }
+        return ret;
     }
 }
 
@@ -256,6 +361,7 @@ JsValue JsObject::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t
 }
 
 JsValue JsObject::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     auto prop = getRawBySymbol(ctx, index, false);
     if (prop) {
         // 修改已经存在的
@@ -276,8 +382,8 @@ JsValue JsObject::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t
 }
 
 JsValue *JsObject::getRawByName(VMContext *ctx, const StringView &name, bool includeProtoProp) {
-    auto it = _props.find(name);
-    if (it == _props.end()) {
+    auto prop = findOwnByName(name);
+    if (prop == nullptr) {
         if (name.equal(SS___PROTO__)) {
             return &__proto__;
         }
@@ -289,13 +395,24 @@ JsValue *JsObject::getRawByName(VMContext *ctx, const StringView &name, bool inc
             }
         }
     } else {
-        return &(*it).second;
+        return prop;
     }
 
     return nullptr;
 }
 
 JsValue *JsObject::getRawByIndex(VMContext *ctx, uint32_t index, bool includeProtoProp) {
+    if (_shape && !_shape->hasNumericNames()) {
+        // 没有数字开头的属性名，不需要将 index 转换为字符串查找
+        if (includeProtoProp) {
+            auto objProto = getPrototypeObject(ctx);
+            if (objProto) {
+                return objProto->getRawByIndex(ctx, index, includeProtoProp);
+            }
+        }
+        return nullptr;
+    }
+
     NumberToStringView name(index);
     return getRawByName(ctx, name, includeProtoProp);
 }
@@ -321,8 +438,28 @@ JsValue *JsObject::getRawBySymbol(VMContext *ctx, uint32_t index, bool includePr
 }
 
 bool JsObject::removeByName(VMContext *ctx, const StringView &name) {
-    auto it = _props.find(name);
-    if (it != _props.end()) {
+    if (_shape) {
+        auto index = _shape->find(name);
+        if (index == -1) {
+            return true;
+        }
+
+        if (!_slots[index].isConfigurable()) {
+            return false;
+        }
+
+        if ((uint32_t)index + 1 == _shape->countProperties()) {
+            // 删除的是最后添加的属性，退回到 parent shape
+            _shape = _shape->parent();
+            _slots.pop_back();
+            return true;
+        }
+
+        convertToDictionary();
+    }
+
+    auto it = _dictProps->find(name);
+    if (it != _dictProps->end()) {
         auto &prop = (*it).second;
         if (prop.isConfigurable()) {
             // 删除自己的属性
@@ -332,7 +469,7 @@ bool JsObject::removeByName(VMContext *ctx, const StringView &name) {
                 delete [] key.data;
             }
 
-            _props.erase(it);
+            _dictProps->erase(it);
             return true;
         } else {
             return false;
@@ -367,9 +504,14 @@ bool JsObject::removeBySymbol(VMContext *ctx, uint32_t index) {
 }
 
 void JsObject::changeAllProperties(VMContext *ctx, JsPropertyFlags toAdd, JsPropertyFlags toRemove) {
+    for (auto &item : _slots) {
+        item.changeProperty(toAdd, toRemove);
+    }
 
-    for (auto &item : _props) {
-        item.second.changeProperty(toAdd, toRemove);
+    if (_dictProps) {
+        for (auto &item : *_dictProps) {
+            item.second.changeProperty(toAdd, toRemove);
+        }
     }
 
     if (_symbolProps) {
@@ -380,12 +522,20 @@ void JsObject::changeAllProperties(VMContext *ctx, JsPropertyFlags toAdd, JsProp
 }
 
 bool JsObject::hasAnyProperty(VMContext *ctx, JsPropertyFlags flags) {
-    for (auto &item : _props) {
-        if (item.second.isPropertyAny(flags)) {
+    for (auto &item : _slots) {
+        if (item.isPropertyAny(flags)) {
             return true;
         }
     }
 
+    if (_dictProps) {
+        for (auto &item : *_dictProps) {
+            if (item.second.isPropertyAny(flags)) {
+                return true;
+            }
+        }
+    }
+
     if (_symbolProps) {
         for (auto &item : *_symbolProps) {
             if (item.second.isPropertyAny(flags)) {
@@ -400,14 +550,16 @@ bool JsObject::hasAnyProperty(VMContext *ctx, JsPropertyFlags flags) {
 IJsObject *JsObject::clone() {
     auto obj = new JsObject(__proto__);
 
-    for (auto &item : _props) {
-        auto &key = item.first;
-        if (!key.isStable()) {
-            delete [] key.data;
+    // 复制的对象仍然使用相同的 shape，添加属性时才转换到所在 VMRuntime 的树中
+    obj->isPreventedExtensions = isPreventedExtensions;
+    obj->_shape = _shape;
+    obj->_slots = _slots;
+    if (_dictProps) {
+        obj->_dictProps = new MapNameToJsProperty;
+        for (auto &item : *_dictProps) {
+            (*obj->_dictProps)[copyPropertyIfNeed(item.first)] = item.second;
         }
     }
-
-    obj->_props = _props;
     if (_symbolProps) { obj->_symbolProps = new MapSymbolToJsProperty; *obj->_symbolProps = *_symbolProps; }
 
     return obj;
@@ -421,8 +573,14 @@ IJsIterator *JsObject::getIteratorObject(VMContext *ctx, bool includeProtoProp,
 void JsObject::markReferIdx(VMRuntime *rt) {
     assert(referIdx == rt->nextReferIdx());
 
-    for (auto &item : _props) {
-        rt->markReferIdx(item.second);
+    for (auto &item : _slots) {
+        rt->markReferIdx(item);
+    }
+
+    if (_dictProps) {
+        for (auto &item : *_dictProps) {
+            rt->markReferIdx(item.second);
+        }
     }
 
     if (__proto__.isValid()) {
@@ -436,3 +594,60 @@ void JsObject::markReferIdx(VMRuntime *rt) {
         }
     }
 }
+
+void JsObject::initWithShape(JsShape *shape, const JsValue *values, uint32_t count) {
+    assert(_shape == JsShape::emptyShape() && _slots.empty());
+    assert(shape->countProperties() == count);
+
+    _shape = shape;
+    _slots.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        _slots.push_back(values[i].asProperty());
+    }
+}
+
+JsValue *JsObject::findOwnByName(const StringView &name) {
+    if (_shape) {
+        auto index = _shape->find(name);
+        return index == -1 ? nullptr : &_slots[index];
+    }
+
+    auto it = _dictProps->find(name);
+    return it == _dictProps->end() ? nullptr : &(*it).second;
+}
+
+void JsObject::addOwnByName(VMContext *ctx, const StringView &name, const JsValue &value) {
+    auto tree = ctx->runtime->shapeTree();
+    if (_shape) {
+        auto shape = _shape->toTree(tree);
+        if (shape) {
+            shape = shape->addProperty(name);
+        }
+        if (shape) {
+            _shape = shape;
+            _slots.push_back(value);
+            return;
+        }
+
+        convertToDictionary();
+    }
+
+    (*_dictProps)[copyPropertyIfNeed(name, tree->atoms())] = value;
+}
+
+void JsObject::convertToDictionary() {
+    assert(_shape && _dictProps == nullptr);
+
+    VecStringViews names;
+    _shape->getNames(names);
+    assert(names.size() == _slots.size());
+
+    _dictProps = new MapNameToJsProperty;
+    _dictProps->reserve(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        (*_dictProps)[copyPropertyIfNeed(names[i])] = _slots[i];
+    }
+
+    _shape = nullptr;
+    VecJsValues().swap(_slots);
+}
@@ -10,6 +10,7 @@
 
 #include "IJsObject.hpp"
 #include "IJsIterator.hpp"
+#include "JsShape.hpp"
 
 
 // 使用 unordered_map 可以同时使用 erase 和 iterator：不会 crash，但是不保证能够完全遍历所有的 key.
@@ -52,12 +53,31 @@ public:
 
     virtual void markReferIdx(VMRuntime *rt) override;
 
+    // 字典模式下返回 nullptr
+    JsShape *shape() const { return _shape; }
+
+    JsValue &slotAt(uint32_t index) { assert(index < _slots.size()); return _slots[index]; }
+
+    /**
+     * 设置新创建的空对象的 shape 和属性值，values 按照 shape 中属性的顺序排列. 用于批量创建对象(比如 JSON.parse).
+     */
+    void initWithShape(JsShape *shape, const JsValue *values, uint32_t count);
+
 protected:
     friend class JsLibObject;
     friend class JsObjectIterator;
 
+    JsValue *findOwnByName(const StringView &name);
+    void addOwnByName(VMContext *ctx, const StringView &name, const JsValue &value);
+    void convertToDictionary();
+
+    // 属性按照 _shape 描述的布局保存在 _slots 中.
+    JsShape                     *_shape;
+    VecJsValues                 _slots;
+
+    // 删除属性或者属性过多时，转为字典模式: _shape 为 nullptr，属性保存在 _dictProps 中.
     // MapNameToJsProperty 中的 StringView 需要由 JsObject 自己管理内存.
-    MapNameToJsProperty         _props;
+    MapNameToJsProperty         *_dictProps;
 
     MapSymbolToJsProperty       *_symbolProps;
 
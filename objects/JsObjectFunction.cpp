@@ -45,10 +45,7 @@ void JsObjectFunction::onInitLazyProperty(VMContext *ctx, JsLazyProperty *prop)
 
 IJsObject *JsObjectFunction::clone() {
     auto obj = new JsObjectFunction(stackScopes, function);
-
-    obj->__proto__ = __proto__;
-
-    if (_obj) { obj->_obj = (JsObject *)_obj->clone(); }
+    copyPropertiesTo(obj);
 
     return obj;
 }
@@ -99,10 +96,7 @@ void JsObjectBoundFunction::onInitLazyProperty(VMContext *ctx, JsLazyProperty *p
 
 IJsObject *JsObjectBoundFunction::clone() {
     auto obj = new JsObjectBoundFunction(func, thiz);
-
-    obj->__proto__ = __proto__;
-
-    if (_obj) { obj->_obj = (JsObject *)_obj->clone(); }
+    copyPropertiesTo(obj);
 
     return obj;
 }
@@ -19,7 +19,19 @@ JsObjectLazy::~JsObjectLazy() {
     }
 }
 
+void JsObjectLazy::copyPropertiesTo(JsObjectLazy *other) const {
+    assert(_propsEnd - _props == other->_propsEnd - other->_props);
+    std::copy(_props, _propsEnd, other->_props);
+
+    other->__proto__ = __proto__;
+    other->isPreventedExtensions = isPreventedExtensions;
+    if (_obj) {
+        other->_obj = (JsObject *)_obj->clone();
+    }
+}
+
 void JsObjectLazy::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     for (auto p = _props; p < _propsEnd; p++) {
         if (name.equal(p->name)) {
             p->prop = descriptor;
@@ -34,6 +46,7 @@ void JsObjectLazy::setPropertyByName(VMContext *ctx, const StringView &name, con
 }
 
 void JsObjectLazy::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -42,6 +55,7 @@ void JsObjectLazy::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsVa
 }
 
 void JsObjectLazy::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -50,6 +64,7 @@ void JsObjectLazy::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsV
 }
 
 JsError JsObjectLazy::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     for (auto p = _props; p < _propsEnd; p++) {
         if (name.equal(p->name)) {
             return setPropertyValue(ctx, &p->prop, thiz, value);
@@ -64,6 +79,7 @@ JsError JsObjectLazy::setByName(VMContext *ctx, const JsValue &thiz, const Strin
 }
 
 JsError JsObjectLazy::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -71,6 +87,7 @@ JsError JsObjectLazy::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t i
 }
 
 JsError JsObjectLazy::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -78,6 +95,7 @@ JsError JsObjectLazy::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t
 }
 
 JsValue JsObjectLazy::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     for (auto p = _props; p < _propsEnd; p++) {
         if (name.equal(p->name)) {
             return increasePropertyValue(ctx, &p->prop, thiz, n, isPost);
@@ -92,6 +110,7 @@ JsValue JsObjectLazy::increaseByName(VMContext *ctx, const JsValue &thiz, const
 }
 
 JsValue JsObjectLazy::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -99,6 +118,7 @@ JsValue JsObjectLazy::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint3
 }
 
 JsValue JsObjectLazy::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -109,6 +129,8 @@ JsValue *JsObjectLazy::getRawByName(VMContext *ctx, const StringView &name, bool
     for (auto p = _props; p < _propsEnd; p++) {
         if (name.equal(p->name)) {
             if (p->isLazyInit && p->prop.isEmpty()) {
+                // 初始化时会写入新分配的值
+                ctx->runtime->writeBarrier(this);
                 onInitLazyProperty(ctx, p);
             }
             return &p->prop;
@@ -53,6 +53,9 @@ public:
 protected:
     void _newObject(VMContext *ctx);
 
+    // clone() 时复制 lazy 属性的当前值 (比如已经初始化的 prototype) 和 _obj 中的属性
+    void copyPropertiesTo(JsObjectLazy *other) const;
+
     void setProperties(JsLazyProperty *props, uint32_t countProps) {
         _props = props;
         _propsEnd = props + countProps;
@@ -18,6 +18,7 @@ JsObjectX::~JsObjectX() {
 }
 
 void JsObjectX::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (onSetValue(ctx, name, descriptor)) {
         return;
     }
@@ -29,6 +30,7 @@ void JsObjectX::setPropertyByName(VMContext *ctx, const StringView &name, const
 }
 
 void JsObjectX::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -37,6 +39,7 @@ void JsObjectX::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue
 }
 
 void JsObjectX::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -45,6 +48,7 @@ void JsObjectX::setPropertyBySymbol(VMContext *ctx, uint32_t index, const JsValu
 }
 
 JsError JsObjectX::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (onSetValue(ctx, name, value)) {
         return JE_OK;
     }
@@ -57,6 +61,7 @@ JsError JsObjectX::setByName(VMContext *ctx, const JsValue &thiz, const StringVi
 }
 
 JsError JsObjectX::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -64,6 +69,7 @@ JsError JsObjectX::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t inde
 }
 
 JsError JsObjectX::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -71,6 +77,7 @@ JsError JsObjectX::setBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t ind
 }
 
 JsValue JsObjectX::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     auto value = onGetValue(ctx, name);
     if (value.isValid()) {
         auto newValue = increase(ctx, value, n);
@@ -86,6 +93,7 @@ JsValue JsObjectX::increaseByName(VMContext *ctx, const JsValue &thiz, const Str
 }
 
 JsValue JsObjectX::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
@@ -93,6 +101,7 @@ JsValue JsObjectX::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t
 }
 
 JsValue JsObjectX::increaseBySymbol(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     if (!_obj) {
         _newObject(ctx);
     }
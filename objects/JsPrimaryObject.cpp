@@ -29,8 +29,6 @@ public:
         if (str.type == JDT_CHAR) {
             auto len = utf32CodeToUtf8(str.value.n32, _chars);
             _strUtf16.set(StringView(_chars, len));
-            _u16[0] = (utf16_t)str.value.n32;
-            _strUtf16.setUtf16(_u16, 1);
         } else {
             _strUtf16 = ctx->runtime->getStringWithRandAccess(_str);
         }
@@ -94,7 +92,6 @@ protected:
     NumberToStringView             _keyBuf;
 
     uint8_t                         _chars[4];
-    utf16_t                         _u16[2];
 
 };
 
@@ -109,6 +106,7 @@ JsStringObject::JsStringObject(const JsValue &value) : JsObjectLazy(nullptr, 0,
 }
 
 void JsStringObject::setPropertyByName(VMContext *ctx, const StringView &name, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     _updateLength(ctx);
 
     if (name.len > 0 && isDigit(name.data[0])) {
@@ -128,6 +126,7 @@ void JsStringObject::setPropertyByName(VMContext *ctx, const StringView &name, c
 }
 
 void JsStringObject::setPropertyByIndex(VMContext *ctx, uint32_t index, const JsValue &descriptor) {
+    ctx->runtime->writeBarrier(this);
     _updateLength(ctx);
 
     if (index < _length) {
@@ -139,6 +138,7 @@ void JsStringObject::setPropertyByIndex(VMContext *ctx, uint32_t index, const Js
 }
 
 JsError JsStringObject::setByName(VMContext *ctx, const JsValue &thiz, const StringView &name, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     _updateLength(ctx);
 
     if (name.len > 0 && isDigit(name.data[0])) {
@@ -157,6 +157,7 @@ JsError JsStringObject::setByName(VMContext *ctx, const JsValue &thiz, const Str
 }
 
 JsError JsStringObject::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, const JsValue &value) {
+    ctx->runtime->writeBarrier(this);
     _updateLength(ctx);
 
     if (index < _length) {
@@ -167,6 +168,7 @@ JsError JsStringObject::setByIndex(VMContext *ctx, const JsValue &thiz, uint32_t
 }
 
 JsValue JsStringObject::increaseByName(VMContext *ctx, const JsValue &thiz, const StringView &name, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     _updateLength(ctx);
 
     if (name.len > 0 && isDigit(name.data[0])) {
@@ -185,6 +187,7 @@ JsValue JsStringObject::increaseByName(VMContext *ctx, const JsValue &thiz, cons
 }
 
 JsValue JsStringObject::increaseByIndex(VMContext *ctx, const JsValue &thiz, uint32_t index, int n, bool isPost) {
+    ctx->runtime->writeBarrier(this);
     _updateLength(ctx);
 
     if (index >= _length) {
@@ -213,7 +216,7 @@ JsValue *JsStringObject::getRawByName(VMContext *ctx, const StringView &name, bo
     }
 
     if (name.equal(SS_LENGTH)) {
-        static JsValue prop;
+        static thread_local JsValue prop;
         prop = makeJsValueInt32(_length).asProperty(0);
         return &prop;
     }
@@ -231,7 +234,7 @@ JsValue *JsStringObject::getRawByIndex(VMContext *ctx, uint32_t index, bool incl
     auto str = ctx->runtime->getStringWithRandAccess(_value);
     auto code = str.chartAt(index);
 
-    static JsValue prop;
+    static thread_local JsValue prop;
     prop = makeJsValueChar(code).asProperty(JP_ENUMERABLE);
 
     return &prop;
@@ -10,7 +10,6 @@
 
 
 #include "JsObjectLazy.hpp"
-#include <regex>
 
 
 template<int protoIndex_, JsDataType type_>
@@ -29,7 +28,9 @@ public:
     JsValue value() { return _value; }
 
     virtual IJsObject *clone() override {
-        return new JsPrimaryObject_<protoIndex_, type_>(_value);
+        auto obj = new JsPrimaryObject_<protoIndex_, type_>(_value);
+        copyPropertiesTo(obj);
+        return obj;
     }
 
 protected:
@@ -67,7 +68,9 @@ public:
     JsValue value() { return _value; }
 
     virtual IJsObject *clone() override {
-        return new JsStringObject(_value);
+        auto obj = new JsStringObject(_value);
+        copyPropertiesTo(obj);
+        return obj;
     }
 
 protected:
@@ -6,6 +6,9 @@
 //
 
 #include "JsPromiseObject.hpp"
+#include "JsGeneratorObject.hpp"
+#include "JsArray.hpp"
+#include "JsObject.hpp"
 
 
 extern JsValue jsValuePrototypePromise;
@@ -13,6 +16,9 @@ extern JsValue jsValuePrototypePromise;
 JsPromiseObject::JsPromiseObject(VMContext *ctx) : JsObjectLazy(nullptr, 0, jsValuePrototypePromise, JDT_PROMISE), _ctx(ctx)
 {
     _status = PENDING;
+    _isQueued = false;
+    _combinator = COMBINE_NONE;
+    _countCombinePending = 0;
 }
 
 
@@ -22,16 +28,19 @@ IJsObject *JsPromiseObject::clone() {
 }
 
 void JsPromiseObject::markReferIdx(VMRuntime *rt) {
+    JsObjectLazy::markReferIdx(rt);
+
     rt->markReferIdx(_fulfillRejectArg);
+    rt->markReferIdx(_combinedValues);
 
-    for (auto &item : _chainPromises) {
-        if (item.funcFulfilled.isValid()) rt->markReferIdx(item.funcFulfilled);
-        if (item.funcRejected.isValid()) rt->markReferIdx(item.funcRejected);
-        if (item.funcFinally.isValid()) rt->markReferIdx(item.funcFinally);
+    for (auto chains : { &_chainPromises, &_runningChainPromises }) {
+        for (auto &item : *chains) {
+            if (item.funcFulfilled.isValid()) rt->markReferIdx(item.funcFulfilled);
+            if (item.funcRejected.isValid()) rt->markReferIdx(item.funcRejected);
+            if (item.funcFinally.isValid()) rt->markReferIdx(item.funcFinally);
 
-        if (item.nextPromise->referIdx != rt->nextReferIdx()) {
-            item.nextPromise->referIdx = rt->nextReferIdx();
-            item.nextPromise->markReferIdx(rt);
+            if (item.nextPromise) ::markReferIdx(rt, item.nextPromise);
+            if (item.awaiter) ::markReferIdx(rt, item.awaiter);
         }
     }
 }
@@ -48,14 +57,21 @@ void JsPromiseObject::changeStatus(Status status, const JsValue &arg) {
         return;
     }
 
-    _ctx->runtime->registerToRunPromise(this);
+    if (!_isQueued) {
+        _isQueued = true;
+        _ctx->runtime->registerToRunPromise(this);
+    }
 
+    // this 可能是 C++ 中保存的指针 (比如 PromiseChain::nextPromise)
+    _ctx->runtime->writeBarrier(this);
     _fulfillRejectArg = arg;
     _status = status;
 }
 
 void JsPromiseObject::onRun() {
     assert(_status != PENDING);
+    _isQueued = false;
+
     if (_chainPromises.empty()) {
         // 未处理的都需要抛出异常
         if (_status == REJECTED) {
@@ -64,11 +80,22 @@ void JsPromiseObject::onRun() {
         return;
     }
 
-    auto toRuns = _chainPromises;
-    _chainPromises.clear();
+    assert(_runningChainPromises.empty());
+    _runningChainPromises.swap(_chainPromises);
+    auto &toRuns = _runningChainPromises;
     JsValue callbackArg[FINALLY + 1] = { jsValueUndefined, _fulfillRejectArg, _fulfillRejectArg, jsValueUndefined };
 
     for (auto callback : toRuns) {
+        if (callback.awaiter) {
+            _ctx->vm->resumeGenerator(_ctx, callback.awaiter, _status == REJECTED ? GRM_THROW : GRM_NEXT, _fulfillRejectArg);
+            continue;
+        }
+
+        if (callback.combinator != COMBINE_NONE) {
+            callback.nextPromise->onCombinedSettled(callback.combinator, callback.combineIndex, _status, _fulfillRejectArg);
+            continue;
+        }
+
         auto func = _status == FULFILLED ? callback.funcFulfilled : callback.funcRejected;
         ArgumentsX args(callbackArg[_status]);
         if (!func.isFunction()) {
@@ -104,6 +131,8 @@ void JsPromiseObject::onRun() {
         // 传递到下一级
         callback.nextPromise->changeStatus(status, arg);
     }
+
+    _runningChainPromises.clear();
 }
 
 JsValue JsPromiseObject::then(const JsValue &fulfilledCallback, const JsValue &rejectedCallback, const JsValue &finallyCallback, JsPromiseObject *nextPromiseObj)
@@ -116,11 +145,143 @@ JsValue JsPromiseObject::then(const JsValue &fulfilledCallback, const JsValue &r
         nextPromise = nextPromiseObj->self;
     }
 
-    PromiseChain chain = { jsValueUndefined, jsValueUndefined, jsValueUndefined, nextPromiseObj };
+    PromiseChain chain = { jsValueUndefined, jsValueUndefined, jsValueUndefined, nextPromiseObj, COMBINE_NONE, 0, nullptr };
     if (fulfilledCallback.isFunction()) chain.funcFulfilled = fulfilledCallback;
     if (rejectedCallback.isFunction()) chain.funcRejected = rejectedCallback;
     if (finallyCallback.isFunction()) chain.funcFinally = finallyCallback;
-    _chainPromises.push_back(chain);
+    addChain(chain);
 
     return nextPromise;
 }
+
+void JsPromiseObject::addChain(const PromiseChain &chain) {
+    _ctx->runtime->writeBarrier(this);
+    _chainPromises.push_back(chain);
+
+    if (_status != PENDING && !_isQueued) {
+        // 已经 settled 并且执行过回调了，新添加的回调也需要执行
+        _isQueued = true;
+        _ctx->runtime->registerToRunPromise(this);
+    }
+}
+
+void JsPromiseObject::addAwaiter(JsGeneratorObject *awaiter) {
+    PromiseChain chain = { jsValueUndefined, jsValueUndefined, jsValueUndefined, nullptr, COMBINE_NONE, 0, awaiter };
+    addChain(chain);
+}
+
+void JsPromiseObject::beginCombine(Combinator combinator, const JsValue &values) {
+    assert(_combinator == COMBINE_NONE && combinator != COMBINE_NONE);
+    assert(values.type == JDT_ARRAY);
+
+    _ctx->runtime->writeBarrier(this);
+    _combinator = combinator;
+    _combinedValues = values;
+
+    // 在 endCombine() 之前不会 settle
+    _countCombinePending = 1;
+}
+
+void JsPromiseObject::addToCombine(JsPromiseObject *promise) {
+    assert(_combinator != COMBINE_NONE);
+    auto runtime = _ctx->runtime;
+
+    // 先占据结果中的位置
+    auto values = (JsArray *)runtime->getObject(_combinedValues);
+    auto index = values->length();
+    values->push(_ctx, jsValueUndefined);
+    _countCombinePending++;
+
+    PromiseChain chain = { jsValueUndefined, jsValueUndefined, jsValueUndefined, this, _combinator, index, nullptr };
+    promise->addChain(chain);
+}
+
+void JsPromiseObject::addValueToCombine(const JsValue &value) {
+    auto runtime = _ctx->runtime;
+
+    if (_combinator == COMBINE_ALL || _combinator == COMBINE_ALL_SETTLED) {
+        // 不是 promise 的值直接作为结果
+        auto values = (JsArray *)runtime->getObject(_combinedValues);
+        values->push(_ctx, _combinator == COMBINE_ALL ? value : newSettledResult(FULFILLED, value));
+    } else {
+        // any 和 race 的结果和 settle 的顺序相关，仍然需要通过 microtask 队列
+        auto promise = new JsPromiseObject(_ctx);
+        runtime->pushObject(promise);
+        promise->changeStatus(FULFILLED, value);
+        addToCombine(promise);
+    }
+}
+
+void JsPromiseObject::endCombine() {
+    onCombinedSettled(_combinator, 0, PENDING, jsValueUndefined);
+}
+
+/**
+ * 参与 combinator 的第 index 项 settled 了. status 为 PENDING 表示 endCombine().
+ */
+void JsPromiseObject::onCombinedSettled(Combinator combinator, uint32_t index, Status status, const JsValue &arg) {
+    if (_status != PENDING) {
+        return;
+    }
+
+    if (status != PENDING) {
+        auto isRejected = status == REJECTED;
+        JsValue value = arg;
+
+        switch (combinator) {
+            case COMBINE_ALL:
+                if (isRejected) {
+                    changeStatus(REJECTED, arg);
+                    return;
+                }
+                break;
+            case COMBINE_ALL_SETTLED:
+                value = newSettledResult(status, arg);
+                break;
+            case COMBINE_ANY:
+                if (!isRejected) {
+                    changeStatus(FULFILLED, arg);
+                    return;
+                }
+                break;
+            case COMBINE_RACE:
+                changeStatus(isRejected ? REJECTED : FULFILLED, arg);
+                return;
+            default:
+                assert(0);
+                return;
+        }
+
+        auto values = (JsArray *)_ctx->runtime->getObject(_combinedValues);
+        values->setByIndex(_ctx, _combinedValues, index, value);
+    }
+
+    assert(_countCombinePending > 0);
+    if (--_countCombinePending > 0) {
+        return;
+    }
+
+    // 所有项都 settled 了
+    if (combinator == COMBINE_ALL || combinator == COMBINE_ALL_SETTLED) {
+        changeStatus(FULFILLED, _combinedValues);
+    } else if (combinator == COMBINE_ANY) {
+        changeStatus(REJECTED, newJsAggregateError(_ctx, _combinedValues, jsStringValueAllPromisesRejected));
+    }
+    // race 的参数为空时一直是 PENDING
+}
+
+// Promise.allSettled 的结果: { status: 'fulfilled', value } 或者 { status: 'rejected', reason }
+JsValue JsPromiseObject::newSettledResult(Status status, const JsValue &arg) {
+    auto obj = new JsObject();
+    auto ret = _ctx->runtime->pushObject(obj);
+
+    if (status == REJECTED) {
+        obj->setByName(_ctx, ret, SS_STATUS, jsStringValuerejected);
+        obj->setByName(_ctx, ret, SS_REASON, arg);
+    } else {
+        obj->setByName(_ctx, ret, SS_STATUS, jsStringValuefulfilled);
+        obj->setByName(_ctx, ret, SS_VALUE, arg);
+    }
+
+    return ret;
+}
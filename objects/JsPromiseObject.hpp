@@ -11,6 +11,8 @@
 #include "JsObjectLazy.hpp"
 
 
+class JsGeneratorObject;
+
 class JsPromiseObject : public JsObjectLazy {
 public:
     enum Status {
@@ -20,9 +22,28 @@ public:
         FINALLY,
     };
 
+    /**
+     * Promise.all, allSettled, any 和 race: 所有参与的 promise 在 settled 时直接更新 nextPromise 中的结果，
+     * 不需要为每一项创建 JavaScript 的回调函数.
+     */
+    enum Combinator {
+        COMBINE_NONE,
+        COMBINE_ALL,
+        COMBINE_ALL_SETTLED,
+        COMBINE_ANY,
+        COMBINE_RACE,
+    };
+
     struct PromiseChain {
         JsValue                 funcFulfilled, funcRejected, funcFinally;
         JsPromiseObject         *nextPromise;
+
+        // 不为 COMBINE_NONE 时，nextPromise 为合并的结果，combineIndex 为在参数中的序号
+        Combinator              combinator;
+        uint32_t                combineIndex;
+
+        // 不为 nullptr 时，settled 后直接恢复执行 await 所在的 async 函数 (nextPromise 为 nullptr)
+        JsGeneratorObject       *awaiter;
     };
     using VecPromiseChain = std::vector<PromiseChain>;
 
@@ -37,13 +58,40 @@ public:
 
     JsValue then(const JsValue &fulfilledCallback, const JsValue &rejectedCallback, const JsValue &finallyCallback, JsPromiseObject *nextPromiseObj = nullptr);
 
+    /**
+     * 作为 combinator 的结果: 先调用 beginCombine(), 再对每一项调用 addToCombine() 或者 addValueToCombine(),
+     * 最后调用 endCombine().
+     */
+    void beginCombine(Combinator combinator, const JsValue &values);
+    void addToCombine(JsPromiseObject *promise);
+    void addValueToCombine(const JsValue &value);
+    void endCombine();
+
+    // async 函数 await 此 promise
+    void addAwaiter(JsGeneratorObject *awaiter);
+
 protected:
+    void addChain(const PromiseChain &chain);
+    void onCombinedSettled(Combinator combinator, uint32_t index, Status status, const JsValue &arg);
+    JsValue newSettledResult(Status status, const JsValue &arg);
+
     VMContext                   *_ctx;
     Status                      _status;
     JsValue                     _fulfillRejectArg;
 
+    // 是否已经在 microtask 队列中
+    bool                        _isQueued;
+
+    // 作为 combinator 的结果时: 各项的结果 (JsArray)，以及还未 settled 的项数
+    Combinator                  _combinator;
+    JsValue                     _combinedValues;
+    uint32_t                    _countCombinePending;
+
     VecPromiseChain             _chainPromises;
 
+    // 正在执行的回调，执行期间可能会触发 GC
+    VecPromiseChain             _runningChainPromises;
+
 };
 
 #endif /* JsPromiseObject_hpp */
@@ -37,8 +37,10 @@ bool parseRegexpFlags(const StringView &flags, uint32_t &flagsOut) {
     return true;
 }
 
-JsRegExp::JsRegExp(const StringView &str, const std::regex &re, uint32_t flags) : JsObjectLazy(_props, CountOf(_props), jsValuePrototypeRegExp, JDT_REGEX),  _strRe((cstr_t)str.data, str.len), _flags(flags), _re(re)
+JsRegExp::JsRegExp(const StringView &str, const JsRegExpProgramPtr &program) : JsObjectLazy(_props, CountOf(_props), jsValuePrototypeRegExp, JDT_REGEX),  _strRe((cstr_t)str.data, str.len), _program(program)
 {
+    auto flags = program->flags();
+
     // isGSetter, isConfigurable, isEnumerable, isWritable
     JsLazyProperty props[] = {
         // 添加缺省的 lastIndex 属性.
@@ -67,5 +69,8 @@ void JsRegExp::setLastIndex(int index) {
 }
 
 IJsObject *JsRegExp::clone() {
-    return new JsRegExp(_strRe, _re, _flags);
+    auto obj = new JsRegExp(_strRe, _program);
+    copyPropertiesTo(obj);
+
+    return obj;
 }
@@ -9,35 +9,21 @@
 #define JsRegExp_hpp
 
 #include "JsObjectLazy.hpp"
-#include <regex>
-
-
-enum RegexpFlags {
-    RF_CASE_INSENSITIVE = std::regex_constants::icase,      // i    Case-insensitive search.    ignoreCase
-#ifdef _WIN32
-    RF_MULTILINE        = 1 << 15,  // m    Allows ^ and $ to match newline characters.    multiline
-#else
-    RF_MULTILINE        = std::regex_constants::multiline,  // m    Allows ^ and $ to match newline characters.    multiline
-#endif
-    RF_DOT_ALL          = 1 << 16, // s    Allows . to match newline characters.    dotAll
-    RF_UNICODE          = 1 << 17, // u    "Unicode"; treat a pattern as a sequence of Unicode code points.    unicode
-    RF_STICKY           = 1 << 18, // y    Perform a "sticky" search that matches starting at the current
-                                   //      position in the target string.    sticky
-    RF_GLOBAL_SEARCH    = 1 << 19, // g    Global search.    global
-    RF_INDEX            = 1 << 20, // d    Generate indices for substring matches.    hasIndices
-};
+#include "JsRegExpEngine.hpp"
+
 
 bool parseRegexpFlags(const StringView &flags, uint32_t &flagsOut);
 
 class JsRegExp : public JsObjectLazy {
 public:
-    JsRegExp(const StringView &str, const std::regex &re, uint32_t flags);
+    JsRegExp(const StringView &str, const JsRegExpProgramPtr &program);
     ~JsRegExp();
 
     const string &toString() const { return _strRe; }
 
-    std::regex &getRegexp() { return _re; }
-    uint32_t flags() const { return _flags; }
+    const JsRegExpProgram &program() const { return *_program; }
+    const JsRegExpProgramPtr &programPtr() const { return _program; }
+    uint32_t flags() const { return _program->flags(); }
 
     void setLastIndex(int index);
 
@@ -47,8 +33,8 @@ protected:
     JsLazyProperty              _props[10];
 
     string                      _strRe;
-    std::regex                  _re;
-    uint32_t                    _flags;
+    // 同一个正则表达式的字面量创建的对象共享编译的结果
+    JsRegExpProgramPtr          _program;
 
 };
 
@@ -0,0 +1,1879 @@
+﻿//
+//  JsRegExpEngine.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/18.
+//
+
+#include "JsRegExpEngine.hpp"
+#include "utils/CharEncoding.h"
+#include "utils/StringEx.h"
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+
+
+enum RegOpCode : uint8_t {
+    RO_CHAR,                    // x: code point
+    RO_CHAR_I,                  // x: foldCase 之后的 code point
+    RO_ANY,                     // .
+    RO_ANY_ALL,                 // dotAll 模式下的 .
+    RO_CLASS,                   // x: _classes 的索引
+    RO_BOL,
+    RO_BOL_MULTILINE,
+    RO_EOL,
+    RO_EOL_MULTILINE,
+    RO_WORD_BOUNDARY,
+    RO_NOT_WORD_BOUNDARY,
+    RO_SAVE,                    // slots[x] = pos
+    RO_RESET,                   // slots[x, y) = -1: 量词每次循环开始时清除其中分组的结果
+    RO_CHECK_PROGRESS,          // pos 和 slots[x] 相同(循环匹配了空字符串)则失败
+    RO_SPLIT,                   // 优先尝试 x, 失败后再尝试 y
+    RO_JMP,                     // 跳转到 x
+    RO_BACKREF,                 // x: 分组
+    RO_BACKREF_I,
+    RO_LOOK,                    // y: LookKind, z: lookbehind 最多匹配的字符数. 子程序从下一条指令开始，到 x 之前的 RO_LOOK_END 结束
+    RO_LOOK_END,
+    RO_MATCH,
+};
+
+enum LookKind {
+    LK_AHEAD,
+    LK_NEGATIVE_AHEAD,
+    LK_BEHIND,
+    LK_NEGATIVE_BEHIND,
+};
+
+enum RegNodeType : uint8_t {
+    RN_EMPTY,
+    RN_CHAR,
+    RN_ANY,
+    RN_CLASS,
+    RN_BOL,
+    RN_EOL,
+    RN_WORD_BOUNDARY,
+    RN_NOT_WORD_BOUNDARY,
+    RN_GROUP,
+    RN_BACKREF,
+    RN_LOOK,
+    RN_CONCAT,
+    RN_ALT,
+    RN_REPEAT,
+};
+
+const uint32_t REGEXP_INFINITE = 0xFFFFFFFF;
+const uint32_t MAX_REGEXP_INSTS = 100000;
+const uint32_t MAX_REGEXP_DEPTH = 500;
+
+// 回溯的步数限制，超过后改用 Pike VM
+const int64_t BACKTRACK_STEPS_BASE = 100000;
+const int64_t BACKTRACK_STEPS_PER_CHAR = 64;
+
+using VecRanges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+static const uint32_t RANGES_DIGIT[] = { '0', '9' };
+static const uint32_t RANGES_WORD[] = { '0', '9', 'A', 'Z', '_', '_', 'a', 'z' };
+static const uint32_t RANGES_SPACE[] = { 0x9, 0xD, ' ', ' ', 0xA0, 0xA0, 0x1680, 0x1680, 0x2000, 0x200A,
+    0x2028, 0x2029, 0x202F, 0x202F, 0x205F, 0x205F, 0x3000, 0x3000, 0xFEFF, 0xFEFF };
+
+struct CaseFoldBlock {
+    uint32_t                    upperStart, upperEnd, delta;
+};
+
+// 大写字母到小写字母的映射
+static const CaseFoldBlock CASE_FOLD_BLOCKS[] = {
+    { 'A', 'Z', 32 },
+    { 0xC0, 0xD6, 32 }, { 0xD8, 0xDE, 32 },
+    { 0x391, 0x3A1, 32 }, { 0x3A3, 0x3AB, 32 },
+    { 0x410, 0x42F, 32 }, { 0x400, 0x40F, 80 },
+};
+
+static inline uint32_t foldCase(uint32_t c) {
+    if (c < 0xC0) {
+        return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+    }
+
+    for (auto &block : CASE_FOLD_BLOCKS) {
+        if (c >= block.upperStart && c <= block.upperEnd) {
+            return c + block.delta;
+        }
+    }
+
+    // ς 和 σ 的大写都是 Σ
+    return c == 0x3C2 ? 0x3C3 : c;
+}
+
+static inline uint32_t decodeUtf8(const uint8_t *p, const uint8_t *end, uint32_t &lenOut) {
+    uint32_t c = *p;
+    if (c < 0x80) {
+        lenOut = 1;
+        return c;
+    } else if (c >= 0xC0 && c < 0xE0 && p + 1 < end) {
+        lenOut = 2;
+        return ((c & 0x1F) << 6) | (p[1] & 0x3F);
+    } else if (c >= 0xE0 && c < 0xF0 && p + 2 < end) {
+        lenOut = 3;
+        return ((c & 0xF) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+    } else if (c >= 0xF0 && c < 0xF8 && p + 3 < end) {
+        lenOut = 4;
+        return ((c & 0x7) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+    }
+
+    // 非法的 utf-8 编码按照单个字节处理
+    lenOut = 1;
+    return c;
+}
+
+static inline uint32_t nextCharPos(const uint8_t *str, uint32_t len, uint32_t pos) {
+    pos++;
+    while (pos < len && (str[pos] & 0xC0) == 0x80) {
+        pos++;
+    }
+    return pos;
+}
+
+static inline uint32_t prevCharPos(const uint8_t *str, uint32_t pos) {
+    assert(pos > 0);
+    pos--;
+    while (pos > 0 && (str[pos] & 0xC0) == 0x80) {
+        pos--;
+    }
+    return pos;
+}
+
+static inline bool isLineTerminator(uint32_t c) {
+    return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029;
+}
+
+// \u2028 和 \u2029 的 utf-8 编码为: E2 80 A8, E2 80 A9
+static inline bool isLineTerminatorAt(const uint8_t *str, uint32_t len, uint32_t pos) {
+    auto c = str[pos];
+    return c == '\n' || c == '\r' || (c == 0xE2 && pos + 2 < len && str[pos + 1] == 0x80 && (str[pos + 2] & 0xFE) == 0xA8);
+}
+
+static inline bool isLineTerminatorBefore(const uint8_t *str, uint32_t pos) {
+    auto c = str[pos - 1];
+    return c == '\n' || c == '\r' || ((c & 0xFE) == 0xA8 && pos >= 3 && str[pos - 3] == 0xE2 && str[pos - 2] == 0x80);
+}
+
+static inline bool isWordChar(uint8_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool isHexChar(uint8_t c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static inline uint32_t hexValue(uint8_t c) {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+static bool matchAssertion(uint8_t op, const uint8_t *str, uint32_t len, uint32_t pos) {
+    switch (op) {
+        case RO_BOL: return pos == 0;
+        case RO_BOL_MULTILINE: return pos == 0 || isLineTerminatorBefore(str, pos);
+        case RO_EOL: return pos == len;
+        case RO_EOL_MULTILINE: return pos == len || isLineTerminatorAt(str, len, pos);
+        case RO_WORD_BOUNDARY:
+        case RO_NOT_WORD_BOUNDARY: {
+            bool before = pos > 0 && isWordChar(str[pos - 1]);
+            bool after = pos < len && isWordChar(str[pos]);
+            return (before != after) == (op == RO_WORD_BOUNDARY);
+        }
+        default:
+            assert(0);
+            return false;
+    }
+}
+
+static void normalizeRanges(VecRanges &ranges) {
+    if (ranges.empty()) {
+        return;
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+
+    size_t count = 0;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        auto &last = ranges[count];
+        auto &r = ranges[i];
+        if (r.first <= last.second + 1) {
+            last.second = std::max(last.second, r.second);
+        } else {
+            ranges[++count] = r;
+        }
+    }
+    ranges.resize(count + 1);
+}
+
+static void addRanges(VecRanges &ranges, const uint32_t *arr, size_t count, bool isNegated) {
+    if (!isNegated) {
+        for (size_t i = 0; i < count; i += 2) {
+            ranges.push_back({ arr[i], arr[i + 1] });
+        }
+        return;
+    }
+
+    uint32_t start = 0;
+    for (size_t i = 0; i < count; i += 2) {
+        if (arr[i] > start) {
+            ranges.push_back({ start, arr[i] - 1 });
+        }
+        start = arr[i + 1] + 1;
+    }
+    ranges.push_back({ start, 0x10FFFF });
+}
+
+// 添加 \d, \w, \s 及其取反的字符集
+static void addPredefinedRanges(VecRanges &ranges, uint8_t name) {
+    auto lower = name | 0x20;
+    bool isNegated = name != lower;
+    if (lower == 'd') {
+        addRanges(ranges, RANGES_DIGIT, CountOf(RANGES_DIGIT), isNegated);
+    } else if (lower == 'w') {
+        addRanges(ranges, RANGES_WORD, CountOf(RANGES_WORD), isNegated);
+    } else {
+        assert(lower == 's');
+        addRanges(ranges, RANGES_SPACE, CountOf(RANGES_SPACE), isNegated);
+    }
+}
+
+bool RegCharClass::contains(uint32_t c) const {
+    if (c < 128) {
+        return (ascii[c >> 5] >> (c & 31)) & 1;
+    }
+
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), c, [](uint32_t c, const std::pair<uint32_t, uint32_t> &r) {
+        return c < r.first;
+    });
+    return it != ranges.begin() && c <= (it - 1)->second;
+}
+
+struct RegNode {
+    RegNodeType                 type;
+    bool                        isGreedy = true;
+
+    // RN_CHAR: code point, RN_CLASS: 字符集的索引, RN_GROUP: 分组(0 为不捕获的分组),
+    // RN_BACKREF: 引用的分组, RN_LOOK: LookKind
+    uint32_t                    value = 0;
+
+    // RN_REPEAT 的次数，以及其中包含的分组 [firstGroup, endGroup)
+    uint32_t                    min = 0, max = 0;
+    uint32_t                    firstGroup = 0, endGroup = 0;
+
+    std::vector<RegNode *>      children;
+};
+
+/**
+ * 将正则表达式解析为语法树，再生成 JsRegExpProgram 的 bytecode.
+ */
+class RegExpCompiler {
+public:
+    RegExpCompiler(const StringView &pattern, uint32_t flags, JsRegExpProgram *program) : _program(program) {
+        _p = (const uint8_t *)pattern.data;
+        _end = _p + pattern.len;
+        _isUnicode = isFlagSet(flags, RF_UNICODE);
+        _isIgnoreCase = isFlagSet(flags, RF_CASE_INSENSITIVE);
+        _isMultiline = isFlagSet(flags, RF_MULTILINE);
+        _isDotAll = isFlagSet(flags, RF_DOT_ALL);
+    }
+
+    bool compile(string &errorOut);
+
+protected:
+    RegNode *newNode(RegNodeType type, uint32_t value = 0) {
+        _nodes.emplace_back();
+        auto node = &_nodes.back();
+        node->type = type;
+        node->value = value;
+        return node;
+    }
+
+    RegNode *fail(cstr_t message) {
+        if (_error.empty()) {
+            _error = message;
+        }
+        return nullptr;
+    }
+
+    void prescanGroups();
+
+    RegNode *parseDisjunction();
+    RegNode *parseAlternative();
+    RegNode *parseTerm();
+    RegNode *parseQuantifier(RegNode *atom, uint32_t firstGroup, bool isQuantifiable);
+    bool parseBraceQuantifier(uint32_t &min, uint32_t &max);
+    RegNode *parseGroup(bool &isQuantifiable);
+    bool parseGroupName(string &nameOut);
+    RegNode *parseAtomEscape();
+    RegNode *parseClass();
+    bool parseClassAtom(uint32_t &c, VecRanges &ranges, bool &isSetOut);
+    bool parseCharEscape(bool isInClass, uint32_t &c);
+    uint32_t parseLegacyOctal();
+    uint32_t readChar();
+
+    uint32_t addClass(VecRanges &ranges, bool isNegated);
+
+    uint32_t emit(uint8_t op, uint32_t x = 0, uint32_t y = 0, uint32_t z = 0);
+    void generate(RegNode *node);
+    void generateRepeat(RegNode *node);
+
+    static bool canBeEmpty(RegNode *node);
+    static uint32_t maxLength(RegNode *node);
+    static bool collectPrefix(RegNode *node, string &prefix);
+    bool collectFirstBytes(RegNode *node, uint32_t *bytes);
+    static bool startsWithBol(RegNode *node);
+
+protected:
+    JsRegExpProgram             *_program;
+    const uint8_t               *_p, *_end;
+    bool                        _isUnicode, _isIgnoreCase, _isMultiline, _isDotAll;
+
+    std::deque<RegNode>         _nodes;
+    uint32_t                    _depth = 0;
+
+    // 预先扫描的分组数量(不包括第 0 个)，用于区分反向引用和八进制转义
+    uint32_t                    _countGroupsPrescanned = 0;
+    bool                        _hasNamedGroupsPrescanned = false;
+    std::vector<std::pair<RegNode *, string>> _namedBackrefs;
+
+    uint32_t                    _countRegisters = 0;
+    string                      _error;
+
+};
+
+bool RegExpCompiler::compile(string &errorOut) {
+    prescanGroups();
+
+    auto root = parseDisjunction();
+    if (root && _p < _end) {
+        assert(*_p == ')');
+        fail("Unmatched ')'");
+    }
+
+    auto program = _program;
+    program->_groupNames.resize(program->_countGroups);
+
+    if (_error.empty()) {
+        for (auto &item : _namedBackrefs) {
+            auto index = program->findGroup(item.second);
+            if (index < 0) {
+                fail("Invalid named capture referenced");
+                break;
+            }
+            item.first->value = index;
+        }
+    }
+
+    if (_error.empty()) {
+        emit(RO_SAVE, 0);
+        generate(root);
+        emit(RO_SAVE, 1);
+        emit(RO_MATCH);
+    }
+
+    if (!_error.empty()) {
+        errorOut = _error;
+        return false;
+    }
+
+    program->_countSlots = program->_countGroups * 2 + _countRegisters;
+    program->_isAnchored = !_isMultiline && startsWithBol(root);
+    if (!_isIgnoreCase) {
+        collectPrefix(root, program->_prefix);
+    }
+    if (program->_prefix.empty()) {
+        auto bytes = program->_firstBytes;
+        memset(bytes, 0, sizeof(program->_firstBytes));
+        if (!collectFirstBytes(root, bytes)) {
+            // 所有的字节都可能开始匹配时不需要
+            program->_hasFirstBytes = std::any_of(bytes, bytes + 8, [](uint32_t n) { return n != 0xFFFFFFFF; });
+        }
+    }
+
+    return true;
+}
+
+void RegExpCompiler::prescanGroups() {
+    bool isInClass = false;
+
+    for (auto p = _p; p < _end; p++) {
+        auto c = *p;
+        if (c == '\\') {
+            p++;
+        } else if (c == '[') {
+            isInClass = true;
+        } else if (c == ']') {
+            isInClass = false;
+        } else if (c == '(' && !isInClass) {
+            if (p + 1 < _end && p[1] == '?') {
+                // (?<name>
+                if (p + 3 < _end && p[2] == '<' && p[3] != '=' && p[3] != '!') {
+                    _countGroupsPrescanned++;
+                    _hasNamedGroupsPrescanned = true;
+                }
+            } else {
+                _countGroupsPrescanned++;
+            }
+        }
+    }
+}
+
+RegNode *RegExpCompiler::parseDisjunction() {
+    auto node = parseAlternative();
+    if (!node || _p >= _end || *_p != '|') {
+        return node;
+    }
+
+    auto alt = newNode(RN_ALT);
+    alt->children.push_back(node);
+    while (_p < _end && *_p == '|') {
+        _p++;
+        node = parseAlternative();
+        if (!node) {
+            return nullptr;
+        }
+        alt->children.push_back(node);
+    }
+
+    return alt;
+}
+
+RegNode *RegExpCompiler::parseAlternative() {
+    auto concat = newNode(RN_CONCAT);
+
+    while (_p < _end && *_p != '|' && *_p != ')') {
+        auto term = parseTerm();
+        if (!term) {
+            return nullptr;
+        }
+        concat->children.push_back(term);
+    }
+
+    return concat;
+}
+
+RegNode *RegExpCompiler::parseTerm() {
+    auto firstGroup = _program->_countGroups;
+    bool isQuantifiable = true;
+    RegNode *atom;
+
+    switch (*_p) {
+        case '^':
+            _p++;
+            return newNode(RN_BOL);
+        case '$':
+            _p++;
+            return newNode(RN_EOL);
+        case '\\':
+            if (_p + 1 < _end && (_p[1] == 'b' || _p[1] == 'B')) {
+                auto type = _p[1] == 'b' ? RN_WORD_BOUNDARY : RN_NOT_WORD_BOUNDARY;
+                _p += 2;
+                return newNode(type);
+            }
+            _p++;
+            atom = parseAtomEscape();
+            break;
+        case '(':
+            atom = parseGroup(isQuantifiable);
+            break;
+        case '.':
+            _p++;
+            atom = newNode(RN_ANY);
+            break;
+        case '[':
+            _p++;
+            atom = parseClass();
+            break;
+        case '*':
+        case '+':
+        case '?':
+            return fail("Nothing to repeat");
+        case '{': {
+            if (_isUnicode) {
+                return fail("Lone quantifier brackets");
+            }
+            uint32_t min, max;
+            if (parseBraceQuantifier(min, max)) {
+                return fail("Nothing to repeat");
+            }
+            // 不是量词的 { 作为普通字符
+            _p++;
+            atom = newNode(RN_CHAR, '{');
+            break;
+        }
+        case ']':
+        case '}':
+            if (_isUnicode) {
+                return fail("Lone quantifier brackets");
+            }
+            atom = newNode(RN_CHAR, readChar());
+            break;
+        default:
+            atom = newNode(RN_CHAR, readChar());
+            break;
+    }
+
+    if (!atom) {
+        return nullptr;
+    }
+
+    return parseQuantifier(atom, firstGroup, isQuantifiable);
+}
+
+RegNode *RegExpCompiler::parseQuantifier(RegNode *atom, uint32_t firstGroup, bool isQuantifiable) {
+    if (_p >= _end) {
+        return atom;
+    }
+
+    uint32_t min, max;
+    switch (*_p) {
+        case '*': min = 0; max = REGEXP_INFINITE; _p++; break;
+        case '+': min = 1; max = REGEXP_INFINITE; _p++; break;
+        case '?': min = 0; max = 1; _p++; break;
+        case '{':
+            if (!parseBraceQuantifier(min, max)) {
+                return atom;
+            }
+            if (min > max) {
+                return fail("numbers out of order in {} quantifier");
+            }
+            break;
+        default:
+            return atom;
+    }
+
+    if (!isQuantifiable) {
+        return fail("Invalid quantifier");
+    }
+
+    auto node = newNode(RN_REPEAT);
+    node->children.push_back(atom);
+    node->min = min;
+    node->max = max;
+    node->firstGroup = firstGroup;
+    node->endGroup = _program->_countGroups;
+
+    if (_p < _end && *_p == '?') {
+        node->isGreedy = false;
+        _p++;
+    }
+
+    return node;
+}
+
+// 解析 {n}, {n,}, {n,m}, 格式不正确时返回 false, 并且不移动 _p
+bool RegExpCompiler::parseBraceQuantifier(uint32_t &min, uint32_t &max) {
+    assert(*_p == '{');
+    auto p = _p + 1;
+
+    auto readNumber = [&p, this](uint32_t &n) {
+        if (p >= _end || !isDigit(*p)) {
+            return false;
+        }
+        uint64_t value = 0;
+        while (p < _end && isDigit(*p)) {
+            value = std::min(value * 10 + (*p - '0'), (uint64_t)REGEXP_INFINITE - 1);
+            p++;
+        }
+        n = (uint32_t)value;
+        return true;
+    };
+
+    if (!readNumber(min)) {
+        return false;
+    }
+
+    max = min;
+    if (p < _end && *p == ',') {
+        p++;
+        if (!readNumber(max)) {
+            max = REGEXP_INFINITE;
+        }
+    }
+
+    if (p >= _end || *p != '}') {
+        return false;
+    }
+
+    _p = p + 1;
+    return true;
+}
+
+RegNode *RegExpCompiler::parseGroup(bool &isQuantifiable) {
+    assert(*_p == '(');
+    _p++;
+
+    if (++_depth > MAX_REGEXP_DEPTH) {
+        return fail("Regular expression too large");
+    }
+
+    auto program = _program;
+    RegNode *node;
+
+    if (_p < _end && *_p == '?') {
+        auto c = _p + 1 < _end ? _p[1] : 0;
+        if (c == ':') {
+            _p += 2;
+            node = newNode(RN_GROUP, 0);
+        } else if (c == '=' || c == '!') {
+            _p += 2;
+            node = newNode(RN_LOOK, c == '=' ? LK_AHEAD : LK_NEGATIVE_AHEAD);
+            // Annex B: 非 unicode 模式下 lookahead 可以有量词
+            isQuantifiable = !_isUnicode;
+            program->_canUsePikeVM = false;
+        } else if (c == '<' && _p + 2 < _end && (_p[2] == '=' || _p[2] == '!')) {
+            node = newNode(RN_LOOK, _p[2] == '=' ? LK_BEHIND : LK_NEGATIVE_BEHIND);
+            _p += 3;
+            isQuantifiable = false;
+            program->_canUsePikeVM = false;
+        } else if (c == '<') {
+            _p += 2;
+            string name;
+            if (!parseGroupName(name)) {
+                return nullptr;
+            }
+            if (program->findGroup(name) != -1) {
+                return fail("Duplicate capture group name");
+            }
+
+            auto index = program->_countGroups++;
+            program->_groupNames.resize(index + 1);
+            program->_groupNames[index] = name;
+            program->_hasNamedGroups = true;
+            node = newNode(RN_GROUP, index);
+        } else {
+            return fail("Invalid group");
+        }
+    } else {
+        node = newNode(RN_GROUP, program->_countGroups++);
+    }
+
+    auto child = parseDisjunction();
+    if (!child) {
+        return nullptr;
+    }
+
+    if (_p >= _end || *_p != ')') {
+        return fail("Unterminated group");
+    }
+    _p++;
+    _depth--;
+
+    node->children.push_back(child);
+    return node;
+}
+
+bool RegExpCompiler::parseGroupName(string &nameOut) {
+    auto start = _p;
+    while (_p < _end && *_p != '>') {
+        auto c = *_p;
+        if (!(isWordChar(c) || c == '$' || c >= 0x80) || (_p == start && isDigit(c))) {
+            break;
+        }
+        _p++;
+    }
+
+    if (_p >= _end || *_p != '>' || _p == start) {
+        fail("Invalid capture group name");
+        return false;
+    }
+
+    nameOut.assign((cstr_t)start, _p - start);
+    _p++;
+    return true;
+}
+
+RegNode *RegExpCompiler::parseAtomEscape() {
+    if (_p >= _end) {
+        return fail("\\ at end of pattern");
+    }
+
+    auto c = *_p;
+    switch (c) {
+        case 'd': case 'D': case 'w': case 'W': case 's': case 'S': {
+            _p++;
+            VecRanges ranges;
+            addPredefinedRanges(ranges, c);
+            return newNode(RN_CLASS, addClass(ranges, false));
+        }
+        case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
+            auto start = _p;
+            uint32_t n = 0;
+            while (_p < _end && isDigit(*_p) && n < 100000) {
+                n = n * 10 + (*_p++ - '0');
+            }
+            if (n <= _countGroupsPrescanned) {
+                _program->_canUsePikeVM = false;
+                return newNode(RN_BACKREF, n);
+            }
+            if (_isUnicode) {
+                return fail("Invalid escape");
+            }
+
+            // Annex B: 没有对应的分组时为八进制转义
+            _p = start;
+            break;
+        }
+        case 'k':
+            if (_isUnicode || _hasNamedGroupsPrescanned) {
+                _p++;
+                string name;
+                if (_p >= _end || *_p != '<') {
+                    return fail("Invalid named reference");
+                }
+                _p++;
+                if (!parseGroupName(name)) {
+                    return nullptr;
+                }
+                _program->_canUsePikeVM = false;
+                auto node = newNode(RN_BACKREF, 0);
+                _namedBackrefs.push_back({ node, name });
+                return node;
+            }
+            break;
+        default:
+            break;
+    }
+
+    uint32_t code;
+    if (!parseCharEscape(false, code)) {
+        return nullptr;
+    }
+    return newNode(RN_CHAR, code);
+}
+
+RegNode *RegExpCompiler::parseClass() {
+    bool isNegated = false;
+    if (_p < _end && *_p == '^') {
+        isNegated = true;
+        _p++;
+    }
+
+    VecRanges ranges;
+    while (true) {
+        if (_p >= _end) {
+            return fail("Unterminated character class");
+        }
+        if (*_p == ']') {
+            _p++;
+            break;
+        }
+
+        uint32_t first;
+        bool isSet;
+        if (!parseClassAtom(first, ranges, isSet)) {
+            return nullptr;
+        }
+
+        if (_p + 1 < _end && *_p == '-' && _p[1] != ']') {
+            _p++;
+            uint32_t last;
+            bool isSet2;
+            if (!parseClassAtom(last, ranges, isSet2)) {
+                return nullptr;
+            }
+
+            if (isSet || isSet2) {
+                if (_isUnicode) {
+                    return fail("Invalid character class");
+                }
+                // Annex B: [\d-z] 中的 - 为普通字符
+                ranges.push_back({ '-', '-' });
+                if (!isSet) {
+                    ranges.push_back({ first, first });
+                }
+                if (!isSet2) {
+                    ranges.push_back({ last, last });
+                }
+            } else {
+                if (first > last) {
+                    return fail("Range out of order in character class");
+                }
+                ranges.push_back({ first, last });
+            }
+        } else if (!isSet) {
+            ranges.push_back({ first, first });
+        }
+    }
+
+    return newNode(RN_CLASS, addClass(ranges, isNegated));
+}
+
+bool RegExpCompiler::parseClassAtom(uint32_t &c, VecRanges &ranges, bool &isSetOut) {
+    isSetOut = false;
+    if (*_p != '\\') {
+        c = readChar();
+        return true;
+    }
+
+    _p++;
+    if (_p >= _end) {
+        fail("\\ at end of pattern");
+        return false;
+    }
+
+    auto name = *_p;
+    auto lower = name | 0x20;
+    if (lower == 'd' || lower == 'w' || lower == 's') {
+        _p++;
+        addPredefinedRanges(ranges, name);
+        isSetOut = true;
+        return true;
+    }
+
+    return parseCharEscape(true, c);
+}
+
+// 解析 \ 之后的字符转义
+bool RegExpCompiler::parseCharEscape(bool isInClass, uint32_t &c) {
+    assert(_p < _end);
+    auto start = _p;
+    c = *_p++;
+
+    switch (c) {
+        case 't': c = '\t'; return true;
+        case 'n': c = '\n'; return true;
+        case 'v': c = '\v'; return true;
+        case 'f': c = '\f'; return true;
+        case 'r': c = '\r'; return true;
+        case 'b':
+            if (isInClass) {
+                c = '\b';
+                return true;
+            }
+            break;
+        case '-':
+            if (isInClass) {
+                return true;
+            }
+            break;
+        case 'c':
+            if (_p < _end && (isAlpha(*_p) || (isInClass && !_isUnicode && (isDigit(*_p) || *_p == '_')))) {
+                c = *_p++ % 32;
+                return true;
+            }
+            if (_isUnicode) {
+                fail("Invalid unicode escape");
+                return false;
+            }
+            // Annex B: \ 作为普通字符
+            _p = start;
+            c = '\\';
+            return true;
+        case '0':
+            if (_p >= _end || !isDigit(*_p)) {
+                c = 0;
+                return true;
+            }
+            if (_isUnicode) {
+                fail("Invalid decimal escape");
+                return false;
+            }
+            _p = start;
+            c = parseLegacyOctal();
+            return true;
+        case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+            if (_isUnicode) {
+                fail(isInClass ? "Invalid class escape" : "Invalid escape");
+                return false;
+            }
+            _p = start;
+            c = parseLegacyOctal();
+            return true;
+        case 'x':
+            if (_p + 1 < _end && isHexChar(_p[0]) && isHexChar(_p[1])) {
+                c = hexValue(_p[0]) * 16 + hexValue(_p[1]);
+                _p += 2;
+                return true;
+            }
+            if (_isUnicode) {
+                fail("Invalid escape");
+                return false;
+            }
+            return true;
+        case 'u': {
+            if (_isUnicode && _p < _end && *_p == '{') {
+                auto p = _p + 1;
+                uint32_t code = 0;
+                while (p < _end && isHexChar(*p) && code <= 0x10FFFF) {
+                    code = code * 16 + hexValue(*p++);
+                }
+                if (p >= _end || *p != '}' || p == _p + 1 || code > 0x10FFFF) {
+                    fail("Invalid Unicode escape");
+                    return false;
+                }
+                _p = p + 1;
+                c = code;
+                return true;
+            }
+
+            auto readHex4 = [this](const uint8_t *p, uint32_t &code) {
+                if (p + 4 > _end || !isHexChar(p[0]) || !isHexChar(p[1]) || !isHexChar(p[2]) || !isHexChar(p[3])) {
+                    return false;
+                }
+                code = (hexValue(p[0]) << 12) | (hexValue(p[1]) << 8) | (hexValue(p[2]) << 4) | hexValue(p[3]);
+                return true;
+            };
+
+            if (readHex4(_p, c)) {
+                _p += 4;
+                uint32_t low;
+                if (c >= 0xD800 && c <= 0xDBFF && _p + 1 < _end && _p[0] == '\\' && _p[1] == 'u'
+                    && readHex4(_p + 2, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    // surrogate pair 合并为一个 code point
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    _p += 6;
+                }
+                return true;
+            }
+            if (_isUnicode) {
+                fail("Invalid Unicode escape");
+                return false;
+            }
+            return true;
+        }
+        default:
+            break;
+    }
+
+    if (_isUnicode && c < 0x80 && (isAlpha(c) || isDigit(c))) {
+        fail(isInClass ? "Invalid class escape" : "Invalid escape");
+        return false;
+    }
+
+    // identity escape
+    _p = start;
+    c = readChar();
+    return true;
+}
+
+// Annex B: 最多 3 位的八进制数，且不超过 0377
+uint32_t RegExpCompiler::parseLegacyOctal() {
+    uint32_t value = 0;
+    for (int i = 0; i < 3 && _p < _end && *_p >= '0' && *_p <= '7'; i++) {
+        auto next = value * 8 + (*_p - '0');
+        if (next > 0377) {
+            break;
+        }
+        value = next;
+        _p++;
+    }
+    return value;
+}
+
+uint32_t RegExpCompiler::readChar() {
+    assert(_p < _end);
+    uint32_t len;
+    auto c = decodeUtf8(_p, _end, len);
+    _p += len;
+    return c;
+}
+
+uint32_t RegExpCompiler::addClass(VecRanges &ranges, bool isNegated) {
+    normalizeRanges(ranges);
+
+    if (_isIgnoreCase) {
+        // 加入大小写对应的字符
+        auto count = ranges.size();
+        for (size_t i = 0; i < count; i++) {
+            auto r = ranges[i];
+            for (auto &block : CASE_FOLD_BLOCKS) {
+                auto first = std::max(r.first, block.upperStart), last = std::min(r.second, block.upperEnd);
+                if (first <= last) {
+                    ranges.push_back({ first + block.delta, last + block.delta });
+                }
+                first = std::max(r.first, block.upperStart + block.delta);
+                last = std::min(r.second, block.upperEnd + block.delta);
+                if (first <= last) {
+                    ranges.push_back({ first - block.delta, last - block.delta });
+                }
+            }
+            if (r.first <= 0x3C3 && r.second >= 0x3C2) {
+                ranges.push_back({ 0x3A3, 0x3A3 });
+                ranges.push_back({ 0x3C2, 0x3C3 });
+            }
+        }
+        normalizeRanges(ranges);
+    }
+
+    if (isNegated) {
+        VecRanges negated;
+        uint32_t start = 0;
+        for (auto &r : ranges) {
+            if (r.first > start) {
+                negated.push_back({ start, r.first - 1 });
+            }
+            start = r.second + 1;
+        }
+        if (start <= 0x10FFFF) {
+            negated.push_back({ start, 0x10FFFF });
+        }
+        ranges.swap(negated);
+    }
+
+    RegCharClass cls;
+    memset(cls.ascii, 0, sizeof(cls.ascii));
+    for (auto &r : ranges) {
+        for (auto c = r.first; c <= r.second && c < 128; c++) {
+            cls.ascii[c >> 5] |= 1 << (c & 31);
+        }
+        if (r.second >= 128) {
+            cls.ranges.push_back({ std::max(r.first, (uint32_t)128), r.second });
+        }
+    }
+
+    auto &classes = _program->_classes;
+    classes.push_back(cls);
+    return (uint32_t)classes.size() - 1;
+}
+
+uint32_t RegExpCompiler::emit(uint8_t op, uint32_t x, uint32_t y, uint32_t z) {
+    auto &insts = _program->_insts;
+    insts.push_back({ op, x, y, z });
+    return (uint32_t)insts.size() - 1;
+}
+
+void RegExpCompiler::generate(RegNode *node) {
+    auto &insts = _program->_insts;
+    if (insts.size() > MAX_REGEXP_INSTS) {
+        fail("Regular expression too large");
+        return;
+    }
+
+    switch (node->type) {
+        case RN_EMPTY:
+            break;
+        case RN_CHAR:
+            if (_isIgnoreCase) {
+                emit(RO_CHAR_I, foldCase(node->value));
+            } else {
+                emit(RO_CHAR, node->value);
+            }
+            break;
+        case RN_ANY:
+            emit(_isDotAll ? RO_ANY_ALL : RO_ANY);
+            break;
+        case RN_CLASS:
+            emit(RO_CLASS, node->value);
+            break;
+        case RN_BOL:
+            emit(_isMultiline ? RO_BOL_MULTILINE : RO_BOL);
+            break;
+        case RN_EOL:
+            emit(_isMultiline ? RO_EOL_MULTILINE : RO_EOL);
+            break;
+        case RN_WORD_BOUNDARY:
+            emit(RO_WORD_BOUNDARY);
+            break;
+        case RN_NOT_WORD_BOUNDARY:
+            emit(RO_NOT_WORD_BOUNDARY);
+            break;
+        case RN_GROUP:
+            if (node->value) {
+                emit(RO_SAVE, node->value * 2);
+                generate(node->children[0]);
+                emit(RO_SAVE, node->value * 2 + 1);
+            } else {
+                generate(node->children[0]);
+            }
+            break;
+        case RN_BACKREF:
+            emit(_isIgnoreCase ? RO_BACKREF_I : RO_BACKREF, node->value);
+            break;
+        case RN_LOOK: {
+            auto look = emit(RO_LOOK, 0, node->value, maxLength(node->children[0]));
+            generate(node->children[0]);
+            emit(RO_LOOK_END);
+            insts[look].x = (uint32_t)insts.size();
+            break;
+        }
+        case RN_CONCAT:
+            for (auto child : node->children) {
+                generate(child);
+            }
+            break;
+        case RN_ALT: {
+            std::vector<uint32_t> jumps;
+            auto count = node->children.size();
+            for (size_t i = 0; i < count; i++) {
+                if (i + 1 < count) {
+                    auto split = emit(RO_SPLIT);
+                    generate(node->children[i]);
+                    jumps.push_back(emit(RO_JMP));
+                    insts[split].x = split + 1;
+                    insts[split].y = (uint32_t)insts.size();
+                } else {
+                    generate(node->children[i]);
+                }
+            }
+            for (auto jump : jumps) {
+                insts[jump].x = (uint32_t)insts.size();
+            }
+            break;
+        }
+        case RN_REPEAT:
+            generateRepeat(node);
+            break;
+    }
+}
+
+void RegExpCompiler::generateRepeat(RegNode *node) {
+    auto &insts = _program->_insts;
+    auto child = node->children[0];
+    bool hasGroups = node->endGroup > node->firstGroup;
+    auto resetFrom = node->firstGroup * 2, resetTo = node->endGroup * 2;
+
+    for (uint32_t i = 0; i < node->min && _error.empty(); i++) {
+        if (hasGroups) {
+            emit(RO_RESET, resetFrom, resetTo);
+        }
+        generate(child);
+    }
+
+    if (node->max == REGEXP_INFINITE) {
+        // 可能匹配空字符串的循环，需要检查每次循环是否有进展
+        bool isNullable = canBeEmpty(child);
+        uint32_t reg = isNullable ? _program->_countGroups * 2 + _countRegisters++ : 0;
+
+        auto split = emit(RO_SPLIT);
+        if (isNullable) {
+            emit(RO_SAVE, reg);
+        }
+        if (hasGroups) {
+            emit(RO_RESET, resetFrom, resetTo);
+        }
+        generate(child);
+        if (isNullable) {
+            emit(RO_CHECK_PROGRESS, reg);
+        }
+        emit(RO_JMP, split);
+
+        auto exit = (uint32_t)insts.size();
+        insts[split].x = node->isGreedy ? split + 1 : exit;
+        insts[split].y = node->isGreedy ? exit : split + 1;
+    } else {
+        std::vector<uint32_t> splits;
+        for (uint32_t i = node->min; i < node->max && _error.empty(); i++) {
+            splits.push_back(emit(RO_SPLIT));
+            if (hasGroups) {
+                emit(RO_RESET, resetFrom, resetTo);
+            }
+            generate(child);
+        }
+
+        auto exit = (uint32_t)insts.size();
+        for (auto split : splits) {
+            insts[split].x = node->isGreedy ? split + 1 : exit;
+            insts[split].y = node->isGreedy ? exit : split + 1;
+        }
+    }
+}
+
+bool RegExpCompiler::canBeEmpty(RegNode *node) {
+    switch (node->type) {
+        case RN_CHAR:
+        case RN_ANY:
+        case RN_CLASS:
+            return false;
+        case RN_GROUP:
+            return canBeEmpty(node->children[0]);
+        case RN_CONCAT:
+            for (auto child : node->children) {
+                if (!canBeEmpty(child)) {
+                    return false;
+                }
+            }
+            return true;
+        case RN_ALT:
+            for (auto child : node->children) {
+                if (canBeEmpty(child)) {
+                    return true;
+                }
+            }
+            return false;
+        case RN_REPEAT:
+            return node->min == 0 || canBeEmpty(node->children[0]);
+        default:
+            return true;
+    }
+}
+
+// 最多匹配的字符数
+uint32_t RegExpCompiler::maxLength(RegNode *node) {
+    switch (node->type) {
+        case RN_CHAR:
+        case RN_ANY:
+        case RN_CLASS:
+            return 1;
+        case RN_BACKREF:
+            return REGEXP_INFINITE;
+        case RN_GROUP:
+            return maxLength(node->children[0]);
+        case RN_CONCAT:
+        case RN_ALT: {
+            uint64_t total = 0;
+            for (auto child : node->children) {
+                uint64_t n = maxLength(child);
+                total = node->type == RN_CONCAT ? total + n : std::max(total, n);
+            }
+            return (uint32_t)std::min(total, (uint64_t)REGEXP_INFINITE);
+        }
+        case RN_REPEAT: {
+            uint64_t n = maxLength(node->children[0]);
+            if (n == 0) {
+                return 0;
+            }
+            return node->max == REGEXP_INFINITE ? REGEXP_INFINITE : (uint32_t)std::min(n * node->max, (uint64_t)REGEXP_INFINITE);
+        }
+        default:
+            return 0;
+    }
+}
+
+// 收集匹配结果一定会开始的字符串，返回 true 表示 node 全部都是固定的字符串
+bool RegExpCompiler::collectPrefix(RegNode *node, string &prefix) {
+    switch (node->type) {
+        case RN_CHAR:
+            utf32CodeToUtf8(node->value, prefix);
+            return true;
+        case RN_GROUP:
+            return collectPrefix(node->children[0], prefix);
+        case RN_CONCAT:
+            for (auto child : node->children) {
+                if (!collectPrefix(child, prefix)) {
+                    return false;
+                }
+            }
+            return true;
+        case RN_REPEAT:
+            if (node->min > 0) {
+                collectPrefix(node->children[0], prefix);
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static inline void addByteRange(uint32_t *bytes, uint32_t first, uint32_t last) {
+    for (auto b = first; b <= last; b++) {
+        bytes[b / 32] |= 1u << (b % 32);
+    }
+}
+
+// code point 的 utf-8 编码的第一个字节
+static inline uint32_t utf8LeadByte(uint32_t c) {
+    if (c < 0x80) return c;
+    if (c < 0x800) return 0xC0 | (c >> 6);
+    if (c < 0x10000) return 0xE0 | (c >> 12);
+    return 0xF0 | (c >> 18);
+}
+
+// 收集匹配结果的第一个字节的集合，返回 node 是否可以匹配空字符串
+bool RegExpCompiler::collectFirstBytes(RegNode *node, uint32_t *bytes) {
+    switch (node->type) {
+        case RN_CHAR: {
+            auto c = node->value;
+            if (!_isIgnoreCase) {
+                addByteRange(bytes, utf8LeadByte(c), utf8LeadByte(c));
+            } else if (c < 0x80) {
+                // 非 ascii 的字符不会 fold 为 ascii 字符
+                addByteRange(bytes, c, c);
+                if (isalpha(c)) {
+                    addByteRange(bytes, c ^ 0x20, c ^ 0x20);
+                }
+            } else {
+                addByteRange(bytes, 0xC0, 0xFF);
+            }
+            return false;
+        }
+        case RN_CLASS: {
+            auto &cls = _program->_classes[node->value];
+            for (int i = 0; i < 4; i++) {
+                bytes[i] |= cls.ascii[i];
+            }
+            for (auto &r : cls.ranges) {
+                if (r.second >= 0x80) {
+                    // 包含 BMP 之外的字符时，也包括非法的 utf-8 字节
+                    addByteRange(bytes, utf8LeadByte(std::max(r.first, 0x80u)), r.second > 0xFFFF ? 0xFF : utf8LeadByte(r.second));
+                }
+            }
+            return false;
+        }
+        case RN_ANY:
+        case RN_BACKREF:
+            // 反向引用可能引用 lookahead 中的分组
+            addByteRange(bytes, 0, 0xFF);
+            return node->type == RN_BACKREF;
+        case RN_GROUP:
+            return collectFirstBytes(node->children[0], bytes);
+        case RN_CONCAT:
+            for (auto child : node->children) {
+                if (!collectFirstBytes(child, bytes)) {
+                    return false;
+                }
+            }
+            return true;
+        case RN_ALT: {
+            bool canBeEmpty = false;
+            for (auto child : node->children) {
+                if (collectFirstBytes(child, bytes)) {
+                    canBeEmpty = true;
+                }
+            }
+            return canBeEmpty;
+        }
+        case RN_REPEAT:
+            return collectFirstBytes(node->children[0], bytes) || node->min == 0;
+        default:
+            // 断言和 lookaround 不消耗字符
+            return true;
+    }
+}
+
+bool RegExpCompiler::startsWithBol(RegNode *node) {
+    switch (node->type) {
+        case RN_BOL:
+            return true;
+        case RN_GROUP:
+            return startsWithBol(node->children[0]);
+        case RN_CONCAT:
+            return !node->children.empty() && startsWithBol(node->children[0]);
+        case RN_ALT:
+            for (auto child : node->children) {
+                if (!startsWithBol(child)) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::shared_ptr<JsRegExpProgram> JsRegExpProgram::compile(const StringView &pattern, uint32_t flags, string &errorOut) {
+    std::shared_ptr<JsRegExpProgram> program(new JsRegExpProgram(flags));
+
+    RegExpCompiler compiler(pattern, flags, program.get());
+    if (!compiler.compile(errorOut)) {
+        return nullptr;
+    }
+
+    return program;
+}
+
+std::shared_ptr<JsRegExpProgram> JsRegExpProgram::compileCached(const StringView &pattern, uint32_t flags, string &errorOut) {
+    const size_t MAX_CACHED = 64;
+    static thread_local std::unordered_map<string, std::shared_ptr<JsRegExpProgram>> cache;
+
+    string key = pattern.toString();
+    key.append(1, '/');
+    key.append(std::to_string(flags));
+
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return (*it).second;
+    }
+
+    auto program = compile(pattern, flags, errorOut);
+    if (program) {
+        if (cache.size() >= MAX_CACHED) {
+            cache.clear();
+        }
+        cache[key] = program;
+    }
+
+    return program;
+}
+
+int JsRegExpProgram::findGroup(const StringView &name) const {
+    for (size_t i = 1; i < _groupNames.size(); i++) {
+        if (name.equal(_groupNames[i])) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+struct BacktrackEntry {
+    // >= 0: 回溯到 pc, pos 为 value; -1: 恢复 slots[index] 为 value
+    int32_t                     pc;
+    uint32_t                    index;
+    int32_t                     value;
+};
+
+struct PikeThread {
+    uint32_t                    pc;
+    // 在 arena 中的偏移
+    uint32_t                    slots;
+};
+
+/**
+ * 执行时的临时数据，每个线程一份，避免每次匹配都分配内存
+ */
+struct JsRegExpProgram::ExecState {
+    const uint8_t               *str;
+    uint32_t                    len;
+    int64_t                     steps;
+
+    std::vector<int32_t>        slots;
+    std::vector<BacktrackEntry> stack;
+
+    // Pike VM 当前和下一个位置的线程
+    std::vector<PikeThread>     threads[2];
+    std::vector<int32_t>        arenas[2];
+    std::vector<uint32_t>       visited;
+    uint32_t                    generation;
+    std::vector<std::pair<uint32_t, uint32_t>> pending;
+};
+
+bool JsRegExpProgram::exec(const StringView &str, uint32_t start, JsRegExpMatch &matchOut) const {
+    if (start > str.len || (_isAnchored && start > 0)) {
+        return false;
+    }
+
+    static thread_local ExecState state;
+    state.str = (const uint8_t *)str.data;
+    state.len = str.len;
+    state.slots.resize(_countSlots);
+    state.steps = _canUsePikeVM ? BACKTRACK_STEPS_BASE + (str.len - start) * BACKTRACK_STEPS_PER_CHAR : INT64_MAX;
+
+    bool isSingle = _isAnchored || isFlagSet(_flags, RF_STICKY);
+    auto pos = start;
+
+    while (true) {
+        if (!isSingle) {
+            auto index = findStart(state.str, str.len, pos);
+            if (index < 0) {
+                return false;
+            }
+            pos = index;
+        }
+
+        std::fill(state.slots.begin(), state.slots.end(), -1);
+        state.stack.clear();
+
+        uint32_t end;
+        auto ret = runBacktrack(state, 0, pos, -1, end);
+        if (ret > 0) {
+            matchOut.captures.assign(state.slots.begin(), state.slots.begin() + _countGroups * 2);
+            return true;
+        } else if (ret < 0) {
+            // 回溯的步数超过了限制，改用 Pike VM 从 pos 继续查找
+            state.stack.clear();
+            return runPike(state, pos, matchOut);
+        }
+
+        if (isSingle || pos >= str.len) {
+            return false;
+        }
+        pos = nextCharPos(state.str, str.len, pos);
+    }
+}
+
+inline bool JsRegExpProgram::matchChar(const RegInst &inst, uint32_t c) const {
+    switch (inst.op) {
+        case RO_CHAR: return c == inst.x;
+        case RO_CHAR_I: return foldCase(c) == inst.x;
+        case RO_ANY: return !isLineTerminator(c);
+        case RO_ANY_ALL: return true;
+        case RO_CLASS: return _classes[inst.x].contains(c);
+        default: return false;
+    }
+}
+
+// 跳到下一个可能匹配的位置，没有返回 -1
+int JsRegExpProgram::findStart(const uint8_t *str, uint32_t len, uint32_t pos) const {
+    if (!_prefix.empty()) {
+        return StringView(str, len).strstr(StringView(_prefix), pos);
+    } else if (_hasFirstBytes) {
+        // 只会匹配非空的字符串，pos 总是在字符的开始位置
+        for (; pos < len; pos++) {
+            auto b = str[pos];
+            if (_firstBytes[b / 32] & (1u << (b % 32))) {
+                return pos;
+            }
+        }
+        return -1;
+    }
+    return pos;
+}
+
+/**
+ * 从 pc 开始回溯匹配，返回 1 表示匹配成功，0 为失败，-1 为步数超过了限制.
+ * target >= 0 时(lookbehind), 要求匹配结束的位置为 target.
+ * 失败时 stack 会恢复到调用时的状态；成功时 stack 中保留着可以回溯的记录.
+ */
+int JsRegExpProgram::runBacktrack(ExecState &state, uint32_t pc, uint32_t pos, int32_t target, uint32_t &endOut) const {
+    auto str = state.str;
+    auto len = state.len;
+    auto slots = state.slots.data();
+    auto &stack = state.stack;
+    auto base = stack.size();
+    auto insts = _insts.data();
+
+    while (true) {
+        auto &inst = insts[pc];
+        switch (inst.op) {
+            case RO_CHAR: {
+                if (pos < len) {
+                    uint32_t c = str[pos];
+                    if (c < 0x80) {
+                        if (c == inst.x) {
+                            pos++;
+                            pc++;
+                            continue;
+                        }
+                    } else {
+                        uint32_t n;
+                        if (decodeUtf8(str + pos, str + len, n) == inst.x) {
+                            pos += n;
+                            pc++;
+                            continue;
+                        }
+                    }
+                }
+                goto FAILED;
+            }
+            case RO_CHAR_I:
+            case RO_ANY:
+            case RO_ANY_ALL:
+            case RO_CLASS: {
+                if (pos < len) {
+                    uint32_t c = str[pos], n = 1;
+                    if (c >= 0x80) {
+                        c = decodeUtf8(str + pos, str + len, n);
+                    }
+                    if (matchChar(inst, c)) {
+                        pos += n;
+                        pc++;
+                        continue;
+                    }
+                }
+                goto FAILED;
+            }
+            case RO_BOL:
+            case RO_BOL_MULTILINE:
+            case RO_EOL:
+            case RO_EOL_MULTILINE:
+            case RO_WORD_BOUNDARY:
+            case RO_NOT_WORD_BOUNDARY:
+                if (!matchAssertion(inst.op, str, len, pos)) {
+                    goto FAILED;
+                }
+                pc++;
+                continue;
+            case RO_SAVE:
+                stack.push_back({ -1, inst.x, slots[inst.x] });
+                slots[inst.x] = pos;
+                pc++;
+                continue;
+            case RO_RESET:
+                for (auto i = inst.x; i < inst.y; i++) {
+                    if (slots[i] != -1) {
+                        stack.push_back({ -1, i, slots[i] });
+                        slots[i] = -1;
+                    }
+                }
+                pc++;
+                continue;
+            case RO_CHECK_PROGRESS:
+                if (slots[inst.x] == (int32_t)pos) {
+                    goto FAILED;
+                }
+                pc++;
+                continue;
+            case RO_SPLIT:
+                if (--state.steps < 0) {
+                    return -1;
+                }
+                stack.push_back({ (int32_t)inst.y, pos, 0 });
+                pc = inst.x;
+                continue;
+            case RO_JMP:
+                pc = inst.x;
+                continue;
+            case RO_BACKREF:
+            case RO_BACKREF_I: {
+                auto begin = slots[inst.x * 2], end = slots[inst.x * 2 + 1];
+                if (begin < 0 || end < 0) {
+                    // 没有匹配的分组，匹配空字符串
+                    pc++;
+                    continue;
+                }
+
+                auto n = (uint32_t)(end - begin);
+                if (inst.op == RO_BACKREF) {
+                    if (pos + n > len || memcmp(str + begin, str + pos, n) != 0) {
+                        goto FAILED;
+                    }
+                    pos += n;
+                } else {
+                    auto p1 = str + begin, end1 = str + end, p2 = str + pos, end2 = str + len;
+                    while (p1 < end1) {
+                        if (p2 >= end2) {
+                            goto FAILED;
+                        }
+                        uint32_t n1, n2;
+                        auto c1 = decodeUtf8(p1, end1, n1), c2 = decodeUtf8(p2, end2, n2);
+                        if (foldCase(c1) != foldCase(c2)) {
+                            goto FAILED;
+                        }
+                        p1 += n1;
+                        p2 += n2;
+                    }
+                    pos = (uint32_t)(p2 - str);
+                }
+                pc++;
+                continue;
+            }
+            case RO_LOOK: {
+                auto lookBase = stack.size();
+                bool isPositive = inst.y == LK_AHEAD || inst.y == LK_BEHIND;
+                uint32_t lookEnd;
+                int ret;
+
+                if (inst.y == LK_AHEAD || inst.y == LK_NEGATIVE_AHEAD) {
+                    ret = runBacktrack(state, pc + 1, pos, -1, lookEnd);
+                } else {
+                    // 向前尝试每个开始的位置，要求匹配结束于 pos
+                    auto start = pos;
+                    for (uint32_t i = 0; ; i++) {
+                        ret = runBacktrack(state, pc + 1, start, pos, lookEnd);
+                        if (ret != 0 || start == 0 || i >= inst.z) {
+                            break;
+                        }
+                        start = prevCharPos(str, start);
+                    }
+                }
+
+                if (ret < 0) {
+                    return -1;
+                }
+
+                if (ret > 0) {
+                    if (!isPositive) {
+                        while (stack.size() > lookBase) {
+                            auto &e = stack.back();
+                            if (e.pc == -1) {
+                                slots[e.index] = e.value;
+                            }
+                            stack.pop_back();
+                        }
+                        goto FAILED;
+                    }
+
+                    // 不会再回溯到 lookaround 中，只保留恢复分组的记录
+                    auto count = lookBase;
+                    for (auto i = lookBase; i < stack.size(); i++) {
+                        if (stack[i].pc == -1) {
+                            stack[count++] = stack[i];
+                        }
+                    }
+                    stack.resize(count);
+                } else if (isPositive) {
+                    goto FAILED;
+                }
+
+                pc = inst.x;
+                continue;
+            }
+            case RO_LOOK_END:
+                if (target >= 0 && pos != (uint32_t)target) {
+                    goto FAILED;
+                }
+                endOut = pos;
+                return 1;
+            case RO_MATCH:
+                endOut = pos;
+                return 1;
+            default:
+                assert(0);
+                break;
+        }
+
+FAILED:
+        while (true) {
+            if (stack.size() <= base) {
+                return 0;
+            }
+
+            auto e = stack.back();
+            stack.pop_back();
+            if (e.pc == -1) {
+                slots[e.index] = e.value;
+            } else {
+                if (--state.steps < 0) {
+                    return -1;
+                }
+                pc = e.pc;
+                pos = e.index;
+                break;
+            }
+        }
+    }
+}
+
+// 将 pc 及其 epsilon 闭包中的线程，按照优先级的顺序加入到 state.threads[next]
+void JsRegExpProgram::addPikeThread(ExecState &state, int next, uint32_t pc, const int32_t *slots, uint32_t pos) const {
+    auto &threads = state.threads[next];
+    auto &arena = state.arenas[next];
+    auto &visited = state.visited;
+    auto &pending = state.pending;
+    auto generation = state.generation;
+    auto countSlots = _countSlots;
+
+    uint32_t si = (uint32_t)arena.size();
+    arena.insert(arena.end(), slots, slots + countSlots);
+
+    pending.clear();
+    pending.push_back({ pc, si });
+    while (!pending.empty()) {
+        pc = pending.back().first;
+        si = pending.back().second;
+        pending.pop_back();
+
+        while (visited[pc] != generation) {
+            visited[pc] = generation;
+
+            auto &inst = _insts[pc];
+            switch (inst.op) {
+                case RO_JMP:
+                    pc = inst.x;
+                    continue;
+                case RO_SPLIT:
+                    pending.push_back({ inst.y, si });
+                    pc = inst.x;
+                    continue;
+                case RO_SAVE:
+                case RO_RESET: {
+                    // 修改前复制一份，其他的线程可能还在使用
+                    auto copied = (uint32_t)arena.size();
+                    arena.resize(copied + countSlots);
+                    memcpy(arena.data() + copied, arena.data() + si, countSlots * sizeof(int32_t));
+                    si = copied;
+                    if (inst.op == RO_SAVE) {
+                        arena[si + inst.x] = pos;
+                    } else {
+                        std::fill(arena.begin() + si + inst.x, arena.begin() + si + inst.y, -1);
+                    }
+                    pc++;
+                    continue;
+                }
+                case RO_CHECK_PROGRESS:
+                    if (arena[si + inst.x] == (int32_t)pos) {
+                        break;
+                    }
+                    pc++;
+                    continue;
+                case RO_BOL:
+                case RO_BOL_MULTILINE:
+                case RO_EOL:
+                case RO_EOL_MULTILINE:
+                case RO_WORD_BOUNDARY:
+                case RO_NOT_WORD_BOUNDARY:
+                    if (!matchAssertion(inst.op, state.str, state.len, pos)) {
+                        break;
+                    }
+                    pc++;
+                    continue;
+                default:
+                    // 匹配字符或者 RO_MATCH
+                    threads.push_back({ pc, si });
+                    break;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Pike VM: 同时模拟所有的线程，每个位置每条指令最多只有一个线程，所以时间和字符串的长度成线性关系.
+ * 线程按照优先级排序，RO_MATCH 时丢弃优先级更低的线程，得到和回溯相同的结果.
+ */
+bool JsRegExpProgram::runPike(ExecState &state, uint32_t start, JsRegExpMatch &matchOut) const {
+    auto str = state.str;
+    auto len = state.len;
+    bool isSingle = _isAnchored || isFlagSet(_flags, RF_STICKY);
+
+    state.visited.assign(_insts.size(), 0);
+    state.generation = 1;
+    for (int i = 0; i < 2; i++) {
+        state.threads[i].clear();
+        state.arenas[i].clear();
+    }
+
+    auto initSlots = state.slots.data();
+    std::fill(state.slots.begin(), state.slots.end(), -1);
+
+    bool isMatched = false;
+    int cur = 0;
+    auto pos = start;
+    addPikeThread(state, cur, 0, initSlots, pos);
+
+    while (true) {
+        auto &threads = state.threads[cur];
+        if (threads.empty()) {
+            if (isMatched || isSingle || pos >= len) {
+                break;
+            }
+
+            // 没有正在匹配的线程，跳到下一个可能匹配的位置
+            auto index = findStart(str, len, nextCharPos(str, len, pos));
+            if (index < 0) {
+                break;
+            }
+            pos = index;
+
+            state.generation++;
+            state.arenas[cur].clear();
+            addPikeThread(state, cur, 0, initSlots, pos);
+            continue;
+        }
+
+        uint32_t c = 0, n = 0;
+        if (pos < len) {
+            n = 1;
+            c = str[pos];
+            if (c >= 0x80) {
+                c = decodeUtf8(str + pos, str + len, n);
+            }
+        }
+
+        auto next = 1 - cur;
+        state.threads[next].clear();
+        state.arenas[next].clear();
+        state.generation++;
+
+        for (size_t i = 0; i < threads.size(); i++) {
+            auto &t = threads[i];
+            auto &inst = _insts[t.pc];
+            auto slots = state.arenas[cur].data() + t.slots;
+            if (inst.op == RO_MATCH) {
+                isMatched = true;
+                matchOut.captures.assign(slots, slots + _countGroups * 2);
+                // 优先级更低的线程不再需要
+                break;
+            }
+
+            if (n > 0 && matchChar(inst, c)) {
+                addPikeThread(state, next, t.pc + 1, slots, pos + n);
+            }
+        }
+
+        if (pos >= len) {
+            break;
+        }
+
+        cur = next;
+        pos += n;
+        if (!isMatched && !isSingle) {
+            // 优先级最低: 从新的位置开始匹配
+            addPikeThread(state, cur, 0, initSlots, pos);
+        }
+    }
+
+    return isMatched;
+}
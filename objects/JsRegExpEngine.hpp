@@ -0,0 +1,133 @@
+﻿//
+//  JsRegExpEngine.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/18.
+//
+
+#ifndef JsRegExpEngine_hpp
+#define JsRegExpEngine_hpp
+
+#include <memory>
+#include "utils/UtilsTypes.h"
+#include "utils/StringView.h"
+
+
+enum RegexpFlags {
+    RF_CASE_INSENSITIVE = 1,       // i    Case-insensitive search.    ignoreCase
+    RF_MULTILINE        = 1 << 1,  // m    Allows ^ and $ to match newline characters.    multiline
+    RF_DOT_ALL          = 1 << 2,  // s    Allows . to match newline characters.    dotAll
+    RF_UNICODE          = 1 << 3,  // u    "Unicode"; treat a pattern as a sequence of Unicode code points.    unicode
+    RF_STICKY           = 1 << 4,  // y    Perform a "sticky" search that matches starting at the current
+                                   //      position in the target string.    sticky
+    RF_GLOBAL_SEARCH    = 1 << 5,  // g    Global search.    global
+    RF_INDEX            = 1 << 6,  // d    Generate indices for substring matches.    hasIndices
+};
+
+/**
+ * 一次匹配的结果，位置都是 utf-8 字符串中的字节偏移.
+ * 第 n 个分组为 [captures[2n], captures[2n + 1]), 没有参与匹配的分组为 -1.
+ */
+struct JsRegExpMatch {
+    std::vector<int32_t>        captures;
+
+    uint32_t countGroups() const { return (uint32_t)captures.size() / 2; }
+    bool isMatched(uint32_t n) const { return captures[n * 2] >= 0 && captures[n * 2 + 1] >= 0; }
+    uint32_t begin(uint32_t n = 0) const { return (uint32_t)captures[n * 2]; }
+    uint32_t end(uint32_t n = 0) const { return (uint32_t)captures[n * 2 + 1]; }
+    StringView group(const StringView &str, uint32_t n) const { return str.substr(begin(n), end(n) - begin(n)); }
+};
+
+struct RegInst {
+    uint8_t                     op;
+    uint32_t                    x, y, z;
+};
+
+/**
+ * 字符集: ascii 部分使用 bitmap, 其他的部分为排序后的区间.
+ */
+struct RegCharClass {
+    uint32_t                    ascii[4];
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+    bool contains(uint32_t c) const;
+};
+
+/**
+ * JavaScript 正则表达式的编译结果.
+ *
+ * 表达式被编译为 bytecode, 由回溯的虚拟机按照 JavaScript 的语义(分支的优先级、lazy 量词、反向引用、
+ * lookaround、sticky 等)执行. 回溯的步数超过限制时，不含反向引用和 lookaround 的表达式改用
+ * Pike VM 执行，匹配的时间和字符串的长度成线性关系，不会出现灾难性的回溯.
+ *
+ * 匹配是按照 utf-8 的 code point 进行的，所以非 unicode 模式下 BMP 之外的字符也作为一个字符匹配;
+ * 忽略大小写只支持 ascii、Latin-1、希腊和西里尔字母.
+ * 编译的结果是只读的，可以在多个 JsRegExp 对象之间共享.
+ */
+class JsRegExpProgram {
+public:
+    /**
+     * 编译 pattern, 失败返回 nullptr, errorOut 为错误信息
+     */
+    static std::shared_ptr<JsRegExpProgram> compile(const StringView &pattern, uint32_t flags, string &errorOut);
+
+    /**
+     * 同 compile, 但是会缓存最近编译的结果. 用于 new RegExp(str)、'abc'.match(str) 等运行时才知道 pattern 的情况.
+     */
+    static std::shared_ptr<JsRegExpProgram> compileCached(const StringView &pattern, uint32_t flags, string &errorOut);
+
+    /**
+     * 从 utf-8 的偏移 start 开始查找，RF_STICKY 时只匹配 start 位置.
+     */
+    bool exec(const StringView &str, uint32_t start, JsRegExpMatch &matchOut) const;
+
+    uint32_t flags() const { return _flags; }
+
+    // 分组的数量，包括第 0 个分组(整个匹配)
+    uint32_t countGroups() const { return _countGroups; }
+
+    bool hasNamedGroups() const { return _hasNamedGroups; }
+    const string &groupName(uint32_t n) const { return _groupNames[n]; }
+
+    // 返回名字为 name 的分组，不存在返回 -1
+    int findGroup(const StringView &name) const;
+
+protected:
+    friend class RegExpCompiler;
+    struct ExecState;
+
+    JsRegExpProgram(uint32_t flags) : _flags(flags) { }
+
+    bool matchChar(const RegInst &inst, uint32_t c) const;
+    int findStart(const uint8_t *str, uint32_t len, uint32_t pos) const;
+
+    int runBacktrack(ExecState &state, uint32_t pc, uint32_t pos, int32_t target, uint32_t &endOut) const;
+    void addPikeThread(ExecState &state, int next, uint32_t pc, const int32_t *slots, uint32_t pos) const;
+    bool runPike(ExecState &state, uint32_t start, JsRegExpMatch &matchOut) const;
+
+protected:
+    uint32_t                    _flags;
+    std::vector<RegInst>        _insts;
+    std::vector<RegCharClass>   _classes;
+
+    uint32_t                    _countGroups = 1;
+    // 分组和循环寄存器的总数
+    uint32_t                    _countSlots = 2;
+    VecStrings                  _groupNames;
+    bool                        _hasNamedGroups = false;
+
+    // 匹配的结果一定以 _prefix 开始，用于快速跳过不可能匹配的位置
+    string                      _prefix;
+    // 没有 _prefix 时，匹配结果的第一个字节一定在 _firstBytes 中
+    uint32_t                    _firstBytes[8];
+    bool                        _hasFirstBytes = false;
+    // 以非 multiline 的 ^ 开始，只能从 0 开始匹配
+    bool                        _isAnchored = false;
+    // 没有反向引用和 lookaround, 可以使用 Pike VM
+    bool                        _canUsePikeVM = true;
+
+};
+
+using JsRegExpProgramPtr = std::shared_ptr<JsRegExpProgram>;
+
+#endif /* JsRegExpEngine_hpp */
@@ -0,0 +1,135 @@
+﻿//
+//  JsShape.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/9.
+//
+
+#include "JsShape.hpp"
+#include "utils/StringEx.h"
+
+
+JsShape::JsShape(JsAtomTable *atoms) : _parent(nullptr), _atoms(atoms), _atom(JS_ATOM_NONE), _name(stringViewEmpty), _countProps(0), _hasNumericNames(false), _lastTransition(nullptr), _table(nullptr) {
+}
+
+JsShape::JsShape(JsShape *parent, JsAtom atom) : _parent(parent), _atoms(parent->_atoms), _atom(atom), _countProps(parent->_countProps + 1), _lastTransition(nullptr), _table(nullptr) {
+    _name = _atoms->name(atom);
+    _hasNumericNames = parent->_hasNumericNames || (_name.len > 0 && isDigit(_name.data[0]));
+}
+
+JsShape::~JsShape() {
+    for (auto &item : _transitions) {
+        delete item.second;
+    }
+    _transitions.clear();
+
+    if (_table) {
+        delete _table;
+    }
+}
+
+JsShape *JsShape::emptyShape() {
+    static JsShape empty(nullptr);
+
+    return &empty;
+}
+
+int32_t JsShape::find(JsAtom atom) {
+    if (_countProps < MIN_COUNT_FOR_TABLE) {
+        for (auto shape = this; shape->_parent; shape = shape->_parent) {
+            if (shape->_atom == atom) {
+                return shape->_countProps - 1;
+            }
+        }
+        return -1;
+    }
+
+    if (!_table) {
+        buildTable();
+    }
+
+    auto it = _table->find(atom);
+    if (it == _table->end()) {
+        return -1;
+    }
+    return (*it).second;
+}
+
+JsShape *JsShape::addProperty(JsAtom atom) {
+    assert(_atoms && !_atoms->isFrozen());
+
+    auto it = _transitions.find(atom);
+    if (it != _transitions.end()) {
+        _lastTransition = (*it).second;
+        return _lastTransition;
+    }
+
+    if (!canAddTransition()) {
+        return nullptr;
+    }
+
+    auto shape = new JsShape(this, atom);
+    _transitions[atom] = shape;
+    _lastTransition = shape;
+    return shape;
+}
+
+JsShape *JsShape::addProperty(const StringView &name) {
+    auto atom = _atoms->find(name);
+    if (atom == JS_ATOM_NONE) {
+        // 新的属性名一定没有 transition
+        if (!canAddTransition()) {
+            return nullptr;
+        }
+        atom = _atoms->intern(name);
+    }
+
+    return addProperty(atom);
+}
+
+JsShape *JsShape::toTree(JsShapeTree *tree) {
+    if (_atoms == tree->atoms()) {
+        return this;
+    }
+
+    // 其他树中的 shape 已经冻结，只读取其属性名
+    VecStringViews names;
+    getNames(names);
+
+    auto shape = tree->root();
+    for (auto &name : names) {
+        shape = shape->addProperty(name);
+        if (!shape) {
+            return nullptr;
+        }
+    }
+
+    return shape;
+}
+
+void JsShape::getNames(VecStringViews &namesOut) const {
+    namesOut.resize(_countProps);
+    for (auto shape = this; shape->_parent; shape = shape->_parent) {
+        namesOut[shape->_countProps - 1] = shape->_name;
+    }
+}
+
+void JsShape::buildTable() {
+    assert(_table == nullptr);
+    _table = new MapAtomToSlotIndex;
+    _table->reserve(_countProps);
+
+    for (auto shape = this; shape->_parent; shape = shape->_parent) {
+        (*_table)[shape->_atom] = shape->_countProps - 1;
+    }
+}
+
+void JsShape::freeze() {
+    if (_countProps >= MIN_COUNT_FOR_TABLE && !_table) {
+        buildTable();
+    }
+
+    for (auto &item : _transitions) {
+        item.second->freeze();
+    }
+}
@@ -0,0 +1,170 @@
+﻿//
+//  JsShape.hpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/9.
+//
+
+#ifndef JsShape_hpp
+#define JsShape_hpp
+
+#include <memory>
+#include <unordered_map>
+#include "JsAtomTable.hpp"
+
+
+class JsShape;
+class JsShapeTree;
+
+using MapAtomToShape = std::unordered_map<JsAtom, JsShape *>;
+using MapAtomToSlotIndex = std::unordered_map<JsAtom, uint32_t>;
+using JsShapeTreePtr = std::shared_ptr<JsShapeTree>;
+
+/**
+ * JsShape (hidden class) 描述了 JsObject 的属性布局: 属性名和其在 slots 中的位置.
+ *
+ * 以相同顺序添加相同属性的 JsObject 共享同一个 JsShape，所以可以通过比较 JsShape 的指针来判断两个对象的布局是否相同.
+ * 所有的 JsShape 组成一颗 transition 树：根节点是没有任何属性的空 shape，每添加一个属性就沿着 transition 走到子节点.
+ *
+ * JsShape 只保存属性名，不保存 JsValue，所以不需要参与 GC. 属性名保存为所在树的 JsAtomTable 中的 atom，查找时只比较整数.
+ * JsShape 创建后直到其所在的 JsShapeTree 释放时才会被释放，所以 inline cache 中可以安全地保存其指针.
+ */
+class JsShape {
+private:
+    JsShape(const JsShape &);
+    JsShape &operator=(const JsShape &);
+
+public:
+    enum {
+        // 属性数量超过此值的对象转为字典模式
+        MAX_PROPERTIES          = 64,
+        // 同一个 shape 的 transition 数量超过此值后，新的属性不再创建 shape，对象转为字典模式. 根节点不限制
+        MAX_TRANSITIONS         = 128,
+        // 属性数量少时，直接沿着 parent 链查找，比查找 hash 表更快
+        MIN_COUNT_FOR_TABLE     = 8,
+    };
+
+    JsShape(JsAtomTable *atoms);
+    ~JsShape();
+
+    /**
+     * 新创建的对象的空 shape, 所有线程共享，不属于任何 transition 树，不会被修改.
+     * 对象添加属性时需要先通过 toTree() 转到 VMRuntime 的树中.
+     */
+    static JsShape *emptyShape();
+
+    /**
+     * 查找属性 atom 的 slot 位置，不存在返回 -1
+     */
+    int32_t find(JsAtom atom);
+
+    int32_t find(const StringView &name) {
+        if (_countProps == 0) {
+            return -1;
+        }
+
+        // 不是 atom 的名字，一定不在 shape 中
+        auto atom = _atoms->find(name);
+        return atom == JS_ATOM_NONE ? -1 : find(atom);
+    }
+
+    /**
+     * 返回添加了属性 atom 之后的 shape，如果不能再添加返回 nullptr (对象需要转为字典模式)
+     * 调用者需要确保 atom 不存在于当前 shape 中.
+     */
+    JsShape *addProperty(JsAtom atom);
+
+    /**
+     * 同 addProperty(JsAtom). 只有在创建新的 shape 时才将 name 添加到 atom 表中:
+     * atom 表不会释放，转为字典模式的对象的属性名 (比如 o['key' + i]) 不能占用 atom.
+     */
+    JsShape *addProperty(const StringView &name);
+
+    /**
+     * 最近一次 addProperty() 返回的 shape. 批量创建相同结构的对象时(比如 JSON.parse 数组中的记录),
+     * 下一个属性通常和上一次相同，比较属性名即可得到新的 shape，不需要查找 atom.
+     */
+    JsShape *lastTransition() const { return _lastTransition; }
+
+    /**
+     * 返回 tree 中属性相同的 shape. 当前 shape 不在 tree 中时 (空 shape, 或者从快照复制的对象)，
+     * 需要先转换才能添加属性. 不能转换时返回 nullptr (对象需要转为字典模式)
+     */
+    JsShape *toTree(JsShapeTree *tree);
+
+    /**
+     * 按照添加的顺序返回所有的属性名
+     */
+    void getNames(VecStringViews &namesOut) const;
+
+    uint32_t countProperties() const { return _countProps; }
+    JsShape *parent() const { return _parent; }
+    JsAtomTable *atoms() const { return _atoms; }
+    const StringView &lastName() const { return _name; }
+
+    // 是否还能创建新的 transition
+    bool canAddTransition() const { return _countProps < MAX_PROPERTIES && (!_parent || _transitions.size() < MAX_TRANSITIONS); }
+
+    // 是否有以数字开头的属性名，没有时按照 index 查找属性不需要将 index 转换为字符串
+    bool hasNumericNames() const { return _hasNumericNames; }
+
+protected:
+    friend class JsShapeTree;
+
+    JsShape(JsShape *parent, JsAtom atom);
+
+    void buildTable();
+
+    // 为所有子节点创建查找表，之后 find() 不会再修改 shape
+    void freeze();
+
+protected:
+    JsShape                     *_parent;
+
+    // 所在的树的 atom 表，空 shape 为 nullptr
+    JsAtomTable                 *_atoms;
+
+    // 当前 shape 最后添加的属性名，其 slot 位置为 _countProps - 1. _name 的内存由 JsAtomTable 管理
+    JsAtom                      _atom;
+    StringView                  _name;
+    uint32_t                    _countProps;
+    bool                        _hasNumericNames;
+
+    MapAtomToShape              _transitions;
+    JsShape                     *_lastTransition;
+
+    // 属性名到 slot 位置的映射，在属性较多时延迟创建
+    MapAtomToSlotIndex          *_table;
+
+};
+
+/**
+ * 属性名的 atom 表和 JsShape 的 transition 树. 由 VMRuntime 持有，随其一起释放.
+ *
+ * 创建快照时 VMRuntime 当前的树被冻结，之后只读，由快照和从快照创建的 VMRuntime 共享 (其中的对象引用了它的 shape).
+ * 它们再在以冻结的树为 parent 的新树中添加属性: atom 表在 parent 的基础上继续编号，所以 atom 在两棵树中是相同的.
+ */
+class JsShapeTree : public std::enable_shared_from_this<JsShapeTree> {
+private:
+    JsShapeTree(const JsShapeTree &);
+    JsShapeTree &operator=(const JsShapeTree &);
+
+public:
+    // commonAtoms 为 VMRuntimeCommon 的 atom 表
+    JsShapeTree(const JsAtomTable *commonAtoms) : _atoms(commonAtoms), _root(&_atoms) { }
+    JsShapeTree(const JsShapeTreePtr &parent) : _parent(parent), _atoms(&parent->_atoms), _root(&_atoms) { }
+
+    JsAtomTable *atoms() { return &_atoms; }
+    JsShape *root() { return &_root; }
+
+    // 冻结之后不能再添加 atom 和 shape, 可以在多个线程中同时读取
+    void freeze() { _atoms.freeze(); _root.freeze(); }
+
+protected:
+    JsShapeTreePtr              _parent;
+    JsAtomTable                 _atoms;
+    JsShape                     _root;
+
+};
+
+#endif /* JsShape_hpp */
@@ -14,11 +14,19 @@
 
 class ByteCodeStream : public BinaryOutputStream {
 public:
+    ByteCodeStream() : _countInlineCaches(0) { }
+
     inline void writeOpCode(OpCode code) { writeUInt8(code); }
     inline uint32_t *writeReservedAddress() { auto addr = (uint32_t *)writeReserved(sizeof(uint32_t)); *addr = 0; return addr; }
     inline void writeAddress(VMAddress addr) { writeUInt32((VMAddress)addr); }
     inline VMAddress address() { return (uint32_t)size(); }
 
+    // 分配一个新的 inline cache，并写入其序号
+    inline void writeInlineCacheIdx() {
+        writeUInt16(_countInlineCaches < INLINE_CACHE_IDX_NONE ? _countInlineCaches++ : INLINE_CACHE_IDX_NONE);
+    }
+    inline uint16_t countInlineCaches() const { return _countInlineCaches; }
+
     void writeBreakAddress();
     void writeContinueAddress();
 
@@ -35,6 +43,7 @@ public:
 
 protected:
     std::list<BreakContinueArea>    _stackBreakContineAreas;
+    uint16_t                        _countInlineCaches;
 
 };
 
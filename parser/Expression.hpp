@@ -323,6 +323,7 @@ public:
         obj->convertToByteCode(stream);
         stream.writeOpCode(isOptional ? OP_PUSH_MEMBER_DOT_OPTIONAL : OP_PUSH_MEMBER_DOT);
         stream.writeUInt32(stringIdx);
+        stream.writeInlineCacheIdx();
     }
 
     virtual void convertAssignableToByteCode(IJsNode *valueOpt, ByteCodeStream &stream) {
@@ -339,6 +340,7 @@ public:
         }
 
         stream.writeUInt32(stringIdx);
+        stream.writeInlineCacheIdx();
     }
 
     IJsNode                     *obj;
@@ -462,6 +464,58 @@ protected:
 
 };
 
+/**
+ * yield 和 await: 暂停当前函数，恢复执行后表达式的值在栈顶. expr 为 nullptr 时相当于 undefined
+ */
+class JsExprSuspend : public IJsNode {
+public:
+    JsExprSuspend(IJsNode *expr, OpCode code) : IJsNode(code == OP_AWAIT ? NT_AWAIT : NT_YIELD), expr(expr), code(code) { }
+
+    virtual void convertToByteCode(ByteCodeStream &stream) {
+        if (expr) {
+            expr->convertToByteCode(stream);
+        } else {
+            stream.writeOpCode(OP_PUSH_UNDFINED);
+        }
+        stream.writeOpCode(code);
+    }
+
+protected:
+    IJsNode                     *expr;
+    OpCode                      code;
+
+};
+
+/**
+ * yield* expr: 依次 yield expr 遍历出的值，和 for (x of expr) yield x 相同.
+ * next() 传入的值不会转发给 expr，表达式的值为 undefined.
+ */
+class JsExprYieldDelegate : public IJsNode {
+public:
+    JsExprYieldDelegate(IJsNode *expr) : IJsNode(NT_YIELD_DELEGATE), expr(expr) { }
+
+    virtual void convertToByteCode(ByteCodeStream &stream) {
+        expr->convertToByteCode(stream);
+        stream.writeOpCode(OP_ITERATOR_OF_CREATE);
+
+        auto addrLoopStart = stream.address();
+        stream.writeOpCode(OP_ITERATOR_NEXT_VALUE);
+        auto addrLoopEnd = stream.writeReservedAddress();
+
+        stream.writeOpCode(OP_YIELD);
+        stream.writeOpCode(OP_POP_STACK_TOP);
+        stream.writeOpCode(OP_JUMP);
+        stream.writeAddress(addrLoopStart);
+
+        *addrLoopEnd = stream.address();
+        stream.writeOpCode(OP_PUSH_UNDFINED);
+    }
+
+protected:
+    IJsNode                     *expr;
+
+};
+
 class JsExprFunctionCall : public IJsNode {
 public:
     JsExprFunctionCall(ResourcePool *resourcePool, IJsNode *func, JsNodeType type = NT_FUNCTION_CALL) : IJsNode(type), func(func) {
@@ -565,6 +619,7 @@ public:
                     stream.writeOpCode(OP_PUSH_THIS_MEMBER_DOT);
                 }
                 stream.writeUInt32(e->stringIdx);
+                stream.writeInlineCacheIdx();
 
                 pushArgs(stream);
 
@@ -844,6 +899,7 @@ public:
 
         stream.writeOpCode(OP_PUSH_THIS_MEMBER_DOT);
         stream.writeUInt32(nameIdx);
+        stream.writeInlineCacheIdx();
 
         stream.writeOpCode(OP_JUMP_IF_NOT_NULL_UNDEFINED_KEEP_VALID);
         auto addrUseStack = stream.writeReservedAddress();
@@ -1091,12 +1147,14 @@ public:
             dst->obj->convertToByteCode(stream);
             stream.writeOpCode(OP_PUSH_THIS_MEMBER_DOT);
             stream.writeUInt32(dst->stringIdx);
+            stream.writeInlineCacheIdx();
 
             right->convertToByteCode(stream);
             stream.writeOpCode(xopr);
 
             stream.writeOpCode(OP_ASSIGN_MEMBER_DOT);
             stream.writeUInt32(dst->stringIdx);
+            stream.writeInlineCacheIdx();
         } else if (left->type == NT_MEMBER_INDEX) {
             auto dst = (JsExprMemberIndex *)left;
             dst->obj->convertToByteCode(stream);
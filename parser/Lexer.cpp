@@ -773,7 +773,10 @@ void JSLexer::_readRegexp() {
     _curToken.type = TK_REGEX;
     _curToken.len = (uint32_t)(_bufPos - _curToken.buf);
 
-    _resPool->addRegexp(_curToken, str, flags);
+    string error;
+    if (!_resPool->addRegexp(_curToken, str, flags, error)) {
+        _parseError("Invalid regular expression: /%.*s/: %s", str.len, str.data, error.c_str());
+    }
 }
 
 void JSLexer::_readName() {
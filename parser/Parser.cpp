@@ -11,6 +11,8 @@
 
 
 static StringView NAME_ASYNC("async");
+static StringView NAME_AWAIT("await");
+static StringView NAME_YIELD("yield");
 static StringView NAME_TARGET("target");
 static StringView NAME_OF("of");
 static StringView NAME_EVAL("eval");
@@ -34,6 +36,10 @@ JSParser::JSParser(VMRuntimeCommon *rtc, ResourcePool *resPool, const char *buf,
     _curFunction = nullptr;
     _curFuncScope = nullptr;
     _curScope = nullptr;
+    _parenExprStart = nullptr;
+
+    _isLazyParse = true;
+    _isPreparsing = false;
 }
 
 Function *JSParser::parse(Scope *parent, bool isExpr) {
@@ -81,6 +87,38 @@ Function *JSParser::parse(Scope *parent, bool isExpr) {
     return function;
 }
 
+void JSParser::parseLazyFunction(Function *function) {
+    assert(function->isLazy);
+
+    // 字符串和数字的索引接着 ResourcePool 中已有的分配
+    _nextStringIdx += (uint32_t)_resPool->strings.size();
+    _nextDoubleIdx += (uint32_t)_resPool->doubles.size();
+
+    _line = function->lazyLine;
+    _col = function->lazyCol;
+
+    _headIdRefs = nullptr;
+    _curFunction = function;
+    _curScope = _curFuncScope = function->scope;
+
+    _readToken();
+    _expectFunctionParamsAndBody(function, 0);
+    _checkExpressionObjects();
+
+    function->isLazy = false;
+
+    _reduceScopeLevels(function);
+
+    // 引用到的外部变量在预解析时已经和父函数一起解析过了，不会再添加新的声明
+    _buildExprIdentifiers();
+
+    // 父函数的 scope (包括 function->scope 的兄弟) 都已经分配过了
+    auto sibling = function->scope->sibling;
+    function->scope->sibling = nullptr;
+    _allocateIdentifierStorage(function->scope, 0);
+    function->scope->sibling = sibling;
+}
+
 IJsNode *JSParser::_expectStatment() {
     _checkExpressionObjects();
 
@@ -105,6 +143,9 @@ IJsNode *JSParser::_expectStatment() {
             if (_nextToken.type == TK_COLON) {
                 return _expectLabelStmt();
             }
+            if (_nextToken.type == TK_FUNCTION && !_nextToken.newLineBefore && isTokenNameEqual(_curToken, NAME_ASYNC)) {
+                return _expectFunctionDeclaration(true);
+            }
             return _expectExpressionStmt();
         }
         case TK_OPEN_BRACE:
@@ -666,12 +707,18 @@ void JSParser::_unexpectToken() {
     _parseError("Unexpected token: %.*s, at: %.*s", _curToken.len, _curToken.buf, len, _curToken.buf);
 }
 
-IJsNode *JSParser::_expectFunctionDeclaration() {
+IJsNode *JSParser::_expectFunctionDeclaration(bool isAsync) {
     auto parentScope = _curScope;
     auto child = _enterFunction(_curToken);
 
     _readToken();
 
+    if (isAsync) {
+        // async function
+        child->isAsync = true;
+        _expectToken(TK_FUNCTION);
+    }
+
     if (_curToken.type == TK_MUL) {
         _readToken();
         child->isGenerator = true;
@@ -685,19 +732,7 @@ IJsNode *JSParser::_expectFunctionDeclaration() {
     parentScope->addFunctionDeclaration(_curToken, child);
     _readToken();
 
-    child->params = _expectFormalParameters();
-
-    // function body
-    _expectToken(TK_OPEN_BRACE);
-    while (_curToken.type != TK_CLOSE_BRACE) {
-        if (_curToken.type == TK_EOF) {
-            _parseError("Unexpected end of input");
-            break;
-        }
-
-        child->astNodes.push_back(_expectStatment());
-    }
-    _readToken();
+    _expectFunctionBody(child, 0);
 
     _leaveFunction();
 
@@ -713,13 +748,17 @@ IJsNode *JSParser::_expectFunctionExpression(uint32_t functionFlags, bool ignore
 
     if (functionFlags & FT_ASYNC) {
         child->isAsync = true;
+        if (functionFlags & FT_EXPRESSION) {
+            // async function 表达式, 已经跳过了 async
+            _expectToken(TK_FUNCTION);
+        }
     }
 
     if (functionFlags & FT_GENERATOR) {
         child->isGenerator = true;
     }
 
-    if ((functionFlags & (FT_GETTER | FT_SETTER)) && _curToken.type == TK_MUL) {
+    if ((functionFlags & (FT_GETTER | FT_SETTER | FT_EXPRESSION)) && _curToken.type == TK_MUL) {
         _readToken();
         assert(!child->isGenerator);
         child->isGenerator = true;
@@ -736,14 +775,39 @@ IJsNode *JSParser::_expectFunctionExpression(uint32_t functionFlags, bool ignore
         child->isMemberFunction = true;
     }
 
+    _expectFunctionBody(child, functionFlags);
+
+    _leaveFunction();
+
+    return PoolNew(_pool, JsFunctionExpr)(child);
+}
+
+/**
+ * 解析函数的参数和函数体，并读取函数体之后的 token.
+ * 开启了延迟解析时，函数只做预解析，在第一次执行前才由 parseLazyFunction 完整地解析.
+ */
+void JSParser::_expectFunctionBody(Function *child, uint32_t functionFlags) {
+    if (_isLazyParse && !_isPreparsing && !(functionFlags & FT_EAGER)) {
+        _preparseFunctionBody(child, functionFlags);
+    } else {
+        _expectFunctionParamsAndBody(child, functionFlags);
+    }
+
+    _readToken();
+}
+
+/**
+ * 解析函数的参数和函数体，结束时 _curToken 为函数体的 '}'
+ */
+void JSParser::_expectFunctionParamsAndBody(Function *child, uint32_t functionFlags) {
     child->params = _expectFormalParameters();
     auto count = child->params ? child->params->count() : 0;
     if ((functionFlags & FT_GETTER) && count > 0) {
         _parseError("Getter must not have any formal parameters.");
-        return child;
+        return;
     } else if ((functionFlags & FT_SETTER) && count != 1) {
         _parseError("Setter must have exactly one formal parameter.");
-        return child;
+        return;
     }
 
     // function body
@@ -756,11 +820,92 @@ IJsNode *JSParser::_expectFunctionExpression(uint32_t functionFlags, bool ignore
 
         child->astNodes.push_back(_expectStatment());
     }
-    _readToken();
+}
 
-    _leaveFunction();
+inline bool isDeclaredInFunction(JsExprIdentifier *id, Function *function) {
+    for (auto scope = id->scope; ; scope = scope->parent) {
+        if (scope->varDeclares.find(id->name) != scope->varDeclares.end()) {
+            return true;
+        }
 
-    return PoolNew(_pool, JsFunctionExpr)(child);
+        if (scope == function->scope) {
+            return false;
+        }
+    }
+}
+
+/**
+ * 预解析函数: 和完整解析一样检查语法错误，但是解析的结果 (语法树、子函数和 scope) 都会被丢弃，只保留:
+ *   - 参数列表在源代码中的位置;
+ *   - 引用到的外部变量，和父函数中的标识符一起解析，以确定父函数的变量是否被修改、是否需要分配函数变量等;
+ *   - eval 的使用 (在解析时已经通过 setHasEval 设置到了父 scope 中).
+ */
+void JSParser::_preparseFunctionBody(Function *child, uint32_t functionFlags) {
+    auto functionScope = child->scope;
+    child->isLazy = true;
+    child->lazyParamsPos = _curToken.buf;
+    child->lazyLine = _curToken.line;
+    child->lazyCol = _curToken.col;
+
+    // 预解析时添加到 child 中的内容需要在结束后清除, 只保留之前声明的 this, arguments
+    MapNameToIdentifiers varDeclares = functionScope->varDeclares;
+    auto countLocalVars = functionScope->countLocalVars;
+
+    auto headIdRefs = _headIdRefs;
+    auto mark = _resPool->mark();
+    _isPreparsing = true;
+
+    _expectFunctionParamsAndBody(child, functionFlags);
+    _checkExpressionObjects();
+    assert(_curToken.type == TK_CLOSE_BRACE && _nextToken.type == TK_ERR);
+
+    // 没有在 child 中声明的标识符，引用的是外部的变量. 相同名字的只需要保留一个
+    std::unordered_map<StringView, JsExprIdentifier, StringViewHash, SizedStrCmpEqual> freeIds;
+    for (auto p = _headIdRefs; p != headIdRefs; p = p->next) {
+        if (isDeclaredInFunction(p, child)) {
+            continue;
+        }
+
+        auto it = freeIds.find(p->name);
+        if (it == freeIds.end()) {
+            freeIds.insert({p->name, *p});
+        } else {
+            auto &id = (*it).second;
+            id.isModified |= p->isModified;
+            id.isUsedNotAsFunctionCall |= p->isUsedNotAsFunctionCall;
+        }
+    }
+
+    _isPreparsing = false;
+    _headIdRefs = headIdRefs;
+
+    if (functionScope->functionArgs) {
+        functionScope->functionArgs->~VecFunctions();
+        functionScope->functionArgs = nullptr;
+    }
+    functionScope->varDeclares.swap(varDeclares);
+    functionScope->countLocalVars = countLocalVars;
+    functionScope->countArguments = 0;
+    functionScope->child = nullptr;
+    VecFunctions().swap(functionScope->functions);
+    VecFunctions().swap(functionScope->functionDecls);
+
+    child->params = nullptr;
+    VecJsNodes().swap(child->astNodes);
+    VecFunctions().swap(child->functions);
+    child->scopes.resize(1);
+    child->scopes.shrink_to_fit();
+
+    _resPool->rollback(mark);
+
+    // 作为 child 中的标识符引用，在父函数解析结束后和其他标识符一起解析
+    for (auto &item : freeIds) {
+        auto &id = item.second;
+        auto ref = PoolNew(_resPool->pool, JsExprIdentifier)(id);
+        ref->scope = functionScope;
+        ref->next = _headIdRefs;
+        _headIdRefs = ref;
+    }
 }
 
 IJsNode *JSParser::_expectClassDeclaration(bool isClassExpr) {
@@ -858,7 +1003,50 @@ IJsNode *JSParser::_expectExpression(Precedence pred, bool enableIn) {
     switch (_curToken.type) {
         case TK_NAME: {
             auto name = _curToken;
+            if (_curFunction->isGenerator && isTokenNameEqual(name, NAME_YIELD)) {
+                // yield 的优先级和赋值相同，其后不会再有其他的运算符
+                return _expectYieldExpression(enableIn);
+            }
+
             _readToken();
+            if (_curFunction->isAsync && isTokenNameEqual(name, NAME_AWAIT)) {
+                expr = PoolNew(_pool, JsExprSuspend)(_expectExpression(PRED_UNARY_PREFIX), OP_AWAIT);
+                break;
+            }
+
+            if (isTokenNameEqual(name, NAME_ASYNC) && !_curToken.newLineBefore) {
+                if (_curToken.type == TK_FUNCTION) {
+                    expr = _expectFunctionExpression(FT_EXPRESSION | FT_ASYNC, false);
+                    break;
+                } else if (_curToken.type == TK_OPEN_PAREN) {
+                    // async (...) => ..., 或者调用名为 async 的函数
+                    expr = _expectParenExprOrArrowFunction(name, true);
+                    break;
+                } else if (_curToken.type == TK_NAME) {
+                    // async x => ...
+                    auto param = _curToken;
+                    _readToken();
+                    if (_curToken.type != TK_ARROW) {
+                        _unexpectToken();
+                    }
+                    _readToken();
+
+                    auto childFunction = _enterFunction(name, false, true);
+                    childFunction->isAsync = true;
+                    _curFuncScope->addArgumentDeclaration(param, 0);
+
+                    if (_curToken.type == TK_OPEN_BRACE) {
+                        childFunction->astNodes.push_back(_expectBlock());
+                    } else {
+                        childFunction->astNodes.push_back(PoolNew(_pool, JsStmtReturnValue)(_expectExpression()));
+                    }
+                    _leaveFunction();
+
+                    expr = PoolNew(_pool, JsFunctionExpr)(childFunction);
+                    break;
+                }
+            }
+
             if (_curToken.type == TK_ARROW) {
                 // Arrow function
                 _readToken();
@@ -886,42 +1074,7 @@ IJsNode *JSParser::_expectExpression(Precedence pred, bool enableIn) {
             expr = _expectArrayLiteralExpression();
             break;
         case TK_OPEN_PAREN: {
-            auto tokenStart = _curToken;
-            _readToken();
-            if (_curToken.type == TK_CLOSE_PAREN) {
-                _readToken();
-                expr = nullptr;
-            } else {
-                expr = _expectParenExpression();
-            }
-
-            if (_curToken.type == TK_ARROW) {
-                auto childFunction = _enterFunction(tokenStart, false, true);
-                assert(expr == nullptr || expr->type == NT_PAREN_EXPRESSION);
-                childFunction->params = _convertParenExprsToFormalPrameters((JsParenExpr *)expr);
-
-                _readToken();
-                if (_curToken.type == TK_OPEN_BRACE) {
-                    _readToken();
-                    while (_curToken.type != TK_CLOSE_BRACE) {
-                        if (_curToken.type == TK_EOF) {
-                            _parseError("Unexpected end of input");
-                            break;
-                        }
-
-                        childFunction->astNodes.push_back(_expectStatment());
-                    }
-                    _readToken();
-                } else {
-                    auto e = _expectExpression();
-                    childFunction->astNodes.push_back(PoolNew(_pool, JsStmtReturnValue)(e));
-                }
-
-                _leaveFunction();
-                expr = PoolNew(_pool, JsFunctionExpr)(childFunction);
-            } else if (expr == nullptr) {
-                _unexpectToken();
-            }
+            expr = _expectParenExprOrArrowFunction(_curToken, false);
             break;
         }
         case TK_TEMPLATE_NO_SUBSTITUTION:
@@ -965,7 +1118,7 @@ IJsNode *JSParser::_expectExpression(Precedence pred, bool enableIn) {
             break;
         }
         case TK_FUNCTION:
-            expr = _expectFunctionExpression(FT_EXPRESSION);
+            expr = _expectFunctionExpression(_curToken.buf == _parenExprStart ? FT_EXPRESSION | FT_EAGER : FT_EXPRESSION);
             break;
         case TK_CLASS:
             _expectClassDeclaration(true);
@@ -1458,6 +1611,95 @@ JsNodeParameters *JSParser::_convertParenExprsToFormalPrameters(JsParenExpr *exp
     return params;
 }
 
+/**
+ * 括号表达式或者箭头函数, _curToken 为 (.
+ * isAsync 为 true 时，tokenStart 为 async: 不是箭头函数时为调用名为 async 的函数.
+ */
+IJsNode *JSParser::_expectParenExprOrArrowFunction(const Token &tokenStart, bool isAsync) {
+    IJsNode *expr;
+
+    _readToken();
+    _parenExprStart = _curToken.buf;
+    if (_curToken.type == TK_CLOSE_PAREN) {
+        _readToken();
+        expr = nullptr;
+    } else {
+        expr = _expectParenExpression();
+    }
+
+    if (_curToken.type == TK_ARROW) {
+        auto childFunction = _enterFunction(tokenStart, false, true);
+        childFunction->isAsync = isAsync;
+        assert(expr == nullptr || expr->type == NT_PAREN_EXPRESSION);
+        childFunction->params = _convertParenExprsToFormalPrameters((JsParenExpr *)expr);
+
+        _readToken();
+        if (_curToken.type == TK_OPEN_BRACE) {
+            _readToken();
+            while (_curToken.type != TK_CLOSE_BRACE) {
+                if (_curToken.type == TK_EOF) {
+                    _parseError("Unexpected end of input");
+                    break;
+                }
+
+                childFunction->astNodes.push_back(_expectStatment());
+            }
+            _readToken();
+        } else {
+            auto e = _expectExpression();
+            childFunction->astNodes.push_back(PoolNew(_pool, JsStmtReturnValue)(e));
+        }
+
+        _leaveFunction();
+        return PoolNew(_pool, JsFunctionExpr)(childFunction);
+    }
+
+    if (isAsync) {
+        auto funcCall = PoolNew(_pool, JsExprFunctionCall)(_resPool, _newExprIdentifier(tokenStart));
+        if (expr) {
+            funcCall->args = ((JsParenExpr *)expr)->nodes;
+        }
+        return funcCall;
+    }
+
+    if (expr == nullptr) {
+        _unexpectToken();
+    }
+    return expr;
+}
+
+/**
+ * yield 表达式, _curToken 为 yield. 其后换行或者不能开始一个表达式时，没有操作数
+ */
+IJsNode *JSParser::_expectYieldExpression(bool enableIn) {
+    _readToken();
+
+    if (_curToken.type == TK_MUL && !_curToken.newLineBefore) {
+        _readToken();
+        return PoolNew(_pool, JsExprYieldDelegate)(_expectExpression(PRED_ASSIGNMENT, enableIn));
+    }
+
+    IJsNode *expr = nullptr;
+    switch (_curToken.type) {
+        case TK_CLOSE_PAREN:
+        case TK_CLOSE_BRACKET:
+        case TK_CLOSE_BRACE:
+        case TK_COMMA:
+        case TK_SEMI_COLON:
+        case TK_COLON:
+        case TK_CONDITIONAL:
+        case TK_EOF:
+            break;
+        default:
+            if (!_curToken.newLineBefore) {
+                expr = _expectExpression(PRED_ASSIGNMENT, enableIn);
+            }
+            break;
+    }
+
+    return PoolNew(_pool, JsExprSuspend)(expr, OP_YIELD);
+}
+
 IJsNode *JSParser::_expectParenExpression() {
     auto parenExpr = PoolNew(_pool, JsParenExpr)(_resPool);
 
@@ -1801,6 +2043,10 @@ void JSParser::_allocateIdentifierStorage(Scope *scope, int registerIndex) {
 }
 
 int JSParser::_getDoubleIndex(double value) {
+    if (_isPreparsing) {
+        return 0;
+    }
+
     if (_runtimeCommon) {
         auto idx = _runtimeCommon->findDoubleValue(value);
         if (idx != -1) {
@@ -1823,6 +2069,10 @@ int JSParser::_getDoubleIndex(double value) {
 }
 
 int JSParser::_getStringIndex(const StringView &str) {
+    if (_isPreparsing) {
+        return 0;
+    }
+
     if (_runtimeCommon) {
         auto idx = _runtimeCommon->findStringValue(str);
         if (idx != -1) {
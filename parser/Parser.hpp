@@ -51,6 +51,12 @@ public:
 
     Function *parse(Scope *parent, bool isExpr);
 
+    // 完整地解析预解析过的函数，由 Function::generateByteCode 调用. 当前位置需为其参数列表的 '('
+    void parseLazyFunction(Function *function);
+
+    // 是否延迟解析函数，缺省为 true: 函数只做预解析，在第一次执行前才完整地解析.
+    void setLazyParse(bool isLazyParse) { _isLazyParse = isLazyParse; }
+
 protected:
     enum FunctionFlags : uint32_t {
         FT_EXPRESSION               = 1,
@@ -59,6 +65,8 @@ protected:
         FT_SETTER                   = 1 << 3,
         FT_ASYNC                    = 1 << 4,
         FT_GENERATOR                = 1 << 5,
+        // 需要立即解析，比如被括号包围的函数表达式 (通常会被立即调用)
+        FT_EAGER                    = 1 << 6,
     };
 
     //
@@ -80,8 +88,11 @@ protected:
     IJsNode *_expectArrayAssignable(JsTokenType declareType);
     IJsNode *_expectObjectAssignable(JsTokenType declareType);
 
-    IJsNode *_expectFunctionDeclaration();
+    IJsNode *_expectFunctionDeclaration(bool isAsync = false);
     IJsNode *_expectFunctionExpression(uint32_t functionFlags, bool ignoreFirstToken = true);
+    void _expectFunctionBody(Function *child, uint32_t functionFlags);
+    void _expectFunctionParamsAndBody(Function *child, uint32_t functionFlags);
+    void _preparseFunctionBody(Function *child, uint32_t functionFlags);
     IJsNode *_expectClassDeclaration(bool isClassExpr = false);
     JsNodeParameters *_expectFormalParameters();
     IJsNode *_expectParameterDeclaration(uint16_t index);
@@ -90,6 +101,8 @@ protected:
     IJsNode *_expectObjectLiteralExpression();
     IJsNode *_expectArrayLiteralExpression();
     IJsNode *_expectParenExpression();
+    IJsNode *_expectParenExprOrArrowFunction(const Token &tokenStart, bool isAsync);
+    IJsNode *_expectYieldExpression(bool enableIn);
     IJsNode *_expectParenCondition();
     IJsNode *_expectRawTemplateCall(IJsNode *func);
     JsNodeParameters *_convertParenExprsToFormalPrameters(JsParenExpr *exprParen);
@@ -155,6 +168,13 @@ protected:
 
     std::list<bool>             _stackBreakContinueAreas;
 
+    // 括号表达式中第一个 token 的位置，用于判断函数表达式是否被括号包围
+    uint8_t                     *_parenExprStart;
+
+    bool                        _isLazyParse;
+    // 正在预解析函数: 不分配字符串和数字的索引，解析的结果在预解析完成后丢弃
+    bool                        _isPreparsing;
+
 };
 
 #endif /* Parser_hpp */
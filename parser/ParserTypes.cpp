@@ -5,10 +5,12 @@
 //  Created by henry_xiao on 2022/5/22.
 //
 
+#include <memory>
 #include "ParserTypes.hpp"
 #include "generated/ConstStrings.hpp"
 #include "Expression.hpp"
 #include "Statement.hpp"
+#include "Parser.hpp"
 #include "interpreter/VirtualMachine.hpp"
 #include "objects/IJsObject.hpp"
 #include "interpreter/BinaryOperation.hpp"
@@ -126,7 +128,8 @@ IdentifierDeclare *Scope::addVarDeclaration(const StringView &nameStr, bool isCo
     auto it = varDeclares.find(nameStr);
     if (it == varDeclares.end()) {
         auto &pool = function->resourcePool->pool;
-        auto node = PoolNew(pool, IdentifierDeclare)(nameStr, this);
+        // 全局变量的声明会一直存在，而 nameStr 所在的 ResourcePool 执行完后可能被 GC 回收
+        auto node = PoolNew(pool, IdentifierDeclare)(parent ? nameStr : pool.duplicate(nameStr), this);
         node->isConst = isConst;
         node->isScopeVar = isScopeVar;
 
@@ -172,12 +175,12 @@ void Scope::addImplicitVarDeclaration(JsExprIdentifier *id) {
     assert(parent == nullptr);
 
     auto &pool = function->resourcePool->pool;
-    auto node = PoolNew(pool, IdentifierDeclare)(id->name, this);
+    auto node = PoolNew(pool, IdentifierDeclare)(pool.duplicate(id->name), this);
     node->isConst = false;
     node->isImplicitDeclaration = true;
     node->varStorageType = VST_GLOBAL_VAR;
     node->storageIndex = countLocalVars++;
-    varDeclares[id->name] = node;
+    varDeclares[node->name] = node;
 
     id->declare = node;
 }
@@ -303,13 +306,19 @@ Function::Function(ResourcePool *resourcePool, Scope *parent, uint16_t index, bo
     params = nullptr;
     bytecode = nullptr;
     lenByteCode = 0;
+    inlineCaches = nullptr;
+    countInlineCaches = 0;
     declare = nullptr;
     isStrictMode = false;
     isVarsReferredByChild = false;
+    isArgumentsReferredByChild = false;
     isReferredParentVars = false;
     isGenerator = false;
     isAsync = false;
     isMemberFunction = false;
+    isLazy = false;
+    lazyParamsPos = nullptr;
+    lazyLine = lazyCol = 0;
 
     line = 0;
     col = 0;
@@ -318,6 +327,13 @@ Function::Function(ResourcePool *resourcePool, Scope *parent, uint16_t index, bo
 }
 
 void Function::generateByteCode() {
+    if (isLazy) {
+        // 预解析的函数在第一次执行前才完整地解析
+        auto end = (uint8_t *)srcCode.data + srcCode.len;
+        JSParser parser(VMRuntimeCommon::getInstance(), resourcePool, (cstr_t)lazyParamsPos, end - lazyParamsPos);
+        parser.parseLazyFunction(this);
+    }
+
     ByteCodeStream stream;
 
     // 提前将不常用的初始化过程转换为 bytecode，以提高 bytecode 执行的性能
@@ -354,10 +370,24 @@ void Function::generateByteCode() {
         auto bc = resourcePool->pool.duplicate(data);
         bytecode = (uint8_t *)bc.data;
         lenByteCode = (int)bc.len;
+        optimizeByteCode(bytecode, lenByteCode);
     } else {
         bytecode = nullptr;
         lenByteCode = 0;
     }
+
+    allocateInlineCaches(stream.countInlineCaches());
+}
+
+void Function::allocateInlineCaches(uint16_t count) {
+    countInlineCaches = count;
+    if (countInlineCaches > 0) {
+        // pool 分配的内存不保证对齐
+        auto size = sizeof(InlineCache) * countInlineCaches;
+        auto p = (uintptr_t)resourcePool->pool.allocate(size + alignof(InlineCache) - 1);
+        inlineCaches = (InlineCache *)((p + alignof(InlineCache) - 1) & ~(uintptr_t)(alignof(InlineCache) - 1));
+        std::uninitialized_fill_n(inlineCaches, countInlineCaches, InlineCache());
+    }
 }
 
 void Function::dump(BinaryOutputStream &stream) {
@@ -415,24 +445,43 @@ JsNodes::JsNodes(ResourcePool *resourcePool, JsNodeType type) : IJsNode(type) {
 ResourcePool::ResourcePool(uint32_t index) : index(index) {
     referIdx = 0;
     nextFreeIdx = 0;
+    rootFunction = nullptr;
 }
 
 ResourcePool::~ResourcePool() {
     free();
 }
 
-void ResourcePool::addRegexp(Token &token, const StringView &str, uint32_t flags) {
+bool ResourcePool::addRegexp(Token &token, const StringView &str, uint32_t flags, string &errorOut) {
+    auto program = JsRegExpProgram::compile(str, flags, errorOut);
+    if (!program) {
+        return false;
+    }
+
     token.param.index = (uint32_t)regexps.size();
+    regexps.push_back({ StringView(token.buf, token.len), program });
+    return true;
+}
 
-    regexps.push_back({ StringView(token.buf, token.len),
-        std::regex((cstr_t)str.data, (cstr_t)str.data + str.len, (std::regex::flag_type)flags), flags });
+void ResourcePool::buildOffsetIndex(StringViewUtf16 &str) {
+    auto buf = pool.allocate(Utf8OffsetIndex::memorySize(str.size()));
+    str.setOffsetIndex(Utf8OffsetIndex::create(buf, str.utf8Str(), str.size()));
 }
 
-void ResourcePool::convertUtf8ToUtf16(StringViewUtf16 &str) {
-    auto &utf8Str = str.utf8Str();
-    auto dataUtf16 = (utf16_t *)pool.allocate(str.size() * sizeof(utf16_t));
-    utf8ToUtf16(utf8Str.data, utf8Str.len, dataUtf16, str.size());
-    str.setUtf16(dataUtf16, str.size());
+void ResourcePool::rollback(const Mark &mark) {
+    for (auto i = mark.countDestructNodes; i < toDestructNodes.size(); i++) {
+        toDestructNodes[i]->~IJsNode();
+    }
+    toDestructNodes.resize(mark.countDestructNodes);
+
+    for (auto i = mark.countDestructScopes; i < toDestructScopes.size(); i++) {
+        toDestructScopes[i]->~Scope();
+    }
+    toDestructScopes.resize(mark.countDestructScopes);
+
+    regexps.resize(mark.countRegexps);
+
+    pool.rollback(mark.pool);
 }
 
 void ResourcePool::dump(BinaryOutputStream &stream) {
@@ -478,6 +527,15 @@ void ResourcePool::free() {
 
     switchCaseJumps.clear();
     switchCaseJumps.shrink_to_fit();
+
+    // pool 被复用时，strings 的索引会对应到不同的字符串
+    regexps.clear();
+    regexps.shrink_to_fit();
+    atoms.clear();
+    atoms.shrink_to_fit();
+
+    source = StringView();
+    rootFunction = nullptr;
 }
 
 bool jsValueStrictLessThan(VMRuntime *runtime, const JsValue &left, const JsValue &right);
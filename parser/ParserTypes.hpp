@@ -10,9 +10,9 @@
 
 #include <deque>
 #include <unordered_map>
-#include <regex>
 #include "Lexer.hpp"
 #include "ByteCodeStream.hpp"
+#include "objects/JsRegExpEngine.hpp"
 
 
 class JsExprIdentifier;
@@ -32,6 +32,7 @@ using VecResourcePools = std::vector<ResourcePool *>;
 using VecJsNodes = std::vector<IJsNode *>;
 using DequeJsNodes = std::deque<IJsNode *>;
 using DequeScopes = std::deque<Scope *>;
+using DequeStringViewUtf16s = std::deque<StringViewUtf16>;
 
 /**
  * 语法树结点的类型定义
@@ -83,6 +84,10 @@ enum JsNodeType : uint8_t {
     NT_PREFIX_XCREASE,
     NT_POSTFIX,
 
+    NT_YIELD,
+    NT_YIELD_DELEGATE,
+    NT_AWAIT,
+
     NT_CONDITIONAL,
     NT_NULLISH,
     NT_LOGICAL_OR,
@@ -275,6 +280,7 @@ public:
     Function(ResourcePool *resourcePool, Scope *parent, uint16_t index, bool isCodeBlock = false, bool isArrowFunction = false);
 
     void generateByteCode();
+    void allocateInlineCaches(uint16_t count);
     void addFunction(Function *f) {
         functions.push_back(f);
     }
@@ -292,6 +298,10 @@ public:
     uint8_t                 *bytecode;
     int                     lenByteCode;
 
+    // 属性访问指令的 inline caches，在生成 bytecode 时分配
+    InlineCache             *inlineCaches;
+    uint16_t                countInlineCaches;
+
     JsNodeParameters        *params;
     VecJsNodes              astNodes;
     VecFunctions            functions; // 所有的子函数列表(包括了子 scope 中的)，用于根据 index 快速找到子 function.
@@ -325,6 +335,12 @@ public:
 
     bool                    isArrowFunction;
 
+    // 预解析的函数: 只检查了语法，还没有参数、语法树和子函数，第一次执行前由 generateByteCode 完整地解析
+    bool                    isLazy;
+    // 预解析的函数参数列表 '(' 在源代码中的位置
+    uint8_t                 *lazyParamsPos;
+    uint32_t                lazyLine, lazyCol;
+
 };
 
 class JsNodes : public IJsNode {
@@ -372,9 +388,9 @@ struct SwitchJump {
 };
 
 struct RegexpInfo {
-    StringView             str;
-    std::regex              re;
-    uint32_t                flags;
+    StringView              str;
+    // 编译的结果，由此正则表达式字面量创建的 JsRegExp 对象共享
+    JsRegExpProgramPtr      program;
 };
 
 using VecSwitchJumps = std::vector<SwitchJump>;
@@ -389,11 +405,20 @@ public:
     uint32_t                nextFreeIdx; // 下一个空闲的索引位置
 
     AllocatorPool           pool;
-    VecStringViewUtf16s     strings;
+    // 延迟解析的函数和 Function.prototype.toString 在执行时也会添加字符串，此时原生函数可能还持有
+    // 其中元素的引用，所以使用 deque: 添加元素时已有元素的地址不变
+    DequeStringViewUtf16s   strings;
     std::vector<double>     doubles;
     VecSwitchJumps          switchCaseJumps;
     std::vector<RegexpInfo> regexps;
 
+    // strings 对应的属性名在所属 VMRuntime 的 atom 表中的 atom，在运行时第一次使用时设置
+    std::vector<uint32_t>   atoms;
+
+    // eval 的代码片段: 复制到 pool 中的源代码和解析得到的 Function, 生成 VMSnapshot 时使用
+    StringView              source;
+    Function                *rootFunction;
+
     // 当 ResourcePool 被释放时，需要调用 toDestructNodes, toDestructScopes 的析构函数
     DequeJsNodes            toDestructNodes;
     DequeScopes             toDestructScopes;
@@ -402,12 +427,24 @@ public:
     ResourcePool(uint32_t index = 0);
     ~ResourcePool();
 
-    void addRegexp(Token &token, const StringView &str, uint32_t flags);
+    // 编译失败返回 false, errorOut 为错误信息
+    bool addRegexp(Token &token, const StringView &str, uint32_t flags, string &errorOut);
 
     inline void needDestructJsNode(IJsNode *node) { toDestructNodes.push_back(node); }
     inline void needDestructScope(Scope *scope) { toDestructScopes.push_back(scope); }
 
-    void convertUtf8ToUtf16(StringViewUtf16 &str);
+    void buildOffsetIndex(StringViewUtf16 &str);
+
+    // 预解析时分配的内存和需要析构的对象，在预解析完成后回滚释放
+    struct Mark {
+        AllocatorPool::Mark     pool;
+        size_t                  countDestructNodes;
+        size_t                  countDestructScopes;
+        size_t                  countRegexps;
+    };
+
+    Mark mark() const { return { pool.mark(), toDestructNodes.size(), toDestructScopes.size(), regexps.size() }; }
+    void rollback(const Mark &mark);
 
     void dump(BinaryOutputStream &stream);
 
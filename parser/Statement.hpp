@@ -230,8 +230,11 @@ public:
         stmt->convertToByteCode(stream);
         stream.leaveBreakContinueArea();
 
-        if (finalExpr)
+        if (finalExpr) {
             finalExpr->convertToByteCode(stream);
+            // 表达式：需要弹出栈顶值
+            stream.writeOpCode(OP_POP_STACK_TOP);
+        }
 
         stream.writeOpCode(OP_JUMP);
         stream.writeAddress(addrLoopStart);
@@ -461,6 +464,11 @@ public:
         stmtTry->convertToByteCode(stream);
 
         if (stmtCatch) {
+            if (!stmtFinal) {
+                // 没有 finally，顺序执行完 try 需要去掉添加的处理点 (有 finally 时由 OP_BEGIN_FINALLY_NORMAL 去掉)
+                stream.writeOpCode(OP_TRY_END);
+            }
+
             // 顺序从 try 执行的指令应该跳转到 catch 结束
             stream.writeOpCode(OP_JUMP);
             auto addrCatchEnd = stream.writeReservedAddress();
@@ -108,3 +108,83 @@ get a
 {"a":"va"}
 */
 
+
+// Index: 4
+// parse
+function f() {
+    var list = JSON.parse('[{"id": 1, "name": "a", "pos": {"x": 1.5, "y": -0}}, {"id": 2, "name": "\\u4e2d\\u6587", "pos": {"x": 1e3, "y": 2}}]');
+    for (var i = 0; i < list.length; i++) {
+        var item = list[i];
+        console.log(item.id, item.name, item.name.length, item.pos.x, item.pos.x / item.pos.y, Object.keys(item).length);
+    }
+
+    var o = JSON.parse('{"a": 1, "a": 2, "s": "x\\ty\\"z"}');
+    console.log(o.a, o.s, Object.getPrototypeOf(o) === Object.prototype, JSON.stringify(o));
+
+    var bad = ['', '[1,]', '{"a" 1}', '"abc', '01', '{"a": 1} x'];
+    for (var i = 0; i < bad.length; i++) {
+        try {
+            JSON.parse(bad[i]);
+            console.log('no error');
+        } catch (e) {
+            console.log(e.name);
+        }
+    }
+}
+f();
+/* OUTPUT
+1 a 1 1.5 -Infinity 3
+2 中文 2 1000 500 3
+2 x	y"z true {"a":2,"s":"x\ty\"z"}
+SyntaxError
+SyntaxError
+SyntaxError
+SyntaxError
+SyntaxError
+SyntaxError
+*/
+
+
+// Index: 5
+function f() {
+    var o = { n: 1.25, s: 'a"b\\c\n\u0001', arr: [1, 'x', null, undefined, function () {}], nested: { d: new Date(0), b: new Boolean(false) }, u: undefined };
+    console.log(JSON.stringify(o));
+    console.log(JSON.stringify(o, ['n', 'arr']));
+    console.log(JSON.stringify({ a: [1, { b: 2 }], c: {}, e: [] }, null, 2));
+    console.log(JSON.stringify({ a: 1, b: 'x' }, function (k, v) {
+        if (typeof v === 'number') {
+            return v * 10;
+        }
+        return v;
+    }, '--'));
+    console.log(JSON.stringify({ toJSON: function (k) { return 'key:' + k; } }), JSON.stringify(undefined), JSON.stringify([NaN, Infinity, -0]));
+
+    var c = { x: 1 };
+    c.self = c;
+    try {
+        JSON.stringify(c);
+    } catch (e) {
+        console.log(e.name);
+    }
+}
+f();
+/* OUTPUT
+{"n":1.25,"s":"a\"b\\c\n\u0001","arr":[1,"x",null,null,null],"nested":{"d":"1970-01-01T00:00:00.000Z","b":false}}
+{"n":1.25,"arr":[1,"x",null,null,null]}
+{
+  "a": [
+    1,
+    {
+      "b": 2
+    }
+  ],
+  "c": {},
+  "e": []
+}
+{
+--"a": 10,
+--"b": "x"
+}
+"key:" undefined [null,null,0]
+TypeError
+*/
@@ -399,3 +399,40 @@ TypeError: Cannot convert a Symbol value to a string
 109 -1
 */
 
+
+
+// Index: 4
+// double 内联存储边界
+function f() {
+    var one = 1;
+    var values = [0.5, -0.5, one / 3, Math.pow(2, -21), Math.pow(2, -22), Math.pow(2, 42) - 0.5, Math.pow(2, 42) + 0.5, 5e-324, -5e-324, 1e300 * 10];
+    for (var i = 0; i < values.length; i++) {
+        var v = values[i];
+        console.log(i, v, v * 2, v / 2, v - v, v === values[i], v * 0 === 0);
+    }
+
+    var sum = 0;
+    for (var i = 0; i < 1000; i++) {
+        sum += 0.1;
+    }
+    console.log('sum', sum, sum === 99.9999999999986, 0.1 + 0.2 === 0.3, 0.1 + 0.2 == 0.30000000000000004);
+    var obj = { a: 1.5 };
+    obj.a += 0.25;
+    obj.a++;
+    console.log('obj', obj.a, obj.a === 2.75);
+}
+f();
+/* OUTPUT
+0 0.5 1 0.25 0 true true
+1 -0.5 -1 -0.25 0 true true
+2 0.3333333333333333 0.6666666666666666 0.16666666666666666 0 true true
+3 4.76837158203125e-7 9.5367431640625e-7 2.384185791015625e-7 0 true true
+4 2.384185791015625e-7 4.76837158203125e-7 1.1920928955078125e-7 0 true true
+5 4398046511103.5 8796093022207 2199023255551.75 0 true true
+6 4398046511104.5 8796093022209 2199023255552.25 0 true true
+7 5e-324 1e-323 0 0 true true
+8 -5e-324 -1e-323 -0 0 true true
+9 1e+301 2e+301 5e+300 0 true true
+sum 99.9999999999986 true false true
+obj 2.75 true
+*/
@@ -682,3 +682,73 @@ f();
 end
 */
 
+
+
+// Index: 27
+// Promise.all, allSettled
+function f() {
+    var p1 = new Promise(function(resolve) {
+        setTimeout(function() { resolve('p1'); }, 10);
+    });
+
+    Promise.all([p1, 'v2', Promise.resolve('p3')]).then(function(values) {
+        console.log('all:', values.length, values[0], values[1], values[2]);
+    });
+    Promise.all([p1, Promise.reject('e2')]).catch(function(e) {
+        console.log('all catch:', e);
+    });
+    Promise.allSettled([p1, Promise.reject('e2')]).then(function(results) {
+        console.log('allSettled:', results[0].status, results[0].value, results[1].status, results[1].reason);
+    });
+    Promise.all([]).then(function(values) {
+        console.log('all empty:', values.length);
+    });
+}
+f();
+/* OUTPUT
+all empty: 0
+all catch: e2
+all: 3 p1 v2 p3
+allSettled: fulfilled p1 rejected e2
+*/
+
+
+// Index: 28
+// Promise.any, race
+function f() {
+    var p1 = new Promise(function(resolve, reject) {
+        setTimeout(function() { reject('e1'); }, 10);
+    });
+
+    Promise.any([p1, Promise.resolve('p2')]).then(function(v) {
+        console.log('any:', v);
+    });
+    Promise.any([p1, Promise.reject('e2')]).catch(function(e) {
+        console.log('any catch:', e.name, e.message, e.errors.length, e.errors[0], e.errors[1]);
+    });
+    Promise.race([p1, new Promise(function() {})]).catch(function(e) {
+        console.log('race:', e);
+    });
+}
+f();
+/* OUTPUT
+any: p2
+any catch: AggregateError All promises were rejected 2 e1 e2
+race: e1
+*/
+
+
+// Index: 29
+// 已经 resolve 的 promise 在 setTimeout 中调用 then
+function f() {
+    var p = Promise.resolve('p');
+    setTimeout(function() {
+        p.then(function(v) { console.log('then:', v); });
+        console.log('timeout');
+    }, 0);
+}
+f();
+/* OUTPUT
+timeout
+then: p
+*/
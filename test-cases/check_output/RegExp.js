@@ -85,3 +85,48 @@ true
 false
 */
 
+
+// Index: 4
+// named groups, sticky, lookaround and backreferences
+function f() {
+    var m = /(?<year>\d{4})-(?<month>\d{2})(-(\d{2}))?/.exec('on 2023-01 ok');
+    console.log(m.index, m[0], m.groups.year, m.groups.month, m[3], m[4]);
+
+    var re = /\w+/y;
+    re.lastIndex = 3;
+    console.log(re.test('ab cd'), re.lastIndex);
+    re.lastIndex = 2;
+    console.log(re.test('ab cd'), re.lastIndex);
+
+    console.log('$10.53 and 7'.replace(/(?<=\$)\d+(\.\d+)?/, 'N'), /(?<!\d)\d\b/.exec('12 3').index);
+    console.log(/(\w)\1+/.exec('abccccd')[0], /\b(\w+) \1\b/i.test('Hello hello'));
+    console.log('2023-01-18'.replace(/(\d+)-(\d+)-(\d+)/, '$3/$2/$1'), 'aaa'.replace(/a*?/g, '-'));
+    console.log('a1b22c333'.split(/(\d+)/).length, 'a, b ,c'.split(/\s*,\s*/).length);
+
+    var s = '';
+    for (var item of 'x=1, y=22'.matchAll(/(?<key>\w)=(?<value>\d+)/g)) {
+        s += item.groups.key + ':' + item.groups.value + '@' + item.index + ' ';
+    }
+    console.log(s);
+    console.log('aBc'.replace(/b/gi, function (c, index) { return '[' + c + index + ']'; }));
+
+    try {
+        new RegExp('a(b');
+    } catch (e) {
+        console.log(e.name, e.message);
+    }
+}
+f();
+/* OUTPUT
+3 2023-01 2023 01 undefined undefined
+true 5
+false 0
+$N and 7 3
+cccc true
+18/01/2023 -a-a-a-
+7 3
+x:1@0 y:22@5 
+a[B1]c
+SyntaxError Invalid regular expression: /a(b/: Unterminated group
+*/
+
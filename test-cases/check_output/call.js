@@ -0,0 +1,174 @@
+// Index: 0
+// 递归调用时每次调用都有自己的 scope
+var h = function (n) {
+    var x = n;
+    if (n > 0) {
+        h(n - 1);
+    }
+    return x;
+};
+console.log(h(2), h(5));
+
+function fib(n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+console.log(fib(20));
+
+function outer() {
+    var a = 'a';
+    function inner(n) {
+        if (n == 0) {
+            return a;
+        }
+        return inner(n - 1) + n;
+    }
+    return inner(5);
+}
+console.log(outer());
+/* OUTPUT
+2 5
+6765
+a12345
+*/
+
+
+// Index: 1
+// 较深的递归调用和调用层次超限
+function depth(n) {
+    if (n == 0) {
+        return 0;
+    }
+    return depth(n - 1) + 1;
+}
+console.log(depth(5000));
+
+function infinite(n) {
+    return infinite(n + 1) + 1;
+}
+try {
+    infinite(0);
+} catch (e) {
+    console.log(e instanceof RangeError, e.message);
+}
+console.log(depth(100));
+/* OUTPUT
+5000
+true Maximum call stack size exceeded
+100
+*/
+
+
+// Index: 2
+// 异常穿过多层函数调用
+function thrower(n) {
+    if (n == 0) {
+        throw new Error('deep');
+    }
+    return thrower(n - 1) + 1;
+}
+
+function mid(n) {
+    try {
+        return thrower(n);
+    } catch (e) {
+        return 'caught ' + e.message;
+    } finally {
+        console.log('finally', n);
+    }
+}
+console.log(mid(3));
+
+function withFinally(n) {
+    try {
+        return thrower(n);
+    } finally {
+        console.log('withFinally', n);
+    }
+}
+try {
+    withFinally(2);
+} catch (e) {
+    console.log('outer', e.message);
+}
+/* OUTPUT
+finally 3
+caught deep
+withFinally 2
+outer deep
+*/
+
+
+// Index: 3
+// new 和 native function 中调用 JavaScript 函数
+function Point(x, y) {
+    this.x = x;
+    this.y = y;
+}
+Point.prototype.sum = function () {
+    return this.x + this.y;
+};
+
+function makePoints(n) {
+    if (n == 0) {
+        return 0;
+    }
+    var p = new Point(n, makePoints(n - 1));
+    return p.sum();
+}
+console.log(makePoints(10));
+
+function viaNative(n) {
+    if (n == 0) {
+        return 0;
+    }
+    return [n].map(function (v) { return viaNative(v - 1) + v; })[0];
+}
+console.log(viaNative(100));
+/* OUTPUT
+55
+5050
+*/
+
+
+// Index: 4
+// 正常执行完成的 try 不能再接收之后其他函数中的异常
+function tryNormal(n) {
+    var r = 0;
+    try {
+        r = n + 1;
+    } catch (e) {
+        r = -1;
+    }
+    return r;
+}
+
+function fail(msg) {
+    throw new Error(msg);
+}
+
+try {
+    var s = tryNormal(1);
+    fail('x');
+    console.log('not here');
+} catch (e) {
+    console.log(s, 'caught', e.message);
+}
+
+for (var i = 0; i < 3; i++) {
+    try {
+        s = tryNormal(s);
+        if (i == 2) {
+            fail('y' + s);
+        }
+    } catch (e) {
+        console.log('caught', e.message);
+    }
+}
+/* OUTPUT
+2 caught x
+caught y5
+*/
+
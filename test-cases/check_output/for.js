@@ -358,9 +358,9 @@ Round:  13
 12
 13
 Round:  14
-f function() {}
 1 y
 a _x
+f function() {}
 TypeError: [object Object] is not iterable
 Round:  15
 0 a
@@ -373,8 +373,8 @@ Round:  16
 0 1
 1 4
 2 x
-b v2
 a v1
+b v2
 1
 4
 x
@@ -494,3 +494,49 @@ undefined
 3 2
 */
 
+
+// Index: 18
+// 融合指令的快速路径不满足时，按原指令执行
+function f(n) {
+    var out = [];
+    for (var i = 0.5; i < n; i++) {
+        out.push(i);
+    }
+    for (let k = 'a'; k < 'aaa'; k = k + 'a') {
+        out.push(k);
+    }
+    var big = 2147483646;
+    for (var m = big; m <= big + 1; m++) {
+        out.push(m - 1, m + 1);
+    }
+    var small = -2147483647;
+    for (var j = small; j >= small - 1; j--) {
+        out.push(j - 1);
+    }
+    var s = 0;
+    for (let x = 0; x < n; x++) {
+        s = s + x;
+        s = s - 1;
+    }
+    out.push(s);
+    var u;
+    for (var q = 0; q < 2; q++) {
+        u = u + q;
+    }
+    out.push(u);
+    var c = 0;
+    while (n > c) c += 1;
+    out.push(c, n - c);
+    var r = '' + out[0];
+    for (var t = 1; t < out.length; t++) {
+        r = r + ' ' + out[t];
+    }
+    return r;
+}
+console.log(f(3));
+console.log(f(2.5));
+/* OUTPUT
+0.5 1.5 2.5 a aa 2147483645 2147483647 2147483646 2147483648 -2147483648 -2147483649 0 NaN 3 0
+0.5 1.5 a aa 2147483645 2147483647 2147483646 2147483648 -2147483648 -2147483649 0 NaN 3 -0.5
+*/
+
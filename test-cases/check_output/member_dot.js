@@ -0,0 +1,235 @@
+// Index: 0
+// 同一个位置访问不同 shape 的对象 (polymorphic)
+function str(arr) {
+    var s = '';
+    for (var i = 0; i < arr.length; i++) {
+        if (i > 0) {
+            s += ',';
+        }
+        s += arr[i];
+    }
+    return s;
+}
+
+function getX(o) {
+    return o.x;
+}
+var objs = [{ x: 1 }, { a: 0, x: 2 }, { b: 0, c: 0, x: 3 }, { x: 4, y: 0 }, { d: 0, x: 5 }, { e: 0, x: 6 }, { y: 7 }, 8, 'str'];
+var out = [];
+for (var round = 0; round < 3; round++) {
+    for (var i = 0; i < objs.length; i++) {
+        out.push(getX(objs[i]));
+    }
+}
+console.log(str(out));
+/* OUTPUT
+1,2,3,4,5,6,undefined,undefined,undefined,1,2,3,4,5,6,undefined,undefined,undefined,1,2,3,4,5,6,undefined,undefined,undefined
+*/
+
+
+// Index: 1
+// 属性在 prototype 上，prototype 被修改后，需要读取到新的值
+function str(arr) {
+    var s = '';
+    for (var i = 0; i < arr.length; i++) {
+        if (i > 0) {
+            s += ',';
+        }
+        s += arr[i];
+    }
+    return s;
+}
+
+function Point(x) {
+    this.x = x;
+}
+Point.prototype.scale = 2;
+Point.prototype.get = function () { return this.x * this.scale; };
+
+var p = new Point(3), q = new Point(4);
+var out = [];
+for (var i = 0; i < 4; i++) {
+    if (i == 1) {
+        Point.prototype.scale = 10;
+    } else if (i == 2) {
+        q.scale = 100;
+    } else if (i == 3) {
+        Point.prototype.get = function () { return -this.x; };
+    }
+    out.push(p.get(), q.get(), p.scale, q.scale);
+}
+console.log(str(out));
+
+Object.setPrototypeOf(p, { get: function () { return 'new proto'; }, scale: 'S' });
+console.log(p.get(), p.scale, q.get());
+/* OUTPUT
+6,8,2,2,30,40,10,10,30,400,10,100,-3,-4,10,100
+new proto S -4
+*/
+
+
+// Index: 2
+// 数据属性被替换为 getter/setter，或者变为只读
+function read(o) { return o.v; }
+function write(o, v) { o.v = v; return o.v; }
+
+var o = { v: 1 };
+console.log(read(o), read(o), write(o, 2), write(o, 3));
+
+Object.defineProperty(o, 'v', { get: function () { return 'getter'; }, set: function (v) { console.log('setter', v); }, configurable: true });
+console.log(read(o), write(o, 4));
+
+Object.defineProperty(o, 'v', { value: 5, writable: false, configurable: true });
+console.log(read(o), write(o, 6));
+
+var f = Object.freeze({ v: 7 });
+console.log(read(f), write(f, 8));
+/* OUTPUT
+1 1 2 3
+setter 4
+getter getter
+5 5
+7 7
+*/
+
+
+// Index: 3
+// 删除属性和大量属性的对象 (字典模式)
+function str(arr) {
+    var s = '';
+    for (var i = 0; i < arr.length; i++) {
+        if (i > 0) {
+            s += ',';
+        }
+        s += arr[i];
+    }
+    return s;
+}
+
+function read(o) { return [o.a, o.b, o.c]; }
+
+var o = { a: 1, b: 2, c: 3 };
+console.log(str(read(o)));
+delete o.c;
+console.log(str(read(o)));
+delete o.a;
+console.log(str(read(o)));
+o.a = 'a2';
+o.c = 'c2';
+console.log(str(read(o)));
+
+var big = {};
+for (var i = 0; i < 100; i++) {
+    big['k' + i] = i;
+}
+big.a = 'x';
+console.log(str(read(big)), big.k0, big.k99, Object.keys(big).length);
+delete big.k50;
+console.log(big.k49, big.k50, big.k51, Object.keys(big).length);
+
+var n = { b: 1, 2: 'two', a: 2, 1: 'one' };
+console.log(str(Object.keys(n)));
+/* OUTPUT
+1,2,3
+1,2,undefined
+undefined,2,undefined
+a2,2,c2
+x,undefined,undefined 0 99 101
+49 undefined 51 100
+1,2,b,a
+*/
+
+
+// Index: 4
+// 复合赋值和方法调用
+function Counter() {
+    this.n = 0;
+    this.items = [];
+}
+Counter.prototype.add = function (v) {
+    this.n += v;
+    this.items.push(v);
+    return this;
+};
+
+var c = new Counter(), d = new Counter();
+for (var i = 0; i < 10; i++) {
+    c.add(i);
+    d.add(i * 2).add(1);
+}
+console.log(c.n, d.n, c.items.length, d.items.length);
+
+var o = { s: 'a' };
+for (var i = 0; i < 5; i++) {
+    o.s += i;
+}
+console.log(o.s, o.missing);
+/* OUTPUT
+45 100 10 20
+a01234 undefined
+*/
+
+
+// Index: 5
+// obj.method() 融合为一条指令后，取属性和调用中的异常
+var o = {
+    n: 1,
+    add(d) { this.n = this.n + d; return this; },
+    get bad() { throw 'getter'; },
+    notFunc: 5,
+};
+o.add(2).add(3);
+console.log(o.n);
+try {
+    o.bad();
+} catch (e) {
+    console.log('caught', e);
+}
+try {
+    o.notFunc();
+} catch (e) {
+    console.log(e instanceof TypeError);
+}
+try {
+    o.missing(1);
+} catch (e) {
+    console.log(e instanceof TypeError);
+}
+var s = 'abc';
+console.log(s.toUpperCase(), o.add(4).n);
+/* OUTPUT
+6
+caught getter
+true
+true
+ABC 10
+*/
+
+// Index: 6
+// 按照数字 index 访问普通对象的属性: 对象自身、prototype 上的数字属性，以及删除后的属性
+var o = { a: 1, b: 2 };
+var p = { x: 'px' };
+p[3] = 'p3';
+o.__proto__ = p;
+console.log(o[0], o[3], o['3'], o.x);
+o[1] = 'one';
+o['2'] = 'two';
+console.log(o[1], o['1'], o[2], o[3], Object.keys(o).length);
+var q = { '10': 'ten', y: 1 };
+var r = { y: 2 };
+console.log(q[10], r[10], q['10'], r.y, q.y);
+delete q[10];
+console.log(q[10], q.y);
+var names = ['k1', 'k2', 'k1', 'k3', '', '0'];
+var m = {};
+for (var i = 0; i < names.length; i++) {
+    m[names[i]] = (m[names[i]] || 0) + 1;
+}
+console.log(m.k1, m.k2, m.k3, m[''], m[0], Object.keys(m).length);
+/* OUTPUT
+undefined p3 p3 px
+one one two p3 4
+ten undefined ten 2 1
+undefined 1
+2 1 1 1 1 5
+*/
@@ -0,0 +1,190 @@
+﻿//
+//  ByteCodeCache.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/13.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/FileApi.h"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+void splitTestCodeAndOutput(string textOrg, VecStrings &vCodeOut, VecStrings &vOutputOut);
+
+class CacheTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string cacheFileName() {
+    return getUnittestTempDir() + "tinyjs_bytecode_cache_test.jsbc";
+}
+
+// cacheFile 为空时不使用缓存
+static string runCode(const string &code, const string &cacheFile, bool *isCachedOut = nullptr, const char *prelude = nullptr) {
+    JsVirtualMachine vm;
+    auto console = new CacheTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+
+    if (prelude) {
+        vm.run(prelude, strlen(prelude), runtime);
+    }
+
+    if (cacheFile.empty()) {
+        vm.run(code.c_str(), code.size(), runtime);
+    } else {
+        auto isCached = vm.runWithCache(code.c_str(), code.size(), cacheFile.c_str(), runtime);
+        if (isCachedOut) {
+            *isCachedOut = isCached;
+        }
+    }
+
+    runtime->runUntilIdle();
+
+    return console->output;
+}
+
+TEST(ByteCodeCache, sameOutputAsParsing) {
+    // 缓存的结果和直接解析执行的结果需要完全相同
+    string path = getSourceRootDir() + "test-cases/check_output/";
+    auto cacheFile = cacheFileName();
+
+    FileFind finder;
+    ASSERT_TRUE(finder.openDir(path.c_str(), "js"));
+    while (finder.findNext()) {
+        string name = finder.getCurName();
+        if (name == "Date.js") {
+            // 输出和当前时间相关
+            continue;
+        }
+
+        string text;
+        ASSERT_TRUE(readFile((path + name).c_str(), text));
+
+        VecStrings codes, outputs;
+        splitTestCodeAndOutput(text, codes, outputs);
+
+        for (size_t i = 0; i < codes.size(); i++) {
+            auto &code = codes[i];
+            auto expected = runCode(code, "");
+
+            bool isCached = true;
+            deleteFile(cacheFile.c_str());
+            ASSERT_EQ(runCode(code, cacheFile, &isCached), expected) << name << ", Index: " << i;
+            ASSERT_FALSE(isCached);
+
+            if (!isFileExist(cacheFile.c_str())) {
+                // 有语法错误，不会生成缓存
+                continue;
+            }
+
+            ASSERT_EQ(runCode(code, cacheFile, &isCached), expected) << name << ", Index: " << i;
+            ASSERT_TRUE(isCached) << name << ", Index: " << i;
+        }
+    }
+
+    deleteFile(cacheFile.c_str());
+}
+
+TEST(ByteCodeCache, relocateGlobals) {
+    const char *code = R"(
+        var count = 0;
+        function inc() { count++; return count; }
+        inc(); inc();
+        console.log(count, typeof count, Math.max(1, 2));
+        try { undeclared; } catch (e) { console.log(e.name); }
+        switch ('b') { case 'a': console.log('a'); break; case 'b': console.log('b'); break; case 'c': console.log('c'); break; }
+        console.log(/a+b/.test('xaab'), inc.toString());
+    )";
+    const char *expected = "2 number 2\nReferenceError\nb\ntrue function inc() { count++; return count; }\n";
+
+    auto cacheFile = cacheFileName();
+    deleteFile(cacheFile.c_str());
+
+    bool isCached = true;
+    ASSERT_EQ(runCode(code, cacheFile, &isCached), expected);
+    ASSERT_FALSE(isCached);
+
+    // 先声明其他的全局变量，全局变量的索引和生成缓存时不同
+    ASSERT_EQ(runCode(code, cacheFile, &isCached, "var a1 = 1, a2 = 2, count = 10; other = 5;"), expected);
+    ASSERT_TRUE(isCached);
+
+    // 源代码修改后，缓存失效，并被更新
+    string code2 = string(code) + "console.log('changed');";
+    ASSERT_EQ(runCode(code2, cacheFile, &isCached), string(expected) + "changed\n");
+    ASSERT_FALSE(isCached);
+    ASSERT_EQ(runCode(code2, cacheFile, &isCached), string(expected) + "changed\n");
+    ASSERT_TRUE(isCached);
+
+    // 损坏的缓存
+    string data;
+    ASSERT_TRUE(readFile(cacheFile.c_str(), data));
+    data[data.size() / 2] ^= 0x5A;
+    ASSERT_TRUE(writeFile(cacheFile.c_str(), data.c_str(), data.size()));
+    ASSERT_EQ(runCode(code2, cacheFile, &isCached), string(expected) + "changed\n");
+    ASSERT_FALSE(isCached);
+
+    deleteFile(cacheFile.c_str());
+}
+
+TEST(ByteCodeCache, DISABLED_benchmark) {
+    // 对比启动时解析源代码和加载缓存的耗时:
+    //   TinyJS --gtest_filter=ByteCodeCache.* --gtest_also_run_disabled_tests
+    string code;
+    const int COUNT_FUNCTIONS = 20000;
+    for (int i = 0; i < COUNT_FUNCTIONS; i++) {
+        auto n = std::to_string(i);
+        code += "function f" + n + "(a, b) {\n"
+            "    var s = 'item-" + n + "', o = { x: a, y: b, name: s };\n"
+            "    for (let k = 0; k < b; k++) {\n"
+            "        if (o.x > k) { o.y += k * 1.5; } else { o.name = o.name + k; }\n"
+            "    }\n"
+            "    switch (a) { case 1: return o.x; case 2: return o.y; case 3: return o.name; default: return [a, b, o]; }\n"
+            "}\n";
+    }
+    code += "console.log(f0(1, 2));\n";
+    printf("Source code size: %d KB, functions: %d\n", (int)code.size() / 1024, COUNT_FUNCTIONS);
+
+    auto cacheFile = cacheFileName();
+    deleteFile(cacheFile.c_str());
+
+    const int COUNT_ROUNDS = 5;
+    int64_t bestParse = INT64_MAX, bestLoad = INT64_MAX;
+    bool isCached = false;
+
+    auto start = getTickCount();
+    ASSERT_EQ(runCode(code, cacheFile, &isCached), "1\n");
+    ASSERT_FALSE(isCached);
+    printf("  parse and write cache: %6d ms, cache size: %d KB\n", (int)(getTickCount() - start), (int)(getFileLength(cacheFile.c_str()) / 1024));
+
+    for (int i = 0; i < COUNT_ROUNDS; i++) {
+        start = getTickCount();
+        ASSERT_EQ(runCode(code, ""), "1\n");
+        bestParse = std::min(bestParse, (int64_t)(getTickCount() - start));
+
+        start = getTickCount();
+        ASSERT_EQ(runCode(code, cacheFile, &isCached), "1\n");
+        bestLoad = std::min(bestLoad, (int64_t)(getTickCount() - start));
+        ASSERT_TRUE(isCached);
+    }
+
+    printf("  cold parse:            %6d ms\n", (int)bestParse);
+    printf("  cached load:           %6d ms\n", (int)bestLoad);
+
+    deleteFile(cacheFile.c_str());
+}
+
+#endif
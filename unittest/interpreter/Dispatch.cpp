@@ -0,0 +1,127 @@
+﻿//
+//  Dispatch.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/10.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class DispatchTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+struct DispatchBenchCase {
+    const char                  *name;
+    const char                  *code;
+    const char                  *expected;
+};
+
+// 每个用例都以简单的 opcode 为主，使分派的开销占主要部分
+static DispatchBenchCase dispatchBenchCases[] = {
+    { "loop", R"(
+        var n = 0;
+        for (var i = 0; i < 3000000; i++) {
+            n = n + 1;
+        }
+        console.log(n);
+    )", "3000000\n" },
+    { "arithmetic", R"(
+        var a = 1, b = 2, c = 0;
+        for (var i = 0; i < 1000000; i++) {
+            c = (a + b) * 3 - (c & 255) + (i >> 2) - (i | 1) + (a ^ b);
+        }
+        console.log(c);
+    )", "-750080\n" },
+    { "locals", R"(
+        function f() {
+            var a = 0, b = 1, c = 2, d = 3;
+            for (var i = 0; i < 2000000; i++) {
+                a = b; b = c; c = d; d = a;
+            }
+            return a + b + c + d;
+        }
+        console.log(f());
+    )", "8\n" },
+    { "member_dot", R"(
+        var o = { x: 1, y: 2 };
+        var s = 0;
+        for (var i = 0; i < 1000000; i++) {
+            s = s + o.x + o.y;
+            o.x = o.y;
+        }
+        console.log(s);
+    )", "3999999\n" },
+    { "call", R"(
+        function add(a, b) { return a + b; }
+        var s = 0;
+        for (var i = 0; i < 500000; i++) {
+            s = add(s, 1);
+        }
+        console.log(s);
+    )", "500000\n" },
+    { "method", R"(
+        function run(n) {
+            var counter = { v: 0, inc(d) { this.v = this.v + d; } };
+            for (let i = 0; i < n; i++) {
+                counter.inc(i - 1);
+            }
+            return counter.v;
+        }
+        console.log(run(500000));
+    )", "124999250000\n" },
+};
+
+TEST(Dispatch, DISABLED_benchmark) {
+    // 对比 direct-threaded 和 switch 两种分派方式:
+    // 分别使用 VM_DIRECT_THREADED=1 和 VM_DIRECT_THREADED=0 编译后运行
+    //   TinyJS --gtest_filter=Dispatch.* --gtest_also_run_disabled_tests
+    printf("Dispatch mode: %s\n", VM_DIRECT_THREADED ? "direct-threaded" : "switch");
+
+    const int COUNT_ROUNDS = 5;
+    int64_t total = 0;
+
+    for (auto &item : dispatchBenchCases) {
+        int64_t best = INT64_MAX;
+        for (int i = 0; i < COUNT_ROUNDS; i++) {
+            JsVirtualMachine vm;
+            auto console = new DispatchTestConsole();
+            auto runtime = vm.defaultRuntime();
+            runtime->setConsole(console);
+
+            auto start = getTickCount();
+            vm.run(item.code, strlen(item.code), runtime);
+            best = std::min(best, (int64_t)(getTickCount() - start));
+
+            ASSERT_EQ(console->output, item.expected);
+        }
+
+        printf("  %-12s %6d ms\n", item.name, (int)best);
+        total += best;
+    }
+
+    printf("  %-12s %6d ms\n", "total", (int)total);
+
+#if VM_OPCODE_PAIR_STATS
+    BinaryOutputStream stream;
+    dumpOpCodePairStats(stream);
+    auto stats = stream.toLinkedString();
+    printf("Opcode pairs:\n%.*s", (int)stats->len, stats->data);
+#endif
+}
+
+#endif
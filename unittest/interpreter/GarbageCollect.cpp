@@ -0,0 +1,302 @@
+﻿//
+//  GarbageCollect.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/6.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/FileApi.h"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+void splitTestCodeAndOutput(string textOrg, VecStrings &vCodeOut, VecStrings &vOutputOut);
+
+class GcTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runWithGcThreshold(JsVirtualMachine &vm, GcTestConsole *console, const char *code, uint32_t threshold) {
+    auto runtime = vm.defaultRuntime();
+    runtime->setGarbageCollectThreshold(threshold);
+
+    console->output.clear();
+    vm.run(code, strlen(code), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+TEST(GarbageCollect, midExecution) {
+    // 阈值很小，循环和函数调用中会频繁地执行 GC，存活的对象不能被回收
+    const char *code = R"(
+        function makeCounter(name) {
+            var count = 0;
+            return function () { count++; return name + ':' + count; };
+        }
+
+        var counters = [];
+        for (var i = 0; i < 5; i++) {
+            counters.push(makeCounter('c' + i));
+        }
+
+        var keep = { list: [], map: {} };
+        var s = '';
+        for (var i = 0; i < 2000; i++) {
+            var tmp = { a: [i, i + 0.5, 'x' + i], b: 'y' + i };
+            if (i % 500 == 0) {
+                keep.list.push(tmp);
+                keep.map['k' + i] = tmp.a;
+            }
+            s = counters[i % 5]();
+        }
+
+        var arr = [3, 1, 2].map(function (x) { var o = { v: 'v' + x }; for (var j = 0; j < 100; j++) { var t = [j]; } return o; });
+        var g = { get v() { return 'getter' + keep.list.length; } };
+
+        console.log(s);
+        console.log(JSON.stringify(keep.list.map(function (o) { return o.a; })));
+        console.log(keep.map.k1500[2], keep.list[2].b);
+        console.log(JSON.stringify(arr.map(function (o) { return o.v; })));
+        console.log(g.v);
+        Promise.resolve('p').then(function (v) { for (var j = 0; j < 300; j++) { var t = { j: j }; } console.log(v + keep.list.length); });
+    )";
+
+    JsVirtualMachine vm;
+    auto console = new GcTestConsole();
+    vm.defaultRuntime()->setConsole(console);
+
+    auto output = runWithGcThreshold(vm, console, code, 64);
+    ASSERT_EQ(output, "c4:400\n"
+              "[[0,0.5,\"x0\"],[500,500.5,\"x500\"],[1000,1000.5,\"x1000\"],[1500,1500.5,\"x1500\"]]\n"
+              "x1500 y1000\n"
+              "[\"v3\",\"v1\",\"v2\"]\n"
+              "getter4\n"
+              "p4\n");
+
+    // 全局变量在多次 run 之间保持有效
+    output = runWithGcThreshold(vm, console, "console.log(counters[0](), keep.list[3].b, s);", 64);
+    ASSERT_EQ(output, "c0:401 y1500 c4:400\n");
+}
+
+TEST(GarbageCollect, minorOldToYoung) {
+    // 老年代的对象、数组、Map、scope 和 promise 中写入新生代的值，minor GC 时不能被回收
+    const char *code = R"(
+        var old = { list: [], obj: {}, last: null };
+        var map = new Map(), set = new Set();
+        var total = 0;
+        function makeAdder() {
+            var saved = [];
+            return function (v) { saved.push({ v: v }); total += saved.length; return saved; };
+        }
+        var adder = makeAdder();
+        var pending = new Promise(function (resolve) { old.resolve = resolve; });
+
+        for (var i = 0; i < 3000; i++) {
+            var tmp = { n: i, s: 'tmp' + i, d: i + 0.25 };
+            if (i % 300 == 0) {
+                old.list.push(tmp);
+                old.obj['k' + i] = [tmp.s, tmp.d];
+                old.last = tmp;
+                map.set('k' + i, tmp);
+                set.add(tmp.s);
+                adder('a' + i);
+            }
+        }
+
+        var filtered = [5, 3, 9, 1].filter(function (x) { var t = { x: x }; for (var j = 0; j < 50; j++) { t = { p: t }; } return x > 2; });
+        var mapped = old.list.map(function (o) { for (var j = 0; j < 50; j++) { var t = [j, 'j' + j]; } return o.s + '/' + o.d; });
+        pending.then(function (v) { for (var j = 0; j < 200; j++) { var t = { j: j }; } console.log('resolved', v.s, v.d); });
+        old.resolve({ s: 'r' + old.list.length, d: old.last.d });
+
+        console.log(old.list.length, old.obj.k2700[0], old.obj.k1500[1], old.last.s, total);
+        var saved = adder('z').map(function (o) { return o.v; });
+        console.log(saved.length, saved[0], saved[5], saved[10]);
+        console.log(filtered.length, filtered[2], mapped[3], mapped[9]);
+        console.log(map.size, map.get('k2400').s, set.has('tmp600'));
+    )";
+
+    JsVirtualMachine vm;
+    auto console = new GcTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    runtime->clearGcStats();
+    runtime->setVerifyWriteBarrier(true);
+
+    auto output = runWithGcThreshold(vm, console, code, 32);
+    ASSERT_EQ(runtime->countMissedWriteBarriers(), 0);
+    ASSERT_EQ(output, "10 tmp2700 1500.25 tmp2700 55\n"
+              "11 a0 a1500 z\n"
+              "3 9 tmp900/900.25 tmp2700/2700.25\n"
+              "10 tmp2400 true\n"
+              "resolved r10 2700.25\n");
+
+    auto &stats = runtime->gcStats();
+#if VM_GENERATIONAL_GC
+    ASSERT_GT(stats.countMinor, 0u);
+    ASSERT_GT(stats.countPromoted, 0u);
+#endif
+    ASSERT_GT(stats.countMinor + stats.countMajor, 0u);
+}
+
+TEST(GarbageCollect, doublesNotAllocated) {
+    // 任意范围的 double 都内联在 JsValue 中，浮点运算不分配存储
+    const char *code = R"(
+        var s = 0, t = 0, m = 0, n = 0;
+        for (var i = 0; i < 1000; i++) {
+            s = s + i * 1e12;
+            t = t * 1e-3 + i * 1e-9;
+            m = -i * 1e300 * 1e300;
+            n = i / 0 - i / 0;
+        }
+    )";
+
+    JsVirtualMachine vm;
+    auto console = new GcTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+
+    auto count = runtime->countAllocated();
+    runWithGcThreshold(vm, console, code, 1024 * 1024);
+    ASSERT_LT(runtime->countAllocated() - count, 10u);
+
+    runWithGcThreshold(vm, console, "console.log(s, t.toFixed(12), m, n, Object.is(-0 * s, -0));", 1024 * 1024);
+    ASSERT_EQ(console->output, "499500000000000000 0.000000999999 -Infinity NaN true\n");
+}
+
+TEST(GarbageCollect, smallNurserySameOutput) {
+    // 新生代很小时会频繁地执行 minor GC，输出需要和默认的阈值完全相同
+    string path = getSourceRootDir() + "test-cases/check_output/";
+
+    FileFind finder;
+    ASSERT_TRUE(finder.openDir(path.c_str(), "js"));
+    while (finder.findNext()) {
+        string name = finder.getCurName();
+        if (name == "Date.js") {
+            // 输出和当前时间相关
+            continue;
+        }
+
+        string text;
+        ASSERT_TRUE(readFile((path + name).c_str(), text));
+
+        VecStrings codes, outputs;
+        splitTestCodeAndOutput(text, codes, outputs);
+
+        for (size_t i = 0; i < codes.size(); i++) {
+            auto code = codes[i].c_str();
+            string expected, output;
+            {
+                JsVirtualMachine vm;
+                auto console = new GcTestConsole();
+                vm.defaultRuntime()->setConsole(console);
+                expected = runWithGcThreshold(vm, console, code, 1024 * 64);
+            }
+            {
+                JsVirtualMachine vm;
+                auto console = new GcTestConsole();
+                auto runtime = vm.defaultRuntime();
+                runtime->setConsole(console);
+                runtime->setVerifyWriteBarrier(true);
+                output = runWithGcThreshold(vm, console, code, 8);
+                ASSERT_EQ(runtime->countMissedWriteBarriers(), 0) << name << ", Index: " << i;
+            }
+            ASSERT_EQ(output, expected) << name << ", Index: " << i;
+        }
+    }
+}
+
+TEST(GarbageCollect, DISABLED_stress) {
+    // 持续分配 10 分钟，内存占用 (RSS) 应该保持稳定
+    const char *code = R"(
+        var keep = [];
+        for (var i = 0; i < 200000; i++) {
+            var o = { i: i, d: i + 0.5, s: 'str' + i, a: [i, { n: i }], f: function () { return o; } };
+            keep[i % 100] = o;
+        }
+    )";
+
+    JsVirtualMachine vm;
+    auto console = new GcTestConsole();
+    vm.defaultRuntime()->setConsole(console);
+
+    const int64_t DURATION = 10 * 60 * 1000;
+    auto start = getTickCount();
+    size_t memBaseline = 0;
+    int round = 0;
+
+    while (getTickCount() - start < DURATION) {
+        runWithGcThreshold(vm, console, code, 1024 * 64);
+        ASSERT_EQ(console->output, "");
+
+        round++;
+        auto mem = getProcessMemoryUsage();
+        if (round == 3) {
+            // 前几轮用于预热: 各个对象池扩展到稳定的大小
+            memBaseline = mem;
+        } else if (round > 3) {
+            ASSERT_LT(mem, memBaseline * 3 / 2);
+        }
+    }
+}
+
+TEST(GarbageCollect, DISABLED_benchmark) {
+    // 老年代中有大量存活的对象时，对比 minor GC 和 major GC 的停顿时间:
+    //   TinyJS --gtest_filter=GarbageCollect.* --gtest_also_run_disabled_tests
+    const char *codeOld = R"(
+        var keep = [];
+        for (var i = 0; i < 200000; i++) {
+            keep[i] = { i: i, s: 'keep' + i, a: [i] };
+        }
+    )";
+    const char *codeYoung = R"(
+        var sum = 0;
+        for (var k = 0; k < 20; k++) {
+            for (var i = 0; i < 50000; i++) {
+                var o = { i: i, d: i + 0.5, s: 'tmp' + i };
+                sum += o.d;
+                if (i % 5000 == 0) { keep[i] = o; }
+            }
+        }
+        console.log(keep.length, sum);
+    )";
+
+    JsVirtualMachine vm;
+    auto console = new GcTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+
+    runWithGcThreshold(vm, console, codeOld, 1024 * 16);
+    runtime->clearGcStats();
+
+    auto start = getTickCount();
+    runWithGcThreshold(vm, console, codeYoung, 1024 * 16);
+    auto duration = getTickCount() - start;
+
+    auto stats = runtime->gcStats();
+    printf("  total time: %d ms, promoted: %d\n", (int)duration, (int)stats.countPromoted);
+    printf("  minor GC: %6d times, avg pause: %8.1f us, max pause: %8d us\n", stats.countMinor,
+           stats.countMinor ? (double)stats.minorPauseTotal / stats.countMinor : 0.0, stats.minorPauseMax);
+    printf("  major GC: %6d times, avg pause: %8.1f us, max pause: %8d us\n", stats.countMajor,
+           stats.countMajor ? (double)stats.majorPauseTotal / stats.countMajor : 0.0, stats.majorPauseMax);
+
+    // 相同的堆上执行一次完整的 GC
+    runtime->clearGcStats();
+    runtime->garbageCollect();
+    printf("  full GC of the same heap:      pause: %8d us\n", (int)runtime->gcStats().majorPauseMax);
+}
+
+#endif
@@ -0,0 +1,225 @@
+//
+//  Generator.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/25.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class GeneratorTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runGeneratorCode(const char *code, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    auto console = new GeneratorTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+TEST(Generator, nextThrowReturn) {
+    const char *code = R"(
+        function* gen(a) {
+            var x = yield a;
+            console.log('got', x);
+            try {
+                yield x * 2;
+                yield 100;
+            } finally {
+                console.log('finally');
+            }
+            return 'end';
+        }
+        var g = gen(5), s = '';
+        for (var i = 0; i < 5; i++) {
+            var r = g.next(7);
+            s += r.value + ':' + r.done + ',';
+        }
+        console.log(s);
+
+        g = gen(1);
+        g.next();
+        g.next(3);
+        var r = g.return(42);
+        console.log(r.value, r.done);
+
+        function* thrower() {
+            try { yield 1; } catch (e) { console.log('caught', e); yield 2; }
+        }
+        var t = thrower();
+        t.next();
+        r = t.throw('boom');
+        console.log(r.value, r.done);
+        try { t.throw('out'); } catch (e) { console.log('uncaught', e, t.next().done); }
+
+        // finally 中暂停后, return 的值需要保留
+        function* cleanup() { try { yield 1; } finally { yield 'cleanup'; } }
+        g = cleanup();
+        g.next();
+        r = g.return('R');
+        console.log(r.value, r.done);
+        r = g.next();
+        console.log(r.value, r.done);
+
+        function* self() { it.next(); yield 1; }
+        var it = self();
+        try { it.next(); } catch (e) { console.log('running', e instanceof TypeError); }
+    )";
+
+    ASSERT_EQ(runGeneratorCode(code),
+        "got 7\n"
+        "finally\n"
+        "5:false,14:false,100:false,end:true,undefined:true,\n"
+        "got 3\n"
+        "finally\n"
+        "42 true\n"
+        "caught boom\n"
+        "2 false\n"
+        "uncaught out true\n"
+        "cleanup false\n"
+        "R true\n"
+        "running true\n");
+}
+
+TEST(Generator, iterate) {
+    const char *code = R"(
+        function* range(n) { for (var i = 0; i < n; i++) { yield i; } }
+        function* outer() { yield 'a'; yield* range(3); yield* [7, 8]; yield 'z'; }
+        var s = '';
+        for (var v of outer()) { s += v + ','; }
+        console.log(s);
+
+        var obj = { x: 9, *m() { yield this.x; } };
+        console.log(obj.m().next().value);
+
+        // 同时存在的多个 generator，频繁 GC 时保存的 scope 和栈上的值不能被回收
+        function* fib() { var a = 0, b = 1; while (true) { yield { v: a }; var t = a + b; a = b; b = t; } }
+        var gens = [], sum = 0;
+        for (var k = 0; k < 50; k++) { gens.push(fib()); }
+        for (var i = 0; i < 30; i++) {
+            for (var k = 0; k < gens.length; k++) { var tmp = [i, { x: k }]; sum += gens[k].next().value.v; }
+        }
+        console.log(sum);
+    )";
+
+    auto expected = "a,0,1,2,7,8,z,\n9\n67313400\n";
+    ASSERT_EQ(runGeneratorCode(code), expected);
+    ASSERT_EQ(runGeneratorCode(code, 32), expected);
+}
+
+TEST(Generator, asyncAwait) {
+    const char *code = R"(
+        async function f(x) {
+            console.log('f start', x);
+            var a = await x;
+            console.log('f after await', a);
+            var b = await Promise.resolve(a + 1);
+            return b * 10;
+        }
+        f(1).then(function (v) { console.log('f result', v); });
+        console.log('sync end');
+
+        var af = async (a, b) => { return await a + b; };
+        af(2, 3).then(function (v) { console.log('arrow', v); });
+        var ax = async x => x * 3;
+        ax(4).then(function (v) { console.log('arrow1', v); });
+
+        async function rej() { await null; throw new Error('bad'); }
+        rej().catch(function (e) { console.log('rejected', e.message); });
+        async function tc() { try { await Promise.reject('no'); } catch (e) { return 'caught ' + e; } }
+        tc().then(function (v) { console.log(v); });
+
+        async function nested(n) { if (n == 0) { return 0; } var r = await nested(n - 1); return r + n; }
+        nested(100).then(function (v) { console.log('nested', v); });
+
+        async function worker(id) {
+            var sum = 0;
+            for (var i = 0; i < 20; i++) {
+                var v = await new Promise(function (resolve) { setTimeout(function () { resolve({ n: i }); }, 0); });
+                var junk = [{ a: i }, { b: i }];
+                sum += v.n;
+            }
+            return sum + id;
+        }
+        var items = [];
+        for (var k = 0; k < 5; k++) { items.push(worker(k * 1000)); }
+        Promise.all(items).then(function (r) {
+            var s = '';
+            for (var i = 0; i < r.length; i++) { s += r[i] + ','; }
+            console.log(s);
+        });
+    )";
+
+    auto expected = "f start 1\n"
+        "sync end\n"
+        "f after await 1\n"
+        "arrow1 12\n"
+        "arrow 5\n"
+        "rejected bad\n"
+        "caught no\n"
+        "f result 20\n"
+        "nested 5050\n"
+        "190,1190,2190,3190,4190,\n";
+    auto output = runGeneratorCode(code);
+    ASSERT_EQ(output, expected);
+    ASSERT_EQ(runGeneratorCode(code, 64), expected);
+}
+
+TEST(Generator, DISABLED_benchmark) {
+    // await 和 .then 链的对比:
+    //   TinyJS --gtest_filter=Generator.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        var N = 300000;
+        var t = new Date().getTime();
+        async function loop() {
+            var sum = 0;
+            for (var i = 0; i < N; i++) { sum += await i; }
+            return sum;
+        }
+        loop().then(function (sum) {
+            console.log('await x 300K', new Date().getTime() - t, sum);
+
+            t = new Date().getTime();
+            var p = Promise.resolve(0), count = 0;
+            for (var i = 0; i < N; i++) { p = p.then(function (v) { count++; return v + count - 1; }); }
+            return p;
+        }).then(function (sum) {
+            console.log('then x 300K', new Date().getTime() - t, sum);
+
+            t = new Date().getTime();
+            function* gen() { for (var i = 0; i < N; i++) { yield i; } }
+            sum = 0;
+            for (var v of gen()) { sum += v; }
+            console.log('yield x 300K', new Date().getTime() - t, sum);
+        });
+    )";
+
+    auto output = runGeneratorCode(code);
+    printf("%s", output.c_str());
+}
+
+#endif
@@ -0,0 +1,276 @@
+﻿//
+//  JsonParser.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/19.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "interpreter/VMRuntime.hpp"
+#include "interpreter/JsonParser.hpp"
+#include "objects/JsObject.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class JsonTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runCode(const string &code, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    auto console = new JsonTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code.c_str(), code.size(), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+static string makeRecords(int count) {
+    string json = "[";
+    for (int i = 0; i < count; i++) {
+        auto n = std::to_string(i);
+        if (i > 0) json += ",";
+        json += "{\"id\":" + n + ",\"name\":\"user" + n + "\",\"score\":" + n + ".5,\"active\":" + (i % 2 ? "true" : "false")
+            + ",\"tags\":[\"t" + std::to_string(i % 7) + "\",\"\\u4e2d\\u6587\"],\"address\":{\"city\":\"city" + n + "\",\"zip\":null}}";
+    }
+    return json + "]";
+}
+
+TEST(JsonParser, values) {
+    JsVirtualMachine vm;
+    auto runtime = vm.defaultRuntime();
+    auto ctx = runtime->mainCtx();
+
+    JsonParser parser(ctx);
+    JsValue v;
+
+    // 整数保存为 JDT_INT32, -0 和超出范围的保存为 double
+    ASSERT_TRUE(parser.parse(" 123 ", v));
+    ASSERT_EQ(v.type, JDT_INT32);
+    ASSERT_EQ(v.value.n32, 123);
+
+    ASSERT_TRUE(parser.parse("-2147483648", v));
+    ASSERT_EQ(v.type, JDT_INT32);
+    ASSERT_EQ(v.value.n32, INT32_MIN);
+
+    ASSERT_TRUE(parser.parse("2147483648", v));
+    ASSERT_EQ(v.type, JDT_NUMBER);
+    ASSERT_EQ(runtime->getDouble(v), 2147483648.0);
+
+    ASSERT_TRUE(parser.parse("-0", v));
+    ASSERT_EQ(v.type, JDT_NUMBER);
+    ASSERT_TRUE(std::signbit(runtime->getDouble(v)));
+
+    ASSERT_TRUE(parser.parse("1e2", v));
+    ASSERT_EQ(v.type, JDT_INT32);
+    ASSERT_EQ(v.value.n32, 100);
+
+    ASSERT_TRUE(parser.parse("0.1", v));
+    ASSERT_EQ(runtime->getDouble(v), 0.1);
+    ASSERT_TRUE(parser.parse("1.7976931348623157e308", v));
+    ASSERT_EQ(runtime->getDouble(v), 1.7976931348623157e308);
+    ASSERT_TRUE(parser.parse("123456789012345678901234567890", v));
+    ASSERT_EQ(runtime->getDouble(v), 123456789012345678901234567890.0);
+
+    ASSERT_TRUE(parser.parse("\"a\\n\\u4e2d\\ud83d\\ude00\"", v));
+    ASSERT_EQ(v.type, JDT_STRING);
+    auto &str = runtime->getUtf8String(v);
+    ASSERT_EQ(string((const char *)str.data, str.len), "a\n\xE4\xB8\xAD\xF0\x9F\x98\x80");
+
+    ASSERT_TRUE(parser.parse("[true, false, null, \"\", \"x\"]", v));
+    ASSERT_EQ(v.type, JDT_ARRAY);
+
+    // 错误的输入
+    const char *errors[][2] = {
+        { "", "Unexpected end of JSON input" },
+        { "[1, 2", "Unexpected end of JSON input" },
+        { "{\"a\": 1,}", "Expected property name" },
+        { "[1 2]", "Expected ',' or ']' after array element" },
+        { "01", "Unexpected non-whitespace character after JSON" },
+        { "\"a\tb\"", "Bad control character in string literal" },
+        { "\"\\x\"", "Bad escaped character in JSON" },
+        { "nul", "Unexpected token" },
+        { "[1] x", "Unexpected non-whitespace character after JSON" },
+    };
+    for (auto &item : errors) {
+        ASSERT_FALSE(parser.parse(item[0], v)) << item[0];
+        ASSERT_STREQ(parser.errorMessage(), item[1]) << item[0];
+    }
+
+    ASSERT_FALSE(parser.parse("{\"a\": [1, tru]}", v));
+    ASSERT_EQ(parser.errorOffset(), 10);
+}
+
+TEST(JsonParser, sharedShapes) {
+    // 相同结构的记录使用同一个 shape
+    JsVirtualMachine vm;
+    auto runtime = vm.defaultRuntime();
+    auto ctx = runtime->mainCtx();
+
+    JsonParser parser(ctx);
+    JsValue v;
+    ASSERT_TRUE(parser.parse(makeRecords(100), v));
+
+    auto arr = runtime->getObject(v);
+    JsShape *shape = nullptr, *shapeAddress = nullptr;
+    for (uint32_t i = 0; i < 100; i++) {
+        auto item = arr->getByIndex(ctx, v, i);
+        ASSERT_EQ(item.type, JDT_OBJECT);
+        auto obj = (JsObject *)runtime->getObject(item);
+        auto address = (JsObject *)runtime->getObject(obj->getByName(ctx, item, StringView("address")));
+        if (i == 0) {
+            shape = obj->shape();
+            shapeAddress = address->shape();
+            ASSERT_NE(shape, nullptr);
+        } else {
+            ASSERT_EQ(obj->shape(), shape);
+            ASSERT_EQ(address->shape(), shapeAddress);
+        }
+
+        auto id = obj->getByName(ctx, item, StringView("id"));
+        ASSERT_EQ(id.type, JDT_INT32);
+        ASSERT_EQ(id.value.n32, (int32_t)i);
+    }
+}
+
+TEST(JsonParser, semantics) {
+    const char *code = R"(
+        var o = JSON.parse('{"a": 1, "b": 2, "a": 3, "__proto__": {"x": 1}}');
+        console.log(Object.keys(o).length, o.a, o.x, Object.getPrototypeOf(o).x);
+
+        var keys = '';
+        for (var i = 0; i < 100; i++) { keys += '"k' + i + '": ' + i + ', '; }
+        var big = JSON.parse('{' + keys + '"k5": "dup"}');
+        console.log(Object.keys(big).length, big.k0, big.k5, big.k99);
+
+        var deep = '';
+        for (var i = 0; i < 5000; i++) { deep += '['; }
+        for (var i = 0; i < 5000; i++) { deep += ']'; }
+        var d = JSON.parse(deep), depth = 0;
+        while (Array.isArray(d)) { d = d[0]; depth++; }
+        console.log(depth);
+
+        var r = JSON.parse(' {"a": [1, {"b": 2.5e-1}], "c": "\\u0041\\"\\\\/"} ');
+        console.log(JSON.stringify(r), r.c.length);
+
+        try { JSON.parse('{"a" 1}'); } catch (e) { console.log(e.name); }
+    )";
+
+    ASSERT_EQ(runCode(code),
+        "2 3 1 1\n"
+        "100 0 dup 99\n"
+        "5000\n"
+        "{\"a\":[1,{\"b\":0.25}],\"c\":\"A\\\"\\\\/\"} 4\n"
+        "SyntaxError\n");
+}
+
+TEST(JsonParser, stringsSurviveGc) {
+    // 字符串共享 JsStringBuffer, GC 时不能被释放; 在解析的字符串后追加内容不能修改其他字符串
+    const char *code = R"(
+        var text = '[';
+        for (var i = 0; i < 2000; i++) { text += (i ? ',' : '') + '{"name": "name' + i + '", "desc": "\\u4e2d' + i + '"}'; }
+        var arr = JSON.parse(text + ']');
+        for (var i = 0; i < 3000; i++) { var tmp = { a: [i], b: 'y' + i }; }
+
+        var first = arr[0].name;
+        first += '!';
+        console.log(first, arr[0].name, arr[1].name, arr[1999].name, arr[1999].desc);
+
+        var kept = arr[1000].desc;
+        arr = null;
+        for (var i = 0; i < 3000; i++) { var tmp = { a: [i], b: 'z' + i }; }
+        console.log(kept, kept.length);
+    )";
+
+    ASSERT_EQ(runCode(code, 1000),
+        "name0! name0 name1 name1999 \xE4\xB8\xAD" "1999\n"
+        "\xE4\xB8\xAD" "1000 5\n");
+}
+
+TEST(JsonParser, DISABLED_benchmark) {
+    // 对比 JSON.parse 和执行同样内容的对象字面量的耗时:
+    //   TinyJS --gtest_filter=JsonParser.* --gtest_also_run_disabled_tests
+    string records = makeRecords(50000);
+
+    string strings = "[";
+    for (int i = 0; i < 20000; i++) {
+        if (i > 0) strings += ",";
+        strings += "\"" + string(100 + i % 50, 'a' + i % 26) + "\\n\"";
+    }
+    strings += "]";
+
+    // 对象字面量的编译是递归的，所以嵌套的层数不能太大
+    string nested = "[";
+    for (int i = 0; i < 2000; i++) {
+        if (i > 0) nested += ",";
+        for (int k = 0; k < 50; k++) {
+            nested += "{\"v\":" + std::to_string(k) + ",\"next\":[";
+        }
+        nested += "null";
+        for (int k = 0; k < 50; k++) {
+            nested += "]}";
+        }
+    }
+    nested += "]";
+
+    std::pair<const char *, string *> docs[] = {
+        { "records", &records },
+        { "strings", &strings },
+        { "nested", &nested },
+    };
+
+    printf("%10s %10s %12s %12s %10s\n", "document", "size(KB)", "parse(ms)", "literal(ms)", "MB/s");
+    for (auto &doc : docs) {
+        auto &json = *doc.second;
+        string escaped;
+        for (auto c : json) {
+            if (c == '\\') escaped += '\\';
+            escaped += c;
+        }
+
+        string codeString = "var s = '" + escaped + "';";
+        string codeParse = codeString + "var v = JSON.parse(s);";
+        string codeLiteral = "var v = " + json + ";";
+
+        // JSON.parse 的时间需要减去编译和创建字符串 s 的时间，对象字面量的时间包含了编译的时间
+        int64_t bestString = INT64_MAX, bestParse = INT64_MAX, bestLiteral = INT64_MAX;
+        for (int i = 0; i < 3; i++) {
+            auto start = getTickCount();
+            runCode(codeString);
+            bestString = std::min(bestString, (int64_t)(getTickCount() - start));
+
+            start = getTickCount();
+            runCode(codeParse);
+            bestParse = std::min(bestParse, (int64_t)(getTickCount() - start));
+
+            start = getTickCount();
+            runCode(codeLiteral);
+            bestLiteral = std::min(bestLiteral, (int64_t)(getTickCount() - start));
+        }
+        bestParse = std::max((int64_t)1, bestParse - bestString);
+
+        printf("%10s %10d %12d %12d %10.1f\n", doc.first, (int)json.size() / 1024, (int)bestParse, (int)bestLiteral,
+            json.size() / 1024.0 / 1024 / bestParse * 1000);
+    }
+}
+
+#endif
@@ -0,0 +1,264 @@
+﻿//
+//  JsonWriter.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/20.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "interpreter/VMRuntime.hpp"
+#include "interpreter/JsonWriter.hpp"
+#include "objects/IJsIterator.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class JsonWriterTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+class ChunksStream : public IJsonWriterStream {
+public:
+    virtual void write(const StringView &chunk) override {
+        chunks.push_back(string((const char *)chunk.data, chunk.len));
+    }
+
+    VecStrings                  chunks;
+
+};
+
+static string runCode(JsVirtualMachine &vm, const char *code) {
+    auto runtime = vm.defaultRuntime();
+    auto console = new JsonWriterTestConsole();
+    runtime->setConsole(console);
+
+    vm.run(code, strlen(code), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+static string runCode(const char *code) {
+    JsVirtualMachine vm;
+    return runCode(vm, code);
+}
+
+static const char *CODE_RECORDS = R"(
+    var data = [];
+    for (var i = 0; i < 2000; i++) {
+        data.push({ id: i, name: 'user' + i, score: i + 0.5, active: i % 2 == 0, tags: ['t' + i % 7, '中文'],
+            address: { city: 'city\n' + i, zip: null } });
+    }
+)";
+
+// 和原来的实现相同: 每个对象都创建 IJsIterator, 字符串逐个字符转义
+static void stringifyByIterator(VMContext *ctx, const JsValue &value, string &out) {
+    auto runtime = ctx->runtime;
+    switch (value.type) {
+        case JDT_NULL: out.append("null"); break;
+        case JDT_BOOL: out.append(value.value.n32 ? "true" : "false"); break;
+        case JDT_INT32: out.append(std::to_string(value.value.n32)); break;
+        case JDT_NUMBER: {
+            char buf[64];
+            out.append(buf, floatToString(runtime->getDouble(value), buf));
+            break;
+        }
+        case JDT_CHAR:
+        case JDT_STRING: {
+            auto s = runtime->toStringView(ctx, value);
+            out.push_back('"');
+            for (uint32_t i = 0; i < s.len; i++) {
+                auto c = (uint8_t)s.data[i];
+                if (c == '"' || c == '\\') {
+                    out.push_back('\\');
+                    out.push_back(c);
+                } else if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), c == '\n' ? "\\n" : "\\u%04x", c);
+                    out.append(buf);
+                } else {
+                    out.push_back(c);
+                }
+            }
+            out.push_back('"');
+            break;
+        }
+        case JDT_ARRAY: {
+            auto obj = runtime->getObject(value);
+            int32_t length;
+            obj->getLength(ctx, length);
+            out.push_back('[');
+            for (int i = 0; i < length; i++) {
+                if (i > 0) out.push_back(',');
+                stringifyByIterator(ctx, obj->getByIndex(ctx, value, i), out);
+            }
+            out.push_back(']');
+            break;
+        }
+        default: {
+            auto obj = runtime->getObject(value);
+            std::unique_ptr<IJsIterator> it(obj->getIteratorObject(ctx, false));
+            StringView key;
+            JsValue v;
+            bool isFirst = true;
+            out.push_back('{');
+            while (it->next(&key, nullptr, &v)) {
+                if (!isFirst) out.push_back(',');
+                isFirst = false;
+                out.push_back('"');
+                out.append((const char *)key.data, key.len);
+                out.append("\":");
+                stringifyByIterator(ctx, v, out);
+            }
+            out.push_back('}');
+            break;
+        }
+    }
+}
+
+TEST(JsonWriter, semantics) {
+    const char *code = R"(
+        var o = { a: 1, b: 'x"y\\z\n\u0001', c: [2.5, -0, NaN, undefined, function () {}, true], d: { e: {}, f: [] }, g: undefined };
+        console.log(JSON.stringify(o));
+        console.log(JSON.stringify({ a: [1, { b: 2 }], c: [] }, null, 2));
+        console.log(JSON.stringify({ a: 1, b: 2 }, null, '--'));
+        console.log(JSON.stringify(o, ['b', 'a', 'a', 'zz']));
+        console.log(JSON.stringify({ a: 1, b: [2, 3] }, function (k, v) { if (typeof v === 'number') { return v * 10; } return v; }));
+        console.log(JSON.stringify({ x: { toJSON: function (k) { return 'key:' + k; } }, y: [new Number(3), new String('s'), new Boolean(false)] }));
+        console.log(JSON.stringify(undefined), JSON.stringify(Math.max), JSON.stringify('\ud800\u4e2d'), JSON.stringify({ 2: 'b', 1: 'a', x: 'c' }));
+
+        var cyc = { a: 1 }; cyc.self = cyc;
+        try { JSON.stringify(cyc); } catch (e) { console.log(e.name); }
+        var shared = { v: 1 };
+        console.log(JSON.stringify([shared, { s: shared }]));
+
+        function P() { this.own = 1; } P.prototype.inherited = 2;
+        var g = { get a() { delete this.c; this.d = 4; return 'ga'; }, b: 2, c: 3 };
+        console.log(JSON.stringify(new P()), JSON.stringify(g), JSON.stringify([1, , 3]));
+
+        // toJSON 中嵌套调用 JSON.stringify
+        console.log(JSON.stringify({ n: { toJSON: function () { return JSON.stringify([1, 'a']); } } }));
+
+        var deep = {}, cur = deep;
+        for (var i = 0; i < 6000; i++) { cur.x = {}; cur = cur.x; }
+        try { JSON.stringify(deep); } catch (e) { console.log(e.name); }
+    )";
+
+    ASSERT_EQ(runCode(code),
+        "{\"a\":1,\"b\":\"x\\\"y\\\\z\\n\\u0001\",\"c\":[2.5,0,null,null,null,true],\"d\":{\"e\":{},\"f\":[]}}\n"
+        "{\n  \"a\": [\n    1,\n    {\n      \"b\": 2\n    }\n  ],\n  \"c\": []\n}\n"
+        "{\n--\"a\": 1,\n--\"b\": 2\n}\n"
+        "{\"b\":\"x\\\"y\\\\z\\n\\u0001\",\"a\":1}\n"
+        "{\"a\":10,\"b\":[20,30]}\n"
+        "{\"x\":\"key:x\",\"y\":[3,\"s\",false]}\n"
+        "undefined undefined \"\\ud800\xE4\xB8\xAD\" {\"1\":\"a\",\"2\":\"b\",\"x\":\"c\"}\n"
+        "TypeError\n"
+        "[{\"v\":1},{\"s\":{\"v\":1}}]\n"
+        "{\"own\":1} {\"a\":\"ga\",\"b\":2} [1,null,3]\n"
+        "{\"n\":\"[1,\\\"a\\\"]\"}\n"
+        "RangeError\n");
+}
+
+TEST(JsonWriter, stream) {
+    // 分段输出的内容和完整输出的相同
+    JsVirtualMachine vm;
+    runCode(vm, CODE_RECORDS);
+    runCode(vm, "data.push('x'.repeat(100000) + '\"');");
+
+    auto runtime = vm.defaultRuntime();
+    auto ctx = runtime->mainCtx();
+    auto data = vm.getMemberDot(ctx, jsValueGlobalThis, "data");
+    ASSERT_EQ(data.type, JDT_ARRAY);
+
+    string expected;
+    {
+        JsonWriter writer(ctx);
+        ASSERT_TRUE(writer.write(data));
+        auto result = writer.result();
+        expected.assign((const char *)result.data, result.len);
+    }
+
+    ChunksStream stream;
+    {
+        JsonWriter writer(ctx);
+        writer.setStream(&stream, 1024);
+        ASSERT_TRUE(writer.write(data));
+        ASSERT_EQ(writer.result().len, 0);
+    }
+
+    string joined;
+    for (auto &chunk : stream.chunks) {
+        // 长的字符串也是分段输出的
+        ASSERT_LE(chunk.size(), 1024 * 100);
+        joined.append(chunk);
+    }
+    ASSERT_GT(stream.chunks.size(), 100);
+    ASSERT_EQ(joined, expected);
+
+    auto output = runCode(vm, "console.log(JSON.stringify(data) === JSON.stringify(JSON.parse(JSON.stringify(data))));");
+    ASSERT_EQ(output, "true\n");
+}
+
+TEST(JsonWriter, DISABLED_benchmark) {
+    // 对比 JsonWriter 和原来通过 IJsIterator 遍历对象的实现:
+    //   TinyJS --gtest_filter=JsonWriter.* --gtest_also_run_disabled_tests
+    const char *codes[][2] = {
+        { "records", R"(
+            var data = [];
+            for (var i = 0; i < 50000; i++) {
+                data.push({ id: i, name: 'user' + i, score: i + 0.5, active: i % 2 == 0, tags: ['t' + i % 7, 'x'],
+                    address: { city: 'city' + i, zip: null } });
+            }
+        )" },
+        { "strings", R"(
+            var data = [], s = 'abcdefghijklmnopqrstuvwxyz中文'.repeat(10);
+            for (var i = 0; i < 20000; i++) { data.push(s + i + '\n'); }
+        )" },
+        { "numbers", R"(
+            var data = [];
+            for (var i = 0; i < 200000; i++) { data.push(i * 1.25); }
+        )" },
+    };
+
+    printf("%10s %10s %12s %12s %10s\n", "document", "size(KB)", "writer(ms)", "iterator(ms)", "MB/s");
+    for (auto &item : codes) {
+        JsVirtualMachine vm;
+        runCode(vm, item[1]);
+        auto ctx = vm.defaultRuntime()->mainCtx();
+        auto data = vm.getMemberDot(ctx, jsValueGlobalThis, "data");
+
+        uint32_t size = 0;
+        int64_t bestWriter = INT64_MAX, bestIterator = INT64_MAX;
+        for (int i = 0; i < 5; i++) {
+            auto start = getTickCount();
+            {
+                JsonWriter writer(ctx);
+                ASSERT_TRUE(writer.write(data));
+                size = writer.result().len;
+            }
+            bestWriter = std::min(bestWriter, (int64_t)(getTickCount() - start));
+
+            start = getTickCount();
+            string out;
+            stringifyByIterator(ctx, data, out);
+            bestIterator = std::min(bestIterator, (int64_t)(getTickCount() - start));
+        }
+
+        printf("%10s %10d %12d %12d %10.1f\n", item[0], size / 1024, (int)bestWriter, (int)bestIterator,
+            size / 1024.0 / 1024 / std::max((int64_t)1, bestWriter) * 1000);
+    }
+}
+
+#endif
@@ -0,0 +1,166 @@
+﻿//
+//  MultiThread.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/14.
+//
+
+#include <thread>
+#include <atomic>
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class ThreadTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runInNewVM(const char *code) {
+    JsVirtualMachine vm;
+    auto console = new ThreadTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+
+    vm.run(code, strlen(code), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+// 尽量覆盖到 common 资源、shape、内置对象和 Date 等有全局状态的地方
+static const char *SCRIPT_MIXED = R"(
+    function Point(x, y) { this.x = x; this.y = y; }
+    Point.prototype.len = function () { return Math.sqrt(this.x * this.x + this.y * this.y); };
+
+    var points = [], sum = 0;
+    for (var i = 0; i < 200; i++) {
+        var p = new Point(i, i + 1);
+        p['k' + (i % 7)] = i;
+        points.push(p);
+        sum += p.len();
+    }
+    console.log(points.length, Math.round(sum), points[10].k3);
+
+    var arr = [5, 3, [1, 2, [7]], 'a'];
+    arr.push(arr);
+    console.log(arr.toString(), [3, 1, 2].sort().join('-'));
+
+    var s = '';
+    for (var i = 0; i < 50; i++) { s += String.fromCharCode(65 + i % 26); }
+    console.log(s.length, s.indexOf('XYZ'), s.substring(3, 8).toLowerCase(), /B+C/.test(s));
+
+    var d = new Date(Date.UTC(2023, 0, 14, 8, 30, 0));
+    console.log(d.getUTCFullYear(), d.getUTCMonth(), d.getUTCDate(), d.getUTCHours());
+
+    var r = Math.random();
+    console.log(r >= 0 && r < 1);
+
+    function counter() { var n = 0; return function () { return ++n; }; }
+    var c = counter(); c(); c();
+    try { null.x; } catch (e) { console.log(e.name, c()); }
+
+    Promise.resolve(1).then(v => console.log('promise', v + 1));
+    console.log(typeof globalThis.Point, Object.keys({ a: 1, b: 2, c: 3 }).join(','));
+)";
+
+TEST(MultiThread, independentRuntimes) {
+    // 每个线程中创建独立的 JsVirtualMachine，执行结果需要和单线程的完全相同
+    auto expected = runInNewVM(SCRIPT_MIXED);
+    ASSERT_NE(expected.find("promise 2"), string::npos) << expected;
+
+    const int COUNT_THREADS = 8, COUNT_ROUNDS = 20;
+    std::atomic<int> countMismatched(0);
+    std::vector<string> firstMismatched(COUNT_THREADS);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < COUNT_THREADS; i++) {
+        threads.push_back(std::thread([&, i]() {
+            for (int k = 0; k < COUNT_ROUNDS; k++) {
+                auto output = runInNewVM(SCRIPT_MIXED);
+                if (output != expected) {
+                    if (countMismatched++ == 0) {
+                        firstMismatched[i] = output;
+                    }
+                }
+            }
+        }));
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    for (auto &output : firstMismatched) {
+        ASSERT_TRUE(output.empty()) << "Expected:\n" << expected << "Actual:\n" << output;
+    }
+    ASSERT_EQ(countMismatched.load(), 0);
+}
+
+TEST(MultiThread, DISABLED_benchmark) {
+    // 每个线程执行相同数量的脚本，吞吐量应该随着线程数量(不超过 CPU 核数)线性增加:
+    //   TinyJS --gtest_filter=MultiThread.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        var objs = [], total = 0;
+        for (var i = 0; i < 20000; i++) {
+            var o = { id: i, name: 'item' + i, tags: [i % 3, i % 5] };
+            objs.push(o);
+            total += o.tags[0] + o.tags[1] + o.name.length;
+        }
+        console.log(total);
+    )";
+    auto expected = runInNewVM(code);
+
+    const int COUNT_SCRIPTS_PER_THREAD = 20;
+    int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> countsThreads;
+    for (int n = 1; n < maxThreads; n *= 2) {
+        countsThreads.push_back(n);
+    }
+    countsThreads.push_back(maxThreads);
+    double baseThroughput = 0;
+
+    printf("%8s %10s %14s %8s\n", "threads", "time(ms)", "scripts/s", "speedup");
+    for (auto countThreads : countsThreads) {
+        std::atomic<int> countFailed(0);
+        auto start = getTickCount();
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < countThreads; i++) {
+            threads.push_back(std::thread([&]() {
+                for (int k = 0; k < COUNT_SCRIPTS_PER_THREAD; k++) {
+                    if (runInNewVM(code) != expected) {
+                        countFailed++;
+                    }
+                }
+            }));
+        }
+
+        for (auto &t : threads) {
+            t.join();
+        }
+
+        auto duration = std::max((int64_t)1, (int64_t)(getTickCount() - start));
+        double throughput = countThreads * COUNT_SCRIPTS_PER_THREAD * 1000.0 / duration;
+        if (countThreads == 1) {
+            baseThroughput = throughput;
+        }
+
+        printf("%8d %10d %14.1f %7.2fx\n", countThreads, (int)duration, throughput, throughput / baseThroughput);
+        ASSERT_EQ(countFailed.load(), 0);
+    }
+}
+
+#endif
@@ -0,0 +1,99 @@
+﻿//
+//  Profiler.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/12.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+
+
+#if UNIT_TEST && VM_PROFILER
+
+#include "utils/unittest.h"
+
+
+class ProfilerTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string toString(BinaryOutputStream &stream) {
+    return stream.toStringView().toString();
+}
+
+TEST(Profiler, flatAndFoldedStacks) {
+    const char *code = R"(
+        function leaf(n) {
+            var s = 0;
+            for (var i = 0; i < n; i++) {
+                s = s + i;
+            }
+            return s;
+        }
+        function middle(n) {
+            return leaf(n) + [1, 2].map(function (x) { return leaf(x); }).length;
+        }
+        console.log(middle(100));
+    )";
+
+    JsVirtualMachine vm;
+    auto console = new ProfilerTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+
+    vm.startProfiler();
+    vm.run(code, strlen(code), runtime);
+    vm.stopProfiler();
+    ASSERT_EQ(console->output, "4952\n");
+
+    BinaryOutputStream flat;
+    vm.dumpProfile(flat);
+    auto strFlat = toString(flat);
+    ASSERT_NE(strFlat.find("OP_RETURN_VALUE"), string::npos);
+    ASSERT_NE(strFlat.find("\nAddresses (top"), string::npos);
+    ASSERT_NE(strFlat.find("leaf:"), string::npos);
+    ASSERT_NE(strFlat.find("middle:"), string::npos);
+
+    // 通过 Array.prototype.map 回调的函数，调用者仍然为 middle
+    BinaryOutputStream folded;
+    vm.dumpProfileFoldedStacks(folded);
+    auto strFolded = toString(folded);
+    ASSERT_NE(strFolded.find("(program):"), string::npos);
+    ASSERT_NE(strFolded.find(";middle:"), string::npos);
+    ASSERT_NE(strFolded.find(";leaf:"), string::npos);
+    ASSERT_NE(strFolded.find(";(anonymous):"), string::npos);
+
+    VecStrings lines;
+    strSplit(strFolded.c_str(), '\n', lines);
+    for (auto &line : lines) {
+        if (line.empty()) {
+            continue;
+        }
+
+        // 每行的格式为: "f1;f2;f3 cycles"
+        auto pos = line.rfind(' ');
+        ASSERT_NE(pos, string::npos);
+        ASSERT_GT(atoll(line.c_str() + pos + 1), 0);
+    }
+
+    // 停止后不再统计，重新开始会清除之前的数据
+    vm.run(code, strlen(code), runtime);
+    BinaryOutputStream folded2;
+    vm.dumpProfileFoldedStacks(folded2);
+    ASSERT_EQ(toString(folded2), strFolded);
+
+    vm.startProfiler();
+    vm.stopProfiler();
+    BinaryOutputStream folded3;
+    vm.dumpProfileFoldedStacks(folded3);
+    ASSERT_EQ(toString(folded3), "");
+}
+
+#endif
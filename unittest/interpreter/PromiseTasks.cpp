@@ -0,0 +1,133 @@
+﻿//
+//  PromiseTasks.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/23.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class PromiseTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runPromiseCode(const char *code, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    auto console = new PromiseTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+    runtime->runUntilIdle();
+
+    return console->output;
+}
+
+TEST(PromiseTasks, queueOrder) {
+    // microtask 队列扩展时需要保持顺序; 执行过程中加入的 promise 在同一轮中执行
+    const char *code = R"(
+        var s = '', count = 0;
+        for (var i = 0; i < 200; i++) {
+            Promise.resolve(i).then(function (v) {
+                count++;
+                if (v % 50 == 0) { s += v + ','; }
+                if (v == 199) { Promise.resolve('nested').then(function (x) { console.log(s, count, x); }); }
+            });
+        }
+
+        var p = Promise.resolve('late');
+        setTimeout(function () { p.then(function (v) { console.log(v); }); }, 0);
+    )";
+
+    ASSERT_EQ(runPromiseCode(code), "0,50,100,150, 200 nested\nlate\n");
+}
+
+TEST(PromiseTasks, combinators) {
+    const char *code = R"(
+        function later(v, fail) {
+            return new Promise(function (resolve, reject) {
+                setTimeout(function () { if (fail) { reject(v); } else { resolve(v); } }, 0);
+            });
+        }
+
+        var items = [];
+        for (var i = 0; i < 1000; i++) { items.push(Promise.resolve(i)); }
+        items.push(later(1000), 1001);
+
+        Promise.all(items).then(function (v) {
+            var sum = 0;
+            for (var i = 0; i < v.length; i++) { sum += v[i]; }
+            console.log('all', v.length, sum);
+        });
+        Promise.all([later(1), later('e', true)]).catch(function (e) { console.log('all rejected', e); });
+        Promise.allSettled([later('x', true), 2]).then(function (r) {
+            console.log('allSettled', r[0].status, r[0].reason, r[1].status, r[1].value);
+        });
+        Promise.any([later('a', true), Promise.reject('b')]).catch(function (e) {
+            console.log('any', e.name, e.errors[0], e.errors[1]);
+        });
+        Promise.race([later('slow'), Promise.resolve('fast')]).then(function (v) { console.log('race', v); });
+    )";
+
+    auto expected = "race fast\n"
+        "all 1002 501501\n"
+        "all rejected e\n"
+        "allSettled rejected x fulfilled 2\n"
+        "any AggregateError a b\n";
+    auto output = runPromiseCode(code);
+    ASSERT_EQ(output, expected);
+
+    // 频繁 GC 时，合并的结果和参与的 promise 不能被回收
+    ASSERT_EQ(runPromiseCode(code, 64), output);
+}
+
+TEST(PromiseTasks, DISABLED_benchmark) {
+    // settle 1M 个 promise:
+    //   TinyJS --gtest_filter=PromiseTasks.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        var N = 1000000;
+        var t = new Date().getTime(), count = 0;
+        for (var i = 0; i < N; i++) {
+            Promise.resolve(i).then(function (v) { count++; });
+        }
+        Promise.resolve().then(function () {
+            console.log('then x 1M', new Date().getTime() - t, count);
+
+            t = new Date().getTime();
+            var items = [];
+            for (var i = 0; i < N; i++) { items.push(Promise.resolve(i)); }
+            return Promise.all(items);
+        }).then(function (v) {
+            console.log('Promise.all 1M', new Date().getTime() - t, v.length);
+
+            t = new Date().getTime();
+            var items = [];
+            for (var i = 0; i < N; i++) { items.push(Promise.reject(i)); }
+            return Promise.allSettled(items);
+        }).then(function (v) {
+            console.log('Promise.allSettled 1M', new Date().getTime() - t, v.length);
+        });
+    )";
+
+    auto output = runPromiseCode(code);
+    printf("%s", output.c_str());
+}
+
+#endif
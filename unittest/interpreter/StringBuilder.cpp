@@ -0,0 +1,107 @@
+﻿//
+//  StringBuilder.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/16.
+//
+
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class StringTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runCode(const char *code, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    auto console = new StringTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+TEST(StringBuilder, appendAndPrepend) {
+    // s += x 追加到 JsStringBuffer 中，x + s 合并 JoinedString 头部的短字符串，GC 频繁执行时结果也需要相同
+    const char *code = R"(
+        var s = '';
+        for (var i = 0; i < 3000; i++) { s += 'item' + i + ','; }
+        var a = s, b = s + 'B', c = s + 'C';
+        console.log(s.length, s.slice(-12), b.slice(-6), c.slice(-6), a === s);
+        var p = '';
+        for (var i = 0; i < 3000; i++) { p = i + ';' + p; }
+        console.log(p.length, p.substring(0, 15), p.slice(-6));
+        var u = '';
+        for (var i = 0; i < 1000; i++) { u += '中文' + i; }
+        console.log(u.length, u.charAt(1), u.indexOf('中文999'), u.slice(-5));
+        var d = u; d += d; d += 'end';
+        console.log(d.length, d.slice(-6));
+        var m = '';
+        for (var i = 0; i < 2000; i++) { m += String.fromCharCode(97 + i % 26); if (i % 400 == 0) { m = '<' + m + '>'; } }
+        console.log(m.length, m.substring(0, 8), m.slice(-4));
+        var parts = [];
+        for (var i = 0; i < 5; i++) { var t = 'x'.repeat(100 * i); parts.push(t + i + t); }
+        console.log(parts[0].length, parts[1].length, parts[4].length, parts[4].charAt(400));
+    )";
+    const char *expected = "25890 98,item2999, 2999,B 2999,C true\n"
+        "13890 2999;2998;2997; 2;1;0;\n"
+        "4890 文 4885 中文999\n"
+        "9783 999end\n"
+        "2010 <<<<<a>b uvwx\n"
+        "1 201 801 4\n";
+
+    ASSERT_EQ(runCode(code), expected);
+    ASSERT_EQ(runCode(code, 500), expected);
+}
+
+TEST(StringBuilder, DISABLED_benchmark) {
+    // 使用 += 拼接 50 MB 的字符串:
+    //   TinyJS --gtest_filter=StringBuilder.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        var s = '', line = 'The quick brown fox jumps over the lazy dog, ';
+        while (s.length < 50 * 1024 * 1024) {
+            s += line;
+            s += s.length;
+            s += '\n';
+        }
+        console.log(s.length >= 50 * 1024 * 1024, s.charAt(0), s.indexOf('dog'));
+    )";
+
+    auto start = getTickCount();
+    ASSERT_EQ(runCode(code), "true T 40\n");
+    printf("  append 50 MB string: %6d ms\n", (int)(getTickCount() - start));
+
+    const char *codePrepend = R"(
+        var s = '';
+        for (var i = 0; i < 200000; i++) {
+            s = i + ',' + s;
+        }
+        console.log(s.length, s.substring(0, 7));
+    )";
+
+    start = getTickCount();
+    ASSERT_EQ(runCode(codePrepend), "1288890 199999,\n");
+    printf("  prepend 200000 times: %6d ms\n", (int)(getTickCount() - start));
+}
+
+#endif
@@ -0,0 +1,127 @@
+﻿//
+//  TimerTasks.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/24.
+//
+
+#include <thread>
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class TimerTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runTimerCode(const char *code, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    auto console = new TimerTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+    runtime->runUntilIdle();
+
+    return console->output;
+}
+
+TEST(TimerTasks, order) {
+    // 相同时间的 timer 按注册顺序执行; 每个 timer 之后执行 microtask; 在回调中删除其他 timer 和自己
+    const char *code = R"(
+        var s = '';
+        setTimeout(function () { s += 'c'; }, 20);
+        setTimeout(function () { s += 'a1'; Promise.resolve().then(function () { s += 'p'; }); }, 0);
+        setTimeout(function () { s += 'a2'; clearTimeout(t3); }, 0);
+        var t3 = setTimeout(function () { s += 'x'; }, 0);
+        setTimeout(function () { s += 'b'; setTimeout(function () { s += 'b2'; }, 0); }, 10);
+
+        var n = 0, t = setInterval(function () {
+            n++;
+            if (n == 3) { clearInterval(t); }
+        }, 1);
+
+        var ids = [];
+        for (var i = 0; i < 1000; i++) { ids.push(setTimeout(function () { s += 'y'; }, 5 + i % 10)); }
+        for (var i = 0; i < 1000; i++) { clearTimeout(ids[i]); }
+
+        setTimeout(function () { console.log(s, n); }, 30);
+    )";
+
+    ASSERT_EQ(runTimerCode(code), "a1pa2bb2c 3\n");
+    ASSERT_EQ(runTimerCode(code, 64), "a1pa2bb2c 3\n");
+}
+
+TEST(TimerTasks, runOnce) {
+    JsVirtualMachine vm;
+    auto console = new TimerTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+
+    const char *code = "setTimeout(function () { console.log('t1'); }, 50);";
+    vm.run(code, strlen(code), runtime);
+
+    // 等待不超过 timeout
+    auto start = getTickCount();
+    ASSERT_TRUE(runtime->runOnce(10));
+    ASSERT_TRUE(console->output.empty());
+    ASSERT_LT(getTickCount() - start, 45);
+
+    // 等到下一个 timer 到期
+    runtime->runUntilIdle();
+    ASSERT_EQ(console->output, "t1\n");
+    ASSERT_GE(getTickCount() - start, 50);
+
+    // 其他线程唤醒
+    code = "setTimeout(function () { console.log('t2'); }, 10000);";
+    vm.run(code, strlen(code), runtime);
+    start = getTickCount();
+    std::thread thread([runtime]() {
+        Sleep(20);
+        runtime->wakeUp();
+    });
+    ASSERT_TRUE(runtime->runOnce());
+    thread.join();
+    ASSERT_LT(getTickCount() - start, 5000);
+    ASSERT_EQ(console->output, "t1\n");
+}
+
+TEST(TimerTasks, DISABLED_benchmark) {
+    // 注册和删除大量的 timer:
+    //   TinyJS --gtest_filter=TimerTasks.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        var N = 100000;
+        var t = new Date().getTime(), ids = [], count = 0;
+        for (var i = 0; i < N; i++) {
+            ids.push(setTimeout(function () { count++; }, (i * 7919) % 50));
+        }
+        console.log('setTimeout x 100K', new Date().getTime() - t);
+
+        t = new Date().getTime();
+        for (var i = 0; i < N; i += 2) { clearTimeout(ids[i]); }
+        console.log('clearTimeout x 50K', new Date().getTime() - t);
+
+        t = new Date().getTime();
+        setTimeout(function () { console.log('run', new Date().getTime() - t, count); }, 60);
+    )";
+
+    auto output = runTimerCode(code);
+    printf("%s", output.c_str());
+}
+
+#endif
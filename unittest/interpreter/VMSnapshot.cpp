@@ -0,0 +1,275 @@
+//
+//  VMSnapshot.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/25.
+//
+
+#include <thread>
+#include "interpreter/VirtualMachine.hpp"
+#include "interpreter/VMSnapshot.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class SnapshotTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runSnapshotCode(JsVirtualMachine &vm, const char *code, uint32_t gcThreshold = 0) {
+    auto console = new SnapshotTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+static VMSnapshot *createSnapshot(const char *bootstrap, string &error) {
+    JsVirtualMachine vm;
+    runSnapshotCode(vm, bootstrap);
+    return VMSnapshot::create(vm.defaultRuntime(), error);
+}
+
+// 初始化代码: 函数和闭包、原型上的方法、修改过的内置对象，以及各种类型的全局变量
+static const char *BOOTSTRAP = R"(
+    function Point(x, y) { this.x = x; this.y = y; }
+    Point.prototype.len2 = function () { return this.x * this.x + this.y * this.y; };
+    Array.prototype.sum = function () { var s = 0; for (var i = 0; i < this.length; i++) { s += this[i]; } return s; };
+    String.prototype.twice = function () { return this + this; };
+
+    function makeCounter(start) { var n = start; return { inc: function () { return ++n; }, get: () => n }; }
+    var counter = makeCounter(100);
+    counter.inc();
+
+    var config = { name: 'app' + 'Name', list: [1, 2, 3], nested: { deep: [{ v: 'x' }] } };
+    Object.freeze(config.nested);
+    var big = '';
+    for (var i = 0; i < 300; i++) { big += String.fromCharCode(97 + i % 26); }
+    var table = new Map([['a', 1], ['b', { c: 2 }]]);
+    var seen = new Set(['x', 'y']);
+    var re = /(\d+)-(\d+)/g;
+    re.exec('1-2 3-4');
+    var when = new Date(1674604800000);
+    var pi = 3.14159, half = 0.5;
+    var sym = Symbol('tag');
+    config[sym] = 'symbol value';
+    var acc = { _v: 1, get v() { return this._v * 10; }, set v(x) { this._v = x; } };
+    var bound = function (a) { return this.k + a; }.bind({ k: 7 });
+
+    function classify(v) {
+        switch (v) { case 'a': return 1; case 2.5: return 2; default: return 0; }
+    }
+
+    // 被回收的值在快照中是空闲的位置
+    for (var i = 0; i < 1000; i++) { var tmp = { i: i, s: 'tmp' + i }; }
+)";
+
+static const char *CHECK = R"(
+    console.log(new Point(3, 4).len2(), [1, 2, 3].sum(), 'ab'.twice());
+    console.log(counter.inc(), counter.get(), makeCounter(5).inc());
+    console.log(config.name, config.list.sum(), config.nested.deep[0].v, Object.isFrozen(config.nested), config[sym]);
+    console.log(big.length, big.substring(26, 30), big.indexOf('xyz'));
+    console.log(table.get('a'), table.get('b').c, table.size, seen.has('y'), seen.has('z'));
+    console.log(re.lastIndex, re.exec('1-2 3-4')[2], when.getTime(), pi + half);
+    console.log(acc.v, (acc.v = 5, acc.v), bound(1), classify('a'), classify(2.5), classify(1));
+)";
+
+static const char *CHECK_EXPECTED = "25 6 abab\n"
+    "102 102 6\n"
+    "appName 6 x true symbol value\n"
+    "300 abcd 23\n"
+    "1 2 2 true false\n"
+    "3 4 1674604800000 3.64159\n"
+    "10 50 8 1 2 0\n";
+
+TEST(VMSnapshot, sameAsBootstrap) {
+    string expected;
+    {
+        JsVirtualMachine vm;
+        runSnapshotCode(vm, BOOTSTRAP);
+        expected = runSnapshotCode(vm, CHECK);
+    }
+    ASSERT_EQ(expected, CHECK_EXPECTED);
+
+    string error;
+    auto snapshot = createSnapshot(BOOTSTRAP, error);
+    ASSERT_TRUE(snapshot != nullptr) << error;
+
+    for (int i = 0; i < 3; i++) {
+        JsVirtualMachine vm(snapshot);
+        ASSERT_EQ(runSnapshotCode(vm, CHECK), expected);
+    }
+
+    {
+        // 频繁 GC 时，复制的值、scope 和代码不能被错误地回收
+        JsVirtualMachine vm(snapshot);
+        string code = string(CHECK) + R"(
+            var objs = [];
+            for (var i = 0; i < 3000; i++) { objs.push({ p: new Point(i, 1), s: 'v' + i }); }
+            console.log(objs[2999].p.len2(), counter.get(), table.get('b').c);
+        )";
+        ASSERT_EQ(runSnapshotCode(vm, code.c_str(), 64), expected + "8994002 102 2\n");
+    }
+
+    delete snapshot;
+}
+
+TEST(VMSnapshot, isolation) {
+    string error;
+    auto snapshot = createSnapshot(BOOTSTRAP, error);
+    ASSERT_TRUE(snapshot != nullptr) << error;
+
+    // 在一个 VM 中修改全局变量、对象、内置对象和 Map, 不能影响到其他 VM
+    const char *mutate = R"(
+        counter.inc(); counter.inc();
+        config.name = 'changed'; config.list.push(100); config.added = true;
+        Array.prototype.sum = function () { return -1; };
+        Point.prototype.len2 = null;
+        table.set('a', 'changed'); seen.clear();
+        re.lastIndex = 0; pi = 0; big += '!';
+        var newGlobal = 1;
+        console.log(counter.get(), config.list.sum(), table.get('a'), seen.size);
+    )";
+    const char *check = R"(
+        console.log(counter.get(), config.name, config.list.length, config.added, [1, 2].sum());
+        console.log(typeof Point.prototype.len2, table.get('a'), seen.size, re.lastIndex, pi, big.length, globalThis.newGlobal);
+    )";
+    const char *expected = "101 appName 3 undefined 3\nfunction 1 2 3 3.14159 300 undefined\n";
+
+    JsVirtualMachine vm1(snapshot), vm2(snapshot);
+    ASSERT_EQ(runSnapshotCode(vm1, mutate), "103 -1 changed 0\n");
+    ASSERT_EQ(runSnapshotCode(vm2, check), expected);
+
+    JsVirtualMachine vm3(snapshot);
+    ASSERT_EQ(runSnapshotCode(vm3, check), expected);
+
+    delete snapshot;
+}
+
+TEST(VMSnapshot, threads) {
+    string error;
+    auto snapshot = createSnapshot(BOOTSTRAP, error);
+    ASSERT_TRUE(snapshot != nullptr) << error;
+
+    // 快照在创建后不会被修改，可以在多个线程中同时使用
+    const int COUNT = 4;
+    string outputs[COUNT];
+    std::vector<std::thread> threads;
+    for (int i = 0; i < COUNT; i++) {
+        threads.push_back(std::thread([snapshot, &outputs, i]() {
+            for (int k = 0; k < 5; k++) {
+                JsVirtualMachine vm(snapshot);
+                outputs[i] = runSnapshotCode(vm, CHECK);
+            }
+        }));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    for (auto &output : outputs) {
+        ASSERT_EQ(output, CHECK_EXPECTED);
+    }
+
+    delete snapshot;
+}
+
+TEST(VMSnapshot, outlivesCreator) {
+    // 快照的 shape 树和创建它的 runtime 及线程无关: 线程退出后仍然可以使用，并且可以给其中的对象添加属性
+    const char *code = R"(
+        config.added = 1; config.more = { v: config.name };
+        var p = new Point(1, 2); p.z = 3;
+        console.log(config.added, config.more.v, p.len2() + p.z);
+    )";
+
+    VMSnapshot *snapshot = nullptr;
+    string error, creatorOutput;
+    std::thread t([&snapshot, &error, &creatorOutput, code]() {
+        JsVirtualMachine vm;
+        runSnapshotCode(vm, BOOTSTRAP);
+        snapshot = VMSnapshot::create(vm.defaultRuntime(), error);
+
+        // 创建快照后，原来的 runtime 在新的树中继续添加属性
+        creatorOutput = runSnapshotCode(vm, code);
+    });
+    t.join();
+    ASSERT_TRUE(snapshot != nullptr) << error;
+    ASSERT_EQ(creatorOutput, "1 appName 8\n");
+
+    JsVirtualMachine vm(snapshot);
+    ASSERT_EQ(runSnapshotCode(vm, (string(CHECK) + code).c_str()), string(CHECK_EXPECTED) + "1 appName 8\n");
+
+    delete snapshot;
+}
+
+TEST(VMSnapshot, failure) {
+    string error;
+    ASSERT_TRUE(createSnapshot("function* g() { yield 1; } var it = g();", error) == nullptr);
+    ASSERT_NE(error.find("JDT_GENERATOR"), string::npos) << error;
+
+    ASSERT_TRUE(createSnapshot("var p = new Promise(function () {});", error) == nullptr);
+    ASSERT_NE(error.find("JDT_PROMISE"), string::npos);
+
+    {
+        JsVirtualMachine vm;
+        const char *code = "setTimeout(function () {}, 100000);";
+        vm.run(code, strlen(code));
+        ASSERT_TRUE(VMSnapshot::create(vm.defaultRuntime(), error) == nullptr);
+    }
+
+    // 不可达的 generator 会在创建快照前被回收
+    auto snapshot = createSnapshot("function* g() { yield 1; } g(); var x = 2;", error);
+    ASSERT_TRUE(snapshot != nullptr) << error;
+    JsVirtualMachine vm(snapshot);
+    ASSERT_EQ(runSnapshotCode(vm, "console.log(x, g().next().value);"), "2 1\n");
+    delete snapshot;
+}
+
+TEST(VMSnapshot, DISABLED_benchmark) {
+    // 执行初始化代码和从快照创建 VM 的对比:
+    //   TinyJS --gtest_filter=VMSnapshot.* --gtest_also_run_disabled_tests
+    string bootstrap;
+    for (int i = 0; i < 200; i++) {
+        bootstrap += stringPrintf("function f%d(a, b) { var r = []; for (var i = 0; i < a; i++) { r.push({ i: i, s: 'x' + b }); } return r; }\n", i);
+        bootstrap += stringPrintf("var data%d = f%d(20, %d);\n", i, i, i);
+    }
+    bootstrap += BOOTSTRAP;
+
+    const int N = 200;
+    auto t = getTickCount();
+    for (int i = 0; i < N; i++) {
+        JsVirtualMachine vm;
+        runSnapshotCode(vm, bootstrap.c_str());
+    }
+    printf("run bootstrap x %d: %d ms\n", N, (int)(getTickCount() - t));
+
+    string error;
+    auto snapshot = createSnapshot(bootstrap.c_str(), error);
+    t = getTickCount();
+    for (int i = 0; i < N; i++) {
+        JsVirtualMachine vm(snapshot);
+    }
+    printf("from snapshot x %d: %d ms, objects: %d\n", N, (int)(getTickCount() - t), snapshot->countObjects());
+
+    delete snapshot;
+}
+
+#endif
@@ -6,6 +6,8 @@
 //
 
 #include "objects/JsArray.hpp"
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
 
 
 #if UNIT_TEST
@@ -31,7 +33,9 @@ TEST(JsArray, findToModifyBlock) {
 
     JsArrayTestable a;
 
-    ASSERT_EQ(a.countBlocks(), 1);
+    // 新建的数组是 packed 的，出现空洞后才使用 block 存储
+    ASSERT_EQ(a.elementsKind(), AEK_PACKED_INT32);
+    ASSERT_EQ(a.countBlocks(), 0);
 
     uint32_t length;;
     VMContext *ctx = nullptr;
@@ -43,6 +47,7 @@ TEST(JsArray, findToModifyBlock) {
     for (int i = 10; i < 20; i++) {
         value = makeJsValueInt32(i);
         a.setByIndex(ctx, thiz, i, value);
+        ASSERT_EQ(a.elementsKind(), AEK_HOLEY);
         ASSERT_EQ(a.countBlocks(), 1);
         ASSERT_EQ(a.length(), i + 1);
         ASSERT_EQ(a.lengthInBlocks(), i + 1);
@@ -172,4 +177,270 @@ TEST(JsArray, findToModifyBlock) {
     }
 }
 
+TEST(JsArray, packedElementsKind) {
+    JsArrayTestable a;
+    VMContext *ctx = nullptr;
+    JsValue thiz, value;
+
+    for (int i = 0; i < 100; i++) {
+        a.push(ctx, makeJsValueInt32(i));
+    }
+    ASSERT_EQ(a.elementsKind(), AEK_PACKED_INT32);
+    ASSERT_EQ(a.length(), 100);
+    ASSERT_EQ(a.countBlocks(), 0);
+
+    // 内联的 double
+    value = makeJsValueInlineDouble(1.5);
+    a.setByIndex(ctx, thiz, 50, value);
+    ASSERT_EQ(a.elementsKind(), AEK_PACKED_DOUBLE);
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 50), value);
+
+    // 写回 int32 不会转换回去
+    ASSERT_TRUE(a.setPackedByIndex(50, makeJsValueInt32(50)));
+    ASSERT_EQ(a.elementsKind(), AEK_PACKED_DOUBLE);
+
+    // 快速路径不能处理的类型转换
+    ASSERT_FALSE(a.setPackedByIndex(10, jsValueTrue));
+    a.setByIndex(ctx, thiz, 10, jsValueTrue);
+    ASSERT_EQ(a.elementsKind(), AEK_PACKED_GENERIC);
+
+    // 快速路径可以在末尾添加，但是不能产生空洞
+    ASSERT_TRUE(a.setPackedByIndex(100, jsValueNull));
+    ASSERT_EQ(a.length(), 101);
+    ASSERT_FALSE(a.setPackedByIndex(102, jsValueNull));
+    ASSERT_FALSE(a.getPackedByIndex(101, value));
+    ASSERT_TRUE(a.getPackedByIndex(99, value));
+    ASSERT_EQ(value, makeJsValueInt32(99));
+
+    // 出现空洞后转换为 block 存储，元素保持不变
+    a.setByIndex(ctx, thiz, 200, makeJsValueInt32(200));
+    ASSERT_EQ(a.elementsKind(), AEK_HOLEY);
+    ASSERT_EQ(a.countBlocks(), 1);
+    ASSERT_EQ(a.length(), 201);
+    ASSERT_FALSE(a.getPackedByIndex(0, value));
+    ASSERT_FALSE(a.setPackedByIndex(0, value));
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 0), makeJsValueInt32(0));
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 10), jsValueTrue);
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 99), makeJsValueInt32(99));
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 100), jsValueNull);
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 150), jsValueUndefined);
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 200), makeJsValueInt32(200));
+
+    // 清空后重新使用 packed 存储
+    a.setLength(0);
+    ASSERT_EQ(a.elementsKind(), AEK_PACKED_INT32);
+    ASSERT_EQ(a.countBlocks(), 0);
+    a.push(ctx, makeJsValueInt32(1));
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 0), makeJsValueInt32(1));
+
+    // 超过 block 大小的 packed 数组转换后分为多个 block
+    JsArrayTestable b;
+    for (uint32_t i = 0; i < ARRAY_BLOCK_SIZE * 2 + 10; i++) {
+        b.push(ctx, makeJsValueInt32(i));
+    }
+    ASSERT_EQ(b.elementsKind(), AEK_PACKED_INT32);
+    ASSERT_TRUE(b.removeByIndex(ctx, 5));
+    ASSERT_EQ(b.elementsKind(), AEK_HOLEY);
+    ASSERT_EQ(b.countBlocks(), 3);
+    ASSERT_EQ(b.lengthInBlocks(), ARRAY_BLOCK_SIZE * 2 + 10);
+    ASSERT_EQ(b.getByIndex(ctx, thiz, 5), jsValueUndefined);
+    ASSERT_EQ(b.getByIndex(ctx, thiz, ARRAY_BLOCK_SIZE + 1), makeJsValueInt32(ARRAY_BLOCK_SIZE + 1));
+    ASSERT_EQ(b.getByIndex(ctx, thiz, ARRAY_BLOCK_SIZE * 2 + 9), makeJsValueInt32(ARRAY_BLOCK_SIZE * 2 + 9));
+}
+
+TEST(JsArray, pushAcrossBlocks) {
+    // 在 block 存储的数组中批量添加，跨越多个 block
+    JsArrayTestable a;
+    VMContext *ctx = nullptr;
+    JsValue thiz;
+
+    a.pushEmpty();
+    ASSERT_EQ(a.elementsKind(), AEK_HOLEY);
+
+    VecJsValues values;
+    for (uint32_t i = 1; i < ARRAY_BLOCK_SIZE * 3; i++) {
+        values.push_back(makeJsValueInt32(i));
+    }
+    a.push(ctx, values.data(), (uint32_t)values.size());
+
+    ASSERT_EQ(a.length(), ARRAY_BLOCK_SIZE * 3);
+    ASSERT_EQ(a.countBlocks(), 3);
+    ASSERT_EQ(a.lengthInBlocks(), ARRAY_BLOCK_SIZE * 3);
+    ASSERT_EQ(a.getByIndex(ctx, thiz, 0), jsValueUndefined);
+    for (uint32_t i = 1; i < ARRAY_BLOCK_SIZE * 3; i++) {
+        ASSERT_EQ(a.getByIndex(ctx, thiz, i), makeJsValueInt32(i));
+    }
+}
+
+class ArrayTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runArrayCode(const char *code, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    auto console = new ArrayTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+
+    return console->output;
+}
+
+TEST(JsArray, packedTransitionsInVM) {
+    // 虚拟机的快速路径和通用流程混合使用时，结果需要一致
+    const char *code = R"(
+        var a = [];
+        for (var i = 0; i < 10; i++) { a[i] = i; }
+        a[3] = 1.5;
+        a[4] = 'x';
+        a.push(null);
+        console.log(a.length, a[3], a[4], a[10], a[11], a.toString());
+        a[2]++;
+        a[13] = 13;
+        console.log(a.length, a[2], a[12], a[13]);
+        a.length = 0;
+        a[0] = 7;
+        console.log(a.length, a[0], a[-1]);
+
+        var b = [1, 2, 3];
+        Object.freeze(b);
+        b[0] = 10; b[3] = 4;
+        console.log(b.length, b[0], b[3]);
+
+        var c = [3, 1, 2];
+        c.sort();
+        c.reverse();
+        console.log(c.toString(), c.concat([4, 5], [[6]]).length, [1, [2, [3, [4]]], [5]].flat(2).length);
+    )";
+    ASSERT_EQ(runArrayCode(code),
+        "11 1.5 x null undefined 0,1,2,1.5,x,5,6,7,8,9,null\n"
+        "14 3 undefined 13\n"
+        "1 7 undefined\n"
+        "3 1 undefined\n"
+        "3,2,1 6 5\n");
+}
+
+TEST(JsArray, sortComparators) {
+    // 覆盖 sortJsValues 的各个分支: 字符串 key、数值比较函数、通用比较函数 (复用和不复用 scope)
+    const char *code = R"(
+        function str(a) { var s = ''; for (var i = 0; i < a.length; i++) { s += (i ? ',' : '') + a[i]; } return s; }
+
+        console.log(str([3, 1, 2, 10, 5].sort()), str([true, 'b', null, 12, { toString: function () { return 'a'; } }].sort()));
+        console.log(str([3, 1, 2, 10, 5].sort(function (a, b) { return a - b; })), str([3, 1.5, -2, 10].sort((x, y) => y - x)));
+        // 按照 utf-16 编码单元排序: 代理对 (0xD83D) 在 U+FF61 之前, 但在 U+00E9 之后.
+        // 字面量的 emoji 保存为 4 字节的 utf-8, 转义的代理对保存为两个 3 字节的字符
+        var u = ['\uFF61', '😀', 'b', '\u00E9', '\uFF61a', '', '\uD83D\uDE01'].sort(), codes = [];
+        for (var i = 0; i < u.length; i++) { codes.push(u[i].length ? u[i].charCodeAt(0).toString(16) + ':' + u[i].length : '-'); }
+        console.log(str(codes));
+        console.log(str([3, NaN, 1, 2].sort(function (a, b) { return a - b; })), str([3, '1', 2].sort(function (a, b) { return a - b; })));
+        console.log(str([3, 1, 2].sort(function (a, b) { return a > b; })), str([3, 1, 2].sort(function (a, b) { return b > a; })));
+
+        var k = 0;
+        console.log(str([3, 1, 2].sort(function (a, b) { k++; return arguments[0] - arguments[1]; })), k > 0);
+        console.log(str([3, 1, 2].sort(function (a, b) { var f = function () { return a - b; }; return f(); })));
+
+        var recs = [];
+        for (var i = 0; i < 2000; i++) { recs.push({ k: (i * 7) % 13, i: i }); }
+        recs.sort(function (a, b) { var d = a.k - b.k; return d; });
+        var stable = true;
+        for (var i = 1; i < recs.length; i++) {
+            var p = recs[i - 1], c = recs[i];
+            if (p.k > c.k || (p.k === c.k && p.i > c.i)) { stable = false; }
+        }
+        console.log('stable', stable);
+
+        var sorted = [], count = 0;
+        for (var i = 0; i < 1000; i++) { sorted.push(i); }
+        sorted.sort(function (a, b) { count++; return a - b + 0; });
+        var countSorted = count;
+        count = 0;
+        sorted.reverse().sort(function (a, b) { count++; return a - b + 0; });
+        console.log(countSorted, count, sorted[0], sorted[999]);
+
+        try {
+            [3, 2, 1].sort(function (a, b) { throw new Error('cmp'); });
+        } catch (e) {
+            console.log(e.message);
+        }
+    )";
+    auto expected = "1,10,2,3,5 12,a,b,null,true\n"
+        "1,2,3,5,10 10,3,1.5,-2\n"
+        "-,62:1,e9:1,d83d:2,d83d:2,ff61:1,ff61:2\n"
+        "3,NaN,1,2 1,2,3\n"
+        "3,1,2 3,1,2\n"
+        "1,2,3 true\n"
+        "1,2,3\n"
+        "stable true\n"
+        "999 999 0 999\n"
+        "cmp\n";
+    ASSERT_EQ(runArrayCode(code), expected);
+
+    // 比较函数中频繁 GC，复用的 scope 需要在 GC 后重新分配
+    ASSERT_EQ(runArrayCode(code, 64), expected);
+}
+
+TEST(JsArray, DISABLED_benchmark) {
+    // 稠密数值数组的读写:
+    //   TinyJS --gtest_filter=JsArray.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        var ints = [], doubles = [];
+        for (var i = 0; i < 300000; i++) { ints.push(i); doubles[i] = i * 0.5; }
+        var sum = 0;
+        for (var k = 0; k < 10; k++) {
+            for (var i = 0; i < ints.length; i++) { sum += ints[i] + doubles[i]; ints[i] = ints[i] + 1; }
+        }
+        console.log(sum);
+    )";
+
+    auto start = getTickCount();
+    auto output = runArrayCode(code);
+    printf("  dense numeric arrays: %6d ms, %s", (int)(getTickCount() - start), output.c_str());
+}
+
+TEST(JsArray, DISABLED_sortBenchmark) {
+    // 1M 个元素的排序:
+    //   TinyJS --gtest_filter=JsArray.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        var ints = [], strs = [], s = 1;
+        for (var i = 0; i < 1000000; i++) {
+            s = (s * 16807) % 2147483647;
+            ints.push(s);
+            strs.push('k' + (s % 100000));
+        }
+
+        function run(name, arr, cmp) {
+            var t = new Date().getTime();
+            arr.sort(cmp);
+            console.log(name, new Date().getTime() - t);
+        }
+
+        run('default ints', ints.slice());
+        run('default strings', strs.slice());
+        run('(a, b) => a - b', ints.slice(), (a, b) => a - b);
+        run('(a, b) => b - a', ints.slice(), (a, b) => b - a);
+        var general = function (a, b) { if (a < b) return -1; if (a > b) return 1; return 0; };
+        run('general', ints.slice(), general);
+        var sorted = ints.slice().sort((a, b) => a - b);
+        run('general, sorted', sorted, general);
+        run('general, reversed', sorted.reverse(), general);
+        var runs = [];
+        for (var i = 0; i < 10; i++) { runs = runs.concat(sorted.slice(i * 100000, (i + 1) * 100000).reverse()); }
+        run('general, 10 runs', runs, general);
+    )";
+
+    auto output = runArrayCode(code);
+    printf("%s", output.c_str());
+}
+
 #endif
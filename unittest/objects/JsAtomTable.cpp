@@ -0,0 +1,178 @@
+﻿//
+//  JsAtomTable.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/17.
+//
+
+#include "objects/JsObject.hpp"
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+TEST(JsAtomTable, intern) {
+    JsAtomTable atoms;
+    auto count = atoms.count();
+
+    string name1 = "atomTestName", name2 = "atomTestName";
+    auto atom = atoms.intern(StringView(name1));
+    ASSERT_NE(atom, JS_ATOM_NONE);
+    ASSERT_EQ(atoms.find(StringView(name2)), atom);
+    ASSERT_EQ(atoms.intern(StringView(name2)), atom);
+    ASSERT_EQ(atoms.count(), count + 1);
+    ASSERT_EQ(atoms.find(StringView("atomTestNameNotExist")), JS_ATOM_NONE);
+
+    // 名字由 atom 表管理，和原字符串无关
+    auto &name = atoms.name(atom);
+    ASSERT_TRUE(name.isStable());
+    ASSERT_NE(name.data, name1.data());
+    name1 = "changed";
+    ASSERT_TRUE(name.equal("atomTestName"));
+
+    // 在 parent 的基础上继续编号，parent 中已有的名字使用 parent 的 atom
+    atoms.freeze();
+    JsAtomTable child(&atoms);
+    ASSERT_EQ(child.find(StringView("atomTestName")), atom);
+    ASSERT_EQ(child.intern(StringView("atomTestName")), atom);
+    auto childAtom = child.intern(StringView("atomChildName"));
+    ASSERT_EQ(childAtom, atoms.count() + 1);
+    ASSERT_EQ(child.count(), atoms.count() + 1);
+    ASSERT_TRUE(child.name(childAtom).equal("atomChildName"));
+    ASSERT_EQ(child.name(atom).data, name.data);
+    ASSERT_EQ(atoms.find(StringView("atomChildName")), JS_ATOM_NONE);
+}
+
+TEST(JsAtomTable, shapeFindByAtom) {
+    JsAtomTable common;
+    common.freeze();
+    JsShapeTree tree(&common);
+    auto atoms = tree.atoms();
+    auto shape = tree.root();
+    ASSERT_FALSE(shape->hasNumericNames());
+
+    // 超过 MIN_COUNT_FOR_TABLE 后使用 hash 表查找
+    VecJsAtoms added;
+    for (int i = 0; i < JsShape::MIN_COUNT_FOR_TABLE * 2; i++) {
+        auto name = "shapeProp" + std::to_string(i);
+        shape = shape->addProperty(StringView(name));
+        added.push_back(atoms->find(StringView(name)));
+        ASSERT_NE(added.back(), JS_ATOM_NONE);
+        ASSERT_EQ(shape->lastName().data, atoms->name(added.back()).data);
+
+        for (int k = 0; k <= i; k++) {
+            ASSERT_EQ(shape->find(added[k]), k);
+        }
+    }
+    ASSERT_FALSE(shape->hasNumericNames());
+    ASSERT_EQ(shape->find(atoms->intern(StringView("shapePropNone"))), -1);
+    ASSERT_EQ(shape->find(StringView("shapePropNotAtom")), -1);
+    ASSERT_EQ(shape->find(StringView("shapeProp3")), 3);
+
+    // 相同的 atom 走到相同的 transition
+    ASSERT_EQ(tree.root()->addProperty(added[0]), tree.root()->addProperty(StringView("shapeProp0")));
+
+    auto numeric = shape->addProperty(StringView("12"));
+    ASSERT_TRUE(numeric->hasNumericNames());
+    ASSERT_TRUE(numeric->addProperty(StringView("x"))->hasNumericNames());
+    ASSERT_FALSE(shape->hasNumericNames());
+
+    // 空 shape 不属于任何树
+    auto empty = JsShape::emptyShape();
+    ASSERT_EQ(empty->find(StringView("shapeProp0")), -1);
+    ASSERT_EQ(empty->toTree(&tree), tree.root());
+    ASSERT_EQ(shape->toTree(&tree), shape);
+
+    // 冻结后，新的树中属性相同的 shape 的 atom 和 slot 位置不变
+    auto frozen = std::make_shared<JsShapeTree>(&common);
+    auto frozenShape = frozen->root()->addProperty(StringView("a"))->addProperty(StringView("b"));
+    frozen->freeze();
+    JsShapeTree next(frozen);
+    auto converted = frozenShape->toTree(&next);
+    ASSERT_NE(converted, frozenShape);
+    ASSERT_EQ(converted->atoms(), next.atoms());
+    ASSERT_EQ(converted->find(next.atoms()->find(StringView("b"))), 1);
+    ASSERT_EQ(frozenShape->find(next.atoms()->intern(StringView("b"))), 1);
+    ASSERT_EQ(converted->addProperty(StringView("c"))->countProperties(), 3);
+}
+
+class AtomTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+TEST(JsAtomTable, dictionaryKeysNotInterned) {
+    // 转为字典模式的对象的属性名不添加到 atom 表中，atom 表的大小不随动态的属性名增长
+    const char *code = R"(
+        var sum = 0, o = {};
+        for (var i = 0; i < 100000; i++) { o['atomDictKey' + i] = i; sum += o['atomDictKey' + i]; }
+
+        var json = '{';
+        for (var i = 0; i < 5000; i++) { json += (i ? ',' : '') + '"atomJsonKey' + i + '":' + i; }
+        var p = JSON.parse(json + '}');
+        console.log(sum, o.atomDictKey99999, p.atomJsonKey0, p.atomJsonKey4999);
+    )";
+
+    JsVirtualMachine vm;
+    auto console = new AtomTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    auto count = runtime->shapeTree()->atoms()->count();
+    vm.run(code, strlen(code), runtime);
+    ASSERT_EQ(console->output, "4999950000 99999 0 4999\n");
+
+    // 只有创建了 transition 的属性和代码中的名字
+    ASSERT_LT(runtime->shapeTree()->atoms()->count() - count, (uint32_t)JsShape::MAX_PROPERTIES * 2 + 100);
+}
+
+TEST(JsAtomTable, ownedByRuntime) {
+    // 根节点的 transition 数量不受限制: 每个对象的第一个属性名都不同时，也不会转为字典模式
+    const char *code = R"(
+        var list = [];
+        for (var i = 0; i < 2000; i++) { var o = {}; o['atomRootKey' + i] = i; list.push(o); }
+
+        var json = '[';
+        for (var i = 0; i < 2000; i++) { json += (i ? ',' : '') + '{"atomJsonKey' + i + '":' + i + '}'; }
+        var p = JSON.parse(json + ']');
+        console.log(list[1999].atomRootKey1999, p[1999].atomJsonKey1999);
+    )";
+
+    std::weak_ptr<JsShapeTree> tree;
+    {
+        JsVirtualMachine vm;
+        auto console = new AtomTestConsole();
+        auto runtime = vm.defaultRuntime();
+        runtime->setConsole(console);
+        tree = runtime->shapeTree()->shared_from_this();
+        vm.run(code, strlen(code), runtime);
+        ASSERT_EQ(console->output, "1999 1999\n");
+
+        auto ctx = runtime->mainCtx();
+        auto p = runtime->getObject(jsValueGlobalThis)->getByName(ctx, jsValueGlobalThis, StringView("p"));
+        auto last = runtime->getObject(runtime->getObject(p)->getByIndex(ctx, p, 1999));
+        ASSERT_NE(((JsObject *)last)->shape(), nullptr);
+        ASSERT_GE(runtime->shapeTree()->atoms()->count(), 4000u);
+
+        // 每个 VMRuntime 有自己的 atom 表
+        JsVirtualMachine other;
+        auto atoms = other.defaultRuntime()->shapeTree()->atoms();
+        ASSERT_NE(atoms, runtime->shapeTree()->atoms());
+        ASSERT_EQ(atoms->find(StringView("atomRootKey1999")), JS_ATOM_NONE);
+        ASSERT_EQ(atoms->find(StringView("length")), runtime->shapeTree()->atoms()->find(StringView("length")));
+    }
+
+    // atom 表和 shape 树随 VMRuntime 一起释放
+    ASSERT_TRUE(tree.expired());
+}
+
+#endif
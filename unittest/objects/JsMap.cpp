@@ -0,0 +1,266 @@
+﻿//
+//  JsMap.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/22.
+//
+
+#include "objects/JsMap.hpp"
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class MapTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runMapCode(JsVirtualMachine &vm, const char *code, uint32_t gcThreshold = 0) {
+    auto runtime = vm.defaultRuntime();
+    auto console = new MapTestConsole();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+
+    return console->output;
+}
+
+static string runMapCode(const char *code, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    return runMapCode(vm, code, gcThreshold);
+}
+
+TEST(JsMap, sameValueZero) {
+    // NaN 等于 NaN, -0 等于 0, 1 等于 1.0; 字符串按内容比较，和数字不同
+    const char *code = R"(
+        var nan = parseFloat('x');
+        var m = new Map([[1, 'int'], ['1', 'str'], [nan, 'nan']]);
+        m.set(-0, 'zero');
+        m.set(2.5, 'double');
+        console.log(m.size, m.get(1.0), m.get('1'), m.get(nan), m.get(parseFloat('y')), m.get(0), m.get(5 * 0.5));
+
+        var s = 'ab' + 'cd', c = 'x';
+        m.set(s, 1);
+        m.set(c, 2);
+        m.set(1e10, 3);
+        console.log(m.get('abcd'), m.get('a' + 'bcd'), m.get('x'), m.get(1e10), m.get('1e10'));
+
+        var o1 = {}, o2 = {};
+        m.set(o1, 'o1');
+        m.set(null, 'null');
+        m.set(undefined, 'undef');
+        console.log(m.get(o1), m.get(o2), m.get(null), m.get(undefined), m.has(false));
+
+        var st = new Set([1, 1.0, '1', nan, nan, -0, 0]);
+        console.log(st.size, st.has(-0), st.has(nan));
+    )";
+
+    ASSERT_EQ(runMapCode(code),
+        "5 int str nan nan zero double\n"
+        "1 1 2 3 undefined\n"
+        "o1 undefined null undef false\n"
+        "4 true true\n");
+}
+
+TEST(JsMap, mutateDuringIteration) {
+    // 遍历过程中删除、添加和清空. 删除了足够多的 entry 后会压缩，正在遍历的位置需要调整
+    const char *code = R"(
+        var m = new Map();
+        for (var i = 0; i < 10; i++) { m.set(i, i * i); }
+        var visited = '';
+        for (var e of m) {
+            visited += e[0] + ',';
+            if (e[0] % 2 == 0) { m.delete(e[0] + 1); }
+            if (e[0] == 8) { m.set(100, 1); }
+        }
+        console.log(visited, m.size);
+
+        var n = 0;
+        m = new Map([[1, 1]]);
+        m.forEach(function (v, k) { n++; if (k < 5) { m.set(k + 1, 1); } });
+        console.log(n, m.size);
+
+        n = 0;
+        m.forEach(function (v, k) { n++; m.clear(); if (n == 1) { m.set('after', 1); } });
+        console.log(n, m.size);
+
+        m = new Map();
+        for (var i = 0; i < 100; i++) { m.set(i, i); }
+        var it = m.keys(), keys = '';
+        for (var k of it) {
+            keys += k + ',';
+            if (k == 10) { for (var j = 0; j < 95; j++) { m.delete(j); } }
+        }
+        console.log(keys, m.size);
+
+        var st = new Set();
+        for (var i = 0; i < 1000; i++) { st.add(i); st.delete(i - 1); }
+        var vals = '';
+        for (var v of st.values()) { vals += v; }
+        console.log(st.size, vals);
+    )";
+
+    ASSERT_EQ(runMapCode(code),
+        "0,2,4,6,8,100, 6\n"
+        "5 5\n"
+        "2 0\n"
+        "0,1,2,3,4,5,6,7,8,9,10,95,96,97,98,99, 5\n"
+        "1 999\n");
+}
+
+TEST(JsMap, gc) {
+    // 频繁 GC 时 Map 中的 key 和 value 不能被回收
+    const char *code = R"(
+        var m = new Map(), st = new Set();
+        for (var i = 0; i < 2000; i++) {
+            m.set('k' + i, { v: i });
+            st.add({ v: i });
+        }
+        var sum = 0;
+        for (var i = 0; i < 2000; i++) { sum += m.get('k' + i).v; }
+        for (var o of st) { sum += o.v; }
+        var entries = 0;
+        for (var e of new Map([[{}, 'x'], [{}, 'y']]).entries()) { entries++; }
+        console.log(sum, entries);
+    )";
+
+    ASSERT_EQ(runMapCode(code, 64), "3998000 2\n");
+}
+
+TEST(JsMap, weakMapCollect) {
+    // key 不可达之后, WeakMap 中的 entry 被删除, value 被回收
+    const char *code = R"(
+        var wm = new WeakMap(), ws = new WeakSet(), keep = [];
+        for (var i = 0; i < 5000; i++) {
+            var k = { i: i };
+            wm.set(k, { payload: [i, i + 1, i + 2] });
+            ws.add(k);
+            if (i % 1000 == 0) { keep.push(k); }
+        }
+    )";
+
+    {
+        // 每个不可达的 entry 释放 key, value 和 payload 数组
+        JsVirtualMachine vm;
+        runMapCode(vm, code);
+        ASSERT_GE(vm.defaultRuntime()->garbageCollect(), (5000 - 6) * 3);
+    }
+
+    {
+        // 同样的数据放在 Map 中不会被回收
+        JsVirtualMachine vm;
+        runMapCode(vm, R"(
+            var m = new Map();
+            for (var i = 0; i < 5000; i++) { m.set({ i: i }, { payload: [i, i + 1, i + 2] }); }
+        )");
+        ASSERT_LT(vm.defaultRuntime()->garbageCollect(), 5000);
+    }
+
+    // 执行过程中 GC, 存活的 key 对应的 entry 仍然可以访问
+    string codeCheck = string(code) + R"(
+        for (var i = 0; i < 5000; i++) { var tmp = { i: i }; }
+        var s = '';
+        for (var i = 0; i < keep.length; i++) {
+            s += wm.get(keep[i]).payload[1];
+            if (ws.has(keep[i])) { s += 'y,'; }
+        }
+        console.log(s, wm.has({}), ws.has({}));
+    )";
+    ASSERT_EQ(runMapCode(codeCheck.c_str(), 64), "1y,1001y,2001y,3001y,4001y, false false\n");
+}
+
+TEST(JsMap, weakMapEphemeron) {
+    // value 只在 key 存活时存活: value 引用的对象可能是另一个 entry 的 key，或者另一个 WeakMap
+    const char *code = R"(
+        var wm = new WeakMap();
+        var head = { name: 'head' }, k = head;
+        for (var i = 0; i < 100; i++) {
+            var next = { name: 'n' + i };
+            wm.set(k, { next: next, other: new WeakMap([[next, 'inner' + i]]) });
+            k = next;
+        }
+        k = next = null;
+
+        // 触发 GC 的对象
+        for (var i = 0; i < 5000; i++) { var tmp = { i: i }; }
+
+        var count = 0, inner = '';
+        for (k = head; wm.has(k); k = wm.get(k).next) {
+            count++;
+            inner = wm.get(k).other.get(wm.get(k).next);
+        }
+        console.log(count, k.name, inner);
+    )";
+
+    ASSERT_EQ(runMapCode(code, 32), "100 n99 inner99\n");
+    ASSERT_EQ(runMapCode(code, 1024), "100 n99 inner99\n");
+}
+
+TEST(JsMap, DISABLED_benchmark) {
+    // Map 和以对象作为字典的对比:
+    //   TinyJS --gtest_filter=JsMap.* --gtest_also_run_disabled_tests
+    const char *code = R"(
+        function run(name, fn) {
+            var t = new Date().getTime();
+            var r = fn();
+            console.log(name, new Date().getTime() - t, r);
+        }
+
+        var N = 200000;
+        run('Map int keys', function () {
+            var m = new Map(), sum = 0;
+            for (var i = 0; i < N; i++) { m.set(i * 7, i); }
+            for (var i = 0; i < N; i++) { sum += m.get(i * 7); }
+            for (var i = 0; i < N; i += 2) { m.delete(i * 7); }
+            return sum + m.size;
+        });
+        run('Object int keys', function () {
+            var o = {}, sum = 0, size = 0;
+            for (var i = 0; i < N; i++) { o[i * 7] = i; }
+            for (var i = 0; i < N; i++) { sum += o[i * 7]; }
+            for (var i = 0; i < N; i += 2) { delete o[i * 7]; }
+            for (var k in o) { size++; }
+            return sum + size;
+        });
+        run('Map string keys', function () {
+            var m = new Map(), sum = 0;
+            for (var i = 0; i < N; i++) { m.set('k' + i, i); }
+            for (var i = 0; i < N; i++) { sum += m.get('k' + i); }
+            for (var i = 0; i < N; i += 2) { m.delete('k' + i); }
+            return sum + m.size;
+        });
+        run('Object string keys', function () {
+            var o = {}, sum = 0, size = 0;
+            for (var i = 0; i < N; i++) { o['k' + i] = i; }
+            for (var i = 0; i < N; i++) { sum += o['k' + i]; }
+            for (var i = 0; i < N; i += 2) { delete o['k' + i]; }
+            for (var k in o) { size++; }
+            return sum + size;
+        });
+        run('Set objects', function () {
+            var objs = [], st = new Set(), n = 0;
+            for (var i = 0; i < N; i++) { objs.push({ i: i }); st.add(objs[i]); }
+            for (var i = 0; i < N; i++) { if (st.has(objs[i])) { n++; } }
+            return n;
+        });
+    )";
+
+    auto output = runMapCode(code);
+    printf("%s", output.c_str());
+}
+
+#endif
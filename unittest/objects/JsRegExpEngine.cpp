@@ -0,0 +1,201 @@
+﻿//
+//  JsRegExpEngine.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/18.
+//
+
+#include <regex>
+#include "objects/JsRegExpEngine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+// 返回所有分组的位置: "begin-end,begin-end", 未匹配的分组为 "U", 不匹配返回 "null"
+static string execToString(const char *pattern, uint32_t flags, const char *str, uint32_t start = 0) {
+    string error;
+    auto program = JsRegExpProgram::compile(StringView(pattern), flags, error);
+    if (!program) {
+        return "error: " + error;
+    }
+
+    JsRegExpMatch match;
+    if (!program->exec(StringView(str), start, match)) {
+        return "null";
+    }
+
+    string out;
+    for (uint32_t i = 0; i < match.countGroups(); i++) {
+        if (i > 0) {
+            out += ",";
+        }
+        if (match.isMatched(i)) {
+            out += std::to_string(match.begin(i)) + "-" + std::to_string(match.end(i));
+        } else {
+            out += "U";
+        }
+    }
+    return out;
+}
+
+TEST(JsRegExpEngine, semantics) {
+    struct Case {
+        const char *pattern;
+        uint32_t flags;
+        const char *str;
+        const char *expected;
+    };
+
+    Case cases[] = {
+        // 分支的优先级和量词
+        { "a|ab", 0, "abc", "0-1" },
+        { "(a|ab)(c|bcd)(d*)", 0, "abcd", "0-4,0-1,1-4,4-4" },
+        { "x{2,3}?", 0, "xxxx", "0-2" },
+        { "a*?", 0, "aaa", "0-0" },
+        { "a{,2}", 0, "a{,2}", "0-5" },
+        // 每次循环清除分组，空循环不再继续
+        { "(z)((a+)?(b+)?(c))*", 0, "zaacbbbcac", "0-10,0-1,8-10,8-9,U,9-10" },
+        { "(a*)*", 0, "b", "0-0,U" },
+        { "(a*)b\\1+", 0, "baaaac", "0-1,0-0" },
+        // lookaround 和反向引用
+        { "(?=(a+))a*b\\1", 0, "baaabac", "3-6,3-4" },
+        { "(.*?)a(?!(a+)b\\2c)\\2(.*)", 0, "baaabaac", "0-8,0-2,U,3-8" },
+        { "(?<=\\$)\\d+(\\.\\d*)?", 0, "cost $10.53", "6-11,8-11" },
+        { "(?<!\\$)\\b\\d+", 0, "cost $10 and 42", "13-15" },
+        { "\\k<x>(?<x>a)", 0, "aa", "0-1,0-1" },
+        { "(a)\\1", RF_CASE_INSENSITIVE, "aA", "0-2,0-1" },
+        // 断言
+        { "^\\w+$", RF_MULTILINE, "foo\nbar", "0-3" },
+        { "bar$", RF_MULTILINE, "foo\nbar\nbaz", "4-7" },
+        { "\\Bo\\B", 0, "foo", "1-2" },
+        { "a.c", 0, "a\nc", "null" },
+        { "a.c", RF_DOT_ALL, "a\nc", "0-3" },
+        // 字符集和转义
+        { "[^a-c]+", 0, "abcdefabc", "3-6" },
+        { "[\\d-x]+", 0, "a1-x2b", "1-5" },
+        { "A\\x42\\103\\u0044", 0, "ABCD", "0-4" },
+        { "\\cJ[\\b]\\0", 0, "\n\b", "null" },
+        { "[一-龥]+", 0, "ab中文字cd", "2-11" },
+        { "\\ud83d\\ude00", 0, "a\xF0\x9F\x98\x80", "1-5" },
+        { "\\u{1F600}", RF_UNICODE, "a\xF0\x9F\x98\x80", "1-5" },
+        { "[a-z]+", RF_CASE_INSENSITIVE, "12HeLLo3", "2-7" },
+        { "\xC3\xA4", RF_CASE_INSENSITIVE, "\xC3\x84", "0-2" },
+        { "[^a]", RF_CASE_INSENSITIVE, "Ab", "1-2" },
+        { "x|\xC3\xA4", 0, "ab\xC3\xA4", "2-4" },
+        { "\xC3\x84|y", RF_CASE_INSENSITIVE, "ab\xC3\xA4", "2-4" },
+        { "[]", 0, "a", "null" },
+        { "[^]", 0, "a", "0-1" },
+    };
+
+    for (auto &c : cases) {
+        ASSERT_EQ(execToString(c.pattern, c.flags, c.str), c.expected) << c.pattern << " on " << c.str;
+    }
+}
+
+TEST(JsRegExpEngine, startAndSticky) {
+    ASSERT_EQ(execToString("o", 0, "foo boo", 3), "5-6");
+    ASSERT_EQ(execToString("o", RF_STICKY, "foo boo", 3), "null");
+    ASSERT_EQ(execToString("o", RF_STICKY, "foo boo", 2), "2-3");
+    ASSERT_EQ(execToString("^b", 0, "ab", 1), "null");
+    ASSERT_EQ(execToString("^b", RF_MULTILINE, "a\nb", 1), "2-3");
+    ASSERT_EQ(execToString("(?<=a)b", 0, "ab", 1), "1-2");
+    ASSERT_EQ(execToString("", 0, "ab", 2), "2-2");
+    ASSERT_EQ(execToString("", 0, "ab", 3), "null");
+}
+
+TEST(JsRegExpEngine, syntaxErrors) {
+    const char *patterns[][2] = {
+        { "(", "Unterminated group" },
+        { "a)", "Unmatched ')'" },
+        { "a**", "Nothing to repeat" },
+        { "[b-a]", "Range out of order in character class" },
+        { "[a", "Unterminated character class" },
+        { "a{3,2}", "numbers out of order in {} quantifier" },
+        { "(?<n>a)(?<n>b)", "Duplicate capture group name" },
+        { "\\k<m>(?<n>a)", "Invalid named capture referenced" },
+        { "(?<=a)*", "Invalid quantifier" },
+        { "a\\", "\\ at end of pattern" },
+        { "((a{1000}){1000})", "Regular expression too large" },
+    };
+
+    for (auto &item : patterns) {
+        ASSERT_EQ(execToString(item[0], 0, ""), string("error: ") + item[1]) << item[0];
+    }
+
+    // unicode 模式下更严格
+    ASSERT_EQ(execToString("\\a", 0, "a"), "0-1");
+    ASSERT_EQ(execToString("\\a", RF_UNICODE, "a"), "error: Invalid escape");
+    ASSERT_EQ(execToString("]", 0, "]"), "0-1");
+    ASSERT_EQ(execToString("]", RF_UNICODE, "]"), "error: Lone quantifier brackets");
+}
+
+TEST(JsRegExpEngine, linearFallback) {
+    // 灾难性回溯的表达式，超过回溯的步数限制后改用 Pike VM
+    string evil(5000, 'a');
+    ASSERT_EQ(execToString("(a+)+b", 0, evil.c_str()), "null");
+    ASSERT_EQ(execToString("(a|aa)*c", 0, evil.c_str()), "null");
+    ASSERT_EQ(execToString("^(\\w+\\s?)*$", 0, (evil + "!").c_str()), "null");
+
+    // Pike VM 的分组和回溯的结果相同
+    string str = string(30, 'a') + "c" + "aaab";
+    ASSERT_EQ(execToString("(a+)+(b)", 0, str.c_str()), "31-35,31-34,34-35");
+    ASSERT_EQ(execToString("(a+?)+?(b)", 0, str.c_str()), "31-35,33-34,34-35");
+
+    // 回溯使用堆上的栈，长字符串不会栈溢出
+    string longStr;
+    for (int i = 0; i < 500000; i++) {
+        longStr += "ab";
+    }
+    longStr += "c";
+    ASSERT_EQ(execToString("(a|b)*(?=c)", 0, longStr.c_str()), "0-1000000,999999-1000000");
+    ASSERT_EQ(execToString("(?:a|b)*c", 0, longStr.c_str()), "0-1000001");
+}
+
+TEST(JsRegExpEngine, DISABLED_benchmark) {
+    // 和 std::regex 对比查找所有匹配的耗时:
+    //   TinyJS --gtest_filter=JsRegExpEngine.* --gtest_also_run_disabled_tests
+    const char *words[] = { "alpha", "beta", "gamma", "delta", "foo@bar.com", "2023-01-18", "x1y2", "The quick brown fox" };
+    string text;
+    for (int i = 0; i < 200000; i++) {
+        text += words[i % CountOf(words)];
+        text += ' ';
+    }
+
+    const char *patterns[] = { "[a-z]+@[a-z]+\\.com", "(\\d+)-(\\d+)-(\\d+)", "quick\\s+(\\w+)", "[aeiou]{2,}", "fox|dog|cat", "zzz" };
+    printf("Text size: %d KB\n", (int)text.size() / 1024);
+    printf("%-24s %8s %12s %12s %8s\n", "pattern", "matches", "engine(ms)", "std(ms)", "speedup");
+
+    for (auto pattern : patterns) {
+        string error;
+        auto program = JsRegExpProgram::compile(StringView(pattern), 0, error);
+        ASSERT_TRUE(program != nullptr);
+
+        auto start = getTickCount();
+        int count = 0;
+        JsRegExpMatch match;
+        StringView str(text);
+        uint32_t pos = 0;
+        while (pos <= str.len && program->exec(str, pos, match)) {
+            count++;
+            pos = match.end() > match.begin() ? match.end() : match.end() + 1;
+        }
+        auto durationEngine = std::max((int64_t)1, (int64_t)(getTickCount() - start));
+
+        start = getTickCount();
+        std::regex re(pattern, std::regex::ECMAScript);
+        int countStd = 0;
+        for (auto it = std::cregex_iterator(text.c_str(), text.c_str() + text.size(), re); it != std::cregex_iterator(); ++it) {
+            countStd++;
+        }
+        auto durationStd = std::max((int64_t)1, (int64_t)(getTickCount() - start));
+
+        ASSERT_EQ(count, countStd) << pattern;
+        printf("%-24s %8d %12d %12d %7.1fx\n", pattern, count, (int)durationEngine, (int)durationStd, (double)durationStd / durationEngine);
+    }
+}
+
+#endif
@@ -6,3 +6,233 @@
 //
 
 #include <stdio.h>
+#include "parser/Parser.hpp"
+#include "interpreter/VirtualMachine.hpp"
+#include "utils/os.h"
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+class ParserTestConsole : public IConsole {
+public:
+    virtual void log(const StringView &message) override { output.append((const char *)message.data, message.len); output.append("\n"); }
+    virtual void info(const StringView &message) override { log(message); }
+    virtual void warn(const StringView &message) override { log(message); }
+    virtual void error(const StringView &message) override { log(message); }
+
+    string                      output;
+
+};
+
+static string runParserCode(const char *code, bool isLazyParse, uint32_t gcThreshold = 0) {
+    JsVirtualMachine vm;
+    vm.setLazyParse(isLazyParse);
+    auto console = new ParserTestConsole();
+    auto runtime = vm.defaultRuntime();
+    runtime->setConsole(console);
+    if (gcThreshold) {
+        runtime->setGarbageCollectThreshold(gcThreshold);
+    }
+
+    vm.run(code, strlen(code), runtime);
+    while (runtime->onRunTasks()) {
+    }
+
+    return console->output;
+}
+
+// 解析 code 后 ResourcePool 占用的内存
+static size_t parsedMemorySize(const string &code, bool isLazyParse) {
+    ResourcePool resPool;
+    JSParser parser(VMRuntimeCommon::getInstance(), &resPool, code.c_str(), code.size());
+    parser.setLazyParse(isLazyParse);
+
+    auto rootFunc = PoolNew(resPool.pool, Function)(&resPool, nullptr, 0);
+    parser.parse(rootFunc->scope, false);
+    return resPool.pool.totalSize();
+}
+
+TEST(JsParser, lazyFunctions) {
+    const char *code = R"(
+        function outer(a, b) {
+            function g() { return 'g'; }
+            function h() { return 'h'; }
+            var x = 10;
+            // 子函数修改了父函数中声明的函数、引用了参数和变量
+            function setG() { g = function () { return 'g2'; }; }
+            function getH() { return h; }
+            function sum() { return a + b + x; }
+            return { setG: setG, callG: function () { return g(); }, getH: getH, sum: sum, inc: function () { a++; return a; } };
+        }
+        var o1 = outer(1, 2), o2 = outer(100, 200);
+        console.log(o1.callG(), o1.setG(), o1.callG(), o2.callG(), o1.getH()(), o1.sum(), o1.inc(), o1.sum(), o2.sum());
+
+        function literals() { return ['abc' + 'def', 1.5 * 3, /a(b+)/.exec('zabb')[1], { 'k': 0.25 }.k]; }
+        var r = literals();
+        console.log(r[0], r[1], r[2], r[3], literals()[1]);
+
+        function setGlobal() { implicitGlobal = 42; return function () { return implicitGlobal + 1; }; }
+        console.log(setGlobal()(), implicitGlobal);
+
+        var obj = { _v: 1, get v() { return this._v; }, set v(x) { this._v = x * 2; }, m() { return this.v; }, *gen() { yield 'y'; } };
+        obj.v = 4;
+        console.log(obj.v, obj.m(), obj.gen().next().value);
+
+        async function af(v) { var w = await v; return w + 1; }
+        af(1).then(function (v) { console.log('async', v); });
+
+        var iife = (function (n) { function inner() { return n * 2; } return inner(); })(21);
+        function neverCalled(p) { return p + 'source'; }
+        console.log(iife, neverCalled.toString());
+
+        function fact(n) { if (n <= 1) { return 1; } return n * fact(n - 1); }
+        console.log(fact(10));
+    )";
+
+    auto expected = "g undefined g2 g h 13 2 14 310\n"
+        "abcdef 4.5 bb 0.25 4.5\n"
+        "43 42\n"
+        "8 8 y\n"
+        "42 function neverCalled(p) { return p + 'source'; }\n"
+        "3628800\n"
+        "async 2\n";
+    ASSERT_EQ(runParserCode(code, false), expected);
+    ASSERT_EQ(runParserCode(code, true), expected);
+    ASSERT_EQ(runParserCode(code, true, 32), expected);
+
+    // 有 eval 的函数，子函数需要访问其中被 eval 修改的变量
+    code = "function withEval() { var z = 1; eval('z = z + 6'); function inner() { return z + 1; } return inner(); }\n"
+        "console.log(withEval(), withEval());";
+    ASSERT_EQ(runParserCode(code, false), "8 8\n");
+    ASSERT_EQ(runParserCode(code, true), "8 8\n");
+}
+
+TEST(JsParser, lazyCompileInNativeCallback) {
+    // 原生函数遍历字符串时调用的函数才被延迟解析，新增的字符串不能使其持有的引用失效
+    const char *code = R"(
+        function check(c) {
+            var names = ['a1', 'a2', 'a3', 'a4', 'a5', 'a6', 'a7', 'a8', 'a9', 'a10', 'a11', 'a12', 'a13', 'a14', 'a15', 'a16'];
+            var more = ['b1', 'b2', 'b3', 'b4', 'b5', 'b6', 'b7', 'b8', 'b9', 'b10', 'b11', 'b12', 'b13', 'b14', 'b15', 'b16'];
+            return names.length + more.length == 32 && c != 'x';
+        }
+        var r = Array.prototype.filter.call('axbxc', check);
+        console.log(r.length, r[0], r[1], r[2]);
+    )";
+
+    ASSERT_EQ(runParserCode(code, false), "3 a b c\n");
+    ASSERT_EQ(runParserCode(code, true), "3 a b c\n");
+
+    // Function.prototype.toString 也会向同一个 ResourcePool 添加字符串，在回调中调用足够多次，保证其发生扩容
+    string code2 = "var pads = [];\n";
+    size_t len = 0;
+    for (int i = 0; i < 256; i++) {
+        auto index = std::to_string(i);
+        auto pad = "function pad" + index + "() { return " + index + "; }";
+        code2 += pad + "\npads.push(pad" + index + ");\n";
+        len += pad.size();
+    }
+    code2 += R"(
+        var len = 0;
+        function check2(c) {
+            var names = ['c1', 'c2', 'c3', 'c4', 'c5', 'c6', 'c7', 'c8', 'c9', 'c10', 'c11', 'c12', 'c13', 'c14', 'c15', 'c16'];
+            if (c == 'a') {
+                for (var i = 0; i < pads.length; i++) { len += pads[i].toString().length; }
+            }
+            return names.length == 16 && c != 'x';
+        }
+        var r = Array.prototype.filter.call('axbxc', check2);
+        console.log(len, r.length, r[0], r[1], r[2]);
+    )";
+
+    auto expected = std::to_string(len) + " 3 a b c\n";
+    ASSERT_EQ(runParserCode(code2.c_str(), false), expected);
+    ASSERT_EQ(runParserCode(code2.c_str(), true), expected);
+}
+
+TEST(JsParser, lazySyntaxError) {
+    // 预解析也需要报告函数中的语法错误
+    auto output = runParserCode("function neverCalled() { var a = ; }\nconsole.log('ran' + 1);", true);
+    ASSERT_EQ(output.find("ran1"), string::npos);
+    ASSERT_EQ(output.find("Uncaught SyntaxError"), 0);
+
+    output = runParserCode("var o = { get v(x) { return 1; } };\nconsole.log('ran' + 1);", true);
+    ASSERT_EQ(output.find("Uncaught SyntaxError"), 0);
+}
+
+static string makeBundle(int countModules) {
+    // 模块的代码, $ 替换为模块的序号
+    const char *MODULE = R"(
+        function module$(exports) {
+            var cache = {}, count = 0;
+            function helper(a, b) {
+                var list = [];
+                for (var i = 0; i < a; i++) { list.push({ index: i, name: 'item' + i, value: b * i + 0.5 }); }
+                return list.filter(function (item) { return item.index % 2 == 0; }).map(item => item.value);
+            }
+            function format(value) {
+                switch (typeof value) {
+                    case 'number': return value.toFixed(2);
+                    case 'string': return '"' + value.replace(/"/g, '\\"') + '"';
+                    default: return String(value);
+                }
+            }
+            exports.run$ = function (n) { count++; return helper(n, $).length + format(count).length; };
+            exports.get$ = function (key) { if (!(key in cache)) { cache[key] = format(key); } return cache[key]; };
+        }
+        module$(globalThis);
+    )";
+
+    string code;
+    for (int i = 0; i < countModules; i++) {
+        auto index = std::to_string(i);
+        for (auto p = MODULE; *p; p++) {
+            if (*p == '$') {
+                code += index;
+            } else {
+                code += *p;
+            }
+        }
+    }
+    return code;
+}
+
+TEST(JsParser, lazyMemory) {
+    auto code = makeBundle(50);
+    auto lazySize = parsedMemorySize(code, true), eagerSize = parsedMemorySize(code, false);
+    ASSERT_LT(lazySize * 3, eagerSize);
+
+    // 只调用其中的部分函数
+    code += "console.log(run7(10), get3('k'), run49(4));";
+    ASSERT_EQ(runParserCode(code.c_str(), true), runParserCode(code.c_str(), false));
+    ASSERT_EQ(runParserCode(code.c_str(), true), "9 \"k\" 6\n");
+}
+
+TEST(JsParser, DISABLED_benchmark) {
+    // 预解析和完整解析的对比:
+    //   TinyJS --gtest_filter=JsParser.* --gtest_also_run_disabled_tests
+    auto code = makeBundle(2000);
+    printf("bundle size: %d KB\n", (int)(code.size() / 1024));
+
+    for (int i = 0; i < 2; i++) {
+        bool isLazy = i == 1;
+        auto t = getTickCount();
+        size_t size = 0;
+        for (int k = 0; k < 5; k++) {
+            size = parsedMemorySize(code, isLazy);
+        }
+        printf("%s parse x 5: %d ms, memory: %d KB\n", isLazy ? "lazy" : "eager", (int)(getTickCount() - t), (int)(size / 1024));
+    }
+
+    auto run = code + "for (var i = 0; i < 2000; i += 100) { globalThis['run' + i](10); }";
+    for (int i = 0; i < 2; i++) {
+        bool isLazy = i == 1;
+        auto t = getTickCount();
+        runParserCode(run.c_str(), isLazy);
+        printf("%s run (1%% of functions called): %d ms\n", isLazy ? "lazy" : "eager", (int)(getTickCount() - t));
+    }
+}
+
+#endif
@@ -25,6 +25,20 @@ TEST(CharEncoding, utf8ToUtf16Length) {
     ASSERT_EQ(utf8ToUtf16Length((uint8_t *)input, (int)strlen(input)), 2);
 }
 
+TEST(CharEncoding, utf8AsciiPrefixLength) {
+    string text(100, 'a');
+    for (uint32_t i = 0; i < text.size(); i++) {
+        auto s = text;
+        s[i] = '\xe4';
+        ASSERT_EQ(utf8AsciiPrefixLength((uint8_t *)s.c_str(), (uint32_t)s.size()), i);
+        ASSERT_EQ(utf8AsciiPrefixLength((uint8_t *)s.c_str(), i / 2), i / 2);
+    }
+    ASSERT_EQ(utf8AsciiPrefixLength((uint8_t *)text.c_str(), (uint32_t)text.size()), text.size());
+
+    // 无效的首字节也需要计数
+    ASSERT_EQ(utf8ToUtf16Length("ab\xfe\xff" "c", 5), 5);
+}
+
 TEST(CharEncoding, utf8ToUtf16) {
     cstr_t input;
     utf16_t buf[1024];
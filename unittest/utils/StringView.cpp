@@ -6,6 +6,11 @@
 //
 
 #include "utils/Utils.h"
+#include "utils/CharEncoding.h"
+#include "utils/os.h"
+#include <random>
+#include <functional>
+#include <algorithm>
 
 
 #if UNIT_TEST
@@ -90,4 +95,240 @@ TEST(StringView, strrstr) {
     }
 }
 
+// 逐字节实现的参考版本，用于验证和对比
+static int strstrScalar(const StringView &s, const StringView &find, int start = 0) {
+    for (int i = start; i + (int)find.len <= (int)s.len; i++) {
+        if (memcmp(s.data + i, find.data, find.len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static StringView trimScalar(const StringView &s) {
+    return s.trim(stringViewBlanks);
+}
+
+TEST(StringView, searchKernels) {
+    std::mt19937 rng(1);
+    for (int round = 0; round < 2000; round++) {
+        // 字符集很小，以便产生大量的部分匹配
+        string text(rng() % 100, 'a');
+        for (auto &c : text) { c = "ab\xe4 \t"[rng() % 5]; }
+        string find(1 + rng() % 6, 'a');
+        for (auto &c : find) { c = "ab\xe4 "[rng() % 4]; }
+        int start = text.empty() ? 0 : (int)(rng() % text.size());
+
+        StringView s(text), f(find);
+        ASSERT_EQ(s.strstr(f), strstrScalar(s, f)) << text << ", " << find;
+        ASSERT_EQ(s.strstr(f, start), strstrScalar(s, f, start)) << text << ", " << find << ", " << start;
+        ASSERT_EQ(s.strchr(find[0], start), strstrScalar(s, StringView(find.c_str(), 1), start));
+
+        auto t = s.trim(), t2 = trimScalar(s);
+        ASSERT_EQ(t.toString(), t2.toString()) << text;
+        ASSERT_EQ(s.trimStart().toString(), s.trimStart(stringViewBlanks).toString());
+        ASSERT_EQ(s.trimEnd().toString(), s.trimEnd(stringViewBlanks).toString());
+
+        ASSERT_EQ(s.startsWith(f), text.compare(0, find.size(), find) == 0);
+        ASSERT_EQ(s.isAnsi(), text.find('\xe4') == string::npos);
+    }
+}
+
+TEST(StringView, DISABLED_benchmark) {
+    // 对比逐字节的实现和向量化的实现:
+    //   TinyJS --gtest_filter=StringView.* --gtest_also_run_disabled_tests
+    string line;
+    for (int i = 0; line.size() < 4096; i++) {
+        line += "2023-01-17 10:20:" + std::to_string(i % 60) + " INFO [worker-" + std::to_string(i % 8) + "] request done, status=200;";
+    }
+    string padded = string(64, ' ') + line + string(64, '\t');
+    StringView s(line), blanks(padded), find("status=404"), sep(";");
+    const int COUNT = 20000;
+
+    auto bench = [](const char *name, const std::function<int64_t ()> &scalar, const std::function<int64_t ()> &fast) {
+        auto start = getTickCount();
+        auto r1 = scalar();
+        auto t1 = getTickCount() - start;
+        start = getTickCount();
+        auto r2 = fast();
+        auto t2 = getTickCount() - start;
+        printf("  %-14s scalar: %5d ms, vectorized: %5d ms\n", name, (int)t1, (int)t2);
+        return r1 == r2;
+    };
+
+    ASSERT_TRUE(bench("strstr",
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) { n += strstrScalar(s, find, i % 16); } return n; },
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) { n += s.strstr(find, i % 16); } return n; }));
+
+    ASSERT_TRUE(bench("split(';')",
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) {
+            for (int pos = 0, next; (next = strstrScalar(s, sep, pos)) >= 0; pos = next + 1) { n++; } } return n; },
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) {
+            for (int pos = 0, next; (next = s.strstr(sep, pos)) >= 0; pos = next + 1) { n++; } } return n; }));
+
+    ASSERT_TRUE(bench("trim",
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT * 10; i++) { n += trimScalar(StringView(padded)).len; } return n; },
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT * 10; i++) { n += blanks.trim().len; } return n; }));
+
+    ASSERT_TRUE(bench("isAnsi",
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) {
+            n += std::all_of(line.begin(), line.end(), [](char c) { return (uint8_t)c < 0x80; }); } return n; },
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) { n += s.isAnsi(); } return n; }));
+
+    ASSERT_TRUE(bench("utf16Length",
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) {
+            for (auto c : line) { n += ((uint8_t)c & 0xC0) != 0x80; } } return n; },
+        [&]() { int64_t n = 0; for (int i = 0; i < COUNT; i++) { n += utf8ToUtf16Length(s); } return n; }));
+}
+
+static string makeMixedUtf8String(int count) {
+    // 包含 ascii，2、3、4 字节的 utf-8 字符，4 字节的字符对应 surrogate pair
+    const char *parts[] = { "abc", "\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9d\x8c\x86", "0123456789", "\xe6\x96\x87" };
+    string s;
+    for (int i = 0; i < count; i++) {
+        s += parts[(i * 7 + i / 5) % CountOf(parts)];
+    }
+    return s;
+}
+
+// 逐个字符检查 UTF-8 结构并计算 UTF-16 长度的参考版本
+static bool utf8CheckUtf16LengthScalar(const string &s, uint32_t &lenUtf16) {
+    auto p = (const uint8_t *)s.c_str(), last = p + s.size();
+    lenUtf16 = 0;
+    while (p < last) {
+        auto n = utf8FirstByteLength(*p);
+        if ((*p >= 0x80 && *p < 0xC0) || *p >= 0xF8 || n > (uint32_t)(last - p)) {
+            return false;
+        }
+        for (uint32_t i = 1; i < n; i++) {
+            if ((p[i] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        lenUtf16 += n == 4 ? 2 : 1;
+        p += n;
+    }
+    return true;
+}
+
+TEST(StringView, utf8CheckUtf16Length) {
+    for (int count : { 0, 1, 5, 11, 40, 300 }) {
+        string text = makeMixedUtf8String(count);
+        uint32_t len = 0;
+        ASSERT_TRUE(utf8CheckUtf16Length((const uint8_t *)text.c_str(), (uint32_t)text.size(), len));
+        ASSERT_EQ(len, utf8ToUCS2(text).size());
+    }
+
+    // 随机的字节，包含截断的字符、多余的后续字节等不合法的情况
+    std::mt19937 rng(1);
+    for (int round = 0; round < 20000; round++) {
+        string text(rng() % 70, 'a');
+        for (auto &c : text) { c = "a ¿Ãäðøÿ"[rng() % 9]; }
+        if (round % 2) {
+            // 大部分为合法的字符
+            text = makeMixedUtf8String(rng() % 30);
+            if (!text.empty() && round % 4 == 1) {
+                text[rng() % text.size()] = "aÃäð"[rng() % 5];
+            }
+        }
+
+        uint32_t len1 = 0, len2 = 0;
+        auto valid = utf8CheckUtf16Length((const uint8_t *)text.c_str(), (uint32_t)text.size(), len1);
+        ASSERT_EQ(valid, utf8CheckUtf16LengthScalar(text, len2)) << round;
+        if (valid) {
+            ASSERT_EQ(len1, len2) << round;
+        }
+    }
+}
+
+TEST(StringViewUtf16, offsetIndex) {
+    for (int count : { 0, 1, 5, 11, 40, 300 }) {
+        string text = makeMixedUtf8String(count);
+        utf16string u16 = utf8ToUCS2(text);
+
+        StringViewUtf16 s((StringView(text)));
+        ASSERT_EQ(s.size(), u16.size());
+        if (!s.isAnsi() && !s.canRandomAccess()) {
+            auto buf = new uint8_t[Utf8OffsetIndex::memorySize(s.size())];
+            s.setOffsetIndex(Utf8OffsetIndex::create(buf, s.utf8Str(), s.size()));
+        }
+        ASSERT_TRUE(s.canRandomAccess());
+
+        // 顺序和倒序访问
+        for (uint32_t i = 0; i < s.size(); i++) {
+            ASSERT_EQ(s.chartAt(i), u16[i]) << count << ", " << i;
+        }
+        for (uint32_t i = s.size(); i > 0; i--) {
+            ASSERT_EQ(s.chartAt(i - 1), u16[i - 1]) << count << ", " << i - 1;
+        }
+
+        for (uint32_t i = 0; i < s.size(); i++) {
+            uint32_t code = u16[i];
+            if (code >= 0xd800 && code <= 0xdbff && i + 1 < s.size()) {
+                code = 0x10000 + ((code - 0xd800) << 10) + (u16[i + 1] - 0xdc00);
+            }
+            ASSERT_EQ(s.codePointAt(i), code) << count << ", " << i;
+        }
+
+        for (uint32_t start = 0; start < s.size(); start += 7) {
+            for (uint32_t len : { 1, 3, 33, 100000 }) {
+                // 和从头开始查找的结果相同
+                auto p = utf8ToUtf16Seek(text.c_str(), (uint32_t)text.size(), start);
+                auto end = utf8ToUtf16Seek(text.c_str(), (uint32_t)text.size(), std::min(start + len, s.size()));
+                auto sub = s.substr(start, len);
+                ASSERT_EQ(sub.toString(), string(p, end)) << count << ", " << start << ", " << len;
+            }
+        }
+
+        if (s.offsetIndex()) {
+            delete [] (uint8_t *)s.offsetIndex();
+        }
+    }
+}
+
+TEST(StringViewUtf16, DISABLED_benchmark) {
+    // 对比完整 utf-16 拷贝和 Utf8OffsetIndex 的创建及访问耗时:
+    //   TinyJS --gtest_filter=StringViewUtf16.* --gtest_also_run_disabled_tests
+    string text = makeMixedUtf8String(2000000);
+    StringViewUtf16 s((StringView(text)));
+    const int COUNT_ROUNDS = 5;
+    auto size = s.size();
+
+    uint64_t sum1 = 0, sum2 = 0;
+    auto start = getTickCount();
+    for (int i = 0; i < COUNT_ROUNDS; i++) {
+        auto u16 = new utf16_t[size];
+        utf8ToUtf16(s.utf8Str(), u16, size);
+        for (uint32_t k = 0; k < size; k++) { sum1 += u16[k]; }
+        delete [] u16;
+    }
+    printf("  utf-16 copy:  %6d ms, %d KB\n", (int)(getTickCount() - start), (int)(size * sizeof(utf16_t) / 1024));
+
+    start = getTickCount();
+    for (int i = 0; i < COUNT_ROUNDS; i++) {
+        auto buf = new uint8_t[Utf8OffsetIndex::memorySize(size)];
+        StringViewUtf16 t(s.utf8Str(), size);
+        t.setOffsetIndex(Utf8OffsetIndex::create(buf, t.utf8Str(), size));
+        for (uint32_t k = 0; k < size; k++) { sum2 += t.chartAt(k); }
+        delete [] buf;
+    }
+    printf("  offset index: %6d ms, %d KB\n", (int)(getTickCount() - start), (int)(Utf8OffsetIndex::memorySize(size) / 1024));
+    ASSERT_EQ(sum1, sum2);
+
+    uint32_t len = 0;
+    start = getTickCount();
+    for (int i = 0; i < COUNT_ROUNDS; i++) {
+        utf8CheckUtf16LengthScalar(text, len);
+        sum1 += len;
+    }
+    printf("  utf-16 length, scalar:     %5d ms\n", (int)(getTickCount() - start));
+
+    start = getTickCount();
+    for (int i = 0; i < COUNT_ROUNDS; i++) {
+        sum2 += utf8ToUtf16Length(s.utf8Str());
+    }
+    printf("  utf-16 length, vectorized: %5d ms\n", (int)(getTickCount() - start));
+    ASSERT_EQ(sum1, sum2);
+}
+
 #endif
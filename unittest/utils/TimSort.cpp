@@ -0,0 +1,104 @@
+﻿//
+//  TimSort.cpp
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/21.
+//
+
+#include "utils/Utils.h"
+#include "utils/TimSort.h"
+#include <random>
+
+
+#if UNIT_TEST
+
+#include "utils/unittest.h"
+
+
+struct TimSortItem {
+    int                         key;
+    int                         index;
+
+    bool operator==(const TimSortItem &other) const { return key == other.key && index == other.index; }
+};
+
+static void checkSameAsStableSort(std::vector<TimSortItem> items) {
+    auto expected = items;
+    auto less = [](const TimSortItem &a, const TimSortItem &b) { return a.key < b.key; };
+    std::stable_sort(expected.begin(), expected.end(), less);
+
+    timSort(items.data(), items.size(), less);
+    ASSERT_TRUE(items == expected);
+}
+
+TEST(TimSort, stable) {
+    std::mt19937 rng(1);
+
+    for (int count : { 0, 1, 2, 3, 31, 32, 33, 64, 65, 100, 1000, 5000, 70000 }) {
+        for (int range : { 2, 10, 1000, 1000000 }) {
+            std::vector<TimSortItem> items;
+            for (int i = 0; i < count; i++) {
+                items.push_back({(int)(rng() % range), i});
+            }
+            checkSameAsStableSort(items);
+
+            // 由多段有序和逆序数据组成
+            std::vector<TimSortItem> runs;
+            for (int i = 0; i < count; i++) {
+                int segment = i / 300;
+                int key = (segment % 2 == 0) ? i % 300 : 300 - i % 300;
+                runs.push_back({key % range, i});
+            }
+            checkSameAsStableSort(runs);
+        }
+    }
+}
+
+TEST(TimSort, countComparisons) {
+    // 有序和严格逆序的数据只需要 n - 1 次比较
+    const int COUNT = 100000;
+    std::vector<int> values;
+    for (int i = 0; i < COUNT; i++) {
+        values.push_back(i);
+    }
+
+    int countCmp = 0;
+    auto less = [&countCmp](int a, int b) { countCmp++; return a < b; };
+
+    timSort(values.data(), values.size(), less);
+    ASSERT_EQ(countCmp, COUNT - 1);
+
+    std::reverse(values.begin(), values.end());
+    countCmp = 0;
+    timSort(values.data(), values.size(), less);
+    ASSERT_EQ(countCmp, COUNT - 1);
+    ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+
+    // 有序的数据后面追加了少量数据: 合并时跳过已经在最终位置上的部分
+    std::sort(values.begin(), values.end());
+    for (int i = 0; i < 10; i++) {
+        values.push_back(i * 1000 + 7);
+    }
+    countCmp = 0;
+    timSort(values.data(), values.size(), less);
+    ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+    ASSERT_LT(countCmp, COUNT + 1000);
+}
+
+TEST(TimSort, inconsistentComparator) {
+    // 不一致的比较函数不能导致越界访问，所有的元素都需要保留
+    std::mt19937 rng(2);
+    std::vector<int> values;
+    for (int i = 0; i < 10000; i++) {
+        values.push_back(i);
+    }
+
+    timSort(values.data(), values.size(), [&rng](int a, int b) { return rng() % 2 == 0; });
+
+    std::sort(values.begin(), values.end());
+    for (int i = 0; i < (int)values.size(); i++) {
+        ASSERT_EQ(values[i], i);
+    }
+}
+
+#endif
@@ -27,3 +27,20 @@ void AllocatorPool::reset() {
     _start = nullptr;
     _end = nullptr;
 }
+
+void AllocatorPool::rollback(const Mark &mark) {
+    while (_poolBlockMax != mark.poolBlockMax) {
+        auto tmp = _poolBlockMax;
+        _poolBlockMax = _poolBlockMax->next;
+        delete [] (uint8_t *)tmp;
+    }
+
+    while (_poolBlock != mark.poolBlock) {
+        auto tmp = _poolBlock;
+        _poolBlock = _poolBlock->next;
+        delete [] (uint8_t *)tmp;
+    }
+
+    _start = mark.start;
+    _end = mark.end;
+}
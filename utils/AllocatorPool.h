@@ -117,6 +117,16 @@ public:
 
     void reset();
 
+    // 记录当前的分配位置，rollback 时释放在此之后分配的所有内存
+    struct Mark {
+        PoolBlock               *poolBlock;
+        PoolBlock               *poolBlockMax;
+        uint8_t                 *start, *end;
+    };
+
+    Mark mark() const { return { _poolBlock, _poolBlockMax, _start, _end }; }
+    void rollback(const Mark &mark);
+
     size_t totalSize() {
         size_t size = 0;
         for (auto p = _poolBlock; p != nullptr; p = p->next) {
@@ -9,6 +9,11 @@
 #include "FileApi.h"
 #include "StringEx.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2_SCAN       1
+#endif
+
 
 #ifndef _WIN32
 EncodingCodePage &getSysDefaultCharEncoding() {
@@ -270,18 +275,58 @@ void ucs2EncodingReverse(utf16_t *str, uint32_t nLen) {
     }
 }
 
-uint32_t utf8ToUtf16Length(const uint8_t *str, uint32_t len) {
+uint32_t utf8AsciiPrefixLength(const uint8_t *str, uint32_t len) {
     auto p = str, last = str + len;
+
+#if USE_SSE2_SCAN
+    // 每次检查 16 个字节的最高位
+    while (p + 16 <= last) {
+        auto mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p));
+        if (mask != 0) {
+            return (uint32_t)(p - str) + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#else
+    while (p + 8 <= last) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        if (v & 0x8080808080808080ULL) {
+            break;
+        }
+        p += 8;
+    }
+#endif
+
+    while (p < last && *p < 0x80) {
+        p++;
+    }
+
+    return (uint32_t)(p - str);
+}
+
+uint32_t utf8ToUtf16Length(const uint8_t *str, uint32_t len) {
     uint32_t lenUtf16 = 0;
+#if USE_SSE2_SCAN
+    // 向量化地计算，不合法的 UTF-8 再和 utf8ToUtf16 一样逐个字符计算
+    if (utf8CheckUtf16Length(str, len, lenUtf16)) {
+        return lenUtf16;
+    }
+#endif
+
+    auto p = str, last = str + len;
 
     // bool hasInvalidChars = false;
     while ((p < last)) {
-        lenUtf16++;
         if ((*p) < 0x80) {
-            p += 1;
+            // 连续的 ascii 字符一次跳过
+            auto n = utf8AsciiPrefixLength(p, (uint32_t)(last - p));
+            lenUtf16 += n;
+            p += n;
             continue;
         }
 
+        lenUtf16++;
         if ((*p) < 0xc0) {
             // hasInvalidChars = true;
             p++;
@@ -318,6 +363,8 @@ uint32_t utf8ToUtf16Length(const uint8_t *str, uint32_t len) {
             p += 6;
         } else {
             // hasInvalidChars = true;
+            // 和 utf8ToUtf16 一致，转换为 '?'
+            p++;
         }
     }
 
@@ -390,10 +437,15 @@ uint8_t *utf8ToUtf16Seek(const uint8_t *str, uint32_t len, uint32_t utf16Pos) {
     uint32_t lenUtf16 = 0;
 
     while (p < last && lenUtf16 < utf16Pos) {
-        lenUtf16++;
         if ((*p) < 0x80) {
-            p += 1;
-        } else if ((*p) < 0xc0) {
+            auto n = utf8AsciiPrefixLength(p, std::min((uint32_t)(last - p), utf16Pos - lenUtf16));
+            lenUtf16 += n;
+            p += n;
+            continue;
+        }
+
+        lenUtf16++;
+        if ((*p) < 0xc0) {
             p += 1;
         } else if ((*p) < 0xe0) {
             p += 2;
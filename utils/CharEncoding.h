@@ -115,6 +115,9 @@ inline utf16string utf8ToUCS2(const std::string &str)
     { utf16string s; utf8ToUCS2(str.c_str(), (int)str.size(), s); return s; }
 int utf8ToMbcs(const char *str, int len, string &strOut, int encodingID = ED_SYSDEF);
 
+// 返回 str 开头连续的 ascii 字符的数量
+uint32_t utf8AsciiPrefixLength(const uint8_t *str, uint32_t len);
+
 uint32_t utf8ToUtf16Length(const uint8_t *str, uint32_t len);
 inline uint32_t utf8ToUtf16Length(const char *str, uint32_t len)
     { return utf8ToUtf16Length((uint8_t *)str, len); }
@@ -46,9 +46,19 @@ int64_t getTimeInMillisecond() {
 DateTime::DateTime(bool localTime) : DateTime(getTimeInMillisecond(), localTime) {
 }
 
+struct tm *timeToTm(time_t t, bool isLocalTime, struct tm &out) {
+#ifdef _WIN32
+    auto err = isLocalTime ? localtime_s(&out, &t) : gmtime_s(&out, &t);
+    return err == 0 ? &out : nullptr;
+#else
+    return isLocalTime ? localtime_r(&t, &out) : gmtime_r(&t, &out);
+#endif
+}
+
 tm *msToTm(int64_t timeInMs, bool isLocalTime) {
-    time_t t = timeInMs / 1000;
-    return isLocalTime ? localtime(&t) : gmtime(&t);
+    // 只在构造 DateTime 时临时使用
+    static thread_local struct tm tmBuf;
+    return timeToTm(timeInMs / 1000, isLocalTime, tmBuf);
 }
 
 DateTime::DateTime(int64_t timeInMs, bool localTime) : DateTime(msToTm(timeInMs, localTime), timeInMs % 1000, localTime) {
@@ -69,8 +79,8 @@ DateTime::DateTime(int year, int month, int day, int hour, int minute, int secon
     _isLocalTime = isLocalTime;
 
     if (dayOfWeek == -1) {
-        auto t = getTime();
-        dayOfWeek = isLocalTime ? localtime(&t)->tm_wday : gmtime(&t)->tm_wday;
+        struct tm tmBuf;
+        dayOfWeek = timeToTm(getTime(), isLocalTime, tmBuf)->tm_wday;
     }
     _dayOfWeek = (int8_t)dayOfWeek;
 }
@@ -97,7 +107,8 @@ time_t DateTime::getTime() const {
 }
 
 void DateTime::fromTime(time_t time) {
-    auto tm = _isLocalTime ? localtime(&time) : gmtime(&time);
+    struct tm tmBuf;
+    auto tm = timeToTm(time, _isLocalTime, tmBuf);
     _year = tm->tm_year + 1900;
     _month = tm->tm_mon + 1;
     _day = tm->tm_mday;
@@ -3,6 +3,9 @@
 
 int64_t getTimeInMillisecond();
 
+// 线程安全的 localtime/gmtime, 结果保存在 out 中
+struct tm *timeToTm(time_t t, bool isLocalTime, struct tm &out);
+
 class DateTime {
 public:
     enum {
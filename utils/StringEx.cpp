@@ -517,6 +517,62 @@ uint32_t parseExponentCount(char *buf, uint32_t len, int32_t &expCount) {
     return lenNumbers;
 }
 
+/**
+ * 小数位数不超过 8 位的数 (比如: 1.25, 100, 0.001) 直接按照整数输出，避免逐个精度 snprintf + strtod.
+ * m = value * 10^k 为整数且小于 2^50 时，value 的舍入区间内最多只有一个 k 位小数，所以去掉末尾的 0 之后就是最短的表示.
+ * 不满足条件时返回 0.
+ */
+static uint32_t floatToShortDecimal(double value, char *buf) {
+    if (value < 1e-6 || value >= 1e15) {
+        return 0;
+    }
+
+    double scale = 1;
+    for (int k = 0; k <= 8; k++, scale *= 10) {
+        auto m = value * scale;
+        if (m >= (double)(1ll << 50)) {
+            return 0;
+        }
+
+        auto n = (int64_t)m;
+        if ((double)n != m || m / scale != value) {
+            continue;
+        }
+
+        while (k > 0 && n % 10 == 0) {
+            n /= 10;
+            k--;
+        }
+
+        char digits[32];
+        auto len = (int)u64toa((uint64_t)n, digits);
+        auto p = buf;
+        if (k == 0) {
+            memcpy(p, digits, len);
+            p += len;
+        } else if (len > k) {
+            // 123 1 => 12.3
+            memcpy(p, digits, len - k);
+            p += len - k;
+            *p++ = '.';
+            memcpy(p, digits + len - k, k);
+            p += k;
+        } else {
+            // 12 4 => 0.0012
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', k - len);
+            p += k - len;
+            memcpy(p, digits, len);
+            p += len;
+        }
+        *p = '\0';
+        return (uint32_t)(p - buf);
+    }
+
+    return 0;
+}
+
 /**
  * 将 double 转化为字符串，截断为 0 的浮点部分，比如:
  *     10.00     => 10
@@ -546,6 +602,13 @@ uint32_t floatToStringEx(double value, char *buf, uint32_t bufSize, int32_t prec
         return isNegative + 8;
     }
 
+    if (precisionCount < 0 && flags == F_TRIM_TAILING_ZERO) {
+        auto len = floatToShortDecimal(value, p);
+        if (len > 0) {
+            return isNegative + len;
+        }
+    }
+
     if (flags & F_FIXED_DIGITS) {
         return isNegative + snprintf(p, bufSize, "%.*f", precisionCount, value);
     }
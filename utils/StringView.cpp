@@ -9,29 +9,226 @@
 #include <ctype.h>
 #include <climits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2_SCAN       1
+#endif
+
+
+/**
+ * 在 str 中查找 find，先用 find 的首尾字节过滤出候选位置，再比较中间的字节.
+ */
+static const uint8_t *searchSubstr(const uint8_t *str, uint32_t len, const uint8_t *find, uint32_t lenFind) {
+    assert(lenFind > 0 && len >= lenFind);
+    if (lenFind == 1) {
+        return (const uint8_t *)memchr(str, find[0], len);
+    }
+
+    auto p = str, last = str + len - lenFind;
+
+#if USE_SSE2_SCAN
+    // 每次检查 16 个开始位置
+    auto first = _mm_set1_epi8((char)find[0]), tail = _mm_set1_epi8((char)find[lenFind - 1]);
+    while (p + 15 <= last) {
+        auto eqFirst = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)p));
+        auto eqTail = _mm_cmpeq_epi8(tail, _mm_loadu_si128((const __m128i *)(p + lenFind - 1)));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(eqFirst, eqTail));
+        while (mask) {
+            auto i = __builtin_ctz(mask);
+            if (memcmp(p + i + 1, find + 1, lenFind - 2) == 0) {
+                return p + i;
+            }
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
 
-StringView::StringView(const char *data) : data((char *)data), len((uint32_t)strlen((const char *)data)) {
+    while (p <= last) {
+        p = (const uint8_t *)memchr(p, find[0], last - p + 1);
+        if (p == nullptr) {
+            return nullptr;
+        }
+
+        if (memcmp(p + 1, find + 1, lenFind - 1) == 0) {
+            return p;
+        }
+        p++;
+    }
+
+    return nullptr;
 }
 
-bool StringView::isNumeric() const {
-    auto end = data + len;
-    auto p = data;
+inline bool isBlankChar(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
 
-    for (; p < end; ++p) {
-        if (!isDigit(*p)) {
+#if USE_SSE2_SCAN
+// 返回 16 个字节中不是空白字符的位置掩码
+inline uint32_t nonBlankMask(const uint8_t *p) {
+    auto v = _mm_loadu_si128((const __m128i *)p);
+    auto blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+    return ~_mm_movemask_epi8(blank) & 0xFFFF;
+}
+#endif
+
+// 跳过 stringViewBlanks 中的空白字符
+static const uint8_t *skipBlanks(const uint8_t *p, const uint8_t *end) {
+#if USE_SSE2_SCAN
+    while (p + 16 <= end) {
+        auto mask = nonBlankMask(p);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+
+    while (p < end && isBlankChar(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const uint8_t *skipBlanksBackward(const uint8_t *start, const uint8_t *end) {
+#if USE_SSE2_SCAN
+    while (end - 16 >= start) {
+        auto mask = nonBlankMask(end - 16);
+        if (mask) {
+            return end - 16 + (31 - __builtin_clz(mask)) + 1;
+        }
+        end -= 16;
+    }
+#endif
+
+    while (end > start && isBlankChar(*(end - 1))) {
+        end--;
+    }
+    return end;
+}
+
+#if USE_SSE2_SCAN
+// v 中每个字节是否 >= min 的掩码
+inline __m128i bytesNotLess(__m128i v, uint8_t min) {
+    return _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8((char)min)), v);
+}
+
+// v 中 16 个字节的和
+inline uint32_t sumBytes(__m128i v) {
+    auto sum = _mm_sad_epu8(v, _mm_setzero_si128());
+    return (uint32_t)_mm_cvtsi128_si32(sum) + (uint32_t)_mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+}
+#endif
+
+/**
+ * 每个引导字节后需要有对应数量的后续字节 (10xxxxxx)，且不能有多余的后续字节和 0xF8 以上的字节.
+ * 向量化的版本比较每个字节是否为后续字节，和其前 1~3 个字节是否要求它为后续字节.
+ * UTF-16 的长度为非后续字节的数量，加上 4 字节字符 (对应 surrogate pair) 的数量.
+ */
+bool utf8CheckUtf16Length(const uint8_t *str, uint32_t len, uint32_t &lenUtf16Out) {
+    auto p = str, last = str + len;
+    uint32_t lenUtf16 = 0;
+
+#if USE_SSE2_SCAN
+    auto prev = _mm_setzero_si128(), invalid = _mm_setzero_si128();
+    // 每个字节位置上后续字节和 4 字节字符的计数，最多累加 255 次
+    auto countCont = _mm_setzero_si128(), count4Bytes = _mm_setzero_si128();
+    uint32_t prevHighMask = 0, rounds = 0, totalCont = 0, total4Bytes = 0;
+    while (p < last) {
+        __m128i cur;
+        if (p + 16 <= last) {
+            cur = _mm_loadu_si128((const __m128i *)p);
+        } else {
+            // 末尾不足 16 个字节，补 0 后被截断的字符会被当作不合法
+            uint8_t tail[16] = { 0 };
+            memcpy(tail, p, last - p);
+            cur = _mm_loadu_si128((const __m128i *)tail);
+        }
+        p += 16;
+
+        auto highMask = (uint32_t)_mm_movemask_epi8(cur);
+        if (highMask == 0 && (prevHighMask & 0xE000) == 0) {
+            // 前面没有未结束的字符时，跳过连续的 ascii 字符
+            while (p + 16 <= last && _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p)) == 0) {
+                p += 16;
+            }
+            prev = _mm_setzero_si128();
+            prevHighMask = 0;
+            continue;
+        }
+
+        auto prev1 = _mm_or_si128(_mm_slli_si128(cur, 1), _mm_srli_si128(prev, 15));
+        auto prev2 = _mm_or_si128(_mm_slli_si128(cur, 2), _mm_srli_si128(prev, 14));
+        auto prev3 = _mm_or_si128(_mm_slli_si128(cur, 3), _mm_srli_si128(prev, 13));
+        auto needCont = _mm_or_si128(_mm_or_si128(bytesNotLess(prev1, 0xC0), bytesNotLess(prev2, 0xE0)),
+            bytesNotLess(prev3, 0xF0));
+        auto isCont = _mm_cmpeq_epi8(_mm_and_si128(cur, _mm_set1_epi8((char)0xC0)), _mm_set1_epi8((char)0x80));
+        invalid = _mm_or_si128(invalid, _mm_or_si128(_mm_xor_si128(needCont, isCont), bytesNotLess(cur, 0xF8)));
+
+        // 掩码为 -1，相减即为加 1
+        countCont = _mm_sub_epi8(countCont, isCont);
+        count4Bytes = _mm_sub_epi8(count4Bytes, bytesNotLess(cur, 0xF0));
+        if (++rounds == 255) {
+            totalCont += sumBytes(countCont);
+            total4Bytes += sumBytes(count4Bytes);
+            countCont = count4Bytes = _mm_setzero_si128();
+            rounds = 0;
+        }
+
+        prev = cur;
+        prevHighMask = highMask;
+    }
+
+    if (_mm_movemask_epi8(invalid) != 0) {
+        return false;
+    }
+
+    // 长度为 16 的倍数时，最后一个字符可能被截断
+    for (auto q = std::max(str, last - 3); q < last; q++) {
+        if (*q >= 0xC0 && utf8FirstByteLength(*q) > (uint32_t)(last - q)) {
             return false;
         }
     }
 
+    lenUtf16 = len - totalCont - sumBytes(countCont) + total4Bytes + sumBytes(count4Bytes);
+#else
+    while (p < last) {
+        if (*p < 0x80) {
+            auto n = utf8AsciiPrefixLength(p, (uint32_t)(last - p));
+            lenUtf16 += n;
+            p += n;
+            continue;
+        }
+
+        auto n = utf8FirstByteLength(*p);
+        if (*p < 0xC0 || *p >= 0xF8 || n > (uint32_t)(last - p)) {
+            return false;
+        }
+        for (uint32_t i = 1; i < n; i++) {
+            if ((p[i] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        lenUtf16 += n == 4 ? 2 : 1;
+        p += n;
+    }
+#endif
+
+    lenUtf16Out = lenUtf16;
     return true;
 }
 
-bool StringView::isAnsi() const {
-    auto end = (uint8_t *)data + len;
-    auto p = (uint8_t *)data;
+
+StringView::StringView(const char *data) : data((char *)data), len((uint32_t)strlen((const char *)data)) {
+}
+
+bool StringView::isNumeric() const {
+    auto end = data + len;
+    auto p = data;
 
     for (; p < end; ++p) {
-        if (*p > 127) {
+        if (!isDigit(*p)) {
             return false;
         }
     }
@@ -39,18 +236,17 @@ bool StringView::isAnsi() const {
     return true;
 }
 
-int StringView::strchr(uint8_t c, int start) const {
-    const auto *p = data + start, *last = data + len;
-
-    while (p < last) {
-        if (*p == c) {
-            return (int)(p - data);
-        }
+bool StringView::isAnsi() const {
+    return utf8AsciiPrefixLength((uint8_t *)data, len) == len;
+}
 
-        p++;
+int StringView::strchr(uint8_t c, int start) const {
+    if (start < 0 || (uint32_t)start >= len) {
+        return -1;
     }
 
-    return -1;
+    auto p = (const char *)memchr(data + start, c, len - start);
+    return p ? (int)(p - data) : -1;
 }
 
 int StringView::strrchr(uint8_t c, int startPos) const {
@@ -74,29 +270,14 @@ int StringView::strstr(const StringView &find, int32_t start) const {
         return 0;
     }
 
-    const auto *last = data + len - find.len;
-    const auto *s1 = data, *s2 = find.data;
-    uint32_t len = find.len - 1;
-    char c1, c2;
-
-    if (start > 0) {
-        s1 += start;
+    if (start < 0) {
+        start = 0;
+    } else if ((uint32_t)start > len - find.len) {
+        return -1;
     }
 
-    c2 = (uint8_t)*s2++;
-
-    do {
-        do {
-            if (s1 > last) {
-                return -1;
-            }
-
-            c1 = *s1++;
-        } while (c1 != c2);
-
-    } while (memcmp(s1, s2, len) != 0);
-
-    return (int)(s1 - data - 1);
+    auto p = searchSubstr((uint8_t *)data + start, len - start, (uint8_t *)find.data, find.len);
+    return p ? (int)(p - (uint8_t *)data) : -1;
 }
 
 int StringView::stristr(const StringView &find, int32_t start) const {
@@ -220,17 +401,7 @@ bool StringView::startsWith(const StringView &with) const {
         return false;
     }
 
-    const auto *p1 = data, *p1End = data + len;
-    const auto *p2 = with.data, *p2End = with.data + with.len;
-
-    for (; p1 < p1End && p2 < p2End; p1++, p2++) {
-        if (*p1 == *p2) {
-            continue;
-        }
-        return false;
-    }
-
-    return p2 == p2End;
+    return memcmp(data, with.data, with.len) == 0;
 }
 
 bool StringView::iStartsWith(const StringView &with) const {
@@ -297,7 +468,22 @@ StringView StringView::trim(const StringView &toTrim) const {
 }
 
 StringView StringView::trim() const {
-    return trim(stringViewBlanks);
+    auto start = skipBlanks((uint8_t *)data, (uint8_t *)data + len);
+    auto end = skipBlanksBackward(start, (uint8_t *)data + len);
+
+    return StringView(start, (uint32_t)(end - start), _isStable);
+}
+
+StringView StringView::trimStart() const {
+    auto start = skipBlanks((uint8_t *)data, (uint8_t *)data + len);
+
+    return StringView(start, (uint32_t)((uint8_t *)data + len - start), _isStable);
+}
+
+StringView StringView::trimEnd() const {
+    auto end = skipBlanksBackward((uint8_t *)data, (uint8_t *)data + len);
+
+    return StringView(data, (uint32_t)(end - (uint8_t *)data), _isStable);
 }
 
 StringView StringView::trimStart(const StringView &toTrim) const {
@@ -536,27 +722,151 @@ bool istrIsInList(StringView &str, StringView *arr, size_t count) {
     return false;
 }
 
+/**
+ * 从 utf-8 偏移 offset (对应 utf-16 位置 posCur) 开始向后查找包含 utf-16 位置 pos 的字符.
+ */
+static uint32_t utf8SeekCharAt(const StringView &str, uint32_t offset, uint32_t &posCur, uint32_t pos) {
+    auto start = (const uint8_t *)str.data, p = start + offset, last = start + str.len;
+    uint32_t cur = posCur;
+
+    while (p < last) {
+        if (*p < 0x80) {
+            if (cur == pos) {
+                break;
+            }
+
+            auto n = utf8AsciiPrefixLength(p, std::min((uint32_t)(last - p), pos - cur));
+            p += n;
+            cur += n;
+            continue;
+        }
+
+        uint32_t count = (*p >= 0xf0 && *p < 0xf8) ? 2 : 1;
+        if (cur + count > pos) {
+            break;
+        }
+
+        cur += count;
+        p += utf8FirstByteLength(*p);
+    }
+
+    posCur = cur;
+    return (uint32_t)((p > last ? last : p) - start);
+}
+
+Utf8OffsetIndex *Utf8OffsetIndex::create(void *buf, const StringView &str, uint32_t lenUtf16) {
+    auto index = new (buf) Utf8OffsetIndex();
+    index->_lastPos = index->_lastOffset = 0;
+
+    auto start = (const uint8_t *)str.data, p = start, last = start + str.len;
+    uint32_t pos = 0, i = 0, count = lenUtf16 / STEP + 1;
+    auto offsets = index->_offsets;
+
+    while (p < last && i < count) {
+        if (*p < 0x80) {
+            auto n = utf8AsciiPrefixLength(p, (uint32_t)(last - p));
+            for (; i < count && i * STEP < pos + n; i++) {
+                offsets[i] = (uint32_t)(p - start) + (i * STEP - pos);
+            }
+            pos += n;
+            p += n;
+        } else {
+            uint32_t n = (*p >= 0xf0 && *p < 0xf8) ? 2 : 1;
+            for (; i < count && i * STEP < pos + n; i++) {
+                offsets[i] = (uint32_t)(p - start) | (i * STEP > pos ? 0x80000000 : 0);
+            }
+            pos += n;
+            p += utf8FirstByteLength(*p);
+        }
+    }
+
+    assert(p < last || pos == lenUtf16);
+    for (; i < count; i++) {
+        offsets[i] = str.len;
+    }
+
+    return index;
+}
+
+uint32_t Utf8OffsetIndex::seek(const StringView &str, uint32_t pos, uint32_t &posStartOut) const {
+    auto i = pos / STEP;
+    auto offset = _offsets[i];
+    uint32_t cur = i * STEP - (offset >> 31);
+    offset &= 0x7FFFFFFF;
+
+    if (_lastPos <= pos && _lastPos > cur) {
+        // 顺序访问时从上次的位置继续
+        cur = _lastPos;
+        offset = _lastOffset;
+    }
+
+    offset = utf8SeekCharAt(str, offset, cur, pos);
+    _lastPos = cur;
+    _lastOffset = offset;
+
+    posStartOut = cur;
+    return offset;
+}
+
 bool StringViewUtf16::equal(uint32_t code) const {
     if (size() != 1) {
         return false;
     }
 
-    if (_dataUtf16) {
-        return *_dataUtf16 == code;
-    }
-
     utf16_t buf[8];
     utf8ToUtf16((uint8_t *)_utf8Str.data, _utf8Str.len, buf, CountOf(buf));
     return buf[0] == code;
 }
 
 void StringViewUtf16::onSetUtf8String() {
-    _dataUtf16 = nullptr;
+    _offsetIndex = nullptr;
 
     setUtf16Size(utf8ToUtf16Length((uint8_t *)_utf8Str.data, _utf8Str.len));
     setAnsi(size() == _utf8Str.len);
 }
 
+const uint8_t *StringViewUtf16::seekCharAt(uint32_t pos, uint32_t &posStartOut) const {
+    uint32_t offset;
+    if (_offsetIndex) {
+        offset = _offsetIndex->seek(_utf8Str, pos, posStartOut);
+    } else {
+        posStartOut = 0;
+        offset = utf8SeekCharAt(_utf8Str, 0, posStartOut, pos);
+    }
+
+    return (uint8_t *)_utf8Str.data + offset;
+}
+
+const uint8_t *StringViewUtf16::seekUtf16(uint32_t pos) const {
+    auto last = (uint8_t *)_utf8Str.data + _utf8Str.len;
+    if (pos >= size()) {
+        return last;
+    }
+
+    uint32_t posStart;
+    auto p = seekCharAt(pos, posStart);
+    if (posStart < pos) {
+        // 在 surrogate pair 的中间
+        p += utf8FirstByteLength(*p);
+        if (p > last) {
+            p = last;
+        }
+    }
+
+    return p;
+}
+
+utf16_t StringViewUtf16::chartAtUtf8(uint32_t index) const {
+    uint32_t posStart;
+    auto p = seekCharAt(index, posStart);
+    auto last = (uint8_t *)_utf8Str.data + _utf8Str.len;
+
+    utf16_t buf[2] = { 0, 0 };
+    utf8ToUtf16(p, std::min((uint32_t)(last - p), (uint32_t)4), buf, CountOf(buf));
+    assert(index - posStart < CountOf(buf));
+    return buf[index - posStart];
+}
+
 utf32_t StringViewUtf16::codePointAt(uint32_t index) const {
     assert(canRandomAccess());
     assert(index < size());
@@ -565,12 +875,12 @@ utf32_t StringViewUtf16::codePointAt(uint32_t index) const {
         return _utf8Str.data[index];
     }
 
-    uint32_t code = _dataUtf16[index];
+    uint32_t code = chartAtUtf8(index);
     if (code >= 0xd800 && code <= 0xdbff) {
         // Code points from the other planes (called Supplementary Planes) are encoded as two 16-bit code units called a surrogate pair,
         // https://en.wikipedia.org/wiki/UTF-16
         if (index + 1 < size()) {
-            auto next = _dataUtf16[index + 1];
+            auto next = chartAtUtf8(index + 1);
             if (next >= 0xdc00 && next <= 0xdfff) {
                 code = 0x10000 + ((code - 0xd800) << 10) | (next - 0xdc00);
             }
@@ -588,7 +898,7 @@ int StringViewUtf16::indexOf(const StringView &find, int32_t start) const {
     int32_t pos;
     if (start > 0) {
         // 将 utf-16 的偏移转换为 utf-8 的
-        auto p = utf8ToUtf16Seek((uint8_t *)_utf8Str.data, _utf8Str.len, start);
+        auto p = seekUtf16(start);
         pos = StringView(p, _utf8Str.len - (p - (uint8_t *)_utf8Str.data)).strstr(find);
         if (pos >= 0) {
             // 需要转换为 utf-16 的偏移地址
@@ -613,7 +923,7 @@ int StringViewUtf16::lastIndexOf(const StringView &find, int32_t start) const {
     int32_t pos;
     if (start > 0) {
         // 将 utf-16 的偏移转换为 utf-8 的
-        auto p = utf8ToUtf16Seek((uint8_t *)_utf8Str.data, _utf8Str.len, start);
+        auto p = seekUtf16(start);
         start = int32_t(p - (uint8_t *)_utf8Str.data);
     }
 
@@ -636,10 +946,12 @@ StringView StringViewUtf16::substr(uint32_t offset, uint32_t size) const {
         return stringViewEmpty;
     }
 
-    auto start = utf8ToUtf16Seek((uint8_t *)_utf8Str.data, _utf8Str.len, offset);
+    auto start = seekUtf16(offset);
     auto end = offset + size;
     if (end <= _utf8Str._lenUtf16 && end >= size) {
-        auto end = utf8ToUtf16Seek(start, (uint32_t)((uint8_t *)_utf8Str.data + _utf8Str.len - start), size);
+        // 可随机访问时直接定位结束位置，否则从 start 开始查找
+        auto end = canRandomAccess() ? seekUtf16(offset + size)
+            : utf8ToUtf16Seek(start, (uint32_t)((uint8_t *)_utf8Str.data + _utf8Str.len - start), size);
         return StringView(start, (uint32_t)(end - start), _utf8Str._isStable);
     } else {
         return StringView(start, (uint32_t)((uint8_t *)_utf8Str.data + _utf8Str.len - start), _utf8Str._isStable);
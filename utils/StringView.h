@@ -84,7 +84,10 @@ public:
 
     StringView trim(uint8_t charToTrim) const;
     StringView trim(const StringView &toTrim) const;
+    // trim(), trimStart(), trimEnd() 去掉 stringViewBlanks 中的空白字符
     StringView trim() const;
+    StringView trimStart() const;
+    StringView trimEnd() const;
     StringView trimStart(const StringView &toTrim) const;
     StringView trimEnd(const StringView &toTrim) const;
 
@@ -161,8 +164,9 @@ public:
         const char *p = data, *start = data, *end = data + len;
 
         while (p < end && count != 0) {
-            while (p < end && *p != chSeparator) {
-                p++;
+            p = (const char *)memchr(p, chSeparator, end - p);
+            if (p == nullptr) {
+                p = end;
             }
 
             if (p < end) {
@@ -211,26 +215,53 @@ protected:
 static_assert(sizeof(StringView) == 16, "Expected same size.");
 
 /**
- * StringView 保存的是 utf-8 编码, 而 dataUtf16 和 lenUtf16 保存的是 utf-16 编码
+ * 非 ansi 字符串的 utf-16 偏移索引: 每隔 STEP 个 utf-16 字符记录一次对应的 utf-8 字节偏移.
+ * 随机访问时从最近的记录开始向后查找，占用的内存约为完整 utf-16 拷贝的 1/16.
+ */
+class Utf8OffsetIndex {
+public:
+    enum {
+        STEP                    = 32,
+    };
+
+    static uint32_t memorySize(uint32_t lenUtf16) { return sizeof(Utf8OffsetIndex) + lenUtf16 / STEP * sizeof(uint32_t); }
+
+    // 在 buf 上创建索引，buf 的大小为 memorySize(lenUtf16)
+    static Utf8OffsetIndex *create(void *buf, const StringView &str, uint32_t lenUtf16);
+
+    // 返回包含 utf-16 位置 pos 的字符在 utf-8 中的偏移，posStartOut 为此字符开始的 utf-16 位置
+    uint32_t seek(const StringView &str, uint32_t pos, uint32_t &posStartOut) const;
+
+protected:
+    Utf8OffsetIndex() { }
+
+    // 最近一次 seek 的位置，顺序访问时可以从这里继续查找
+    mutable uint32_t            _lastPos, _lastOffset;
+
+    // _offsets[i] 为包含 utf-16 位置 i * STEP 的字符的 utf-8 偏移,
+    // 最高位为 1 表示此位置是 surrogate pair 的第二个字符
+    uint32_t                    _offsets[1];
+
+};
+
+/**
+ * StringView 保存的是 utf-8 编码, 而 lenUtf16 是 utf-16 编码的长度.
+ * 非 ansi 的长字符串需要先创建 Utf8OffsetIndex 才能随机访问.
  */
 class StringViewUtf16 {
 public:
     StringViewUtf16() {
-        _dataUtf16 = nullptr;
+        _offsetIndex = nullptr;
         setAnsi(true);
     }
 
-    StringViewUtf16(const utf16_t *dataUtf16, uint32_t lenUtf16) : _dataUtf16((utf16_t *)dataUtf16) {
-        setUtf16Size(lenUtf16);
-    }
-
     StringViewUtf16(const StringView &s) : _utf8Str(s) {
         onSetUtf8String();
     }
 
     StringViewUtf16(const uint8_t *data, uint32_t len, bool isAnsi) : _utf8Str(data, len) {
         if (isAnsi) {
-            _dataUtf16 = nullptr;
+            _offsetIndex = nullptr;
             _utf8Str._lenUtf16 = len;
             _utf8Str._isAnsi = true;
         } else {
@@ -238,33 +269,38 @@ public:
         }
     }
 
+    // 已知 utf-16 的长度时，不需要再遍历 utf-8 字符串
+    StringViewUtf16(const StringView &s, uint32_t lenUtf16) : _utf8Str(s), _offsetIndex(nullptr) {
+        setUtf16Size(lenUtf16);
+        setAnsi(lenUtf16 == s.len);
+    }
+
     void set(const StringView &other) {
         _utf8Str = other;
         onSetUtf8String();
     }
 
-    void setUtf16(const utf16_t *dataUtf16, uint32_t lenUtf16) {
-        _dataUtf16 = (utf16_t *)dataUtf16;
-        assert(lenUtf16 == size()); // _lenUtf16 = lenUtf16;
-        setAnsi(false);
+    void setOffsetIndex(Utf8OffsetIndex *index) {
+        assert(!isAnsi());
+        _offsetIndex = index;
     }
 
     const StringView &utf8Str() const { return _utf8Str; }
 
     inline uint32_t size() const { return _utf8Str._lenUtf16; }
-    inline utf16_t *utf16Data() const { return _dataUtf16; }
+    inline Utf8OffsetIndex *offsetIndex() const { return _offsetIndex; }
 
     inline utf16_t chartAt(uint32_t index) const {
         assert(index < size());
         assert(canRandomAccess());
-        return isAnsi() ? _utf8Str.data[index] : _dataUtf16[index];
+        return isAnsi() ? _utf8Str.data[index] : chartAtUtf8(index);
     }
 
     utf32_t codePointAt(uint32_t index) const;
 
-    inline bool canRandomAccess() const { return isAnsi() || _dataUtf16 != nullptr; }
+    // 短字符串直接从头查找，不需要索引
+    inline bool canRandomAccess() const { return isAnsi() || _offsetIndex != nullptr || size() <= Utf8OffsetIndex::STEP; }
     inline bool isAnsi() const { return _utf8Str._isAnsi; }
-    inline bool isUtf16Valid() const { return _dataUtf16 != nullptr; }
 
     bool equal(uint32_t code) const;
 
@@ -278,11 +314,19 @@ protected:
     inline void setAnsi(bool isAnsi) { _utf8Str._isAnsi = isAnsi; }
     inline void setUtf16Size(uint32_t len) { _utf8Str._lenUtf16 = len; }
 
+    utf16_t chartAtUtf8(uint32_t index) const;
+
+    // 返回包含 utf-16 位置 pos 的字符，posStartOut 为此字符开始的 utf-16 位置
+    const uint8_t *seekCharAt(uint32_t pos, uint32_t &posStartOut) const;
+
+    // 返回 utf-16 位置 pos 对应的 utf-8 字符串位置，pos 在 surrogate pair 中间时返回其后的位置
+    const uint8_t *seekUtf16(uint32_t pos) const;
+
 protected:
     StringView                 _utf8Str;
 
-    // _lenUtf16 是一定有效的，_dataUtf16 不一定有效
-    utf16_t                     *_dataUtf16;
+    // _lenUtf16 是一定有效的，_offsetIndex 不一定有效
+    Utf8OffsetIndex             *_offsetIndex;
 
 };
 
@@ -322,6 +366,9 @@ public:
 bool strIsInList(StringView &str, StringView *arr, size_t count);
 bool IStrIsInList(StringView &str, StringView *arr, size_t count);
 
+// 检查 str 是否为结构合法的 UTF-8，合法时 lenUtf16Out 返回转换为 UTF-16 后的长度
+bool utf8CheckUtf16Length(const uint8_t *str, uint32_t len, uint32_t &lenUtf16Out);
+
 inline void operator+=(std::string &str, const StringView &other) {
     str.append(other.data, other.len);
 }
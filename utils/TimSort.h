@@ -0,0 +1,367 @@
+﻿//
+//  TimSort.h
+//  TinyJS
+//
+//  Created by henry_xiao on 2023/1/21.
+//
+
+#pragma once
+
+#ifndef TimSort_h
+#define TimSort_h
+
+#include <vector>
+#include <algorithm>
+
+
+/**
+ * 稳定的 TimSort，用于比较的开销较大的场景 (比如 Array.prototype.sort 的比较函数会调用 JavaScript).
+ *
+ * 先找出已经有序的 run (严格递减的 run 会被反转)，短的 run 用二分插入排序补足到 minRun，
+ * 再按照 TimSort 的规则合并 run 栈. 合并前跳过两边已经在最终位置上的元素，合并时连续从同一个 run
+ * 中取出较多元素后进入 galloping 模式，整段移动. 对于已经有序、逆序或者由几段有序数据组成的数组，比较次数接近 n.
+ *
+ * less 可能是不一致的 (比如比较函数返回随机值或者抛出了异常)，此时结果的顺序不确定，但不会越界访问.
+ */
+template<typename T, typename Less>
+class TimSort {
+public:
+    TimSort(Less &less) : _less(less) { }
+
+    void sort(T *data, size_t count) {
+        if (count < 2) {
+            return;
+        }
+
+        _data = data;
+        _runs.clear();
+
+        auto minRun = minRunLength(count);
+        size_t lo = 0, remaining = count;
+        while (remaining > 0) {
+            auto len = countRunAndMakeAscending(lo, count);
+            if (len < minRun) {
+                // 用二分插入排序将 run 扩展到 minRun
+                auto force = std::min(remaining, minRun);
+                binaryInsertionSort(lo, lo + force, lo + len);
+                len = force;
+            }
+
+            _runs.push_back({lo, len});
+            mergeCollapse();
+
+            lo += len;
+            remaining -= len;
+        }
+
+        mergeForceCollapse();
+        assert(_runs.size() == 1 && _runs[0].len == count);
+    }
+
+protected:
+    enum {
+        MIN_MERGE               = 32,
+        MIN_GALLOP              = 7,
+    };
+
+    struct Run {
+        size_t                  start, len;
+    };
+
+    static size_t minRunLength(size_t n) {
+        size_t r = 0;
+        while (n >= MIN_MERGE) {
+            r |= n & 1;
+            n >>= 1;
+        }
+        return n + r;
+    }
+
+    // 返回从 lo 开始的 run 的长度，严格递减的 run 会被反转为递增 (非严格递减的反转后会破坏稳定性)
+    size_t countRunAndMakeAscending(size_t lo, size_t hi) {
+        auto runHi = lo + 1;
+        if (runHi == hi) {
+            return 1;
+        }
+
+        if (_less(_data[runHi++], _data[lo])) {
+            while (runHi < hi && _less(_data[runHi], _data[runHi - 1])) {
+                runHi++;
+            }
+            std::reverse(_data + lo, _data + runHi);
+        } else {
+            while (runHi < hi && !_less(_data[runHi], _data[runHi - 1])) {
+                runHi++;
+            }
+        }
+
+        return runHi - lo;
+    }
+
+    // [lo, start) 已经有序，将 [start, hi) 逐个二分插入
+    void binaryInsertionSort(size_t lo, size_t hi, size_t start) {
+        for (; start < hi; start++) {
+            T pivot = std::move(_data[start]);
+
+            // 相等的元素插入到后面，保证稳定
+            size_t left = lo, right = start;
+            while (left < right) {
+                auto mid = (left + right) / 2;
+                if (_less(pivot, _data[mid])) {
+                    right = mid;
+                } else {
+                    left = mid + 1;
+                }
+            }
+
+            std::move_backward(_data + left, _data + start, _data + start + 1);
+            _data[left] = std::move(pivot);
+        }
+    }
+
+    // 保持 run 栈的不变式: len[i - 2] > len[i - 1] + len[i], len[i - 1] > len[i]
+    void mergeCollapse() {
+        while (_runs.size() > 1) {
+            auto n = _runs.size() - 2;
+            if ((n > 0 && _runs[n - 1].len <= _runs[n].len + _runs[n + 1].len)
+                || (n > 1 && _runs[n - 2].len <= _runs[n - 1].len + _runs[n].len)) {
+                if (_runs[n - 1].len < _runs[n + 1].len) {
+                    n--;
+                }
+            } else if (_runs[n].len > _runs[n + 1].len) {
+                break;
+            }
+            mergeAt(n);
+        }
+    }
+
+    void mergeForceCollapse() {
+        while (_runs.size() > 1) {
+            auto n = _runs.size() - 2;
+            if (n > 0 && _runs[n - 1].len < _runs[n + 1].len) {
+                n--;
+            }
+            mergeAt(n);
+        }
+    }
+
+    // 合并 run i 和 i + 1
+    void mergeAt(size_t i) {
+        auto base1 = _runs[i].start, len1 = _runs[i].len;
+        auto base2 = _runs[i + 1].start, len2 = _runs[i + 1].len;
+        assert(base1 + len1 == base2);
+
+        _runs[i].len = len1 + len2;
+        _runs.erase(_runs.begin() + i + 1);
+
+        // run1 中不大于 run2 第一个元素的部分已经在最终的位置上了
+        auto k = gallopUpper(_data[base2], _data + base1, len1);
+        base1 += k;
+        len1 -= k;
+        if (len1 == 0) {
+            return;
+        }
+
+        // run2 中不小于 run1 最后一个元素的部分也已经在最终的位置上了
+        len2 -= countNotLessAtEnd(_data[base1 + len1 - 1], _data + base2, len2);
+        if (len2 == 0) {
+            return;
+        }
+
+        if (len1 <= len2) {
+            mergeLo(base1, len1, base2, len2);
+        } else {
+            mergeHi(base1, len1, base2, len2);
+        }
+    }
+
+    /**
+     * 以下的 gallop 查找先按照 1, 3, 7, 15... 的位置确定范围，再在范围内二分，
+     * 目标位置离查找的起点越近，比较次数越少.
+     */
+
+    // [first, first + len) 中第一个大于 key 的位置
+    size_t gallopUpper(const T &key, const T *first, size_t len) {
+        size_t lo = 0, step = 1;
+        while (lo + step <= len && !_less(key, first[lo + step - 1])) {
+            lo += step;
+            step *= 2;
+        }
+
+        auto hi = lo + step <= len ? lo + step - 1 : len;
+        while (lo < hi) {
+            auto mid = (lo + hi) / 2;
+            if (_less(key, first[mid])) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    }
+
+    // [first, first + len) 中第一个不小于 key 的位置
+    size_t gallopLower(const T &key, const T *first, size_t len) {
+        size_t lo = 0, step = 1;
+        while (lo + step <= len && _less(first[lo + step - 1], key)) {
+            lo += step;
+            step *= 2;
+        }
+
+        auto hi = lo + step <= len ? lo + step - 1 : len;
+        while (lo < hi) {
+            auto mid = (lo + hi) / 2;
+            if (_less(first[mid], key)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // [first, first + len) 末尾大于 key 的元素个数
+    size_t countGreaterAtEnd(const T &key, const T *first, size_t len) {
+        size_t count = 0, step = 1;
+        while (count + step <= len && _less(key, first[len - count - step])) {
+            count += step;
+            step *= 2;
+        }
+
+        size_t lo = count + step <= len ? len - count - step + 1 : 0, hi = len - count;
+        while (lo < hi) {
+            auto mid = (lo + hi) / 2;
+            if (_less(key, first[mid])) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return len - lo;
+    }
+
+    // [first, first + len) 末尾不小于 key 的元素个数
+    size_t countNotLessAtEnd(const T &key, const T *first, size_t len) {
+        size_t count = 0, step = 1;
+        while (count + step <= len && !_less(first[len - count - step], key)) {
+            count += step;
+            step *= 2;
+        }
+
+        size_t lo = count + step <= len ? len - count - step + 1 : 0, hi = len - count;
+        while (lo < hi) {
+            auto mid = (lo + hi) / 2;
+            if (_less(first[mid], key)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return len - lo;
+    }
+
+    // run1 较短，复制到临时空间，从前往后合并
+    void mergeLo(size_t base1, size_t len1, size_t base2, size_t len2) {
+        _tmp.assign(std::make_move_iterator(_data + base1), std::make_move_iterator(_data + base1 + len1));
+
+        auto tmp = _tmp.data();
+        size_t i = 0, j = base2, end2 = base2 + len2, dest = base1;
+        while (i < len1 && j < end2) {
+            // 逐个比较，直到连续从同一个 run 中取出了 MIN_GALLOP 个元素
+            size_t count1 = 0, count2 = 0;
+            while (i < len1 && j < end2 && count1 < MIN_GALLOP && count2 < MIN_GALLOP) {
+                if (_less(_data[j], tmp[i])) {
+                    _data[dest++] = std::move(_data[j++]);
+                    count2++;
+                    count1 = 0;
+                } else {
+                    _data[dest++] = std::move(tmp[i++]);
+                    count1++;
+                    count2 = 0;
+                }
+            }
+
+            // galloping: 查找出可以整段移动的元素
+            while (i < len1 && j < end2) {
+                auto k1 = gallopUpper(_data[j], tmp + i, len1 - i);
+                std::move(tmp + i, tmp + i + k1, _data + dest);
+                dest += k1;
+                i += k1;
+                if (i == len1) {
+                    break;
+                }
+
+                auto k2 = gallopLower(tmp[i], _data + j, end2 - j);
+                std::move(_data + j, _data + j + k2, _data + dest);
+                dest += k2;
+                j += k2;
+
+                if (k1 < MIN_GALLOP && k2 < MIN_GALLOP) {
+                    break;
+                }
+            }
+        }
+
+        // run2 剩余的部分已经在原位置上了
+        std::move(tmp + i, tmp + len1, _data + dest);
+    }
+
+    // run2 较短，复制到临时空间，从后往前合并
+    void mergeHi(size_t base1, size_t len1, size_t base2, size_t len2) {
+        _tmp.assign(std::make_move_iterator(_data + base2), std::make_move_iterator(_data + base2 + len2));
+
+        auto tmp = _tmp.data();
+        size_t i = base1 + len1, j = len2, dest = base2 + len2;
+        while (i > base1 && j > 0) {
+            size_t count1 = 0, count2 = 0;
+            while (i > base1 && j > 0 && count1 < MIN_GALLOP && count2 < MIN_GALLOP) {
+                if (_less(tmp[j - 1], _data[i - 1])) {
+                    _data[--dest] = std::move(_data[--i]);
+                    count1++;
+                    count2 = 0;
+                } else {
+                    _data[--dest] = std::move(tmp[--j]);
+                    count2++;
+                    count1 = 0;
+                }
+            }
+
+            while (i > base1 && j > 0) {
+                auto k1 = countGreaterAtEnd(tmp[j - 1], _data + base1, i - base1);
+                std::move_backward(_data + i - k1, _data + i, _data + dest);
+                dest -= k1;
+                i -= k1;
+                if (i == base1) {
+                    break;
+                }
+
+                auto k2 = countNotLessAtEnd(_data[i - 1], tmp, j);
+                std::move(tmp + j - k2, tmp + j, _data + dest - k2);
+                dest -= k2;
+                j -= k2;
+
+                if (k1 < MIN_GALLOP && k2 < MIN_GALLOP) {
+                    break;
+                }
+            }
+        }
+
+        // run1 剩余的部分已经在原位置上了
+        std::move(tmp, tmp + j, _data + dest - j);
+    }
+
+protected:
+    Less                        &_less;
+    T                           *_data;
+    std::vector<Run>            _runs;
+    std::vector<T>              _tmp;
+
+};
+
+template<typename T, typename Less>
+void timSort(T *data, size_t count, Less less) {
+    TimSort<T, Less> sorter(less);
+    sorter.sort(data, count);
+}
+
+#endif /* TimSort_h */
@@ -8,11 +8,16 @@
 #include <chrono>
 
 #ifdef _WIN32
+#include <psapi.h>
 #else
 #include <sys/time.h>
 #include <unistd.h>
 #endif
 
+#ifdef _MAC_OS
+#include <mach/mach.h>
+#endif
+
 #include "UtilsTypes.h"
 #include "StringView.h"
 #include "StringEx.h"
@@ -41,6 +46,37 @@ void Sleep(uint32_t milliseconds) {
 }
 #endif
 
+size_t getProcessMemoryUsage() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.WorkingSetSize;
+    }
+    return 0;
+#elif defined(_MAC_OS)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        return info.resident_size;
+    }
+    return 0;
+#else
+    // /proc/self/statm: size resident shared ... (单位为 page)
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp == nullptr) {
+        return 0;
+    }
+
+    long size = 0, resident = 0;
+    if (fscanf(fp, "%ld %ld", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(fp);
+
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
 FileFind::FileFind() {
 }
 
@@ -19,6 +19,9 @@ int64_t getTickCount();
 void Sleep(uint32_t milliseconds);
 #endif
 
+// 返回当前进程占用的物理内存 (RSS)，单位为字节，失败返回 0
+size_t getProcessMemoryUsage();
+
 bool executeCmd(cstr_t cmdLine);
 bool executeCmdAndWait(cstr_t cmdLine, uint32_t timeOut, uint32_t *exitCodeOut);
 